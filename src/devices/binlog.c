@@ -0,0 +1,133 @@
+#include "devices/binlog.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+
+/* Binary log channel.
+
+   With -binlog, bulk instrumentation output, such as the trace
+   ring and the profile, is written raw to the second serial port
+   (COM2) instead of being formatted with printf() onto the
+   console.  That skips the formatting, sends a fraction of the
+   bytes, and keeps the console output that tests check free of
+   it.  utils/pintos --binlog=FILE connects COM2 to FILE, and
+   utils/pintos-binlog turns FILE back into the text lines that
+   the other tools read.
+
+   The log is a sequence of frames, each an 8-byte header followed
+   by SIZE bytes of payload, all little-endian:
+
+        uint8_t magic[2];       "PB"
+        uint8_t type;           enum binlog_type
+        uint8_t reserved;       0
+        uint32_t size;          Payload bytes.
+
+   The port is driven by polling, so frames may be written with
+   interrupts off, and one frame is written with interrupts off
+   throughout so that frames never interleave. */
+
+/* I/O port base address for the second serial port, and the
+   16550A registers used here.  See devices/serial.c. */
+#define IO_BASE 0x2f8
+#define THR_REG (IO_BASE + 0)   /* Transmitter Holding Reg. */
+#define IER_REG (IO_BASE + 1)   /* Interrupt Enable Reg. */
+#define LS_REG (IO_BASE + 0)    /* Divisor Latch (LSB), with DLAB. */
+#define MS_REG (IO_BASE + 1)    /* Divisor Latch (MSB), with DLAB. */
+#define FCR_REG (IO_BASE + 2)   /* FIFO Control Reg. */
+#define LCR_REG (IO_BASE + 3)   /* Line Control Reg. */
+#define LSR_REG (IO_BASE + 5)   /* Line Status Reg. */
+#define SCR_REG (IO_BASE + 7)   /* Scratch Reg. */
+
+#define FCR_ENABLE 0x01         /* Enable FIFOs. */
+#define FCR_CLEAR 0x06          /* Clear both FIFOs. */
+#define LCR_N81 0x03            /* No parity, 8 data bits, 1 stop bit. */
+#define LCR_DLAB 0x80           /* Divisor Latch Access Bit. */
+#define LSR_THRE 0x20           /* THR Empty. */
+
+/* Bytes that can be written once THR is empty.  Assumes the
+   16550A's FIFO, which every emulator Pintos runs on has. */
+#define FIFO_SIZE 16
+
+bool binlog_enabled;
+
+/* Bytes writable before LSR_THRE must be checked again. */
+static int tx_room;
+
+/* Bytes of the current frame's payload not yet written, and the
+   interrupt level to restore once they are. */
+static size_t frame_left;
+static enum intr_level frame_level;
+
+/* Looks for COM2 and sets it up for 115.2 kbps, N-8-1, without
+   interrupts.  Returns true and enables the binary log if COM2
+   exists, false otherwise. */
+bool
+binlog_init (void) 
+{
+  /* A missing port reads back all 1s, not what was written to
+     the scratch register. */
+  outb (SCR_REG, 0x5a);
+  if (inb (SCR_REG) != 0x5a)
+    return false;
+
+  outb (IER_REG, 0);
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR);
+  outb (LCR_REG, LCR_N81 | LCR_DLAB);
+  outb (LS_REG, 1);                     /* 115200 bps. */
+  outb (MS_REG, 0);
+  outb (LCR_REG, LCR_N81);
+  binlog_enabled = true;
+  return true;
+}
+
+/* Writes BYTE to COM2, waiting only when the FIFO may be full. */
+static void
+put_byte (uint8_t byte) 
+{
+  if (tx_room == 0)
+    {
+      while ((inb (LSR_REG) & LSR_THRE) == 0)
+        continue;
+      tx_room = FIFO_SIZE;
+    }
+  outb (THR_REG, byte);
+  tx_room--;
+}
+
+/* Starts a frame of the given TYPE with SIZE bytes of payload,
+   which the caller must then write with binlog_put().  Interrupts
+   stay off until the whole payload has been written. */
+void
+binlog_begin (enum binlog_type type, size_t size) 
+{
+  uint8_t header[8] = { 'P', 'B', type, 0,
+                        size, size >> 8, size >> 16, size >> 24 };
+  enum intr_level old_level;
+  size_t i;
+
+  ASSERT (binlog_enabled);
+
+  old_level = intr_disable ();
+  ASSERT (frame_left == 0);
+  for (i = 0; i < sizeof header; i++)
+    put_byte (header[i]);
+  frame_left = size;
+  frame_level = old_level;
+  if (size == 0)
+    intr_set_level (old_level);
+}
+
+/* Writes the SIZE bytes at BUFFER as part of the current frame's
+   payload. */
+void
+binlog_put (const void *buffer, size_t size) 
+{
+  const uint8_t *p = buffer;
+
+  ASSERT (size <= frame_left);
+  frame_left -= size;
+  while (size-- > 0)
+    put_byte (*p++);
+  if (frame_left == 0)
+    intr_set_level (frame_level);
+}
@@ -0,0 +1,22 @@
+#ifndef DEVICES_BINLOG_H
+#define DEVICES_BINLOG_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Kinds of binary log frame.  utils/pintos-binlog must agree. */
+enum binlog_type
+  {
+    BINLOG_TRACE = 1,           /* Event trace ring, from trace_dump(). */
+    BINLOG_PROF = 2             /* Profile slots, from prof_print(). */
+  };
+
+/* True if dumps go to the binary log instead of the console. */
+extern bool binlog_enabled;
+
+bool binlog_init (void);
+void binlog_begin (enum binlog_type, size_t size);
+void binlog_put (const void *, size_t);
+
+#endif /* devices/binlog.h */
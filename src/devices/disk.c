@@ -1,12 +1,22 @@
 #include "devices/disk.h"
 #include <ctype.h>
 #include <debug.h>
+#include <list.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/vaddr.h"
+#ifdef FILESYS
+#include "filesys/cache.h"
+#include "filesys/inode.h"
+#endif
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -28,10 +38,37 @@
 #define reg_ctl(CHANNEL) ((CHANNEL)->reg_base + 0x206)  /* Control (w/o). */
 #define reg_alt_status(CHANNEL) reg_ctl (CHANNEL)       /* Alt Status (r/o). */
 
+/* Bus master IDE port addresses, relative to the channel's part
+   of the bus master register block found through PCI. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prd(CHANNEL) ((CHANNEL)->bm_base + 4)     /* PRD table. */
+
+/* Bus master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Transfer to memory, i.e. disk read. */
+
+/* Bus master Status Register bits.  Both are cleared by writing
+   a 1 to them. */
+#define BM_STA_ERR 0x02         /* Transfer failed. */
+#define BM_STA_INTR 0x04        /* Device raised its interrupt. */
+
+/* A physical region descriptor, one entry in the table that
+   tells the bus master where in memory to transfer data.  A
+   region may not cross a 64 kB boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address. */
+    uint16_t size;              /* Size in bytes, 0 for 64 kB. */
+    uint16_t flags;             /* PRD_EOT for the last entry. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -47,6 +84,18 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_MULTIPLE 0xc4          /* READ MULTIPLE. */
+#define CMD_WRITE_MULTIPLE 0xc5         /* WRITE MULTIPLE. */
+#define CMD_SET_MULTIPLE_MODE 0xc6      /* SET MULTIPLE MODE. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Maximum number of sectors transferred by one command.  The
+   sector count register holds 0 for this many. */
+#define TRANSFER_MAX DISK_TRANSFER_MAX
+
+/* Number of buckets in a disk's latency histogram. */
+#define LATENCY_BUCKETS 16
 
 /* An ATA device. */
 struct disk 
@@ -57,25 +106,78 @@ struct disk
 
     bool is_ata;                /* 1=This device is an ATA disk. */
     disk_sector_t capacity;     /* Capacity in sectors (if is_ata). */
+    size_t multiple_cnt;        /* Sectors per interrupt for READ/WRITE
+                                   MULTIPLE, or 0 if not supported. */
+    bool dma;                   /* True to transfer data by DMA. */
 
     long long read_cnt;         /* Number of sectors read. */
     long long write_cnt;        /* Number of sectors written. */
+
+    /* Histogram of command latencies, from issuing a command to
+       its final interrupt.  Bucket I counts commands that took
+       less than 2**I kilocycles (and at least 2**(I-1) for I > 0);
+       the last bucket also counts anything slower. */
+    long long latency_hist[LATENCY_BUCKETS];
   };
 
+/* Maximum number of requests merged into one command.  Keeps the
+   PRD table for a merged DMA transfer within a page. */
+#define MERGE_MAX 64
+
 /* An ATA channel (aka controller).
-   Each channel can control up to two disks. */
+   Each channel can control up to two disks.  The two channels
+   work independently, so a disk on one channel, such as the file
+   system disk hd0:1, transfers data at the same time as a disk on
+   the other, such as the swap disk hd1:1.
+
+   Only the channel's I/O thread talks to the controller, once
+   disk_init() has returned.  Other threads queue requests, which
+   the I/O thread serves by I/O class, highest first.  Within a
+   class, it goes in C-SCAN order: in ascending sector order
+   starting at the sector just past the previous transfer,
+   wrapping around to the lowest pending sector at the end.
+   Queued requests of one class for consecutive sectors in the
+   same direction are merged into a single command.
+
+   So that a busy class cannot starve the ones below it, each
+   class also keeps its requests in submission order, and the
+   oldest request of any class that is past its deadline is
+   served first. */
 struct channel 
   {
     char name[8];               /* Name, e.g. "hd0". */
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
+    struct lock queue_lock;     /* Protects the queues. */
+    struct list queue[DISK_IO_CLASS_CNT]; /* Pending requests by class,
+                                   sorted by sector; [DISK_IO_AUTO]
+                                   is unused. */
+    struct list fifo[DISK_IO_CLASS_CNT]; /* The same, oldest first. */
+    struct condition queue_ready; /* Signaled when a queue is nonempty. */
+    disk_sector_t head;         /* Sector after the last transfer. */
+
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    struct timer timeout;       /* Fires if the interrupt never comes. */
+    bool timed_out;             /* Set by TIMEOUT on expiry. */
+
+    uint16_t bm_base;           /* Bus master registers, 0 if none. */
+    struct prd *prd;            /* PRD table, in its own page. */
 
     struct disk devices[2];     /* The devices on this channel. */
+
+    /* Statistics. */
+    long long submit_cnt;       /* Number of requests submitted. */
+    long long depth_sum;        /* Sum of queue lengths at submission. */
+    size_t queue_len;           /* Requests in all queues. */
+    size_t max_queue_len;       /* Highest QUEUE_LEN seen. */
+    long long class_cnt[DISK_IO_CLASS_CNT]; /* Requests by class. */
+    long long expired_cnt;      /* Batches started past a deadline. */
+    long long cmd_cnt;          /* Number of commands issued. */
+    int64_t busy_ticks;         /* Timer ticks spent in transfers. */
+    int64_t start_ticks;        /* Timer ticks at initialization. */
   };
 
 /* We support the two "legacy" ATA channels found in a standard PC. */
@@ -85,14 +187,27 @@ static struct channel channels[CHANNEL_CNT];
 static void reset_channel (struct channel *);
 static bool check_device_type (struct disk *);
 static void identify_ata_device (struct disk *);
+static void set_multiple_mode (struct disk *, size_t cnt);
+static uint16_t find_bus_master (void);
 
-static void select_sector (struct disk *, disk_sector_t);
+static void select_sector (struct disk *, disk_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
-static void input_sector (struct channel *, void *);
-static void output_sector (struct channel *, const void *);
+static void input_sectors (struct channel *, void *, size_t cnt);
+static void output_sectors (struct channel *, const void *, size_t cnt);
+static void pio_read (struct disk *, disk_sector_t, size_t cnt,
+                      struct list *);
+static void pio_write (struct disk *, disk_sector_t, size_t cnt,
+                       struct list *);
+static bool use_dma (const struct disk *, struct list *);
+static void dma_transfer (struct disk *, disk_sector_t, size_t cnt,
+                          struct list *, bool write);
+static void disk_transfer (struct disk *, disk_sector_t, size_t cnt,
+                           void *, bool write);
+static thread_func channel_thread NO_RETURN;
 
 static void wait_until_idle (const struct disk *);
 static bool wait_while_busy (const struct disk *);
+static bool wait_for_interrupt (struct channel *);
 static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
@@ -102,12 +217,13 @@ static void interrupt_handler (struct intr_frame *);
 void
 disk_init (void) 
 {
+  uint16_t bm_base = find_bus_master ();
   size_t chan_no;
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
-      int dev_no;
+      int dev_no, i;
 
       /* Initialize channel. */
       snprintf (c->name, sizeof c->name, "hd%zu", chan_no);
@@ -124,22 +240,49 @@ disk_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
+      lock_init_named (&c->queue_lock, c->name);
+      for (i = 0; i < DISK_IO_CLASS_CNT; i++)
+        {
+          list_init (&c->queue[i]);
+          list_init (&c->fifo[i]);
+          c->class_cnt[i] = 0;
+        }
+      c->expired_cnt = 0;
+      cond_init (&c->queue_ready);
+      c->head = 0;
       c->expecting_interrupt = false;
+      c->cmd_cnt = 0;
+      c->submit_cnt = c->depth_sum = 0;
+      c->queue_len = c->max_queue_len = 0;
+      c->busy_ticks = 0;
+      c->start_ticks = timer_ticks ();
       sema_init (&c->completion_wait, 0);
+
+      /* Set up bus master DMA, if the controller supports it. */
+      c->bm_base = 0;
+      c->prd = NULL;
+      if (bm_base != 0)
+        {
+          c->prd = palloc_get_page (0);
+          if (c->prd != NULL)
+            c->bm_base = bm_base + 8 * chan_no;
+        }
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
         {
           struct disk *d = &c->devices[dev_no];
-          snprintf (d->name, sizeof d->name, "%s:%d", c->name, dev_no);
+          snprintf (d->name, sizeof d->name, "hd%zu:%d", chan_no, dev_no);
           d->channel = c;
           d->dev_no = dev_no;
 
           d->is_ata = false;
           d->capacity = 0;
+          d->multiple_cnt = 0;
+          d->dma = false;
 
           d->read_cnt = d->write_cnt = 0;
+          memset (d->latency_hist, 0, sizeof d->latency_hist);
         }
 
       /* Register interrupt handler. */
@@ -156,9 +299,42 @@ disk_init (void)
       for (dev_no = 0; dev_no < 2; dev_no++)
         if (c->devices[dev_no].is_ata)
           identify_ata_device (&c->devices[dev_no]);
+
+      /* Start serving requests. */
+      if (c->devices[0].is_ata || c->devices[1].is_ata)
+        thread_create_daemon (c->name, PRI_MAX, channel_thread, c);
     }
 }
 
+/* Counts a command on disk D that took CYCLES CPU cycles. */
+static void
+record_latency (struct disk *d, uint64_t cycles) 
+{
+  uint32_t kcycles = cycles >> 10 > UINT32_MAX ? UINT32_MAX : cycles >> 10;
+  int bucket = 0;
+
+  while (bucket < LATENCY_BUCKETS - 1 && kcycles >= (1u << bucket))
+    bucket++;
+  d->latency_hist[bucket]++;
+}
+
+/* Prints the nonempty buckets of disk D's latency histogram. */
+static void
+print_latency_hist (const struct disk *d) 
+{
+  int i;
+
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    if (d->latency_hist[i] > 0)
+      {
+        if (i == LATENCY_BUCKETS - 1)
+          printf ("  >= %u", 1u << (i - 1));
+        else
+          printf ("  < %u", 1u << i);
+        printf (" kcycles: %lld commands\n", d->latency_hist[i]);
+      }
+}
+
 /* Prints disk statistics. */
 void
 disk_print_stats (void) 
@@ -167,16 +343,52 @@ disk_print_stats (void)
 
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++) 
     {
+      struct channel *c = &channels[chan_no];
+      int64_t elapsed = timer_elapsed (c->start_ticks);
       int dev_no;
 
+      if (c->cmd_cnt > 0)
+        printf ("%s: %lld commands, %lld%% busy, "
+                "queue depth %lld.%02lld average, %zu maximum\n",
+                c->name, c->cmd_cnt,
+                elapsed > 0 ? c->busy_ticks * 100 / elapsed : 0,
+                c->depth_sum / c->submit_cnt,
+                c->depth_sum * 100 / c->submit_cnt % 100,
+                c->max_queue_len);
+      if (c->submit_cnt > 0)
+        printf ("%s: %lld real-time, %lld best-effort, %lld idle requests, "
+                "%lld served past deadline\n",
+                c->name, c->class_cnt[DISK_IO_RT], c->class_cnt[DISK_IO_BE],
+                c->class_cnt[DISK_IO_IDLE], c->expired_cnt);
+
       for (dev_no = 0; dev_no < 2; dev_no++) 
         {
           struct disk *d = disk_get (chan_no, dev_no);
           if (d != NULL && d->is_ata) 
-            printf ("%s: %lld reads, %lld writes\n",
-                    d->name, d->read_cnt, d->write_cnt);
+            {
+              printf ("%s: %lld reads, %lld writes\n",
+                      d->name, d->read_cnt, d->write_cnt);
+              print_latency_hist (d);
+            }
         }
     }
+#ifdef FILESYS
+  cache_print_stats ();
+  inode_print_stats ();
+#endif
+}
+
+/* Fills in the disk fields of *S with the counters of disk D and
+   of its channel. */
+void
+disk_get_stats (struct disk *d, struct disk_stats *s) 
+{
+  ASSERT (d != NULL);
+
+  s->read_cnt = d->read_cnt;
+  s->write_cnt = d->write_cnt;
+  s->cmd_cnt = d->channel->cmd_cnt;
+  s->busy_ticks = d->channel->busy_ticks;
 }
 
 /* Returns the disk numbered DEV_NO--either 0 or 1 for master or
@@ -219,21 +431,7 @@ disk_size (struct disk *d)
 void
 disk_read (struct disk *d, disk_sector_t sec_no, void *buffer) 
 {
-  struct channel *c;
-  
-  ASSERT (d != NULL);
-  ASSERT (buffer != NULL);
-
-  c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  d->read_cnt++;
-  lock_release (&c->lock);
+  disk_read_multiple (d, sec_no, 1, buffer);
 }
 
 /* Write sector SEC_NO to disk D from BUFFER, which must contain
@@ -244,23 +442,343 @@ disk_read (struct disk *d, disk_sector_t sec_no, void *buffer)
 void
 disk_write (struct disk *d, disk_sector_t sec_no, const void *buffer)
 {
-  struct channel *c;
-  
+  disk_write_multiple (d, sec_no, 1, buffer);
+}
+
+/* Returns the number of sectors that disk D transfers per
+   interrupt. */
+static size_t
+block_size (const struct disk *d)
+{
+  return d->multiple_cnt > 0 ? d->multiple_cnt : 1;
+}
+
+/* Reads the CNT sectors starting at SEC_NO from disk D into
+   BUFFER, which must have room for CNT * DISK_SECTOR_SIZE bytes.
+   Issues one command per TRANSFER_MAX sectors.  Uses bus master
+   DMA if available, otherwise PIO, with READ MULTIPLE if D
+   supports it so that there is one interrupt per block of several
+   sectors instead of one per sector.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_read_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+                    void *buffer) 
+{
+  disk_transfer (d, sec_no, cnt, buffer, false);
+}
+
+/* Writes the CNT sectors starting at SEC_NO on disk D from
+   BUFFER, which must contain CNT * DISK_SECTOR_SIZE bytes.
+   Returns after the disk has acknowledged receiving all of the
+   data.  Uses DMA or WRITE MULTIPLE if possible, as
+   disk_read_multiple() does for reads.
+   Internally synchronizes accesses to disks, so external
+   per-disk locking is unneeded. */
+void
+disk_write_multiple (struct disk *d, disk_sector_t sec_no, size_t cnt,
+                     const void *buffer)
+{
+  disk_transfer (d, sec_no, cnt, (void *) buffer, true);
+}
+
+/* Returns true if request A's first sector precedes request
+   B's. */
+static inline bool
+request_less (const struct disk_request *a, const struct disk_request *b)
+{
+  return a->sector < b->sector;
+}
+
+DEFINE_LIST_INSERT_ORDERED (queue_insert, struct disk_request, elem,
+                            request_less);
+
+/* Initializes R as a request to transfer the CNT sectors
+   starting at SEC_NO between disk D and BUFFER, which must have
+   room for CNT * DISK_SECTOR_SIZE bytes.  The transfer writes to
+   the disk if WRITE is true and reads from it otherwise.  CNT
+   must not exceed DISK_TRANSFER_MAX.
+
+   If COMPLETE is non-null, it is called with R and AUX when the
+   transfer completes.  Otherwise, wait for completion with
+   disk_wait(). */
+void
+disk_request_init (struct disk_request *r, struct disk *d,
+                   disk_sector_t sec_no, size_t cnt, void *buffer,
+                   bool write, disk_request_func *complete, void *aux) 
+{
   ASSERT (d != NULL);
   ASSERT (buffer != NULL);
+  ASSERT (cnt > 0 && cnt <= DISK_TRANSFER_MAX);
+
+  r->disk = d;
+  r->sector = sec_no;
+  r->cnt = cnt;
+  r->buffer = buffer;
+  r->write = write;
+  r->complete = complete;
+  r->aux = aux;
+  sema_init (&r->done, 0);
+}
 
-  c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  d->write_cnt++;
-  lock_release (&c->lock);
+/* Most milliseconds a request of each class waits before it is
+   served ahead of higher classes. */
+static const int deadline_ms[DISK_IO_CLASS_CNT] =
+  {
+    [DISK_IO_RT] = 25,
+    [DISK_IO_BE] = 250,
+    [DISK_IO_IDLE] = 1000,
+  };
+
+/* Sets the I/O class of the current thread's requests to
+   IO_CLASS, or, for DISK_IO_AUTO, back to following its
+   priority. */
+void
+disk_set_io_class (enum disk_io_class io_class)
+{
+  ASSERT (io_class >= DISK_IO_AUTO && io_class < DISK_IO_CLASS_CNT);
+  thread_current ()->io_class = io_class;
 }
-
+
+/* Returns the I/O class of thread T's requests. */
+static enum disk_io_class
+thread_io_class (struct thread *t)
+{
+  if (t->io_class != DISK_IO_AUTO)
+    return t->io_class;
+  else if (t->priority > PRI_DEFAULT)
+    return DISK_IO_RT;
+  else if (t->priority < PRI_DEFAULT)
+    return DISK_IO_IDLE;
+  else
+    return DISK_IO_BE;
+}
+
+/* Queues request R, initialized with disk_request_init(), and
+   returns without waiting for it.  Any number of requests may be
+   outstanding at once; the disk's I/O thread serves them by the
+   current thread's I/O class, then in sector order, merging
+   adjacent ones.  The transfer is charged to the current
+   thread's I/O statistics. */
+void
+disk_submit (struct disk_request *r) 
+{
+  struct channel *c = r->disk->channel;
+
+  struct thread *t = thread_current ();
+  int64_t wait;
+
+  if (r->write)
+    t->io_write_bytes += r->cnt * DISK_SECTOR_SIZE;
+  else
+    t->io_read_bytes += r->cnt * DISK_SECTOR_SIZE;
+
+  r->io_class = thread_io_class (t);
+  wait = (int64_t) deadline_ms[r->io_class] * TIMER_FREQ / 1000;
+  r->deadline = timer_ticks () + (wait > 0 ? wait : 1);
+
+  lock_acquire (&c->queue_lock);
+  c->submit_cnt++;
+  c->class_cnt[r->io_class]++;
+  c->depth_sum += c->queue_len;
+  if (++c->queue_len > c->max_queue_len)
+    c->max_queue_len = c->queue_len;
+  queue_insert (&c->queue[r->io_class], r);
+  list_push_back (&c->fifo[r->io_class], &r->fifo_elem);
+  cond_signal (&c->queue_ready, &c->queue_lock);
+  lock_release (&c->queue_lock);
+}
+
+/* Waits for request R, which was submitted without a completion
+   callback, to complete. */
+void
+disk_wait (struct disk_request *r) 
+{
+  ASSERT (r->complete == NULL);
+  sema_down (&r->done);
+}
+
+/* Transfers the CNT sectors starting at SEC_NO between disk D
+   and BUFFER, in the direction given by WRITE, and waits for the
+   transfer to complete. */
+static void
+disk_transfer (struct disk *d, disk_sector_t sec_no, size_t cnt,
+               void *buffer_, bool write) 
+{
+  uint8_t *buffer = buffer_;
+
+  while (cnt > 0)
+    {
+      struct disk_request r;
+      size_t xfer_cnt = cnt < TRANSFER_MAX ? cnt : TRANSFER_MAX;
+
+      disk_request_init (&r, d, sec_no, xfer_cnt, buffer, write, NULL, NULL);
+      disk_submit (&r);
+      disk_wait (&r);
+
+      sec_no += xfer_cnt;
+      buffer += xfer_cnt * DISK_SECTOR_SIZE;
+      cnt -= xfer_cnt;
+    }
+}
+
+/* Returns the oldest request in channel C's queues that is past
+   its deadline, or a null pointer if there is none. */
+static struct disk_request *
+find_expired (struct channel *c)
+{
+  int64_t now = timer_ticks ();
+  struct disk_request *oldest = NULL;
+  int i;
+
+  for (i = DISK_IO_RT; i < DISK_IO_CLASS_CNT; i++)
+    if (!list_empty (&c->fifo[i]))
+      {
+        struct disk_request *r = list_entry (list_front (&c->fifo[i]),
+                                             struct disk_request, fifo_elem);
+        if (r->deadline <= now
+            && (oldest == NULL || r->deadline < oldest->deadline))
+          oldest = r;
+      }
+  return oldest;
+}
+
+/* Returns the request in channel C's highest nonempty class that
+   C-SCAN picks next. */
+static struct disk_request *
+find_next (struct channel *c)
+{
+  struct list *queue;
+  struct list_elem *e;
+  int i;
+
+  for (i = DISK_IO_RT; list_empty (&c->queue[i]); i++)
+    ASSERT (i < DISK_IO_CLASS_CNT - 1);
+  queue = &c->queue[i];
+
+  for (e = list_begin (queue); e != list_end (queue); e = list_next (e))
+    if (list_entry (e, struct disk_request, elem)->sector >= c->head)
+      break;
+  if (e == list_end (queue))
+    e = list_begin (queue);
+  return list_entry (e, struct disk_request, elem);
+}
+
+/* Moves request R from channel C's queues to the end of BATCH
+   and returns the request after it in its class's sector order. */
+static struct list_elem *
+move_to_batch (struct disk_request *r, struct list *batch)
+{
+  struct list_elem *next = list_remove (&r->elem);
+
+  list_remove (&r->fifo_elem);
+  list_push_back (batch, &r->elem);
+  return next;
+}
+
+/* Moves the next requests to serve from channel C's queues to
+   BATCH, in sector order, and returns their total number of
+   sectors.  The first is the oldest request past its deadline,
+   if any, and otherwise the one C-SCAN picks in the highest
+   nonempty class; those after it are of the same class, for the
+   sectors that immediately follow, on the same disk and in the
+   same direction.  C's queues must not all be empty, and its
+   QUEUE_LOCK must be held. */
+static size_t
+take_batch (struct channel *c, struct list *batch) 
+{
+  struct disk_request *first;
+  struct list *queue;
+  struct list_elem *e;
+  size_t req_cnt, sector_cnt;
+
+  ASSERT (c->queue_len > 0);
+
+  first = find_expired (c);
+  if (first != NULL)
+    c->expired_cnt++;
+  else
+    first = find_next (c);
+  queue = &c->queue[first->io_class];
+
+  e = move_to_batch (first, batch);
+  sector_cnt = first->cnt;
+  for (req_cnt = 1; req_cnt < MERGE_MAX && e != list_end (queue);
+       req_cnt++)
+    {
+      struct disk_request *r = list_entry (e, struct disk_request, elem);
+      if (r->disk != first->disk
+          || r->write != first->write
+          || r->sector != first->sector + sector_cnt
+          || sector_cnt + r->cnt > TRANSFER_MAX)
+        break;
+      e = move_to_batch (r, batch);
+      sector_cnt += r->cnt;
+    }
+  c->queue_len -= req_cnt;
+  return sector_cnt;
+}
+
+/* Serves the requests queued on channel C, passed as C. */
+static void
+channel_thread (void *c_) 
+{
+  struct channel *c = c_;
+
+  for (;;)
+    {
+      struct disk_request *first;
+      struct list batch;
+      int64_t start;
+      uint64_t start_tsc;
+      size_t cnt;
+
+      lock_acquire (&c->queue_lock);
+      while (c->queue_len == 0)
+        cond_wait (&c->queue_ready, &c->queue_lock);
+      list_init (&batch);
+      cnt = take_batch (c, &batch);
+      lock_release (&c->queue_lock);
+
+      first = list_entry (list_front (&batch), struct disk_request, elem);
+      start = timer_ticks ();
+      start_tsc = read_tsc ();
+      trace (first->write ? TRACE_DISK_WRITE : TRACE_DISK_READ,
+             first->sector, cnt);
+      if (!first->write)
+        {
+          if (use_dma (first->disk, &batch))
+            dma_transfer (first->disk, first->sector, cnt, &batch, false);
+          else
+            pio_read (first->disk, first->sector, cnt, &batch);
+          first->disk->read_cnt += cnt;
+        }
+      else
+        {
+          if (use_dma (first->disk, &batch))
+            dma_transfer (first->disk, first->sector, cnt, &batch, true);
+          else
+            pio_write (first->disk, first->sector, cnt, &batch);
+          first->disk->write_cnt += cnt;
+        }
+      c->head = first->sector + cnt;
+      trace (TRACE_DISK_DONE, first->sector, cnt);
+      record_latency (first->disk, read_tsc () - start_tsc);
+      c->busy_ticks += timer_elapsed (start);
+      c->cmd_cnt++;
+
+      while (!list_empty (&batch))
+        {
+          struct list_elem *e = list_pop_front (&batch);
+          struct disk_request *r = list_entry (e, struct disk_request, elem);
+          if (r->complete != NULL)
+            r->complete (r, r->aux);
+          else
+            sema_up (&r->done);
+        }
+    }
+}
+
 /* Disk detection and identification. */
 
 static void print_ata_string (char *string, size_t size);
@@ -375,17 +893,24 @@ identify_ata_device (struct disk *d)
      into our buffer. */
   select_device_wait (d);
   issue_pio_command (c, CMD_IDENTIFY_DEVICE);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
+  if (!wait_for_interrupt (c) || !wait_while_busy (d))
     {
       d->is_ata = false;
       return;
     }
-  input_sector (c, id);
+  input_sectors (c, id, 1);
 
   /* Calculate capacity. */
   d->capacity = id[60] | ((uint32_t) id[61] << 16);
 
+  /* Word 47 gives the most sectors the disk can transfer per
+     interrupt with READ/WRITE MULTIPLE, or 0 if it cannot. */
+  if ((id[47] & 0xff) > 1)
+    set_multiple_mode (d, id[47] & 0xff);
+
+  /* Bit 8 of word 49 says whether the disk supports DMA. */
+  d->dma = c->bm_base != 0 && (id[49] & (1 << 8)) != 0;
+
   /* Print identification message. */
   printf ("%s: detected %'"PRDSNu" sector (", d->name, d->capacity);
   if (d->capacity > 1024 / DISK_SECTOR_SIZE * 1024 * 1024)
@@ -404,6 +929,86 @@ identify_ata_device (struct disk *d)
   printf ("\"\n");
 }
 
+/* Tells disk D to transfer CNT sectors per interrupt for READ
+   MULTIPLE and WRITE MULTIPLE, and records CNT in D if the disk
+   accepts it. */
+static void
+set_multiple_mode (struct disk *d, size_t cnt) 
+{
+  struct channel *c = d->channel;
+
+  select_device_wait (d);
+  outb (reg_nsect (c), cnt);
+  issue_pio_command (c, CMD_SET_MULTIPLE_MODE);
+  if (!wait_for_interrupt (c))
+    return;
+  wait_while_busy (d);
+  if (!(inb (reg_status (c)) & STA_ERR))
+    d->multiple_cnt = cnt;
+}
+
+/* PCI configuration space ports. */
+#define PCI_CONFIG_ADDR 0xcf8
+#define PCI_CONFIG_DATA 0xcfc
+
+/* Returns the 32-bit register at byte offset REG in the PCI
+   configuration space of function FUNC of device DEV on BUS. */
+static uint32_t
+pci_read_config (int bus, int dev, int func, int reg) 
+{
+  outl (PCI_CONFIG_ADDR,
+        0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes DATA to the 32-bit register at byte offset REG in the
+   PCI configuration space of function FUNC of device DEV on
+   BUS. */
+static void
+pci_write_config (int bus, int dev, int func, int reg, uint32_t data) 
+{
+  outl (PCI_CONFIG_ADDR,
+        0x80000000 | (bus << 16) | (dev << 11) | (func << 8) | reg);
+  outl (PCI_CONFIG_DATA, data);
+}
+
+/* Looks on PCI bus 0 for an IDE controller that can act as a bus
+   master, enables bus mastering on it, and returns the I/O port
+   base of its bus master registers.  Returns 0 if there is no
+   such controller. */
+static uint16_t
+find_bus_master (void) 
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t class, bar4;
+
+        if ((pci_read_config (0, dev, func, 0x00) & 0xffff) == 0xffff)
+          continue;
+
+        /* Class 1, subclass 1 is an IDE controller; bit 7 of the
+           programming interface says it can be a bus master. */
+        class = pci_read_config (0, dev, func, 0x08);
+        if ((class >> 16) != 0x0101 || !(class & 0x8000))
+          continue;
+
+        /* BAR 4 holds the bus master register block, which must
+           be in I/O space. */
+        bar4 = pci_read_config (0, dev, func, 0x20);
+        if (!(bar4 & 1) || (bar4 & ~3u) == 0)
+          continue;
+
+        /* Enable I/O space access and bus mastering. */
+        pci_write_config (0, dev, func, 0x04,
+                          pci_read_config (0, dev, func, 0x04) | 0x05);
+        return bar4 & ~3u;
+      }
+  return 0;
+}
+
 /* Prints STRING, which consists of SIZE bytes in a funky format:
    each pair of bytes is in reverse order.  Does not print
    trailing whitespace and/or nulls. */
@@ -426,18 +1031,20 @@ print_ata_string (char *string, size_t size)
 }
 
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT to the disk's sector selection and
+   sector count registers.  (We use LBA mode.) */
 static void
-select_sector (struct disk *d, disk_sector_t sec_no) 
+select_sector (struct disk *d, disk_sector_t sec_no, size_t cnt) 
 {
   struct channel *c = d->channel;
 
+  ASSERT (cnt > 0 && cnt <= TRANSFER_MAX);
   ASSERT (sec_no < d->capacity);
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt <= d->capacity - sec_no);
+  ASSERT (sec_no + cnt <= (1UL << 28));
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == TRANSFER_MAX ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -458,22 +1065,182 @@ issue_pio_command (struct channel *c, uint8_t command)
   outb (reg_command (c), command);
 }
 
-/* Reads a sector from channel C's data register in PIO mode into
-   SECTOR, which must have room for DISK_SECTOR_SIZE bytes. */
+/* Reads CNT sectors from channel C's data register in PIO mode
+   into SECTORS, which must have room for CNT * DISK_SECTOR_SIZE
+   bytes. */
 static void
-input_sector (struct channel *c, void *sector) 
+input_sectors (struct channel *c, void *sectors, size_t cnt) 
 {
-  insw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+  insw (reg_data (c), sectors, cnt * DISK_SECTOR_SIZE / 2);
 }
 
-/* Writes SECTOR to channel C's data register in PIO mode.
-   SECTOR must contain DISK_SECTOR_SIZE bytes. */
+/* Writes CNT sectors from SECTORS to channel C's data register in
+   PIO mode.  SECTORS must contain CNT * DISK_SECTOR_SIZE bytes. */
 static void
-output_sector (struct channel *c, const void *sector) 
+output_sectors (struct channel *c, const void *sectors, size_t cnt) 
 {
-  outsw (reg_data (c), sector, DISK_SECTOR_SIZE / 2);
+  outsw (reg_data (c), sectors, cnt * DISK_SECTOR_SIZE / 2);
 }
 
+/* Iterates over the sectors of the buffers of a list of
+   requests, in order. */
+struct sector_iter
+  {
+    struct list_elem *e;        /* Current request. */
+    size_t idx;                 /* Sector within current request. */
+  };
+
+/* Returns the address of the next sector in ITER and advances. */
+static uint8_t *
+next_sector (struct sector_iter *iter) 
+{
+  struct disk_request *r = list_entry (iter->e, struct disk_request, elem);
+  uint8_t *sector = (uint8_t *) r->buffer + iter->idx * DISK_SECTOR_SIZE;
+
+  if (++iter->idx >= r->cnt)
+    {
+      iter->e = list_next (iter->e);
+      iter->idx = 0;
+    }
+  return sector;
+}
+
+/* Transfers the CNT sectors starting at SEC_NO from disk D into
+   the buffers of the requests in REQS by PIO. */
+static void
+pio_read (struct disk *d, disk_sector_t sec_no, size_t cnt,
+          struct list *reqs) 
+{
+  struct channel *c = d->channel;
+  struct sector_iter iter;
+  size_t i, j;
+
+  iter.e = list_begin (reqs);
+  iter.idx = 0;
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, (d->multiple_cnt > 0
+                         ? CMD_READ_MULTIPLE : CMD_READ_SECTOR_RETRY));
+  for (i = 0; i < cnt; i += block_size (d))
+    {
+      size_t block_cnt = cnt - i;
+      if (block_cnt > block_size (d))
+        block_cnt = block_size (d);
+
+      if (!wait_for_interrupt (c) || !wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no + i);
+      for (j = 0; j < block_cnt; j++)
+        input_sectors (c, next_sector (&iter), 1);
+    }
+}
+
+/* Transfers the CNT sectors in the buffers of the requests in
+   REQS to disk D starting at SEC_NO by PIO. */
+static void
+pio_write (struct disk *d, disk_sector_t sec_no, size_t cnt,
+           struct list *reqs) 
+{
+  struct channel *c = d->channel;
+  struct sector_iter iter;
+  size_t i, j;
+
+  iter.e = list_begin (reqs);
+  iter.idx = 0;
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, (d->multiple_cnt > 0
+                         ? CMD_WRITE_MULTIPLE : CMD_WRITE_SECTOR_RETRY));
+  for (i = 0; i < cnt; i += block_size (d))
+    {
+      size_t block_cnt = cnt - i;
+      if (block_cnt > block_size (d))
+        block_cnt = block_size (d);
+
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no + i);
+      for (j = 0; j < block_cnt; j++)
+        output_sectors (c, next_sector (&iter), 1);
+      if (!wait_for_interrupt (c))
+        PANIC ("%s: disk write timed out, sector=%"PRDSNu,
+               d->name, sec_no + i);
+    }
+}
+
+/* Returns true if data for disk D can be transferred to or from
+   the buffers of the requests in REQS by DMA.  The buffers must
+   be in kernel memory, so that their physical addresses are
+   known, and word aligned. */
+static bool
+use_dma (const struct disk *d, struct list *reqs) 
+{
+  struct list_elem *e;
+
+  if (!d->dma)
+    return false;
+  for (e = list_begin (reqs); e != list_end (reqs); e = list_next (e))
+    {
+      const void *buffer = list_entry (e, struct disk_request, elem)->buffer;
+      if (!is_kernel_vaddr (buffer) || ((uintptr_t) buffer & 1) != 0)
+        return false;
+    }
+  return true;
+}
+
+/* Transfers the CNT sectors starting at SEC_NO between disk D and
+   the buffers of the requests in REQS by bus master DMA, from the
+   disk to memory if WRITE is false, the other way if it is true.
+   The CPU is free to run other threads while the data moves. */
+static void
+dma_transfer (struct disk *d, disk_sector_t sec_no, size_t cnt,
+              struct list *reqs, bool write) 
+{
+  struct channel *c = d->channel;
+  uint8_t direction = write ? 0 : BM_CMD_READ;
+  struct prd *prd = c->prd;
+  struct list_elem *e;
+  uint8_t bm_status;
+
+  /* Describe each buffer, splitting it at 64 kB boundaries. */
+  for (e = list_begin (reqs); e != list_end (reqs); e = list_next (e))
+    {
+      struct disk_request *r = list_entry (e, struct disk_request, elem);
+      uintptr_t addr = vtop (r->buffer);
+      size_t size = r->cnt * DISK_SECTOR_SIZE;
+
+      while (size > 0) 
+        {
+          size_t chunk = 0x10000 - (addr & 0xffff);
+          if (chunk > size)
+            chunk = size;
+          prd->addr = addr;
+          prd->size = chunk & 0xffff;
+          prd->flags = 0;
+          prd++;
+          addr += chunk;
+          size -= chunk;
+        }
+    }
+  prd[-1].flags = PRD_EOT;
+
+  /* Program the bus master, then the disk, then start. */
+  outl (reg_bm_prd (c), vtop (c->prd));
+  outb (reg_bm_command (c), direction);
+  outb (reg_bm_status (c),
+        inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_INTR);
+  select_sector (d, sec_no, cnt);
+  issue_pio_command (c, write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), direction | BM_CMD_START);
+  if (!wait_for_interrupt (c))
+    PANIC ("%s: disk %s timed out, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", sec_no);
+
+  /* Stop the bus master and check for errors. */
+  outb (reg_bm_command (c), direction);
+  bm_status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), bm_status | BM_STA_ERR | BM_STA_INTR);
+  if ((bm_status & BM_STA_ERR) || (inb (reg_alt_status (c)) & STA_ERR))
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu,
+           d->name, write ? "write" : "read", sec_no);
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -523,6 +1290,37 @@ wait_while_busy (const struct disk *d)
   return false;
 }
 
+/* Timer callback for wait_for_interrupt(): gives up on the
+   interrupt that channel C_ is waiting for. */
+static void
+interrupt_timeout (void *c_) 
+{
+  struct channel *c = c_;
+
+  /* The interrupt beat us, but its waiter has not run yet. */
+  if (c->completion_wait.value > 0)
+    return;
+  c->expecting_interrupt = false;
+  c->timed_out = true;
+  sema_up (&c->completion_wait);
+}
+
+/* Waits for the completion interrupt of the command issued on
+   channel C, blocking on a timer rather than polling.  Returns
+   true if it arrived, false if it did not within 30 seconds, the
+   longest the ATA standards allow a disk to stay busy. */
+static bool
+wait_for_interrupt (struct channel *c) 
+{
+  c->timed_out = false;
+  timer_add (&c->timeout, 30 * TIMER_FREQ, interrupt_timeout, c);
+  sema_down (&c->completion_wait);
+  timer_cancel (&c->timeout);
+  if (c->timed_out)
+    printf ("%s: interrupt timeout\n", c->name);
+  return !c->timed_out;
+}
+
 /* Program D's channel so that D is now the selected disk. */
 static void
 select_device (const struct disk *d)
@@ -1,8 +1,13 @@
 #ifndef DEVICES_DISK_H
 #define DEVICES_DISK_H
 
+#include <disk-stats.h>
 #include <inttypes.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
+#include "threads/synch.h"
 
 /* Size of a disk sector in bytes. */
 #define DISK_SECTOR_SIZE 512
@@ -15,12 +20,69 @@ typedef uint32_t disk_sector_t;
    printf ("sector=%"PRDSNu"\n", sector); */
 #define PRDSNu PRIu32
 
+/* Maximum number of sectors in one disk request. */
+#define DISK_TRANSFER_MAX 256
+
+struct disk;
+struct disk_request;
+
+/* I/O classes.  A disk serves pending requests of a higher class
+   (lower number) before those of a lower one, except that a
+   request waiting longer than its class's deadline goes first.
+   A thread's requests get the class set with disk_set_io_class(),
+   or by default one that follows its priority: DISK_IO_RT above
+   PRI_DEFAULT, DISK_IO_IDLE below it, DISK_IO_BE otherwise. */
+enum disk_io_class
+  {
+    DISK_IO_AUTO,               /* Follow the thread's priority. */
+    DISK_IO_RT,                 /* Real-time. */
+    DISK_IO_BE,                 /* Best-effort. */
+    DISK_IO_IDLE,               /* Background. */
+    DISK_IO_CLASS_CNT
+  };
+
+/* Called when disk request R completes, with the AUX given to
+   disk_request_init().  Runs in the disk's I/O thread, so it
+   must be quick and must not wait for another disk request. */
+typedef void disk_request_func (struct disk_request *r, void *aux);
+
+/* A request to transfer a run of consecutive sectors between a
+   disk and memory.  Initialize with disk_request_init(), start
+   with disk_submit().  The request and its buffer must stay
+   valid until it completes. */
+struct disk_request
+  {
+    struct list_elem elem;      /* Element in channel's queue. */
+    struct list_elem fifo_elem; /* Element in channel's FIFO. */
+    enum disk_io_class io_class; /* Class, set by disk_submit(). */
+    int64_t deadline;           /* Tick by which to serve it. */
+    struct disk *disk;          /* Disk to transfer to or from. */
+    disk_sector_t sector;       /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+    void *buffer;               /* CNT * DISK_SECTOR_SIZE bytes. */
+    bool write;                 /* True to write, false to read. */
+    disk_request_func *complete; /* Completion callback, or null. */
+    void *aux;                  /* Passed to COMPLETE. */
+    struct semaphore done;      /* Up'd on completion if no COMPLETE. */
+  };
+
 void disk_init (void);
 void disk_print_stats (void);
+void disk_get_stats (struct disk *, struct disk_stats *);
 
 struct disk *disk_get (int chan_no, int dev_no);
 disk_sector_t disk_size (struct disk *);
 void disk_read (struct disk *, disk_sector_t, void *);
 void disk_write (struct disk *, disk_sector_t, const void *);
+void disk_read_multiple (struct disk *, disk_sector_t, size_t, void *);
+void disk_write_multiple (struct disk *, disk_sector_t, size_t, const void *);
+
+void disk_request_init (struct disk_request *, struct disk *,
+                        disk_sector_t, size_t cnt, void *buffer,
+                        bool write, disk_request_func *, void *aux);
+void disk_submit (struct disk_request *);
+void disk_wait (struct disk_request *);
+
+void disk_set_io_class (enum disk_io_class);
 
 #endif /* devices/disk.h */
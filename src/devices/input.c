@@ -2,15 +2,43 @@
 #include <debug.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
+#include "threads/pollwait.h"
+#include "threads/synch.h"
 
-/* Stores keys from the keyboard and serial port. */
+/* Input buffer size, in bytes.  Large enough to hold a pasted
+   line or two while no one is reading. */
+#define INPUT_BUFSIZE 256
+
+/* Stores keys from the keyboard and serial port.  The keyboard
+   and serial interrupt handlers are the producers; they never
+   run at the same time.  Readers are serialized by READER_LOCK. */
+static uint8_t buffer_data[INPUT_BUFSIZE];
 static struct intq buffer;
+static struct lock reader_lock;
+
+/* Called from interrupt context when INPUT_DUMP_KEY arrives,
+   instead of storing the key, if set by input_set_dump(). */
+static void (*dump_func) (void);
+
+/* Set by input_putc() when it fills the buffer, after which the
+   serial port stops receiving until serial_notify() is called. */
+static volatile bool was_full;
 
 /* Initializes the input buffer. */
 void
 input_init (void) 
 {
-  intq_init (&buffer);
+  intq_init (&buffer, buffer_data, sizeof buffer_data);
+  lock_init (&reader_lock);
+}
+
+/* Arranges for FUNC to be called, in interrupt context, each time
+   INPUT_DUMP_KEY is typed on the keyboard or serial port.  The key
+   then never reaches the input buffer. */
+void
+input_set_dump (void (*func) (void)) 
+{
+  dump_func = func;
 }
 
 /* Adds a key to the input buffer.
@@ -21,8 +49,30 @@ input_putc (uint8_t key)
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (!intq_full (&buffer));
 
+  if (key == INPUT_DUMP_KEY && dump_func != NULL)
+    {
+      dump_func ();
+      return;
+    }
+
   intq_putc (&buffer, key);
-  serial_notify ();
+  if (intq_full (&buffer))
+    was_full = true;
+  poll_notify ();
+}
+
+/* Called after keys are removed from the buffer.  If it had
+   filled up, lets the serial port receive again. */
+static void
+notify_not_full (void) 
+{
+  if (was_full)
+    {
+      enum intr_level old_level = intr_disable ();
+      was_full = false;
+      serial_notify ();
+      intr_set_level (old_level);
+    }
 }
 
 /* Retrieves a key from the input buffer.
@@ -30,23 +80,41 @@ input_putc (uint8_t key)
 uint8_t
 input_getc (void) 
 {
-  enum intr_level old_level;
   uint8_t key;
 
-  old_level = intr_disable ();
-  key = intq_getc (&buffer);
-  serial_notify ();
-  intr_set_level (old_level);
-  
+  input_read (&key, 1);
   return key;
 }
 
+/* Retrieves up to SIZE keys from the input buffer into BUF.  Waits
+   for the first key if the buffer is empty, then takes only what
+   is already there.  Returns the number of keys stored, which is
+   nonzero if SIZE is. */
+size_t
+input_read (uint8_t *buf, size_t size)
+{
+  size_t n;
+
+  lock_acquire (&reader_lock);
+  n = intq_get_many (&buffer, buf, size);
+  notify_not_full ();
+  lock_release (&reader_lock);
+
+  return n;
+}
+
+/* Returns true if the input buffer is empty,
+   false otherwise. */
+bool
+input_empty (void) 
+{
+  return intq_empty (&buffer);
+}
+
 /* Returns true if the input buffer is full,
-   false otherwise.
-   Interrupts must be off. */
+   false otherwise. */
 bool
 input_full (void) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
   return intq_full (&buffer);
 }
@@ -2,11 +2,19 @@
 #define DEVICES_INPUT_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Key that requests a status dump instead of being input:
+   Ctrl+T, as on BSD. */
+#define INPUT_DUMP_KEY 0x14
+
 void input_init (void);
+void input_set_dump (void (*) (void));
 void input_putc (uint8_t);
 uint8_t input_getc (void);
+size_t input_read (uint8_t *, size_t);
+bool input_empty (void);
 bool input_full (void);
 
 #endif /* devices/input.h */
@@ -2,16 +2,19 @@
 #include <debug.h>
 #include "threads/thread.h"
 
-static int next (int pos);
 static void wait (struct intq *q, struct thread **waiter);
 static void signal (struct intq *q, struct thread **waiter);
 
-/* Initializes interrupt queue Q. */
+/* Initializes interrupt queue Q to use the SIZE bytes in BUF,
+   where SIZE is a power of 2.  The queue holds up to SIZE bytes. */
 void
-intq_init (struct intq *q) 
+intq_init (struct intq *q, uint8_t *buf, size_t size) 
 {
-  lock_init (&q->lock);
+  ASSERT (size > 0 && (size & (size - 1)) == 0);
+
   q->not_full = q->not_empty = NULL;
+  q->buf = buf;
+  q->size = size;
   q->head = q->tail = 0;
 }
 
@@ -19,7 +22,6 @@ intq_init (struct intq *q)
 bool
 intq_empty (const struct intq *q) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
   return q->head == q->tail;
 }
 
@@ -27,8 +29,7 @@ intq_empty (const struct intq *q)
 bool
 intq_full (const struct intq *q) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  return next (q->head) == q->tail;
+  return q->head - q->tail == q->size;
 }
 
 /* Removes a byte from Q and returns it.
@@ -39,19 +40,8 @@ uint8_t
 intq_getc (struct intq *q) 
 {
   uint8_t byte;
-  
-  ASSERT (intr_get_level () == INTR_OFF);
-  while (intq_empty (q)) 
-    {
-      ASSERT (!intr_context ());
-      lock_acquire (&q->lock);
-      wait (q, &q->not_empty);
-      lock_release (&q->lock);
-    }
-  
-  byte = q->buf[q->tail];
-  q->tail = next (q->tail);
-  signal (q, &q->not_full);
+
+  intq_get_many (q, &byte, 1);
   return byte;
 }
 
@@ -62,29 +52,84 @@ intq_getc (struct intq *q)
 void
 intq_putc (struct intq *q, uint8_t byte) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  while (intq_full (q))
+  intq_put_many (q, &byte, 1);
+}
+
+/* Removes up to CNT bytes from Q into BUF and returns the number
+   removed.  If Q is empty and CNT is nonzero, first sleeps until
+   a byte is added; Q must not be empty if called from an
+   interrupt handler.  Otherwise takes only what is already
+   there. */
+size_t
+intq_get_many (struct intq *q, uint8_t *buf, size_t cnt) 
+{
+  size_t avail, i;
+
+  if (cnt == 0)
+    return 0;
+  while (intq_empty (q))
     {
+      enum intr_level old_level;
+
       ASSERT (!intr_context ());
-      lock_acquire (&q->lock);
-      wait (q, &q->not_full);
-      lock_release (&q->lock);
+      old_level = intr_disable ();
+      if (intq_empty (q))
+        wait (q, &q->not_empty);
+      intr_set_level (old_level);
     }
 
-  q->buf[q->head] = byte;
-  q->head = next (q->head);
-  signal (q, &q->not_empty);
+  avail = q->head - q->tail;
+  if (cnt > avail)
+    cnt = avail;
+  barrier ();                   /* Read HEAD before the data. */
+  for (i = 0; i < cnt; i++)
+    buf[i] = q->buf[(q->tail + i) & (q->size - 1)];
+  barrier ();                   /* Read the data before freeing it. */
+  q->tail += cnt;
+
+  signal (q, &q->not_full);
+  return cnt;
 }
-
-/* Returns the position after POS within an intq. */
-static int
-next (int pos) 
+
+/* Adds the CNT bytes in BUF to the end of Q.  Whenever Q is full,
+   sleeps until bytes are removed; Q must have room for all CNT
+   bytes if called from an interrupt handler. */
+void
+intq_put_many (struct intq *q, const uint8_t *buf, size_t cnt) 
 {
-  return (pos + 1) % INTQ_BUFSIZE;
+  while (cnt > 0)
+    {
+      size_t room, i;
+
+      while (intq_full (q))
+        {
+          enum intr_level old_level;
+
+          ASSERT (!intr_context ());
+          old_level = intr_disable ();
+          if (intq_full (q))
+            wait (q, &q->not_full);
+          intr_set_level (old_level);
+        }
+
+      room = q->size - (q->head - q->tail);
+      if (room > cnt)
+        room = cnt;
+      for (i = 0; i < room; i++)
+        q->buf[(q->head + i) & (q->size - 1)] = buf[i];
+      barrier ();               /* Write the data before publishing it. */
+      q->head += room;
+      buf += room;
+      cnt -= room;
+
+      signal (q, &q->not_empty);
+    }
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
-   member.  Waits until the given condition is true. */
+   member.  Waits until the given condition is true.  Interrupts
+   must be off, so the other side cannot slip in between the
+   caller's last check and the thread going to sleep. */
 static void
 wait (struct intq *q UNUSED, struct thread **waiter) 
 {
@@ -92,6 +137,7 @@ wait (struct intq *q UNUSED, struct thread **waiter)
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT ((waiter == &q->not_empty && intq_empty (q))
           || (waiter == &q->not_full && intq_full (q)));
+  ASSERT (*waiter == NULL);
 
   *waiter = thread_current ();
   thread_block ();
@@ -100,17 +146,19 @@ wait (struct intq *q UNUSED, struct thread **waiter)
 /* WAITER must be the address of Q's not_empty or not_full
    member, and the associated condition must be true.  If a
    thread is waiting for the condition, wakes it up and resets
-   the waiting thread. */
+   the waiting thread.  Only disables interrupts if there may be
+   a waiter. */
 static void
 signal (struct intq *q UNUSED, struct thread **waiter) 
 {
-  ASSERT (intr_get_level () == INTR_OFF);
-  ASSERT ((waiter == &q->not_empty && !intq_empty (q))
-          || (waiter == &q->not_full && !intq_full (q)));
-
-  if (*waiter != NULL) 
+  if (*(struct thread *volatile *) waiter != NULL) 
     {
-      thread_unblock (*waiter);
-      *waiter = NULL;
+      enum intr_level old_level = intr_disable ();
+      if (*waiter != NULL)
+        {
+          thread_unblock (*waiter);
+          *waiter = NULL;
+        }
+      intr_set_level (old_level);
     }
 }
@@ -1,43 +1,52 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
 /* An "interrupt queue", a circular buffer shared between
    kernel threads and external interrupt handlers.
 
-   Interrupt queue functions can be called from kernel threads or
-   from external interrupt handlers.  Except for intq_init(),
-   interrupts must be off in either case.
-
-   The interrupt queue has the structure of a "monitor".  Locks
-   and condition variables from threads/synch.h cannot be used in
-   this case, as they normally would, because they can only
-   protect kernel threads from one another, not from interrupt
-   handlers. */
-
-/* Queue buffer size, in bytes. */
+   Each queue has a single producer and a single consumer, each of
+   which may be a kernel thread or an external interrupt handler.
+   Callers on the same side must not run concurrently; if more
+   than one thread consumes, say, they need a lock of their own.
+   Because the producer only ever writes HEAD and the consumer
+   only TAIL, neither needs interrupts off to move data.
+   Interrupts are only disabled on the slow path, to sleep on an
+   empty or full queue or to wake a thread sleeping on one.
+
+   Locks and condition variables from threads/synch.h cannot be
+   used to wait here, as they normally would, because they can
+   only protect kernel threads from one another, not from
+   interrupt handlers. */
+
+/* Default queue buffer size, in bytes. */
 #define INTQ_BUFSIZE 64
 
 /* A circular queue of bytes. */
 struct intq
   {
     /* Waiting threads. */
-    struct lock lock;           /* Only one thread may wait at once. */
     struct thread *not_full;    /* Thread waiting for not-full condition. */
     struct thread *not_empty;   /* Thread waiting for not-empty condition. */
 
     /* Queue. */
-    uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
-    int head;                   /* New data is written here. */
-    int tail;                   /* Old data is read here. */
+    uint8_t *buf;               /* Buffer. */
+    size_t size;                /* Buffer size, a power of 2. */
+    volatile size_t head;       /* Bytes ever added, by the producer. */
+    volatile size_t tail;       /* Bytes ever removed, by the consumer. */
   };
 
-void intq_init (struct intq *);
+void intq_init (struct intq *, uint8_t *buf, size_t size);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
 void intq_putc (struct intq *, uint8_t);
+size_t intq_get_many (struct intq *, uint8_t *, size_t);
+void intq_put_many (struct intq *, const uint8_t *, size_t);
 
 #endif /* devices/intq.h */
@@ -1,6 +1,7 @@
 #include "devices/kbd.h"
 #include <ctype.h>
 #include <debug.h>
+#include <stats.h>
 #include <stdio.h>
 #include <string.h>
 #include "devices/input.h"
@@ -23,12 +24,23 @@ static bool caps_lock;
 /* Number of keys pressed. */
 static int64_t key_cnt;
 
+/* Scancodes read by the interrupt handler, waiting for
+   keyboard_bottom() to turn them into characters.  Scancodes
+   that arrive while it is full are dropped, as are characters
+   that arrive while the input buffer is full. */
+#define SCANCODE_CNT 16
+static unsigned scancodes[SCANCODE_CNT];
+static unsigned scancode_head, scancode_tail;
+
 static intr_handler_func keyboard_interrupt;
+static struct intr_bottom keyboard_bottom_half;
+static intr_bottom_func keyboard_bottom;
 
 /* Initializes the keyboard. */
 void
 kbd_init (void) 
 {
+  intr_bottom_init (&keyboard_bottom_half, keyboard_bottom, NULL);
   intr_register_ext (0x21, keyboard_interrupt, "8042 Keyboard");
 }
 
@@ -38,6 +50,13 @@ kbd_print_stats (void)
 {
   printf ("Keyboard: %lld keys pressed\n", key_cnt);
 }
+
+/* Fills in the keyboard fields of *S. */
+void
+kbd_get_stats (struct stats *s) 
+{
+  s->key_cnt = key_cnt;
+}
 
 /* Maps a set of contiguous scancodes into characters. */
 struct keymap
@@ -90,28 +109,38 @@ static const struct keymap shifted_keymap[] =
 
 static bool map_key (const struct keymap[], unsigned scancode, uint8_t *);
 
+/* Keyboard interrupt handler: reads the scancode, so that the
+   controller can send the next one, and leaves the rest to
+   keyboard_bottom(). */
 static void
 keyboard_interrupt (struct intr_frame *args UNUSED) 
+{
+  /* Read scancode, including second byte if prefix code. */
+  unsigned code = inb (DATA_REG);
+  if (code == 0xe0)
+    code = (code << 8) | inb (DATA_REG);
+
+  if (scancode_head - scancode_tail < SCANCODE_CNT)
+    scancodes[scancode_head++ % SCANCODE_CNT] = code;
+  intr_schedule_bottom (&keyboard_bottom_half);
+}
+
+/* Interprets scancode CODE, updating the shift state and adding
+   the character for a key press, if any, to the input buffer. */
+static void
+interpret_scancode (unsigned code) 
 {
   /* Status of shift keys. */
   bool shift = left_shift || right_shift;
   bool alt = left_alt || right_alt;
   bool ctrl = left_ctrl || right_ctrl;
 
-  /* Keyboard scancode. */
-  unsigned code;
-
   /* False if key pressed, true if key released. */
   bool release;
 
   /* Character that corresponds to `code'. */
   uint8_t c;
 
-  /* Read scancode, including second byte if prefix code. */
-  code = inb (DATA_REG);
-  if (code == 0xe0)
-    code = (code << 8) | inb (DATA_REG);
-
   /* Bit 0x80 distinguishes key press from key release
      (even if there's a prefix). */
   release = (code & 0x80) != 0;
@@ -148,11 +177,15 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
             c += 0x80;
 
           /* Append to keyboard buffer. */
-          if (!input_full ())
-            {
-              key_cnt++;
-              input_putc (c);
-            }
+          {
+            enum intr_level old_level = intr_disable ();
+            if (!input_full ())
+              {
+                key_cnt++;
+                input_putc (c);
+              }
+            intr_set_level (old_level);
+          }
         }
     }
   else
@@ -188,6 +221,26 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
     }
 }
 
+/* Bottom half of the keyboard interrupt: interprets the
+   scancodes the handler has read. */
+static void
+keyboard_bottom (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      enum intr_level old_level = intr_disable ();
+      bool empty = scancode_tail == scancode_head;
+      unsigned code = scancodes[scancode_tail % SCANCODE_CNT];
+
+      if (!empty)
+        scancode_tail++;
+      intr_set_level (old_level);
+      if (empty)
+        break;
+      interpret_scancode (code);
+    }
+}
+
 /* Scans the array of keymaps K for SCANCODE.
    If found, sets *C to the corresponding character and returns
    true.
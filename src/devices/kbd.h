@@ -3,7 +3,10 @@
 
 #include <stdint.h>
 
+struct stats;
+
 void kbd_init (void);
 void kbd_print_stats (void);
+void kbd_get_stats (struct stats *);
 
 #endif /* devices/kbd.h */
@@ -1,7 +1,6 @@
 #include "devices/serial.h"
 #include <debug.h>
 #include "devices/input.h"
-#include "devices/intq.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
@@ -33,6 +32,13 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR 0x06          /* Clear both FIFOs. */
+
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* FIFOs are enabled and working. */
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -51,11 +57,32 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
-/* Data to be transmitted. */
-static struct intq txq;
+/* Size of the transmit FIFO on a 16550A. */
+#define FIFO_SIZE 16
+
+/* Bytes the UART can take once THR is empty: FIFO_SIZE if the
+   FIFO works, 1 on an older UART without one. */
+static int fifo_size = 1;
+
+/* Bytes that can still be written to THR before LSR_THRE must
+   be checked again. */
+static int tx_room;
+
+/* Transmit buffer size in bytes.  Must be a power of 2. */
+#define TXQ_SIZE 1024
+
+/* Data to be transmitted, a ring buffer.  TX_HEAD and TX_TAIL
+   count the bytes ever added and removed, so TX_HEAD - TX_TAIL is
+   the number queued.  Interrupts must be off to touch these. */
+static uint8_t txq[TXQ_SIZE];
+static unsigned tx_head, tx_tail;
+static struct lock tx_lock;         /* Only one thread may wait at once. */
+static struct thread *tx_waiter;    /* Thread waiting for room in TXQ. */
 
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
+static void tx_fill (void);
+static void tx_wait (void);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
 
@@ -68,10 +95,11 @@ init_poll (void)
 {
   ASSERT (mode == UNINIT);
   outb (IER_REG, 0);                    /* Turn off all interrupts. */
-  outb (FCR_REG, 0);                    /* Disable FIFO. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR); /* Enable and reset FIFOs. */
+  if ((inb (IIR_REG) & IIR_FIFO) == IIR_FIFO)
+    fifo_size = FIFO_SIZE;
   set_serial (115200);                  /* 115.2 kbps, N-8-1. */
   outb (MCR_REG, MCR_OUT2);             /* Required to enable interrupts. */
-  intq_init (&txq);
   mode = POLL;
 } 
 
@@ -87,6 +115,7 @@ serial_init_queue (void)
     init_poll ();
   ASSERT (mode == POLL);
 
+  lock_init (&tx_lock);
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
   mode = QUEUE;
   old_level = intr_disable ();
@@ -97,32 +126,58 @@ serial_init_queue (void)
 /* Sends BYTE to the serial port. */
 void
 serial_putc (uint8_t byte) 
+{
+  serial_putbuf (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.  In queued mode
+   the bytes are added to the transmit buffer as a block and sent
+   a FIFO's worth at a time; the caller only waits if the buffer
+   fills up. */
+void
+serial_putbuf (const uint8_t *buffer, size_t n) 
 {
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (n-- > 0)
+        putc_poll (*buffer++);
     }
   else 
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      while (n > 0)
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          if (tx_head - tx_tail == TXQ_SIZE)
+            {
+              if (old_level == INTR_OFF)
+                {
+                  /* Interrupts are off and the transmit buffer
+                     is full.  If we wanted to wait for it to
+                     drain, we'd have to reenable interrupts.
+                     That's impolite, so we'll send a FIFO's
+                     worth via polling instead. */
+                  while ((inb (LSR_REG) & LSR_THRE) == 0)
+                    continue;
+                  tx_fill ();
+                }
+              else
+                tx_wait ();
+              continue;
+            }
+
+          do
+            txq[tx_head++ % TXQ_SIZE] = *buffer++;
+          while (--n > 0 && tx_head - tx_tail < TXQ_SIZE);
         }
 
-      intq_putc (&txq, byte); 
+      /* Start transmitting right away if the UART is idle, rather
+         than waiting for the transmit interrupt. */
+      tx_fill ();
       write_ier ();
     }
   
@@ -135,8 +190,8 @@ void
 serial_flush (void) 
 {
   enum intr_level old_level = intr_disable ();
-  while (!intq_empty (&txq))
-    putc_poll (intq_getc (&txq));
+  while (tx_head != tx_tail)
+    putc_poll (txq[tx_tail++ % TXQ_SIZE]);
   intr_set_level (old_level);
 }
 
@@ -182,7 +237,7 @@ write_ier (void)
 
   /* Enable transmit interrupt if we have any characters to
      transmit. */
-  if (!intq_empty (&txq))
+  if (tx_head != tx_tail)
     ier |= IER_XMIT;
 
   /* Enable receive interrupt if we have room to store any
@@ -194,15 +249,63 @@ write_ier (void)
 }
 
 /* Polls the serial port until it's ready,
-   and then transmits BYTE. */
+   and then transmits BYTE.  Waits only when the FIFO may be
+   full, so bursts go out at line rate. */
 static void
 putc_poll (uint8_t byte) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
 
-  while ((inb (LSR_REG) & LSR_THRE) == 0)
-    continue;
+  if (tx_room == 0)
+    {
+      while ((inb (LSR_REG) & LSR_THRE) == 0)
+        continue;
+      tx_room = fifo_size;
+    }
   outb (THR_REG, byte);
+  tx_room--;
+}
+
+/* Moves as many bytes from the transmit buffer into the UART as
+   it will take without waiting. */
+static void
+tx_fill (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if ((inb (LSR_REG) & LSR_THRE) != 0)
+    tx_room = fifo_size;
+  while (tx_room > 0 && tx_head != tx_tail)
+    {
+      outb (THR_REG, txq[tx_tail++ % TXQ_SIZE]);
+      tx_room--;
+    }
+
+  /* Wake the thread waiting for room, if we made some. */
+  if (tx_waiter != NULL && tx_head - tx_tail < TXQ_SIZE)
+    {
+      thread_unblock (tx_waiter);
+      tx_waiter = NULL;
+    }
+}
+
+/* Waits for the serial interrupt to make room in the transmit
+   buffer.  Interrupts must be off on entry, but must have been on
+   in the caller. */
+static void
+tx_wait (void) 
+{
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock_acquire (&tx_lock);
+  if (tx_head - tx_tail == TXQ_SIZE)
+    {
+      write_ier ();
+      tx_waiter = thread_current ();
+      thread_block ();
+    }
+  lock_release (&tx_lock);
 }
 
 /* Serial interrupt handler. */
@@ -218,10 +321,8 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* Refill the transmit FIFO. */
+  tx_fill ();
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -1,60 +1,184 @@
 #include "devices/timer.h"
 #include <debug.h>
+#include <div64.h>
 #include <inttypes.h>
+#include <kinfo.h>
+#include <list.h>
 #include <round.h>
 #include <stdio.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/prof.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/tunable.h"
   
 /* See [8254] for hardware details of the 8254 timer chip. */
 
-#if TIMER_FREQ < 19
-#error 8254 timer requires TIMER_FREQ >= 19
-#endif
-#if TIMER_FREQ > 1000
-#error TIMER_FREQ <= 1000 recommended
-#endif
+int timer_freq = TIMER_FREQ_DEFAULT;
+
+/* 8254 input frequency, and the counter value for one tick,
+   rounded to nearest. */
+#define PIT_HZ 1193180
+#define PIT_TICK_COUNT ((unsigned) (PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+
+/* Most ticks one PIT period can span, given its 16-bit counter. */
+#define STRIDE_MAX (65535 / PIT_TICK_COUNT)
 
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
-/* Number of loops per timer tick.
-   Initialized by timer_calibrate(). */
+/* Number of ticks each timer interrupt stands for.  Normally 1,
+   but up to STRIDE_MAX while the idle thread has stretched the
+   PIT period with timer_idle_enter(). */
+static unsigned tick_stride = 1;
+
+/* Pending timers live in a hierarchical timer wheel with
+   WHEEL_LEVELS levels of WHEEL_SLOTS slots each.  Level L holds
+   the timers due between WHEEL_SLOTS**L and WHEEL_SLOTS**(L+1)
+   ticks after wheel_tick, in the slot selected by digit L of
+   their expiry tick, so level 0 has one slot per tick.  Each time
+   the level-0 index wraps around, the next level-1 slot is
+   cascaded down into the levels below, and so on up.  Adding or
+   canceling a timer is O(1), and a tick only visits one slot plus
+   the occasional cascade however many timers are pending.
+   Accessed by timer_interrupt(), so interrupts must be off to
+   touch it. */
+#define WHEEL_BITS 6
+#define WHEEL_SLOTS (1 << WHEEL_BITS)
+#define WHEEL_LEVELS 4
+#define WHEEL_RANGE ((int64_t) 1 << (WHEEL_BITS * WHEEL_LEVELS))
+static struct list wheel[WHEEL_LEVELS][WHEEL_SLOTS];
+
+/* Next tick whose level-0 slot the wheel will run. */
+static int64_t wheel_tick;
+
+/* Number of loops per timer tick.  Calibrated by
+   timer_calibrate() only if there is no usable TSC. */
 static unsigned loops_per_tick;
 
+/* Time stamp counter rate, in counts per second, measured
+   against the PIT by timer_calibrate(), and the count when
+   timer_init() ran.  Until calibration, TSC_HZ is 0. */
+#define TSC_CALIBRATE_TICKS 4
+static uint64_t tsc_hz;
+static uint64_t tsc_boot;
+
+/* TSC rate given by timer_set_tsc_hz(), or 0. */
+static uint64_t tsc_preset;
+
+/* Nanoseconds per TSC cycle, in 32.32 fixed point, so that
+   timer_ns() multiplies instead of dividing by TSC_HZ. */
+static uint64_t tsc_ns_scale;
+
+/* Kernel information page given by timer_share(), or null.  Kept
+   up to date with the tick count and the TSC calibration. */
+static struct kinfo *kinfo;
+
 static intr_handler_func timer_interrupt;
+static void wheel_insert (struct timer *);
+static void wheel_run (void);
+static void wake_sleeper (void *);
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void pit_program (unsigned stride);
+static void kinfo_update (void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
-   interrupt PIT_FREQ times per second, and registers the
+   interrupt TIMER_FREQ times per second, and registers the
    corresponding interrupt. */
 void
 timer_init (void) 
 {
-  /* 8254 input frequency divided by TIMER_FREQ, rounded to
-     nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  int i, j;
 
+  tunable_register ("hz", &timer_freq, TIMER_FREQ_MIN, TIMER_FREQ_MAX);
+  tsc_boot = read_tsc ();
+  pit_program (1);
+  for (i = 0; i < WHEEL_LEVELS; i++)
+    for (j = 0; j < WHEEL_SLOTS; j++)
+      list_init (&wheel[i][j]);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
-/* Calibrates loops_per_tick, used to implement brief delays. */
+/* Sets the rate of the time stamp counter to HZ, a decimal
+   number of counts per second, so that timer_calibrate() does
+   not have to measure it.  Meant for -tsc=HZ, with HZ as printed
+   by an earlier boot on the same host and simulator settings.
+   Returns false if HZ is not a positive number. */
+bool
+timer_set_tsc_hz (const char *hz)
+{
+  uint64_t value = 0;
+
+  if (hz == NULL || *hz == '\0')
+    return false;
+  for (; *hz != '\0'; hz++)
+    {
+      if (*hz < '0' || *hz > '9' || value > (UINT64_MAX - 9) / 10)
+        return false;
+      value = value * 10 + (*hz - '0');
+    }
+  if (value == 0)
+    return false;
+  tsc_preset = value;
+  return true;
+}
+
+/* Sets TSC_HZ to HZ.  timer_ns() may run in an interrupt at any
+   time, so the scale is set before TSC_HZ announces it. */
+static void
+set_tsc_hz (uint64_t hz)
+{
+  enum intr_level old_level;
+
+  tsc_ns_scale = ((uint64_t) 1000 * 1000 * 1000 << 32) / hz;
+  barrier ();
+  tsc_hz = hz;
+
+  old_level = intr_disable ();
+  kinfo_update ();
+  intr_set_level (old_level);
+}
+
+/* Measures the rate of the time stamp counter, used by
+   timer_ns() and for brief delays, unless timer_set_tsc_hz()
+   already supplied it.  Only if the TSC does not count is
+   loops_per_tick calibrated for busy-wait delays instead, which
+   takes a few dozen ticks more. */
 void
 timer_calibrate (void) 
 {
   unsigned high_bit, test_bit;
+  uint64_t tsc_start, hz;
+  int64_t start;
 
   ASSERT (intr_get_level () == INTR_ON);
+  if (tsc_preset != 0)
+    {
+      set_tsc_hz (tsc_preset);
+      printf ("Timer: %'"PRIu64" TSC cycles/s (from -tsc).\n", tsc_hz);
+      return;
+    }
   printf ("Calibrating timer...  ");
 
+  /* Count TSC cycles across a few whole ticks. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  tsc_start = read_tsc ();
+  start = ticks;
+  while (ticks < start + TSC_CALIBRATE_TICKS)
+    barrier ();
+  hz = (read_tsc () - tsc_start) * TIMER_FREQ / TSC_CALIBRATE_TICKS;
+  if (hz != 0)
+    {
+      set_tsc_hz (hz);
+      printf ("%'"PRIu64" TSC cycles/s (-tsc=%"PRIu64").\n", hz, hz);
+      return;
+    }
+
   /* Approximate loops_per_tick as the largest power-of-two
      still less than one timer tick. */
   loops_per_tick = 1u << 10;
@@ -70,7 +194,8 @@ timer_calibrate (void)
     if (!too_many_loops (high_bit | test_bit))
       loops_per_tick |= test_bit;
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" loops/s, no TSC.\n",
+          (uint64_t) loops_per_tick * TIMER_FREQ);
 }
 
 /* Returns the number of timer ticks since the OS booted. */
@@ -92,15 +217,107 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
-/* Suspends execution for approximately TICKS timer ticks. */
+/* Returns the number of nanoseconds since timer_init(), with the
+   resolution of the time stamp counter once timer_calibrate()
+   has run, and of timer ticks before. */
+int64_t
+timer_ns (void) 
+{
+  uint64_t cycles;
+
+  if (tsc_hz == 0)
+    return timer_ticks () * (1000 * 1000 * 1000 / TIMER_FREQ);
+
+  /* Scale by the precomputed nanoseconds per cycle.  Rounding
+     the scale loses under one part in 10**9, far less than the
+     error of calibration, and the result stays monotonic. */
+  cycles = read_tsc () - tsc_boot;
+  return mul64_fix32 (cycles, tsc_ns_scale);
+}
+
+/* Has the timer keep K, the kernel information page that user
+   processes read, up to date from now on. */
+void
+timer_share (struct kinfo *k) 
+{
+  enum intr_level old_level = intr_disable ();
+  kinfo = k;
+  kinfo->version = KINFO_VERSION;
+  kinfo_update ();
+  intr_set_level (old_level);
+}
+
+/* Returns the rate of the time stamp counter in cycles per
+   second, or 0 if timer_calibrate() has not run yet. */
+uint64_t
+timer_tsc_hz (void) 
+{
+  return tsc_hz;
+}
+
+/* Arranges for FUNC to be called with AUX from the timer
+   interrupt TICKS timer ticks from now, using T to keep track of
+   it.  T must not be pending already.  May be called from an
+   interrupt handler. */
+void
+timer_add (struct timer *t, int64_t ticks, timer_func *func, void *aux) 
+{
+  enum intr_level old_level;
+
+  ASSERT (t != NULL);
+  ASSERT (func != NULL);
+
+  old_level = intr_disable ();
+  t->expires = timer_ticks () + (ticks > 0 ? ticks : 0);
+  t->func = func;
+  t->aux = aux;
+  t->pending = true;
+  wheel_insert (t);
+  intr_set_level (old_level);
+}
+
+/* Cancels timer T.  Returns true if T was pending, false if it
+   had already expired or been canceled, in which case its
+   callback may already have run. */
+bool
+timer_cancel (struct timer *t) 
+{
+  enum intr_level old_level = intr_disable ();
+  bool was_pending = t->pending;
+
+  if (was_pending) 
+    {
+      list_remove (&t->elem);
+      t->pending = false;
+    }
+  intr_set_level (old_level);
+  return was_pending;
+}
+
+/* Suspends execution for approximately TICKS timer ticks.  The
+   thread blocks until a timer wakes it, rather than competing
+   for the CPU while it waits. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct timer t;
+  struct semaphore wakeup;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield (); /* BUSY WAIT. Unacceptable. For you to fix. */
+  if (ticks <= 0)
+    return;
+
+  sema_init (&wakeup, 0);
+  timer_add (&t, ticks, wake_sleeper, &wakeup);
+  sema_down (&wakeup);
+}
+
+/* Timer callback for timer_sleep(): wakes up the sleeping
+   thread by upping semaphore WAKEUP. */
+static void
+wake_sleeper (void *wakeup) 
+{
+  sema_up (wakeup);
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -124,6 +341,64 @@ timer_nsleep (int64_t ns)
   real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  Stretches the PIT period so that the next timer
+   interrupt comes as late as possible without delaying a pending
+   timer, a wheel cascade, or more than STRIDE_MAX ticks.
+   Nothing needs the regular tick while the CPU is idle, so the
+   fewer interrupts the better.  Skipped under -mlfqs, whose
+   load average sampling needs every tick. */
+void
+timer_idle_enter (void) 
+{
+  unsigned stride;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Only stretch a fully caught-up wheel, whose level-0 slots
+     then hold exactly the timers due in the next WHEEL_SLOTS
+     ticks. */
+  if (thread_mlfqs || tick_stride != 1 || wheel_tick != ticks + 1)
+    return;
+
+  for (stride = 1; stride < STRIDE_MAX; stride++) 
+    {
+      int64_t tick = ticks + stride;
+      if (!list_empty (&wheel[0][tick & (WHEEL_SLOTS - 1)])
+          || (tick & (WHEEL_SLOTS - 1)) == 0)
+        break;
+    }
+  if (stride > 1)
+    {
+      tick_stride = stride;
+      pit_program (stride);
+    }
+}
+
+/* Called with interrupts off when the idle thread is about to be
+   switched out.  If the PIT period is still stretched, credits
+   the whole ticks that have passed in it and returns to one
+   interrupt per tick.  Timers that came due meanwhile run at
+   the next timer interrupt. */
+void
+timer_idle_exit (void) 
+{
+  unsigned remaining;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (tick_stride == 1)
+    return;
+
+  outb (0x43, 0x00);    /* CW: latch counter 0. */
+  remaining = inb (0x40);
+  remaining |= inb (0x40) << 8;
+  ticks += (tick_stride * PIT_TICK_COUNT - remaining) / PIT_TICK_COUNT;
+
+  tick_stride = 1;
+  pit_program (1);
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
@@ -133,10 +408,124 @@ timer_print_stats (void)
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
+{
+  unsigned i;
+
+  if (prof_enabled)
+    prof_sample (args, tick_stride);
+  for (i = 0; i < tick_stride; i++) 
+    {
+      ticks++;
+      while (wheel_tick <= ticks)
+        wheel_run ();
+      thread_tick ();
+    }
+  kinfo_update ();
+
+  if (tick_stride != 1) 
+    {
+      tick_stride = 1;
+      pit_program (1);
+    }
+}
+
+/* Copies the tick count and TSC calibration to KINFO, making its
+   sequence count odd meanwhile so that a user process reading it
+   can tell it was interrupted.  Interrupts must be off. */
+static void
+kinfo_update (void) 
 {
-  ticks++;
-  thread_tick ();
+  if (kinfo == NULL)
+    return;
+  kinfo->seq++;
+  barrier ();
+  kinfo->ticks = ticks;
+  kinfo->timer_freq = TIMER_FREQ;
+  kinfo->tsc_hz = tsc_hz;
+  kinfo->tsc_boot = tsc_boot;
+  kinfo->tsc_ns_scale = tsc_ns_scale;
+  barrier ();
+  kinfo->seq++;
+}
+
+/* Sets up the 8254 Programmable Interval Timer (PIT) to
+   interrupt every STRIDE timer ticks. */
+static void
+pit_program (unsigned stride) 
+{
+  uint16_t count = PIT_TICK_COUNT * stride;
+
+  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+}
+
+/* Puts pending timer T into the wheel slot for its expiry tick.
+   A timer that is already due goes in the next slot to run; one
+   due beyond the wheel's range goes in the farthest slot and is
+   placed again each time it cascades. */
+static void
+wheel_insert (struct timer *t) 
+{
+  int64_t expires = t->expires;
+  int level;
+
+  if (expires < wheel_tick)
+    expires = wheel_tick;
+  else if (expires - wheel_tick >= WHEEL_RANGE)
+    expires = wheel_tick + WHEEL_RANGE - 1;
+
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (expires - wheel_tick < (int64_t) 1 << (WHEEL_BITS * (level + 1)))
+      break;
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                & (WHEEL_SLOTS - 1)],
+                  &t->elem);
+}
+
+/* Moves the timers in slot IDX of wheel level LEVEL into the
+   slots below where they now belong.  Returns IDX. */
+static int
+wheel_cascade (int level, int idx) 
+{
+  struct list *slot = &wheel[level][idx];
+  struct list timers;
+
+  list_init (&timers);
+  list_splice (list_end (&timers), list_begin (slot), list_end (slot));
+  while (!list_empty (&timers))
+    wheel_insert (list_entry (list_pop_front (&timers), struct timer, elem));
+  return idx;
+}
+
+/* Runs the timers due at wheel_tick, first cascading higher
+   levels if the level-0 index has wrapped around, and advances
+   wheel_tick. */
+static void
+wheel_run (void) 
+{
+  int idx = wheel_tick & (WHEEL_SLOTS - 1);
+  struct list *slot = &wheel[0][idx];
+  struct list timers;
+  int level;
+
+  for (level = 1; idx == 0 && level < WHEEL_LEVELS; level++)
+    idx = wheel_cascade (level, (wheel_tick >> (WHEEL_BITS * level))
+                                & (WHEEL_SLOTS - 1));
+
+  /* Detach the due timers first, so that callbacks may add
+     timers, which then land in later slots. */
+  list_init (&timers);
+  list_splice (list_end (&timers), list_begin (slot), list_end (slot));
+  wheel_tick++;
+  while (!list_empty (&timers))
+    {
+      struct timer *t = list_entry (list_pop_front (&timers),
+                                    struct timer, elem);
+      t->pending = false;
+      t->func (t->aux);
+    }
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -182,7 +571,9 @@ real_time_sleep (int64_t num, int32_t denom)
      ---------------------- = NUM * TIMER_FREQ / DENOM ticks. 
      1 s / TIMER_FREQ ticks
   */
-  int64_t ticks = num * TIMER_FREQ / denom;
+  int64_t ticks = (num > 0
+                   ? (int64_t) div64_32 (num * TIMER_FREQ, denom, NULL)
+                   : 0);
 
   ASSERT (intr_get_level () == INTR_ON);
   if (ticks > 0)
@@ -192,11 +583,20 @@ real_time_sleep (int64_t num, int32_t denom)
          processes. */                
       timer_sleep (ticks); 
     }
+  else if (tsc_hz != 0 && num > 0)
+    {
+      /* Otherwise, spin on the time stamp counter for accurate
+         sub-tick timing.  NUM/DENOM is under a tick, so
+         NUM * TSC_HZ cannot overflow. */
+      uint64_t end = read_tsc () + div64_32 (num * tsc_hz, denom, NULL);
+      while (read_tsc () < end)
+        barrier ();
+    }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing.  We scale the numerator and denominator
-         down by 1000 to avoid the possibility of overflow. */
+      /* Before the TSC is calibrated, use a busy-wait loop.  We
+         scale the numerator and denominator down by 1000 to
+         avoid the possibility of overflow. */
       ASSERT (denom % 1000 == 0);
       busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
     }
@@ -1,23 +1,60 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
 
-/* Number of timer interrupts per second. */
-#define TIMER_FREQ 100
+/* Number of timer interrupts per second: tunable "hz", given
+   with -o hz=N, between TIMER_FREQ_MIN and TIMER_FREQ_MAX.  It
+   is fixed once timer_init() has run. */
+#define TIMER_FREQ_DEFAULT 100
+#define TIMER_FREQ_MIN 19       /* 8254 counter is only 16 bits. */
+#define TIMER_FREQ_MAX 1000
+extern int timer_freq;
+#define TIMER_FREQ timer_freq
+
+/* Called by timer_interrupt() when a timer expires, with the AUX
+   given to timer_add().  Runs in interrupt context, so it must
+   be quick and must not sleep. */
+typedef void timer_func (void *aux);
+
+/* A one-shot kernel timer.  The caller provides the storage,
+   which must stay valid until the timer expires or is canceled
+   with timer_cancel(). */
+struct timer
+  {
+    struct list_elem elem;      /* Element in a timer wheel slot. */
+    int64_t expires;            /* Tick at which to call FUNC. */
+    timer_func *func;           /* Expiry callback. */
+    void *aux;                  /* Passed to FUNC. */
+    bool pending;               /* True until it expires or is canceled. */
+  };
 
 void timer_init (void);
 void timer_calibrate (void);
+bool timer_set_tsc_hz (const char *);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_ns (void);
+uint64_t timer_tsc_hz (void);
+
+struct kinfo;
+void timer_share (struct kinfo *);
+
+void timer_add (struct timer *, int64_t ticks, timer_func *, void *aux);
+bool timer_cancel (struct timer *);
 
 void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
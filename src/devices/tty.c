@@ -0,0 +1,169 @@
+#include "devices/tty.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/input.h"
+#include "threads/synch.h"
+
+/* Line-buffered terminal on top of the input buffer.
+
+   Keys are collected into a line, with backspace and Ctrl+U
+   editing it, and echoed back to the console a chunk at a time.
+   Readers only see the line once it is finished by a new-line or
+   Ctrl+D, and each read returns at most what is left of one
+   line. */
+
+#define CTRL(C) ((C) - 'A' + 1)
+
+static struct lock tty_lock;    /* Serializes readers. */
+
+/* Line being edited, or finished and partly read. */
+static char line[TTY_LINE_MAX];
+static size_t line_len;         /* Bytes in LINE. */
+static size_t line_ofs;         /* Bytes already returned to readers. */
+static bool line_done;          /* LINE is finished. */
+
+/* Raw keys taken from the input buffer but not yet processed,
+   because they arrived after the end of the previous line. */
+static uint8_t raw[64];
+static size_t raw_ofs, raw_len;
+
+/* Initializes the terminal. */
+void
+tty_init (void)
+{
+  lock_init_named (&tty_lock, "tty");
+}
+
+/* Echo not yet written to the console. */
+static char echo[128];
+static size_t echo_len;
+
+/* Writes out pending echo. */
+static void
+echo_flush (void)
+{
+  if (echo_len > 0)
+    putbuf (echo, echo_len);
+  echo_len = 0;
+}
+
+/* Queues S to be echoed. */
+static void
+echo_add (const char *s)
+{
+  size_t n = strlen (s);
+
+  if (echo_len + n > sizeof echo)
+    echo_flush ();
+  memcpy (echo + echo_len, s, n);
+  echo_len += n;
+}
+
+/* Processes keys into LINE until the line is finished, waiting
+   for input as needed if WAIT is true, or else stopping when no
+   more keys have arrived.  Echo for each batch of keys goes to
+   the console in a single putbuf() call. */
+static void
+fill_line (bool wait)
+{
+  while (!line_done)
+    {
+      if (raw_ofs == raw_len)
+        {
+          if (!wait && input_empty ())
+            break;
+          raw_len = input_read (raw, sizeof raw);
+          raw_ofs = 0;
+        }
+
+      while (raw_ofs < raw_len && !line_done)
+        {
+          char c = raw[raw_ofs++];
+          char s[2] = { c, '\0' };
+
+          switch (c)
+            {
+            case '\r':
+            case '\n':
+              line[line_len++] = '\n';
+              echo_add ("\n");
+              line_done = true;
+              break;
+
+            case '\b':
+            case 0x7f:
+              if (line_len > 0)
+                {
+                  line_len--;
+                  echo_add ("\b \b");
+                }
+              break;
+
+            case CTRL ('U'):
+              while (line_len > 0)
+                {
+                  line_len--;
+                  echo_add ("\b \b");
+                }
+              break;
+
+            case CTRL ('D'):
+              line_done = true;
+              break;
+
+            default:
+              line[line_len++] = c;
+              echo_add (s);
+              if (line_len == TTY_LINE_MAX - 1)
+                line_done = true;
+              break;
+            }
+        }
+
+      echo_flush ();
+    }
+}
+
+/* Reads up to SIZE bytes from the terminal into BUFFER.  Waits
+   until a line is finished, then returns as much of it as fits,
+   which may be less than SIZE.  Returns 0 at end of file, that
+   is, when Ctrl+D is typed on an empty line. */
+size_t
+tty_read (void *buffer, size_t size)
+{
+  size_t n;
+
+  lock_acquire (&tty_lock);
+  fill_line (true);
+  n = line_len - line_ofs;
+  if (n > size)
+    n = size;
+  memcpy (buffer, line + line_ofs, n);
+  line_ofs += n;
+  if (line_ofs == line_len)
+    {
+      line_len = line_ofs = 0;
+      line_done = false;
+    }
+  lock_release (&tty_lock);
+
+  return n;
+}
+
+/* Returns true if tty_read() would return without waiting, that
+   is, if a finished line is there.  Processes the keys that have
+   arrived so far.  Returns false if another thread is reading. */
+bool
+tty_ready (void)
+{
+  bool ready;
+
+  if (!lock_try_acquire (&tty_lock))
+    return false;
+  fill_line (false);
+  ready = line_done;
+  lock_release (&tty_lock);
+  return ready;
+}
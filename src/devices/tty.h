@@ -0,0 +1,14 @@
+#ifndef DEVICES_TTY_H
+#define DEVICES_TTY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Longest line the terminal will buffer, including the new-line. */
+#define TTY_LINE_MAX 256
+
+void tty_init (void);
+size_t tty_read (void *, size_t);
+bool tty_ready (void);
+
+#endif /* devices/tty.h */
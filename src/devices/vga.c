@@ -3,11 +3,20 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/vaddr.h"
 
-/* VGA text screen support.  See [FREEVGA] for more information. */
+/* VGA text screen support.  See [FREEVGA] for more information.
+
+   Video memory is uncached and slow to write, so characters are
+   drawn into a shadow copy of the screen in RAM, and only the
+   rows that changed are copied to video memory, in a batch, by
+   vga_flush().  Rows of the shadow form a ring, so that
+   scrolling moves its start instead of copying every row.  Until
+   vga_start_flusher() is called, each write flushes at once;
+   afterward, a timer flushes on the next tick. */
 
 /* Number of columns and rows on the text display. */
 #define COL_CNT 80
@@ -20,13 +29,32 @@ static size_t cx, cy;
 /* Attribute value for gray text on a black background. */
 #define GRAY_ON_BLACK 0x07
 
+/* Two blank gray-on-black character cells, as one 32-bit word. */
+#define BLANK_PAIR (0x00010001u * (' ' | GRAY_ON_BLACK << 8))
+
 /* Framebuffer.  See [FREEVGA] under "VGA Text Mode Operation".
    The character at (x,y) is fb[y][x][0].
    The attribute at (x,y) is fb[y][x][1]. */
 static uint8_t (*fb)[COL_CNT][2];
 
+/* Shadow of the framebuffer.  Screen row Y is shadow row
+   (top + Y) % ROW_CNT. */
+static uint8_t shadow[ROW_CNT][COL_CNT][2];
+static size_t top;
+
+/* Bit Y is set if screen row Y differs from video memory. */
+static uint32_t dirty;
+
+/* True once flushes are left to FLUSH_TIMER. */
+static bool deferred;
+static struct timer flush_timer;
+
+static void putc_locked (int c);
+static void done_locked (void);
+static void flush_locked (void);
 static void clear_row (size_t y);
 static void cls (void);
+static void scroll (void);
 static void newline (void);
 static void move_cursor (void);
 static void find_cursor (size_t *x, size_t *y);
@@ -40,6 +68,7 @@ init (void)
   if (!inited)
     {
       fb = ptov (0xb8000);
+      memcpy (shadow, fb, sizeof shadow);
       find_cursor (&cx, &cy);
       inited = true; 
     }
@@ -55,7 +84,69 @@ vga_putc (int c)
   enum intr_level old_level = intr_disable ();
 
   init ();
-  
+  putc_locked (c);
+  done_locked ();
+
+  intr_set_level (old_level);
+}
+
+/* Writes the N characters in BUFFER to the VGA text display, as
+   vga_putc() would. */
+void
+vga_putbuf (const char *buffer, size_t n)
+{
+  enum intr_level old_level = intr_disable ();
+
+  init ();
+  while (n-- > 0)
+    putc_locked (*buffer++);
+  done_locked ();
+
+  intr_set_level (old_level);
+}
+
+/* Copies every changed row to video memory and moves the
+   hardware cursor, so that the screen is up to date. */
+void
+vga_flush (void)
+{
+  enum intr_level old_level = intr_disable ();
+
+  init ();
+  flush_locked ();
+
+  intr_set_level (old_level);
+}
+
+/* Timer callback: flushes the screen. */
+static void
+flush_timer_func (void *aux UNUSED)
+{
+  flush_locked ();
+}
+
+/* Leaves flushing to a timer from now on, instead of flushing
+   after every write.  Call after timer_init(). */
+void
+vga_start_flusher (void)
+{
+  deferred = true;
+}
+
+/* A character cell: character, then attribute. */
+typedef uint8_t cell[2];
+
+/* Returns screen row Y of the shadow. */
+static inline cell *
+row (size_t y)
+{
+  return shadow[(top + y) % ROW_CNT];
+}
+
+/* Writes C to the shadow.  Interrupts must be off. */
+static void
+putc_locked (int c)
+{
   switch (c) 
     {
     case '\n':
@@ -82,17 +173,13 @@ vga_putc (int c)
       break;
       
     default:
-      fb[cy][cx][0] = c;
-      fb[cy][cx][1] = GRAY_ON_BLACK;
+      row (cy)[cx][0] = c;
+      row (cy)[cx][1] = GRAY_ON_BLACK;
+      dirty |= 1u << cy;
       if (++cx >= COL_CNT)
         newline ();
       break;
     }
-
-  /* Update cursor position. */
-  move_cursor ();
-
-  intr_set_level (old_level);
 }
 
 /* Clears the screen and moves the cursor to the upper left. */
@@ -105,20 +192,58 @@ cls (void)
     clear_row (y);
 
   cx = cy = 0;
-  move_cursor ();
 }
 
-/* Clears row Y to spaces. */
+/* Clears screen row Y to spaces, two cells per store. */
 static void
 clear_row (size_t y) 
 {
-  size_t x;
+  uint32_t *cells = (uint32_t *) row (y);
+  size_t i;
 
-  for (x = 0; x < COL_CNT; x++)
-    {
-      fb[y][x][0] = ' ';
-      fb[y][x][1] = GRAY_ON_BLACK;
-    }
+  for (i = 0; i < COL_CNT / 2; i++)
+    cells[i] = BLANK_PAIR;
+  dirty |= 1u << y;
+}
+
+/* Moves every row but the first up by one, by advancing the
+   start of the ring.  The old first row becomes the last.  Every
+   row of the screen changes. */
+static void
+scroll (void)
+{
+  top = (top + 1) % ROW_CNT;
+  dirty = (1u << ROW_CNT) - 1;
+}
+
+/* Finishes a write: flushes now, or makes sure the timer will. */
+static void
+done_locked (void)
+{
+  if (!deferred)
+    flush_locked ();
+  else if (!flush_timer.pending)
+    timer_add (&flush_timer, 1, flush_timer_func, NULL);
+}
+
+/* Copies the dirty rows of the shadow to video memory, a 32-bit
+   word (two cells) at a time, and moves the hardware cursor.
+   Interrupts must be off. */
+static void
+flush_locked (void)
+{
+  size_t y, i;
+
+  for (y = 0; dirty != 0; y++, dirty >>= 1)
+    if (dirty & 1)
+      {
+        uint32_t *dst = (uint32_t *) fb[y];
+        const uint32_t *src = (const uint32_t *) row (y);
+
+        for (i = 0; i < COL_CNT / 2; i++)
+          dst[i] = src[i];
+      }
+  move_cursor ();
 }
 
 /* Advances the cursor to the first column in the next line on
@@ -132,7 +257,7 @@ newline (void)
   if (cy >= ROW_CNT)
     {
       cy = ROW_CNT - 1;
-      memmove (&fb[0], &fb[1], sizeof fb[0] * (ROW_CNT - 1));
+      scroll ();
       clear_row (ROW_CNT - 1);
     }
 }
@@ -1,6 +1,11 @@
 #ifndef DEVICES_VGA_H
 #define DEVICES_VGA_H
 
+#include <stddef.h>
+
 void vga_putc (int);
+void vga_putbuf (const char *, size_t);
+void vga_flush (void);
+void vga_start_flusher (void);
 
 #endif /* devices/vga.h */
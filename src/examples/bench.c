@@ -0,0 +1,27 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+/* Returns a time stamp for bench_elapsed(). */
+int64_t bench_start(void)
+{
+  return clock_ns();
+}
+
+/* Returns the nanoseconds since START. */
+int64_t bench_elapsed(int64_t start)
+{
+  return clock_ns() - start;
+}
+
+/* Reports that OPS operations, counted in UNITs, took NS
+   nanoseconds. */
+void bench_report(const char *name, int64_t ns, int64_t ops,
+                  const char *unit)
+{
+  if (ns <= 0)
+    ns = 1;
+  printf("BENCH %s %"PRId64" %s %"PRId64" ns %"PRId64" %s/s\n",
+         name, ops, unit, ns, ops * 1000000000 / ns, unit);
+}
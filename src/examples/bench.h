@@ -0,0 +1,17 @@
+/* Common code for the bench_* programs.  Each result is printed
+   as one line, in the same form as the kernel's tests/bench:
+
+        BENCH <name> <ops> <unit> <ns> ns <rate> <unit>/s
+*/
+
+#ifndef EXAMPLES_BENCH_H
+#define EXAMPLES_BENCH_H
+
+#include <stdint.h>
+
+int64_t bench_start(void);
+int64_t bench_elapsed(int64_t start);
+void bench_report(const char *name, int64_t ns, int64_t ops,
+                  const char *unit);
+
+#endif /* examples/bench.h */
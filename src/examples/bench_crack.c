@@ -0,0 +1,200 @@
+/* Brute-force password search, as a CPU scaling benchmark.
+
+   A password of LETTERS lowercase letters is hashed with ROUNDS
+   rounds of FNV-1a, and the program looks for it by hashing every
+   password of that length.  The key space is split evenly among
+   child processes, copies of this program, which need nothing
+   but the CPU and send their results back through a pipe set up
+   as their stdout.  The search is done with 1 child, then 2, 4
+   and so on up to MAX_PROCS, default 4, and each run is reported
+   as a BENCH line with its speedup over the run with 1 child.
+
+   bench_crack [MAX_PROCS [LETTERS]]    default 4 children, 4 letters
+
+   pintos --qemu -p ../examples/bench_crack -a bench_crack -- -q run 'bench_crack 4'
+
+   A child is started as "bench_crack -w FIRST LAST TARGET LETTERS",
+   to try keys FIRST up to LAST against hash TARGET.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define CHILD_MAX 16            /* Most children. */
+#define LETTERS_MAX 6           /* Longest password. */
+#define ROUNDS 16               /* Hash rounds per password. */
+
+/* What a child sends back. */
+struct result
+{
+  int found;                    /* Passwords that matched. */
+  unsigned key;                 /* The last one, if any. */
+};
+
+/* Stores the password with key KEY, of LETTERS letters, in PW,
+   null-terminated. */
+static void key_to_password(unsigned key, int letters, char *pw)
+{
+  int i;
+
+  for (i = letters - 1; i >= 0; i--)
+  {
+    pw[i] = 'a' + key % 26;
+    key /= 26;
+  }
+  pw[letters] = '\0';
+}
+
+/* Returns the hash of the LETTERS letters of PW. */
+static unsigned hash_password(const char *pw, int letters)
+{
+  unsigned h = 2166136261u;
+  int r, i;
+
+  for (r = 0; r < ROUNDS; r++)
+    for (i = 0; i < letters; i++)
+    {
+      h ^= (unsigned char) pw[i];
+      h *= 16777619u;
+    }
+  return h;
+}
+
+/* Child: tries keys FIRST up to LAST and writes a struct result
+   to stdout.  Returns 0 if successful. */
+static int search(unsigned first, unsigned last, unsigned target,
+                  int letters)
+{
+  struct result r = { 0, 0 };
+  char pw[LETTERS_MAX + 1];
+  unsigned key;
+
+  for (key = first; key < last; key++)
+  {
+    key_to_password(key, letters, pw);
+    if (hash_password(pw, letters) == target)
+    {
+      r.found++;
+      r.key = key;
+    }
+  }
+  return write(STDOUT_FILENO, &r, sizeof r) == sizeof r ? 0 : 1;
+}
+
+/* Searches the KEY_CNT keys for TARGET with CNT children and
+   stores the summed result in *R.  Returns the nanoseconds taken,
+   or -1 if a child could not be started or failed. */
+static int64_t run(int cnt, unsigned key_cnt, unsigned target, int letters,
+                   struct result *r)
+{
+  pid_t pids[CHILD_MAX];
+  int fds[2];
+  int64_t start, ns;
+  bool success = true;
+  int i, j;
+
+  if (!pipe(fds))
+    return -1;
+  r->found = 0;
+  r->key = 0;
+  start = bench_start();
+  for (i = 0; i < cnt; i++)
+  {
+    char cmd[64];
+    /* TARGET goes as a signed number, for atoi(). */
+    snprintf(cmd, sizeof cmd, "bench_crack -w %u %u %d %d",
+             (unsigned) ((long long) key_cnt * i / cnt),
+             (unsigned) ((long long) key_cnt * (i + 1) / cnt),
+             (int) target, letters);
+    pids[i] = exec_stdio(cmd, STDIN_FILENO, fds[1]);
+    if (pids[i] == PID_ERROR)
+    {
+      printf("bench_crack: exec failed\n");
+      success = false;
+      break;
+    }
+  }
+  close(fds[1]);
+
+  /* Results arrive in the order the children finish.  Each is far
+     smaller than the pipe buffer, so it is written in one piece. */
+  for (j = 0; success && j < i; j++)
+  {
+    struct result c;
+    if (read(fds[0], &c, sizeof c) != sizeof c)
+      success = false;
+    else
+    {
+      r->found += c.found;
+      if (c.found > 0)
+        r->key = c.key;
+    }
+  }
+  while (i-- > 0)
+    if (wait(pids[i]) != 0)
+      success = false;
+  ns = bench_elapsed(start);
+  close(fds[0]);
+  return success ? ns : -1;
+}
+
+int main(int argc, char *argv[])
+{
+  int max = argc > 1 ? atoi(argv[1]) : 4;
+  int letters = argc > 2 ? atoi(argv[2]) : 4;
+  char pw[LETTERS_MAX + 1];
+  unsigned key_cnt, target;
+  int64_t base_ns = 0;
+  int cnt, i;
+
+  if (argc == 6 && !strcmp(argv[1], "-w"))
+    return search(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]),
+                  atoi(argv[5]));
+
+  if (max < 1 || max > CHILD_MAX || letters < 1 || letters > LETTERS_MAX)
+  {
+    printf("bench_crack: 1 to %d children, 1 to %d letters\n",
+           CHILD_MAX, LETTERS_MAX);
+    return 1;
+  }
+  for (key_cnt = 1, i = 0; i < letters; i++)
+    key_cnt *= 26;
+
+  /* The password is two thirds of the way into the key space, so
+     that it is not in the first child's share. */
+  key_to_password(key_cnt / 3 * 2, letters, pw);
+  target = hash_password(pw, letters);
+
+  for (cnt = 1; ; cnt = cnt * 2 < max ? cnt * 2 : max)
+  {
+    struct result r;
+    char label[32], found[LETTERS_MAX + 1];
+    int64_t ns = run(cnt, key_cnt, target, letters, &r);
+
+    if (ns < 0)
+    {
+      printf("bench_crack: search with %d children failed\n", cnt);
+      return 1;
+    }
+    /* With 32-bit hashes, a longer password may have company. */
+    key_to_password(r.key, letters, found);
+    if (r.found < 1 || hash_password(found, letters) != target)
+    {
+      printf("bench_crack: \"%s\" not found with %d children\n", pw, cnt);
+      return 1;
+    }
+    if (cnt == 1)
+      base_ns = ns;
+
+    snprintf(label, sizeof label, "crack-%d-p%d", letters, cnt);
+    bench_report(label, ns, key_cnt, "keys");
+    printf("bench_crack: %d children, speedup %d.%02d\n", cnt,
+           (int) (base_ns / ns), (int) (base_ns * 100 / ns % 100));
+    if (cnt == max)
+      break;
+  }
+  return 0;
+}
@@ -0,0 +1,66 @@
+/* Measures the round trip of starting a process with exec() and
+   collecting it with wait(), and breaks the time exec() takes
+   down into the phases that the kernel counts in struct stats.
+   Needs the dummy program.
+
+   pintos --qemu -p ../examples/bench_exec -a bench_exec -p ../examples/dummy -a dummy -- -f -q run bench_exec
+
+   Booting with -trace=exec as well records each phase of each
+   exec in the trace, for utils/pintos-trace.
+*/
+
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define ROUNDS 50
+
+/* Names of enum exec_phase. */
+static const char *phase_names[EXEC_PHASE_CNT] =
+{
+  [EXEC_SPAWN] = "spawn",
+  [EXEC_THREAD] = "thread",
+  [EXEC_SETUP] = "setup",
+  [EXEC_OPEN] = "open",
+  [EXEC_SEGMENTS] = "segments",
+  [EXEC_REGISTER] = "register",
+};
+
+static struct stats before, after;
+
+int main(void)
+{
+  long long cnt;
+  int64_t start;
+  int i;
+
+  if (stats(&before, sizeof before) < (int) sizeof before
+      || before.version < 4)
+  {
+    printf("bench_exec: kernel lacks exec statistics\n");
+    return 1;
+  }
+
+  start = bench_start();
+  for (i = 0; i < ROUNDS; i++)
+  {
+    pid_t pid = exec("dummy 0");
+    if (pid < 0 || wait(pid) != 0)
+    {
+      printf("bench_exec: exec or wait of dummy failed\n");
+      return 1;
+    }
+  }
+  bench_report("exec-wait", bench_elapsed(start), ROUNDS, "processes");
+
+  stats(&after, sizeof after);
+  cnt = after.exec_cnt - before.exec_cnt;
+  for (i = 0; i < EXEC_PHASE_CNT && cnt > 0; i++)
+  {
+    char label[32];
+    snprintf(label, sizeof label, "exec-%s", phase_names[i]);
+    bench_report(label, after.exec_ns[i] - before.exec_ns[i], cnt,
+                 "processes");
+  }
+  return 0;
+}
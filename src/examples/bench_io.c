@@ -0,0 +1,68 @@
+/* Measures file read and write bandwidth, sequential and at
+   random block-aligned offsets, for several block sizes.
+
+   pintos --qemu -p ../examples/bench_io -a bench_io -- -f -q run bench_io
+*/
+
+#include <random.h>
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define FILE_SIZE (256 * 1024)
+#define MAX_BLOCK 16384
+
+static char buf[MAX_BLOCK];
+
+/* Transfers FILE_SIZE bytes of FD in blocks of SIZE bytes, writing
+   if WRITE is true and reading otherwise, in order if RANDOM is
+   false and at random blocks otherwise.  Prints the bandwidth
+   under NAME.  Returns false on a short transfer. */
+static bool run(int fd, const char *name, int size, bool write_, bool random)
+{
+  int blocks = FILE_SIZE / size;
+  char label[32];
+  int64_t start;
+  int i;
+
+  seek(fd, 0);
+  start = bench_start();
+  for (i = 0; i < blocks; i++)
+  {
+    if (random)
+      seek(fd, random_ulong() % blocks * size);
+    if ((write_ ? write(fd, buf, size) : read(fd, buf, size)) != size)
+    {
+      printf("bench_io: short %s of %d bytes\n", name, size);
+      return false;
+    }
+  }
+  snprintf(label, sizeof label, "%s-%d", name, size);
+  bench_report(label, bench_elapsed(start), FILE_SIZE, "bytes");
+  return true;
+}
+
+int main(void)
+{
+  static const int sizes[] = { 512, 4096, MAX_BLOCK };
+  unsigned i;
+  int fd;
+
+  random_init(0);
+  if (!create("bench.tmp", 0) || (fd = open("bench.tmp")) < 0)
+  {
+    printf("bench_io: cannot create bench.tmp\n");
+    return 1;
+  }
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    if (!run(fd, "seq-write", sizes[i], true, false)
+        || !run(fd, "seq-read", sizes[i], false, false)
+        || !run(fd, "rand-write", sizes[i], true, true)
+        || !run(fd, "rand-read", sizes[i], false, true))
+      return 1;
+
+  close(fd);
+  remove("bench.tmp");
+  return 0;
+}
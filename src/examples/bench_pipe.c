@@ -0,0 +1,47 @@
+/* Measures pipe throughput for several chunk sizes, writing each
+   chunk and reading it back.  Chunks are at most a page, the
+   pipe's capacity, so writes never wait.
+
+   pintos --qemu -p ../examples/bench_pipe -a bench_pipe -- -q run bench_pipe
+*/
+
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define TOTAL (1024 * 1024)
+#define MAX_CHUNK 4096
+
+static char buf[MAX_CHUNK];
+
+int main(void)
+{
+  static const int sizes[] = { 64, 512, MAX_CHUNK };
+  unsigned i;
+  int fds[2];
+
+  if (!pipe(fds))
+  {
+    printf("bench_pipe: pipe failed\n");
+    return 1;
+  }
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+  {
+    int size = sizes[i];
+    char label[32];
+    int64_t start;
+    int done;
+
+    start = bench_start();
+    for (done = 0; done < TOTAL; done += size)
+      if (write(fds[1], buf, size) != size || read(fds[0], buf, size) != size)
+      {
+        printf("bench_pipe: short transfer of %d bytes\n", size);
+        return 1;
+      }
+    snprintf(label, sizeof label, "pipe-%d", size);
+    bench_report(label, bench_elapsed(start), TOTAL, "bytes");
+  }
+  return 0;
+}
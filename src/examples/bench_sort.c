@@ -0,0 +1,269 @@
+/* External merge sort benchmark, a file-based big brother of the
+   child-sort and child-qsort programs in tests/vm.
+
+   The parent writes INPUT_KB kB of random 32-bit keys to sort.in.
+   RUNS child processes, copies of this program, then each read a
+   slice of it, sort the slice in memory and write it out as a
+   sorted run.  Finally, the parent merges the runs into sort.out,
+   reading each run and writing the output in MERGE_BLOCK-byte
+   blocks, and checks the result.  The run phase uses the CPUs,
+   the buffer cache and, once the slices stop fitting in memory,
+   swap; the merge phase is large sequential I/O with read-ahead.
+   Each phase is reported as a BENCH line.
+
+   bench_sort [INPUT_KB [RUNS]]         default 512 kB in 4 runs
+
+   pintos --qemu --fs-disk=8 -p ../examples/bench_sort -a bench_sort -- -f -q run bench_sort
+
+   A child is started as "bench_sort run IDX FIRST CNT", to sort
+   keys FIRST up to FIRST + CNT into run IDX.
+*/
+
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define MAX_RUNS 8
+#define MAX_RUN_KEYS (256 * 1024)       /* 1 MB per run. */
+#define MERGE_BLOCK 4096                 /* Bytes per merge read or write. */
+#define BLOCK_KEYS (MERGE_BLOCK / (int) sizeof (unsigned))
+
+/* Keys of one run, in a child. */
+static unsigned keys[MAX_RUN_KEYS];
+
+/* Merge buffers, in the parent: one block of each run, and one of
+   output. */
+static unsigned in_blocks[MAX_RUNS][BLOCK_KEYS];
+static unsigned out_block[BLOCK_KEYS];
+
+/* A run being merged. */
+struct run
+{
+  int fd;                       /* Open run file. */
+  int pos, cnt;                 /* Next key and keys in its block. */
+};
+
+/* Returns the name of run IDX in NAME, which has room for 16
+   bytes. */
+static const char *run_name(char name[16], int idx)
+{
+  snprintf(name, 16, "sort.%d", idx);
+  return name;
+}
+
+static int compare_keys(const void *a_, const void *b_)
+{
+  unsigned a = *(const unsigned *) a_;
+  unsigned b = *(const unsigned *) b_;
+  return a < b ? -1 : a > b;
+}
+
+/* Writes the SIZE bytes at BUF to FD in MERGE_BLOCK-byte blocks.
+   Returns true if all were written. */
+static bool write_all(int fd, const void *buf_, int size)
+{
+  const char *buf = buf_;
+  int ofs;
+
+  for (ofs = 0; ofs < size; ofs += MERGE_BLOCK)
+  {
+    int n = size - ofs < MERGE_BLOCK ? size - ofs : MERGE_BLOCK;
+    if (write(fd, buf + ofs, n) != n)
+      return false;
+  }
+  return true;
+}
+
+/* Child: sorts keys FIRST up to FIRST + CNT of sort.in into run
+   IDX.  Returns 0 if successful. */
+static int sort_run(int idx, int first, int cnt)
+{
+  char name[16];
+  int size = cnt * (int) sizeof *keys;
+  int in, out;
+
+  if (cnt > MAX_RUN_KEYS || (in = open("sort.in")) < 0)
+    return 1;
+  if (pread(in, keys, size, first * sizeof *keys) != size)
+    return 1;
+  close(in);
+
+  qsort(keys, cnt, sizeof *keys, compare_keys);
+
+  if (!create(run_name(name, idx), 0) || (out = open(name)) < 0
+      || !write_all(out, keys, size))
+    return 1;
+  close(out);
+  return 0;
+}
+
+/* Refills BLOCK, R's block, from R's file.  Returns false at the
+   end of the run. */
+static bool refill(struct run *r, unsigned *block)
+{
+  int n = read(r->fd, block, MERGE_BLOCK);
+  r->pos = 0;
+  r->cnt = n > 0 ? n / (int) sizeof *block : 0;
+  return r->cnt > 0;
+}
+
+/* Merges the CNT sorted runs into sort.out, checking that the
+   output is sorted and that its keys add up to SUM.  Returns true
+   if successful. */
+static bool merge(int cnt, int key_cnt, unsigned sum)
+{
+  struct run runs[MAX_RUNS];
+  int out, live = 0, out_cnt = 0, total = 0;
+  unsigned last = 0, out_sum = 0;
+  char name[16];
+  int i;
+
+  if (!create("sort.out", 0) || (out = open("sort.out")) < 0)
+    return false;
+  for (i = 0; i < cnt; i++)
+  {
+    runs[i].fd = open(run_name(name, i));
+    if (runs[i].fd < 0)
+      return false;
+    if (refill(&runs[i], in_blocks[i]))
+      live++;
+  }
+
+  /* With at most MAX_RUNS runs, a linear scan for the smallest
+     head is as fast as a heap. */
+  while (live > 0)
+  {
+    int min = -1;
+    unsigned key;
+
+    for (i = 0; i < cnt; i++)
+      if (runs[i].cnt > 0
+          && (min < 0 || in_blocks[i][runs[i].pos]
+                         < in_blocks[min][runs[min].pos]))
+        min = i;
+    key = in_blocks[min][runs[min].pos];
+    if (++runs[min].pos == runs[min].cnt
+        && !refill(&runs[min], in_blocks[min]))
+      live--;
+
+    if (key < last)
+    {
+      printf("bench_sort: key %d out of order\n", total);
+      return false;
+    }
+    last = key;
+    out_sum += key;
+    total++;
+    out_block[out_cnt++] = key;
+    if (out_cnt == BLOCK_KEYS)
+    {
+      if (write(out, out_block, MERGE_BLOCK) != MERGE_BLOCK)
+        return false;
+      out_cnt = 0;
+    }
+  }
+  if (!write_all(out, out_block, out_cnt * (int) sizeof *out_block))
+    return false;
+
+  for (i = 0; i < cnt; i++)
+  {
+    close(runs[i].fd);
+    remove(run_name(name, i));
+  }
+  close(out);
+  if (total != key_cnt || out_sum != sum)
+  {
+    printf("bench_sort: merged %d keys, expected %d\n", total, key_cnt);
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int input_kb = argc > 1 ? atoi(argv[1]) : 512;
+  int runs = argc > 2 ? atoi(argv[2]) : 4;
+  int key_cnt, fd, i;
+  pid_t pids[MAX_RUNS];
+  unsigned sum = 0;
+  int64_t start;
+  bool ok = true;
+
+  if (argc == 5 && !strcmp(argv[1], "run"))
+    return sort_run(atoi(argv[2]), atoi(argv[3]), atoi(argv[4]));
+
+  key_cnt = input_kb * 1024 / (int) sizeof (unsigned);
+  if (runs < 1 || runs > MAX_RUNS || key_cnt < runs
+      || (key_cnt + runs - 1) / runs > MAX_RUN_KEYS)
+  {
+    printf("bench_sort: need 1 to %d runs of at most %d kB each\n",
+           MAX_RUNS, MAX_RUN_KEYS * (int) sizeof (unsigned) / 1024);
+    return 1;
+  }
+
+  /* Write the input a block at a time. */
+  random_init(key_cnt);
+  if (!create("sort.in", 0) || (fd = open("sort.in")) < 0)
+  {
+    printf("bench_sort: can't create sort.in\n");
+    return 1;
+  }
+  for (i = 0; i < key_cnt; i += BLOCK_KEYS)
+  {
+    int n = key_cnt - i < BLOCK_KEYS ? key_cnt - i : BLOCK_KEYS;
+    int j;
+
+    for (j = 0; j < n; j++)
+      sum += out_block[j] = random_ulong();
+    if (!write_all(fd, out_block, n * (int) sizeof *out_block))
+    {
+      printf("bench_sort: can't write sort.in\n");
+      return 1;
+    }
+  }
+  close(fd);
+
+  /* Sort the runs in parallel. */
+  start = bench_start();
+  for (i = 0; i < runs; i++)
+  {
+    char cmd[64];
+    int first = (int) ((long long) key_cnt * i / runs);
+    int last = (int) ((long long) key_cnt * (i + 1) / runs);
+
+    snprintf(cmd, sizeof cmd, "bench_sort run %d %d %d", i, first,
+             last - first);
+    pids[i] = exec(cmd);
+    if (pids[i] == PID_ERROR)
+    {
+      printf("bench_sort: exec failed\n");
+      ok = false;
+      break;
+    }
+  }
+  while (i-- > 0)
+    if (wait(pids[i]) != 0)
+      ok = false;
+  if (!ok)
+  {
+    printf("bench_sort: sorting a run failed\n");
+    return 1;
+  }
+  bench_report("sort-runs", bench_elapsed(start), input_kb * 1024LL, "bytes");
+
+  /* Merge them. */
+  start = bench_start();
+  if (!merge(runs, key_cnt, sum))
+  {
+    printf("bench_sort: merge failed\n");
+    return 1;
+  }
+  bench_report("sort-merge", bench_elapsed(start), input_kb * 1024LL, "bytes");
+
+  remove("sort.in");
+  remove("sort.out");
+  return 0;
+}
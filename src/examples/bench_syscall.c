@@ -0,0 +1,44 @@
+/* Measures the latency of a system call that does no work, tell()
+   on a file descriptor that is not open, and the rate of open()
+   and close() on an existing file.
+
+   pintos --qemu -p ../examples/bench_syscall -a bench_syscall -- -f -q run bench_syscall
+*/
+
+#include <stdio.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define NULL_CALLS 100000
+#define OPEN_CALLS 2000
+
+int main(void)
+{
+  int64_t start;
+  int i;
+
+  start = bench_start();
+  for (i = 0; i < NULL_CALLS; i++)
+    tell(-1);
+  bench_report("null-syscall", bench_elapsed(start), NULL_CALLS, "calls");
+
+  if (!create("bench.tmp", 0))
+  {
+    printf("bench_syscall: create failed\n");
+    return 1;
+  }
+  start = bench_start();
+  for (i = 0; i < OPEN_CALLS; i++)
+  {
+    int fd = open("bench.tmp");
+    if (fd < 0)
+    {
+      printf("bench_syscall: open failed\n");
+      return 1;
+    }
+    close(fd);
+  }
+  bench_report("open-close", bench_elapsed(start), OPEN_CALLS, "opens");
+  remove("bench.tmp");
+  return 0;
+}
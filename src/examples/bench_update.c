@@ -0,0 +1,130 @@
+/* Measures updating a file in place, as lineup does: reading each
+   block, changing it and writing it back to the same offset.  The
+   update is done three ways, for several block sizes:
+
+        update-seek     read(), seek() back, write()
+        update-pwrite   pread() and pwrite(), no seeks
+        update-mmap     through a memory mapping, written back by
+                        munmap(); only with -m, since it needs VM
+
+   Blocks that are not a multiple of the sector size make the
+   kernel merge partial sectors, which the buffer cache turns into
+   memory copies instead of disk reads.
+
+   bench_update [-m]
+
+   pintos --qemu -p ../examples/bench_update -a bench_update -- -f -q run 'bench_update -m'
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define FILE_SIZE (256 * 1024)
+#define MAX_BLOCK 16384
+#define MAP_ADDR ((char *) 0x10000000)
+
+static char buf[MAX_BLOCK];
+
+/* Changes the SIZE bytes at P, so that every pass writes new
+   data. */
+static void change(char *p, int size)
+{
+  int i;
+
+  for (i = 0; i < size; i++)
+    p[i]++;
+}
+
+/* Updates all of FD in blocks of SIZE bytes, with pread() and
+   pwrite() if POSITIONED and otherwise with read(), seek() and
+   write().  Prints the bandwidth under NAME.  Returns false on a
+   short transfer. */
+static bool run(int fd, const char *name, int size, bool positioned)
+{
+  char label[32];
+  int64_t start;
+  int ofs;
+
+  seek(fd, 0);
+  start = bench_start();
+  for (ofs = 0; ofs < FILE_SIZE; ofs += size)
+  {
+    int n = FILE_SIZE - ofs < size ? FILE_SIZE - ofs : size;
+    bool ok;
+
+    if (positioned)
+    {
+      ok = pread(fd, buf, n, ofs) == n;
+      change(buf, n);
+      ok = ok && pwrite(fd, buf, n, ofs) == n;
+    }
+    else
+    {
+      ok = read(fd, buf, n) == n;
+      change(buf, n);
+      seek(fd, ofs);
+      ok = ok && write(fd, buf, n) == n;
+    }
+    if (!ok)
+    {
+      printf("bench_update: short %s of %d bytes\n", name, n);
+      return false;
+    }
+  }
+  snprintf(label, sizeof label, "%s-%d", name, size);
+  bench_report(label, bench_elapsed(start), FILE_SIZE, "bytes");
+  return true;
+}
+
+/* Updates all of FD through a mapping, including the write-back
+   when it is unmapped.  Returns false if it cannot be mapped. */
+static bool run_mmap(int fd)
+{
+  int64_t start = bench_start();
+  mapid_t map = mmap(fd, MAP_ADDR);
+
+  if (map == MAP_FAILED)
+  {
+    printf("bench_update: mmap failed\n");
+    return false;
+  }
+  change(MAP_ADDR, FILE_SIZE);
+  munmap(map);
+  bench_report("update-mmap", bench_elapsed(start), FILE_SIZE, "bytes");
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  /* Odd sizes on purpose: 1000 bytes splits most sectors. */
+  static const int sizes[] = { 512, 1000, 4096, MAX_BLOCK };
+  bool use_mmap = argc > 1 && !strcmp(argv[1], "-m");
+  unsigned i;
+  int fd, ofs;
+
+  if (!create("bench.tmp", FILE_SIZE) || (fd = open("bench.tmp")) < 0)
+  {
+    printf("bench_update: cannot create bench.tmp\n");
+    return 1;
+  }
+  /* Write it all once, so that no pass pays for allocation. */
+  for (ofs = 0; ofs < FILE_SIZE; ofs += MAX_BLOCK)
+    if (write(fd, buf, MAX_BLOCK) != MAX_BLOCK)
+    {
+      printf("bench_update: cannot write bench.tmp\n");
+      return 1;
+    }
+
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    if (!run(fd, "update-seek", sizes[i], false)
+        || !run(fd, "update-pwrite", sizes[i], true))
+      return 1;
+  if (use_mmap && !run_mmap(fd))
+    return 1;
+
+  close(fd);
+  remove("bench.tmp");
+  return 0;
+}
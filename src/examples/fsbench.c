@@ -0,0 +1,195 @@
+/* File system throughput harness, in the spirit of the seq-block
+   and syn-read/syn-write tests of tests/filesys/base, but timed
+   rather than checked.
+
+   Each run has PROCS child processes, copies of this program, each
+   write and then read back its own FILE_KB file sequentially in
+   BLOCK-byte blocks, either through the buffer cache or around it
+   with O_DIRECT.  For each run a table row gives the write and
+   read bandwidth and how much the disk and cache counters moved.
+
+   fsbench [FILE_KB]                      sweeps block sizes,
+                                          process counts and cache
+   fsbench FILE_KB BLOCK PROCS cache|direct   runs one configuration
+
+   pintos --qemu --fs-disk=4 -p ../examples/fsbench -a fsbench -- -f -q run fsbench
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define MAX_PROCS 4
+#define MAX_BLOCK 16384
+
+static char buf[MAX_BLOCK] __attribute__ ((aligned (512)));
+
+/* Child: writes (OP 'w') or reads (OP 'r') file fsb.IDX of FILE_KB
+   kB in BLOCK-byte blocks.  Returns 0 if all went well. */
+static int child(int idx, char op, int file_kb, int block, bool direct)
+{
+  char name[16];
+  int fd, i;
+
+  snprintf(name, sizeof name, "fsb.%d", idx);
+  fd = open_flags(name, direct ? O_DIRECT : 0);
+  if (fd < 0)
+    return 1;
+  memset(buf, idx, block);
+  for (i = 0; i < file_kb * 1024 / block; i++)
+    if ((op == 'w' ? write(fd, buf, block) : read(fd, buf, block)) != block)
+      return 1;
+  close(fd);
+  return 0;
+}
+
+/* Adds the change in each counter from BEFORE to AFTER to *DELTA. */
+static void stats_add(struct disk_stats *delta, const struct disk_stats *after,
+                      const struct disk_stats *before)
+{
+  delta->read_cnt += after->read_cnt - before->read_cnt;
+  delta->write_cnt += after->write_cnt - before->write_cnt;
+  delta->cmd_cnt += after->cmd_cnt - before->cmd_cnt;
+  delta->busy_ticks += after->busy_ticks - before->busy_ticks;
+  delta->hit_cnt += after->hit_cnt - before->hit_cnt;
+  delta->miss_cnt += after->miss_cnt - before->miss_cnt;
+  delta->evict_cnt += after->evict_cnt - before->evict_cnt;
+  delta->prefetch_cnt += after->prefetch_cnt - before->prefetch_cnt;
+}
+
+/* Runs PROCS children doing OP at once.  Returns the elapsed time
+   in nanoseconds, adding the change in counters to *DELTA, or -1
+   if a child failed. */
+static int64_t phase(char op, int file_kb, int block, int procs, bool direct,
+                     struct disk_stats *delta)
+{
+  struct disk_stats before, after;
+  pid_t pids[MAX_PROCS];
+  char cmd[64];
+  int64_t start, ns;
+  bool ok = true;
+  int i;
+
+  disk_stats(&before);
+  start = bench_start();
+  for (i = 0; i < procs; i++)
+  {
+    snprintf(cmd, sizeof cmd, "fsbench child %d %c %d %d %d",
+             i, op, file_kb, block, direct);
+    pids[i] = exec(cmd);
+  }
+  for (i = 0; i < procs; i++)
+    if (pids[i] < 0 || wait(pids[i]) != 0)
+      ok = false;
+  ns = bench_elapsed(start);
+  disk_stats(&after);
+
+  stats_add(delta, &after, &before);
+  return ok ? ns : -1;
+}
+
+/* Prints BYTES per NS nanoseconds as MB/s with two decimals. */
+static void print_rate(long long bytes, int64_t ns)
+{
+  long long centi = ns > 0 ? bytes * 1000 * 100 / ns : 0;
+  printf(" %6lld.%02lld", centi / 100, centi % 100);
+}
+
+/* Runs one configuration and prints its table row.  Returns false
+   on failure. */
+static bool run(int file_kb, int block, int procs, bool direct)
+{
+  long long bytes = (long long) file_kb * 1024 * procs;
+  struct disk_stats delta;
+  int64_t write_ns, read_ns;
+  char name[16];
+  int i;
+
+  for (i = 0; i < procs; i++)
+  {
+    snprintf(name, sizeof name, "fsb.%d", i);
+    remove(name);
+    if (!create(name, 0))
+    {
+      printf("fsbench: cannot create %s\n", name);
+      return false;
+    }
+  }
+
+  memset(&delta, 0, sizeof delta);
+  write_ns = phase('w', file_kb, block, procs, direct, &delta);
+  read_ns = phase('r', file_kb, block, procs, direct, &delta);
+  if (write_ns < 0 || read_ns < 0)
+  {
+    printf("fsbench: a child failed\n");
+    return false;
+  }
+
+  printf("%-6s %7d %6d %5d", direct ? "direct" : "cache", file_kb,
+         block, procs);
+  print_rate(bytes, write_ns);
+  print_rate(bytes, read_ns);
+  printf(" %7lld %7lld %6lld %6lld %7lld %7lld %6lld\n",
+         delta.read_cnt, delta.write_cnt, delta.cmd_cnt, delta.busy_ticks,
+         delta.hit_cnt, delta.miss_cnt, delta.prefetch_cnt);
+
+  for (i = 0; i < procs; i++)
+  {
+    snprintf(name, sizeof name, "fsb.%d", i);
+    remove(name);
+  }
+  return true;
+}
+
+static void print_header(void)
+{
+  printf("%-6s %7s %6s %5s %9s %9s %7s %7s %6s %6s %7s %7s %6s\n",
+         "mode", "file_kb", "block", "procs", "wr_MB/s", "rd_MB/s",
+         "sec_rd", "sec_wr", "cmds", "busy", "hits", "misses", "ahead");
+}
+
+int main(int argc, char *argv[])
+{
+  static const int blocks[] = { 512, 4096, MAX_BLOCK };
+  static const int procs[] = { 1, 2, MAX_PROCS };
+  int file_kb = 64;
+  unsigned b, p;
+  int direct;
+
+  if (argc == 7 && !strcmp(argv[1], "child"))
+    return child(atoi(argv[2]), argv[3][0], atoi(argv[4]), atoi(argv[5]),
+                 atoi(argv[6]));
+
+  if (argc == 5)
+  {
+    int block = atoi(argv[2]), nprocs = atoi(argv[3]);
+    if (block < 512 || block > MAX_BLOCK || block % 512 != 0
+        || nprocs < 1 || nprocs > MAX_PROCS)
+    {
+      printf("fsbench: BLOCK must be a multiple of 512 up to %d, "
+             "PROCS from 1 to %d\n", MAX_BLOCK, MAX_PROCS);
+      return 1;
+    }
+    print_header();
+    return run(atoi(argv[1]), block, nprocs, !strcmp(argv[4], "direct"))
+           ? 0 : 1;
+  }
+  if (argc == 2)
+    file_kb = atoi(argv[1]);
+  else if (argc != 1)
+  {
+    printf("usage: fsbench [FILE_KB [BLOCK PROCS cache|direct]]\n");
+    return 1;
+  }
+
+  print_header();
+  for (direct = 0; direct <= 1; direct++)
+    for (b = 0; b < sizeof blocks / sizeof *blocks; b++)
+      for (p = 0; p < sizeof procs / sizeof *procs; p++)
+        if (!run(file_kb, blocks[b], procs[p], direct))
+          return 1;
+  return 0;
+}
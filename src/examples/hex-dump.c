@@ -10,6 +10,9 @@ main (int argc, char *argv[])
 {
   bool success = true;
   int i;
+
+  /* hex_dump() prints a line at a time; write whole buffers. */
+  setvbuf (stdout, NULL, _IOFBF, 4096);
   
   for (i = 1; i < argc; i++) 
     {
@@ -2,51 +2,38 @@
 
    pintos --fs-disk=2 -v -k -p ../examples/line_echo -a line_echo -- -f -q run line_echo
 
-   This program will echo every input line to output.
+   This program will echo every input line to output.  It reads
+   with getline(), which takes a whole line from the terminal with
+   a single read().
  */
 
 #include <stdio.h>
+#include <malloc.h>
 #include <syscall.h>
 
 int mystrlen(char *start);
-int getline(char *buf, int size);
 
 int main(void)
 {
-  char buf[10];
+  char *buf = NULL;
+  size_t size = 0;
   int length;
-  char endl = '\n';
 
   for ( ; ; )
   {
-    length = getline(buf, 10);
-    
-    if (length != mystrlen(buf))
-      exit(111);
+    length = getline(&buf, &size, stdin);
 
     if (length < 1)
       break;
-    
-    write(STDOUT_FILENO, buf, length);
-    write(STDOUT_FILENO, &endl, 1);
-  }
-  
-  return 0;
-}
 
-int getline(char *buf, int size)
-{
-  int i;
-  
-  for (i = 0; i < size-1; ++i)
-  {
-    if (read(STDIN_FILENO, &buf[i], 1) != 1)
-      break;
-    if (buf[i] == '\n')
-      break;
+    if (length != mystrlen(buf))
+      exit(111);
+
+    fwrite(buf, 1, length, stdout);
   }
-  buf[i] = '\0';
-  return i;
+
+  free(buf);
+  return 0;
 }
 
 int mystrlen(char *start)
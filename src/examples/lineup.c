@@ -2,6 +2,15 @@
 
    Converts a file to uppercase in-place.
 
+   lineup FILE          with pread() and pwrite()
+   lineup -m FILE       through a memory mapping, needs VM
+
+   The first travels through the file in 1 kB blocks, reading each
+   and writing it back at the same offset, two system calls per
+   block and no seeks.  The second maps the file, changes it in
+   memory and leaves the write-back to munmap(), so the file is
+   read a page at a time on faults and written once.
+
    Incidentally, another way to do this while avoiding the seeks
    would be to open the input file, then remove() it and reopen
    it under another handle.  Because of Unix deletion semantics
@@ -9,38 +18,82 @@
 
 #include <ctype.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall.h>
 
-int
-main (int argc, char *argv[])
+/* Uppercases the SIZE bytes at BUF. */
+static void
+upcase (char *buf, int size)
 {
-  char buf[1024];
-  int handle;
+  int i;
 
-  if (argc != 2)
-    exit (1);
+  for (i = 0; i < size; i++)
+    buf[i] = toupper ((unsigned char) buf[i]);
+}
 
-  handle = open (argv[1]);
-  if (handle < 0)
-    exit (2);
+/* Uppercases the file open as HANDLE with pread() and pwrite().
+   Returns false if a write fails. */
+static bool
+lineup_pwrite (int handle)
+{
+  char buf[1024];
+  unsigned ofs = 0;
 
   for (;;) 
     {
-      int n, i;
-
-      n = read (handle, buf, sizeof buf);
+      int n = pread (handle, buf, sizeof buf, ofs);
       if (n <= 0)
         break;
 
-      for (i = 0; i < n; i++)
-        buf[i] = toupper ((unsigned char) buf[i]);
+      upcase (buf, n);
+      if (pwrite (handle, buf, n, ofs) != n)
+        {
+          printf ("write failed\n");
+          return false;
+        }
+      ofs += n;
+    }
+  return true;
+}
 
-      seek (handle, tell (handle) - n);
-      if (write (handle, buf, n) != n)
-        printf ("write failed\n");
+/* Uppercases the file open as HANDLE through a mapping.  Returns
+   false if it cannot be mapped. */
+static bool
+lineup_mmap (int handle)
+{
+  char *data = (char *) 0x10000000;
+  int size = filesize (handle);
+  mapid_t map;
+
+  if (size == 0)
+    return true;
+  map = mmap (handle, data);
+  if (map == MAP_FAILED)
+    {
+      printf ("mmap failed\n");
+      return false;
     }
+  upcase (data, size);
+  munmap (map);
+  return true;
+}
+
+int
+main (int argc, char *argv[])
+{
+  bool use_mmap = argc == 3 && !strcmp (argv[1], "-m");
+  bool success;
+  int handle;
+
+  if (argc != 2 && !use_mmap)
+    exit (1);
+
+  handle = open (argv[argc - 1]);
+  if (handle < 0)
+    exit (2);
 
+  success = use_mmap ? lineup_mmap (handle) : lineup_pwrite (handle);
   close (handle);
 
-  return EXIT_SUCCESS;
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,103 @@
+/* Exercises the user allocator: many small blocks of mixed sizes,
+   big blocks, and realloc(), checking that no block overlaps
+   another and that freeing the big blocks gives their pages back
+   to the kernel.
+
+   malloc_test [ROUNDS]
+*/
+
+#include <malloc.h>
+#include <random.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Number of blocks live at once. */
+#define BLOCK_CNT 256
+
+static unsigned char *blocks[BLOCK_CNT];
+static size_t sizes[BLOCK_CNT];
+
+/* Returns true if block I still holds its fill pattern. */
+static bool check(int i)
+{
+  size_t j;
+
+  for (j = 0; j < sizes[i]; j++)
+    if (blocks[i][j] != (unsigned char) (i + j))
+      return false;
+  return true;
+}
+
+/* Replaces block I with a new one of SIZE bytes. */
+static bool replace(int i, size_t size)
+{
+  size_t j;
+
+  if (blocks[i] != NULL && !check(i))
+  {
+    printf("malloc_test: block %d of %zu bytes was overwritten\n",
+           i, sizes[i]);
+    return false;
+  }
+  free(blocks[i]);
+  blocks[i] = malloc(size);
+  sizes[i] = size;
+  if (blocks[i] == NULL)
+  {
+    printf("malloc_test: malloc(%zu) failed\n", size);
+    return false;
+  }
+  for (j = 0; j < size; j++)
+    blocks[i][j] = i + j;
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int rounds = argc > 1 ? atoi(argv[1]) : 4;
+  unsigned char *start = sbrk(0), *peak = start, *p;
+  int r, i;
+
+  random_init(0);
+  for (r = 0; r < rounds; r++)
+    for (i = 0; i < BLOCK_CNT; i++)
+    {
+      /* Mostly small blocks, now and then a big one. */
+      size_t size = (random_ulong() % 8 == 0
+                     ? 4096 + random_ulong() % 20000
+                     : 1 + random_ulong() % 600);
+      if (!replace(random_ulong() % BLOCK_CNT, size))
+        return 1;
+      if ((unsigned char *) sbrk(0) > peak)
+        peak = sbrk(0);
+    }
+
+  /* Grow one block through every size class and beyond. */
+  p = NULL;
+  for (i = 1; i <= 16384; i *= 2)
+  {
+    p = realloc(p, i);
+    if (p == NULL)
+    {
+      printf("malloc_test: realloc to %d bytes failed\n", i);
+      return 1;
+    }
+    p[i - 1] = i;
+    if (i > 1 && p[i / 2 - 1] != (unsigned char) (i / 2))
+    {
+      printf("malloc_test: realloc to %d bytes lost data\n", i);
+      return 1;
+    }
+  }
+  free(p);
+
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (!replace(i, 1))
+      return 1;
+  printf("malloc_test: heap grew to %d kB, %d kB after freeing\n",
+         (int) (peak - start) / 1024,
+         (int) ((unsigned char *) sbrk(0) - start) / 1024);
+  return 0;
+}
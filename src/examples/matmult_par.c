@@ -0,0 +1,142 @@
+/* Multiplies two DIM x DIM matrices, as matmult does, but with
+   the rows of the result split among N child processes that all
+   work on one shared memory segment.  Each child multiplies its
+   rows in TILE x TILE blocks, so that the parts of A, B and C it
+   is working on stay in the CPU cache.  The product is done
+   once with a single child and once with N, default 4, and each
+   run is reported as a BENCH line, so that the two show how well
+   process creation, the frame table and shared memory scale with
+   the CPUs.
+
+   pintos --qemu -p ../examples/matmult_par -a matmult_par -- -q run 'matmult_par 4'
+
+   A child is started as "matmult_par -c ID FIRST LAST", to
+   compute rows FIRST up to LAST of segment ID.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "bench.h"
+
+#define DIM 128                 /* Rows and columns; a multiple of TILE. */
+#define TILE 16                 /* Rows and columns of a block. */
+#define CHILD_MAX 16            /* Most children. */
+
+/* The matrices, at a fixed address in every process. */
+struct matrices
+{
+  int a[DIM][DIM];
+  int b[DIM][DIM];
+  int c[DIM][DIM];
+};
+#define SHARED ((struct matrices *) 0x10000000)
+
+/* Computes rows FIRST up to LAST of C = A * B. */
+static void multiply(struct matrices *m, int first, int last)
+{
+  int i0, j0, k0, i, j, k;
+
+  for (i0 = first; i0 < last; i0 += TILE)
+    for (k0 = 0; k0 < DIM; k0 += TILE)
+      for (j0 = 0; j0 < DIM; j0 += TILE)
+        for (i = i0; i < i0 + TILE && i < last; i++)
+          for (k = k0; k < k0 + TILE; k++)
+          {
+            int a = m->a[i][k];
+            for (j = j0; j < j0 + TILE; j++)
+              m->c[i][j] += a * m->b[k][j];
+          }
+}
+
+/* Computes C with CNT children sharing segment ID, and reports
+   how long that took.  Returns false if a child could not be
+   started or failed. */
+static bool run(int id, int cnt)
+{
+  pid_t pids[CHILD_MAX];
+  char label[32];
+  int64_t start;
+  bool success = true;
+  int i;
+
+  memset(SHARED->c, 0, sizeof SHARED->c);
+  start = bench_start();
+  for (i = 0; i < cnt; i++)
+  {
+    char cmd[64];
+    snprintf(cmd, sizeof cmd, "matmult_par -c %d %d %d",
+             id, DIM * i / cnt, DIM * (i + 1) / cnt);
+    pids[i] = exec(cmd);
+    if (pids[i] == PID_ERROR)
+    {
+      printf("matmult_par: exec failed\n");
+      success = false;
+      break;
+    }
+  }
+  while (i-- > 0)
+    if (wait(pids[i]) != 0)
+      success = false;
+  if (!success)
+    return false;
+
+  snprintf(label, sizeof label, "matmult-%dx%d-p%d", DIM, DIM, cnt);
+  bench_report(label, bench_elapsed(start), (int64_t) DIM * DIM * DIM,
+               "madds");
+  return true;
+}
+
+/* Returns true if C holds A * B, for the A and B set up by
+   main(). */
+static bool check(void)
+{
+  int i, j;
+
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++)
+      if (SHARED->c[i][j] != DIM * i * j)
+      {
+        printf("matmult_par: C[%d][%d] is %d, not %d\n",
+               i, j, SHARED->c[i][j], DIM * i * j);
+        return false;
+      }
+  return true;
+}
+
+int main(int argc, char *argv[])
+{
+  int cnt = argc > 1 ? atoi(argv[1]) : 4;
+  int id, i, j;
+
+  if (argc == 5 && !strcmp(argv[1], "-c"))
+  {
+    if (!shm_attach(atoi(argv[2]), SHARED))
+      return 1;
+    multiply(SHARED, atoi(argv[3]), atoi(argv[4]));
+    return 0;
+  }
+
+  if (cnt < 1 || cnt > CHILD_MAX)
+  {
+    printf("matmult_par: between 1 and %d children\n", CHILD_MAX);
+    return 1;
+  }
+  id = shm_create(sizeof *SHARED, SHARED);
+  if (id < 0)
+  {
+    printf("matmult_par: shm_create failed\n");
+    return 1;
+  }
+  for (i = 0; i < DIM; i++)
+    for (j = 0; j < DIM; j++)
+    {
+      SHARED->a[i][j] = i;
+      SHARED->b[i][j] = j;
+    }
+
+  if (!run(id, 1) || !check() || !run(id, cnt) || !check())
+    return 1;
+  return 0;
+}
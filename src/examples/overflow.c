@@ -21,7 +21,7 @@ int main(void);
 
 /* A messy not very good buffer overflow example. A little bit too
  * contrieved. */
-static int getline (char* destination)
+static int readline (char* destination)
 {
   char line[200];
   int i = 0;
@@ -69,14 +69,14 @@ static int getline (char* destination)
 }
 
 /* Stupid program to echo every line you write to screen. And to make
- * matter worse, getline have a serious buffer overflow. */
+ * matter worse, readline have a serious buffer overflow. */
 int main (void)
 {
   char msg[2000];
   char quote = '"';
   char endl = '\n';
   
-  while ( getline (msg) )
+  while ( readline (msg) )
   {
     write (STDOUT_FILENO, &quote, 1);
     write (STDOUT_FILENO, msg, strlen(msg));
@@ -13,9 +13,13 @@ char buffer[BIG];
 int main(void)
 {
   int bytes, i, j, inconsistency;
-  int id, messages;
+  int id;
+  FILE *messages;
   
-  messages = open("messages");
+  /* Buffered, so the messages go out a buffer at a time. */
+  messages = fdopen(open("messages"), "w");
+  if (messages == NULL)
+    exit(1);
   
   for (i = 0; i < TIMES; ++i)
   {
@@ -25,7 +29,7 @@ int main(void)
     
     if (bytes != BIG)
     {
-      write(messages, "Buffer not filled!\n", 19);
+      fputs("Buffer not filled!\n", messages);
       continue;
     }
     /* now check for consistency */
@@ -34,7 +38,7 @@ int main(void)
       if (buffer[0] != buffer[j])
       {
         /* Ooops, inconsistency */
-	write(messages, "INCONSISTENCY.", 14);
+	fputs("INCONSISTENCY.", messages);
 	printf("INCONSISTENCY\n");
 	inconsistency = 1;
 	break; /* no need to check further */
@@ -42,9 +46,9 @@ int main(void)
     }
     if (!inconsistency)
     {
-      write(messages, "cool\n", 5);
+      fputs("cool\n", messages);
     }
   }
-  close(messages);
+  fclose(messages);
   exit(0);
 }
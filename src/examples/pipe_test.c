@@ -0,0 +1,60 @@
+/* Checks that data written to a pipe comes back out in order,
+   across the wrap-around of the ring buffer, and that the read
+   end sees end of file once the write end is closed. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+
+#define CHUNK 1000
+#define ROUNDS 20
+
+int main(void)
+{
+  static char out[CHUNK], in[CHUNK];
+  int fds[2];
+  int round, i, got;
+
+  if (!pipe(fds))
+  {
+    printf("pipe_test: pipe failed\n");
+    return 1;
+  }
+
+  for (round = 0; round < ROUNDS; round++)
+  {
+    for (i = 0; i < CHUNK; i++)
+      out[i] = round + i;
+    if (write(fds[1], out, CHUNK) != CHUNK)
+    {
+      printf("pipe_test: short write in round %d\n", round);
+      return 1;
+    }
+    for (got = 0; got < CHUNK; )
+    {
+      int n = read(fds[0], in + got, CHUNK - got);
+      if (n <= 0)
+      {
+        printf("pipe_test: read failed in round %d\n", round);
+        return 1;
+      }
+      got += n;
+    }
+    if (memcmp(in, out, CHUNK) != 0)
+    {
+      printf("pipe_test: data mismatch in round %d\n", round);
+      return 1;
+    }
+  }
+
+  close(fds[1]);
+  if (read(fds[0], in, CHUNK) != 0)
+  {
+    printf("pipe_test: no end of file after close\n");
+    return 1;
+  }
+  close(fds[0]);
+
+  printf("pipe_test: ok\n");
+  return 0;
+}
@@ -1,26 +1,65 @@
+/* A small shell.  Besides running one command at a time, it runs
+   pipelines such as "cat file | grep x | wc", with each stage's
+   stdout connected to the next stage's stdin through a pipe and all
+   the stages running at once, and background jobs, started with a
+   trailing "&" and collected with the "wait" builtin. */
+
 #include <stdbool.h>
 #include <stdio.h>
 #include <string.h>
 #include <syscall.h>
 
-static void read_line (char line[], size_t);
-static bool backspace (char **pos, char line[]);
+#define STAGE_MAX 8             /* Most commands in a pipeline. */
+#define JOB_MAX 16              /* Most background processes. */
+
+/* A background process, not yet waited for. */
+struct job
+  {
+    pid_t pid;                  /* PID_ERROR if the slot is free. */
+    char command[80];           /* Its command, for messages. */
+  };
+static struct job jobs[JOB_MAX];
+static int job_cnt;
+
+static char *read_line (void);
+static char *trim (char *);
+static void run_pipeline (char *command, bool background);
+static void wait_jobs (void);
 
 int
 main (void)
 {
+  int i;
+
+  for (i = 0; i < JOB_MAX; i++)
+    jobs[i].pid = PID_ERROR;
+
   printf ("Shell starting...\n");
   for (;;) 
     {
-      char command[80];
+      char *command;
+      size_t len;
+      bool background = false;
 
       /* Read command. */
       printf ("--");
-      read_line (command, sizeof command);
+      command = read_line ();
+      if (command == NULL)
+        break;
+      command = trim (command);
+      len = strlen (command);
+      if (len > 0 && command[len - 1] == '&')
+        {
+          background = true;
+          command[len - 1] = '\0';
+          command = trim (command);
+        }
       
       /* Execute command. */
       if (!strcmp (command, "exit"))
         break;
+      else if (!strcmp (command, "wait"))
+        wait_jobs ();
       else if (!memcmp (command, "cd ", 3)) 
         {
           if (!chdir (command + 3))
@@ -31,74 +70,164 @@ main (void)
           /* Empty command. */
         }
       else
-        {
-          pid_t pid = exec (command);
-          if (pid != PID_ERROR)
-            printf ("\"%s\": exit code %d\n", command, wait (pid));
-          else
-            printf ("exec failed\n");
-        }
+        run_pipeline (command, background);
     }
 
   printf ("Shell exiting.");
   return EXIT_SUCCESS;
 }
 
-/* Reads a line of input from the user into LINE, which has room
-   for SIZE bytes.  Handles backspace and Ctrl+U in the ways
-   expected by Unix users.  On return, LINE will always be
-   null-terminated and will not end in a new-line character. */
+/* Reads a line of input from the user and returns it, without
+   its new-line, or a null pointer at end of input.  The kernel's
+   terminal echoes the line and handles backspace and Ctrl+U, and
+   hands it over whole, so getline() reads it with one system call.
+   The line is good until the next call. */
+static char *
+read_line (void) 
+{
+  static char *line;
+  static size_t size;
+  int len = getline (&line, &size, stdin);
+
+  if (len < 0)
+    return NULL;
+  if (len > 0 && line[len - 1] == '\n')
+    line[len - 1] = '\0';
+  return line;
+}
+
+/* Returns S without its leading and trailing spaces, which are
+   cut off in place. */
+static char *
+trim (char *s)
+{
+  char *end;
+
+  while (*s == ' ')
+    s++;
+  end = s + strlen (s);
+  while (end > s && end[-1] == ' ')
+    *--end = '\0';
+  return s;
+}
+
+/* Remembers PID, running COMMAND in the background.  Returns
+   false if the job table is full. */
+static bool
+add_job (pid_t pid, const char *command)
+{
+  int i;
+
+  for (i = 0; i < JOB_MAX; i++)
+    if (jobs[i].pid == PID_ERROR)
+      {
+        jobs[i].pid = pid;
+        strlcpy (jobs[i].command, command, sizeof jobs[i].command);
+        job_cnt++;
+        printf ("[%d] %s\n", pid, command);
+        return true;
+      }
+  return false;
+}
+
+/* Runs the stages of COMMAND, separated by "|", each with its
+   stdout piped to the next one's stdin.  Unless BACKGROUND, waits
+   for all of them and reports the exit code of the last. */
 static void
-read_line (char line[], size_t size) 
+run_pipeline (char *command, bool background)
 {
-  char *pos = line;
-  for (;;)
-    {
-      char c;
-      read (STDIN_FILENO, &c, 1);
+  char *stages[STAGE_MAX];
+  pid_t pids[STAGE_MAX];
+  char *stage, *save_ptr;
+  int in_fd = STDIN_FILENO;
+  int cnt = 0;
+  int i;
 
-      switch (c) 
+  for (stage = strtok_r (command, "|", &save_ptr); stage != NULL;
+       stage = strtok_r (NULL, "|", &save_ptr))
+    {
+      if (cnt == STAGE_MAX)
+        {
+          printf ("more than %d commands in a pipeline\n", STAGE_MAX);
+          return;
+        }
+      stages[cnt] = trim (stage);
+      if (stages[cnt][0] == '\0')
         {
-        case '\r':
-          *pos = '\0';
-          putchar ('\n');
+          printf ("empty command in pipeline\n");
           return;
+        }
+      cnt++;
+    }
 
-        case '\b':
-          backspace (&pos, line);
-          break;
+  /* Start all the stages before waiting for any, so that they run
+     at once.  Each one gets its own copies of the pipe ends, so the
+     shell closes its own as soon as they are handed over; a stage
+     then sees end of file once the stage before it has exited. */
+  for (i = 0; i < cnt; i++)
+    {
+      bool last = i == cnt - 1;
+      int fds[2] = { STDIN_FILENO, STDOUT_FILENO };
 
-        case ('U' - 'A') + 1:       /* Ctrl+U. */
-          while (backspace (&pos, line))
-            continue;
+      if (!last && !pipe (fds))
+        {
+          printf ("pipe failed\n");
           break;
-
-        default:
-          /* Add character to line. */
-          if (pos < line + size - 1) 
-            {
-              putchar (c);
-              *pos++ = c;
-            }
+        }
+      pids[i] = exec_stdio (stages[i], in_fd, fds[1]);
+      if (in_fd != STDIN_FILENO)
+        close (in_fd);
+      if (!last)
+        close (fds[1]);
+      in_fd = fds[0];
+      if (pids[i] == PID_ERROR)
+        {
+          printf ("\"%s\": exec failed\n", stages[i]);
           break;
         }
     }
+  if (in_fd != STDIN_FILENO)
+    close (in_fd);
+
+  /* I is the number of stages started. */
+  if (background && i == cnt)
+    {
+      while (i-- > 0)
+        if (!add_job (pids[i], stages[i]))
+          {
+            printf ("too many jobs, waiting for \"%s\"\n", stages[i]);
+            wait (pids[i]);
+          }
+      return;
+    }
+  while (i-- > 0)
+    {
+      int status = wait (pids[i]);
+      if (i == cnt - 1)
+        printf ("\"%s\": exit code %d\n", stages[i], status);
+    }
 }
 
-/* If *POS is past the beginning of LINE, backs up one character
-   position.  Returns true if successful, false if nothing was
-   done. */
-static bool
-backspace (char **pos, char line[]) 
+/* Waits for all the background jobs, in the order they finish. */
+static void
+wait_jobs (void)
 {
-  if (*pos > line)
+  while (job_cnt > 0)
     {
-      /* Back up cursor, overwrite character, back up
-         again. */
-      printf ("\b \b");
-      (*pos)--;
-      return true;
+      int status;
+      pid_t pid = wait_any (&status);
+      int i;
+
+      if (pid == PID_ERROR)
+        break;
+      for (i = 0; i < JOB_MAX; i++)
+        if (jobs[i].pid == pid)
+          {
+            printf ("[%d] \"%s\": exit code %d\n",
+                    pid, jobs[i].command, status);
+            jobs[i].pid = PID_ERROR;
+            job_cnt--;
+            break;
+          }
     }
-  else
-    return false;
 }
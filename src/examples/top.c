@@ -0,0 +1,164 @@
+/* Samples the kernel's counters with stats() and prints, for each
+   interval, where CPU time went and how busy the scheduler, memory,
+   disk and system calls were.
+
+   top [COUNT [INTERVAL_MS [COMMAND]]]
+
+   takes COUNT samples (default 10) INTERVAL_MS apart (default
+   1000), after starting COMMAND, if given, to have something to
+   watch.
+
+   pintos --qemu -p ../examples/top -a top -p ../examples/bench_io -a bench_io -- -f -q run 'top 5 1000 bench_io'
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Number of busiest system calls to list per sample. */
+#define TOP_CALLS 3
+
+static struct stats prev, cur;
+
+/* Returns PART as a percentage of WHOLE. */
+static int pct(long long part, long long whole)
+{
+  return whole > 0 ? part * 100 / whole : 0;
+}
+
+/* Prints the busiest system calls between PREV and CUR. */
+static void print_calls(void)
+{
+  bool shown[STATS_SYSCALLS];
+  unsigned i, n;
+
+  memset(shown, 0, sizeof shown);
+  printf("  calls:");
+  for (n = 0; n < TOP_CALLS; n++)
+  {
+    long long best_cnt = 0;
+    unsigned best = 0;
+    for (i = 0; i < cur.syscall_cnt; i++)
+    {
+      long long cnt = cur.syscalls[i].calls - prev.syscalls[i].calls;
+      if (!shown[i] && cnt > best_cnt)
+      {
+        best = i;
+        best_cnt = cnt;
+      }
+    }
+    if (best_cnt == 0)
+      break;
+    shown[best] = true;
+    printf(" #%u x%lld", best, best_cnt);
+  }
+  printf("\n");
+}
+
+/* Prints the page faults between PREV and CUR by class, with
+   their average latency. */
+static void print_faults(void)
+{
+  static const char *names[FAULT_CLASS_CNT] =
+    {"file", "zero", "swap", "stack", "cow", "invalid"};
+  int c;
+
+  printf("  faults:");
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+  {
+    long long cnt = cur.faults[c].cnt - prev.faults[c].cnt;
+    int64_t ns = cur.faults[c].ns - prev.faults[c].ns;
+    if (cnt > 0)
+      printf(" %s %lld (%lld us)", names[c], cnt,
+             (long long) (ns / cnt / 1000));
+  }
+  printf("\n");
+}
+
+/* Prints the external interrupts between PREV and CUR by IRQ
+   line, with their average cost. */
+static void print_irqs(void)
+{
+  int i;
+
+  printf("  irqs:");
+  for (i = 0; i < STATS_IRQS; i++)
+  {
+    long long cnt = cur.irqs[i].cnt - prev.irqs[i].cnt;
+    uint64_t cycles = cur.irqs[i].cycles - prev.irqs[i].cycles;
+    if (cnt > 0)
+      printf(" %d x%lld (%lld cycles)", i, cnt,
+             (long long) (cycles / cnt));
+  }
+  printf("\n");
+}
+
+/* Prints the change between PREV and CUR. */
+static void print_sample(void)
+{
+  long long ticks = ((cur.idle_ticks - prev.idle_ticks)
+                     + (cur.kernel_ticks - prev.kernel_ticks)
+                     + (cur.user_ticks - prev.user_ticks));
+  long long hits = cur.disk.hit_cnt - prev.disk.hit_cnt;
+  long long misses = cur.disk.miss_cnt - prev.disk.miss_cnt;
+
+  printf("cpu %3d%% user %3d%% kernel %3d%% idle | %d threads, %d ready"
+         " | %lld switches (%lld preempted)\n",
+         pct(cur.user_ticks - prev.user_ticks, ticks),
+         pct(cur.kernel_ticks - prev.kernel_ticks, ticks),
+         pct(cur.idle_ticks - prev.idle_ticks, ticks),
+         cur.thread_cnt, cur.ready_cnt,
+         cur.switch_cnt - prev.switch_cnt,
+         cur.preempt_cnt - prev.preempt_cnt);
+  printf("  mem: %u/%u kernel and %u/%u user pages free,"
+         " %u arena + %u big malloc pages, %lld faults\n",
+         cur.kernel_free_pages, cur.kernel_pages,
+         cur.user_free_pages, cur.user_pages,
+         cur.malloc_arenas, cur.malloc_big_pages,
+         cur.page_fault_cnt - prev.page_fault_cnt);
+  printf("  pressure: %lld allocations under %u pages, %lld frames"
+         " reclaimed, %lld execs waited %lld ticks\n",
+         cur.pressure_cnt - prev.pressure_cnt, cur.user_low_pages,
+         cur.reclaim_cnt - prev.reclaim_cnt,
+         cur.exec_wait_cnt - prev.exec_wait_cnt,
+         cur.exec_wait_ticks - prev.exec_wait_ticks);
+  printf("  disk: %lld sectors read, %lld written, %lld commands,"
+         " cache %d%% of %lld lookups hit\n",
+         cur.disk.read_cnt - prev.disk.read_cnt,
+         cur.disk.write_cnt - prev.disk.write_cnt,
+         cur.disk.cmd_cnt - prev.disk.cmd_cnt,
+         pct(hits, hits + misses), hits + misses);
+  print_irqs();
+  print_faults();
+  print_calls();
+}
+
+int main(int argc, char *argv[])
+{
+  int count = argc > 1 ? atoi(argv[1]) : 10;
+  int interval = argc > 2 ? atoi(argv[2]) : 1000;
+  int i;
+
+  if (stats(&prev, sizeof prev) != sizeof prev
+      || prev.version != STATS_VERSION)
+  {
+    printf("top: kernel stats version %u, expected %u\n",
+           prev.version, STATS_VERSION);
+    return 1;
+  }
+  if (argc > 3 && exec(argv[3]) < 0)
+  {
+    printf("top: cannot run %s\n", argv[3]);
+    return 1;
+  }
+
+  for (i = 0; i < count; i++)
+  {
+    sleep(interval);
+    stats(&cur, sizeof cur);
+    print_sample();
+    prev = cur;
+  }
+  return 0;
+}
@@ -0,0 +1,709 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <ohash.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tunable.h"
+
+/* Buffer cache.  Keeps the CACHE_SIZE most recently used sectors
+   of the file system disk in memory and writes modified sectors
+   back only when they are evicted or when the cache is flushed.
+
+   Each entry is either free, being filled from disk ("loading"),
+   or holds valid data.  An entry is pinned while some thread
+   copies data to or from it, and pinned entries are never
+   evicted.  Disk I/O is done without holding CACHE_LOCK so that
+   hits on other sectors are not held up by a slow transfer.
+
+   A sector that belongs to a journal transaction that has not
+   committed yet is "held": it is neither evicted nor written
+   back until the journal releases it.
+
+   A write-behind daemon flushes dirty sectors periodically, so
+   dirty data rarely has to be written back by the thread that
+   needs its entry, and a read-ahead daemon loads sectors that
+   sequential readers are expected to need soon.
+
+   CACHE_INDEX maps each assigned sector, and the old sector of
+   each entry being evicted, to its entry, so that a lookup need
+   not touch every entry. */
+
+/* Timer ticks between periodic flushes of dirty sectors. */
+#define WRITE_BEHIND_INTERVAL TIMER_FREQ
+
+/* A cached disk sector. */
+struct cache_entry
+  {
+    disk_sector_t sector;               /* Sector held, if IN_USE. */
+    bool in_use;                        /* True if SECTOR is assigned. */
+    bool loading;                       /* True while DATA is not valid. */
+    bool dirty;                         /* True if DATA differs on disk. */
+    bool accessed;                      /* Reference bit for the clock. */
+    int pin_cnt;                        /* Number of users of DATA. */
+    bool held;                          /* Held by the journal? */
+
+    /* Set while the previous contents of DATA are being written
+       back to OLD_SECTOR during eviction. */
+    bool evicting;
+    disk_sector_t old_sector;
+
+    uint8_t data[DISK_SECTOR_SIZE];     /* Sector contents. */
+  };
+
+static struct cache_entry cache[CACHE_SIZE];
+
+/* Number of entries in use, tunable as "cache_sectors" to try a
+   smaller cache.  A fetch pins up to CACHE_FETCH_MAX entries at
+   once, so there must be room beyond that. */
+static int cache_cnt = CACHE_SIZE;
+static struct lock cache_lock;          /* Protects all entry metadata. */
+static struct condition cache_changed;  /* Signaled on unpin or load. */
+static size_t clock_hand;               /* Next eviction candidate. */
+static struct ohash cache_index;        /* Sector to entry. */
+
+/* Buffer for multi-sector reads, and requests for writing back
+   the entries they replace.  FETCH_LOCK serializes their use;
+   the reads would be serialized by the disk anyway. */
+static uint8_t fetch_buf[CACHE_FETCH_MAX * DISK_SECTOR_SIZE];
+static struct disk_request fetch_reqs[CACHE_FETCH_MAX];
+static struct lock fetch_lock;
+
+/* Write requests for cache_flush(), which FLUSH_LOCK
+   serializes. */
+static struct disk_request flush_reqs[CACHE_SIZE];
+static struct lock flush_lock;
+
+/* Read-ahead requests, a ring of runs of sectors to be loaded
+   into the cache by the read-ahead daemon.  Requests that do not
+   fit are dropped; read-ahead is only a hint. */
+#define READ_AHEAD_QUEUE 32
+struct read_ahead
+  {
+    disk_sector_t sector;               /* First sector. */
+    size_t cnt;                         /* Number of sectors. */
+  };
+static struct read_ahead read_ahead_queue[READ_AHEAD_QUEUE];
+static size_t read_ahead_head;          /* Next request to serve. */
+static size_t read_ahead_cnt;           /* Number of queued requests. */
+static struct lock read_ahead_lock;     /* Protects the queue. */
+static struct condition read_ahead_ready; /* Signaled on new request. */
+
+/* Statistics. */
+static long long hit_cnt;               /* Lookups found in the cache. */
+static long long miss_cnt;              /* Lookups that needed a slot. */
+static long long evict_cnt;             /* Valid sectors replaced. */
+static long long prefetch_cnt;          /* Sectors loaded by read-ahead. */
+static long long fresh_cnt;             /* Partial writes that read nothing. */
+
+static struct cache_entry *cache_lookup (disk_sector_t, bool *busy);
+static struct cache_entry *cache_get (disk_sector_t, bool fill);
+static void cache_claim (struct cache_entry *, disk_sector_t);
+static struct cache_entry *cache_load (struct cache_entry *,
+                                       disk_sector_t, bool fill);
+static void cache_end_eviction (struct cache_entry *);
+static void cache_put (struct cache_entry *, bool dirty);
+static void cache_fetch_run (disk_sector_t, size_t, long long *loaded_cnt);
+static thread_func read_ahead_daemon NO_RETURN;
+static thread_func write_behind_daemon NO_RETURN;
+
+/* Initializes the buffer cache. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  tunable_register ("cache_sectors", &cache_cnt, 2 * CACHE_FETCH_MAX,
+                    CACHE_SIZE);
+  lock_init_named (&cache_lock, "cache");
+  cond_init (&cache_changed);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      cache[i].in_use = false;
+      cache[i].loading = false;
+      cache[i].dirty = false;
+      cache[i].accessed = false;
+      cache[i].evicting = false;
+      cache[i].pin_cnt = 0;
+      cache[i].held = false;
+    }
+  clock_hand = 0;
+
+  /* Each entry has at most two sectors, so the index never has to
+     grow. */
+  if (!ohash_init (&cache_index, 2 * CACHE_SIZE))
+    PANIC ("cache_init: out of memory");
+  hit_cnt = miss_cnt = evict_cnt = prefetch_cnt = 0;
+  lock_init (&fetch_lock);
+  lock_init (&flush_lock);
+
+  lock_init (&read_ahead_lock);
+  cond_init (&read_ahead_ready);
+  read_ahead_head = read_ahead_cnt = 0;
+  thread_create_daemon ("read-ahead", PRI_DEFAULT, read_ahead_daemon, NULL);
+  thread_create_daemon ("write-behind", PRI_DEFAULT,
+                        write_behind_daemon, NULL);
+}
+
+/* Reads sector SECTOR into BUFFER, which must have room for
+   DISK_SECTOR_SIZE bytes. */
+void
+cache_read (disk_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Writes the DISK_SECTOR_SIZE bytes in BUFFER to sector
+   SECTOR.  The data reaches the disk when the sector is evicted
+   or the cache is flushed. */
+void
+cache_write (disk_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, DISK_SECTOR_SIZE);
+}
+
+/* Copies SIZE bytes starting at byte offset OFS within sector
+   SECTOR into BUFFER. */
+void
+cache_read_at (disk_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+  e = cache_get (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  cache_put (e, false);
+}
+
+/* Copies SIZE bytes from BUFFER into sector SECTOR, starting at
+   byte offset OFS within the sector.  Only a partial write needs
+   the old sector contents to be read from disk first. */
+void
+cache_write_at (disk_sector_t sector, const void *buffer,
+                size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+  e = cache_get (sector, ofs != 0 || size != DISK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  cache_put (e, true);
+}
+
+/* Copies SIZE bytes from BUFFER into sector SECTOR, starting at
+   byte offset OFS within the sector, as cache_write_at() does, but
+   clears the rest of the sector instead of reading it from disk.
+   For a sector none of whose old contents matter, such as the
+   next sector of a file being appended to in small pieces. */
+void
+cache_write_fresh (disk_sector_t sector, const void *buffer,
+                   size_t ofs, size_t size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+
+  e = cache_get (sector, false);
+  memset (e->data, 0, ofs);
+  memcpy (e->data + ofs, buffer, size);
+  memset (e->data + ofs + size, 0, DISK_SECTOR_SIZE - ofs - size);
+  if (ofs != 0 || size != DISK_SECTOR_SIZE)
+    fresh_cnt++;
+  cache_put (e, true);
+}
+
+/* Brings the CNT consecutive sectors starting at SECTOR into the
+   cache, reading the ones that are missing with as few
+   multi-sector transfers as possible, so that reading them
+   afterward with cache_read_at() does not go to disk one sector
+   at a time.  This is only an optimization: sectors may be
+   skipped if the cache is too busy. */
+void
+cache_fetch (disk_sector_t sector, size_t cnt)
+{
+  cache_fetch_run (sector, cnt, &miss_cnt);
+}
+
+/* Asks the read-ahead daemon to bring the CNT consecutive sectors
+   starting at SECTOR into the cache in the background.  Returns
+   immediately. */
+void
+cache_read_ahead (disk_sector_t sector, size_t cnt)
+{
+  lock_acquire (&read_ahead_lock);
+  if (read_ahead_cnt < READ_AHEAD_QUEUE)
+    {
+      size_t tail = (read_ahead_head + read_ahead_cnt) % READ_AHEAD_QUEUE;
+      read_ahead_queue[tail].sector = sector;
+      read_ahead_queue[tail].cnt = cnt;
+      read_ahead_cnt++;
+      cond_signal (&read_ahead_ready, &read_ahead_lock);
+    }
+  lock_release (&read_ahead_lock);
+}
+
+/* Completion function for asynchronous writes: ups the semaphore
+   passed as AUX. */
+static void
+write_done (struct disk_request *r UNUSED, void *aux)
+{
+  sema_up (aux);
+}
+
+/* Brings SECTOR into the cache and holds it there, unwritten,
+   until cache_unhold() is called. */
+void
+cache_hold (disk_sector_t sector)
+{
+  struct cache_entry *e = cache_get (sector, true);
+
+  lock_acquire (&cache_lock);
+  e->held = true;
+  lock_release (&cache_lock);
+  cache_put (e, false);
+}
+
+/* Releases SECTOR, held by cache_hold(), so that it can be
+   written back and evicted again. */
+void
+cache_unhold (disk_sector_t sector)
+{
+  struct cache_entry *e;
+  bool busy;
+
+  lock_acquire (&cache_lock);
+  e = cache_lookup (sector, &busy);
+  ASSERT (e != NULL && e->held);
+  e->held = false;
+  cond_broadcast (&cache_changed, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Writes SECTOR back to disk now if it is cached, dirty, and not
+   held.  Returns once the write is done. */
+void
+cache_write_back (disk_sector_t sector)
+{
+  struct cache_entry *e;
+  bool busy;
+
+  lock_acquire (&cache_lock);
+  e = cache_lookup (sector, &busy);
+  if (e != NULL && !busy && e->dirty && !e->held)
+    {
+      e->pin_cnt++;
+      e->dirty = false;
+      lock_release (&cache_lock);
+
+      disk_write (filesys_disk, e->sector, e->data);
+
+      lock_acquire (&cache_lock);
+      e->pin_cnt--;
+      cond_broadcast (&cache_changed, &cache_lock);
+    }
+  lock_release (&cache_lock);
+}
+
+/* Drops the CNT sectors starting at SECTOR from the cache, so
+   that a transfer that bypasses the cache neither reads stale
+   data from disk nor leaves stale data cached.  Dirty sectors
+   are written back first, unless DISCARD is true because the
+   caller is about to overwrite all of them on disk.  Waits for
+   entries in the range that are in use.  Held sectors are
+   left alone. */
+void
+cache_invalidate (disk_sector_t sector, size_t cnt, bool discard)
+{
+  size_t i = 0;
+
+  lock_acquire (&cache_lock);
+  while (i < (size_t) cache_cnt)
+    {
+      struct cache_entry *e = &cache[i];
+      bool match = e->in_use && !e->held && e->sector - sector < cnt;
+
+      if ((e->evicting && e->old_sector - sector < cnt)
+          || (match && (e->pin_cnt > 0 || e->loading)))
+        {
+          cond_wait (&cache_changed, &cache_lock);
+          continue;
+        }
+      if (match && e->dirty && !discard)
+        {
+          /* Write it back, then look at it again: it may have
+             been used meanwhile. */
+          e->pin_cnt++;
+          e->dirty = false;
+          lock_release (&cache_lock);
+          disk_write (filesys_disk, e->sector, e->data);
+          lock_acquire (&cache_lock);
+          e->pin_cnt--;
+          cond_broadcast (&cache_changed, &cache_lock);
+          continue;
+        }
+      if (match)
+        {
+          ohash_delete (&cache_index, e->sector);
+          e->in_use = false;
+          e->dirty = false;
+        }
+      i++;
+    }
+  lock_release (&cache_lock);
+}
+
+/* Writes every dirty sector in the cache back to disk.  All of
+   the writes are submitted at once, so the disk serves them in
+   sector order and merges adjacent ones.  Returns once all
+   sectors that were dirty on entry have been written.  Held
+   sectors are skipped. */
+void
+cache_flush (void)
+{
+  struct cache_entry *dirty[CACHE_SIZE];
+  struct semaphore done;
+  size_t dirty_cnt = 0;
+  size_t i;
+
+  lock_acquire (&flush_lock);
+  sema_init (&done, 0);
+  lock_acquire (&cache_lock);
+
+  /* Collect and pin the dirty entries.  Pinning keeps them from
+     being evicted while we work.  Clearing DIRTY before the write
+     means that a write that races with ours marks the sector
+     dirty again. */
+  for (i = 0; i < (size_t) cache_cnt; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      if (e->in_use && e->dirty && !e->loading && !e->held)
+        {
+          e->pin_cnt++;
+          e->dirty = false;
+          disk_request_init (&flush_reqs[dirty_cnt], filesys_disk, e->sector,
+                             1, e->data, true, write_done, &done);
+          dirty[dirty_cnt++] = e;
+        }
+    }
+  lock_release (&cache_lock);
+
+  /* Write them. */
+  for (i = 0; i < dirty_cnt; i++)
+    disk_submit (&flush_reqs[i]);
+  for (i = 0; i < dirty_cnt; i++)
+    sema_down (&done);
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < dirty_cnt; i++)
+    dirty[i]->pin_cnt--;
+  cond_broadcast (&cache_changed, &cache_lock);
+  lock_release (&cache_lock);
+  lock_release (&flush_lock);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %lld hits, %lld misses, %lld evictions, "
+          "%lld read-aheads, %lld fresh partial writes\n",
+          hit_cnt, miss_cnt, evict_cnt, prefetch_cnt, fresh_cnt);
+}
+
+/* Fills in the cache fields of *S. */
+void
+cache_get_stats (struct disk_stats *s)
+{
+  s->hit_cnt = hit_cnt;
+  s->miss_cnt = miss_cnt;
+  s->evict_cnt = evict_cnt;
+  s->prefetch_cnt = prefetch_cnt;
+}
+
+/* Returns the entry holding SECTOR, or a null pointer if SECTOR
+   is not cached.  Sets *BUSY to true if an entry for SECTOR
+   exists but cannot be used yet because it is being loaded or
+   written back.  CACHE_LOCK must be held. */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector, bool *busy)
+{
+  struct cache_entry *e = ohash_find (&cache_index, sector);
+
+  *busy = false;
+  if (e == NULL)
+    return NULL;
+  if (e->evicting && e->old_sector == sector)
+    {
+      *busy = true;
+      return NULL;
+    }
+  ASSERT (e->in_use && e->sector == sector);
+  *busy = e->loading;
+  return e;
+}
+
+/* Chooses an unpinned entry to reuse, using the clock algorithm.
+   Returns a null pointer if every entry is pinned.  CACHE_LOCK
+   must be held. */
+static struct cache_entry *
+cache_choose_victim (void)
+{
+  size_t i;
+
+  for (i = 0; i < 2 * (size_t) cache_cnt; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % cache_cnt;
+
+      if (e->pin_cnt > 0 || e->held)
+        continue;
+      if (!e->in_use)
+        return e;
+      if (e->accessed)
+        e->accessed = false;
+      else
+        return e;
+    }
+  return NULL;
+}
+
+/* Returns a pinned entry for SECTOR.  If FILL is true, the entry
+   holds the sector's current contents.  Otherwise, a newly
+   loaded entry's data is undefined and the caller must overwrite
+   all of it before calling cache_put(). */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool fill)
+{
+  struct cache_entry *e;
+  bool busy;
+
+  lock_acquire (&cache_lock);
+  for (;;)
+    {
+      e = cache_lookup (sector, &busy);
+      if (busy)
+        {
+          cond_wait (&cache_changed, &cache_lock);
+          continue;
+        }
+      if (e != NULL)
+        {
+          hit_cnt++;
+          e->accessed = true;
+          e->pin_cnt++;
+          lock_release (&cache_lock);
+          return e;
+        }
+
+      e = cache_choose_victim ();
+      if (e != NULL)
+        break;
+      cond_wait (&cache_changed, &cache_lock);
+    }
+
+  miss_cnt++;
+  return cache_load (e, sector, fill);
+}
+
+/* Reassigns victim entry E, chosen by cache_choose_victim(), to
+   SECTOR and pins it.  Other lookups of SECTOR will wait for
+   LOADING to clear.  If E's old contents are dirty, sets
+   EVICTING, and lookups of the old sector will wait for it to
+   clear; the caller must write the old contents back to
+   OLD_SECTOR before reusing E's data.  CACHE_LOCK must be
+   held. */
+static void
+cache_claim (struct cache_entry *e, disk_sector_t sector)
+{
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+  ASSERT (e->pin_cnt == 0);
+
+  if (e->in_use)
+    evict_cnt++;
+  e->evicting = e->in_use && e->dirty;
+  if (e->in_use && !e->evicting)
+    ohash_delete (&cache_index, e->sector);
+  e->old_sector = e->sector;
+  e->sector = sector;
+  e->in_use = true;
+  ohash_insert (&cache_index, sector, e);
+  e->loading = true;
+  e->dirty = false;
+  e->accessed = true;
+  e->pin_cnt = 1;
+}
+
+/* Notes that the old contents of entry E, if it was evicting
+   them, have been written back, so that lookups of the old sector
+   no longer find E.  CACHE_LOCK must be held. */
+static void
+cache_end_eviction (struct cache_entry *e)
+{
+  if (e->evicting)
+    {
+      ohash_delete (&cache_index, e->old_sector);
+      e->evicting = false;
+    }
+}
+
+/* Reassigns victim entry E, chosen by cache_choose_victim(), to
+   SECTOR, writing back its old contents first if they are dirty,
+   and returns E pinned.  If FILL is true, reads SECTOR into E.
+   CACHE_LOCK must be held on entry; it is released on return. */
+static struct cache_entry *
+cache_load (struct cache_entry *e, disk_sector_t sector, bool fill)
+{
+  cache_claim (e, sector);
+  lock_release (&cache_lock);
+
+  if (e->evicting)
+    disk_write (filesys_disk, e->old_sector, e->data);
+  if (fill)
+    disk_read (filesys_disk, sector, e->data);
+
+  lock_acquire (&cache_lock);
+  cache_end_eviction (e);
+  if (fill)
+    e->loading = false;
+  cond_broadcast (&cache_changed, &cache_lock);
+  lock_release (&cache_lock);
+  return e;
+}
+
+/* Unpins entry E, obtained from cache_get().  If DIRTY is true,
+   E's data has been modified and must eventually be written
+   back. */
+static void
+cache_put (struct cache_entry *e, bool dirty)
+{
+  lock_acquire (&cache_lock);
+  ASSERT (e->pin_cnt > 0);
+  if (dirty)
+    e->dirty = true;
+  e->loading = false;
+  e->pin_cnt--;
+  cond_broadcast (&cache_changed, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Loads those of the CNT sectors starting at SECTOR that are not
+   already cached, reading each run of up to CACHE_FETCH_MAX consecutive
+   missing sectors with one disk_read_multiple() call, and adds
+   the number of sectors loaded to *LOADED_CNT.  Skips sectors
+   that are being loaded or written back, and gives up once every
+   entry is pinned; never waits for another thread's sector. */
+static void
+cache_fetch_run (disk_sector_t sector, size_t cnt, long long *loaded_cnt)
+{
+  lock_acquire (&fetch_lock);
+  lock_acquire (&cache_lock);
+  while (cnt > 0)
+    {
+      struct cache_entry *run[CACHE_FETCH_MAX];
+      disk_sector_t first = sector;
+      struct semaphore done;
+      size_t run_cnt = 0;
+      size_t wb_cnt;
+      size_t i;
+
+      /* Claim entries for a run of consecutive missing sectors. */
+      for (; cnt > 0 && run_cnt < CACHE_FETCH_MAX; sector++, cnt--)
+        {
+          struct cache_entry *e;
+          bool busy;
+
+          if (cache_lookup (sector, &busy) != NULL || busy)
+            {
+              if (run_cnt > 0)
+                break;
+              continue;
+            }
+          e = cache_choose_victim ();
+          if (e == NULL)
+            {
+              cnt = 0;
+              break;
+            }
+          if (run_cnt == 0)
+            first = sector;
+          cache_claim (e, sector);
+          run[run_cnt++] = e;
+        }
+      if (run_cnt == 0)
+        continue;
+
+      /* Write back the old contents, all at once, and read the
+         run. */
+      lock_release (&cache_lock);
+      sema_init (&done, 0);
+      for (i = wb_cnt = 0; i < run_cnt; i++)
+        if (run[i]->evicting)
+          {
+            disk_request_init (&fetch_reqs[wb_cnt], filesys_disk,
+                               run[i]->old_sector, 1, run[i]->data, true,
+                               write_done, &done);
+            disk_submit (&fetch_reqs[wb_cnt++]);
+          }
+      for (i = 0; i < wb_cnt; i++)
+        sema_down (&done);
+      disk_read_multiple (filesys_disk, first, run_cnt, fetch_buf);
+      for (i = 0; i < run_cnt; i++)
+        memcpy (run[i]->data, fetch_buf + i * DISK_SECTOR_SIZE,
+                DISK_SECTOR_SIZE);
+      lock_acquire (&cache_lock);
+
+      for (i = 0; i < run_cnt; i++)
+        {
+          cache_end_eviction (run[i]);
+          run[i]->loading = false;
+          run[i]->pin_cnt--;
+        }
+      *loaded_cnt += run_cnt;
+      cond_broadcast (&cache_changed, &cache_lock);
+    }
+  lock_release (&cache_lock);
+  lock_release (&fetch_lock);
+}
+
+/* Serves read-ahead requests queued by cache_read_ahead(). */
+static void
+read_ahead_daemon (void *aux UNUSED)
+{
+  disk_set_io_class (DISK_IO_IDLE);
+  for (;;)
+    {
+      struct read_ahead ra;
+
+      lock_acquire (&read_ahead_lock);
+      while (read_ahead_cnt == 0)
+        cond_wait (&read_ahead_ready, &read_ahead_lock);
+      ra = read_ahead_queue[read_ahead_head];
+      read_ahead_head = (read_ahead_head + 1) % READ_AHEAD_QUEUE;
+      read_ahead_cnt--;
+      lock_release (&read_ahead_lock);
+
+      cache_fetch_run (ra.sector, ra.cnt, &prefetch_cnt);
+    }
+}
+
+/* Periodically commits the journal and writes dirty sectors back
+   to disk. */
+static void
+write_behind_daemon (void *aux UNUSED)
+{
+  disk_set_io_class (DISK_IO_IDLE);
+  for (;;)
+    {
+      timer_sleep (WRITE_BEHIND_INTERVAL);
+      journal_commit ();
+      cache_flush ();
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+/* Number of sectors held by the buffer cache. */
+#define CACHE_SIZE 64
+
+/* Maximum number of sectors cache_fetch() reads with one
+   multi-sector transfer. */
+#define CACHE_FETCH_MAX 16
+
+void cache_init (void);
+void cache_read (disk_sector_t, void *);
+void cache_write (disk_sector_t, const void *);
+void cache_read_at (disk_sector_t, void *, size_t ofs, size_t size);
+void cache_write_at (disk_sector_t, const void *, size_t ofs, size_t size);
+void cache_write_fresh (disk_sector_t, const void *, size_t ofs, size_t size);
+void cache_fetch (disk_sector_t, size_t cnt);
+void cache_read_ahead (disk_sector_t, size_t cnt);
+void cache_hold (disk_sector_t);
+void cache_unhold (disk_sector_t);
+void cache_write_back (disk_sector_t);
+void cache_invalidate (disk_sector_t, size_t cnt, bool discard);
+void cache_flush (void);
+void cache_print_stats (void);
+void cache_get_stats (struct disk_stats *);
+
+#endif /* filesys/cache.h */
@@ -1,10 +1,13 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir 
@@ -21,12 +24,402 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
-/* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+/* Number of directory entries read from disk at a time: as many
+   as fit in one sector. */
+#define DIR_BATCH_CNT (DISK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Reads up to DIR_BATCH_CNT entries of directory INODE starting
+   at byte offset OFS into BATCH.  Returns the number of whole
+   entries read, which is less than DIR_BATCH_CNT only at the end
+   of the directory. */
+static size_t
+read_entries (struct inode *inode, struct dir_entry batch[DIR_BATCH_CNT],
+              off_t ofs)
+{
+  off_t size = DIR_BATCH_CNT * sizeof *batch;
+  return inode_read_at (inode, batch, size, ofs) / sizeof *batch;
+}
+
+/* In-memory index of a directory's entries, built the first
+   time the directory is searched and kept with its inode until
+   the inode is closed for the last time.  Every change to the
+   directory goes through the index, so it always matches the
+   entries on disk. */
+struct dir_index
+  {
+    struct rwlock lock;                 /* Protects the index. */
+    struct hash names;                  /* In-use entries, by name. */
+    struct list free;                   /* Free slots. */
+    off_t end;                          /* Offset just past last slot. */
+  };
+
+/* One directory slot in a dir_index. */
+struct dir_slot
+  {
+    struct hash_elem hash_elem;         /* Element in names, if in use. */
+    struct list_elem list_elem;         /* Element in free, if free. */
+    off_t ofs;                          /* Byte offset of the entry. */
+    struct dir_entry e;                 /* Copy of the entry. */
+  };
+
+/* Serializes building directory indexes. */
+static struct lock dir_index_lock;
+
+/* Directory entry cache.
+
+   Maps a directory's sector and a name in it to the sector of
+   the named inode, so that a path walk goes from one inode to
+   the next without searching, or even indexing, the directories
+   along the way.  Holds at most DCACHE_MAX names and evicts the
+   least recently used.  Only dir_lookup() adds names, while it
+   holds the directory's index lock, and dir_remove() drops the
+   name it removes, so a cached name is always in its directory.
+   "." and ".." are never cached.  A directory's index lock is
+   taken before DCACHE_LOCK. */
+#define DCACHE_MAX 128
+
+struct dcache_entry
+  {
+    struct hash_elem hash_elem;         /* Element in dcache. */
+    struct list_elem lru_elem;          /* Element in dcache_lru. */
+    disk_sector_t dir;                  /* Directory's inode sector. */
+    char name[NAME_MAX + 1];            /* Name in the directory. */
+    disk_sector_t sector;               /* Named inode's sector. */
+  };
+
+static struct lock dcache_lock;         /* Protects the following. */
+static struct hash dcache;              /* Entries by directory and name. */
+static struct list dcache_lru;          /* Most recently used first. */
+
+/* Caches of struct dir, struct dir_slot and struct
+   dcache_entry. */
+static struct kmem_cache *dir_cache;
+static struct kmem_cache *slot_cache;
+static struct kmem_cache *dcache_entry_cache;
+
+static hash_hash_func dcache_hash;
+static hash_less_func dcache_less;
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  lock_init (&dir_index_lock);
+  lock_init_named (&dcache_lock, "dcache");
+  if (!hash_init_incremental (&dcache, dcache_hash, dcache_less, NULL))
+    PANIC ("directory entry cache initialization failed");
+  list_init (&dcache_lru);
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), NULL);
+  slot_cache = kmem_cache_create ("dir_slot", sizeof (struct dir_slot),
+                                  NULL);
+  dcache_entry_cache = kmem_cache_create ("dcache_entry",
+                                          sizeof (struct dcache_entry), NULL);
+}
+
+/* Returns true if NAME is "." or "..", which every directory
+   has and which cannot be added or removed. */
+static bool
+is_dot_name (const char *name)
+{
+  return !strcmp (name, ".") || !strcmp (name, "..");
+}
+
+/* Returns a hash value for dcache entry E. */
+static unsigned
+dcache_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dcache_entry *d = hash_entry (e, struct dcache_entry,
+                                             hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+/* Returns true if dcache entry A precedes dcache entry B. */
+static bool
+dcache_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dcache_entry *a = hash_entry (a_, struct dcache_entry,
+                                             hash_elem);
+  const struct dcache_entry *b = hash_entry (b_, struct dcache_entry,
+                                             hash_elem);
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Key for looking up a dcache entry. */
+struct dcache_key
+  {
+    disk_sector_t dir;                  /* Directory's inode sector. */
+    const char *name;                   /* Name in the directory. */
+  };
+
+/* Returns the hash value of a dcache entry with key K, as
+   dcache_hash() would. */
+static inline unsigned
+dcache_key_hash (const struct dcache_key *k)
+{
+  return hash_string (k->name) ^ hash_int (k->dir);
+}
+
+/* Returns true if dcache entry D has key K. */
+static inline bool
+dcache_has_key (const struct dcache_entry *d, const struct dcache_key *k)
+{
+  return d->dir == k->dir && !strcmp (d->name, k->name);
+}
+
+DEFINE_HASH_FIND (dcache_find_key, struct dcache_entry, hash_elem,
+                  const struct dcache_key *, dcache_key_hash, dcache_has_key);
+
+/* Returns the dcache entry for NAME in the directory in sector
+   DIR, or a null pointer if there is none.  DCACHE_LOCK must be
+   held. */
+static struct dcache_entry *
+dcache_find (disk_sector_t dir, const char *name)
+{
+  struct dcache_key key;
+
+  ASSERT (lock_held_by_current_thread (&dcache_lock));
+  key.dir = dir;
+  key.name = name;
+  return dcache_find_key (&dcache, &key);
+}
+
+/* Looks up NAME in the directory in sector DIR in the dcache.
+   On a hit, opens the named inode, stores it in *INODE and
+   returns true.  The inode is opened with DCACHE_LOCK held, so
+   the name cannot be removed, and its sector freed, in between. */
+static bool
+dcache_lookup (disk_sector_t dir, const char *name, struct inode **inode)
+{
+  struct dcache_entry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dcache_find (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&dcache_lru, &d->lru_elem);
+      *inode = inode_open (d->sector);
+    }
+  lock_release (&dcache_lock);
+  return d != NULL && *inode != NULL;
+}
+
+/* Records that NAME in the directory in sector DIR refers to the
+   inode in SECTOR, evicting the least recently used name if the
+   dcache is full.  Does nothing if memory runs out. */
+static void
+dcache_insert (disk_sector_t dir, const char *name, disk_sector_t sector)
+{
+  struct dcache_entry *d;
+
+  if (is_dot_name (name))
+    return;
+
+  lock_acquire (&dcache_lock);
+  if (dcache_find (dir, name) != NULL)
+    goto done;
+  if (hash_size (&dcache) >= DCACHE_MAX)
+    {
+      d = list_entry (list_pop_back (&dcache_lru), struct dcache_entry,
+                      lru_elem);
+      hash_delete (&dcache, &d->hash_elem);
+    }
+  else
+    {
+      d = kmem_cache_alloc (dcache_entry_cache);
+      if (d == NULL)
+        goto done;
+    }
+  d->dir = dir;
+  strlcpy (d->name, name, sizeof d->name);
+  d->sector = sector;
+  hash_insert (&dcache, &d->hash_elem);
+  list_push_front (&dcache_lru, &d->lru_elem);
+
+ done:
+  lock_release (&dcache_lock);
+}
+
+/* Drops NAME in the directory in sector DIR from the dcache. */
+static void
+dcache_remove (disk_sector_t dir, const char *name)
+{
+  struct dcache_entry *d;
+
+  lock_acquire (&dcache_lock);
+  d = dcache_find (dir, name);
+  if (d != NULL)
+    {
+      hash_delete (&dcache, &d->hash_elem);
+      list_remove (&d->lru_elem);
+      kmem_cache_free (dcache_entry_cache, d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Returns a hash value for slot E. */
+static unsigned
+slot_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dir_slot *slot = hash_entry (e, struct dir_slot, hash_elem);
+  return hash_string (slot->e.name);
+}
+
+/* Returns true if slot A's name precedes slot B's. */
+static bool
+slot_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct dir_slot *a = hash_entry (a_, struct dir_slot, hash_elem);
+  const struct dir_slot *b = hash_entry (b_, struct dir_slot, hash_elem);
+  return strcmp (a->e.name, b->e.name) < 0;
+}
+
+/* Returns true if SLOT's entry is named NAME. */
+static inline bool
+slot_has_name (const struct dir_slot *slot, const char *name)
+{
+  return !strcmp (slot->e.name, name);
+}
+
+DEFINE_HASH_FIND (slot_lookup, struct dir_slot, hash_elem, const char *,
+                  hash_string, slot_has_name);
+
+/* Frees slot E. */
+static void
+slot_free (struct hash_elem *e, void *aux UNUSED)
+{
+  kmem_cache_free (slot_cache, hash_entry (e, struct dir_slot, hash_elem));
+}
+
+/* Frees INDEX and all of its slots. */
+void
+dir_index_destroy (struct dir_index *index)
+{
+  if (index != NULL)
+    {
+      while (!list_empty (&index->free))
+        {
+          struct list_elem *e = list_pop_front (&index->free);
+          kmem_cache_free (slot_cache,
+                           list_entry (e, struct dir_slot, list_elem));
+        }
+      hash_destroy (&index->names, slot_free);
+      free (index);
+    }
+}
+
+/* Reads every entry of directory INODE into a new index and
+   returns it, or a null pointer if memory runs out. */
+static struct dir_index *
+dir_index_build (struct inode *inode)
+{
+  struct dir_index *index;
+  struct dir_entry batch[DIR_BATCH_CNT];
+  size_t cnt, i;
+
+  index = malloc (sizeof *index);
+  if (index == NULL)
+    return NULL;
+  if (!hash_init (&index->names, slot_hash, slot_less, NULL))
+    {
+      free (index);
+      return NULL;
+    }
+  rw_init (&index->lock);
+  list_init (&index->free);
+
+  index->end = 0;
+  do
+    {
+      cnt = read_entries (inode, batch, index->end);
+      for (i = 0; i < cnt; i++, index->end += sizeof *batch)
+        {
+          struct dir_slot *slot = kmem_cache_alloc (slot_cache);
+          if (slot == NULL)
+            {
+              dir_index_destroy (index);
+              return NULL;
+            }
+          slot->ofs = index->end;
+          slot->e = batch[i];
+          if (slot->e.in_use)
+            hash_insert (&index->names, &slot->hash_elem);
+          else
+            list_push_back (&index->free, &slot->list_elem);
+        }
+    }
+  while (cnt == DIR_BATCH_CNT);
+  return index;
+}
+
+/* Returns DIR's index, building it if necessary, with its lock
+   held for writing if WRITE is true, otherwise for reading.
+   Returns a null pointer if memory runs out. */
+static struct dir_index *
+dir_index_acquire (const struct dir *dir, bool write)
+{
+  struct dir_index *index;
+
+  lock_acquire (&dir_index_lock);
+  index = inode_get_dir_index (dir->inode);
+  if (index == NULL)
+    {
+      index = dir_index_build (dir->inode);
+      inode_set_dir_index (dir->inode, index);
+    }
+  lock_release (&dir_index_lock);
+
+  if (index == NULL)
+    return NULL;
+  if (write)
+    rw_write_acquire (&index->lock);
+  else
+    rw_read_acquire (&index->lock);
+  return index;
+}
+
+/* Returns the slot in INDEX for the in-use entry named NAME, or
+   a null pointer if there is none. */
+static struct dir_slot *
+dir_index_find (struct dir_index *index, const char *name)
+{
+  return slot_lookup (&index->names, name);
+}
+
+/* Creates a directory with space for ENTRY_CNT entries besides
+   "." and ".." in the given SECTOR.  Its ".." refers to the
+   directory in sector PARENT, which is SECTOR itself for the
+   root.  Returns true if successful, false on failure. */
 bool
-dir_create (disk_sector_t sector, size_t entry_cnt) 
+dir_create (disk_sector_t sector, size_t entry_cnt, disk_sector_t parent)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  struct dir_entry dots[2];
+  struct inode *inode;
+  bool success;
+
+  if (!inode_create (sector, (entry_cnt + 2) * sizeof (struct dir_entry),
+                     true))
+    return false;
+
+  memset (dots, 0, sizeof dots);
+  dots[0].inode_sector = sector;
+  strlcpy (dots[0].name, ".", sizeof dots[0].name);
+  dots[0].in_use = true;
+  dots[1].inode_sector = parent;
+  strlcpy (dots[1].name, "..", sizeof dots[1].name);
+  dots[1].in_use = true;
+
+  inode = inode_open (sector);
+  if (inode == NULL)
+    return false;
+  inode_set_journaled (inode);
+  success = inode_write_at (inode, dots, sizeof dots, 0) == sizeof dots;
+  inode_close (inode);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -34,9 +427,10 @@ dir_create (disk_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = kmem_cache_alloc (dir_cache);
   if (inode != NULL && dir != NULL)
     {
+      inode_set_journaled (inode);
       dir->inode = inode;
       dir->pos = 0;
       return dir;
@@ -44,7 +438,7 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
       return NULL; 
     }
 }
@@ -72,7 +466,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
     }
 }
 
@@ -83,51 +477,41 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
-/* Searches DIR for a file with the given NAME.
-   If successful, returns true, sets *EP to the directory entry
-   if EP is non-null, and sets *OFSP to the byte offset of the
-   directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
-static bool
-lookup (const struct dir *dir, const char *name,
-        struct dir_entry *ep, off_t *ofsp) 
-{
-  struct dir_entry e;
-  size_t ofs;
-  
-  ASSERT (dir != NULL);
-  ASSERT (name != NULL);
-
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
-  return false;
-}
-
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   Fails if DIR has been removed, and also if memory for DIR's
+   index cannot be allocated. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
-  struct dir_entry e;
+  disk_sector_t dir_sector;
+  struct dir_index *index;
+  struct dir_slot *slot;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
-  else
-    *inode = NULL;
+  *inode = NULL;
+  if (inode_is_removed (dir->inode))
+    return false;
+  dir_sector = inode_get_inumber (dir->inode);
+  if (dcache_lookup (dir_sector, name, inode))
+    return true;
+
+  index = dir_index_acquire (dir, false);
+  if (index == NULL)
+    return false;
+
+  slot = dir_index_find (index, name);
+  if (slot != NULL)
+    {
+      *inode = inode_open (slot->e.inode_sector);
+      dcache_insert (dir_sector, name, slot->e.inode_sector);
+    }
+  rw_read_release (&index->lock);
 
   return *inode != NULL;
 }
@@ -136,101 +520,177 @@ dir_lookup (const struct dir *dir, const char *name,
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
    Returns true if successful, false on failure.
-   Fails if NAME is invalid (i.e. too long) or a disk or memory
-   error occurs. */
+   Fails if NAME is invalid (i.e. too long, or "." or ".."), if
+   DIR has been removed, or if a disk or memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) 
 {
-  struct dir_entry e;
-  off_t ofs;
+  struct dir_index *index;
+  struct dir_slot *slot;
   bool success = false;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
   /* Check NAME for validity. */
-  if (*name == '\0' || strlen (name) > NAME_MAX)
+  if (*name == '\0' || strlen (name) > NAME_MAX || is_dot_name (name))
+    return false;
+
+  index = dir_index_acquire (dir, true);
+  if (index == NULL)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  /* Check that DIR still exists and NAME is not in use.  A
+     directory is removed with its index lock held, so it cannot
+     gain an entry afterward. */
+  if (inode_is_removed (dir->inode) || dir_index_find (index, name) != NULL)
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  /* Take a free slot, or a new one at the end of the
+     directory. */
+  if (!list_empty (&index->free))
+    slot = list_entry (list_front (&index->free), struct dir_slot, list_elem);
+  else
+    {
+      slot = kmem_cache_alloc (slot_cache);
+      if (slot == NULL)
+        goto done;
+      slot->ofs = index->end;
+    }
 
   /* Write slot. */
-  e.in_use = true;
-  strlcpy (e.name, name, sizeof e.name);
-  e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  slot->e.in_use = true;
+  strlcpy (slot->e.name, name, sizeof slot->e.name);
+  slot->e.inode_sector = inode_sector;
+  success = (inode_write_at (dir->inode, &slot->e, sizeof slot->e, slot->ofs)
+             == sizeof slot->e);
+
+  /* Record the new entry in the index. */
+  if (slot->ofs == index->end)
+    {
+      if (success)
+        index->end += sizeof slot->e;
+      else
+        {
+          kmem_cache_free (slot_cache, slot);
+          goto done;
+        }
+    }
+  else if (success)
+    list_remove (&slot->list_elem);
+  else
+    {
+      slot->e.in_use = false;
+      goto done;
+    }
+  hash_insert (&index->names, &slot->hash_elem);
 
  done:
+  rw_write_release (&index->lock);
   return success;
 }
 
 /* Removes any entry for NAME in DIR.
    Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   which occurs only if there is no file with the given NAME,
+   NAME is "." or "..", NAME is a directory that is not empty,
+   or a disk or memory error occurs. */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
-  struct dir_entry e;
+  struct dir_index *index;
+  struct dir_index *child_index = NULL;
+  struct dir_slot *slot;
   struct inode *inode = NULL;
   bool success = false;
-  off_t ofs;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (is_dot_name (name))
+    return false;
+
+  index = dir_index_acquire (dir, true);
+  if (index == NULL)
+    return false;
+
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  slot = dir_index_find (index, name);
+  if (slot == NULL)
     goto done;
 
   /* Open inode. */
-  inode = inode_open (e.inode_sector);
+  inode = inode_open (slot->e.inode_sector);
   if (inode == NULL)
     goto done;
 
+  /* A directory must be empty but for "." and "..".  Its index
+     stays locked until it is marked removed, so that nothing is
+     added to it in between. */
+  if (inode_is_dir (inode))
+    {
+      struct dir child = { inode, 0 };
+      child_index = dir_index_acquire (&child, true);
+      if (child_index == NULL || hash_size (&child_index->names) > 2)
+        goto done;
+    }
+
   /* Erase directory entry. */
-  e.in_use = false;
-  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
-    goto done;
+  slot->e.in_use = false;
+  if (inode_write_at (dir->inode, &slot->e, sizeof slot->e, slot->ofs)
+      != sizeof slot->e) 
+    {
+      slot->e.in_use = true;
+      goto done;
+    }
+  hash_delete (&index->names, &slot->hash_elem);
+  list_push_back (&index->free, &slot->list_elem);
+  dcache_remove (inode_get_inumber (dir->inode), name);
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  if (child_index != NULL)
+    rw_write_release (&child_index->lock);
+  rw_write_release (&index->lock);
   inode_close (inode);
   return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+   contains no more entries.  "." and ".." are skipped. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
-  struct dir_entry e;
+  return dir_readdir_at (dir->inode, &dir->pos, name);
+}
+
+/* Like dir_readdir(), for directory INODE, at the byte position
+   in *POS, which is advanced past the entry read.  For a
+   directory opened as a file, whose position is kept in its
+   struct file. */
+bool
+dir_readdir_at (struct inode *inode, off_t *pos, char name[NAME_MAX + 1])
+{
+  struct dir_entry batch[DIR_BATCH_CNT];
+  size_t cnt, i;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  do
     {
-      dir->pos += sizeof e;
-      if (e.in_use)
+      cnt = read_entries (inode, batch, *pos);
+      for (i = 0; i < cnt; i++)
         {
-          strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
-        } 
+          *pos += sizeof *batch;
+          if (batch[i].in_use && !is_dot_name (batch[i].name))
+            {
+              strlcpy (name, batch[i].name, NAME_MAX + 1);
+              return true;
+            }
+        }
     }
+  while (cnt == DIR_BATCH_CNT);
   return false;
 }
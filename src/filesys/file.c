@@ -1,57 +1,193 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include <poll.h>
+#include "filesys/cache.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "filesys/pipe.h"
+#include "devices/disk.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "threads/slab.h"
+#include "threads/tunable.h"
 
-/* An open file. */
+/* Number of sectors to read ahead of a sequential reader,
+   tunable as "read_ahead".  0 turns read-ahead off. */
+#define READ_AHEAD_SECTORS 8
+static int read_ahead_sectors = READ_AHEAD_SECTORS;
+
+/* An open file, or one end of a pipe.  A pipe end has no inode
+   and no position.  File_share() lets several fds, in one process
+   or several, refer to the same struct file, sharing its
+   position; it is closed when the last of them closes it. */
 struct file 
   {
-    struct inode *inode;        /* File's inode. */
+    int ref_cnt;                /* Number of holders. */
+    struct inode *inode;        /* File's inode, null for a pipe. */
     off_t pos;                  /* Current position. */
+    off_t read_end;             /* Position after the last file_read(). */
+    struct pipe *pipe;          /* Pipe, if this is a pipe end. */
+    bool pipe_writer;           /* Write end of PIPE? */
+    bool deny_write;            /* Has file_deny_write() been called? */
+    bool direct;                /* Bypass the buffer cache? */
   };
 
+/* Cache of struct file. */
+static struct kmem_cache *file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void)
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file), NULL);
+  tunable_register ("read_ahead", &read_ahead_sectors, 0, CACHE_SIZE / 2);
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (file_cache);
   if (inode != NULL && file != NULL)
     {
+      file->ref_cnt = 1;
       file->inode = inode;
       file->pos = 0;
+      file->read_end = 0;
+      file->pipe = NULL;
+      file->deny_write = false;
+      file->direct = false;
 
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (file_cache, file);
       return NULL; 
     }
 }
 
+/* Creates a pipe and stores its read end in *READER and its write
+   end in *WRITER.  Returns true if successful, false if an
+   allocation fails. */
+bool
+file_open_pipe (struct file **reader, struct file **writer)
+{
+  struct pipe *pipe = pipe_create ();
+  struct file *ends[2];
+  int i;
+
+  if (pipe == NULL)
+    return false;
+  ends[0] = kmem_cache_alloc (file_cache);
+  ends[1] = kmem_cache_alloc (file_cache);
+  if (ends[0] == NULL || ends[1] == NULL)
+    {
+      kmem_cache_free (file_cache, ends[0]);
+      kmem_cache_free (file_cache, ends[1]);
+      pipe_close (pipe, false);
+      pipe_close (pipe, true);
+      return false;
+    }
+  for (i = 0; i < 2; i++)
+    {
+      ends[i]->ref_cnt = 1;
+      ends[i]->inode = NULL;
+      ends[i]->pos = 0;
+      ends[i]->read_end = 0;
+      ends[i]->pipe = pipe;
+      ends[i]->pipe_writer = i == 1;
+      ends[i]->deny_write = false;
+      ends[i]->direct = false;
+    }
+  *reader = ends[0];
+  *writer = ends[1];
+  return true;
+}
+
 /* Opens and returns a new file for the same inode as FILE.
-   Returns a null pointer if unsuccessful. */
+   Returns a null pointer if unsuccessful, which it always is for
+   a pipe end. */
 struct file *
 file_reopen (struct file *file) 
 {
+  if (file->pipe != NULL)
+    return NULL;
   return file_open (inode_reopen (file->inode));
 }
 
-/* Closes FILE. */
+/* Returns a new file that reads and writes the same thing as
+   FILE: another end of the same pipe, or, for a file, another
+   open file for its inode starting at FILE's position.  Returns a
+   null pointer if memory is short. */
+struct file *
+file_dup (struct file *file)
+{
+  struct file *dup;
+
+  if (file->pipe == NULL)
+    {
+      dup = file_reopen (file);
+      if (dup != NULL)
+        {
+          dup->pos = file->pos;
+          dup->direct = file->direct;
+        }
+      return dup;
+    }
+
+  dup = kmem_cache_alloc (file_cache);
+  if (dup == NULL)
+    return NULL;
+  pipe_reopen (file->pipe, file->pipe_writer);
+  *dup = *file;
+  dup->ref_cnt = 1;
+  return dup;
+}
+
+/* Adds a holder to FILE, which must be open, and returns it.
+   Unlike file_dup(), this allocates nothing and cannot fail, and
+   the holders share one position.  Each holder closes FILE with
+   file_close(). */
+struct file *
+file_share (struct file *file)
+{
+  enum intr_level old_level = intr_disable ();
+  ASSERT (file->ref_cnt > 0);
+  file->ref_cnt++;
+  intr_set_level (old_level);
+  return file;
+}
+
+/* Closes FILE for one of its holders.  Closes it for real once
+   no holder is left. */
 void
 file_close (struct file *file) 
 {
   if (file != NULL)
     {
-      inode_close (file->inode);
-      free (file); 
+      enum intr_level old_level = intr_disable ();
+      bool last = --file->ref_cnt == 0;
+      intr_set_level (old_level);
+      if (!last)
+        return;
+
+      if (file->pipe != NULL)
+        pipe_close (file->pipe, file->pipe_writer);
+      else
+        {
+          file_allow_write (file);
+          inode_close (file->inode);
+        }
+      kmem_cache_free (file_cache, file);
     }
 }
 
-/* Returns the inode encapsulated by FILE. */
+/* Returns the inode encapsulated by FILE, or a null pointer if
+   FILE is a pipe end. */
 struct inode *
 file_get_inode (struct file *file) 
 {
@@ -62,12 +198,30 @@ file_get_inode (struct file *file)
    starting at the file's current position.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   If the read continues where the previous one ended, the
+   sectors following it are read ahead in the background.
+   Reading the read end of a pipe waits for data to arrive and
+   returns 0 only at end of file; reading the write end fails
+   with -1.  Reading a directory fails with -1. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
-  off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  bool sequential;
+  off_t bytes_read;
+
+  if (file->pipe != NULL)
+    return file->pipe_writer ? -1 : pipe_read (file->pipe, buffer, size);
+  if (inode_is_dir (file->inode))
+    return -1;
+
+  sequential = file->pos == file->read_end;
+  bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
+  file->read_end = file->pos;
+  if (sequential && bytes_read > 0 && read_ahead_sectors > 0)
+    inode_read_ahead (file->inode, file->pos,
+                      read_ahead_sectors * DISK_SECTOR_SIZE);
   return bytes_read;
 }
 
@@ -75,24 +229,36 @@ file_read (struct file *file, void *buffer, off_t size)
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   The file's current position is unaffected. */
+   The file's current position is unaffected.
+   Fails with -1 on a pipe end or a directory. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
+  if (file->pipe != NULL || inode_is_dir (file->inode))
+    return -1;
   return inode_read_at (file->inode, buffer, size, file_ofs);
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
-   Advances FILE's position by the number of bytes read. */
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
+   Advances FILE's position by the number of bytes written.
+   Writing the write end of a pipe waits for room as needed, see
+   pipe_write(); writing the read end fails with -1.  Writing a
+   directory fails with -1. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written;
+
+  if (file->pipe != NULL)
+    return file->pipe_writer ? pipe_write (file->pipe, buffer, size) : -1;
+  if (inode_is_dir (file->inode))
+    return -1;
+
+  bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -100,23 +266,158 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
-   The file's current position is unaffected. */
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
+   The file's current position is unaffected.
+   Fails with -1 on a pipe end or a directory. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
+  if (file->pipe != NULL || inode_is_dir (file->inode))
+    return -1;
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
 
-/* Returns the size of FILE in bytes. */
+/* Makes FILE use direct I/O: the caller may then pass buffers
+   that are sector aligned to file_read_direct() and
+   file_write_direct(), which bypass the buffer cache.  Does
+   nothing for a pipe end or a directory. */
+void
+file_set_direct (struct file *file)
+{
+  if (file->pipe == NULL && !inode_is_dir (file->inode))
+    file->direct = true;
+}
+
+/* Returns true if FILE uses direct I/O.  A direct transfer must
+   also start at a multiple of DISK_SECTOR_SIZE in the file. */
+bool
+file_is_direct (struct file *file)
+{
+  return file->direct;
+}
+
+/* Reads from FILE, which must use direct I/O and be at a
+   multiple of DISK_SECTOR_SIZE, into the IOVCNT kernel buffers
+   in IOV, laid out as for inode_read_direct(), straight from
+   disk.  Returns the number of bytes read and advances FILE's
+   position by that much. */
+off_t
+file_read_direct (struct file *file, const struct iovec *iov, int iovcnt)
+{
+  off_t bytes_read;
+
+  ASSERT (file->direct);
+  bytes_read = inode_read_direct (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Writes the IOVCNT kernel buffers in IOV to FILE like
+   file_read_direct() reads them.  Returns the number of bytes
+   written and advances FILE's position by that much. */
+off_t
+file_write_direct (struct file *file, const struct iovec *iov, int iovcnt)
+{
+  off_t bytes_written;
+
+  ASSERT (file->direct);
+  bytes_written = inode_write_direct (file->inode, iov, iovcnt, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/* Copies up to SIZE bytes from SRC, starting at its current
+   position, to DST at its current position, through a kernel
+   buffer, a page at a time.  Advances each file's position by
+   the number of bytes copied.  Returns that number, which is
+   less than SIZE if SRC reaches end of file or DST cannot be
+   written, or -1 if no buffer can be allocated. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size)
+{
+  uint8_t *buffer;
+  off_t bytes_copied = 0;
+
+  if (size <= 0)
+    return 0;
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return -1;
+  while (size > 0)
+    {
+      off_t chunk = size < PGSIZE ? size : PGSIZE;
+      off_t bytes_read = file_read (src, buffer, chunk);
+      off_t bytes_written;
+
+      if (bytes_read <= 0)
+        break;
+      bytes_written = file_write (dst, buffer, bytes_read);
+      if (bytes_written < 0)
+        bytes_written = 0;
+      if (bytes_written < bytes_read)
+        {
+          /* Leave SRC just after the last byte copied. */
+          if (src->pipe == NULL)
+            src->pos -= bytes_read - bytes_written;
+          bytes_copied += bytes_written;
+          break;
+        }
+      size -= bytes_read;
+      bytes_copied += bytes_read;
+    }
+  palloc_free_page (buffer);
+  return bytes_copied;
+}
+
+/* Prevents write operations on FILE's underlying inode
+   until file_allow_write() is called or FILE is closed.
+   Does nothing for a pipe end. */
+void
+file_deny_write (struct file *file) 
+{
+  ASSERT (file != NULL);
+  if (file->pipe == NULL && !file->deny_write) 
+    {
+      file->deny_write = true;
+      inode_deny_write (file->inode);
+    }
+}
+
+/* Re-enables write operations on FILE's underlying inode.
+   (Writes might still be denied by some other file that has the
+   same inode open.) */
+void
+file_allow_write (struct file *file) 
+{
+  ASSERT (file != NULL);
+  if (file->deny_write) 
+    {
+      file->deny_write = false;
+      inode_allow_write (file->inode);
+    }
+}
+
+/* Returns the poll() events that are ready on FILE.  A file can
+   always be read and written without waiting; only a pipe end
+   ever has to wait. */
+int
+file_poll (struct file *file)
+{
+  if (file->pipe != NULL)
+    return pipe_poll (file->pipe, file->pipe_writer);
+  return POLLIN | POLLOUT;
+}
+
+/* Returns the size of FILE in bytes, or 0 for a pipe end. */
 off_t
 file_length (struct file *file) 
 {
   ASSERT (file != NULL);
+  if (file->pipe != NULL)
+    return 0;
   return inode_length (file->inode);
 }
 
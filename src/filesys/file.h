@@ -1,13 +1,20 @@
 #ifndef FILESYS_FILE_H
 #define FILESYS_FILE_H
 
+#include <stdbool.h>
 #include "filesys/off_t.h"
 
 struct inode;
+struct iovec;
+
+void file_init (void);
 
 /* Opening and closing files. */
 struct file *file_open (struct inode *);
+bool file_open_pipe (struct file **reader, struct file **writer);
 struct file *file_reopen (struct file *);
+struct file *file_dup (struct file *);
+struct file *file_share (struct file *);
 void file_close (struct file *);
 struct inode *file_get_inode (struct file *);
 
@@ -16,7 +23,19 @@ off_t file_read (struct file *, void *, off_t);
 off_t file_read_at (struct file *, void *, off_t size, off_t start);
 off_t file_write (struct file *, const void *, off_t);
 off_t file_write_at (struct file *, const void *, off_t size, off_t start);
+off_t file_copy (struct file *dst, struct file *src, off_t size);
+int file_poll (struct file *);
+
+/* Direct I/O. */
+void file_set_direct (struct file *);
+bool file_is_direct (struct file *);
+off_t file_read_direct (struct file *, const struct iovec *, int iovcnt);
+off_t file_write_direct (struct file *, const struct iovec *, int iovcnt);
+
 
+/* Preventing writes. */
+void file_deny_write (struct file *);
+void file_allow_write (struct file *);
 
 /* File position. */
 void file_seek (struct file *, off_t);
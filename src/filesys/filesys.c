@@ -2,18 +2,131 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
 #include "devices/disk.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 
 /* The disk that contains the file system. */
 struct disk *filesys_disk;
 
+/* The root directory, kept open from filesys_init() until
+   filesys_done().  Lookups, additions and removals never touch a
+   directory's position, so one handle serves every caller. */
+static struct dir *root_dir;
+
 static void do_format (void);
 
+/* Path names.
+
+   A path is a sequence of names separated by one or more
+   slashes.  An absolute path starts with a slash and is looked
+   up from the root directory; any other path is looked up from
+   the working directory of the current thread, which is the
+   root directory for a thread that never changed it.  Every
+   name but the last must be a directory.  "." and ".." are
+   ordinary entries of every directory, written by dir_create();
+   the root's ".." refers to itself.
+
+   Each step of a path walk is a dir_lookup(), which finds
+   recently used names in the directory entry cache without
+   searching the directory. */
+
+/* Returns the directory that relative paths are looked up
+   from. */
+static struct dir *
+working_dir (void)
+{
+  struct dir *cwd = thread_current ()->cwd;
+  return cwd != NULL ? cwd : root_dir;
+}
+
+/* Splits PATH into the directory that holds its last name and
+   that name.  Opens the directory and stores it in *DIRP, and
+   copies the name into NAME.  NAME is empty if PATH names the
+   root directory, e.g. "/".  Returns true if successful, false
+   if PATH is empty, a name is longer than NAME_MAX, a name
+   before the last is not a directory, or memory runs out.  The
+   caller must close *DIRP. */
+static bool
+resolve (const char *path, struct dir **dirp, char name[NAME_MAX + 1])
+{
+  struct dir *dir;
+
+  *dirp = NULL;
+  if (*path == '\0')
+    return false;
+
+  dir = dir_reopen (*path == '/' ? root_dir : working_dir ());
+  if (dir == NULL)
+    return false;
+
+  name[0] = '\0';
+  for (;;)
+    {
+      struct inode *inode;
+      size_t len;
+
+      while (*path == '/')
+        path++;
+      len = strcspn (path, "/");
+      if (len == 0)
+        break;
+      if (len > NAME_MAX)
+        goto fail;
+      memcpy (name, path, len);
+      name[len] = '\0';
+      path += len;
+
+      /* Stop at the last name. */
+      if (path[strspn (path, "/")] == '\0')
+        break;
+
+      if (!dir_lookup (dir, name, &inode))
+        goto fail;
+      if (!inode_is_dir (inode))
+        {
+          inode_close (inode);
+          goto fail;
+        }
+      dir_close (dir);
+      dir = dir_open (inode);
+      if (dir == NULL)
+        return false;
+    }
+  *dirp = dir;
+  return true;
+
+ fail:
+  dir_close (dir);
+  return false;
+}
+
+/* Opens and returns the inode named by PATH, or a null pointer
+   if there is none. */
+static struct inode *
+open_path (const char *path)
+{
+  struct dir *dir;
+  char name[NAME_MAX + 1];
+  struct inode *inode = NULL;
+
+  if (resolve (path, &dir, name))
+    {
+      if (name[0] == '\0')
+        inode = inode_reopen (dir_get_inode (dir));
+      else
+        dir_lookup (dir, name, &inode);
+      dir_close (dir);
+    }
+  return inode;
+}
+
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
 void
@@ -23,62 +136,102 @@ filesys_init (bool format)
   if (filesys_disk == NULL)
     PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+  journal_init ();
+  cache_init ();
   inode_init ();
+  file_init ();
+  dir_init ();
   free_map_init ();
 
   if (format) 
     do_format ();
+  else
+    journal_recover ();
 
   free_map_open ();
+
+  root_dir = dir_open_root ();
+  if (root_dir == NULL)
+    PANIC ("root directory open failed");
+
+  inode_start_defrag ();
 }
 
 /* Shuts down the file system module, writing any unwritten data
-   to disk. */
+   to disk.  The journal is committed and the buffer cache is
+   flushed synchronously, so all dirty sectors are on disk when
+   this function returns. */
 void
 filesys_done (void) 
 {
+  dir_close (root_dir);
+  root_dir = NULL;
   free_map_close ();
+  journal_done ();
 }
 
-/* Creates a file named NAME with the given INITIAL_SIZE.
-   Returns true if successful, false otherwise.
-   Fails if a file named NAME already exists,
-   or if internal memory allocation fails. */
-bool
-filesys_create (const char *name, off_t initial_size) 
+/* Creates a file, or a directory if IS_DIR is true, at PATH,
+   with the given INITIAL_SIZE for a file.  See filesys_create()
+   and filesys_mkdir(). */
+static bool
+create (const char *path, off_t initial_size, bool is_dir)
 {
-  disk_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+  disk_sector_t inode_sector = 0, parent;
+  struct dir *dir;
+  char name[NAME_MAX + 1];
+  bool success;
+
+  if (!resolve (path, &dir, name))
+    return false;
+
+  /* A file's inode goes near its directory's, a directory's in
+     the emptiest group, so that its own files have room nearby. */
+  parent = inode_get_inumber (dir_get_inode (dir));
+  journal_begin ();
+  success = (free_map_allocate_near (is_dir ? free_map_emptiest_group ()
+                                            : parent, 1, &inode_sector)
+             && (is_dir
+                 ? dir_create (inode_sector, 0, parent)
+                 : inode_create (inode_sector, initial_size, false))
+             && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
+  journal_end ();
+
   dir_close (dir);
-  
   return success;
 }
 
-/* Opens the file with the given NAME.
+/* Creates a file at PATH with the given INITIAL_SIZE.
+   Returns true if successful, false otherwise.
+   Fails if a file named PATH already exists, if the directory
+   that would hold it does not exist,
+   or if internal memory allocation fails. */
+bool
+filesys_create (const char *path, off_t initial_size) 
+{
+  return create (path, initial_size, false);
+}
+
+/* Creates an empty directory at PATH.
+   Returns true if successful, false otherwise, in the same
+   cases as filesys_create(). */
+bool
+filesys_mkdir (const char *path)
+{
+  return create (path, 0, true);
+}
+
+/* Opens the file or directory at PATH.
    Returns the new file if successful or a null pointer
-   otherwise.
-   Fails if no file named NAME exists,
+   otherwise.  A directory opened this way can only be read with
+   dir_readdir_at().
+   Fails if no file named PATH exists,
    or if an internal memory allocation fails. */
 struct file *
-filesys_open (const char *name)
+filesys_open (const char *path)
 {
-  struct dir *dir = dir_open_root ();
-  struct inode *inode = NULL;
-  struct file *file = NULL;
-
-  if (dir != NULL)
-    dir_lookup (dir, name, &inode);
-  dir_close (dir);
-
-  file = file_open (inode);
-  
-  return file;
+  return file_open (open_path (path));
 }
 
 void
@@ -87,27 +240,63 @@ filesys_close (struct file *file)
   file_close(file);
 }
 
-/* Deletes the file named NAME.
+/* Deletes the file or empty directory at PATH.
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   Fails if no file named PATH exists, if PATH is a directory
+   that is not empty or is the root,
+   or if an internal memory allocation fails.  A removed
+   directory that is still open, or some process's working
+   directory, stays usable only for closing: it can no longer
+   gain or look up entries. */
 bool
-filesys_remove (const char *name) 
+filesys_remove (const char *path) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
-  dir_close (dir); 
-  
+  struct dir *dir;
+  char name[NAME_MAX + 1];
+  bool success;
+
+  if (!resolve (path, &dir, name))
+    return false;
+
+  journal_begin ();
+  success = name[0] != '\0' && dir_remove (dir, name);
+  journal_end ();
+
+  dir_close (dir);
   return success;
 }
 
+/* Makes the directory at PATH the current thread's working
+   directory.  Returns true if successful, false if PATH is not
+   a directory or memory runs out. */
+bool
+filesys_chdir (const char *path)
+{
+  struct thread *t = thread_current ();
+  struct inode *inode = open_path (path);
+  struct dir *dir;
+
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return false;
+    }
+  dir = dir_open (inode);
+  if (dir == NULL)
+    return false;
+  dir_close (t->cwd);
+  t->cwd = dir;
+  return true;
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
+  journal_format ();
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, 16, ROOT_DIR_SECTOR))
     PANIC ("root directory creation failed");
   free_map_close ();
   printf ("done.\n");
@@ -7,6 +7,7 @@
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define JOURNAL_SECTOR 2        /* First sector of the journal area. */
 
 /* Disk used for file system. */
 extern struct disk *filesys_disk;
@@ -14,10 +15,12 @@ extern struct disk *filesys_disk;
 void filesys_init (bool format);
 void filesys_done (void);
 
-bool filesys_create (const char *name, off_t initial_size);
-bool filesys_remove (const char *name);
+bool filesys_create (const char *path, off_t initial_size);
+bool filesys_mkdir (const char *path);
+bool filesys_remove (const char *path);
+bool filesys_chdir (const char *path);
 
-struct file *filesys_open (const char *name);
+struct file *filesys_open (const char *path);
 void         filesys_close (struct file *file);
 
 #endif /* filesys/filesys.h */
@@ -1,13 +1,110 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include <stdio.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
 
+/* Changes to the free map are not written to the free map file
+   right away.  Instead, FREE_MAP_DIRTY records which sectors of
+   the file differ from FREE_MAP, and free_map_flush() writes just
+   those.  Every journal commit flushes the free map into the
+   buffer cache as part of the transaction, and free_map_close()
+   does the same at shutdown, so the free map on disk always
+   matches the inodes committed with it. */
+static struct bitmap *free_map_dirty; /* One bit per free map file sector. */
+
+/* Every sector below FIRST_FREE is in use, so allocations start
+   their search there instead of at sector 0.  On a disk filling
+   up from the front, as it does under a stream of creates, this
+   skips the long run of used sectors that every allocation would
+   otherwise scan past while holding FREE_MAP_LOCK. */
+static disk_sector_t first_free;
+
+/* The disk is divided into groups of GROUP_SECTORS sectors, each
+   covered by one sector of the free map file, and GROUP_FREE
+   counts the free sectors in each.  A file's inode goes near its
+   directory's inode and its data near its inode, so the sectors of
+   one directory stay together, while a new directory goes in the
+   group with the most free sectors, leaving room for its files
+   next to it. */
+#define GROUP_SECTORS BITS_PER_SECTOR
+static unsigned *group_free;
+static size_t group_cnt;
+static struct lock free_map_lock;     /* Protects all of the above. */
+
+/* Number of free map bits per sector of the free map file. */
+#define BITS_PER_SECTOR (DISK_SECTOR_SIZE * 8)
+
+/* Records that the free map bits for the CNT sectors starting at
+   SECTOR have changed. */
+static void
+mark_dirty (disk_sector_t sector, size_t cnt)
+{
+  size_t first = sector / BITS_PER_SECTOR;
+  size_t last = (sector + cnt - 1) / BITS_PER_SECTOR;
+
+  if (cnt > 0)
+    bitmap_set_multiple (free_map_dirty, first, last - first + 1, true);
+}
+
+/* Updates the free counts of the groups of the CNT sectors
+   starting at SECTOR, which have been freed if FREED is true and
+   allocated otherwise. */
+static void
+count_free (disk_sector_t sector, size_t cnt, bool freed)
+{
+  while (cnt > 0)
+    {
+      size_t group = sector / GROUP_SECTORS;
+      size_t run = (group + 1) * GROUP_SECTORS - sector;
+      if (run > cnt)
+        run = cnt;
+      if (freed)
+        group_free[group] += run;
+      else
+        group_free[group] -= run;
+      sector += run;
+      cnt -= run;
+    }
+}
+
+/* Recounts the free sectors of every group from the free map. */
+static void
+count_groups (void)
+{
+  size_t i;
+
+  for (i = 0; i < group_cnt; i++)
+    {
+      size_t start = i * GROUP_SECTORS;
+      size_t cnt = bitmap_size (free_map) - start;
+      if (cnt > GROUP_SECTORS)
+        cnt = GROUP_SECTORS;
+      group_free[i] = bitmap_count (free_map, start, cnt, false);
+    }
+}
+
+/* Marks the CNT sectors starting at SECTOR, which must be free, as
+   allocated. */
+static void
+take (disk_sector_t sector, size_t cnt)
+{
+  bitmap_set_multiple (free_map, sector, cnt, true);
+  mark_dirty (sector, cnt);
+  count_free (sector, cnt, false);
+  if (sector == first_free)
+    first_free = sector + cnt;
+}
+
 
 /* Initializes the free map. */
 void
@@ -18,6 +115,18 @@ free_map_init (void)
     PANIC ("bitmap creation failed--disk is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SECTORS, true);
+
+  free_map_dirty = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                                DISK_SECTOR_SIZE));
+  if (free_map_dirty == NULL)
+    PANIC ("bitmap creation failed--disk is too large");
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  group_free = calloc (group_cnt, sizeof *group_free);
+  if (group_free == NULL)
+    PANIC ("free map group counts allocation failed");
+  count_groups ();
+  lock_init_named (&free_map_lock, "free_map");
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,29 +136,108 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) 
 {
-  disk_sector_t sector;
-  
-  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
-    {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
-    }
+  return free_map_allocate_near (0, cnt, sectorp);
+}
+
+/* Allocates CNT consecutive sectors as free_map_allocate() does,
+   but takes the first free run at or after GOAL, if there is one,
+   rather than the first on the disk. */
+bool
+free_map_allocate_near (disk_sector_t goal, size_t cnt,
+                        disk_sector_t *sectorp) 
+{
+  disk_sector_t sector = BITMAP_ERROR;
+
+  lock_acquire (&free_map_lock);
+  if (goal > first_free && goal < bitmap_size (free_map))
+    sector = bitmap_scan (free_map, goal, cnt, false);
+  if (sector == BITMAP_ERROR)
+    sector = bitmap_scan (free_map, first_free, cnt, false);
+  if (sector != BITMAP_ERROR)
+    take (sector, cnt);
+  lock_release (&free_map_lock);
   
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
+/* Returns the first sector of the group with the most free
+   sectors, as a goal for free_map_allocate_near() that leaves
+   room around it. */
+disk_sector_t
+free_map_emptiest_group (void)
+{
+  size_t i, best = 0;
+
+  lock_acquire (&free_map_lock);
+  for (i = 1; i < group_cnt; i++)
+    if (group_free[i] > group_free[best])
+      best = i;
+  lock_release (&free_map_lock);
+  return best * GROUP_SECTORS;
+}
+
+/* Allocates the CNT consecutive sectors starting at SECTOR, if
+   they are all free.  Used to grow a file's last extent in
+   place.  Returns true if successful, false if any of the
+   sectors is in use or beyond the end of the disk. */
+bool
+free_map_allocate_at (disk_sector_t sector, size_t cnt)
+{
+  bool success = false;
+
+  lock_acquire (&free_map_lock);
+  if (sector < bitmap_size (free_map)
+      && cnt <= bitmap_size (free_map) - sector
+      && bitmap_none (free_map, sector, cnt))
+    {
+      take (sector, cnt);
+      success = true;
+    }
+  lock_release (&free_map_lock);
+  return success;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (disk_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+  count_free (sector, cnt, true);
+  if (sector < first_free)
+    first_free = sector;
+  lock_release (&free_map_lock);
+}
+
+/* Writes the sectors of the free map file that have changed
+   since the last flush.  Does nothing if the free map file is
+   not open.  Returns true if successful, false if a write
+   failed, in which case the sector stays dirty. */
+bool
+free_map_flush (void)
+{
+  bool success = true;
+  size_t i;
+
+  journal_begin ();
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL)
+    for (i = 0; (i = bitmap_scan (free_map_dirty, i, 1, true)) != BITMAP_ERROR;
+         i++)
+      {
+        if (bitmap_write_range (free_map, free_map_file,
+                                i * DISK_SECTOR_SIZE, DISK_SECTOR_SIZE))
+          bitmap_reset (free_map_dirty, i);
+        else
+          success = false;
+      }
+  lock_release (&free_map_lock);
+  journal_end ();
+  return success;
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -59,15 +247,23 @@ free_map_open (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  inode_set_journaled (file_get_inode (free_map_file));
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  count_groups ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
 free_map_close (void) 
 {
+  if (!free_map_flush ())
+    printf ("free_map_close: can't write free map\n");
+
+  lock_acquire (&free_map_lock);
   file_close (free_map_file);
+  free_map_file = NULL;
+  lock_release (&free_map_lock);
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -76,13 +272,15 @@ void
 free_map_create (void) 
 {
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  inode_set_journaled (file_get_inode (free_map_file));
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (free_map_dirty, false);
 }
@@ -1,5 +1,7 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -66,6 +68,24 @@ fsutil_rm (char **argv)
     PANIC ("%s: delete failed\n", file_name);
 }
 
+/* Size of the staging buffer that fsutil_put() and fsutil_get()
+   move file data through, in pages and in sectors.  Each pass
+   over the buffer is one multi-sector transfer. */
+#define STAGING_PAGES 8
+#define STAGING_SECTORS (STAGING_PAGES * PGSIZE / DISK_SECTOR_SIZE)
+
+/* Returns the number of bytes of a file with SIZE bytes left
+   that fit in the staging buffer, and stores in *SECTOR_CNT the
+   number of disk sectors that they occupy. */
+static off_t
+staging_chunk (off_t size, size_t *sector_cnt)
+{
+  off_t chunk_size = (size < STAGING_SECTORS * DISK_SECTOR_SIZE
+                      ? size : STAGING_SECTORS * DISK_SECTOR_SIZE);
+  *sector_cnt = DIV_ROUND_UP (chunk_size, DISK_SECTOR_SIZE);
+  return chunk_size;
+}
+
 /* Copies from the "scratch" disk, hdc or hd1:0 to file ARGV[1]
    in the file system.
 
@@ -92,7 +112,7 @@ fsutil_put (char **argv)
   printf ("Putting '%s' into the file system...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
+  buffer = palloc_get_multiple (0, STAGING_PAGES);
   if (buffer == NULL)
     PANIC ("couldn't allocate buffer");
 
@@ -109,7 +129,8 @@ fsutil_put (char **argv)
   if (size < 0)
     PANIC ("%s: invalid file size %d", file_name, size);
   
-  /* Create destination file. */
+  /* Create destination file, allocating all of its sectors at
+     once. */
   if (!filesys_create (file_name, size))
     PANIC ("%s: create failed", file_name);
   dst = filesys_open (file_name);
@@ -119,8 +140,12 @@ fsutil_put (char **argv)
   /* Do copy. */
   while (size > 0)
     {
-      int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-      disk_read (src, sector++, buffer);
+      size_t sector_cnt;
+      off_t chunk_size = staging_chunk (size, &sector_cnt);
+      if (sector + sector_cnt > disk_size (src))
+        PANIC ("%s: file extends past end of scratch disk", file_name);
+      disk_read_multiple (src, sector, sector_cnt, buffer);
+      sector += sector_cnt;
       if (file_write (dst, buffer, chunk_size) != chunk_size)
         PANIC ("%s: write failed with %"PROTd" bytes unwritten",
                file_name, size);
@@ -129,7 +154,7 @@ fsutil_put (char **argv)
 
   /* Finish up. */
   file_close (dst);
-  free (buffer);
+  palloc_free_multiple (buffer, STAGING_PAGES);
 }
 
 /* Copies file FILE_NAME from the file system to the scratch disk.
@@ -157,7 +182,7 @@ fsutil_get (char **argv)
   printf ("Getting '%s' from the file system...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (DISK_SECTOR_SIZE);
+  buffer = palloc_get_multiple (0, STAGING_PAGES);
   if (buffer == NULL)
     PANIC ("couldn't allocate buffer");
 
@@ -181,17 +206,211 @@ fsutil_get (char **argv)
   /* Do copy. */
   while (size > 0) 
     {
-      int chunk_size = size > DISK_SECTOR_SIZE ? DISK_SECTOR_SIZE : size;
-      if (sector >= disk_size (dst))
+      size_t sector_cnt;
+      off_t chunk_size = staging_chunk (size, &sector_cnt);
+      if (sector + sector_cnt > disk_size (dst))
         PANIC ("%s: out of space on scratch disk", file_name);
       if (file_read (src, buffer, chunk_size) != chunk_size)
         PANIC ("%s: read failed with %"PROTd" bytes unread", file_name, size);
-      memset (buffer + chunk_size, 0, DISK_SECTOR_SIZE - chunk_size);
-      disk_write (dst, sector++, buffer);
+      memset (buffer + chunk_size, 0,
+              sector_cnt * DISK_SECTOR_SIZE - chunk_size);
+      disk_write_multiple (dst, sector, sector_cnt, buffer);
+      sector += sector_cnt;
       size -= chunk_size;
     }
 
   /* Finish up. */
   file_close (src);
-  free (buffer);
+  palloc_free_multiple (buffer, STAGING_PAGES);
+}
+
+/* Sequential reader of the scratch disk, which fills the staging
+   buffer with one multi-sector transfer at a time. */
+struct scratch_reader
+  {
+    struct disk *disk;          /* The scratch disk. */
+    disk_sector_t next;         /* Next sector to read into BUFFER. */
+    uint8_t *buffer;            /* STAGING_SECTORS sectors. */
+    size_t pos;                 /* Sectors of BUFFER already consumed. */
+    size_t cnt;                 /* Sectors in BUFFER. */
+  };
+
+/* Returns the next sectors from R, up to WANT of them, and stores
+   their number, at least 1, in *GOT. */
+static const uint8_t *
+scratch_read (struct scratch_reader *r, size_t want, size_t *got)
+{
+  const uint8_t *data;
+
+  if (r->pos == r->cnt)
+    {
+      size_t cnt = STAGING_SECTORS;
+      if (r->next >= disk_size (r->disk))
+        PANIC ("archive extends past end of scratch disk");
+      if (cnt > disk_size (r->disk) - r->next)
+        cnt = disk_size (r->disk) - r->next;
+      disk_read_multiple (r->disk, r->next, cnt, r->buffer);
+      r->next += cnt;
+      r->cnt = cnt;
+      r->pos = 0;
+    }
+
+  *got = want < r->cnt - r->pos ? want : r->cnt - r->pos;
+  data = r->buffer + r->pos * DISK_SECTOR_SIZE;
+  r->pos += *got;
+  return data;
+}
+
+/* Parses the octal number in the SIZE bytes at S, which may end
+   in spaces or null bytes.  Returns false if S holds anything
+   else or the number does not fit in an off_t. */
+static bool
+parse_octal (const uint8_t *s, size_t size, off_t *value)
+{
+  size_t i;
+
+  *value = 0;
+  for (i = 0; i < size && s[i] >= '0' && s[i] <= '7'; i++)
+    {
+      if (*value > (INT32_MAX >> 3))
+        return false;
+      *value = (*value << 3) | (s[i] - '0');
+    }
+  for (; i < size; i++)
+    if (s[i] != ' ' && s[i] != '\0')
+      return false;
+  return true;
+}
+
+/* Parses the ustar header in the sector at H.  On success,
+   stores the member's full name in NAME, which must have room
+   for USTAR_NAME_MAX + 1 bytes, its type flag in *TYPE and its
+   size in *SIZE, and returns true. */
+#define USTAR_NAME_MAX (155 + 1 + 100)
+static bool
+parse_ustar_header (const uint8_t *h, char *name, char *type, off_t *size)
+{
+  unsigned chksum = 0;
+  off_t stored;
+  size_t i;
+
+  if (memcmp (h + 257, "ustar", 5) || (h[262] != '\0' && h[262] != ' '))
+    return false;
+  for (i = 0; i < DISK_SECTOR_SIZE; i++)
+    chksum += i >= 148 && i < 156 ? ' ' : h[i];
+  if (!parse_octal (h + 148, 8, &stored) || (unsigned) stored != chksum
+      || !parse_octal (h + 124, 12, size))
+    return false;
+
+  /* The name is PREFIX "/" NAME, where each part fills its field
+     or ends in a null byte. */
+  *name = '\0';
+  if (h[345] != '\0')
+    {
+      strlcpy (name, (const char *) h + 345, 155 + 1);
+      strlcat (name, "/", USTAR_NAME_MAX + 1);
+    }
+  i = strlen (name);
+  memcpy (name + i, h, 100);
+  name[i + 100] = '\0';
+
+  *type = h[156];
+  return true;
+}
+
+/* Returns true if the sector at P is all zeros. */
+static bool
+is_zero_sector (const uint8_t *p)
+{
+  size_t i;
+
+  for (i = 0; i < DISK_SECTOR_SIZE; i++)
+    if (p[i] != 0)
+      return false;
+  return true;
+}
+
+/* Extracts the ustar archive at the start of the scratch disk
+   (hdc or hd1:0) into the file system, creating each regular
+   file and directory in it under the member's name.  The archive
+   is read in one streaming pass, a staging buffer at a time, and
+   each file is written straight out of the buffer.  Members of
+   other types are skipped.  "pintos -p" writes such an archive,
+   so that however many files are put, the kernel's command line
+   only has to say "extract". */
+void
+fsutil_extract (char **argv UNUSED)
+{
+  struct scratch_reader r;
+  char *name;
+
+  printf ("Extracting ustar archive from scratch disk...\n");
+
+  name = malloc (USTAR_NAME_MAX + 1);
+  r.buffer = palloc_get_multiple (0, STAGING_PAGES);
+  if (name == NULL || r.buffer == NULL)
+    PANIC ("couldn't allocate buffers");
+  r.disk = disk_get (1, 0);
+  if (r.disk == NULL)
+    PANIC ("couldn't open scratch disk (hdc or hd1:0)");
+  r.next = 0;
+  r.pos = r.cnt = 0;
+
+  for (;;)
+    {
+      disk_sector_t sector = r.next - (r.cnt - r.pos);
+      const uint8_t *data;
+      struct file *dst = NULL;
+      size_t got;
+      off_t size;
+      char type;
+
+      data = scratch_read (&r, 1, &got);
+      if (is_zero_sector (data))
+        break;
+      if (!parse_ustar_header (data, name, &type, &size))
+        PANIC ("bad ustar header in sector %"PRDSNu" of scratch disk",
+               sector);
+
+      if (type == '5')
+        {
+          size_t len = strlen (name);
+          while (len > 1 && name[len - 1] == '/')
+            name[--len] = '\0';
+          printf ("Making directory '%s'...\n", name);
+          if (!filesys_mkdir (name))
+            PANIC ("%s: mkdir failed", name);
+          size = 0;
+        }
+      else if (type == '0' || type == '\0')
+        {
+          printf ("Putting '%s' into the file system...\n", name);
+          if (!filesys_create (name, size))
+            PANIC ("%s: create failed", name);
+          dst = filesys_open (name);
+          if (dst == NULL)
+            PANIC ("%s: open failed", name);
+        }
+      else
+        printf ("Skipping '%s' of type '%c'...\n", name, type);
+
+      /* Copy or skip the member's data. */
+      while (size > 0)
+        {
+          off_t chunk_size;
+
+          data = scratch_read (&r, DIV_ROUND_UP (size, DISK_SECTOR_SIZE),
+                               &got);
+          chunk_size = ((off_t) got * DISK_SECTOR_SIZE < size
+                        ? (off_t) got * DISK_SECTOR_SIZE : size);
+          if (dst != NULL && file_write (dst, data, chunk_size) != chunk_size)
+            PANIC ("%s: write failed with %"PROTd" bytes unwritten",
+                   name, size);
+          size -= chunk_size;
+        }
+      file_close (dst);
+    }
+
+  palloc_free_multiple (r.buffer, STAGING_PAGES);
+  free (name);
 }
@@ -1,25 +1,118 @@
 #include "filesys/inode.h"
-#include <list.h>
 #include <debug.h>
+#include <hash.h>
+#include <iovec.h>
+#include <list.h>
 #include <round.h>
+#include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
+#include "devices/timer.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tunable.h"
 
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Inode layouts.  A file's data sectors are either listed as
+   extents, runs of consecutive sectors, or found through a
+   multi-level block index.  New files start out with extents,
+   so a file written sequentially on an unfragmented disk stays
+   physically contiguous.  A file whose extents run out is
+   converted to a block index, which can address any sector
+   individually.  A file of at most INODE_INLINE_MAX bytes has no
+   data sectors at all: its bytes are kept in the inode itself,
+   until it grows past that and is moved to an extent. */
+#define INODE_EXTENTS 0                 /* Extent list. */
+#define INODE_INDEXED 1                 /* Multi-level block index. */
+#define INODE_INLINE 2                  /* Data in the inode. */
+
+/* Number of data sectors addressed directly by an indexed inode,
+   number of sector numbers that fit in one index sector, and
+   number of extents an inode can hold. */
+#define INODE_DIRECT_CNT 122
+#define INODE_PTRS_PER_SECTOR (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+#define INODE_EXTENT_CNT 61
+
+/* Most bytes of data an inode can hold inline: all of it but the
+   fields common to every layout. */
+#define INODE_INLINE_MAX 496
+
+/* Maximum number of data sectors in an indexed inode. */
+#define INODE_MAX_SECTORS (INODE_DIRECT_CNT + INODE_PTRS_PER_SECTOR \
+                           + INODE_PTRS_PER_SECTOR * INODE_PTRS_PER_SECTOR)
+
+/* A write that skips at least this many whole sectors past end
+   of file turns an extent-based inode into an indexed one, so
+   that the skipped sectors can be left as a hole. */
+#define INODE_HOLE_MIN 8
+
+/* A run of consecutive data sectors starting at disk sector
+   START.  The run holds the file's sectors from the END of the
+   previous extent (0 for the first) up to but not including
+   END, so the extents can be binary searched by file sector. */
+struct inode_extent
+  {
+    disk_sector_t start;                /* First disk sector of the run. */
+    uint32_t end;                       /* File sector after the run. */
+  };
+
 /* On-disk inode.
-   Must be exactly DISK_SECTOR_SIZE bytes long. */
+   Must be exactly DISK_SECTOR_SIZE bytes long.
+
+   In the indexed layout the first INODE_DIRECT_CNT data sectors
+   are found directly, the next INODE_PTRS_PER_SECTOR through the
+   indirect sector, and the rest through the doubly indirect
+   sector, which holds the sector numbers of further indirect
+   sectors.  A sector number of 0 means "not allocated"; sector 0
+   always holds the free map inode, so it can never be a data or
+   index sector.  Growing an indexed inode allocates nothing: each
+   data sector is allocated, cleared, by the first write to it,
+   and a sector that was never written is a hole that reads as
+   zeros.
+
+   The data sectors of an extent-based inode are allocated when
+   the file grows but are not cleared.  Only the bytes before
+   INIT_LENGTH have ever been written; everything from there to
+   LENGTH reads as zeros without touching the disk, and is cleared
+   on disk only when a later write lands beyond it.
+
+   The data of an inline inode is part of the inode, so it is
+   written back and journaled along with it.  Its bytes past
+   LENGTH are always zero, and INIT_LENGTH equals LENGTH. */
 struct inode_disk
   {
-    disk_sector_t start;                /* First data sector. */
     off_t length;                       /* File size in bytes. */
+    off_t init_length;                  /* Bytes written so far. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint16_t layout;                    /* INODE_EXTENTS, INODE_INDEXED or
+                                           INODE_INLINE. */
+    uint16_t is_dir;                    /* Nonzero for a directory. */
+    union
+      {
+        struct
+          {
+            disk_sector_t direct[INODE_DIRECT_CNT]; /* Direct sectors. */
+            disk_sector_t indirect;     /* Indirect index sector. */
+            disk_sector_t doubly_indirect; /* Doubly indirect sector. */
+          }
+        index;
+        struct
+          {
+            uint32_t cnt;               /* Number of extents in use. */
+            struct inode_extent extents[INODE_EXTENT_CNT];
+          }
+        ext;
+        uint8_t bytes[INODE_INLINE_MAX]; /* Inline data. */
+      };
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -33,46 +126,588 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     disk_sector_t sector;               /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
+    struct list_elem idle_elem;         /* Element in idle_inodes. */
     bool removed;                       /* True if deleted, false otherwise. */
+    bool journaled;                     /* Is the data metadata? */
+    int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct rwlock lock;                 /* Protects DATA, see below. */
+    struct dir_index *dir_index;        /* Directory index, if built. */
+    void *exec_plan;                    /* Loader's plan, if cached. */
+    unsigned write_cnt;                 /* Number of writes so far. */
+    bool dirty;                         /* DATA newer than cached sector? */
+    struct list_elem dirty_elem;        /* Element in dirty_inodes. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Locking.
+
+   Each open inode has its own LOCK, so operations on different
+   files never wait for each other.  Reads, and writes that stay
+   within the written part of the file, hold LOCK for reading:
+   they only look sectors up in DATA, and the buffer cache
+   serializes access to any one sector.  Growing a file rewrites
+   DATA, possibly converting it from extents to a block index,
+   and a write past DATA's init_length must clear the gap before
+   it and then advance init_length, so both hold LOCK for
+   writing.  A directory's index lock is taken before the lock of
+   its inode, and the free map lock after it.
+
+   Journaling.
+
+   Every change to an inode sector or an index sector is logged
+   with journal_log(), and so is every change to the data of an
+   inode marked with inode_set_journaled(), which the directory
+   and free map modules do for theirs.  inode_create(),
+   inode_write_at() and the release of a removed inode each run as
+   a journal operation, nested within the caller's if it has one.
+
+   Write-back.
+
+   DATA is the only copy of an open inode that is kept current.
+   A write that changes it only marks the inode dirty, so a file
+   grown by many small appends updates its inode sector in the
+   buffer cache once, not once per write.  Dirty inodes are
+   written to the cache by inode_flush(), which the journal calls
+   before each commit, and when the inode is freed.
+
+   Idle inodes.
+
+   The last inode_close() does not free an inode that still
+   exists.  It stays in the open inode table with an open_cnt of
+   0, and goes on a list of idle inodes, so that opening it again
+   soon, as a program that opens, reads and closes the same file
+   in a loop does, needs no disk read and keeps its directory
+   index and exec plan.  Only the least recently closed idle
+   inodes beyond idle_max are freed. */
+
+/* A sector's worth of zeros. */
+static const char zeros[DISK_SECTOR_SIZE];
+
+/* Allocates a sector, fills it with zeros, and stores its number
+   in *SECTORP.  If LOG is true, the sector is an index sector, and
+   is logged with the journal.  Returns false if the disk is
+   full. */
+static bool
+allocate_zeroed (disk_sector_t *sectorp, bool log)
+{
+  if (!free_map_allocate (1, sectorp))
+    return false;
+  cache_write (*sectorp, zeros);
+  if (log)
+    journal_log (*sectorp);
+  return true;
+}
+
+/* Extent layout. */
+
+/* Returns the first file sector held by extent IDX of
+   DISK_INODE. */
+static uint32_t
+extent_first (const struct inode_disk *disk_inode, size_t idx)
+{
+  return idx > 0 ? disk_inode->ext.extents[idx - 1].end : 0;
+}
+
+/* Stores in *SECTORP the disk sector that holds file sector IDX
+   of extent-based DISK_INODE.  Returns false if no extent covers
+   IDX.  Binary searches the extent list. */
+static bool
+extent_lookup (const struct inode_disk *disk_inode, size_t idx,
+               disk_sector_t *sectorp)
+{
+  size_t lo = 0, hi = disk_inode->ext.cnt;
+
+  /* Find the first extent whose END is past IDX. */
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      if (disk_inode->ext.extents[mid].end <= idx)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  if (lo >= disk_inode->ext.cnt)
+    return false;
+
+  *sectorp = (disk_inode->ext.extents[lo].start
+              + (idx - extent_first (disk_inode, lo)));
+  return true;
+}
+
+/* Grows extent-based DISK_INODE, whose inode sector is SECTOR, to
+   hold SECTOR_CNT data sectors.  Extends the last extent in place
+   when the sectors following it are free, otherwise starts a new
+   extent as close after it as possible, or for a first extent
+   after SECTOR.
+   Returns false if the extent list is full or no contiguous run
+   of the needed size is free; the sectors added so far stay in
+   the extent list. */
+static bool
+extent_extend (struct inode_disk *disk_inode, disk_sector_t sector,
+               size_t sector_cnt)
+{
+  size_t cnt = disk_inode->ext.cnt;
+  size_t have = cnt > 0 ? disk_inode->ext.extents[cnt - 1].end : 0;
+
+  if (have < sector_cnt)
+    {
+      size_t need = sector_cnt - have;
+      disk_sector_t start = sector + 1;
+
+      if (cnt > 0)
+        {
+          struct inode_extent *last = &disk_inode->ext.extents[cnt - 1];
+          start = last->start + (last->end - extent_first (disk_inode,
+                                                           cnt - 1));
+          if (free_map_allocate_at (start, need))
+            {
+              last->end += need;
+              return true;
+            }
+        }
+      if (cnt >= INODE_EXTENT_CNT
+          || !free_map_allocate_near (start, need, &start))
+        return false;
+      disk_inode->ext.extents[cnt].start = start;
+      disk_inode->ext.extents[cnt].end = sector_cnt;
+      disk_inode->ext.cnt++;
+    }
+  return true;
+}
+
+/* Indexed layout. */
+
+/* Stores entry IDX of index sector BLOCK in *SECTORP.  If the
+   entry is 0 and CREATE is true, a zeroed sector is allocated
+   for it first.  Returns true if *SECTORP is an allocated
+   sector. */
+static bool
+index_entry (disk_sector_t block, size_t idx, disk_sector_t *sectorp,
+             bool create)
+{
+  size_t ofs = idx * sizeof *sectorp;
+
+  cache_read_at (block, sectorp, ofs, sizeof *sectorp);
+  if (*sectorp == 0 && create)
+    {
+      if (!allocate_zeroed (sectorp, true))
+        return false;
+      journal_log (block);
+      cache_write_at (block, sectorp, ofs, sizeof *sectorp);
+    }
+  return *sectorp != 0;
+}
+
+/* Where the sector number of one data sector is stored: in the
+   inode itself if DIRECT is non-null, otherwise at byte offset
+   OFS within index sector BLOCK. */
+struct index_slot
+  {
+    disk_sector_t *direct;
+    disk_sector_t block;
+    size_t ofs;
+  };
+
+/* Finds the slot that holds the sector number of data sector IDX
+   of indexed DISK_INODE and stores it in *SLOT.  Index sectors
+   that are missing on the way are allocated if CREATE is true.
+   Returns false if IDX is beyond the maximum file size, or if an
+   index sector is missing and cannot or may not be allocated.
+   Needs at most two index sector reads. */
+static bool
+index_find_slot (struct inode_disk *disk_inode, size_t idx,
+                 struct index_slot *slot, bool create)
+{
+  disk_sector_t indirect;
+
+  slot->direct = NULL;
+  if (idx < INODE_DIRECT_CNT)
+    {
+      slot->direct = &disk_inode->index.direct[idx];
+      return true;
+    }
+  idx -= INODE_DIRECT_CNT;
+
+  if (idx < INODE_PTRS_PER_SECTOR)
+    {
+      if (disk_inode->index.indirect == 0
+          && (!create
+              || !allocate_zeroed (&disk_inode->index.indirect, true)))
+        return false;
+      slot->block = disk_inode->index.indirect;
+      slot->ofs = idx * sizeof (disk_sector_t);
+      return true;
+    }
+  idx -= INODE_PTRS_PER_SECTOR;
+
+  if (idx < INODE_PTRS_PER_SECTOR * INODE_PTRS_PER_SECTOR)
+    {
+      if (disk_inode->index.doubly_indirect == 0
+          && (!create
+              || !allocate_zeroed (&disk_inode->index.doubly_indirect,
+                                   true)))
+        return false;
+      if (!index_entry (disk_inode->index.doubly_indirect,
+                        idx / INODE_PTRS_PER_SECTOR, &indirect, create))
+        return false;
+      slot->block = indirect;
+      slot->ofs = idx % INODE_PTRS_PER_SECTOR * sizeof (disk_sector_t);
+      return true;
+    }
+
+  /* File too large. */
+  return false;
+}
+
+/* Returns the sector number stored in SLOT. */
+static disk_sector_t
+slot_get (const struct index_slot *slot)
+{
+  disk_sector_t sector;
+
+  if (slot->direct != NULL)
+    return *slot->direct;
+  cache_read_at (slot->block, &sector, slot->ofs, sizeof sector);
+  return sector;
+}
+
+/* Stores SECTOR in SLOT. */
+static void
+slot_set (const struct index_slot *slot, disk_sector_t sector)
+{
+  if (slot->direct != NULL)
+    *slot->direct = sector;
+  else
+    {
+      journal_log (slot->block);
+      cache_write_at (slot->block, &sector, slot->ofs, sizeof sector);
+    }
+}
+
+/* Stores in *SECTORP the sector that holds data sector IDX of
+   indexed DISK_INODE.  If that sector, or an index sector on the
+   way to it, is not allocated and CREATE is true, allocates it.
+   Returns true if *SECTORP is an allocated sector. */
+static bool
+index_lookup (struct inode_disk *disk_inode, size_t idx,
+              disk_sector_t *sectorp, bool create)
+{
+  struct index_slot slot;
+
+  if (!index_find_slot (disk_inode, idx, &slot, create))
+    return false;
+  *sectorp = slot_get (&slot);
+  if (*sectorp == 0)
+    {
+      if (!create || !allocate_zeroed (sectorp, false))
+        return false;
+      slot_set (&slot, *sectorp);
+    }
+  return true;
+}
+
+/* Releases index or data sector SECTOR and, for an index sector
+   with LEVEL > 0, every sector reachable from it through LEVEL
+   levels of index sectors.  Data sectors, at level 0, are only
+   released if DATA is true. */
+static void
+release_tree (disk_sector_t sector, int level, bool data)
+{
+  if (sector == 0 || (level == 0 && !data))
+    return;
+  if (level > 0)
+    {
+      size_t i;
+      for (i = 0; i < INODE_PTRS_PER_SECTOR; i++)
+        {
+          disk_sector_t entry;
+          cache_read_at (sector, &entry, i * sizeof entry, sizeof entry);
+          release_tree (entry, level - 1, data);
+        }
+    }
+  free_map_release (sector, 1);
+}
+
+/* Releases the index sectors of indexed DISK_INODE, and its data
+   sectors too if DATA is true. */
+static void
+index_release (struct inode_disk *disk_inode, bool data)
+{
+  size_t i;
+
+  for (i = 0; i < INODE_DIRECT_CNT; i++)
+    release_tree (disk_inode->index.direct[i], 0, data);
+  release_tree (disk_inode->index.indirect, 1, data);
+  release_tree (disk_inode->index.doubly_indirect, 2, data);
+}
+
+/* Converts extent-based DISK_INODE to the indexed layout,
+   without moving any data.  Returns false if memory or index
+   sectors cannot be allocated, leaving DISK_INODE unchanged. */
+static bool
+inode_convert_to_index (struct inode_disk *disk_inode)
+{
+  struct inode_disk *indexed;
+  size_t i;
+
+  ASSERT (disk_inode->layout == INODE_EXTENTS);
+
+  indexed = calloc (1, sizeof *indexed);
+  if (indexed == NULL)
+    return false;
+  indexed->length = disk_inode->length;
+  indexed->init_length = disk_inode->init_length;
+  indexed->magic = disk_inode->magic;
+  indexed->layout = INODE_INDEXED;
+  indexed->is_dir = disk_inode->is_dir;
+
+  for (i = 0; i < disk_inode->ext.cnt; i++)
+    {
+      const struct inode_extent *e = &disk_inode->ext.extents[i];
+      uint32_t idx = extent_first (disk_inode, i);
+      disk_sector_t sector;
+
+      for (sector = e->start; idx < e->end; idx++, sector++)
+        {
+          struct index_slot slot;
+          if (!index_find_slot (indexed, idx, &slot, true))
+            {
+              index_release (indexed, false);
+              free (indexed);
+              return false;
+            }
+          slot_set (&slot, sector);
+        }
+    }
+
+  memcpy (disk_inode, indexed, sizeof *disk_inode);
+  free (indexed);
+  return true;
+}
+
+/* Inline layout. */
+
+/* Moves the data of inline DISK_INODE, whose inode sector is
+   INODE_SECTOR, to a newly allocated data sector near it, making
+   it an extent-based inode with one extent, or none if it is
+   empty.  If LOG is true, the data is metadata and the sector is
+   logged with the journal.  Returns false if memory or the sector
+   cannot be allocated, leaving DISK_INODE unchanged. */
+static bool
+inline_to_extents (struct inode_disk *disk_inode, disk_sector_t inode_sector,
+                   bool log)
+{
+  uint8_t *sector_buf;
+  disk_sector_t sector = 0;
+
+  ASSERT (disk_inode->layout == INODE_INLINE);
+
+  sector_buf = calloc (1, DISK_SECTOR_SIZE);
+  if (sector_buf == NULL)
+    return false;
+  if (disk_inode->length > 0)
+    {
+      if (!free_map_allocate_near (inode_sector + 1, 1, &sector))
+        {
+          free (sector_buf);
+          return false;
+        }
+      memcpy (sector_buf, disk_inode->bytes, disk_inode->length);
+      cache_write (sector, sector_buf);
+      if (log)
+        journal_log (sector);
+    }
+  free (sector_buf);
+
+  memset (disk_inode->bytes, 0, sizeof disk_inode->bytes);
+  disk_inode->layout = INODE_EXTENTS;
+  if (disk_inode->length > 0)
+    {
+      disk_inode->ext.cnt = 1;
+      disk_inode->ext.extents[0].start = sector;
+      disk_inode->ext.extents[0].end = 1;
+    }
+  return true;
+}
+
+/* Both layouts. */
+
+/* Stores in *SECTORP the sector that holds data sector IDX of
+   DISK_INODE.  Returns false if it is not allocated. */
+static bool
+inode_lookup (struct inode_disk *disk_inode, size_t idx,
+              disk_sector_t *sectorp)
+{
+  if (disk_inode->layout == INODE_EXTENTS)
+    return extent_lookup (disk_inode, idx, sectorp);
+  else if (disk_inode->layout == INODE_INDEXED)
+    return index_lookup (disk_inode, idx, sectorp, false);
+  else
+    return false;
+}
+
+/* Grows DISK_INODE, whose inode sector is SECTOR, to LENGTH
+   bytes.  An extent-based inode gets its new data sectors
+   allocated now, near its last ones; one that cannot grow any
+   further is converted to the indexed layout, which leaves the
+   new sectors to be allocated as they are written.
+   Returns false if the disk fills up or LENGTH exceeds the
+   maximum file size, in which case the sectors allocated so far
+   stay with the inode but the length is unchanged. */
+static bool
+inode_extend (struct inode_disk *disk_inode, disk_sector_t sector,
+              off_t length)
+{
+  size_t sector_cnt = bytes_to_sectors (length);
+
+  if (disk_inode->layout == INODE_EXTENTS
+      && !extent_extend (disk_inode, sector, sector_cnt)
+      && !inode_convert_to_index (disk_inode))
+    return false;
+
+  if (disk_inode->layout == INODE_INDEXED && sector_cnt > INODE_MAX_SECTORS)
+    return false;
+
+  if (length > disk_inode->length)
+    disk_inode->length = length;
+  return true;
+}
+
+/* Releases all data and index sectors of DISK_INODE. */
+static void
+inode_deallocate (struct inode_disk *disk_inode)
+{
+  size_t i;
+
+  if (disk_inode->layout == INODE_EXTENTS)
+    for (i = 0; i < disk_inode->ext.cnt; i++)
+      free_map_release (disk_inode->ext.extents[i].start,
+                        (disk_inode->ext.extents[i].end
+                         - extent_first (disk_inode, i)));
+  else if (disk_inode->layout == INODE_INDEXED)
+    index_release (disk_inode, true);
+}
 
 /* Returns the disk sector that contains byte offset POS within
    INODE.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static disk_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
+  disk_sector_t sector;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / DISK_SECTOR_SIZE;
+  if (pos < inode->data.length
+      && inode_lookup (&inode->data, pos / DISK_SECTOR_SIZE, &sector))
+    return sector;
   else
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+
+/* Protects open_inodes, idle_inodes, and the open_cnt of every
+   open inode. */
+static struct lock open_inodes_lock;
+
+/* Inodes in open_inodes with an open_cnt of 0, least recently
+   closed first.  At most idle_max, tunable as "idle_inodes"; 0
+   frees every inode at its last close. */
+#define IDLE_MAX_DEFAULT 32
+static struct list idle_inodes;
+static int idle_cnt;
+static int idle_max = IDLE_MAX_DEFAULT;
+
+/* Seconds between defragmenter passes, tunable as "defrag_secs";
+   0 stops it.  See "Defragmentation" below. */
+#define DEFRAG_SECS_DEFAULT 5
+static int defrag_secs = DEFRAG_SECS_DEFAULT;
+
+/* Statistics. */
+static long long open_call_cnt; /* Calls to inode_open(). */
+static long long idle_hit_cnt;  /* Of those, that found an idle inode. */
+static long long inline_create_cnt; /* Inodes created inline. */
+static long long inline_move_cnt;   /* Inline inodes moved to sectors. */
+static long long defrag_file_cnt;   /* Files defragmented. */
+static long long defrag_fragment_cnt; /* Fragments they lost. */
+static long long defrag_sector_cnt; /* Data sectors moved. */
+
+/* Open inodes whose DATA has not been written to the buffer
+   cache, and the lock that protects the list and each inode's
+   DIRTY flag. */
+static struct list dirty_inodes;
+static struct lock dirty_lock;
+
+/* Returns a hash value for inode E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct inode *inode = hash_entry (e, struct inode, elem);
+  return hash_int (inode->sector);
+}
+
+/* Returns true if inode A precedes inode B. */
+static bool
+inode_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct inode *a = hash_entry (a_, struct inode, elem);
+  const struct inode *b = hash_entry (b_, struct inode, elem);
+  return a->sector < b->sector;
+}
+
+/* Returns true if INODE is the one in SECTOR. */
+static inline bool
+inode_has_sector (const struct inode *inode, disk_sector_t sector)
+{
+  return inode->sector == sector;
+}
+
+DEFINE_HASH_FIND (find_open_inode, struct inode, elem, disk_sector_t,
+                  hash_int, inode_has_sector);
+
+/* Cache of struct inode. */
+static struct kmem_cache *inode_cache;
+
+/* Constructor for struct inode: sets up the parts that stay the
+   same from one use to the next. */
+static void
+inode_ctor (void *inode_)
+{
+  struct inode *inode = inode_;
+  rw_init (&inode->lock);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init_incremental (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("inode_init: out of memory");
+  lock_init_named (&open_inodes_lock, "open_inodes");
+  list_init (&idle_inodes);
+  tunable_register ("idle_inodes", &idle_max, 0, 1024);
+  tunable_register ("defrag_secs", &defrag_secs, 0, 3600);
+  list_init (&dirty_inodes);
+  lock_init_named (&dirty_lock, "dirty_inodes");
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode),
+                                   inode_ctor);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   disk.
+   disk.  The inode is a directory if IS_DIR is true.  Data that
+   fits is kept inline, in the inode sector.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
-inode_create (disk_sector_t sector, off_t length)
+inode_create (disk_sector_t sector, off_t length, bool is_dir)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -86,65 +721,93 @@ inode_create (disk_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
+      journal_begin ();
+      disk_inode->length = 0;
+      disk_inode->init_length = 0;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start))
+      disk_inode->is_dir = is_dir;
+      if (length <= INODE_INLINE_MAX)
         {
-          disk_write (filesys_disk, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[DISK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                disk_write (filesys_disk, disk_inode->start + i, zeros); 
-            }
+          disk_inode->layout = INODE_INLINE;
+          disk_inode->length = disk_inode->init_length = length;
+          inline_create_cnt++;
+        }
+      else
+        disk_inode->layout = INODE_EXTENTS;
+      if (disk_inode->layout == INODE_INLINE
+          || inode_extend (disk_inode, sector, length))
+        {
+          cache_write (sector, disk_inode);
+          journal_log (sector);
           success = true; 
         } 
+      else
+        inode_deallocate (disk_inode);
+      journal_end ();
       free (disk_inode);
     }
   return success;
 }
 
+/* Opens INODE, which is in the open inode table, once more,
+   taking it off the idle list if it was idle.  Returns true if
+   it was.  OPEN_INODES_LOCK must be held. */
+static bool
+reopen_locked (struct inode *inode)
+{
+  ASSERT (lock_held_by_current_thread (&open_inodes_lock));
+
+  if (inode->open_cnt++ > 0)
+    return false;
+  list_remove (&inode->idle_elem);
+  idle_cnt--;
+  return true;
+}
+
 /* Reads an inode from SECTOR
    and returns a `struct inode' that contains it.
    Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) 
 {
-  struct list_elem *e;
   struct inode *inode;
 
-  
-  /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  lock_acquire (&open_inodes_lock);
+  open_call_cnt++;
+
+  /* Check whether this inode is already open or idle. */
+  inode = find_open_inode (&open_inodes, sector);
+  if (inode != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      if (reopen_locked (inode))
+        idle_hit_cnt++;
+      lock_release (&open_inodes_lock);
+      return inode; 
     }
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
   {
+    lock_release (&open_inodes_lock);
     return NULL;
   }
   
-  list_push_front (&open_inodes, &inode->elem);
-  
-  /* Initialize. */
+  /* Initialize.  The inode is read before the lock is released,
+     so that a concurrent opener never sees it half filled in. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->removed = false;
+  inode->journaled = false;
+  inode->deny_write_cnt = 0;
+  inode->dir_index = NULL;
+  inode->exec_plan = NULL;
+  inode->write_cnt = 0;
+  inode->dirty = false;
+  cache_read (inode->sector, &inode->data);
+  hash_insert (&open_inodes, &inode->elem);
   
-  disk_read (filesys_disk, inode->sector, &inode->data);
-  
+  lock_release (&open_inodes_lock);
   return inode;
 }
 
@@ -154,7 +817,9 @@ inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
   {
+    lock_acquire (&open_inodes_lock);
     inode->open_cnt++;
+    lock_release (&open_inodes_lock);
   }
   return inode;
 }
@@ -166,9 +831,10 @@ inode_get_inumber (const struct inode *inode)
   return inode->sector;
 }
 
-/* Closes INODE and writes it to disk.
-   If this was the last reference to INODE, frees its memory.
-   If INODE was also a removed inode, frees its blocks. */
+/* Closes INODE.  If this was the last reference to INODE and it
+   was removed, frees its memory and its blocks.  Otherwise, keeps
+   it as an idle inode, freeing the least recently closed idle
+   inode instead if there are too many. */
 void
 inode_close (struct inode *inode) 
 {
@@ -176,25 +842,86 @@ inode_close (struct inode *inode)
   if (inode == NULL)
     return;
 
-    
-  /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt > 0)
     {
-      /* Remove from inode list. */
-      list_remove (&inode->elem);
-      
- 
-      /* Deallocate blocks if the file is marked as removed. */
-      if (inode->removed) 
+      lock_release (&open_inodes_lock);
+      return;
+    }
+
+  if (!inode->removed && idle_max > 0)
+    {
+      list_push_back (&idle_inodes, &inode->idle_elem);
+      if (++idle_cnt <= idle_max)
         {
-          free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          lock_release (&open_inodes_lock);
+          return;
         }
+      inode = list_entry (list_pop_front (&idle_inodes),
+                          struct inode, idle_elem);
+      idle_cnt--;
+    }
 
-      free (inode);
-      return;
+  /* INODE is to be freed.  Write it back, unless it was removed,
+     before leaving the open inode table, so that opening it
+     again reads the current data.  Once it is out of the table
+     nobody else can reach it, so the rest needs no lock. */
+  lock_acquire (&dirty_lock);
+  if (inode->dirty)
+    {
+      if (!inode->removed)
+        cache_write (inode->sector, &inode->data);
+      list_remove (&inode->dirty_elem);
+      inode->dirty = false;
+    }
+  lock_release (&dirty_lock);
+  hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
+  /* Deallocate blocks if the file is marked as removed. */
+  if (inode->removed) 
+    {
+      journal_begin ();
+      free_map_release (inode->sector, 1);
+      inode_deallocate (&inode->data);
+      journal_end ();
     }
+
+  dir_index_destroy (inode->dir_index);
+  free (inode->exec_plan);
+  kmem_cache_free (inode_cache, inode);
+}
+
+/* Marks INODE's DATA as changed.  Its sector must already be
+   logged with the journal.  The caller must hold INODE's lock for
+   writing, within a journal operation. */
+static void
+mark_dirty (struct inode *inode)
+{
+  lock_acquire (&dirty_lock);
+  if (!inode->dirty)
+    {
+      inode->dirty = true;
+      list_push_back (&dirty_inodes, &inode->dirty_elem);
+    }
+  lock_release (&dirty_lock);
+}
+
+/* Writes every dirty open inode to the buffer cache.  Called by
+   the journal before a commit, when no operation that could
+   change an inode is in progress. */
+void
+inode_flush (void)
+{
+  lock_acquire (&dirty_lock);
+  while (!list_empty (&dirty_inodes))
+    {
+      struct inode *inode = list_entry (list_pop_front (&dirty_inodes),
+                                        struct inode, dirty_elem);
+      cache_write (inode->sector, &inode->data);
+      inode->dirty = false;
+    }
+  lock_release (&dirty_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -206,18 +933,147 @@ inode_remove (struct inode *inode)
   inode->removed = true;
 }
 
+/* Returns true if INODE has been removed. */
+bool
+inode_is_removed (const struct inode *inode)
+{
+  return inode->removed;
+}
+
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return inode->data.is_dir != 0;
+}
+
+/* Calls FETCH once for each run of physically consecutive disk
+   sectors that hold INODE's bytes from OFFSET up to OFFSET +
+   SIZE.  Bytes past the end of INODE, or past the part of it
+   that has been written, are ignored.
+   The caller must hold INODE's lock. */
+static void
+inode_for_each_run (struct inode *inode, off_t offset, off_t size,
+                    void (*fetch) (disk_sector_t, size_t))
+{
+  off_t end = offset + size;
+  disk_sector_t run_start = 0;
+  size_t run_cnt = 0;
+
+  if (end > inode->data.init_length)
+    end = inode->data.init_length;
+  for (offset -= offset % DISK_SECTOR_SIZE; offset < end;
+       offset += DISK_SECTOR_SIZE)
+    {
+      disk_sector_t sector = byte_to_sector (inode, offset);
+      if (run_cnt > 0 && sector == run_start + run_cnt)
+        run_cnt++;
+      else
+        {
+          if (run_cnt > 0)
+            fetch (run_start, run_cnt);
+          run_start = sector;
+          run_cnt = sector != (disk_sector_t) -1;
+        }
+    }
+  if (run_cnt > 0)
+    fetch (run_start, run_cnt);
+}
+
+/* Page cache.
+
+   With VM, the frame table keeps whole pages of file data in
+   user frames, keyed by inode and offset, for executables and
+   mapped files, and evicts them by the same clock as every other
+   user page.  It registers itself here with
+   inode_set_page_cache(), so that inode_read_at() serves reads
+   from those pages first, and only what they do not hold comes
+   from the buffer cache.  Once a page's data is in a frame, the
+   frame table drops the sectors from the buffer cache with
+   inode_uncache(), so that the same data is not kept twice.  The
+   data of journaled inodes is never in the page cache. */
+static inode_page_read_func *page_read;
+
+/* Makes READ the page cache hook. */
+void
+inode_set_page_cache (inode_page_read_func *read)
+{
+  page_read = read;
+}
+
 /* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
    Returns the number of bytes actually read, which may be less
    than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset)
+{
+  off_t cnt = 0;
+
+  if (page_read != NULL && !inode->journaled && size > 0)
+    cnt = page_read (inode, buffer, size, offset);
+  if (cnt < size)
+    cnt += inode_read_through (inode, (uint8_t *) buffer + cnt, size - cnt,
+                               offset + cnt);
+  return cnt;
+}
+
+/* Drops a run of CNT sectors starting at SECTOR from the buffer
+   cache. */
+static void
+uncache_run (disk_sector_t sector, size_t cnt)
+{
+  cache_invalidate (sector, cnt, false);
+}
+
+/* Drops the sectors that hold INODE's SIZE bytes at OFFSET from
+   the buffer cache, writing back any that are dirty, now that the
+   page cache holds the data. */
+void
+inode_uncache (struct inode *inode, off_t offset, off_t size)
+{
+  rw_read_acquire (&inode->lock);
+  inode_for_each_run (inode, offset, size, uncache_run);
+  rw_read_release (&inode->lock);
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET, as inode_read_at() does, but through the buffer cache
+   alone, for the page cache to fill a page with. */
+off_t
+inode_read_through (struct inode *inode, void *buffer_, off_t size,
+                    off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
-  
+  bool multi = (size > 0 && (offset / DISK_SECTOR_SIZE
+                             != (offset + size - 1) / DISK_SECTOR_SIZE));
+  off_t fetched = offset;
+
+  rw_read_acquire (&inode->lock);
+  if (inode->data.layout == INODE_INLINE)
+    {
+      if (offset < inode->data.length)
+        {
+          bytes_read = inode->data.length - offset;
+          if (bytes_read > size)
+            bytes_read = size;
+          memcpy (buffer, inode->data.bytes + offset, bytes_read);
+        }
+      size = 0;
+    }
   while (size > 0) 
     {
+      /* A read that spans several sectors brings them into the
+         cache with multi-sector transfers, a window at a time so
+         that they are not evicted again before being copied. */
+      if (multi && offset >= fetched)
+        {
+          off_t window = CACHE_FETCH_MAX * DISK_SECTOR_SIZE;
+          inode_for_each_run (inode, offset, size < window ? size : window,
+                              cache_fetch);
+          fetched = offset + window;
+        }
+
       /* Disk sector to read, starting byte offset within sector. */
       disk_sector_t sector_idx = byte_to_sector (inode, offset);
       int sector_ofs = offset % DISK_SECTOR_SIZE;
@@ -232,23 +1088,17 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
+      /* Copy the chunk out of the buffer cache, or supply zeros
+         for holes and the part that has never been written. */
+      if (offset >= inode->data.init_length
+          || sector_idx == (disk_sector_t) -1)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else
         {
-          /* Read full sector directly into caller's buffer. */
-          disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          disk_read (filesys_disk, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          if (chunk_size > inode->data.init_length - offset)
+            chunk_size = inode->data.init_length - offset;
+          cache_read_at (sector_idx, buffer + bytes_read,
+                         sector_ofs, chunk_size);
         }
       
       /* Advance. */
@@ -256,77 +1106,720 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  rw_read_release (&inode->lock);
 
   return bytes_read;
 }
 
+/* Queues the sectors of INODE that hold the SIZE bytes starting
+   at OFFSET for background loading into the buffer cache.  Bytes
+   past the end of INODE are ignored. */
+void
+inode_read_ahead (struct inode *inode, off_t offset, off_t size)
+{
+  rw_read_acquire (&inode->lock);
+  inode_for_each_run (inode, offset, size, cache_read_ahead);
+  rw_read_release (&inode->lock);
+}
+
+/* Writes SIZE bytes from BUFFER into INODE at OFFSET, all of
+   which must lie within INODE's length.  A hole in an indexed
+   inode is filled in if CREATE is true, in which case the caller
+   must hold INODE's lock for writing, otherwise the write stops
+   there; it also stops if the disk is full.  Returns the number
+   of bytes written.  The caller must hold INODE's lock. */
+static off_t
+write_chunks (struct inode *inode, const uint8_t *buffer, off_t size,
+              off_t offset, bool create)
+{
+  off_t bytes_written = 0;
+
+  while (size > 0) 
+    {
+      /* Sector to write, starting byte offset within sector. */
+      size_t idx = offset / DISK_SECTOR_SIZE;
+      int sector_ofs = offset % DISK_SECTOR_SIZE;
+      disk_sector_t sector_idx;
+      if (inode->data.layout == INODE_EXTENTS
+          ? !extent_lookup (&inode->data, idx, &sector_idx)
+          : !index_lookup (&inode->data, idx, &sector_idx, create))
+        break;
+
+      /* Number of bytes to actually write into this sector. */
+      int sector_left = DISK_SECTOR_SIZE - sector_ofs;
+      int chunk_size = size < sector_left ? size : sector_left;
+
+      /* Copy the chunk into the buffer cache.  The cache reads
+         the old sector contents first only if the chunk does not
+         cover the whole sector, and not even then if the sector
+         lies wholly past the written part of the file, whose old
+         contents are never read: a run of small appends reads
+         nothing from disk. */
+      if (inode->journaled)
+        journal_log (sector_idx);
+      if ((off_t) idx * DISK_SECTOR_SIZE >= inode->data.init_length)
+        cache_write_fresh (sector_idx, buffer + bytes_written,
+                           sector_ofs, chunk_size);
+      else
+        cache_write_at (sector_idx, buffer + bytes_written,
+                        sector_ofs, chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+  return bytes_written;
+}
+
+/* Clears INODE's bytes from its init_length up to END on disk,
+   leaving holes alone.  The caller must hold INODE's lock for
+   writing. */
+static void
+clear_gap (struct inode *inode, off_t end)
+{
+  off_t offset = inode->data.init_length;
+
+  while (offset < end)
+    {
+      int chunk_size = DISK_SECTOR_SIZE - offset % DISK_SECTOR_SIZE;
+      if (chunk_size > end - offset)
+        chunk_size = end - offset;
+      write_chunks (inode, (const uint8_t *) zeros, chunk_size, offset,
+                    false);
+      offset += chunk_size;
+    }
+}
+
+/* Returns true if a write at OFFSET would leave a hole of at
+   least INODE_HOLE_MIN sectors past the end of extent-based
+   INODE. */
+static bool
+leaves_hole (const struct inode *inode, off_t offset)
+{
+  return (inode->data.layout == INODE_EXTENTS
+          && ((size_t) offset / DISK_SECTOR_SIZE
+              >= bytes_to_sectors (inode->data.length) + INODE_HOLE_MIN));
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if the disk is full or an error occurs.
+   A write past end of file extends the inode; any gap between
+   the old end of file and OFFSET reads back as zeros.
+   Nothing is written while writes are denied, see
+   inode_deny_write(). */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  off_t old_length;
 
-    
-  while (size > 0) 
+  if (inode->deny_write_cnt > 0 || size <= 0)
+    return 0;
+
+  /* Anything derived from the old contents is now stale. */
+  inode->write_cnt++;
+
+  /* A write within the written part of the file that fills no
+     holes changes no metadata, so it runs alongside other readers
+     and writers.  Only a journaled inode's data needs the journal
+     here. */
+  if (inode->journaled)
+    journal_begin ();
+  rw_read_acquire (&inode->lock);
+  if (offset + size <= inode->data.init_length
+      && inode->data.layout != INODE_INLINE)
+    bytes_written = write_chunks (inode, buffer, size, offset, false);
+  rw_read_release (&inode->lock);
+  if (bytes_written == size)
     {
-      /* Sector to write, starting byte offset within sector. */
-      disk_sector_t sector_idx = byte_to_sector (inode, offset);
-      int sector_ofs = offset % DISK_SECTOR_SIZE;
+      if (inode->journaled)
+        journal_end ();
+      return bytes_written;
+    }
+  if (!inode->journaled)
+    journal_begin ();
+  buffer += bytes_written;
+  size -= bytes_written;
+  offset += bytes_written;
 
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
-      int sector_left = DISK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
+  /* Inline data is changed in place, unless the write takes it
+     past INODE_INLINE_MAX, in which case it moves to a data
+     sector first. */
+  rw_write_acquire (&inode->lock);
+  if (inode->data.layout == INODE_INLINE)
+    {
+      if (offset + size <= INODE_INLINE_MAX)
+        {
+          memcpy (inode->data.bytes + offset, buffer, size);
+          if (offset + size > inode->data.length)
+            inode->data.length = inode->data.init_length = offset + size;
+          bytes_written += size;
+          size = 0;
+        }
+      else if (inline_to_extents (&inode->data, inode->sector,
+                                  inode->journaled))
+        inline_move_cnt++;
+      else
+        size = 0;
+    }
 
-      /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
-        break;
+  /* Otherwise grow the file first, so that readers never see a
+     length that covers unallocated sectors, then clear whatever
+     lies between the written part and OFFSET.  A write far past
+     end of file leaves a hole instead. */
+  old_length = inode->data.length;
+  if (size > 0 && offset + size > old_length)
+    {
+      if (leaves_hole (inode, offset))
+        inode_convert_to_index (&inode->data);
+      inode_extend (&inode->data, inode->sector, offset + size);
+    }
+  if (size > 0 && offset < inode->data.length)
+    {
+      off_t cnt;
+
+      if (size > inode->data.length - offset)
+        size = inode->data.length - offset;
+      clear_gap (inode, offset);
+      cnt = write_chunks (inode, buffer, size, offset, true);
+
+      /* Do not keep a length that the disk could not fill. */
+      if (cnt < size && inode->data.length > old_length)
+        inode->data.length = (offset + cnt > old_length
+                              ? offset + cnt : old_length);
+      if (offset + cnt > inode->data.init_length)
+        inode->data.init_length = offset + cnt;
+      bytes_written += cnt;
+    }
+  journal_log (inode->sector);
+  mark_dirty (inode);
+  rw_write_release (&inode->lock);
+  journal_end ();
+
+  return bytes_written;
+}
+
+/* Defragmentation.
+
+   A file that grows alongside others, or whose extents ran out so
+   that it was converted to a block index, ends up in pieces
+   across the disk, and reading it then takes a disk request per
+   piece instead of one per CACHE_FETCH_MAX sectors.  Every
+   defrag_secs seconds a daemon looks through the open and idle
+   inodes and moves each regular file of DEFRAG_MIN_FRAGMENTS or
+   more pieces, and at most DEFRAG_MAX_SECTORS, into one free run
+   near its inode, which becomes its only extent.
+
+   The data moves from disk to disk, with dirty cached copies
+   written back first and stale ones dropped after, and is all on
+   disk before the journal logs the new layout, so a crash leaves
+   the file wholly in its old place or wholly in its new one.  The
+   inode's lock is held for writing throughout, so that nobody
+   sees the file half moved; to keep that short, the copy is done
+   in the best-effort I/O class rather than the idle class the
+   daemon otherwise uses.  Files with holes are left alone, and
+   so are directories and the free map, whose data is
+   journaled. */
+
+/* Fewest pieces a file must be in, and most data sectors it may
+   have, to be defragmented. */
+#define DEFRAG_MIN_FRAGMENTS 2
+#define DEFRAG_MAX_SECTORS 1024
+
+/* Sectors copied at a time. */
+#define DEFRAG_BATCH CACHE_FETCH_MAX
+
+/* Returns the number of file sectors that a single extent for
+   DISK_INODE must hold. */
+static size_t
+layout_sectors (const struct inode_disk *disk_inode)
+{
+  if (disk_inode->layout == INODE_EXTENTS)
+    return (disk_inode->ext.cnt > 0
+            ? disk_inode->ext.extents[disk_inode->ext.cnt - 1].end : 0);
+  return bytes_to_sectors (disk_inode->length);
+}
+
+/* Returns true if INODE may be worth defragmenting: a regular
+   file in use, with extents enough or a block index, and not too
+   big.  Reads INODE's data without its lock, so the answer is only
+   a hint until the lock is held. */
+static bool
+defrag_candidate (const struct inode *inode)
+{
+  const struct inode_disk *d = &inode->data;
+
+  return (!inode->removed && !inode->journaled && !d->is_dir
+          && (d->layout == INODE_INDEXED
+              || (d->layout == INODE_EXTENTS
+                  && d->ext.cnt >= DEFRAG_MIN_FRAGMENTS))
+          && layout_sectors (d) <= DEFRAG_MAX_SECTORS);
+}
+
+/* Returns the number of runs of consecutive disk sectors that
+   hold the written part of INODE, or 0 if it is inline or has a
+   hole.  The caller must hold INODE's lock. */
+static size_t
+count_fragments (struct inode *inode)
+{
+  struct inode_disk *d = &inode->data;
+  size_t used = bytes_to_sectors (d->init_length);
+  disk_sector_t sector, prev = 0;
+  size_t idx, cnt = 0;
+
+  if (d->layout == INODE_EXTENTS)
+    return d->ext.cnt;
+  else if (d->layout != INODE_INDEXED)
+    return 0;
+  for (idx = 0; idx < used; idx++)
+    {
+      if (!index_lookup (d, idx, &sector, false))
+        return 0;
+      if (idx == 0 || sector != prev + 1)
+        cnt++;
+      prev = sector;
+    }
+  return cnt;
+}
+
+/* Copies INODE's CNT data sectors starting at file sector IDX,
+   which must all be allocated, to the CNT disk sectors starting
+   at DST, by way of BUFFER, which must hold CNT sectors.  The
+   caller must hold INODE's lock. */
+static void
+copy_sectors (struct inode *inode, size_t idx, size_t cnt,
+              disk_sector_t dst, uint8_t *buffer)
+{
+  size_t i, run;
+
+  for (i = 0; i < cnt; i += run)
+    {
+      disk_sector_t src, next;
+
+      if (!inode_lookup (&inode->data, idx + i, &src))
+        NOT_REACHED ();
+      for (run = 1; i + run < cnt; run++)
+        if (!inode_lookup (&inode->data, idx + i + run, &next)
+            || next != src + run)
+          break;
+      cache_invalidate (src, run, false);
+      disk_read_multiple (filesys_disk, src, run,
+                          buffer + i * DISK_SECTOR_SIZE);
+    }
+  disk_write_multiple (filesys_disk, dst, cnt, buffer);
+  cache_invalidate (dst, cnt, true);
+}
+
+/* Moves INODE's data into one run of free sectors near it.
+   Returns false if it turns out not to need that, or no such run
+   is free, or memory is short. */
+static bool
+defrag_inode (struct inode *inode)
+{
+  struct inode_disk old;
+  size_t fragments, sector_cnt, used, idx;
+  disk_sector_t start;
+  uint8_t *buffer;
+  bool success = false;
+
+  buffer = malloc (DEFRAG_BATCH * DISK_SECTOR_SIZE);
+  if (buffer == NULL)
+    return false;
+
+  journal_begin ();
+  rw_write_acquire (&inode->lock);
+  fragments = count_fragments (inode);
+  sector_cnt = layout_sectors (&inode->data);
+  used = bytes_to_sectors (inode->data.init_length);
+  if (defrag_candidate (inode) && fragments >= DEFRAG_MIN_FRAGMENTS
+      && free_map_allocate_near (inode->sector + 1, sector_cnt, &start))
+    {
+      disk_set_io_class (DISK_IO_BE);
+      for (idx = 0; idx < used; idx += DEFRAG_BATCH)
+        copy_sectors (inode, idx,
+                      used - idx < DEFRAG_BATCH ? used - idx : DEFRAG_BATCH,
+                      start + idx, buffer);
+      disk_set_io_class (DISK_IO_IDLE);
+
+      old = inode->data;
+      memset (inode->data.bytes, 0, sizeof inode->data.bytes);
+      inode->data.layout = INODE_EXTENTS;
+      inode->data.ext.cnt = 1;
+      inode->data.ext.extents[0].start = start;
+      inode->data.ext.extents[0].end = sector_cnt;
+      inode_deallocate (&old);
+      journal_log (inode->sector);
+      mark_dirty (inode);
+
+      defrag_file_cnt++;
+      defrag_fragment_cnt += fragments - 1;
+      defrag_sector_cnt += used;
+      success = true;
+    }
+  rw_write_release (&inode->lock);
+  journal_end ();
+  free (buffer);
+  return success;
+}
+
+/* Returns the open or idle inode with the lowest sector number
+   at or after *CURSOR that may be worth defragmenting, opened
+   once more, and advances *CURSOR past it.  Returns a null
+   pointer if there is none. */
+static struct inode *
+next_candidate (disk_sector_t *cursor)
+{
+  struct inode *best = NULL;
+  struct hash_iterator i;
 
-      if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) 
+  lock_acquire (&open_inodes_lock);
+  hash_first (&i, &open_inodes);
+  while (hash_next (&i))
+    {
+      struct inode *inode = hash_entry (hash_cur (&i), struct inode, elem);
+      if (inode->sector >= *cursor && defrag_candidate (inode)
+          && (best == NULL || inode->sector < best->sector))
+        best = inode;
+    }
+  if (best != NULL)
+    {
+      reopen_locked (best);
+      *cursor = best->sector + 1;
+    }
+  lock_release (&open_inodes_lock);
+  return best;
+}
+
+/* Defragments the files in use every defrag_secs seconds. */
+static void
+defrag_daemon (void *aux UNUSED)
+{
+  disk_set_io_class (DISK_IO_IDLE);
+  for (;;)
+    {
+      disk_sector_t cursor = 0;
+      struct inode *inode;
+
+      timer_sleep ((defrag_secs > 0 ? defrag_secs : 1) * TIMER_FREQ);
+      if (defrag_secs == 0)
+        continue;
+      while ((inode = next_candidate (&cursor)) != NULL)
         {
-          /* Write full sector directly to disk. */
-          disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
+          defrag_inode (inode);
+          inode_close (inode);
         }
-      else 
+    }
+}
+
+/* Starts the defragmenter.  The file system must be ready for
+   use. */
+void
+inode_start_defrag (void)
+{
+  thread_create_daemon ("defrag", PRI_MIN, defrag_daemon, NULL);
+}
+
+/* Direct I/O.
+
+   inode_read_direct() and inode_write_direct() move whole sectors
+   between the disk and the caller's buffers without the buffer
+   cache.  Each run of sectors that is consecutive both on disk
+   and in a buffer becomes one disk request, and up to
+   DIRECT_REQ_MAX requests are submitted at once, so the disk
+   serves them in order and merges adjacent ones.  Any cached
+   copy of a transferred sector is dropped first, written back
+   if it is dirty and about to be read from disk. */
+
+/* Most disk requests a direct transfer has in flight. */
+#define DIRECT_REQ_MAX 32
+
+/* Disk requests of a direct transfer. */
+struct direct_batch
+  {
+    struct disk_request reqs[DIRECT_REQ_MAX];
+    size_t cnt;                         /* Number of requests. */
+    bool write;                         /* Writing to disk? */
+    struct semaphore done;              /* Up'd as each one completes. */
+  };
+
+/* Completion function for direct transfers: ups the semaphore
+   passed as AUX. */
+static void
+direct_done (struct disk_request *r UNUSED, void *aux)
+{
+  sema_up (aux);
+}
+
+/* Submits the requests in B and waits for all of them. */
+static void
+direct_submit (struct direct_batch *b)
+{
+  size_t i;
+
+  for (i = 0; i < b->cnt; i++)
+    {
+      cache_invalidate (b->reqs[i].sector, b->reqs[i].cnt, b->write);
+      disk_submit (&b->reqs[i]);
+    }
+  for (i = 0; i < b->cnt; i++)
+    sema_down (&b->done);
+
+  /* A read-ahead may have cached an old copy during a write. */
+  if (b->write)
+    for (i = 0; i < b->cnt; i++)
+      cache_invalidate (b->reqs[i].sector, b->reqs[i].cnt, true);
+  b->cnt = 0;
+}
+
+/* Transfers the SIZE bytes of INODE starting at OFFSET, which
+   must be a multiple of DISK_SECTOR_SIZE, to or from the IOVCNT
+   buffers in IOV, whose lengths must be multiples of
+   DISK_SECTOR_SIZE, depending on WRITE.  A read supplies zeros
+   for holes and for the part of INODE that has never been
+   written; a write fills in holes, and stops if the disk is full.
+   Returns the number of bytes transferred, rounded up to a whole
+   sector.  The caller must hold INODE's lock, for writing if
+   WRITE is true. */
+static off_t
+direct_transfer (struct inode *inode, const struct iovec *iov, int iovcnt,
+                 off_t offset, off_t size, bool write)
+{
+  struct direct_batch *b;
+  uint8_t *tail = NULL;
+  off_t done = 0;
+  int i;
+
+  ASSERT (offset % DISK_SECTOR_SIZE == 0);
+
+  b = malloc (sizeof *b);
+  if (b == NULL)
+    return 0;
+  b->cnt = 0;
+  b->write = write;
+  sema_init (&b->done, 0);
+
+  for (i = 0; i < iovcnt && done < size; i++)
+    {
+      uint8_t *buffer = iov[i].iov_base;
+      size_t left = iov[i].iov_len;
+
+      ASSERT (left % DISK_SECTOR_SIZE == 0);
+      for (; left > 0 && done < size;
+           buffer += DISK_SECTOR_SIZE, left -= DISK_SECTOR_SIZE,
+             done += DISK_SECTOR_SIZE)
         {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
+          off_t pos = offset + done;
+          size_t idx = pos / DISK_SECTOR_SIZE;
+          struct disk_request *last;
+          disk_sector_t sector;
+          bool mapped;
+
+          if (!write && pos >= inode->data.init_length)
+            mapped = false;
+          else if (inode->data.layout == INODE_EXTENTS)
+            mapped = extent_lookup (&inode->data, idx, &sector);
+          else
+            mapped = index_lookup (&inode->data, idx, &sector, write);
+          if (!mapped)
             {
-              bounce = malloc (DISK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
+              if (write)
+                goto done;
+              memset (buffer, 0, DISK_SECTOR_SIZE);
+              continue;
             }
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            disk_read (filesys_disk, sector_idx, bounce);
+          /* Only the written part of the last sector read is
+             valid; the rest is cleared once the read is done. */
+          if (!write && pos + DISK_SECTOR_SIZE > inode->data.init_length)
+            tail = buffer;
+
+          last = b->cnt > 0 ? &b->reqs[b->cnt - 1] : NULL;
+          if (last != NULL && sector == last->sector + last->cnt
+              && buffer == (uint8_t *) last->buffer + last->cnt * DISK_SECTOR_SIZE
+              && last->cnt < DISK_TRANSFER_MAX)
+            last->cnt++;
           else
-            memset (bounce, 0, DISK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          disk_write (filesys_disk, sector_idx, bounce); 
+            {
+              if (b->cnt == DIRECT_REQ_MAX)
+                direct_submit (b);
+              disk_request_init (&b->reqs[b->cnt++], filesys_disk, sector, 1,
+                                 buffer, write, direct_done, &b->done);
+            }
         }
+    }
 
-      /* Advance. */
-      size -= chunk_size;
-      offset += chunk_size;
-      bytes_written += chunk_size;
+ done:
+  direct_submit (b);
+  free (b);
+  if (tail != NULL)
+    {
+      size_t valid = inode->data.init_length % DISK_SECTOR_SIZE;
+      memset (tail + valid, 0, DISK_SECTOR_SIZE - valid);
     }
-  free (bounce);
+  return done;
+}
+
+/* Returns the total length of the IOVCNT buffers in IOV. */
+static off_t
+iov_length (const struct iovec *iov, int iovcnt)
+{
+  off_t size = 0;
+  int i;
+
+  for (i = 0; i < iovcnt; i++)
+    size += iov[i].iov_len;
+  return size;
+}
+
+/* Reads INODE, starting at OFFSET, into the IOVCNT kernel buffers
+   in IOV straight from disk.  OFFSET and the buffers' lengths
+   must be multiples of DISK_SECTOR_SIZE, and no sector's worth
+   of a buffer may cross a page boundary.  Returns the number of
+   bytes read, which may be less than requested if end of file is
+   reached or memory runs out.  The buffers past that point, up
+   to the end of the sector that holds end of file, are
+   clobbered. */
+off_t
+inode_read_direct (struct inode *inode, const struct iovec *iov, int iovcnt,
+                   off_t offset)
+{
+  off_t size = iov_length (iov, iovcnt);
+  off_t bytes_read = 0;
+
+  rw_read_acquire (&inode->lock);
+  if (offset < inode->data.length)
+    {
+      if (size > inode->data.length - offset)
+        size = inode->data.length - offset;
+      if (inode->data.layout == INODE_INLINE)
+        {
+          /* Nothing to read from disk. */
+          int i;
+
+          for (i = 0; i < iovcnt && bytes_read < size; i++)
+            {
+              off_t n = size - bytes_read;
+              if (n > (off_t) iov[i].iov_len)
+                n = iov[i].iov_len;
+              memcpy (iov[i].iov_base, inode->data.bytes + offset + bytes_read,
+                      n);
+              bytes_read += n;
+            }
+        }
+      else
+        bytes_read = direct_transfer (inode, iov, iovcnt, offset, size,
+                                      false);
+      if (bytes_read > size)
+        bytes_read = size;
+    }
+  rw_read_release (&inode->lock);
+  return bytes_read;
+}
+
+/* Writes the IOVCNT kernel buffers in IOV to INODE, starting at
+   OFFSET, straight to disk, growing INODE as needed.  OFFSET and
+   the buffers must be laid out as for inode_read_direct().
+   Returns the number of bytes written, which may be less than
+   requested if the disk is full or memory runs out.  Nothing is
+   written while writes are denied.  INODE must not be
+   journaled. */
+off_t
+inode_write_direct (struct inode *inode, const struct iovec *iov,
+                    int iovcnt, off_t offset)
+{
+  off_t size = iov_length (iov, iovcnt);
+  off_t bytes_written = 0;
+  off_t old_length;
+
+  ASSERT (!inode->journaled);
+  if (inode->deny_write_cnt > 0 || size <= 0)
+    return 0;
+  inode->write_cnt++;
+
+  /* The same steps as a write past the written part of the file
+     in inode_write_at(), with the data going straight to disk,
+     which inline data must first be moved to. */
+  journal_begin ();
+  rw_write_acquire (&inode->lock);
+  if (inode->data.layout == INODE_INLINE)
+    {
+      if (!inline_to_extents (&inode->data, inode->sector, false))
+        {
+          rw_write_release (&inode->lock);
+          journal_end ();
+          return 0;
+        }
+      inline_move_cnt++;
+      journal_log (inode->sector);
+      mark_dirty (inode);
+    }
+  old_length = inode->data.length;
+  if (offset + size > old_length)
+    {
+      if (leaves_hole (inode, offset))
+        inode_convert_to_index (&inode->data);
+      inode_extend (&inode->data, inode->sector, offset + size);
+    }
+  if (offset < inode->data.length)
+    {
+      if (size > inode->data.length - offset)
+        size = inode->data.length - offset;
+      clear_gap (inode, offset);
+      bytes_written = direct_transfer (inode, iov, iovcnt, offset, size,
+                                       true);
+      if (bytes_written > size)
+        bytes_written = size;
+
+      if (bytes_written < size && inode->data.length > old_length)
+        inode->data.length = (offset + bytes_written > old_length
+                              ? offset + bytes_written : old_length);
+      if (offset + bytes_written > inode->data.init_length)
+        inode->data.init_length = offset + bytes_written;
+    }
+  journal_log (inode->sector);
+  mark_dirty (inode);
+  rw_write_release (&inode->lock);
+  journal_end ();
 
   return bytes_written;
 }
 
+/* Disables writes to INODE.
+   May be called at most once per inode opener. */
+void
+inode_deny_write (struct inode *inode) 
+{
+  lock_acquire (&open_inodes_lock);
+  inode->deny_write_cnt++;
+  ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  lock_release (&open_inodes_lock);
+}
+
+/* Re-enables writes to INODE.
+   Must be called once by each inode opener who has called
+   inode_deny_write() on the inode, before closing the inode. */
+void
+inode_allow_write (struct inode *inode) 
+{
+  lock_acquire (&open_inodes_lock);
+  ASSERT (inode->deny_write_cnt > 0);
+  ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  inode->deny_write_cnt--;
+  lock_release (&open_inodes_lock);
+}
+
+/* Marks INODE's data as file system metadata, so that changes to
+   it are journaled along with the inode itself. */
+void
+inode_set_journaled (struct inode *inode)
+{
+  inode->journaled = true;
+}
+
 /* Returns the length, in bytes, of INODE's data. */
 off_t
 inode_length (const struct inode *inode)
@@ -334,3 +1827,58 @@ inode_length (const struct inode *inode)
   return inode->data.length;
 }
 
+/* Returns the directory index that the directory module built
+   for INODE, or a null pointer if none has been built. */
+struct dir_index *
+inode_get_dir_index (struct inode *inode)
+{
+  return inode->dir_index;
+}
+
+/* Sets INODE's directory index to INDEX.  The index is freed
+   with dir_index_destroy() when INODE is closed for the last
+   time. */
+void
+inode_set_dir_index (struct inode *inode, struct dir_index *index)
+{
+  inode->dir_index = index;
+}
+
+/* Returns the number of times INODE has been written since it was
+   opened.  Anything derived from INODE's contents is still valid
+   if this has not changed since. */
+unsigned
+inode_write_cnt (const struct inode *inode)
+{
+  return inode->write_cnt;
+}
+
+/* Returns the plan that the loader cached for INODE, or a null
+   pointer if none has been cached. */
+void *
+inode_get_exec_plan (struct inode *inode)
+{
+  return inode->exec_plan;
+}
+
+/* Sets INODE's cached loader plan to PLAN, which must have been
+   obtained from malloc().  The plan is freed with free() when
+   INODE is closed for the last time. */
+void
+inode_set_exec_plan (struct inode *inode, void *plan)
+{
+  inode->exec_plan = plan;
+}
+
+/* Prints inode statistics. */
+void
+inode_print_stats (void)
+{
+  printf ("Inodes: %lld opens, %lld of idle inodes, %d idle\n",
+          open_call_cnt, idle_hit_cnt, idle_cnt);
+  printf ("Inodes: %lld created inline, %lld moved out of line\n",
+          inline_create_cnt, inline_move_cnt);
+  printf ("Inodes: %lld defragmented, %lld fragments merged, "
+          "%lld sectors moved\n",
+          defrag_file_cnt, defrag_fragment_cnt, defrag_sector_cnt);
+}
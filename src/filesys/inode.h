@@ -6,17 +6,46 @@
 #include "devices/disk.h"
 
 struct bitmap;
+struct inode;
+struct iovec;
+struct dir_index;
 
+/* Page cache hook, see inode_set_page_cache(): copies to BUFFER
+   what it holds in memory of the SIZE bytes of INODE at OFFSET,
+   from OFFSET on, and returns how many bytes it copied. */
+typedef off_t inode_page_read_func (struct inode *, void *buffer,
+                                    off_t size, off_t offset);
 
 void inode_init (void);
-bool inode_create (disk_sector_t, off_t);
+bool inode_create (disk_sector_t, off_t, bool is_dir);
 struct inode *inode_open (disk_sector_t);
 struct inode *inode_reopen (struct inode *);
 disk_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
+void inode_flush (void);
+void inode_start_defrag (void);
 void inode_remove (struct inode *);
+bool inode_is_removed (const struct inode *);
+bool inode_is_dir (const struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+off_t inode_read_through (struct inode *, void *, off_t size, off_t offset);
+void inode_uncache (struct inode *, off_t offset, off_t size);
+void inode_set_page_cache (inode_page_read_func *);
+void inode_read_ahead (struct inode *, off_t offset, off_t size);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_read_direct (struct inode *, const struct iovec *, int iovcnt,
+                         off_t offset);
+off_t inode_write_direct (struct inode *, const struct iovec *, int iovcnt,
+                          off_t offset);
+void inode_deny_write (struct inode *);
+void inode_allow_write (struct inode *);
+void inode_set_journaled (struct inode *);
 off_t inode_length (const struct inode *);
+struct dir_index *inode_get_dir_index (struct inode *);
+void inode_set_dir_index (struct inode *, struct dir_index *);
+unsigned inode_write_cnt (const struct inode *);
+void *inode_get_exec_plan (struct inode *);
+void inode_set_exec_plan (struct inode *, void *);
+void inode_print_stats (void);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,302 @@
+#include "filesys/journal.h"
+#include <crc32.h>
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "filesys/inode.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Redo journal for file system metadata.
+
+   Metadata means inode sectors, index sectors, and the data of
+   directories and of the free map.  An operation that changes
+   metadata runs between journal_begin() and journal_end() and
+   calls journal_log() on each metadata sector it changes.  Those
+   sectors join the running transaction and are "held" in the
+   buffer cache until the transaction commits.  The cache neither
+   evicts nor flushes a held sector, so no change reaches its
+   home location early.
+
+   A commit waits until no operation is in progress.  It writes
+   the free map and every dirty in-memory inode into the cache,
+   so that they join the transaction too.  Then one multi-sector write puts a header
+   and a copy of every logged sector in the journal area.  The
+   header carries a checksum of the copies, so a torn journal
+   write is recognized and ignored.  Once the journal is written,
+   the logged sectors are released, and the cache writes them
+   home whenever it likes.  Before the journal area is reused,
+   the previous transaction's sectors are written home, so the
+   journal never holds the only copy of a committed change when
+   it is overwritten.
+
+   After a crash, journal_recover() copies the sectors of the
+   last committed transaction home again.  That brings the
+   metadata to its state at that commit.
+
+   File data is not journaled.  After a crash, sectors written
+   since the last commit may hold stale data, but inodes, indexes
+   and directory entries always agree with the free map. */
+
+/* Identifies a valid journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Journal header, in sector JOURNAL_SECTOR.  The copies of the
+   logged sectors follow it, in order. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC if valid. */
+    unsigned seq;                       /* Transaction number. */
+    uint32_t cnt;                       /* Number of logged sectors. */
+    unsigned checksum;                  /* Of SECTORS and the copies. */
+    disk_sector_t sectors[JOURNAL_MAX]; /* Home location of each copy. */
+  };
+
+static struct lock journal_lock;        /* Protects the following. */
+static struct condition journal_changed; /* An operation or commit ended. */
+static int active_cnt;                  /* Operations in progress. */
+static bool committing;                 /* A commit is under way. */
+static unsigned seq;                    /* Last transaction number. */
+
+/* Sectors logged by the running transaction, and by the last
+   committed one, which may not all be home yet. */
+static disk_sector_t logged[JOURNAL_MAX];
+static size_t logged_cnt;
+static disk_sector_t committed[JOURNAL_MAX];
+static size_t committed_cnt;
+
+/* Header and copies, as written to the journal area.  Only the
+   committing thread uses it. */
+static uint8_t journal_buf[JOURNAL_SECTORS * DISK_SECTOR_SIZE];
+
+static void commit (void);
+
+/* Returns the checksum of journal header H and the CNT copies
+   that follow it in journal_buf: a CRC of the sector numbers and
+   the copies, seeded with the sequence number. */
+static unsigned
+checksum (const struct journal_header *h, size_t cnt)
+{
+  uint32_t crc = crc32_update (h->seq, h->sectors,
+                               cnt * sizeof *h->sectors);
+  return crc32_update (crc, journal_buf + DISK_SECTOR_SIZE,
+                       cnt * DISK_SECTOR_SIZE);
+}
+
+/* Initializes the journal module. */
+void
+journal_init (void)
+{
+  lock_init_named (&journal_lock, "journal");
+  cond_init (&journal_changed);
+  active_cnt = 0;
+  committing = false;
+  seq = 0;
+  logged_cnt = committed_cnt = 0;
+}
+
+/* Writes an empty journal header, so that a later
+   journal_recover() finds nothing to replay. */
+void
+journal_format (void)
+{
+  memset (journal_buf, 0, DISK_SECTOR_SIZE);
+  disk_write (filesys_disk, JOURNAL_SECTOR, journal_buf);
+}
+
+/* Replays the last committed transaction, if the journal holds
+   one, and empties the journal.  Must be called before any
+   metadata is read into the buffer cache. */
+void
+journal_recover (void)
+{
+  struct journal_header *h = (struct journal_header *) journal_buf;
+  size_t i;
+
+  disk_read (filesys_disk, JOURNAL_SECTOR, h);
+  if (h->magic != JOURNAL_MAGIC || h->cnt > JOURNAL_MAX)
+    return;
+  seq = h->seq;
+  if (h->cnt > 0)
+    disk_read_multiple (filesys_disk, JOURNAL_SECTOR + 1, h->cnt,
+                        journal_buf + DISK_SECTOR_SIZE);
+  if (checksum (h, h->cnt) != h->checksum)
+    {
+      printf ("journal: transaction %u is incomplete, ignoring it\n", seq);
+      return;
+    }
+
+  printf ("journal: replaying transaction %u (%u sectors)\n",
+          seq, (unsigned) h->cnt);
+  for (i = 0; i < h->cnt; i++)
+    disk_write (filesys_disk, h->sectors[i],
+                journal_buf + (i + 1) * DISK_SECTOR_SIZE);
+  journal_format ();
+}
+
+/* Commits the running transaction and writes every cached
+   sector home.  Afterward the journal is empty. */
+void
+journal_done (void)
+{
+  journal_commit ();
+  cache_flush ();
+  journal_format ();
+}
+
+/* Starts a file system operation that may change metadata.
+   Waits while a commit is under way or while the running
+   transaction lacks room for JOURNAL_OP_MAX more sectors per
+   operation, committing it if no operation is in progress.
+   Operations nest: only the outermost journal_begin() and
+   journal_end() of a thread count. */
+void
+journal_begin (void)
+{
+  struct thread *t = thread_current ();
+
+  if (t->journal_depth++ > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  for (;;)
+    {
+      if (!committing
+          && logged_cnt + (active_cnt + 1) * JOURNAL_OP_MAX <= JOURNAL_MAX)
+        break;
+      if (!committing && active_cnt == 0)
+        {
+          committing = true;
+          commit ();
+        }
+      else
+        cond_wait (&journal_changed, &journal_lock);
+    }
+  active_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation started with journal_begin(). */
+void
+journal_end (void)
+{
+  struct thread *t = thread_current ();
+
+  ASSERT (t->journal_depth > 0);
+  if (--t->journal_depth > 0)
+    return;
+
+  lock_acquire (&journal_lock);
+  active_cnt--;
+  cond_broadcast (&journal_changed, &journal_lock);
+  lock_release (&journal_lock);
+}
+
+/* Adds metadata SECTOR to the running transaction.  Must be
+   called within journal_begin() and journal_end(), before SECTOR
+   is changed, except that a sector just allocated, which nothing
+   refers to yet, may be written first and logged afterward.  If
+   the transaction is full, SECTOR is not logged and will be
+   written home like any other sector. */
+void
+journal_log (disk_sector_t sector)
+{
+  size_t i;
+
+  ASSERT (thread_current ()->journal_depth > 0);
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < logged_cnt; i++)
+    if (logged[i] == sector)
+      break;
+  if (i == logged_cnt && logged_cnt < JOURNAL_MAX)
+    {
+      logged[logged_cnt++] = sector;
+      cache_hold (sector);
+    }
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction, waiting for the operations in
+   progress to end first.  Must not be called within an
+   operation. */
+void
+journal_commit (void)
+{
+  ASSERT (thread_current ()->journal_depth == 0);
+
+  lock_acquire (&journal_lock);
+  while (committing)
+    cond_wait (&journal_changed, &journal_lock);
+  committing = true;
+  while (active_cnt > 0)
+    cond_wait (&journal_changed, &journal_lock);
+  commit ();
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction.  JOURNAL_LOCK must be held,
+   COMMITTING must be set, and no operation may be in progress.
+   Releases JOURNAL_LOCK while writing, and clears COMMITTING when
+   done. */
+static void
+commit (void)
+{
+  struct journal_header *h = (struct journal_header *) journal_buf;
+  struct thread *t = thread_current ();
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (committing && active_cnt == 0);
+  lock_release (&journal_lock);
+
+  /* Bring the free map and dirty inodes into the transaction.
+     The free map's writes nest inside this commit rather than
+     waiting for it, and may dirty its inode, so inodes come
+     last. */
+  t->journal_depth++;
+  free_map_flush ();
+  t->journal_depth--;
+  inode_flush ();
+
+  if (logged_cnt > 0)
+    {
+      /* The previous transaction's copies are about to be
+         overwritten, so its sectors must be home first.  Those
+         that the running transaction changed again are held, and
+         are skipped; their new copies replace the old ones. */
+      for (i = 0; i < committed_cnt; i++)
+        cache_write_back (committed[i]);
+
+      /* Write the header and copies in one transfer. */
+      memset (h, 0, DISK_SECTOR_SIZE);
+      h->magic = JOURNAL_MAGIC;
+      h->seq = ++seq;
+      h->cnt = logged_cnt;
+      for (i = 0; i < logged_cnt; i++)
+        {
+          h->sectors[i] = logged[i];
+          cache_read (logged[i], journal_buf + (i + 1) * DISK_SECTOR_SIZE);
+        }
+      h->checksum = checksum (h, logged_cnt);
+      disk_write_multiple (filesys_disk, JOURNAL_SECTOR, logged_cnt + 1,
+                           journal_buf);
+
+      /* The transaction is durable; let its sectors go home. */
+      for (i = 0; i < logged_cnt; i++)
+        {
+          cache_unhold (logged[i]);
+          committed[i] = logged[i];
+        }
+      committed_cnt = logged_cnt;
+      logged_cnt = 0;
+    }
+
+  lock_acquire (&journal_lock);
+  committing = false;
+  cond_broadcast (&journal_changed, &journal_lock);
+}
@@ -0,0 +1,27 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include "devices/disk.h"
+
+/* Maximum number of metadata sectors in one transaction, and
+   number of sectors reserved for the journal, starting at
+   JOURNAL_SECTOR: a header followed by the logged sectors. */
+#define JOURNAL_MAX 32
+#define JOURNAL_SECTORS (JOURNAL_MAX + 1)
+
+/* Number of sectors one file system operation may expect to
+   log.  An operation that logs more may have some of its sectors
+   written without the journal's protection. */
+#define JOURNAL_OP_MAX 8
+
+void journal_init (void);
+void journal_format (void);
+void journal_recover (void);
+void journal_done (void);
+
+void journal_begin (void);
+void journal_end (void);
+void journal_log (disk_sector_t);
+void journal_commit (void);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,209 @@
+#include "filesys/pipe.h"
+#include <debug.h>
+#include <poll.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pollwait.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A pipe: a one-page ring buffer between a read end and a write
+   end.  Each byte is copied once going in, straight from the
+   writer's buffer, and once going out, straight into the
+   reader's. */
+struct pipe
+  {
+    struct lock lock;           /* Protects all the members. */
+    struct condition not_empty; /* Signaled when data arrives. */
+    struct condition not_full;  /* Signaled when space frees up. */
+    uint8_t *buf;               /* PGSIZE bytes of data. */
+    size_t head;                /* Offset in BUF of the first byte. */
+    size_t used;                /* Bytes in BUF. */
+    int readers;                /* Open read ends. */
+    int writers;                /* Open write ends. */
+  };
+
+/* Creates and returns a new, empty pipe with one read end and one
+   write end open.  Returns a null pointer if memory allocation
+   fails. */
+struct pipe *
+pipe_create (void)
+{
+  struct pipe *p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->buf = palloc_get_page (0);
+  if (p->buf == NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  lock_init (&p->lock);
+  cond_init (&p->not_empty);
+  cond_init (&p->not_full);
+  p->head = 0;
+  p->used = 0;
+  p->readers = 1;
+  p->writers = 1;
+  return p;
+}
+
+/* Closes one end of pipe P, the write end if WRITER is true,
+   otherwise the read end.  Waiting readers see end of file once
+   the last write end is closed; waiting writers give up once the
+   last read end is closed.  Frees P when both ends are closed. */
+void
+pipe_close (struct pipe *p, bool writer)
+{
+  bool unused;
+
+  lock_acquire (&p->lock);
+  if (writer)
+    {
+      ASSERT (p->writers > 0);
+      if (--p->writers == 0)
+        cond_broadcast (&p->not_empty, &p->lock);
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      if (--p->readers == 0)
+        cond_broadcast (&p->not_full, &p->lock);
+    }
+  unused = p->readers == 0 && p->writers == 0;
+  lock_release (&p->lock);
+  poll_notify ();
+
+  if (unused)
+    {
+      palloc_free_page (p->buf);
+      free (p);
+    }
+}
+
+/* Opens another end of pipe P, a write end if WRITER is true,
+   otherwise a read end.  Each end so opened must be closed with
+   pipe_close() like the first two. */
+void
+pipe_reopen (struct pipe *p, bool writer)
+{
+  lock_acquire (&p->lock);
+  if (writer)
+    {
+      ASSERT (p->writers > 0);
+      p->writers++;
+    }
+  else
+    {
+      ASSERT (p->readers > 0);
+      p->readers++;
+    }
+  lock_release (&p->lock);
+}
+
+/* Reads up to SIZE bytes from pipe P into BUFFER, waiting until at
+   least one byte is available.  Returns the number of bytes read,
+   which is 0 only at end of file, that is, once the pipe is empty
+   and has no write end open. */
+off_t
+pipe_read (struct pipe *p, void *buffer_, off_t size)
+{
+  uint8_t *buffer = buffer_;
+  off_t bytes_read = 0;
+
+  if (size <= 0)
+    return 0;
+
+  lock_acquire (&p->lock);
+  while (p->used == 0 && p->writers > 0)
+    cond_wait (&p->not_empty, &p->lock);
+  while (size > 0 && p->used > 0)
+    {
+      /* Up to the end of the data or the end of the buffer. */
+      size_t chunk = p->used;
+      if (chunk > PGSIZE - p->head)
+        chunk = PGSIZE - p->head;
+      if (chunk > (size_t) size)
+        chunk = size;
+
+      memcpy (buffer + bytes_read, p->buf + p->head, chunk);
+      p->head = (p->head + chunk) % PGSIZE;
+      p->used -= chunk;
+      size -= chunk;
+      bytes_read += chunk;
+    }
+  if (bytes_read > 0)
+    cond_broadcast (&p->not_full, &p->lock);
+  lock_release (&p->lock);
+  if (bytes_read > 0)
+    poll_notify ();
+
+  return bytes_read;
+}
+
+/* Writes SIZE bytes from BUFFER into pipe P, waiting for the
+   reader whenever the pipe is full.  Returns the number of bytes
+   written, which is less than SIZE only if the last read end is
+   closed, or -1 if it was closed before any byte was written. */
+off_t
+pipe_write (struct pipe *p, const void *buffer_, off_t size)
+{
+  const uint8_t *buffer = buffer_;
+  off_t bytes_written = 0;
+
+  lock_acquire (&p->lock);
+  while (size > 0)
+    {
+      size_t tail, chunk;
+
+      while (p->used == PGSIZE && p->readers > 0)
+        cond_wait (&p->not_full, &p->lock);
+      if (p->readers == 0)
+        break;
+
+      /* Up to the end of the free space or the end of the buffer. */
+      tail = (p->head + p->used) % PGSIZE;
+      chunk = PGSIZE - p->used;
+      if (chunk > PGSIZE - tail)
+        chunk = PGSIZE - tail;
+      if (chunk > (size_t) size)
+        chunk = size;
+
+      memcpy (p->buf + tail, buffer + bytes_written, chunk);
+      p->used += chunk;
+      size -= chunk;
+      bytes_written += chunk;
+      cond_broadcast (&p->not_empty, &p->lock);
+      poll_notify ();
+    }
+  lock_release (&p->lock);
+
+  return bytes_written > 0 || size == 0 ? bytes_written : -1;
+}
+
+/* Returns the poll() events that are ready on the write end of
+   pipe P if WRITER is true, otherwise on its read end. */
+int
+pipe_poll (struct pipe *p, bool writer)
+{
+  int events = 0;
+
+  lock_acquire (&p->lock);
+  if (writer)
+    {
+      if (p->readers == 0)
+        events = POLLOUT | POLLHUP;
+      else if (p->used < PGSIZE)
+        events = POLLOUT;
+    }
+  else
+    {
+      if (p->used > 0)
+        events = POLLIN;
+      if (p->writers == 0)
+        events = POLLIN | POLLHUP;
+    }
+  lock_release (&p->lock);
+  return events;
+}
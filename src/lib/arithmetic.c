@@ -1,3 +1,4 @@
+#include <div64.h>
 #include <stdint.h>
 
 /* On x86, division of one 64-bit integer by another cannot be
@@ -25,15 +26,9 @@
 static inline uint32_t
 divl (uint64_t n, uint32_t d)
 {
-  uint32_t n1 = n >> 32;
-  uint32_t n0 = n;
-  uint32_t q, r;
+  uint32_t r;
 
-  asm ("divl %4"
-       : "=d" (r), "=a" (q)
-       : "0" (n1), "1" (n0), "rm" (d));
-
-  return q;
+  return divl_rem (n >> 32, n, d, &r);
 }
 
 /* Returns the number of leading zero bits in X,
@@ -41,43 +36,28 @@ divl (uint64_t n, uint32_t d)
 static int
 nlz (uint32_t x) 
 {
-  /* This technique is portable, but there are better ways to do
-     it on particular systems.  With sufficiently new enough GCC,
-     you can use __builtin_clz() to take advantage of GCC's
-     knowledge of how to do it.  Or you can use the x86 BSR
-     instruction directly. */
-  int n = 0;
-  if (x <= 0x0000FFFF)
-    {
-      n += 16;
-      x <<= 16; 
-    }
-  if (x <= 0x00FFFFFF)
-    {
-      n += 8;
-      x <<= 8; 
-    }
-  if (x <= 0x0FFFFFFF)
-    {
-      n += 4;
-      x <<= 4;
-    }
-  if (x <= 0x3FFFFFFF)
-    {
-      n += 2;
-      x <<= 2; 
-    }
-  if (x <= 0x7FFFFFFF)
-    n++;
-  return n;
+  /* GCC turns this into the x86 BSR instruction. */
+  return __builtin_clz (x);
 }
 
-/* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
-   quotient. */
+/* Divides unsigned 64-bit N by unsigned 64-bit D.  Returns the
+   quotient and stores the remainder in *R.
+
+   Most divisors in Pintos, such as TIMER_FREQ and the TSC rate,
+   fit in 32 bits, and many dividends do too, so those cases
+   take as few DIVL instructions as possible. */
 static uint64_t
-udiv64 (uint64_t n, uint64_t d)
+udivmod64 (uint64_t n, uint64_t d, uint64_t *r)
 {
-  if ((d >> 32) == 0) 
+  if ((d >> 32) == 0 && (n >> 32) == 0)
+    {
+      /* Plain 32-bit division. */
+      uint32_t n0 = n, d0 = d;
+
+      *r = n0 % d0;
+      return n0 / d0;
+    }
+  else if ((d >> 32) == 0) 
     {
       /* Proof of correctness:
 
@@ -103,35 +83,63 @@ udiv64 (uint64_t n, uint64_t d)
          which is a tautology.
 
          Therefore, this code is correct and will not trap. */
-      uint64_t b = 1ULL << 32;
       uint32_t n1 = n >> 32;
       uint32_t n0 = n; 
       uint32_t d0 = d;
+      uint32_t q1 = 0, r0;
+      uint32_t q0;
 
-      return divl (b * (n1 % d0) + n0, d0) + b * (n1 / d0); 
+      /* The first step vanishes if N1 < D0, as it often is. */
+      if (n1 >= d0)
+        {
+          q1 = n1 / d0;
+          n1 %= d0;
+        }
+      q0 = divl_rem (n1, n0, d0, &r0);
+      *r = r0;
+      return ((uint64_t) q1 << 32) | q0;
     }
   else 
     {
       /* Based on the algorithm and proof available from
          http://www.hackersdelight.org/revisions.pdf. */
       if (n < d)
-        return 0;
+        {
+          *r = n;
+          return 0;
+        }
       else 
         {
           uint32_t d1 = d >> 32;
           int s = nlz (d1);
           uint64_t q = divl (n >> 1, (d << s) >> 32) >> (31 - s);
-          return n - (q - 1) * d < d ? q - 1 : q; 
+          if (n - (q - 1) * d < d)
+            q--;
+          *r = n - q * d;
+          return q;
         }
     }
 }
 
+/* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
+   quotient. */
+static uint64_t
+udiv64 (uint64_t n, uint64_t d)
+{
+  uint64_t r;
+
+  return udivmod64 (n, d, &r);
+}
+
 /* Divides unsigned 64-bit N by unsigned 64-bit D and returns the
    remainder. */
-static uint32_t
+static uint64_t
 umod64 (uint64_t n, uint64_t d)
 {
-  return n - d * udiv64 (n, d);
+  uint64_t r;
+
+  udivmod64 (n, d, &r);
+  return r;
 }
 
 /* Divides signed 64-bit N by signed 64-bit D and returns the
@@ -147,10 +155,13 @@ sdiv64 (int64_t n, int64_t d)
 
 /* Divides signed 64-bit N by signed 64-bit D and returns the
    remainder. */
-static int32_t
+static int64_t
 smod64 (int64_t n, int64_t d)
 {
-  return n - d * sdiv64 (n, d);
+  uint64_t n_abs = n >= 0 ? (uint64_t) n : -(uint64_t) n;
+  uint64_t d_abs = d >= 0 ? (uint64_t) d : -(uint64_t) d;
+  uint64_t r_abs = umod64 (n_abs, d_abs);
+  return n >= 0 ? (int64_t) r_abs : -(int64_t) r_abs;
 }
 
 /* These are the routines that GCC calls. */
@@ -159,6 +170,8 @@ long long __divdi3 (long long n, long long d);
 long long __moddi3 (long long n, long long d);
 unsigned long long __udivdi3 (unsigned long long n, unsigned long long d);
 unsigned long long __umoddi3 (unsigned long long n, unsigned long long d);
+unsigned long long __udivmoddi4 (unsigned long long n, unsigned long long d,
+                                 unsigned long long *r);
 
 /* Signed 64-bit division. */
 long long
@@ -187,3 +200,17 @@ __umoddi3 (unsigned long long n, unsigned long long d)
 {
   return umod64 (n, d);
 }
+
+/* Unsigned 64-bit division and remainder together, which newer
+   GCC calls when code needs both. */
+unsigned long long
+__udivmoddi4 (unsigned long long n, unsigned long long d,
+              unsigned long long *r) 
+{
+  uint64_t rem;
+  uint64_t q = udivmod64 (n, d, &rem);
+
+  if (r != NULL)
+    *r = rem;
+  return q;
+}
@@ -0,0 +1,86 @@
+#include "crc32.h"
+#include <stdbool.h>
+
+/* CRC-32 with the polynomial 0x04c11db7, most significant bit
+   first, as used by the Posix `cksum' utility.  The CRC carries
+   no initial value or final inversion of its own; callers that
+   want them apply them.
+
+   The usual table-driven CRC folds one byte into the CRC per
+   table lookup.  "Slicing-by-8" instead keeps eight tables, the
+   Kth of which gives the effect of byte value I followed by K
+   zero bytes, so that eight bytes can be folded in at once with
+   eight independent lookups, XORed together.  See Kounavis and
+   Berry, "A Systematic Approach to Building High Performance
+   Software-based CRC Generators", 2005.
+
+   The tables take 8 kB, too much to write out here, so they are
+   computed on first use. */
+
+#define POLYNOMIAL 0x04c11db7
+
+/* TABLES[K][I] is the CRC of byte I followed by K zero bytes. */
+static uint32_t tables[8][256];
+
+/* Tables computed yet? */
+static bool inited;
+
+/* Computes TABLES. */
+static void
+init_tables (void)
+{
+  int i, k;
+
+  for (i = 0; i < 256; i++)
+    {
+      uint32_t c = (uint32_t) i << 24;
+      int bit;
+
+      for (bit = 0; bit < 8; bit++)
+        c = c & 0x80000000 ? (c << 1) ^ POLYNOMIAL : c << 1;
+      tables[0][i] = c;
+    }
+  for (k = 1; k < 8; k++)
+    for (i = 0; i < 256; i++)
+      {
+        uint32_t c = tables[k - 1][i];
+        tables[k][i] = (c << 8) ^ tables[0][c >> 24];
+      }
+
+  /* Keep the compiler from setting INITED before the tables are
+     written, in case a thread is preempted halfway through. */
+  asm volatile ("" : : : "memory");
+  inited = true;
+}
+
+/* Returns big-endian 32-bit word P. */
+static inline uint32_t
+get_be32 (const uint8_t *p)
+{
+  return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16)
+          | ((uint32_t) p[2] << 8) | p[3];
+}
+
+/* Folds the SIZE bytes at BUF into CRC and returns the result. */
+uint32_t
+crc32_update (uint32_t crc, const void *buf_, size_t size)
+{
+  const uint8_t *buf = buf_;
+
+  if (!inited)
+    init_tables ();
+
+  for (; size >= 8; buf += 8, size -= 8)
+    {
+      uint32_t hi = crc ^ get_be32 (buf);
+      uint32_t lo = get_be32 (buf + 4);
+
+      crc = (tables[7][hi >> 24] ^ tables[6][(hi >> 16) & 0xff]
+             ^ tables[5][(hi >> 8) & 0xff] ^ tables[4][hi & 0xff]
+             ^ tables[3][lo >> 24] ^ tables[2][(lo >> 16) & 0xff]
+             ^ tables[1][(lo >> 8) & 0xff] ^ tables[0][lo & 0xff]);
+    }
+  for (; size > 0; buf++, size--)
+    crc = (crc << 8) ^ tables[0][(crc >> 24) ^ *buf];
+  return crc;
+}
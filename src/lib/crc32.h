@@ -0,0 +1,9 @@
+#ifndef __LIB_CRC32_H
+#define __LIB_CRC32_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+uint32_t crc32_update (uint32_t crc, const void *, size_t);
+
+#endif /* lib/crc32.h */
@@ -1,10 +1,57 @@
 #ifndef __LIB_DEBUG_H
 #define __LIB_DEBUG_H
 
+#include <stdbool.h>
+
+/* Kernel log messages, printed with a "# " prefix that the test
+   checkers ignore.  Each message belongs to a subsystem and has a
+   level, and is printed only if its subsystem's runtime level,
+   set with the kernel's -log option, is at least that high.
+   Messages above LOG_LEVEL_MAX, which a build may define with
+   -DLOG_LEVEL_MAX=..., are compiled out, arguments and all.  The
+   first argument after the level must be a literal string. */
+enum log_subsys
+  {
+    LOG_MISC,                   /* Anything else. */
+    LOG_THREAD,                 /* threads/thread.c. */
+    LOG_PROCESS,                /* userprog/process.c. */
+    LOG_SYSCALL,                /* userprog/syscall.c. */
+    LOG_PLIST,                  /* userprog/plist.c. */
+    LOG_FLIST,                  /* userprog/flist.c. */
+    LOG_SUBSYS_CNT
+  };
+
+enum log_level
+  {
+    LOG_OFF,                    /* Nothing. */
+    LOG_ERROR,                  /* Failures worth knowing about. */
+    LOG_INFO,                   /* Occasional progress. */
+    LOG_DEBUG                   /* Every step, for debugging. */
+  };
+
+#ifndef LOG_LEVEL_MAX
+#define LOG_LEVEL_MAX LOG_DEBUG
+#endif
+
+/* Runtime level of each subsystem, kernel only. */
+extern unsigned char log_levels[LOG_SUBSYS_CNT];
+
+/* True if messages of LEVEL in SUBSYS are printed: a constant
+   false above LOG_LEVEL_MAX, otherwise one byte compare. */
+#define log_enabled(SUBSYS, LEVEL)                                      \
+        ((LEVEL) <= LOG_LEVEL_MAX && log_levels[SUBSYS] >= (LEVEL))
+
+#define log_printf(SUBSYS, LEVEL, fmt, ...)                             \
+        do {                                                            \
+          if (log_enabled (SUBSYS, LEVEL))                              \
+            printf ("# " fmt, ##__VA_ARGS__);                           \
+        } while (0)
+
 /* klaar@ida 2011-01-12: A macro to allow debug printouts without
  * interfering with the test programs. The first argument must be a
- * literal string (in double-quotes). */
-#define debug(fmt, ...) printf("# " fmt, ##__VA_ARGS__)
+ * literal string (in double-quotes).  It logs at LOG_DEBUG as the
+ * subsystem DEBUG_SUBSYS, which a source file using it defines. */
+#define debug(fmt, ...) log_printf (DEBUG_SUBSYS, LOG_DEBUG, fmt, ##__VA_ARGS__)
 
 /* GCC lets us add "attributes" to functions, function
    parameters, etc. to indicate their properties.
@@ -21,6 +68,7 @@
 void debug_panic (const char *file, int line, const char *function,
                   const char *message, ...) PRINTF_FORMAT (4, 5) NO_RETURN;
 void debug_backtrace (void);
+bool log_configure (const char *);
 
 /* klaar@ida Parts from 100 to 210 exists (only in reference solution) */
 #define PART 210
@@ -0,0 +1,19 @@
+#ifndef __LIB_DISK_STATS_H
+#define __LIB_DISK_STATS_H
+
+/* Counters of the file system disk and buffer cache since boot,
+   as returned by disk_stats().  Subtract two snapshots to
+   measure a piece of work. */
+struct disk_stats
+  {
+    long long read_cnt;         /* Sectors read from the disk. */
+    long long write_cnt;        /* Sectors written to the disk. */
+    long long cmd_cnt;          /* Commands issued on its channel. */
+    long long busy_ticks;       /* Timer ticks its channel was busy. */
+    long long hit_cnt;          /* Cache lookups that hit. */
+    long long miss_cnt;         /* Cache lookups that missed. */
+    long long evict_cnt;        /* Cached sectors replaced. */
+    long long prefetch_cnt;     /* Sectors loaded by read-ahead. */
+  };
+
+#endif /* lib/disk-stats.h */
@@ -0,0 +1,73 @@
+#ifndef __LIB_DIV64_H
+#define __LIB_DIV64_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* 64-bit division by a 32-bit divisor.
+
+   On 80x86, GCC turns any division of a 64-bit value into a
+   call to __udivdi3() or __divdi3() in lib/arithmetic.c, even
+   when the divisor is a small constant.  These helpers instead
+   use the DIVL instruction directly: once if the quotient fits
+   in 32 bits, otherwise twice. */
+
+/* Uses x86 DIVL to divide the 64-bit value HI:LO by D, which
+   must be greater than HI, so that the quotient fits in 32 bits.
+   Returns the quotient and stores the remainder in *REM. */
+static inline uint32_t
+divl_rem (uint32_t hi, uint32_t lo, uint32_t d, uint32_t *rem)
+{
+  uint32_t q;
+
+  asm ("divl %4"
+       : "=d" (*rem), "=a" (q)
+       : "0" (hi), "1" (lo), "rm" (d));
+  return q;
+}
+
+/* Divides N by nonzero D.  Returns the quotient and, if REM is
+   nonnull, stores the remainder in *REM. */
+static inline uint64_t
+div64_32 (uint64_t n, uint32_t d, uint32_t *rem)
+{
+  uint32_t hi = n >> 32;
+  uint32_t q_hi = 0, q_lo, r;
+
+  if (hi >= d)
+    {
+      q_hi = hi / d;
+      hi %= d;
+    }
+  q_lo = divl_rem (hi, n, d, &r);
+  if (rem != NULL)
+    *rem = r;
+  return ((uint64_t) q_hi << 32) | q_lo;
+}
+
+/* Returns N modulo nonzero D. */
+static inline uint32_t
+mod64_32 (uint64_t n, uint32_t d)
+{
+  uint32_t r;
+
+  div64_32 (n, d, &r);
+  return r;
+}
+
+/* Returns X times Y, where Y is in 32.32 fixed point, rounded
+   down, using four 32-bit multiplies.  The result must fit in 64
+   bits.  With Y precomputed as (M << 32) / D, this computes
+   X * M / D for a divisor D that rarely changes. */
+static inline uint64_t
+mul64_fix32 (uint64_t x, uint64_t y)
+{
+  uint32_t x0 = x, x1 = x >> 32;
+  uint32_t y0 = y, y1 = y >> 32;
+
+  return (((uint64_t) x1 * y1 << 32)
+          + (uint64_t) x1 * y0 + (uint64_t) x0 * y1
+          + ((uint64_t) x0 * y0 >> 32));
+}
+
+#endif /* lib/div64.h */
@@ -0,0 +1,13 @@
+#ifndef __LIB_FCNTL_H
+#define __LIB_FCNTL_H
+
+/* Flags for open_flags(). */
+#define O_DIRECT 0x01           /* Bypass the buffer cache for reads
+                                   and writes whose buffer, size and
+                                   file position are multiples of
+                                   O_DIRECT_ALIGN. */
+
+/* Alignment of direct transfers: the disk sector size. */
+#define O_DIRECT_ALIGN 512
+
+#endif /* lib/fcntl.h */
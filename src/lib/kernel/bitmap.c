@@ -69,6 +69,87 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Returns a mask of the bits in element IDX that represent bits
+   of the bitmap in the range [START, END), where START < END and
+   IDX is the index of an element holding some of them. */
+static inline elem_type
+range_mask (size_t idx, size_t start, size_t end)
+{
+  elem_type mask = (elem_type) -1;
+
+  if (idx == elem_idx (start))
+    mask &= ~(bit_mask (start) - 1);
+  if (idx == elem_idx (end - 1))
+    mask &= (bit_mask (end - 1) << 1) - 1;
+  return mask;
+}
+
+/* Returns the number of bits set to 1 in X.  GCC's
+   __builtin_popcountl() would call into libgcc on 80x86, which
+   the kernel does not have, so this adds up the bits in
+   parallel: in pairs, then nibbles, then bytes, and finally sums
+   the bytes with one multiply. */
+static inline int
+popcount (elem_type x)
+{
+  const elem_type ones = (elem_type) -1;
+
+  x -= (x >> 1) & (ones / 3);
+  x = (x & (ones / 15 * 3)) + ((x >> 2) & (ones / 15 * 3));
+  x = (x + (x >> 4)) & (ones / 255 * 15);
+  return (elem_type) (x * (ones / 255)) >> (sizeof x - 1) * CHAR_BIT;
+}
+
+/* Atomically sets the bits in MASK in element IDX of B to true. */
+static inline void
+mark_bits (struct bitmap *b, size_t idx, elem_type mask)
+{
+  /* This is equivalent to `b->bits[idx] |= mask' except that it
+     is guaranteed to be atomic on a uniprocessor machine.  See
+     the description of the OR instruction in [IA32-v2b]. */
+  asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+}
+
+/* Atomically sets the bits in MASK in element IDX of B to
+   false. */
+static inline void
+reset_bits (struct bitmap *b, size_t idx, elem_type mask)
+{
+  /* This is equivalent to `b->bits[idx] &= ~mask' except that it
+     is guaranteed to be atomic on a uniprocessor machine.  See
+     the description of the AND instruction in [IA32-v2a]. */
+  asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+}
+
+/* Returns the index of the first bit in B at or after START that
+   is set to VALUE, or B's bit count if there is none.  Examines a
+   whole element at a time. */
+static size_t
+next_bit (const struct bitmap *b, size_t start, bool value)
+{
+  elem_type invert = value ? 0 : (elem_type) -1;
+  size_t idx = elem_idx (start);
+  size_t cnt = elem_cnt (b->bit_cnt);
+  elem_type bits;
+
+  if (start >= b->bit_cnt)
+    return b->bit_cnt;
+
+  /* Ignore the bits before START in the first element. */
+  bits = (b->bits[idx] ^ invert) & ~(bit_mask (start) - 1);
+  while (bits == 0)
+    {
+      if (++idx >= cnt)
+        return b->bit_cnt;
+      bits = b->bits[idx] ^ invert;
+    }
+
+  /* The unused bits in the last element may hold anything, so
+     clamp the result to the bitmap's size. */
+  start = idx * ELEM_BITS + __builtin_ctzl (bits);
+  return start < b->bit_cnt ? start : b->bit_cnt;
+}
+
 /* Creation and destruction. */
 
 /* Initializes B to be a bitmap of BIT_CNT bits
@@ -157,26 +238,14 @@ bitmap_set (struct bitmap *b, size_t idx, bool value)
 void
 bitmap_mark (struct bitmap *b, size_t bit_idx) 
 {
-  size_t idx = elem_idx (bit_idx);
-  elem_type mask = bit_mask (bit_idx);
-
-  /* This is equivalent to `b->bits[idx] |= mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the OR instruction in [IA32-v2b]. */
-  asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  mark_bits (b, elem_idx (bit_idx), bit_mask (bit_idx));
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
 void
 bitmap_reset (struct bitmap *b, size_t bit_idx) 
 {
-  size_t idx = elem_idx (bit_idx);
-  elem_type mask = bit_mask (bit_idx);
-
-  /* This is equivalent to `b->bits[idx] &= ~mask' except that it
-     is guaranteed to be atomic on a uniprocessor machine.  See
-     the description of the AND instruction in [IA32-v2a]. */
-  asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  reset_bits (b, elem_idx (bit_idx), bit_mask (bit_idx));
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -214,18 +283,29 @@ bitmap_set_all (struct bitmap *b, bool value)
   bitmap_set_multiple (b, 0, bitmap_size (b), value);
 }
 
-/* Sets the CNT bits starting at START in B to VALUE. */
+/* Sets the CNT bits starting at START in B to VALUE, a whole
+   element at a time.  Each element is updated atomically, but
+   the group as a whole is not. */
 void
 bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
+  size_t end = start + cnt;
+  size_t idx;
   
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    bitmap_set (b, start + i, value);
+  if (cnt == 0)
+    return;
+  for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+    {
+      elem_type mask = range_mask (idx, start, end);
+      if (value)
+        mark_bits (b, idx, mask);
+      else
+        reset_bits (b, idx, mask);
+    }
 }
 
 /* Returns the number of bits in B between START and START + CNT,
@@ -233,16 +313,19 @@ bitmap_set_multiple (struct bitmap *b, size_t start, size_t cnt, bool value)
 size_t
 bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i, value_cnt;
+  elem_type invert = value ? 0 : (elem_type) -1;
+  size_t end = start + cnt;
+  size_t idx, value_cnt;
 
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
   value_cnt = 0;
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      value_cnt++;
+  if (cnt > 0)
+    for (idx = elem_idx (start); idx <= elem_idx (end - 1); idx++)
+      value_cnt += popcount ((b->bits[idx] ^ invert)
+                             & range_mask (idx, start, end));
   return value_cnt;
 }
 
@@ -251,16 +334,11 @@ bitmap_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
 bool
 bitmap_contains (const struct bitmap *b, size_t start, size_t cnt, bool value) 
 {
-  size_t i;
-  
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
   ASSERT (start + cnt <= b->bit_cnt);
 
-  for (i = 0; i < cnt; i++)
-    if (bitmap_test (b, start + i) == value)
-      return true;
-  return false;
+  return cnt > 0 && next_bit (b, start, value) < start + cnt;
 }
 
 /* Returns true if any bits in B between START and START + CNT,
@@ -299,13 +377,27 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
+  if (cnt == 0)
+    return start;
   if (cnt <= b->bit_cnt) 
     {
       size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      size_t i = start;
+
+      /* Jump from the start of each run of VALUE bits to its end,
+         until a run is long enough. */
+      for (;;)
+        {
+          size_t end;
+
+          i = next_bit (b, i, value);
+          if (i > last)
+            break;
+          end = next_bit (b, i, !value);
+          if (end - i >= cnt)
+            return i;
+          i = end;
+        }
     }
   return BITMAP_ERROR;
 }
@@ -359,6 +451,25 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the SIZE bytes starting at byte offset OFS of B's file
+   representation to the same offset in FILE, so that only the
+   part of the file that changed needs to be rewritten.  The
+   range is clipped to bitmap_file_size(B).  Returns true if
+   successful, false otherwise. */
+bool
+bitmap_write_range (const struct bitmap *b, struct file *file,
+                    size_t ofs, size_t size)
+{
+  size_t file_size = byte_cnt (b->bit_cnt);
+
+  if (ofs >= file_size)
+    return true;
+  if (size > file_size - ofs)
+    size = file_size - ofs;
+  return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs)
+         == (off_t) size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
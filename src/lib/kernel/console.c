@@ -1,14 +1,17 @@
 #include <console.h>
 #include <stdarg.h>
+#include <stats.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/serial.h"
 #include "devices/vga.h"
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
-static void vprintf_helper (char, void *);
+static void vprintf_helper (struct printf_buffer *);
 static void putchar_have_lock (uint8_t c);
+static void putbuf_have_lock (const char *, size_t);
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -59,11 +62,22 @@ static int console_lock_depth;
 /* Number of characters written to console. */
 static int64_t write_cnt;
 
+/* Output of one vprintf() call, staged on the caller's stack so
+   that formatting happens without the console lock.  The lock is
+   taken only to write the finished text, or, if it does not fit,
+   from the first overflow to the end of the call, so printf()
+   output from different threads still never interleaves. */
+struct vprintf_aux
+  {
+    char buf[128];              /* Staged characters. */
+    bool locked;                /* Console lock already held? */
+  };
+
 /* Enable console locking. */
 void
 console_init (void) 
 {
-  lock_init (&console_lock);
+  lock_init_named (&console_lock, "console");
   use_console_lock = true;
 }
 
@@ -83,6 +97,13 @@ console_print_stats (void)
   printf ("Console: %lld characters output\n", write_cnt);
 }
 
+/* Fills in the console fields of *S. */
+void
+console_get_stats (struct stats *s) 
+{
+  s->console_cnt = write_cnt;
+}
+
 /* Acquires the console lock. */
 static void
 acquire_console (void) 
@@ -109,6 +130,22 @@ release_console (void)
     }
 }
 
+/* Keeps the console to the current thread until the matching
+   console_release(), so that the output of several calls comes
+   out together.  Calls may nest. */
+void
+console_acquire (void)
+{
+  acquire_console ();
+}
+
+/* Undoes console_acquire(). */
+void
+console_release (void)
+{
+  release_console ();
+}
+
 /* Returns true if the current thread has the console lock,
    false otherwise. */
 static bool
@@ -125,13 +162,24 @@ console_locked_by_current_thread (void)
 int
 vprintf (const char *format, va_list args) 
 {
-  int char_cnt = 0;
+  struct vprintf_aux aux;
+  struct printf_buffer pb;
 
-  acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
+  aux.locked = false;
+  pb.buf = aux.buf;
+  pb.size = sizeof aux.buf;
+  pb.len = 0;
+  pb.char_cnt = 0;
+  pb.flush = vprintf_helper;
+  pb.aux = &aux;
+  __vprintf_buffer (format, args, &pb);
+
+  if (!aux.locked)
+    acquire_console ();
+  putbuf_have_lock (pb.buf, pb.len);
   release_console ();
 
-  return char_cnt;
+  return pb.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -140,8 +188,7 @@ int
 puts (const char *s) 
 {
   acquire_console ();
-  while (*s != '\0')
-    putchar_have_lock (*s++);
+  putbuf_have_lock (s, strlen (s));
   putchar_have_lock ('\n');
   release_console ();
 
@@ -153,8 +200,7 @@ void
 putbuf (const char *buffer, size_t n) 
 {
   acquire_console ();
-  while (n-- > 0)
-    putchar_have_lock (*buffer++);
+  putbuf_have_lock (buffer, n);
   release_console ();
 }
 
@@ -169,13 +215,20 @@ putchar (int c)
   return c;
 }
 
-/* Helper function for vprintf(). */
+/* Helper function for vprintf(): writes out the full buffer
+   PB, taking the console lock for the rest of the call. */
 static void
-vprintf_helper (char c, void *char_cnt_) 
+vprintf_helper (struct printf_buffer *pb) 
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  struct vprintf_aux *aux = pb->aux;
+
+  if (!aux->locked)
+    {
+      acquire_console ();
+      aux->locked = true;
+    }
+  putbuf_have_lock (pb->buf, pb->len);
+  pb->len = 0;
 }
 
 /* Writes C to the vga display and serial port.
@@ -189,3 +242,15 @@ putchar_have_lock (uint8_t c)
   serial_putc (c);
   vga_putc (c);
 }
+
+/* Writes the N characters in BUFFER to the vga display and serial
+   port.  The caller has already acquired the console lock if
+   appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n) 
+{
+  ASSERT (console_locked_by_current_thread ());
+  write_cnt += n;
+  serial_putbuf ((const uint8_t *) buffer, n);
+  vga_putbuf (buffer, n);
+}
@@ -1,8 +1,13 @@
 #ifndef __LIB_KERNEL_CONSOLE_H
 #define __LIB_KERNEL_CONSOLE_H
 
+struct stats;
+
 void console_init (void);
 void console_panic (void);
 void console_print_stats (void);
+void console_get_stats (struct stats *);
+void console_acquire (void);
+void console_release (void);
 
 #endif /* lib/kernel/console.h */
@@ -8,6 +8,75 @@
 #include "threads/init.h"
 #include "threads/interrupt.h"
 #include "devices/serial.h"
+#include "devices/vga.h"
+
+/* Runtime level of each subsystem.  Only errors by default. */
+unsigned char log_levels[LOG_SUBSYS_CNT] =
+  {
+    [0 ... LOG_SUBSYS_CNT - 1] = LOG_ERROR,
+  };
+
+/* Names of the subsystems and the levels, for log_configure(). */
+static const char *subsys_names[LOG_SUBSYS_CNT] =
+  {
+    [LOG_MISC] = "misc",
+    [LOG_THREAD] = "thread",
+    [LOG_PROCESS] = "process",
+    [LOG_SYSCALL] = "syscall",
+    [LOG_PLIST] = "plist",
+    [LOG_FLIST] = "flist",
+  };
+static const char *level_names[] = { "off", "error", "info", "debug" };
+
+/* Returns the index of the LEN-byte name at S in the CNT NAMES, or
+   -1 if it is not there. */
+static int
+find_name (const char *s, size_t len, const char **names, int cnt)
+{
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    if (strlen (names[i]) == len && !memcmp (s, names[i], len))
+      return i;
+  return -1;
+}
+
+/* Sets log levels from SPEC, a comma-separated list of
+   SUBSYS[:LEVEL] items, where SUBSYS may be `all' and LEVEL, one
+   of off error info debug, defaults to debug.  Returns false if
+   SPEC is malformed, leaving some levels set. */
+bool
+log_configure (const char *spec)
+{
+  while (*spec != '\0')
+    {
+      size_t len = strcspn (spec, ",");
+      size_t name_len = strcspn (spec, ":,");
+      int subsys, level = LOG_DEBUG;
+
+      if (name_len < len)
+        {
+          level = find_name (spec + name_len + 1, len - name_len - 1,
+                             level_names,
+                             sizeof level_names / sizeof *level_names);
+          if (level < 0)
+            return false;
+        }
+      if (name_len == 3 && !memcmp (spec, "all", 3))
+        memset (log_levels, level, sizeof log_levels);
+      else
+        {
+          subsys = find_name (spec, name_len, subsys_names, LOG_SUBSYS_CNT);
+          if (subsys < 0)
+            return false;
+          log_levels[subsys] = level;
+        }
+      spec += len;
+      if (*spec == ',')
+        spec++;
+    }
+  return true;
+}
 
 /* Halts the OS, printing the source file name, line number, and
    function name, plus a user-specific message. */
@@ -41,6 +110,7 @@ debug_panic (const char *file, int line, const char *function,
       /* Don't print anything: that's probably why we recursed. */
     }
 
+  vga_flush ();
   serial_flush ();
   if (power_off_when_done)
     power_off ();
@@ -18,6 +18,12 @@ static struct hash_elem *find_elem (struct hash *, struct list *,
 static void insert_elem (struct hash *, struct list *, struct hash_elem *);
 static void remove_elem (struct hash *, struct hash_elem *);
 static void rehash (struct hash *);
+static void migrate (struct hash *);
+static void move_bucket (struct hash *, struct list *);
+static void clear_buckets (struct hash *, struct list *, size_t,
+                           hash_action_func *);
+static void apply_buckets (struct hash *, struct list *, size_t,
+                           hash_action_func *);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
@@ -31,6 +37,10 @@ hash_init (struct hash *h,
   h->hash = hash;
   h->less = less;
   h->aux = aux;
+  h->incremental = false;
+  h->old_buckets = NULL;
+  h->old_bucket_cnt = 0;
+  h->migrate_idx = 0;
 
   if (h->buckets != NULL) 
     {
@@ -41,6 +51,19 @@ hash_init (struct hash *h,
     return false;
 }
 
+/* Initializes hash table H like hash_init(), but so that it
+   resizes itself incrementally, a few buckets per insertion or
+   deletion, instead of all at once.  See hash.h for details. */
+bool
+hash_init_incremental (struct hash *h, hash_hash_func *hash,
+                       hash_less_func *less, void *aux) 
+{
+  if (!hash_init (h, hash, less, aux))
+    return false;
+  h->incremental = true;
+  return true;
+}
+
 /* Removes all the elements from H.
    
    If DESTRUCTOR is non-null, then it is called for each element
@@ -53,22 +76,13 @@ hash_init (struct hash *h,
 void
 hash_clear (struct hash *h, hash_action_func *destructor) 
 {
-  size_t i;
-
-  for (i = 0; i < h->bucket_cnt; i++) 
+  clear_buckets (h, h->buckets, h->bucket_cnt, destructor);
+  if (h->old_buckets != NULL)
     {
-      struct list *bucket = &h->buckets[i];
-
-      if (destructor != NULL) 
-        while (!list_empty (bucket)) 
-          {
-            struct list_elem *list_elem = list_pop_front (bucket);
-            struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
-            destructor (hash_elem, h->aux);
-          }
-
-      list_init (bucket); 
-    }    
+      clear_buckets (h, h->old_buckets, h->old_bucket_cnt, destructor);
+      free (h->old_buckets);
+      h->old_buckets = NULL;
+    }
 
   h->elem_cnt = 0;
 }
@@ -89,6 +103,7 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
   if (destructor != NULL)
     hash_clear (h, destructor);
   free (h->buckets);
+  free (h->old_buckets);
 }
 
 /* Inserts NEW into hash table H and returns a null pointer, if
@@ -162,21 +177,12 @@ hash_delete (struct hash *h, struct hash_elem *e)
 void
 hash_apply (struct hash *h, hash_action_func *action) 
 {
-  size_t i;
-  
   ASSERT (action != NULL);
 
-  for (i = 0; i < h->bucket_cnt; i++) 
-    {
-      struct list *bucket = &h->buckets[i];
-      struct list_elem *elem, *next;
-
-      for (elem = list_begin (bucket); elem != list_end (bucket); elem = next) 
-        {
-          next = list_next (elem);
-          action (list_elem_to_hash_elem (elem), h->aux);
-        }
-    }
+  apply_buckets (h, h->buckets, h->bucket_cnt, action);
+  if (h->old_buckets != NULL)
+    apply_buckets (h, h->old_buckets + h->migrate_idx,
+                   h->old_bucket_cnt - h->migrate_idx, action);
 }
 
 /* Initializes I for iterating hash table H.
@@ -202,8 +208,18 @@ hash_first (struct hash_iterator *i, struct hash *h)
   ASSERT (i != NULL);
   ASSERT (h != NULL);
 
+  /* Visit the old buckets still in use, if any, first. */
   i->hash = h;
-  i->bucket = i->hash->buckets;
+  if (h->old_buckets != NULL)
+    {
+      i->bucket = h->old_buckets + h->migrate_idx;
+      i->bucket_end = h->old_buckets + h->old_bucket_cnt;
+    }
+  else
+    {
+      i->bucket = h->buckets;
+      i->bucket_end = h->buckets + h->bucket_cnt;
+    }
   i->elem = list_elem_to_hash_elem (list_head (i->bucket));
 }
 
@@ -223,10 +239,19 @@ hash_next (struct hash_iterator *i)
   i->elem = list_elem_to_hash_elem (list_next (&i->elem->list_elem));
   while (i->elem == list_elem_to_hash_elem (list_end (i->bucket)))
     {
-      if (++i->bucket >= i->hash->buckets + i->hash->bucket_cnt)
+      if (++i->bucket >= i->bucket_end)
         {
-          i->elem = NULL;
-          break;
+          struct hash *h = i->hash;
+
+          if (i->bucket_end == h->buckets + h->bucket_cnt)
+            {
+              i->elem = NULL;
+              break;
+            }
+
+          /* Done with the old buckets, on to the new ones. */
+          i->bucket = h->buckets;
+          i->bucket_end = h->buckets + h->bucket_cnt;
         }
       i->elem = list_elem_to_hash_elem (list_begin (i->bucket));
     }
@@ -305,8 +330,7 @@ hash_int (int i)
 static struct list *
 find_bucket (struct hash *h, struct hash_elem *e) 
 {
-  size_t bucket_idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
-  return &h->buckets[bucket_idx];
+  return hash_bucket (h, h->hash (e, h->aux));
 }
 
 /* Searches BUCKET in H for a hash element equal to E.  Returns
@@ -344,10 +368,20 @@ is_power_of_2 (size_t x)
 #define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
 #define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
 
+/* Number of old buckets an incremental hash table empties per
+   insertion or deletion.  A resize moves at most half the
+   elements that trigger the next one, so this easily finishes
+   each resize before another is due. */
+#define MIGRATE_BUCKETS 4
+
 /* Changes the number of buckets in hash table H to match the
    ideal.  This function can fail because of an out-of-memory
    condition, but that'll just make hash accesses less efficient;
-   we can still continue. */
+   we can still continue.
+
+   An incremental table takes the next step of a resize already
+   underway, if any, and otherwise, if its bucket count should
+   change, allocates the new buckets and takes the first step. */
 static void
 rehash (struct hash *h) 
 {
@@ -357,6 +391,12 @@ rehash (struct hash *h)
 
   ASSERT (h != NULL);
 
+  if (h->old_buckets != NULL)
+    {
+      migrate (h);
+      return;
+    }
+
   /* Save old bucket info for later use. */
   old_buckets = h->buckets;
   old_bucket_cnt = h->bucket_cnt;
@@ -391,25 +431,97 @@ rehash (struct hash *h)
   h->buckets = new_buckets;
   h->bucket_cnt = new_bucket_cnt;
 
+  if (h->incremental)
+    {
+      /* Leave the elements where they are for now. */
+      h->old_buckets = old_buckets;
+      h->old_bucket_cnt = old_bucket_cnt;
+      h->migrate_idx = 0;
+      migrate (h);
+      return;
+    }
+
   /* Move each old element into the appropriate new bucket. */
   for (i = 0; i < old_bucket_cnt; i++) 
+    move_bucket (h, &old_buckets[i]);
+
+  free (old_buckets);
+}
+
+/* Moves the elements of up to MIGRATE_BUCKETS of H's old buckets
+   into its new ones, freeing the old buckets once all are
+   empty. */
+static void
+migrate (struct hash *h) 
+{
+  int i;
+
+  for (i = 0; i < MIGRATE_BUCKETS && h->migrate_idx < h->old_bucket_cnt; i++)
+    move_bucket (h, &h->old_buckets[h->migrate_idx++]);
+
+  if (h->migrate_idx >= h->old_bucket_cnt)
+    {
+      free (h->old_buckets);
+      h->old_buckets = NULL;
+    }
+}
+
+/* Moves each element of OLD_BUCKET into the appropriate bucket
+   of H's current bucket array. */
+static void
+move_bucket (struct hash *h, struct list *old_bucket) 
+{
+  while (!list_empty (old_bucket)) 
+    {
+      struct list_elem *elem = list_pop_front (old_bucket);
+      unsigned hash = h->hash (list_elem_to_hash_elem (elem), h->aux);
+      list_push_front (&h->buckets[hash & (h->bucket_cnt - 1)], elem);
+    }
+}
+
+/* Empties the CNT buckets in BUCKETS, which belong to H, calling
+   DESTRUCTOR, if it is nonnull, for each element. */
+static void
+clear_buckets (struct hash *h, struct list *buckets, size_t cnt,
+               hash_action_func *destructor) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++) 
     {
-      struct list *old_bucket;
+      struct list *bucket = &buckets[i];
+
+      if (destructor != NULL) 
+        while (!list_empty (bucket)) 
+          {
+            struct list_elem *list_elem = list_pop_front (bucket);
+            struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
+            destructor (hash_elem, h->aux);
+          }
+
+      list_init (bucket); 
+    }    
+}
+
+/* Calls ACTION for each element in the CNT buckets in BUCKETS,
+   which belong to H. */
+static void
+apply_buckets (struct hash *h, struct list *buckets, size_t cnt,
+               hash_action_func *action) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++) 
+    {
+      struct list *bucket = &buckets[i];
       struct list_elem *elem, *next;
 
-      old_bucket = &old_buckets[i];
-      for (elem = list_begin (old_bucket);
-           elem != list_end (old_bucket); elem = next) 
+      for (elem = list_begin (bucket); elem != list_end (bucket); elem = next) 
         {
-          struct list *new_bucket
-            = find_bucket (h, list_elem_to_hash_elem (elem));
           next = list_next (elem);
-          list_remove (elem);
-          list_push_front (new_bucket, elem);
+          action (list_elem_to_hash_elem (elem), h->aux);
         }
     }
-
-  free (old_buckets);
 }
 
 /* Inserts E into BUCKET (in hash table H). */
@@ -18,7 +18,15 @@
    conversion from a struct hash_elem back to a structure object
    that contains it.  This is the same technique used in the
    linked list implementation.  Refer to lib/kernel/list.h for a
-   detailed explanation. */
+   detailed explanation.
+
+   A table made with hash_init() resizes itself all at once,
+   moving every element, when its load gets too high or too low.
+   One made with hash_init_incremental() instead keeps the old
+   bucket array alongside the new one and moves a few buckets per
+   insertion or deletion, so that no single operation takes time
+   proportional to the size of the table.  Lookups then may have
+   to look in either array, but never in both. */
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -64,6 +72,12 @@ struct hash
     hash_hash_func *hash;       /* Hash function. */
     hash_less_func *less;       /* Comparison function. */
     void *aux;                  /* Auxiliary data for `hash' and `less'. */
+
+    /* Incremental resizing. */
+    bool incremental;           /* Resize a few buckets at a time? */
+    struct list *old_buckets;   /* Buckets being emptied, or null. */
+    size_t old_bucket_cnt;      /* Number of old buckets. */
+    size_t migrate_idx;         /* Old buckets below this are empty. */
   };
 
 /* A hash table iterator. */
@@ -71,11 +85,14 @@ struct hash_iterator
   {
     struct hash *hash;          /* The hash table. */
     struct list *bucket;        /* Current bucket. */
+    struct list *bucket_end;    /* End of current bucket's array. */
     struct hash_elem *elem;     /* Current hash element in current bucket. */
   };
 
 /* Basic life cycle. */
 bool hash_init (struct hash *, hash_hash_func *, hash_less_func *, void *aux);
+bool hash_init_incremental (struct hash *, hash_hash_func *,
+                            hash_less_func *, void *aux);
 void hash_clear (struct hash *, hash_action_func *);
 void hash_destroy (struct hash *, hash_action_func *);
 
@@ -85,6 +102,50 @@ struct hash_elem *hash_replace (struct hash *, struct hash_elem *);
 struct hash_elem *hash_find (struct hash *, struct hash_elem *);
 struct hash_elem *hash_delete (struct hash *, struct hash_elem *);
 
+/* Returns the bucket in H for elements with hash value HASH.
+   While H is being resized incrementally, that is an old bucket
+   if that hash value's old bucket has not been moved yet. */
+static inline struct list *
+hash_bucket (struct hash *h, unsigned hash)
+{
+  if (h->old_buckets != NULL)
+    {
+      size_t old_idx = hash & (h->old_bucket_cnt - 1);
+      if (old_idx >= h->migrate_idx)
+        return &h->old_buckets[old_idx];
+    }
+  return &h->buckets[hash & (h->bucket_cnt - 1)];
+}
+
+/* Defines NAME as a static inline function that does what
+   hash_find() does, for a table of STRUCTs linked through hash
+   element MEMBER, but takes a key instead of an element:
+
+        STRUCT *NAME (struct hash *h, KEY_TYPE key);
+
+   HASH(KEY) must return the same value as the table's hash
+   function does for an element with that key, and EQUAL(S, KEY)
+   must return true if the STRUCT that S points to has that key.
+   Both are expanded in place, so the compiler can inline them
+   instead of calling through the table's function pointers, and
+   the caller need not fill in a whole STRUCT as the key. */
+#define DEFINE_HASH_FIND(NAME, STRUCT, MEMBER, KEY_TYPE, HASH, EQUAL)   \
+        static inline STRUCT *                                          \
+        NAME (struct hash *h, KEY_TYPE key)                             \
+        {                                                               \
+          struct list *bucket = hash_bucket (h, HASH (key));            \
+          struct list_elem *i;                                          \
+                                                                        \
+          for (i = list_begin (bucket); i != list_end (bucket);         \
+               i = list_next (i))                                       \
+            {                                                           \
+              STRUCT *s = list_entry (i, STRUCT, MEMBER.list_elem);     \
+              if (EQUAL (s, key))                                       \
+                return s;                                               \
+            }                                                           \
+          return NULL;                                                  \
+        }
+
 /* Iteration. */
 void hash_apply (struct hash *, hash_action_func *);
 void hash_first (struct hash_iterator *, struct hash *);
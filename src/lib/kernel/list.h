@@ -161,6 +161,29 @@ void list_insert_ordered (struct list *, struct list_elem *,
 void list_unique (struct list *, struct list *duplicates,
                   list_less_func *, void *aux);
 
+/* Defines NAME as a static inline function that does what
+   list_insert_ordered() does, for a list of STRUCTs linked
+   through list element MEMBER:
+
+        void NAME (struct list *list, STRUCT *elem);
+
+   LESS is a function or macro that takes two pointers to STRUCT
+   and returns true if the first is less than the second.  It is
+   expanded in place, so the compiler can inline the comparison
+   instead of calling through a list_less_func pointer. */
+#define DEFINE_LIST_INSERT_ORDERED(NAME, STRUCT, MEMBER, LESS)          \
+        static inline void                                              \
+        NAME (struct list *list, STRUCT *elem)                          \
+        {                                                               \
+          struct list_elem *e;                                          \
+                                                                        \
+          for (e = list_begin (list); e != list_end (list);             \
+               e = list_next (e))                                       \
+            if (LESS (elem, list_entry (e, STRUCT, MEMBER)))            \
+              break;                                                    \
+          list_insert (e, &elem->MEMBER);                               \
+        }
+
 /* Max and min. */
 struct list_elem *list_max (struct list *, list_less_func *, void *aux);
 struct list_elem *list_min (struct list *, list_less_func *, void *aux);
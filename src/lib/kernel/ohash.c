@@ -0,0 +1,199 @@
+/* Open-addressing hash table.
+
+   See ohash.h for basic information.
+
+   Collisions are resolved by linear probing: a key lives in its
+   home slot or, if that is taken, in the first empty slot after
+   it, wrapping around at the end of the array.  At most three
+   quarters of the slots are ever in use, so probe sequences stay
+   short and always end at an empty slot. */
+
+#include "ohash.h"
+#include "../debug.h"
+#include "threads/malloc.h"
+
+/* Fewest slots in a table. */
+#define MIN_SLOTS 8
+
+static bool resize (struct ohash *, size_t slot_cnt);
+
+/* Returns the home slot of KEY in H.  Multiplying by 2**32
+   divided by the golden ratio mixes every bit of KEY into the
+   high bits of the product, which select the slot, so keys that
+   differ only in their high bits or that are all multiples of
+   the page size still spread out. */
+static inline size_t
+home_slot (const struct ohash *h, uintptr_t key)
+{
+  return (uint32_t) ((uint32_t) key * 2654435769u) >> h->shift;
+}
+
+/* Returns the slot in H that holds KEY or, if KEY is not in H,
+   the empty slot where it would go. */
+static struct ohash_slot *
+probe (const struct ohash *h, uintptr_t key)
+{
+  size_t mask = h->slot_cnt - 1;
+  size_t i;
+
+  for (i = home_slot (h, key); h->slots[i].value != NULL; i = (i + 1) & mask)
+    if (h->slots[i].key == key)
+      break;
+  return &h->slots[i];
+}
+
+/* Initializes H as an empty table with room for CNT keys before
+   it first has to grow.  Returns false if memory is short. */
+bool
+ohash_init (struct ohash *h, size_t cnt)
+{
+  h->cnt = 0;
+  h->slot_cnt = 0;
+  h->slots = NULL;
+  return resize (h, cnt + cnt / 3 + 1);
+}
+
+/* Destroys hash table H.  If ACTION is non-null, then it is
+   first called for each key and value in the table, given
+   auxiliary data AUX.  ACTION may, if appropriate, deallocate
+   the value. */
+void
+ohash_destroy (struct ohash *h, ohash_action_func *action, void *aux)
+{
+  if (action != NULL)
+    ohash_apply (h, action, aux);
+  free (h->slots);
+  h->slots = NULL;
+  h->slot_cnt = h->cnt = 0;
+}
+
+/* Returns the value of KEY in H, or a null pointer if KEY is not
+   in H. */
+void *
+ohash_find (const struct ohash *h, uintptr_t key)
+{
+  return probe (h, key)->value;
+}
+
+/* Sets the value of KEY in H to VALUE, which must not be null,
+   replacing any value KEY had.  Returns true if successful,
+   false if H had to grow but memory is short. */
+bool
+ohash_insert (struct ohash *h, uintptr_t key, void *value)
+{
+  struct ohash_slot *s;
+
+  ASSERT (value != NULL);
+
+  if ((h->cnt + 1) * 4 > h->slot_cnt * 3
+      && !resize (h, h->slot_cnt * 2)
+      && h->cnt + 2 > h->slot_cnt)
+    {
+      /* Filling the whole table would leave probes no empty slot
+         to stop at.  Short of that, a crowded table still
+         works, just more slowly. */
+      return false;
+    }
+
+  s = probe (h, key);
+  if (s->value == NULL)
+    {
+      s->key = key;
+      h->cnt++;
+    }
+  s->value = value;
+  return true;
+}
+
+/* Removes KEY from H and returns its value, or returns a null
+   pointer if KEY is not in H. */
+void *
+ohash_delete (struct ohash *h, uintptr_t key)
+{
+  size_t mask = h->slot_cnt - 1;
+  struct ohash_slot *s = probe (h, key);
+  void *value = s->value;
+  size_t hole, i;
+
+  if (value == NULL)
+    return NULL;
+
+  /* Fill the hole with the next key in the run of full slots
+     that may legally move back to it, one whose home slot is not
+     between the hole and the key, and repeat with the hole that
+     leaves, until the run ends. */
+  hole = i = s - h->slots;
+  for (;;)
+    {
+      size_t home;
+
+      i = (i + 1) & mask;
+      if (h->slots[i].value == NULL)
+        break;
+      home = home_slot (h, h->slots[i].key);
+      if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+          h->slots[hole] = h->slots[i];
+          hole = i;
+        }
+    }
+  h->slots[hole].value = NULL;
+  h->cnt--;
+  return value;
+}
+
+/* Calls ACTION for each key and value in hash table H, in
+   arbitrary order, given auxiliary data AUX.  Modifying H while
+   ohash_apply() is running yields undefined behavior. */
+void
+ohash_apply (struct ohash *h, ohash_action_func *action, void *aux)
+{
+  size_t i;
+
+  ASSERT (action != NULL);
+
+  for (i = 0; i < h->slot_cnt; i++)
+    if (h->slots[i].value != NULL)
+      action (h->slots[i].key, h->slots[i].value, aux);
+}
+
+/* Returns the number of keys in H. */
+size_t
+ohash_size (const struct ohash *h)
+{
+  return h->cnt;
+}
+
+/* Moves the entries of H into a new array of at least SLOT_CNT
+   slots, rounded up to a power of 2.  Returns false, leaving H
+   unchanged, if memory is short. */
+static bool
+resize (struct ohash *h, size_t slot_cnt)
+{
+  struct ohash_slot *old_slots = h->slots;
+  size_t old_slot_cnt = h->slot_cnt;
+  size_t cnt, i;
+  int bits;
+
+  for (cnt = MIN_SLOTS, bits = 3; cnt < slot_cnt; cnt *= 2)
+    {
+      if (cnt > SIZE_MAX / 2 / sizeof *h->slots)
+        return false;
+      bits++;
+    }
+
+  h->slots = calloc (cnt, sizeof *h->slots);
+  if (h->slots == NULL)
+    {
+      h->slots = old_slots;
+      return false;
+    }
+  h->slot_cnt = cnt;
+  h->shift = 32 - bits;
+
+  for (i = 0; i < old_slot_cnt; i++)
+    if (old_slots[i].value != NULL)
+      *probe (h, old_slots[i].key) = old_slots[i];
+  free (old_slots);
+  return true;
+}
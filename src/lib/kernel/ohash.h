@@ -0,0 +1,61 @@
+#ifndef __LIB_KERNEL_OHASH_H
+#define __LIB_KERNEL_OHASH_H
+
+/* Open-addressing hash table from integer keys to pointers.
+
+   Unlike the chained hash table in hash.h, this table stores
+   each key, with its value, inline in one array of slots.  A
+   lookup hashes the key to a "home" slot and scans forward from
+   there, usually within one cache line, instead of following
+   list pointers out to elements scattered through memory.  It
+   suits read-mostly tables with a simple key, such as a sector
+   number or a page address.
+
+   A slot is empty if its value is a null pointer, so null
+   values cannot be stored.  Deletion moves later entries back
+   into the freed slot rather than leaving a marker, so lookups
+   never slow down as entries come and go.  The table doubles in
+   size when it becomes three-quarters full, so a table that
+   must never allocate should be initialized with room for all
+   the keys it will hold. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* One key and its value. */
+struct ohash_slot
+  {
+    uintptr_t key;              /* Key, if VALUE is nonnull. */
+    void *value;                /* Value, or null if slot is empty. */
+  };
+
+/* Open-addressing hash table. */
+struct ohash
+  {
+    size_t cnt;                 /* Number of keys in table. */
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    int shift;                  /* 32 - log2 (slot_cnt). */
+    struct ohash_slot *slots;   /* Array of `slot_cnt' slots. */
+  };
+
+/* Performs some operation on the entry with KEY and VALUE, given
+   auxiliary data AUX. */
+typedef void ohash_action_func (uintptr_t key, void *value, void *aux);
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *, size_t cnt);
+void ohash_destroy (struct ohash *, ohash_action_func *, void *aux);
+
+/* Search, insertion, deletion. */
+void *ohash_find (const struct ohash *, uintptr_t key);
+bool ohash_insert (struct ohash *, uintptr_t key, void *value);
+void *ohash_delete (struct ohash *, uintptr_t key);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, ohash_action_func *, void *aux);
+
+/* Information. */
+size_t ohash_size (const struct ohash *);
+
+#endif /* lib/kernel/ohash.h */
@@ -0,0 +1,214 @@
+#include "pqueue.h"
+#include "../debug.h"
+
+/* A priority queue is a pairing heap, as described by Fredman,
+   Sedgewick, Sleator, and Tarjan in "The Pairing Heap: A New Form
+   of Self-Adjusting Heap" (Algorithmica 1, 1986).
+
+   Each element's children form a doubly linked list through
+   their `next' and `prev' members, except that the first
+   child's `prev' points to the parent.  Two trees are combined
+   by "linking" them: the root of the lesser becomes the first
+   child of the root of the greater, in constant time.  Pushing
+   an element links it with the root as a tree of one.
+
+   Popping the root leaves its children as a list of trees,
+   which are linked back into one tree in two passes: first
+   pairwise from left to right, then each of the resulting trees
+   into the last, from right to left.  The second pass keeps the
+   tree from degenerating into a long list of children, which is
+   what makes the amortized cost of a pop logarithmic. */
+
+/* Links the trees rooted at A and B, returning the root of the
+   result.  The `next' and `prev' members of the returned root
+   are left for the caller to set. */
+static struct pqueue_elem *
+link (struct pqueue *h, struct pqueue_elem *a, struct pqueue_elem *b)
+{
+  if (h->less (a, b, h->aux))
+    {
+      struct pqueue_elem *t = a;
+      a = b;
+      b = t;
+    }
+
+  b->next = a->child;
+  if (b->next != NULL)
+    b->next->prev = b;
+  b->prev = a;
+  a->child = b;
+  return a;
+}
+
+/* Links the list of trees that starts at FIRST into one tree,
+   in two passes, and returns its root, or a null pointer if the
+   list is empty. */
+static struct pqueue_elem *
+merge_pairs (struct pqueue *h, struct pqueue_elem *first)
+{
+  struct pqueue_elem *pairs = NULL;
+  struct pqueue_elem *root;
+
+  /* Link pairs from left to right, stacking the results on
+     PAIRS through their `next' members. */
+  while (first != NULL)
+    {
+      struct pqueue_elem *a = first;
+      struct pqueue_elem *b = a->next;
+
+      if (b != NULL)
+        {
+          first = b->next;
+          a = link (h, a, b);
+        }
+      else
+        first = NULL;
+      a->next = pairs;
+      pairs = a;
+    }
+  if (pairs == NULL)
+    return NULL;
+
+  /* Link each tree into the one on its right, popping them off
+     PAIRS in right-to-left order. */
+  root = pairs;
+  pairs = pairs->next;
+  while (pairs != NULL)
+    {
+      struct pqueue_elem *next = pairs->next;
+      root = link (h, pairs, root);
+      pairs = next;
+    }
+  root->next = root->prev = NULL;
+  return root;
+}
+
+/* Unlinks E, which must not be the root, and its subtree from
+   E's parent and siblings. */
+static void
+detach (struct pqueue_elem *e)
+{
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  e->next = e->prev = NULL;
+}
+
+/* Initializes H as an empty queue whose elements are ordered by
+   LESS, given auxiliary data AUX. */
+void
+pqueue_init (struct pqueue *h, pqueue_less_func *less, void *aux)
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->size = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into H, in constant time. */
+void
+pqueue_push (struct pqueue *h, struct pqueue_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  h->root = h->root != NULL ? link (h, h->root, e) : e;
+  h->size++;
+}
+
+/* Removes the greatest element from H and returns it.  Undefined
+   behavior if H is empty before removal. */
+struct pqueue_elem *
+pqueue_pop (struct pqueue *h)
+{
+  struct pqueue_elem *e;
+
+  ASSERT (!pqueue_empty (h));
+
+  e = h->root;
+  h->root = merge_pairs (h, e->child);
+  h->size--;
+  return e;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+pqueue_remove (struct pqueue *h, struct pqueue_elem *e)
+{
+  struct pqueue_elem *sub;
+
+  ASSERT (!pqueue_empty (h));
+  ASSERT (e != NULL);
+
+  if (e == h->root)
+    {
+      pqueue_pop (h);
+      return;
+    }
+
+  detach (e);
+  sub = merge_pairs (h, e->child);
+  if (sub != NULL)
+    h->root = link (h, h->root, sub);
+  h->size--;
+}
+
+/* Restores H's order after E, which must be in H, has become
+   greater, in constant time.  E's children are all still no
+   greater than E, so only E's own subtree needs to move. */
+void
+pqueue_raise (struct pqueue *h, struct pqueue_elem *e)
+{
+  ASSERT (!pqueue_empty (h));
+  ASSERT (e != NULL);
+
+  if (e != h->root)
+    {
+      detach (e);
+      h->root = link (h, h->root, e);
+    }
+}
+
+/* Restores H's order after E, which must be in H, has become
+   greater or smaller. */
+void
+pqueue_update (struct pqueue *h, struct pqueue_elem *e)
+{
+  pqueue_remove (h, e);
+  pqueue_push (h, e);
+}
+
+/* Returns the greatest element in H, or a null pointer if H is
+   empty. */
+struct pqueue_elem *
+pqueue_max (const struct pqueue *h)
+{
+  ASSERT (h != NULL);
+
+  return h->root;
+}
+
+/* Returns the number of elements in H. */
+size_t
+pqueue_size (const struct pqueue *h)
+{
+  ASSERT (h != NULL);
+
+  return h->size;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+pqueue_empty (const struct pqueue *h)
+{
+  ASSERT (h != NULL);
+
+  return h->root == NULL;
+}
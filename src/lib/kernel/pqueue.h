@@ -0,0 +1,105 @@
+#ifndef __LIB_KERNEL_PQUEUE_H
+#define __LIB_KERNEL_PQUEUE_H
+
+/* Priority queue.
+
+   This is a pairing heap: a tree in which every element is at
+   least as "great" as each of its children, each element
+   pointing to its first child and to its siblings.  Finding the
+   greatest element takes constant time, as does adding an
+   element or making one greater.  Removing the greatest element,
+   or any other, takes O(log n) amortized time.  Compare
+   list_max(), which takes O(n) time to find the greatest
+   element of a list, and list_insert_ordered(), which takes
+   O(n) time to add one.
+
+   Like the doubly linked list in list.h, a priority queue
+   allocates no memory.  Each structure that can be in a queue
+   embeds a struct pqueue_elem member, and pqueue_entry() converts a pointer to that
+   member back into a pointer to the structure, just as
+   list_entry() does.  For example, given
+
+      struct foo
+        {
+          struct pqueue_elem elem;
+          int priority;
+          ...other members...
+        };
+
+      static bool
+      foo_less (const struct pqueue_elem *a, const struct pqueue_elem *b,
+                void *aux UNUSED)
+      {
+        return (pqueue_entry (a, struct foo, elem)->priority
+                < pqueue_entry (b, struct foo, elem)->priority);
+      }
+
+   a queue initialized with pqueue_init (&foo_queue, foo_less, NULL)
+   hands out the struct foo with the highest priority:
+
+      struct foo *f = pqueue_entry (pqueue_pop (&foo_queue),
+                                  struct foo, elem);
+
+   Elements that compare equal come out in no particular order.
+   A comparison function that breaks ties by a sequence number
+   makes them come out first in, first out.
+
+   The queue does not notice when an element's key changes.
+   After changing the key of an element in a queue, call
+   pqueue_raise() if the element became greater, pqueue_update()
+   if it may have become smaller. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Priority queue element. */
+struct pqueue_elem
+  {
+    struct pqueue_elem *child;    /* First child. */
+    struct pqueue_elem *next;     /* Next sibling. */
+    struct pqueue_elem *prev;     /* Previous sibling, or parent if
+                                   first child, or null if root. */
+  };
+
+/* Compares the values of two queue elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool pqueue_less_func (const struct pqueue_elem *a,
+                             const struct pqueue_elem *b,
+                             void *aux);
+
+/* Priority queue. */
+struct pqueue
+  {
+    struct pqueue_elem *root;     /* Greatest element, or null. */
+    size_t size;                /* Number of elements. */
+    pqueue_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Converts pointer to queue element PQUEUE_ELEM into a pointer
+   to the structure that PQUEUE_ELEM is embedded inside.  Supply
+   the name of the outer structure STRUCT and the member name
+   MEMBER of the queue element. */
+#define pqueue_entry(PQUEUE_ELEM, STRUCT, MEMBER)       \
+        ((STRUCT *) ((uint8_t *) &(PQUEUE_ELEM)->child  \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+void pqueue_init (struct pqueue *, pqueue_less_func *, void *aux);
+
+/* Insertion and removal. */
+void pqueue_push (struct pqueue *, struct pqueue_elem *);
+struct pqueue_elem *pqueue_pop (struct pqueue *);
+void pqueue_remove (struct pqueue *, struct pqueue_elem *);
+
+/* Key changes. */
+void pqueue_raise (struct pqueue *, struct pqueue_elem *);
+void pqueue_update (struct pqueue *, struct pqueue_elem *);
+
+/* Queue properties. */
+struct pqueue_elem *pqueue_max (const struct pqueue *);
+size_t pqueue_size (const struct pqueue *);
+bool pqueue_empty (const struct pqueue *);
+
+#endif /* lib/kernel/pqueue.h */
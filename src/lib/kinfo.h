@@ -0,0 +1,47 @@
+#ifndef __LIB_KINFO_H
+#define __LIB_KINFO_H
+
+#include <stdint.h>
+
+/* Kernel information pages, mapped read-only into every user
+   process by load(), so that a process can read the time and its
+   own pid without a system call.
+
+   The page at KINFO_ADDR is shared by all processes and updated
+   by the kernel as it runs: the timer interrupt stores TICKS, and
+   timer_calibrate() stores the time stamp counter calibration, so
+   that a process can turn RDTSC into nanoseconds as timer_ns()
+   does.  The page just after it, at KINFO_PROC_ADDR, belongs to
+   the process alone.
+
+   Both lie below the usual 0x08048000 start of the code, clear
+   of the segments, heap and stack. */
+#define KINFO_ADDR ((const struct kinfo *) 0x08000000)
+#define KINFO_PROC_ADDR ((const struct kinfo_proc *) 0x08001000)
+
+/* Version of struct kinfo.  As with struct stats, fields are only
+   ever added at the end. */
+#define KINFO_VERSION 1
+
+/* The shared page.  A reader can be interrupted by the timer
+   halfway through the 64-bit fields, so the kernel makes SEQ odd
+   while it updates them, and a reader retries until it reads the
+   same even SEQ before and after. */
+struct kinfo
+  {
+    uint32_t version;           /* KINFO_VERSION. */
+    uint32_t seq;               /* Update count, odd during updates. */
+    int64_t ticks;              /* Timer ticks since boot. */
+    int32_t timer_freq;         /* Timer ticks per second. */
+    uint64_t tsc_hz;            /* TSC cycles per second, or 0. */
+    uint64_t tsc_boot;          /* TSC when the timer started. */
+    uint64_t tsc_ns_scale;      /* Nanoseconds per cycle, 32.32. */
+  };
+
+/* The per-process page.  Never changes while the process runs. */
+struct kinfo_proc
+  {
+    int32_t pid;                /* Process identifier. */
+  };
+
+#endif /* lib/kinfo.h */
@@ -0,0 +1,24 @@
+#ifndef __LIB_POLL_H
+#define __LIB_POLL_H
+
+/* One file descriptor watched by poll().  The caller sets FD and
+   EVENTS; poll() sets REVENTS. */
+struct pollfd
+  {
+    int fd;                     /* File descriptor. */
+    short events;               /* Events to watch for. */
+    short revents;              /* Events that occurred. */
+  };
+
+/* Values for EVENTS and REVENTS. */
+#define POLLIN   0x01           /* Reading would not block. */
+#define POLLOUT  0x04           /* Writing would not block. */
+
+/* Values for REVENTS only, reported even if not asked for. */
+#define POLLHUP  0x10           /* The other end of a pipe is closed. */
+#define POLLNVAL 0x20           /* FD is not open. */
+
+/* Most file descriptors one poll() call accepts. */
+#define POLL_MAX 32
+
+#endif /* lib/poll.h */
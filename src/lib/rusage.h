@@ -0,0 +1,23 @@
+#ifndef __LIB_RUSAGE_H
+#define __LIB_RUSAGE_H
+
+#include <stats.h>
+
+/* Resources used by one process over its whole life, summed over
+   its threads, as wait_rusage() returns them for a dead child. */
+struct rusage
+  {
+    long long user_ticks;       /* Timer ticks running user code. */
+    long long kernel_ticks;     /* Timer ticks running in the kernel. */
+    long long voluntary_switches;   /* Times it blocked or yielded. */
+    long long involuntary_switches; /* Times it was preempted. */
+    long long faults[FAULT_CLASS_CNT]; /* Page faults, by fault_class. */
+    long long read_bytes;       /* Bytes read by read calls. */
+    long long write_bytes;      /* Bytes written by write calls. */
+    long long disk_read_sectors;  /* Sectors read from disk for it. */
+    long long disk_write_sectors; /* Sectors written to disk for it. */
+    long long max_resident;     /* Most pages mapped at once. */
+    long long syscalls[STATS_SYSCALLS]; /* Calls, by SYS_* number. */
+  };
+
+#endif /* lib/rusage.h */
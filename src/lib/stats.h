@@ -0,0 +1,138 @@
+#ifndef __LIB_STATS_H
+#define __LIB_STATS_H
+
+#include <disk-stats.h>
+#include <stdint.h>
+
+/* Version of struct stats.  Fields are only ever added at the
+   end, each addition bumping the version, so that a program
+   built for an older version can read the prefix it knows. */
+#define STATS_VERSION 5
+
+/* Number of system calls with counters in struct stats. */
+#define STATS_SYSCALLS 64
+
+/* Classes of page fault, by how the kernel served it. */
+enum fault_class
+  {
+    FAULT_FILE,                 /* Page read from its file. */
+    FAULT_ZERO,                 /* Page of zeros. */
+    FAULT_SWAP,                 /* Page read back from swap. */
+    FAULT_STACK,                /* New page of a growing stack. */
+    FAULT_COW,                  /* Private copy of a shared page. */
+    FAULT_INVALID,              /* Bad access, not served. */
+    FAULT_CLASS_CNT
+  };
+
+/* Number of buckets in a fault latency histogram.  Bucket 0
+   counts faults served in under 2 us, bucket I in [2**I, 2**(I+1))
+   us, and the last bucket everything slower. */
+#define FAULT_HIST_BUCKETS 16
+
+/* Counters of one class of page fault. */
+struct fault_stats
+  {
+    long long cnt;              /* Number of faults. */
+    int64_t ns;                 /* Total time serving them. */
+    long long hist[FAULT_HIST_BUCKETS]; /* Latency histogram. */
+  };
+
+/* Phases of starting a process with exec(), in order.  The
+   parent does EXEC_SPAWN and then waits, while the new thread does
+   the rest. */
+enum exec_phase
+  {
+    EXEC_SPAWN,                 /* Copying the command line. */
+    EXEC_THREAD,                /* Creating the thread, until it runs. */
+    EXEC_SETUP,                 /* Page directory, page table, stack. */
+    EXEC_OPEN,                  /* Opening the executable. */
+    EXEC_SEGMENTS,              /* Reading headers, mapping segments. */
+    EXEC_REGISTER,              /* Process list, copying arguments. */
+    EXEC_PHASE_CNT
+  };
+
+/* Number of external interrupt lines, IRQ 0 through 15, with
+   counters in struct stats. */
+#define STATS_IRQS 16
+
+/* Counters of one interrupt vector.  Cycles run from the kernel's
+   interrupt entry until just before any yield on return, and so
+   include the bottom halves the interrupt ran and any interrupts
+   that arrived while they did. */
+struct intr_stats
+  {
+    long long cnt;              /* Number of interrupts. */
+    uint64_t cycles;            /* CPU cycles spent handling them. */
+    uint64_t max_cycles;        /* Most cycles one of them took. */
+    long long yield_cnt;        /* Those that ended in a yield. */
+  };
+
+/* Counters of one system call. */
+struct syscall_stats
+  {
+    long long calls;            /* Number of calls. */
+    uint64_t cycles;            /* CPU cycles spent in them. */
+  };
+
+/* A snapshot of kernel counters, as returned by stats().  Counts
+   are since boot unless noted; subtract two snapshots to measure
+   an interval. */
+struct stats
+  {
+    unsigned version;           /* STATS_VERSION. */
+    unsigned size;              /* Size of the kernel's struct stats. */
+
+    /* Timer and scheduler. */
+    long long ticks;            /* Timer ticks. */
+    long long idle_ticks;       /* Ticks spent idle. */
+    long long kernel_ticks;     /* Ticks in kernel threads. */
+    long long user_ticks;       /* Ticks in user programs. */
+    long long switch_cnt;       /* Thread switches. */
+    long long preempt_cnt;      /* Switches that preempted a thread. */
+    int thread_cnt;             /* Threads now. */
+    int ready_cnt;              /* Threads ready to run now. */
+
+    /* Memory. */
+    unsigned kernel_pages;      /* Pages in the kernel pool. */
+    unsigned kernel_free_pages; /* Of them, free now. */
+    unsigned user_pages;        /* Pages in the user pool. */
+    unsigned user_free_pages;   /* Of them, free now. */
+    long long zeroed_hit_cnt;   /* PAL_ZERO pages served pre-zeroed. */
+    long long zeroed_miss_cnt;  /* PAL_ZERO pages zeroed on the spot. */
+    unsigned malloc_arenas;     /* Pages in malloc() arenas now. */
+    unsigned malloc_big_pages;  /* Pages in big malloc() blocks now. */
+    unsigned frame_cnt;         /* User frames in use now (VM only). */
+    long long evict_cnt;        /* Frames evicted (VM only). */
+
+    /* Devices and exceptions. */
+    long long console_cnt;      /* Characters written to the console. */
+    long long key_cnt;          /* Keys pressed. */
+    long long page_fault_cnt;   /* Page faults. */
+    struct disk_stats disk;     /* File system disk and cache. */
+
+    /* System calls, indexed by number from <syscall-nr.h>. */
+    unsigned syscall_cnt;       /* Entries of SYSCALLS in use. */
+    struct syscall_stats syscalls[STATS_SYSCALLS];
+
+    /* Version 2: page faults, indexed by enum fault_class, for the
+       whole system and for the calling process, whose histograms
+       are not kept. */
+    struct fault_stats faults[FAULT_CLASS_CNT];
+    struct fault_stats proc_faults[FAULT_CLASS_CNT];
+
+    /* Version 3: memory pressure. */
+    unsigned user_low_pages;    /* User pool low watermark, in pages. */
+    long long pressure_cnt;     /* User allocations that left less. */
+    long long reclaim_cnt;      /* Frames freed ahead of need (VM only). */
+    long long exec_wait_cnt;    /* Execs that waited for memory. */
+    long long exec_wait_ticks;  /* Ticks they spent waiting. */
+
+    /* Version 4: exec, by enum exec_phase. */
+    long long exec_cnt;         /* Processes started. */
+    int64_t exec_ns[EXEC_PHASE_CNT]; /* Time spent in each phase. */
+
+    /* Version 5: external interrupts, by IRQ line. */
+    struct intr_stats irqs[STATS_IRQS];
+  };
+
+#endif /* lib/stats.h */
@@ -5,16 +5,6 @@
 #include <stdint.h>
 #include <string.h>
 
-/* Auxiliary data for vsnprintf_helper(). */
-struct vsnprintf_aux 
-  {
-    char *p;            /* Current output position. */
-    int length;         /* Length of output string. */
-    int max_length;     /* Max length of output string. */
-  };
-
-static void vsnprintf_helper (char, void *);
-
 /* Like vprintf(), except that output is stored into BUFFER,
    which must have space for BUF_SIZE characters.  Writes at most
    BUF_SIZE - 1 characters to BUFFER, followed by a null
@@ -25,30 +15,22 @@ static void vsnprintf_helper (char, void *);
 int
 vsnprintf (char *buffer, size_t buf_size, const char *format, va_list args) 
 {
-  /* Set up aux data for vsnprintf_helper(). */
-  struct vsnprintf_aux aux;
-  aux.p = buffer;
-  aux.length = 0;
-  aux.max_length = buf_size > 0 ? buf_size - 1 : 0;
+  /* Format straight into BUFFER, dropping what does not fit. */
+  struct printf_buffer pb;
+  pb.buf = buffer;
+  pb.size = buf_size > 0 ? buf_size - 1 : 0;
+  pb.len = 0;
+  pb.char_cnt = 0;
+  pb.flush = NULL;
 
   /* Do most of the work. */
-  __vprintf (format, args, vsnprintf_helper, &aux);
+  __vprintf_buffer (format, args, &pb);
 
   /* Add null terminator. */
   if (buf_size > 0)
-    *aux.p = '\0';
+    buffer[pb.len] = '\0';
 
-  return aux.length;
-}
-
-/* Helper function for vsnprintf(). */
-static void
-vsnprintf_helper (char ch, void *aux_)
-{
-  struct vsnprintf_aux *aux = aux_;
-
-  if (aux->length++ < aux->max_length)
-    *aux->p++ = ch;
+  return pb.char_cnt;
 }
 
 /* Like printf(), except that output is stored into BUFFER,
@@ -140,39 +122,56 @@ static const struct integer_base base_o = {8, "01234567", 0, 3};
 static const struct integer_base base_x = {16, "0123456789abcdef", 'x', 4};
 static const struct integer_base base_X = {16, "0123456789ABCDEF", 'X', 4};
 
+/* "00" through "99", for converting two decimal digits at a
+   time. */
+static const char digit_pairs[201] =
+  "00010203040506070809101112131415161718192021222324252627282930"
+  "31323334353637383940414243444546474849505152535455565758596061"
+  "62636465666768697071727374757677787980818283848586878889909192"
+  "93949596979899";
+
 static const char *parse_conversion (const char *format,
                                      struct printf_conversion *,
                                      va_list *);
 static void format_integer (uintmax_t value, bool is_signed, bool negative, 
                             const struct integer_base *,
                             const struct printf_conversion *,
-                            void (*output) (char, void *), void *aux);
-static void output_dup (char ch, size_t cnt,
-                        void (*output) (char, void *), void *aux);
+                            struct printf_buffer *);
 static void format_string (const char *string, int length,
                            struct printf_conversion *,
-                           void (*output) (char, void *), void *aux);
-
+                           struct printf_buffer *);
+static void emit (struct printf_buffer *, char);
+static void emit_many (struct printf_buffer *, const char *, size_t);
+static void emit_dup (struct printf_buffer *, char, size_t);
+static void bprintf (struct printf_buffer *, const char *format, ...);
+
+/* Formats FORMAT with ARGS into PB, as described for struct
+   printf_buffer.  Runs of literal characters and converted
+   fields are copied into the buffer whole, rather than handed
+   out a character at a time. */
 void
-__vprintf (const char *format, va_list args,
-           void (*output) (char, void *), void *aux)
+__vprintf_buffer (const char *format, va_list args,
+                  struct printf_buffer *pb)
 {
-  for (; *format != '\0'; format++)
+  while (*format != '\0')
     {
       struct printf_conversion c;
+      const char *run;
 
       /* Literally copy non-conversions to output. */
-      if (*format != '%') 
-        {
-          output (*format, aux);
-          continue;
-        }
+      for (run = format; *format != '\0' && *format != '%'; format++)
+        continue;
+      if (format > run)
+        emit_many (pb, run, format - run);
+      if (*format == '\0')
+        break;
       format++;
 
       /* %% => %. */
       if (*format == '%') 
         {
-          output ('%', aux);
+          emit (pb, '%');
+          format++;
           continue;
         }
 
@@ -221,7 +220,7 @@ __vprintf (const char *format, va_list args,
               }
 
             format_integer (value < 0 ? -value : value,
-                            true, value < 0, &base_d, &c, output, aux);
+                            true, value < 0, &base_d, &c, pb);
           }
           break;
           
@@ -276,7 +275,7 @@ __vprintf (const char *format, va_list args,
               default: NOT_REACHED ();
               }
 
-            format_integer (value, false, false, b, &c, output, aux);
+            format_integer (value, false, false, b, &c, pb);
           }
           break;
 
@@ -284,7 +283,7 @@ __vprintf (const char *format, va_list args,
           {
             /* Treat character as single-character string. */
             char ch = va_arg (args, int);
-            format_string (&ch, 1, &c, output, aux);
+            format_string (&ch, 1, &c, pb);
           }
           break;
 
@@ -298,7 +297,7 @@ __vprintf (const char *format, va_list args,
             /* Limit string length according to precision.
                Note: if c.precision == -1 then strnlen() will get
                SIZE_MAX for MAXLEN, which is just what we want. */
-            format_string (s, strnlen (s, c.precision), &c, output, aux);
+            format_string (s, strnlen (s, c.precision), &c, pb);
           }
           break;
           
@@ -310,7 +309,7 @@ __vprintf (const char *format, va_list args,
 
             c.flags = POUND;
             format_integer ((uintptr_t) p, false, false,
-                            &base_x, &c, output, aux);
+                            &base_x, &c, pb);
           }
           break;
       
@@ -322,16 +321,59 @@ __vprintf (const char *format, va_list args,
         case 'n':
           /* We don't support floating-point arithmetic,
              and %n can be part of a security hole. */
-          __printf ("<<no %%%c in kernel>>", output, aux, *format);
+          bprintf (pb, "<<no %%%c in kernel>>", *format);
           break;
 
         default:
-          __printf ("<<no %%%c conversion>>", output, aux, *format);
+          bprintf (pb, "<<no %%%c conversion>>", *format);
           break;
         }
+      format++;
     }
 }
 
+/* Auxiliary data for vprintf_helper(). */
+struct vprintf_aux
+  {
+    void (*output) (char, void *);
+    void *aux;
+  };
+
+/* Hands the characters in PB to the output function in its
+   auxiliary data, one at a time. */
+static void
+vprintf_helper (struct printf_buffer *pb)
+{
+  struct vprintf_aux *aux = pb->aux;
+  size_t i;
+
+  for (i = 0; i < pb->len; i++)
+    aux->output (pb->buf[i], aux->aux);
+  pb->len = 0;
+}
+
+/* Formats FORMAT with ARGS, passing each character of output to
+   OUTPUT along with AUX. */
+void
+__vprintf (const char *format, va_list args,
+           void (*output) (char, void *), void *aux)
+{
+  char buf[64];
+  struct vprintf_aux vaux;
+  struct printf_buffer pb;
+
+  vaux.output = output;
+  vaux.aux = aux;
+  pb.buf = buf;
+  pb.size = sizeof buf;
+  pb.len = 0;
+  pb.char_cnt = 0;
+  pb.flush = vprintf_helper;
+  pb.aux = &vaux;
+  __vprintf_buffer (format, args, &pb);
+  vprintf_helper (&pb);
+}
+
 /* Parses conversion option characters starting at FORMAT and
    initializes C appropriately.  Returns the character in FORMAT
    that indicates the conversion (e.g. the `d' in `%d').  Uses
@@ -459,25 +501,68 @@ parse_conversion (const char *format, struct printf_conversion *c,
   return format;
 }
 
-/* Performs an integer conversion, writing output to OUTPUT with
-   auxiliary data AUX.  The integer converted has absolute value
-   VALUE.  If IS_SIGNED is true, does a signed conversion with
-   NEGATIVE indicating a negative value; otherwise does an
-   unsigned conversion and ignores NEGATIVE.  The output is done
-   according to the provided base B.  Details of the conversion
-   are in C. */
+/* Writes the decimal digits of VALUE, which must be nonzero,
+   backward into the buffer that ends just before END.  Returns
+   the first digit.  This is done a pair of digits at a time,
+   and in 32-bit arithmetic once VALUE fits, because 64-bit
+   division is slow on 80x86 and costs a library call. */
+static char *
+format_decimal (uintmax_t value, char *end)
+{
+  char *cp = end;
+  uint32_t v;
+
+  /* Take nine digits at a time in 64-bit arithmetic, only as
+     long as needed. */
+  while (value > UINT32_MAX)
+    {
+      uintmax_t q = value / 1000000000;
+      uint32_t chunk = value - q * 1000000000;
+      int i;
+
+      for (i = 0; i < 4; i++)
+        {
+          cp -= 2;
+          memcpy (cp, &digit_pairs[chunk % 100 * 2], 2);
+          chunk /= 100;
+        }
+      *--cp = '0' + chunk;
+      value = q;
+    }
+
+  for (v = value; v >= 100; v /= 100)
+    {
+      cp -= 2;
+      memcpy (cp, &digit_pairs[v % 100 * 2], 2);
+    }
+  if (v >= 10)
+    {
+      cp -= 2;
+      memcpy (cp, &digit_pairs[v * 2], 2);
+    }
+  else if (v > 0)
+    *--cp = '0' + v;
+  return cp;
+}
+
+/* Performs an integer conversion, writing output to PB.  The
+   integer converted has absolute value VALUE.  If IS_SIGNED is
+   true, does a signed conversion with NEGATIVE indicating a
+   negative value; otherwise does an unsigned conversion and
+   ignores NEGATIVE.  The output is done according to the
+   provided base B.  Details of the conversion are in C. */
 static void
 format_integer (uintmax_t value, bool is_signed, bool negative, 
                 const struct integer_base *b,
                 const struct printf_conversion *c,
-                void (*output) (char, void *), void *aux)
+                struct printf_buffer *pb)
 {
-  char buf[64], *cp;            /* Buffer and current position. */
+  char buf[64], *cp;            /* Buffer and first digit. */
+  char *end = buf + sizeof buf; /* End of digits. */
   int x;                        /* `x' character to use or 0 if none. */
   int sign;                     /* Sign character or 0 if none. */
   int precision;                /* Rendered precision. */
   int pad_cnt;                  /* # of pad characters to fill field width. */
-  int digit_cnt;                /* # of digits output so far. */
 
   /* Determine sign character, if any.
      An unsigned conversion will never have a sign character,
@@ -498,77 +583,151 @@ format_integer (uintmax_t value, bool is_signed, bool negative,
      nonzero value with the # flag. */
   x = (c->flags & POUND) && value ? b->x : 0;
 
-  /* Accumulate digits into buffer.
-     This algorithm produces digits in reverse order, so later we
-     will output the buffer's content in reverse. */
-  cp = buf;
-  digit_cnt = 0;
-  while (value > 0) 
+  /* Write digits into the end of the buffer, least significant
+     first.  Grouping is rare enough to take a digit at a time;
+     otherwise octal and hexadecimal need only shifts and masks,
+     and decimal has a faster path of its own. */
+  cp = end;
+  if (value == 0)
+    ;
+  else if (c->flags & GROUP)
     {
-      if ((c->flags & GROUP) && digit_cnt > 0 && digit_cnt % b->group == 0)
-        *cp++ = ',';
-      *cp++ = b->digits[value % b->base];
-      value /= b->base;
-      digit_cnt++;
+      int digit_cnt = 0;
+
+      while (value > 0) 
+        {
+          if (digit_cnt > 0 && digit_cnt % b->group == 0)
+            *--cp = ',';
+          *--cp = b->digits[value % b->base];
+          value /= b->base;
+          digit_cnt++;
+        }
+    }
+  else if (b->base == 10)
+    cp = format_decimal (value, end);
+  else
+    {
+      int shift = b->base == 16 ? 4 : 3;
+
+      while (value > 0) 
+        {
+          *--cp = b->digits[value & (b->base - 1)];
+          value >>= shift;
+        }
     }
 
-  /* Append enough zeros to match precision.
+  /* Prepend enough zeros to match precision.
      If requested precision is 0, then a value of zero is
      rendered as a null string, otherwise as "0".
      If the # flag is used with base 8, the result must always
      begin with a zero. */
   precision = c->precision < 0 ? 1 : c->precision;
-  while (cp - buf < precision && cp < buf + sizeof buf - 1)
-    *cp++ = '0';
-  if ((c->flags & POUND) && b->base == 8 && (cp == buf || cp[-1] != '0'))
-    *cp++ = '0';
+  while (end - cp < precision && cp > buf + 1)
+    *--cp = '0';
+  if ((c->flags & POUND) && b->base == 8 && (cp == end || *cp != '0'))
+    *--cp = '0';
 
   /* Calculate number of pad characters to fill field width. */
-  pad_cnt = c->width - (cp - buf) - (x ? 2 : 0) - (sign != 0);
+  pad_cnt = c->width - (end - cp) - (x ? 2 : 0) - (sign != 0);
   if (pad_cnt < 0)
     pad_cnt = 0;
 
   /* Do output. */
   if ((c->flags & (MINUS | ZERO)) == 0)
-    output_dup (' ', pad_cnt, output, aux);
+    emit_dup (pb, ' ', pad_cnt);
   if (sign)
-    output (sign, aux);
+    emit (pb, sign);
   if (x) 
     {
-      output ('0', aux);
-      output (x, aux); 
+      emit (pb, '0');
+      emit (pb, x); 
     }
   if (c->flags & ZERO)
-    output_dup ('0', pad_cnt, output, aux);
-  while (cp > buf)
-    output (*--cp, aux);
+    emit_dup (pb, '0', pad_cnt);
+  emit_many (pb, cp, end - cp);
   if (c->flags & MINUS)
-    output_dup (' ', pad_cnt, output, aux);
-}
-
-/* Writes CH to OUTPUT with auxiliary data AUX, CNT times. */
-static void
-output_dup (char ch, size_t cnt, void (*output) (char, void *), void *aux) 
-{
-  while (cnt-- > 0)
-    output (ch, aux);
+    emit_dup (pb, ' ', pad_cnt);
 }
 
 /* Formats the LENGTH characters starting at STRING according to
-   the conversion specified in C.  Writes output to OUTPUT with
-   auxiliary data AUX. */
+   the conversion specified in C.  Writes output to PB. */
 static void
 format_string (const char *string, int length,
                struct printf_conversion *c,
-               void (*output) (char, void *), void *aux) 
+               struct printf_buffer *pb) 
 {
-  int i;
   if (c->width > length && (c->flags & MINUS) == 0)
-    output_dup (' ', c->width - length, output, aux);
-  for (i = 0; i < length; i++)
-    output (string[i], aux);
+    emit_dup (pb, ' ', c->width - length);
+  emit_many (pb, string, length);
   if (c->width > length && (c->flags & MINUS) != 0)
-    output_dup (' ', c->width - length, output, aux);
+    emit_dup (pb, ' ', c->width - length);
+}
+
+/* Flushes PB if it is full and can be flushed.  Returns the
+   number of characters that now fit in it. */
+static size_t
+make_room (struct printf_buffer *pb)
+{
+  if (pb->len >= pb->size && pb->flush != NULL)
+    pb->flush (pb);
+  return pb->size - pb->len;
+}
+
+/* Writes CH to PB. */
+static void
+emit (struct printf_buffer *pb, char ch)
+{
+  if (make_room (pb) > 0)
+    pb->buf[pb->len++] = ch;
+  pb->char_cnt++;
+}
+
+/* Writes the CNT characters in S to PB. */
+static void
+emit_many (struct printf_buffer *pb, const char *s, size_t cnt)
+{
+  pb->char_cnt += cnt;
+  while (cnt > 0)
+    {
+      size_t n = make_room (pb);
+      if (n == 0)
+        return;
+      if (n > cnt)
+        n = cnt;
+      memcpy (pb->buf + pb->len, s, n);
+      pb->len += n;
+      s += n;
+      cnt -= n;
+    }
+}
+
+/* Writes CH to PB, CNT times. */
+static void
+emit_dup (struct printf_buffer *pb, char ch, size_t cnt) 
+{
+  pb->char_cnt += cnt;
+  while (cnt > 0)
+    {
+      size_t n = make_room (pb);
+      if (n == 0)
+        return;
+      if (n > cnt)
+        n = cnt;
+      memset (pb->buf + pb->len, ch, n);
+      pb->len += n;
+      cnt -= n;
+    }
+}
+
+/* Like printf(), but writes to PB. */
+static void
+bprintf (struct printf_buffer *pb, const char *format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  __vprintf_buffer (format, args, pb);
+  va_end (args);
 }
 
 /* Wrapper for __vprintf() that converts varargs into a
@@ -27,6 +27,24 @@ int puts (const char *);
 void hex_dump (uintptr_t ofs, const void *, size_t size, bool ascii);
 
 /* Internal functions. */
+
+/* A buffer that __vprintf_buffer() formats into directly.  When
+   BUF is full, FLUSH, if nonnull, is called to make room, usually
+   by writing out the LEN characters and setting LEN to 0.
+   Characters that still do not fit are dropped, but counted in
+   CHAR_CNT. */
+struct printf_buffer
+  {
+    char *buf;                  /* Output buffer. */
+    size_t size;                /* Size of BUF. */
+    size_t len;                 /* Characters now in BUF. */
+    int char_cnt;               /* Characters formatted so far. */
+    void (*flush) (struct printf_buffer *);
+    void *aux;                  /* For FLUSH's use. */
+  };
+
+void __vprintf_buffer (const char *format, va_list args,
+                       struct printf_buffer *);
 void __vprintf (const char *format, va_list args,
                 void (*output) (char, void *), void *aux);
 void __printf (const char *format,
@@ -0,0 +1,20 @@
+#ifndef __LIB_SYSCALL_BATCH_H
+#define __LIB_SYSCALL_BATCH_H
+
+#include <stdint.h>
+
+/* One system call queued for submit().  NR is a file system call
+   number from <syscall-nr.h>, ARGS its arguments as for the
+   plain call.  The kernel stores the call's return value in
+   RESULT. */
+struct syscall_entry
+  {
+    int nr;                     /* SYS_READ, SYS_WRITE, ... */
+    int32_t args[4];            /* Arguments. */
+    int32_t result;             /* Return value, set by the kernel. */
+  };
+
+/* Most entries one submit() call accepts. */
+#define SUBMIT_MAX 64
+
+#endif /* lib/syscall-batch.h */
@@ -32,6 +32,35 @@ enum
     
     SYS_SLEEP,
     SYS_PLIST,
+    SYS_PIPE,                   /* Create a pipe. */
+    SYS_READV,                  /* Read into several buffers. */
+    SYS_WRITEV,                 /* Write from several buffers. */
+    SYS_COPY,                   /* Copy between files in the kernel. */
+    SYS_PREAD,                  /* Read from a given file offset. */
+    SYS_PWRITE,                 /* Write at a given file offset. */
+    SYS_SUBMIT,                 /* Run a batch of file calls. */
+    SYS_SPAWN_MANY,             /* Start several processes at once. */
+    SYS_WAIT_ANY,               /* Wait for whichever child dies first. */
+    SYS_FUTEX_WAIT,             /* Wait on a futex. */
+    SYS_FUTEX_WAKE,             /* Wake futex waiters. */
+    SYS_SHM_CREATE,             /* Create a shared memory segment. */
+    SYS_SHM_ATTACH,             /* Attach a shared memory segment. */
+    SYS_SHM_DETACH,             /* Detach a shared memory segment. */
+    SYS_POLL,                   /* Wait for fds to become ready. */
+    SYS_OPEN_FLAGS,             /* Open a file with flags. */
+    SYS_TRACE_DUMP,             /* Print the kernel event trace. */
+    SYS_CLOCK_NS,               /* Nanoseconds since boot. */
+    SYS_DISK_STATS,             /* File system disk counters. */
+    SYS_STATS,                  /* Kernel counters snapshot. */
+    SYS_SBRK,                   /* Move the program break. */
+    SYS_THREAD_CREATE,          /* Start a thread in this process. */
+    SYS_THREAD_JOIN,            /* Wait for a thread to exit. */
+    SYS_THREAD_EXIT,            /* End the calling thread. */
+    SYS_EXEC_STDIO,             /* Start a process with given stdio. */
+    SYS_DUP,                    /* Duplicate a file descriptor. */
+    SYS_DUP2,                   /* Duplicate onto a given fd. */
+    SYS_EXEC_INHERIT,           /* Start a process with the caller's fds. */
+    SYS_WAIT_RUSAGE,            /* Wait, returning the child's usage. */
     SYS_NUMBER_OF_CALLS
   };
 
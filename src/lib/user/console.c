@@ -4,14 +4,16 @@
 #include <syscall-nr.h>
 
 /* The standard vprintf() function,
-   which is like printf() but uses a va_list. */
+   which is like printf() but uses a va_list.  Writes to the
+   stdout stream, so output is buffered a line at a time. */
 int
 vprintf (const char *format, va_list args) 
 {
-  return vhprintf (STDOUT_FILENO, format, args);
+  return vfprintf (stdout, format, args);
 }
 
-/* Like printf(), but writes output to the given HANDLE. */
+/* Like printf(), but writes output to the given HANDLE, without
+   buffering. */
 int
 hprintf (int handle, const char *format, ...) 
 {
@@ -30,7 +32,7 @@ hprintf (int handle, const char *format, ...)
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
+  fputs (s, stdout);
   putchar ('\n');
 
   return 0;
@@ -40,22 +42,11 @@ puts (const char *s)
 int
 putchar (int c) 
 {
-  char c2 = c;
-  write (STDOUT_FILENO, &c2, 1);
+  fputc (c, stdout);
   return c;
 }
 
-/* Auxiliary data for vhprintf_helper(). */
-struct vhprintf_aux 
-  {
-    char buf[64];       /* Character buffer. */
-    char *p;            /* Current position in buffer. */
-    int char_cnt;       /* Total characters written so far. */
-    int handle;         /* Output file handle. */
-  };
-
-static void add_char (char, void *);
-static void flush (struct vhprintf_aux *);
+static void flush (struct printf_buffer *);
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
@@ -63,32 +54,28 @@ static void flush (struct vhprintf_aux *);
 int
 vhprintf (int handle, const char *format, va_list args) 
 {
-  struct vhprintf_aux aux;
-  aux.p = aux.buf;
-  aux.char_cnt = 0;
-  aux.handle = handle;
-  __vprintf (format, args, add_char, &aux);
-  flush (&aux);
-  return aux.char_cnt;
-}
+  char buf[64];
+  struct printf_buffer pb;
 
-/* Adds C to the buffer in AUX, flushing it if the buffer fills
-   up. */
-static void
-add_char (char c, void *aux_) 
-{
-  struct vhprintf_aux *aux = aux_;
-  *aux->p++ = c;
-  if (aux->p >= aux->buf + sizeof aux->buf)
-    flush (aux);
-  aux->char_cnt++;
+  pb.buf = buf;
+  pb.size = sizeof buf;
+  pb.len = 0;
+  pb.char_cnt = 0;
+  pb.flush = flush;
+  pb.aux = &handle;
+  __vprintf_buffer (format, args, &pb);
+  flush (&pb);
+  return pb.char_cnt;
 }
 
-/* Flushes the buffer in AUX. */
+/* Writes the characters in PB to the handle in its auxiliary
+   data. */
 static void
-flush (struct vhprintf_aux *aux)
+flush (struct printf_buffer *pb)
 {
-  if (aux->p > aux->buf)
-    write (aux->handle, aux->buf, aux->p - aux->buf);
-  aux->p = aux->buf;
+  int *handle = pb->aux;
+
+  if (pb->len > 0)
+    write (*handle, pb->buf, pb->len);
+  pb->len = 0;
 }
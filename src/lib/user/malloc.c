@@ -0,0 +1,330 @@
+#include <malloc.h>
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* User memory allocator, on top of the heap that sbrk() grows.
+
+   Blocks of up to SMALL_MAX bytes are rounded up to one of a few
+   size classes.  Each class has a free list of blocks of its
+   size, refilled a page at a time: such a page, a "run", starts
+   with a header that names its class, and the rest is cut into
+   blocks.  malloc() and free() of a small block only pop or push
+   the class's free list, so the kernel is entered just when a
+   class runs dry.  Runs are never taken apart again.
+
+   Bigger blocks get whole pages of their own, also starting with
+   a header, that records the page count.  Freed pages go to a
+   list of free spans in address order, coalesced with their
+   neighbors, from which both big blocks and new runs are taken
+   first-fit.  A span that ends at the program break is given
+   back to the kernel.
+
+   Either way, the header of a block is at the start of the page
+   that holds the block's first byte.
+
+   A Pintos process has only one thread, so the free lists serve
+   as its thread cache and no locking is needed. */
+
+/* Page size, as in the kernel. */
+#define PAGE_SIZE 4096
+
+/* Identifies a page header. */
+#define PAGE_MAGIC 0x9a548eed
+
+/* Header at the start of a run or a big block. */
+struct page_hdr
+  {
+    unsigned magic;             /* PAGE_MAGIC. */
+    int class;                  /* Size class, or -1 for a big block. */
+    size_t page_cnt;            /* Pages in a big block. */
+    unsigned pad;               /* Keeps blocks 16-byte aligned. */
+  };
+
+/* Free pages, at the start of the span. */
+struct span
+  {
+    struct span *next;          /* Next span, at a higher address. */
+    size_t page_cnt;            /* Number of pages. */
+  };
+
+/* A free small block. */
+struct free_block
+  {
+    struct free_block *next;
+  };
+
+/* Size classes, in bytes.  Each is a multiple of 16, and each
+   fills a run with as little waste as possible. */
+static const size_t class_sizes[] =
+  {
+    16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256,
+    320, 384, 448, 512, 672, 1008, 1360, 2032,
+  };
+#define CLASS_CNT (sizeof class_sizes / sizeof *class_sizes)
+#define SMALL_MAX 2032
+
+/* Size class for each size up to SMALL_MAX, indexed by the size
+   in 16-byte units, rounded up.  Filled in on first use. */
+static unsigned char size_to_class[SMALL_MAX / 16 + 1];
+static bool inited;
+
+static struct free_block *free_lists[CLASS_CNT];
+static struct span *free_spans;
+
+/* Returns the header of the page holding P. */
+static struct page_hdr *
+page_of (const void *p)
+{
+  return (struct page_hdr *) ((uintptr_t) p & ~(uintptr_t) (PAGE_SIZE - 1));
+}
+
+/* Fills in size_to_class. */
+static void
+init (void)
+{
+  size_t units, c = 0;
+
+  for (units = 0; units <= SMALL_MAX / 16; units++)
+    {
+      while (class_sizes[c] < units * 16)
+        c++;
+      size_to_class[units] = c;
+    }
+  inited = true;
+}
+
+/* Returns CNT contiguous free pages, taken from the free spans
+   or by moving the program break, or a null pointer if memory
+   is short. */
+static void *
+get_pages (size_t cnt)
+{
+  struct span **sp;
+  uint8_t *brk;
+  size_t pad;
+
+  for (sp = &free_spans; *sp != NULL; sp = &(*sp)->next)
+    {
+      struct span *s = *sp;
+      if (s->page_cnt == cnt)
+        {
+          *sp = s->next;
+          return s;
+        }
+      else if (s->page_cnt > cnt)
+        {
+          /* Take the tail, leaving the span where it is. */
+          s->page_cnt -= cnt;
+          return (uint8_t *) s + s->page_cnt * PAGE_SIZE;
+        }
+    }
+
+  /* Someone else may have left the break unaligned. */
+  if (cnt > (SIZE_MAX - PAGE_SIZE) / PAGE_SIZE)
+    return NULL;
+  brk = sbrk (0);
+  pad = -(uintptr_t) brk & (PAGE_SIZE - 1);
+  if (sbrk (pad + cnt * PAGE_SIZE) == (void *) -1)
+    return NULL;
+  return brk + pad;
+}
+
+/* Returns the end of span S. */
+static uint8_t *
+span_end (const struct span *s)
+{
+  return (uint8_t *) s + s->page_cnt * PAGE_SIZE;
+}
+
+/* Frees the CNT pages at PAGES. */
+static void
+put_pages (void *pages, size_t cnt)
+{
+  struct span *s = pages;
+  struct span **link, **prev_link = NULL;
+
+  /* Insert S in address order. */
+  for (link = &free_spans; *link != NULL && *link < s;
+       link = &(*link)->next)
+    prev_link = link;
+  s->page_cnt = cnt;
+  s->next = *link;
+  *link = s;
+
+  /* Merge it with the spans after and before it, if they touch. */
+  if (s->next != NULL && span_end (s) == (uint8_t *) s->next)
+    {
+      s->page_cnt += s->next->page_cnt;
+      s->next = s->next->next;
+    }
+  if (prev_link != NULL && span_end (*prev_link) == (uint8_t *) s)
+    {
+      struct span *prev = *prev_link;
+      prev->page_cnt += s->page_cnt;
+      prev->next = s->next;
+      s = prev;
+      link = prev_link;
+    }
+
+  /* Give back a span at the top of the heap. */
+  if (s->next == NULL && span_end (s) == sbrk (0)
+      && sbrk (-(intptr_t) (s->page_cnt * PAGE_SIZE)) != (void *) -1)
+    *link = NULL;
+}
+
+/* Carves a new run for size class C onto its free list.
+   Returns false if memory is short. */
+static bool
+refill (int c)
+{
+  size_t size = class_sizes[c];
+  struct page_hdr *h = get_pages (1);
+  uint8_t *b;
+
+  if (h == NULL)
+    return false;
+  h->magic = PAGE_MAGIC;
+  h->class = c;
+  h->page_cnt = 1;
+  for (b = (uint8_t *) (h + 1); b + size <= (uint8_t *) h + PAGE_SIZE;
+       b += size)
+    {
+      struct free_block *fb = (struct free_block *) b;
+      fb->next = free_lists[c];
+      free_lists[c] = fb;
+    }
+  return true;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if memory is not available. */
+void *
+malloc (size_t size)
+{
+  if (size == 0)
+    return NULL;
+  if (!inited)
+    init ();
+
+  if (size <= SMALL_MAX)
+    {
+      int c = size_to_class[(size + 15) / 16];
+      struct free_block *b;
+
+      if (free_lists[c] == NULL && !refill (c))
+        return NULL;
+      b = free_lists[c];
+      free_lists[c] = b->next;
+      return b;
+    }
+  else
+    {
+      size_t page_cnt;
+      struct page_hdr *h;
+
+      if (size > SIZE_MAX - sizeof *h - PAGE_SIZE)
+        return NULL;
+      page_cnt = (size + sizeof *h + PAGE_SIZE - 1) / PAGE_SIZE;
+      h = get_pages (page_cnt);
+      if (h == NULL)
+        return NULL;
+      h->magic = PAGE_MAGIC;
+      h->class = -1;
+      h->page_cnt = page_cnt;
+      return h + 1;
+    }
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  if (b != 0 && a > SIZE_MAX / b)
+    return NULL;
+  size = a * b;
+
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+  return p;
+}
+
+/* Returns the number of bytes the block at P can hold. */
+static size_t
+block_size (const void *p)
+{
+  const struct page_hdr *h = page_of (p);
+
+  ASSERT (h->magic == PAGE_MAGIC);
+  return (h->class >= 0
+          ? class_sizes[h->class]
+          : h->page_cnt * PAGE_SIZE - sizeof *h);
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  size_t old_size;
+  void *new_block;
+
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  if (old_block == NULL)
+    return malloc (new_size);
+
+  old_size = block_size (old_block);
+  if (new_size <= old_size
+      && (new_size > SMALL_MAX || old_size <= SMALL_MAX))
+    return old_block;
+
+  new_block = malloc (new_size);
+  if (new_block != NULL)
+    {
+      memcpy (new_block, old_block,
+              old_size < new_size ? old_size : new_size);
+      free (old_block);
+    }
+  return new_block;
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct page_hdr *h;
+
+  if (p == NULL)
+    return;
+  h = page_of (p);
+  ASSERT (h->magic == PAGE_MAGIC);
+
+  if (h->class >= 0)
+    {
+      struct free_block *b = p;
+      b->next = free_lists[h->class];
+      free_lists[h->class] = b;
+    }
+  else
+    {
+      ASSERT (p == h + 1);
+      h->magic = 0;
+      put_pages (h, h->page_cnt);
+    }
+}
@@ -4,4 +4,42 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffered streams. */
+typedef struct stream FILE;
+
+/* Buffering modes, for setvbuf(). */
+#define _IOFBF 0                /* Flush when the buffer fills. */
+#define _IOLBF 1                /* Also flush after each new-line. */
+#define _IONBF 2                /* No buffer. */
+
+/* Default buffer size. */
+#define BUFSIZ 1024
+
+/* Returned by the character functions at end of file or on error. */
+#define EOF (-1)
+
+/* Standard input, line-buffered standard output. */
+extern FILE *stdin;
+extern FILE *stdout;
+
+FILE *fdopen (int fd, const char *mode);
+FILE *fopen (const char *name, const char *mode);
+int fclose (FILE *);
+int fflush (FILE *);
+int setvbuf (FILE *, char *buf, int mode, size_t size);
+int fileno (FILE *);
+int feof (FILE *);
+int ferror (FILE *);
+
+size_t fread (void *, size_t size, size_t cnt, FILE *);
+int fgetc (FILE *);
+char *fgets (char *, int size, FILE *);
+int getline (char **, size_t *, FILE *);
+
+size_t fwrite (const void *, size_t size, size_t cnt, FILE *);
+int fputc (int, FILE *);
+int fputs (const char *, FILE *);
+int fprintf (FILE *, const char *, ...) PRINTF_FORMAT (2, 3);
+int vfprintf (FILE *, const char *, va_list) PRINTF_FORMAT (2, 0);
+
 #endif /* lib/user/stdio.h */
@@ -0,0 +1,504 @@
+#include <stdio.h>
+#include <malloc.h>
+#include <string.h>
+#include <syscall.h>
+
+/* Buffered streams over file descriptors.
+
+   A stream either reads or writes, as chosen when it is opened.
+   A reading stream fills its buffer with one read() and hands
+   out bytes from it; a writing stream collects bytes and writes
+   them out with one write() when the buffer fills, after each
+   new-line if line-buffered, or on fflush().  Requests at least
+   as big as the buffer bypass it.
+
+   stdin and stdout exist from the start.  stdout is
+   line-buffered, and so that output still appears in the order
+   it was produced, it is also flushed before any write() to
+   STDOUT_FILENO, any read() from STDIN_FILENO, and at exit().
+   Output still in a buffer is lost if the kernel kills the
+   process. */
+
+struct stream
+  {
+    int fd;                     /* File descriptor. */
+    bool writing;               /* Writes, rather than reads? */
+    int mode;                   /* _IOFBF, _IOLBF or _IONBF. */
+    char *buf;                  /* Buffer, null until first use. */
+    size_t size;                /* Size of BUF. */
+    bool own_buf;               /* BUF from malloc(), ours to free? */
+    size_t pos;                 /* Reading: next byte in BUF. */
+    size_t len;                 /* Bytes in BUF: unread or unwritten. */
+    bool eof;                   /* Reading: hit end of file? */
+    bool error;                 /* An I/O error happened? */
+    struct stream *next;        /* Next in OPEN_STREAMS. */
+  };
+
+static char stdin_buf[BUFSIZ], stdout_buf[BUFSIZ];
+static struct stream stdin_stream =
+  { STDIN_FILENO, false, _IOFBF, stdin_buf, BUFSIZ, false, 0, 0,
+    false, false, NULL };
+static struct stream stdout_stream =
+  { STDOUT_FILENO, true, _IOLBF, stdout_buf, BUFSIZ, false, 0, 0,
+    false, false, &stdin_stream };
+
+FILE *stdin = &stdin_stream;
+FILE *stdout = &stdout_stream;
+
+/* All open streams, for fflush (NULL). */
+static struct stream *open_streams = &stdout_stream;
+
+/* Returns a new stream for FD, which writes if MODE starts with
+   'w' or 'a' and reads otherwise, or a null pointer if memory is
+   short.  FD is closed by fclose(). */
+FILE *
+fdopen (int fd, const char *mode)
+{
+  struct stream *s;
+
+  if (fd < 0)
+    return NULL;
+  s = calloc (1, sizeof *s);
+  if (s == NULL)
+    return NULL;
+  s->fd = fd;
+  s->writing = mode[0] == 'w' || mode[0] == 'a';
+  s->mode = _IOFBF;
+  s->size = BUFSIZ;
+  s->own_buf = true;
+  s->next = open_streams;
+  open_streams = s;
+  return s;
+}
+
+/* Opens the file called NAME as a stream.  MODE "r" reads it.
+   MODE "w" writes it, replacing any file of that name with an
+   empty one.  MODE "a" writes it from the end, creating it if
+   needed.  Returns a null pointer on failure. */
+FILE *
+fopen (const char *name, const char *mode)
+{
+  FILE *s;
+  int fd;
+
+  if (mode[0] == 'w')
+    {
+      remove (name);
+      create (name, 0);
+    }
+  else if (mode[0] == 'a')
+    create (name, 0);
+  fd = open (name);
+  if (fd < 0)
+    return NULL;
+  if (mode[0] == 'a')
+    seek (fd, filesize (fd));
+
+  s = fdopen (fd, mode);
+  if (s == NULL)
+    close (fd);
+  return s;
+}
+
+/* Writes out the bytes in writing stream S's buffer.  The buffer
+   is emptied first, so that the write() wrapper, flushing
+   stdout, finds nothing left to write.  Returns 0 if successful,
+   EOF on error. */
+static int
+flush_buffer (struct stream *s)
+{
+  size_t len = s->len;
+
+  s->len = 0;
+  if (len > 0 && write (s->fd, s->buf, len) != (int) len)
+    {
+      s->error = true;
+      return EOF;
+    }
+  return 0;
+}
+
+/* Writes out any buffered output of S, or of every open stream
+   if S is null.  For a reading stream, does nothing.  Returns 0
+   if successful, EOF on error. */
+int
+fflush (FILE *s)
+{
+  int result = 0;
+
+  if (s == NULL)
+    {
+      for (s = open_streams; s != NULL; s = s->next)
+        if (fflush (s) != 0)
+          result = EOF;
+      return result;
+    }
+  return s->writing ? flush_buffer (s) : 0;
+}
+
+/* Flushes and closes S and its file descriptor.  Returns 0 if
+   successful, EOF if the flush failed. */
+int
+fclose (FILE *s)
+{
+  struct stream **sp;
+  int result = fflush (s);
+
+  for (sp = &open_streams; *sp != NULL; sp = &(*sp)->next)
+    if (*sp == s)
+      {
+        *sp = s->next;
+        break;
+      }
+  close (s->fd);
+  if (s->own_buf)
+    free (s->buf);
+  if (s != &stdin_stream && s != &stdout_stream)
+    free (s);
+  return result;
+}
+
+/* Sets S to buffering MODE with a SIZE-byte buffer: BUF if it is
+   nonnull, which must then outlive S, or else one from malloc().
+   Must be called before S is first read or written.  Returns 0
+   if successful, EOF if MODE or SIZE is invalid. */
+int
+setvbuf (FILE *s, char *buf, int mode, size_t size)
+{
+  if (mode != _IOFBF && mode != _IOLBF && mode != _IONBF)
+    return EOF;
+  if (mode != _IONBF && size == 0)
+    return EOF;
+  if (fflush (s) != 0)
+    return EOF;
+  if (s->own_buf)
+    free (s->buf);
+  s->mode = mode;
+  s->buf = buf;
+  s->size = mode == _IONBF ? 0 : size;
+  s->own_buf = buf == NULL;
+  s->pos = s->len = 0;
+  return 0;
+}
+
+/* Returns the file descriptor of S. */
+int
+fileno (FILE *s)
+{
+  return s->fd;
+}
+
+/* Returns nonzero if reading S has reached end of file. */
+int
+feof (FILE *s)
+{
+  return s->eof;
+}
+
+/* Returns nonzero if an I/O error has happened on S. */
+int
+ferror (FILE *s)
+{
+  return s->error;
+}
+
+/* Makes sure S has a buffer, unless it is unbuffered.  Returns
+   false if memory is short, in which case S becomes
+   unbuffered. */
+static bool
+get_buffer (struct stream *s)
+{
+  if (s->buf == NULL && s->size > 0)
+    {
+      s->buf = malloc (s->size);
+      if (s->buf == NULL)
+        {
+          s->mode = _IONBF;
+          s->size = 0;
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Reads up to SIZE bytes from S's file into BUF, recording end of
+   file and errors.  Returns the number of bytes read. */
+static size_t
+read_fd (struct stream *s, void *buf, size_t size)
+{
+  int n = read (s->fd, buf, size);
+
+  if (n <= 0)
+    {
+      if (n < 0)
+        s->error = true;
+      else
+        s->eof = true;
+      return 0;
+    }
+  return n;
+}
+
+/* Refills reading stream S's empty buffer.  Returns false at end
+   of file or on error. */
+static bool
+fill_buffer (struct stream *s)
+{
+  if (!s->writing && get_buffer (s) && s->size > 0)
+    {
+      s->pos = 0;
+      s->len = read_fd (s, s->buf, s->size);
+      return s->len > 0;
+    }
+  return false;
+}
+
+/* Reads up to CNT elements of SIZE bytes each from S into BUF.
+   Returns the number of whole elements read. */
+size_t
+fread (void *buf_, size_t size, size_t cnt, FILE *s)
+{
+  char *buf = buf_;
+  size_t total = size * cnt;
+  size_t done = 0;
+
+  if (s->writing || total == 0)
+    return 0;
+
+  while (done < total)
+    {
+      size_t n;
+
+      if (s->pos < s->len)
+        {
+          n = s->len - s->pos;
+          if (n > total - done)
+            n = total - done;
+          memcpy (buf + done, s->buf + s->pos, n);
+          s->pos += n;
+        }
+      else if (total - done >= s->size || !get_buffer (s) || s->size == 0)
+        {
+          /* Too big to be worth buffering. */
+          n = read_fd (s, buf + done, total - done);
+          if (n == 0)
+            break;
+        }
+      else if (!fill_buffer (s))
+        break;
+      else
+        continue;
+      done += n;
+    }
+  return done / size;
+}
+
+/* Reads one character from S and returns it, or EOF at end of
+   file or on error. */
+int
+fgetc (FILE *s)
+{
+  unsigned char c;
+
+  if (s->pos < s->len)
+    return (unsigned char) s->buf[s->pos++];
+  return fread (&c, 1, 1, s) == 1 ? c : EOF;
+}
+
+/* Reads a line of at most SIZE - 1 characters from S into BUF,
+   including the new-line if it fits, and null-terminates it.
+   Returns BUF, or a null pointer if nothing was read before end
+   of file or an error. */
+char *
+fgets (char *buf, int size, FILE *s)
+{
+  int i = 0;
+
+  if (size <= 0)
+    return NULL;
+  while (i < size - 1)
+    {
+      int c = fgetc (s);
+      if (c == EOF)
+        break;
+      buf[i++] = c;
+      if (c == '\n')
+        break;
+    }
+  buf[i] = '\0';
+  return i > 0 ? buf : NULL;
+}
+
+/* Reads a whole line from S, including its new-line if it has
+   one, into *LINEP, null-terminated.  *LINEP is a buffer of *SIZEP
+   bytes from malloc(), or null, and is grown with realloc() as
+   needed, updating *LINEP and *SIZEP.  The line is copied out of
+   S's buffer a chunk at a time; for stdin, whose terminal hands
+   out one line per read(), that means one system call per line.
+   Returns the length of the line, or -1 if nothing was read before
+   end of file or an error or if memory is short. */
+int
+getline (char **linep, size_t *sizep, FILE *s)
+{
+  size_t len = 0;
+
+  if (s->writing)
+    return -1;
+  for (;;)
+    {
+      const char *chunk, *nl;
+      size_t n;
+      char c;
+
+      if (s->pos < s->len)
+        {
+          chunk = s->buf + s->pos;
+          nl = memchr (chunk, '\n', s->len - s->pos);
+          n = nl != NULL ? (size_t) (nl - chunk) + 1 : s->len - s->pos;
+        }
+      else if (get_buffer (s) && s->size > 0)
+        {
+          if (!fill_buffer (s))
+            break;
+          continue;
+        }
+      else
+        {
+          /* Unbuffered: a byte at a time. */
+          if (read_fd (s, &c, 1) == 0)
+            break;
+          chunk = &c;
+          nl = c == '\n' ? chunk : NULL;
+          n = 1;
+        }
+
+      if (len + n + 1 > *sizep || *linep == NULL)
+        {
+          size_t size = *sizep > 0 ? *sizep : 64;
+          char *p;
+
+          while (size < len + n + 1)
+            size *= 2;
+          p = realloc (*linep, size);
+          if (p == NULL)
+            return -1;
+          *linep = p;
+          *sizep = size;
+        }
+      memcpy (*linep + len, chunk, n);
+      len += n;
+      if (chunk != &c)
+        s->pos += n;
+      if (nl != NULL)
+        break;
+    }
+  if (len == 0)
+    return -1;
+  (*linep)[len] = '\0';
+  return len;
+}
+
+/* Writes CNT elements of SIZE bytes each from BUF to S.  Returns
+   the number of whole elements written. */
+size_t
+fwrite (const void *buf_, size_t size, size_t cnt, FILE *s)
+{
+  const char *buf = buf_;
+  size_t total = size * cnt;
+
+  if (!s->writing || total == 0)
+    return 0;
+  get_buffer (s);
+
+  if (total >= s->size - s->len)
+    {
+      /* Doesn't fit: write out the buffer, then write directly
+         if the data would fill the buffer again anyway. */
+      if (flush_buffer (s) != 0)
+        return 0;
+      if (total >= s->size)
+        {
+          int n = write (s->fd, buf, total);
+          if (n != (int) total)
+            {
+              s->error = true;
+              return n > 0 ? n / size : 0;
+            }
+          return cnt;
+        }
+    }
+
+  memcpy (s->buf + s->len, buf, total);
+  s->len += total;
+  if (s->mode == _IOLBF && memchr (buf, '\n', total) != NULL
+      && flush_buffer (s) != 0)
+    return 0;
+  return cnt;
+}
+
+/* Writes character C to S.  Returns C, or EOF on error. */
+int
+fputc (int c, FILE *s)
+{
+  char ch = c;
+
+  if (s->writing && s->buf != NULL && s->len + 1 < s->size && c != '\n')
+    {
+      s->buf[s->len++] = ch;
+      return (unsigned char) ch;
+    }
+  return fwrite (&ch, 1, 1, s) == 1 ? (unsigned char) ch : EOF;
+}
+
+/* Writes string STR, without a new-line, to S.  Returns a
+   nonnegative number if successful, EOF on error. */
+int
+fputs (const char *str, FILE *s)
+{
+  size_t len = strlen (str);
+
+  return len == 0 || fwrite (str, len, 1, s) == 1 ? 0 : EOF;
+}
+
+/* Writes the characters in PB to the stream in its auxiliary
+   data, for vfprintf(). */
+static void
+vfprintf_helper (struct printf_buffer *pb)
+{
+  if (pb->len > 0)
+    fwrite (pb->buf, 1, pb->len, pb->aux);
+  pb->len = 0;
+}
+
+/* Like printf(), but writes to stream S. */
+int
+fprintf (FILE *s, const char *format, ...)
+{
+  va_list args;
+  int retval;
+
+  va_start (args, format);
+  retval = vfprintf (s, format, args);
+  va_end (args);
+
+  return retval;
+}
+
+/* Like vprintf(), but writes to stream S.  Returns the number of
+   characters formatted. */
+int
+vfprintf (FILE *s, const char *format, va_list args)
+{
+  char buf[128];
+  struct printf_buffer pb;
+
+  pb.buf = buf;
+  pb.size = sizeof buf;
+  pb.len = 0;
+  pb.char_cnt = 0;
+  pb.flush = vfprintf_helper;
+  pb.aux = s;
+  __vprintf_buffer (format, args, &pb);
+  vfprintf_helper (&pb);
+  return pb.char_cnt;
+}
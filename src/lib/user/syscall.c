@@ -1,9 +1,109 @@
 #include <syscall.h>
+#include <div64.h>
+#include <kinfo.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
-/* Invokes syscall NUMBER, passing no arguments, and returns the
-   return value as an `int'. */
-#define syscall0(NUMBER)                                        \
+/* System calls.
+
+   Each system call is made with "int $0x30", with the call number
+   and arguments pushed on the stack, or, on CPUs that have it,
+   with the faster SYSENTER, with them in registers: the number in
+   EAX, up to three arguments in EBX, ESI and EDI, and a fourth
+   one, which only a few calls take, pushed on the stack.  SYSENTER
+   saves nothing, so the stack pointer goes in ECX and the return
+   address in EDX, which the kernel's SYSEXIT returns to.  EBP is
+   left alone, since this file keeps frame pointers for
+   backtraces.  See userprog/syscall-entry.S. */
+
+/* Use SYSENTER?  Set by syscall_setup(). */
+static bool use_sysenter;
+
+/* EFLAGS bit that can be toggled only if CPUID exists. */
+#define FLAG_ID 0x00200000
+
+/* CPUID function 1 EDX bit for SYSENTER and SYSEXIT. */
+#define CPUID_SEP (1u << 11)
+
+/* Decides how to make system calls, the same way as the kernel
+   decides whether to accept SYSENTER: CPUID must report it, on a
+   CPU other than the Pentium Pro, which reports it falsely.
+   Called by _start() before anything else. */
+void
+syscall_setup (void)
+{
+  uint32_t flags, toggled, eax, ebx, ecx, edx;
+  int family, model, stepping;
+
+  asm volatile ("pushfl; popl %0; movl %0, %1; xorl %2, %1; "
+                "pushl %1; popfl; pushfl; popl %1; pushl %0; popfl"
+                : "=&r" (flags), "=&r" (toggled) : "i" (FLAG_ID));
+  if (((flags ^ toggled) & FLAG_ID) == 0)
+    return;
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  use_sysenter = ((edx & CPUID_SEP) != 0
+                  && !(family == 6 && model < 3 && stepping < 3));
+}
+
+/* Invokes syscall NUMBER with SYSENTER, passing arguments ARG0,
+   ARG1 and ARG2, and returns the return value as an `int'. */
+#define sysenter3(NUMBER, ARG0, ARG1, ARG2)                     \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("movl %%esp, %%ecx; movl $1f, %%edx; sysenter; 1:" \
+               : "=a" (retval)                                  \
+               : "a" (NUMBER),                                  \
+                 "b" ((int) (ARG0)),                            \
+                 "S" ((int) (ARG1)),                            \
+                 "D" ((int) (ARG2))                             \
+               : "ecx", "edx", "memory", "cc");                 \
+          retval;                                               \
+        })
+
+/* Invokes syscall NUMBER with SYSENTER, passing arguments ARG0,
+   ARG1, ARG2 and ARG3, and returns the return value as an
+   `int'. */
+#define sysenter4(NUMBER, ARG0, ARG1, ARG2, ARG3)               \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; movl %%esp, %%ecx; "               \
+             "movl $1f, %%edx; sysenter; 1: addl $4, %%esp"     \
+               : "=a" (retval)                                  \
+               : "a" (NUMBER),                                  \
+                 "b" ((int) (ARG0)),                            \
+                 "S" ((int) (ARG1)),                            \
+                 "D" ((int) (ARG2)),                            \
+                 [arg3] "g" (ARG3)                              \
+               : "ecx", "edx", "memory", "cc");                 \
+          retval;                                               \
+        })
+
+#define syscall0(NUMBER)                                                \
+        (use_sysenter ? sysenter3 (NUMBER, 0, 0, 0)                     \
+         : int_syscall0 (NUMBER))
+#define syscall1(NUMBER, ARG0)                                          \
+        (use_sysenter ? sysenter3 (NUMBER, ARG0, 0, 0)                  \
+         : int_syscall1 (NUMBER, ARG0))
+#define syscall2(NUMBER, ARG0, ARG1)                                    \
+        (use_sysenter ? sysenter3 (NUMBER, ARG0, ARG1, 0)               \
+         : int_syscall2 (NUMBER, ARG0, ARG1))
+#define syscall3(NUMBER, ARG0, ARG1, ARG2)                              \
+        (use_sysenter ? sysenter3 (NUMBER, ARG0, ARG1, ARG2)            \
+         : int_syscall3 (NUMBER, ARG0, ARG1, ARG2))
+#define syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                        \
+        (use_sysenter ? sysenter4 (NUMBER, ARG0, ARG1, ARG2, ARG3)      \
+         : int_syscall4 (NUMBER, ARG0, ARG1, ARG2, ARG3))
+
+/* Invokes syscall NUMBER with "int $0x30", passing no arguments,
+   and returns the return value as an `int'. */
+#define int_syscall0(NUMBER)                                        \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -14,9 +114,9 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing argument ARG0, and returns the
-   return value as an `int'. */
-#define syscall1(NUMBER, ARG0)                                           \
+/* Invokes syscall NUMBER with "int $0x30", passing argument ARG0,
+   and returns the return value as an `int'. */
+#define int_syscall1(NUMBER, ARG0)                                           \
         ({                                                               \
           int retval;                                                    \
           asm volatile                                                   \
@@ -28,9 +128,9 @@
           retval;                                                        \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0 and ARG1, and
-   returns the return value as an `int'. */
-#define syscall2(NUMBER, ARG0, ARG1)                            \
+/* Invokes syscall NUMBER with "int $0x30", passing arguments ARG0
+   and ARG1, and returns the return value as an `int'. */
+#define int_syscall2(NUMBER, ARG0, ARG1)                            \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -44,9 +144,10 @@
           retval;                                               \
         })
 
-/* Invokes syscall NUMBER, passing arguments ARG0, ARG1, and
-   ARG2, and returns the return value as an `int'. */
-#define syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
+/* Invokes syscall NUMBER with "int $0x30", passing arguments
+   ARG0, ARG1, and ARG2, and returns the return value as an
+   `int'. */
+#define int_syscall3(NUMBER, ARG0, ARG1, ARG2)                      \
         ({                                                      \
           int retval;                                           \
           asm volatile                                          \
@@ -61,9 +162,30 @@
           retval;                                               \
         })
 
+/* Invokes syscall NUMBER with "int $0x30", passing arguments
+   ARG0, ARG1, ARG2, and ARG3, and returns the return value as an
+   `int'. */
+#define int_syscall4(NUMBER, ARG0, ARG1, ARG2, ARG3)                \
+        ({                                                      \
+          int retval;                                           \
+          asm volatile                                          \
+            ("pushl %[arg3]; pushl %[arg2]; pushl %[arg1]; "    \
+             "pushl %[arg0]; pushl %[number]; int $0x30; "      \
+             "addl $20, %%esp"                                  \
+               : "=a" (retval)                                  \
+               : [number] "i" (NUMBER),                         \
+                 [arg0] "g" (ARG0),                             \
+                 [arg1] "g" (ARG1),                             \
+                 [arg2] "g" (ARG2),                             \
+                 [arg3] "g" (ARG3)                              \
+               : "memory");                                     \
+          retval;                                               \
+        })
+
 void
 halt (void) 
 {
+  fflush (NULL);
   syscall0 (SYS_HALT);
   NOT_REACHED ();
 }
@@ -71,6 +193,7 @@ halt (void)
 void
 exit (int status)
 {
+  fflush (NULL);
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -114,12 +237,18 @@ filesize (int fd)
 int
 read (int fd, void *buffer, unsigned size)
 {
+  /* Let a prompt appear before waiting for the answer. */
+  if (fd == STDIN_FILENO)
+    fflush (stdout);
   return syscall3 (SYS_READ, fd, buffer, size);
 }
 
 int
 write (int fd, const void *buffer, unsigned size)
 {
+  /* Keep output written directly in order with buffered output. */
+  if (fd == STDOUT_FILENO)
+    fflush (stdout);
   return syscall3 (SYS_WRITE, fd, buffer, size);
 }
 
@@ -194,3 +323,250 @@ plist(void)
 {
   return syscall0 (SYS_PLIST);
 }
+
+bool
+pipe (int fds[2])
+{
+  return syscall1 (SYS_PIPE, fds);
+}
+
+int
+readv (int fd, const struct iovec *iov, int iovcnt)
+{
+  return syscall3 (SYS_READV, fd, iov, iovcnt);
+}
+
+int
+writev (int fd, const struct iovec *iov, int iovcnt)
+{
+  if (fd == STDOUT_FILENO)
+    fflush (stdout);
+  return syscall3 (SYS_WRITEV, fd, iov, iovcnt);
+}
+
+int
+copy (int in_fd, int out_fd, unsigned size)
+{
+  return syscall3 (SYS_COPY, in_fd, out_fd, size);
+}
+
+int
+pread (int fd, void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PREAD, fd, buffer, size, offset);
+}
+
+int
+pwrite (int fd, const void *buffer, unsigned size, unsigned offset)
+{
+  return syscall4 (SYS_PWRITE, fd, buffer, size, offset);
+}
+
+int
+submit (struct syscall_entry *entries, int cnt)
+{
+  return syscall2 (SYS_SUBMIT, entries, cnt);
+}
+
+int
+spawn_many (const char *const *cmd_lines, int cnt, pid_t *pids)
+{
+  return syscall3 (SYS_SPAWN_MANY, cmd_lines, cnt, pids);
+}
+
+pid_t
+exec_stdio (const char *cmd_line, int in_fd, int out_fd)
+{
+  return (pid_t) syscall3 (SYS_EXEC_STDIO, cmd_line, in_fd, out_fd);
+}
+
+pid_t
+exec_inherit (const char *cmd_line)
+{
+  return (pid_t) syscall1 (SYS_EXEC_INHERIT, cmd_line);
+}
+
+int
+dup (int fd)
+{
+  return syscall1 (SYS_DUP, fd);
+}
+
+int
+dup2 (int old_fd, int new_fd)
+{
+  return syscall2 (SYS_DUP2, old_fd, new_fd);
+}
+
+pid_t
+wait_any (int *status)
+{
+  return syscall1 (SYS_WAIT_ANY, status);
+}
+
+int
+wait_rusage (pid_t pid, struct rusage *ru)
+{
+  return syscall2 (SYS_WAIT_RUSAGE, pid, ru);
+}
+
+int
+futex_wait (int *futex, int val)
+{
+  return syscall2 (SYS_FUTEX_WAIT, futex, val);
+}
+
+int
+futex_wake (int *futex, int cnt)
+{
+  return syscall2 (SYS_FUTEX_WAKE, futex, cnt);
+}
+
+int
+shm_create (unsigned size, void *addr)
+{
+  return syscall2 (SYS_SHM_CREATE, size, addr);
+}
+
+bool
+shm_attach (int id, void *addr)
+{
+  return syscall2 (SYS_SHM_ATTACH, id, addr);
+}
+
+bool
+shm_detach (void *addr)
+{
+  return syscall1 (SYS_SHM_DETACH, addr);
+}
+
+int
+poll (struct pollfd *fds, int nfds, int timeout_ms)
+{
+  return syscall3 (SYS_POLL, fds, nfds, timeout_ms);
+}
+
+int
+open_flags (const char *file, int flags)
+{
+  return syscall2 (SYS_OPEN_FLAGS, file, flags);
+}
+
+void
+trace_dump (void)
+{
+  syscall0 (SYS_TRACE_DUMP);
+}
+
+/* The kernel information page, read through a volatile pointer
+   since the kernel changes it under us. */
+#define KINFO ((const volatile struct kinfo *) KINFO_ADDR)
+
+/* Returns nanoseconds since boot, as the kernel's timer_ns()
+   does, from the TSC and the calibration in the kernel
+   information page.  Makes a system call only if the TSC is not
+   calibrated. */
+int64_t
+clock_ns (void)
+{
+  uint64_t tsc_hz, tsc_boot, scale, tsc;
+  uint32_t seq;
+  int64_t ns;
+
+  do
+    {
+      seq = KINFO->seq;
+      asm volatile ("" : : : "memory");
+      tsc_hz = KINFO->tsc_hz;
+      tsc_boot = KINFO->tsc_boot;
+      scale = KINFO->tsc_ns_scale;
+      asm volatile ("" : : : "memory");
+    }
+  while ((seq & 1) != 0 || seq != KINFO->seq);
+
+  if (tsc_hz == 0)
+    {
+      syscall1 (SYS_CLOCK_NS, &ns);
+      return ns;
+    }
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return mul64_fix32 (tsc - tsc_boot, scale);
+}
+
+/* Returns timer ticks since boot, from the kernel information
+   page. */
+int64_t
+clock_ticks (void)
+{
+  uint32_t seq;
+  int64_t ticks;
+
+  do
+    {
+      seq = KINFO->seq;
+      asm volatile ("" : : : "memory");
+      ticks = KINFO->ticks;
+      asm volatile ("" : : : "memory");
+    }
+  while ((seq & 1) != 0 || seq != KINFO->seq);
+  return ticks;
+}
+
+/* Returns the calling process's pid, from its kernel information
+   page. */
+pid_t
+getpid (void)
+{
+  return KINFO_PROC_ADDR->pid;
+}
+
+bool
+disk_stats (struct disk_stats *s)
+{
+  return syscall1 (SYS_DISK_STATS, s);
+}
+
+int
+stats (struct stats *s, size_t size)
+{
+  return syscall2 (SYS_STATS, s, size);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
+
+/* Where threads made by thread_create() start, with FUNC and AUX
+   on the stack as if passed by a caller. */
+static void NO_RETURN
+thread_start (void (*func) (void *), void *aux)
+{
+  func (aux);
+  thread_exit ();
+}
+
+int
+thread_create (void (*func) (void *), void *aux, void *stack, size_t size)
+{
+  void **sp = (void **) ((uintptr_t) ((char *) stack + size) & ~0xf);
+
+  *--sp = aux;
+  *--sp = func;
+  *--sp = NULL;                 /* Return address. */
+  return syscall2 (SYS_THREAD_CREATE, thread_start, sp);
+}
+
+int
+thread_join (int tid)
+{
+  return syscall1 (SYS_THREAD_JOIN, tid);
+}
+
+void
+thread_exit (void)
+{
+  syscall0 (SYS_THREAD_EXIT);
+  NOT_REACHED ();
+}
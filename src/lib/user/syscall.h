@@ -2,7 +2,15 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
+#include <disk-stats.h>
+#include <fcntl.h>
+#include <iovec.h>
+#include <poll.h>
+#include <rusage.h>
+#include <stats.h>
+#include <syscall-batch.h>
 
 /* Process identifier. */
 typedef int pid_t;
@@ -12,6 +20,9 @@ typedef int pid_t;
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
+/* Most command lines one spawn_many() call starts. */
+#define SPAWN_MAX 16
+
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
@@ -19,6 +30,9 @@ typedef int mapid_t;
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
 
+/* Chooses how to enter the kernel.  Called by _start(). */
+void syscall_setup (void);
+
 /* The basic systemcalls you will implement. */
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
@@ -47,6 +61,44 @@ int inumber (int fd);
 
 void sleep(int ms);
 void plist(void);
+bool pipe (int fds[2]);
+int readv (int fd, const struct iovec *, int iovcnt);
+int writev (int fd, const struct iovec *, int iovcnt);
+int copy (int in_fd, int out_fd, unsigned size);
+int pread (int fd, void *buffer, unsigned length, unsigned offset);
+int pwrite (int fd, const void *buffer, unsigned length, unsigned offset);
+int submit (struct syscall_entry *, int cnt);
+int spawn_many (const char *const *cmd_lines, int cnt, pid_t *pids);
+pid_t exec_stdio (const char *cmd_line, int in_fd, int out_fd);
+pid_t exec_inherit (const char *cmd_line);
+int dup (int fd);
+int dup2 (int old_fd, int new_fd);
+pid_t wait_any (int *status);
+int wait_rusage (pid_t, struct rusage *);
+int futex_wait (int *, int val);
+int futex_wake (int *, int cnt);
+int shm_create (unsigned size, void *addr);
+bool shm_attach (int id, void *addr);
+bool shm_detach (void *addr);
+int poll (struct pollfd *, int nfds, int timeout_ms);
+int open_flags (const char *file, int flags);
+void trace_dump (void);
+int64_t clock_ns (void);
+int64_t clock_ticks (void);
+pid_t getpid (void);
+bool disk_stats (struct disk_stats *);
+int stats (struct stats *, size_t size);
+void *sbrk (intptr_t increment);
+
+/* Threads sharing the calling process's memory and open files.
+   thread_create() runs FUNC (AUX) in a new thread on the SIZE
+   bytes of STACK, which must stay allocated until the thread has
+   been joined, and returns its tid or -1.  A thread ends when
+   FUNC returns or it calls thread_exit(); exit() in any thread
+   ends them all. */
+int thread_create (void (*func) (void *), void *aux, void *stack, size_t size);
+int thread_join (int tid);
+void thread_exit (void) NO_RETURN;
 
 
 #endif /* lib/user/syscall.h */
@@ -0,0 +1,56 @@
+/* Common code for the kernel microbenchmarks.
+
+   Each benchmark times some number of operations on a kernel
+   primitive and reports them with bench_report(), as one line
+
+        BENCH <name> <ops> <unit> <ns> ns <rate> <unit>/s
+
+   which a script can pick out of the console output to track
+   the primitives across kernel changes. */
+
+#include "tests/bench/bench.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include "devices/timer.h"
+
+/* Returns a time stamp for bench_elapsed(). */
+int64_t
+bench_start (void) 
+{
+  return timer_ns ();
+}
+
+/* Returns the nanoseconds since START, a time stamp returned by
+   bench_start(). */
+int64_t
+bench_elapsed (int64_t start) 
+{
+  return timer_ns () - start;
+}
+
+/* Reports that OPS operations, counted in UNITs, took NS
+   nanoseconds. */
+void
+bench_report (const char *name, int64_t ns, int64_t ops,
+              const char *unit) 
+{
+  if (ns <= 0)
+    ns = 1;
+  printf ("BENCH %s %"PRId64" %s %"PRId64" ns %"PRId64" %s/s\n",
+          name, ops, unit, ns, ops * 1000000000 / ns, unit);
+}
+
+/* Runs every benchmark. */
+void
+bench_all (void) 
+{
+  bench_switch ();
+  bench_thread ();
+  bench_sema ();
+  bench_malloc ();
+  bench_palloc ();
+  bench_memcpy ();
+  bench_bitmap ();
+  bench_hash ();
+  bench_list_sort ();
+}
@@ -0,0 +1,23 @@
+#ifndef TESTS_BENCH_BENCH_H
+#define TESTS_BENCH_BENCH_H
+
+#include <stdint.h>
+#include "tests/threads/tests.h"
+
+extern test_func bench_all;
+extern test_func bench_switch;
+extern test_func bench_thread;
+extern test_func bench_sema;
+extern test_func bench_malloc;
+extern test_func bench_palloc;
+extern test_func bench_memcpy;
+extern test_func bench_bitmap;
+extern test_func bench_hash;
+extern test_func bench_list_sort;
+
+int64_t bench_start (void);
+int64_t bench_elapsed (int64_t start);
+void bench_report (const char *name, int64_t ns, int64_t ops,
+                   const char *unit);
+
+#endif /* tests/bench/bench.h */
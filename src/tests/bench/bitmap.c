@@ -0,0 +1,47 @@
+/* Measures bitmap_scan() on a nearly full bitmap, where a scan
+   must pass over almost every bit to find the free run at the
+   end, and bitmap_count() and bitmap_set_multiple() over the
+   whole bitmap. */
+
+#include "tests/bench/bench.h"
+#include <bitmap.h>
+#include "threads/malloc.h"
+
+#define BIT_CNT 4096
+#define RUN_CNT 8
+#define SCAN_CNT 2000
+
+void
+bench_bitmap (void) 
+{
+  struct bitmap *b = bitmap_create (BIT_CNT);
+  int64_t start;
+  int i;
+
+  if (b == NULL)
+    fail ("out of memory");
+  bitmap_set_all (b, true);
+  bitmap_set_multiple (b, BIT_CNT - RUN_CNT, RUN_CNT, false);
+
+  start = bench_start ();
+  for (i = 0; i < SCAN_CNT; i++)
+    if (bitmap_scan (b, 0, RUN_CNT, false) != BIT_CNT - RUN_CNT)
+      fail ("bitmap_scan found the wrong run");
+  bench_report ("bitmap-scan", bench_elapsed (start),
+                SCAN_CNT, "scans");
+
+  start = bench_start ();
+  for (i = 0; i < SCAN_CNT; i++)
+    if (bitmap_count (b, 1, BIT_CNT - 1, false) != RUN_CNT)
+      fail ("bitmap_count miscounted");
+  bench_report ("bitmap-count", bench_elapsed (start),
+                SCAN_CNT, "counts");
+
+  start = bench_start ();
+  for (i = 0; i < SCAN_CNT; i++)
+    bitmap_set_multiple (b, 1, BIT_CNT - 2, i % 2 != 0);
+  bench_report ("bitmap-set-multiple", bench_elapsed (start),
+                SCAN_CNT, "sets");
+
+  bitmap_destroy (b);
+}
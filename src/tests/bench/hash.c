@@ -0,0 +1,95 @@
+/* Measures hash_insert() and hash_find() on a table of integer
+   keys, for tables that resize all at once and incrementally.
+   Each insert is also timed alone, for the worst case. */
+
+#include "tests/bench/bench.h"
+#include <hash.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+
+#define ELEM_CNT 1024
+#define ROUND_CNT 20
+
+struct value
+  {
+    struct hash_elem elem;
+    unsigned key;
+  };
+
+static unsigned
+value_hash (const struct hash_elem *e, void *aux UNUSED) 
+{
+  const struct value *v = hash_entry (e, struct value, elem);
+  return hash_int (v->key);
+}
+
+static bool
+value_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED) 
+{
+  return (hash_entry (a, struct value, elem)->key
+          < hash_entry (b, struct value, elem)->key);
+}
+
+/* Runs ROUND_CNT rounds of inserts and finds on a table made
+   with INIT, reporting them under names that start with NAME. */
+static void
+run_rounds (const char *name, struct value *values,
+            bool (*init) (struct hash *, hash_hash_func *,
+                          hash_less_func *, void *))
+{
+  int64_t insert_ns = 0, find_ns = 0, max_insert_ns = 0;
+  int64_t start;
+  struct hash h;
+  char report[32];
+  int round, i;
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      if (!init (&h, value_hash, value_less, NULL))
+        fail ("out of memory");
+
+      for (i = 0; i < ELEM_CNT; i++)
+        {
+          int64_t ns;
+
+          start = bench_start ();
+          hash_insert (&h, &values[i].elem);
+          ns = bench_elapsed (start);
+          insert_ns += ns;
+          if (ns > max_insert_ns)
+            max_insert_ns = ns;
+        }
+
+      start = bench_start ();
+      for (i = 0; i < ELEM_CNT; i++)
+        if (hash_find (&h, &values[i * 7 % ELEM_CNT].elem) == NULL)
+          fail ("hash_find missed an element");
+      find_ns += bench_elapsed (start);
+
+      hash_destroy (&h, NULL);
+    }
+
+  snprintf (report, sizeof report, "%s-insert", name);
+  bench_report (report, insert_ns, ROUND_CNT * ELEM_CNT, "inserts");
+  snprintf (report, sizeof report, "%s-insert-max", name);
+  bench_report (report, max_insert_ns, 1, "insert");
+  snprintf (report, sizeof report, "%s-find", name);
+  bench_report (report, find_ns, ROUND_CNT * ELEM_CNT, "finds");
+}
+
+void
+bench_hash (void) 
+{
+  struct value *values = malloc (ELEM_CNT * sizeof *values);
+  int i;
+
+  if (values == NULL)
+    fail ("out of memory");
+  for (i = 0; i < ELEM_CNT; i++)
+    values[i].key = i * 2654435761u;
+
+  run_rounds ("hash", values, hash_init);
+  run_rounds ("hash-incr", values, hash_init_incremental);
+  free (values);
+}
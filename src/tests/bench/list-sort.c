@@ -0,0 +1,53 @@
+/* Measures list_sort() on lists in random order. */
+
+#include "tests/bench/bench.h"
+#include <list.h>
+#include <random.h>
+#include "threads/malloc.h"
+
+#define ELEM_CNT 1024
+#define ROUND_CNT 20
+
+struct value
+  {
+    struct list_elem elem;
+    unsigned key;
+  };
+
+static bool
+value_less (const struct list_elem *a, const struct list_elem *b,
+            void *aux UNUSED) 
+{
+  return (list_entry (a, struct value, elem)->key
+          < list_entry (b, struct value, elem)->key);
+}
+
+void
+bench_list_sort (void) 
+{
+  struct value *values = malloc (ELEM_CNT * sizeof *values);
+  int64_t sort_ns = 0;
+  int64_t start;
+  struct list list;
+  int round, i;
+
+  if (values == NULL)
+    fail ("out of memory");
+
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      list_init (&list);
+      for (i = 0; i < ELEM_CNT; i++)
+        {
+          values[i].key = random_ulong ();
+          list_push_back (&list, &values[i].elem);
+        }
+
+      start = bench_start ();
+      list_sort (&list, value_less, NULL);
+      sort_ns += bench_elapsed (start);
+    }
+
+  bench_report ("list-sort", sort_ns, ROUND_CNT * ELEM_CNT, "elements");
+  free (values);
+}
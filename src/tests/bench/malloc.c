@@ -0,0 +1,32 @@
+/* Measures malloc() and free() throughput over a mix of block
+   sizes, freeing in batches so that arenas fill and empty. */
+
+#include "tests/bench/bench.h"
+#include <debug.h>
+#include "threads/malloc.h"
+
+#define BATCH_CNT 64
+#define ROUND_CNT 200
+
+void
+bench_malloc (void) 
+{
+  void *blocks[BATCH_CNT];
+  int64_t start;
+  int round, i;
+
+  start = bench_start ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < BATCH_CNT; i++)
+        {
+          blocks[i] = malloc (16 << (i % 8));
+          if (blocks[i] == NULL)
+            fail ("out of memory");
+        }
+      for (i = 0; i < BATCH_CNT; i++)
+        free (blocks[i]);
+    }
+  bench_report ("malloc", bench_elapsed (start),
+                ROUND_CNT * BATCH_CNT, "allocs");
+}
@@ -0,0 +1,32 @@
+/* Measures memcpy() bandwidth between page-aligned buffers. */
+
+#include "tests/bench/bench.h"
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+#define BUF_PAGES 4
+#define COPY_CNT 1000
+
+void
+bench_memcpy (void) 
+{
+  size_t size = BUF_PAGES * PGSIZE;
+  uint8_t *src, *dst;
+  int64_t start;
+  int i;
+
+  src = palloc_get_multiple (PAL_ZERO, BUF_PAGES);
+  dst = palloc_get_multiple (0, BUF_PAGES);
+  if (src == NULL || dst == NULL)
+    fail ("out of pages");
+
+  start = bench_start ();
+  for (i = 0; i < COPY_CNT; i++)
+    memcpy (dst, src, size);
+  bench_report ("memcpy", bench_elapsed (start),
+                (int64_t) COPY_CNT * size, "bytes");
+
+  palloc_free_multiple (src, BUF_PAGES);
+  palloc_free_multiple (dst, BUF_PAGES);
+}
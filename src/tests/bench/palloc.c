@@ -0,0 +1,30 @@
+/* Measures palloc_get_page() and palloc_free_page() throughput. */
+
+#include "tests/bench/bench.h"
+#include "threads/palloc.h"
+
+#define BATCH_CNT 32
+#define ROUND_CNT 200
+
+void
+bench_palloc (void) 
+{
+  void *pages[BATCH_CNT];
+  int64_t start;
+  int round, i;
+
+  start = bench_start ();
+  for (round = 0; round < ROUND_CNT; round++)
+    {
+      for (i = 0; i < BATCH_CNT; i++)
+        {
+          pages[i] = palloc_get_page (0);
+          if (pages[i] == NULL)
+            fail ("out of pages");
+        }
+      for (i = 0; i < BATCH_CNT; i++)
+        palloc_free_page (pages[i]);
+    }
+  bench_report ("palloc", bench_elapsed (start),
+                ROUND_CNT * BATCH_CNT, "pages");
+}
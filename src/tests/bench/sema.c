@@ -0,0 +1,72 @@
+/* Measures semaphore handoff latency, as two threads that wake
+   each other in turn through a pair of semaphores, and the cost
+   of waking the highest-priority thread from a semaphore that
+   many threads of mixed priorities are waiting on. */
+
+#include "tests/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define HANDOFF_CNT 20000
+#define WAITER_CNT 200
+
+struct ping_pong
+  {
+    struct semaphore ping;      /* Upped by the benchmark thread. */
+    struct semaphore pong;      /* Upped by the partner. */
+  };
+
+static thread_func partner;
+static thread_func waiter;
+
+void
+bench_sema (void) 
+{
+  struct ping_pong pp;
+  int64_t start;
+  int i;
+
+  sema_init (&pp.ping, 0);
+  sema_init (&pp.pong, 0);
+  thread_create ("partner", thread_get_priority (), partner, &pp);
+  start = bench_start ();
+  for (i = 0; i < HANDOFF_CNT; i++)
+    {
+      sema_up (&pp.ping);
+      sema_down (&pp.pong);
+    }
+  bench_report ("sema", bench_elapsed (start),
+                2 * HANDOFF_CNT, "handoffs");
+
+  /* Each waiter outranks us, so it runs and blocks on PP.PING as
+     soon as it is created, and finishes as soon as it is woken,
+     once per sema_up(). */
+  sema_init (&pp.ping, 0);
+  for (i = 0; i < WAITER_CNT; i++)
+    thread_create ("waiter", PRI_DEFAULT + 1 + i % (PRI_MAX - PRI_DEFAULT),
+                   waiter, &pp.ping);
+  start = bench_start ();
+  for (i = 0; i < WAITER_CNT; i++)
+    sema_up (&pp.ping);
+  bench_report ("sema-waiters", bench_elapsed (start),
+                WAITER_CNT, "wakeups");
+}
+
+static void
+partner (void *pp_) 
+{
+  struct ping_pong *pp = pp_;
+  int i;
+
+  for (i = 0; i < HANDOFF_CNT; i++)
+    {
+      sema_down (&pp->ping);
+      sema_up (&pp->pong);
+    }
+}
+
+static void
+waiter (void *sema) 
+{
+  sema_down (sema);
+}
@@ -0,0 +1,38 @@
+/* Measures the cost of a context switch, as two threads of equal
+   priority that hand the CPU back and forth with thread_yield(). */
+
+#include "tests/bench/bench.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define SWITCH_CNT 20000
+
+static thread_func yielder;
+
+void
+bench_switch (void) 
+{
+  struct semaphore done;
+  int64_t start;
+  int i;
+
+  sema_init (&done, 0);
+  thread_create ("yielder", thread_get_priority (), yielder, &done);
+  start = bench_start ();
+  for (i = 0; i < SWITCH_CNT; i++)
+    thread_yield ();
+  sema_down (&done);
+  bench_report ("switch", bench_elapsed (start),
+                2 * SWITCH_CNT, "switches");
+}
+
+static void
+yielder (void *done_) 
+{
+  struct semaphore *done = done_;
+  int i;
+
+  for (i = 0; i < SWITCH_CNT; i++)
+    thread_yield ();
+  sema_up (done);
+}
@@ -0,0 +1,30 @@
+/* Measures the cost of creating a thread that exits at once.  The
+   child has a higher priority than its creator, so each iteration
+   covers creating it, switching to it, its exit, and destroying
+   it. */
+
+#include "tests/bench/bench.h"
+#include "threads/thread.h"
+
+#define THREAD_CNT 2000
+
+static thread_func quitter;
+
+void
+bench_thread (void) 
+{
+  int64_t start;
+  int i;
+
+  start = bench_start ();
+  for (i = 0; i < THREAD_CNT; i++)
+    if (thread_create ("quitter", thread_get_priority () + 1,
+                       quitter, NULL) == TID_ERROR)
+      fail ("thread_create failed");
+  bench_report ("thread", bench_elapsed (start), THREAD_CNT, "threads");
+}
+
+static void
+quitter (void *aux UNUSED) 
+{
+}
@@ -31,6 +31,15 @@ static bool value_less (const struct list_elem *, const struct list_elem *,
 static void verify_list_fwd (struct list *, int size);
 static void verify_list_bkwd (struct list *, int size);
 
+/* Returns true if value A is less than value B. */
+static inline bool
+value_lt (const struct value *a, const struct value *b)
+{
+  return a->value < b->value;
+}
+
+DEFINE_LIST_INSERT_ORDERED (insert_value, struct value, elem, value_lt);
+
 /* Test the linked list implementation. */
 void
 test (void) 
@@ -85,6 +94,14 @@ test (void)
                                  value_less, NULL);
           verify_list_fwd (&list, size);
 
+          /* The same, using the inserter defined by
+             DEFINE_LIST_INSERT_ORDERED. */
+          shuffle (values, size);
+          list_init (&list);
+          for (i = 0; i < size; i++)
+            insert_value (&list, &values[i]);
+          verify_list_fwd (&list, size);
+
           /* Duplicate some items, uniquify, and verify. */
           ofs = size;
           for (e = list_begin (&list); e != list_end (&list);
@@ -1,4 +1,5 @@
 #include "tests/threads/tests.h"
+#include "tests/bench/bench.h"
 #include <debug.h>
 #include <string.h>
 #include <stdio.h>
@@ -39,7 +40,17 @@ static const struct test tests[] =
     {"mlfqs-nice-10", test_mlfqs_nice_10},
     {"mlfqs-block", test_mlfqs_block},
     {"threadtest", ThreadTest},
-    {"simplethreadtest", SimpleThreadTest}
+    {"simplethreadtest", SimpleThreadTest},
+    {"bench", bench_all},
+    {"bench-switch", bench_switch},
+    {"bench-thread", bench_thread},
+    {"bench-sema", bench_sema},
+    {"bench-malloc", bench_malloc},
+    {"bench-palloc", bench_palloc},
+    {"bench-memcpy", bench_memcpy},
+    {"bench-bitmap", bench_bitmap},
+    {"bench-hash", bench_hash},
+    {"bench-list-sort", bench_list_sort},
   };
 
 static const char *test_name;
@@ -1,36 +1,123 @@
 // boundedbuffer.cc
-//  This is a skeleton for the implementation of bounded buffer to test
-//  synchronization primitives (condition and lock).
+//  Bounded buffer: a fixed-size FIFO channel of ints between any
+//  number of producer and consumer threads.
 //
-//  Your implementation of bounded buffer should be thread safe. For an
-//  example of implementation refer to synchlist implementation.
+//  The slots are counted by two semaphores, so a writer waits only
+//  while the buffer is full and a reader only while it is empty.
+//  Once a thread owns a slot, it claims its position and copies
+//  the value with interrupts off, which takes only a few
+//  instructions, instead of taking a lock.  Positions are claimed
+//  in order, so the Nth value counted in FULL is always the Nth
+//  one stored, whichever thread ups FULL first.
 //
 // Created by Andrzej Bednarski
 //
 // Modified by Vlad Jahundovics (translation from C++ to C)
 
 #include "threads/boundedbuffer.h"
+#include <debug.h>
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
 
 void bb_init(struct bounded_buffer *bb, int _size)
 {
+  ASSERT(_size > 0);
   bb->size = _size;
-  // write your code here
+  bb->slots = malloc(_size * sizeof *bb->slots);
+  if (bb->slots == NULL)
+    PANIC("bb_init: out of memory");
+  bb->head = bb->tail = 0;
+  sema_init(&bb->empty, _size);
+  sema_init(&bb->full, 0);
 }
 
-void bb_destroy(struct bounded_buffer *bb UNUSED)
+void bb_destroy(struct bounded_buffer *bb)
 {
-  // write your code here
+  free(bb->slots);
+  bb->slots = NULL;
 }
 
-int bb_read(struct bounded_buffer *bb UNUSED)
+// Returns the slot after POS in BB.
+static inline int next_slot(const struct bounded_buffer *bb, int pos)
 {
-  // write your code here
-  return 0;
+  return pos + 1 < bb->size ? pos + 1 : 0;
 }
 
-void bb_write(struct bounded_buffer *bb UNUSED, int value UNUSED)
+// Waits for a value in BB, removes it, and returns it.
+int bb_read(struct bounded_buffer *bb)
 {
-  // write your code here
+  enum intr_level old_level;
+  int value;
+
+  sema_down(&bb->full);
+  old_level = intr_disable();
+  value = bb->slots[bb->head];
+  bb->head = next_slot(bb, bb->head);
+  intr_set_level(old_level);
+  sema_up(&bb->empty);
+  return value;
+}
+
+// Waits for a free slot in BB and stores VALUE in it.
+void bb_write(struct bounded_buffer *bb, int value)
+{
+  enum intr_level old_level;
+
+  sema_down(&bb->empty);
+  old_level = intr_disable();
+  bb->slots[bb->tail] = value;
+  bb->tail = next_slot(bb, bb->tail);
+  intr_set_level(old_level);
+  sema_up(&bb->full);
 }
 
+// Waits for at least one value in BB, then removes as many as are
+// there, up to CNT, into VALUES.  Returns the number removed.
+int bb_read_many(struct bounded_buffer *bb, int *values, int cnt)
+{
+  enum intr_level old_level;
+  int n, i;
+
+  ASSERT(cnt > 0);
+  sema_down(&bb->full);
+  for (n = 1; n < cnt && sema_try_down(&bb->full); n++)
+    continue;
+
+  old_level = intr_disable();
+  for (i = 0; i < n; i++) {
+    values[i] = bb->slots[bb->head];
+    bb->head = next_slot(bb, bb->head);
+    sema_up(&bb->empty);
+  }
+  intr_set_level(old_level);
+  thread_preempt();
+  return n;
+}
+
+// Stores the CNT values in VALUES in BB, in order, waiting for
+// free slots as needed.  Another writer's values may come between
+// those of separate waits.
+void bb_write_many(struct bounded_buffer *bb, const int *values, int cnt)
+{
+  enum intr_level old_level;
+  int done = 0;
+
+  while (done < cnt) {
+    int n, i;
+
+    sema_down(&bb->empty);
+    for (n = 1; done + n < cnt && sema_try_down(&bb->empty); n++)
+      continue;
+
+    old_level = intr_disable();
+    for (i = 0; i < n; i++) {
+      bb->slots[bb->tail] = values[done + i];
+      bb->tail = next_slot(bb, bb->tail);
+      sema_up(&bb->full);
+    }
+    intr_set_level(old_level);
+    thread_preempt();
+    done += n;
+  }
+}
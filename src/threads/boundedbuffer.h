@@ -10,15 +10,24 @@
 
 #include "threads/synch.h"
 
+// A ring of SIZE slots.  EMPTY counts the free slots and FULL the
+// filled ones, so a reader or writer only waits when it must.
+// HEAD and TAIL only move with interrupts off, for a few
+// instructions, so readers and writers need no lock.
 struct bounded_buffer {
   int size;
-  // You may add other data fields required for the bounded buffer
-
+  int *slots;                   // Array of SIZE values.
+  int head;                     // Next slot to read.
+  int tail;                     // Next slot to write.
+  struct semaphore empty;       // Number of free slots.
+  struct semaphore full;        // Number of filled slots.
 };
 
 void bb_init(struct bounded_buffer *, int);
 int bb_read(struct bounded_buffer *);
 void bb_write(struct bounded_buffer *, int);
+int bb_read_many(struct bounded_buffer *, int *, int);
+void bb_write_many(struct bounded_buffer *, const int *, int);
 void bb_destroy(struct bounded_buffer *);
 
 #endif
@@ -0,0 +1,216 @@
+#include "threads/cpu.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/vaddr.h"
+
+/* Per-CPU data.  cpus[0] is the boot processor. */
+struct cpu cpus[CPU_MAX];
+
+/* Number of CPUs in cpus[]. */
+int cpu_cnt = 1;
+
+/* MultiProcessor Specification floating pointer structure.  See
+   [MP] 4.1 "MP Floating Pointer Structure". */
+struct mp_pointer
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config;            /* Physical address of mp_config. */
+    uint8_t length;             /* In 16-byte units. */
+    uint8_t spec_rev;           /* MP spec version. */
+    uint8_t checksum;           /* All bytes sum to 0. */
+    uint8_t features[5];        /* Nonzero FEATURES[0]: default config. */
+  } __attribute__ ((packed));
+
+/* MP configuration table header.  See [MP] 4.2 "MP
+   Configuration Table Header". */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Of header and base entries. */
+    uint8_t spec_rev;           /* MP spec version. */
+    uint8_t checksum;           /* All bytes sum to 0. */
+    char oem_id[8];
+    char product_id[12];
+    uint32_t oem_table;
+    uint16_t oem_table_size;
+    uint16_t entry_cnt;         /* Number of base entries. */
+    uint32_t lapic;             /* Physical address of local APICs. */
+    uint16_t ext_length;
+    uint8_t ext_checksum;
+    uint8_t reserved;
+  } __attribute__ ((packed));
+
+/* MP configuration table processor entry.  See [MP] 4.3.1
+   "Processor Entries". */
+struct mp_processor
+  {
+    uint8_t type;               /* MP_PROCESSOR. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    uint8_t apic_version;
+    uint8_t flags;              /* MP_CPU_* flags. */
+    uint32_t signature;
+    uint32_t feature_flags;
+    uint32_t reserved[2];
+  } __attribute__ ((packed));
+
+#define MP_PROCESSOR 0          /* Processor entry type. */
+#define MP_CPU_ENABLED 0x01     /* Processor is usable. */
+#define MP_CPU_BSP 0x02         /* Processor is the boot processor. */
+
+/* Returns true if the SIZE bytes at P sum to 0 modulo 256. */
+static bool
+checksum_ok (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Returns the MP floating pointer structure in the SIZE bytes at
+   physical address START, or a null pointer if there is none
+   there. */
+static struct mp_pointer *
+find_mp_in (uintptr_t start, size_t size)
+{
+  uintptr_t p;
+
+  for (p = start; p + sizeof (struct mp_pointer) <= start + size; p += 16)
+    {
+      struct mp_pointer *mp = ptov (p);
+      if (!memcmp (mp->signature, "_MP_", 4)
+          && checksum_ok (mp, sizeof *mp))
+        return mp;
+    }
+  return NULL;
+}
+
+/* Returns the MP floating pointer structure, or a null pointer
+   if the BIOS did not provide one.  It must be in the first
+   kilobyte of the Extended BIOS Data Area, the last kilobyte of
+   base memory, or the BIOS ROM.  See [MP] 4 "MP Configuration
+   Table". */
+static struct mp_pointer *
+find_mp (void)
+{
+  uintptr_t ebda = *(uint16_t *) ptov (0x40e) << 4;
+  uintptr_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_pointer *mp = NULL;
+
+  if (ebda != 0)
+    mp = find_mp_in (ebda, 1024);
+  if (mp == NULL && base_kb != 0)
+    mp = find_mp_in (base_kb * 1024 - 1024, 1024);
+  if (mp == NULL)
+    mp = find_mp_in (0xf0000, 0x10000);
+  return mp;
+}
+
+/* Finds the processors in the machine, filling in cpus[] and
+   cpu_cnt.  The boot processor becomes cpus[0]; it is the only
+   one started. */
+void
+cpu_init (void)
+{
+  struct mp_pointer *mp = find_mp ();
+  struct mp_config *conf;
+  uint8_t *entry;
+  int i;
+
+  cpus[0].id = 0;
+  cpus[0].started = true;
+  cpu_cnt = 1;
+
+  if (mp == NULL || mp->config == 0 || mp->features[0] != 0
+      || mp->config >= ram_pages * PGSIZE)
+    return;
+  conf = ptov (mp->config);
+  if (memcmp (conf->signature, "PCMP", 4)
+      || !checksum_ok (conf, conf->length))
+    return;
+
+  entry = (uint8_t *) (conf + 1);
+  for (i = 0; i < conf->entry_cnt
+         && entry + sizeof (struct mp_processor)
+              <= (uint8_t *) conf + conf->length; i++)
+    {
+      if (*entry == MP_PROCESSOR)
+        {
+          struct mp_processor *p = (struct mp_processor *) entry;
+          if (p->flags & MP_CPU_BSP)
+            cpus[0].apic_id = p->apic_id;
+          else if ((p->flags & MP_CPU_ENABLED) && cpu_cnt < CPU_MAX)
+            {
+              cpus[cpu_cnt].id = cpu_cnt;
+              cpus[cpu_cnt].apic_id = p->apic_id;
+              cpu_cnt++;
+            }
+          entry += sizeof *p;
+        }
+      else
+        {
+          /* Every other base entry type is 8 bytes long. */
+          entry += 8;
+        }
+    }
+}
+
+/* EFLAGS bit that can be toggled only if CPUID exists. */
+#define FLAG_ID 0x00200000
+
+/* Returns CPUID function 1's EDX feature flags, CPUID_* bits, or
+   0 if the CPU does not have the CPUID instruction. */
+uint32_t
+cpu_features (void)
+{
+  uint32_t flags, toggled, eax, ebx, ecx, edx;
+
+  asm volatile ("pushfl; popl %0; movl %0, %1; xorl %2, %1; "
+                "pushl %1; popfl; pushfl; popl %1; pushl %0; popfl"
+                : "=&r" (flags), "=&r" (toggled) : "i" (FLAG_ID));
+  if (((flags ^ toggled) & FLAG_ID) == 0)
+    return 0;
+
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  return edx;
+}
+
+/* Returns true if the CPU has working SYSENTER and SYSEXIT.  The
+   Pentium Pro, family 6 before model 3 stepping 3, sets the
+   CPUID bit without having them.  See [IA32-v2b] "SYSENTER". */
+bool
+cpu_has_sysenter (void)
+{
+  uint32_t eax, ebx, ecx, edx;
+  int family, model, stepping;
+
+  if (!(cpu_features () & CPUID_SEP))
+    return false;
+  asm volatile ("cpuid"
+                : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+                : "a" (1));
+  family = (eax >> 8) & 0xf;
+  model = (eax >> 4) & 0xf;
+  stepping = eax & 0xf;
+  return !(family == 6 && model < 3 && stepping < 3);
+}
+
+/* Prints per-CPU statistics, if there is more than one CPU. */
+void
+cpu_print_stats (void)
+{
+  int i;
+
+  if (cpu_cnt > 1)
+    for (i = 0; i < cpu_cnt; i++)
+      printf ("CPU %d: APIC ID %d, %s, %lld idle ticks, %lld kernel ticks, "
+              "%lld user ticks\n",
+              i, cpus[i].apic_id, cpus[i].started ? "running" : "not started",
+              cpus[i].idle_ticks, cpus[i].kernel_ticks, cpus[i].user_ticks);
+}
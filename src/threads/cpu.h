@@ -0,0 +1,59 @@
+#ifndef THREADS_CPU_H
+#define THREADS_CPU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Most CPUs the kernel keeps track of. */
+#define CPU_MAX 16
+
+/* Per-CPU data.
+
+   State that each processor needs its own copy of lives here
+   rather than in globals, so that it can move to one struct cpu
+   per running CPU.  Only the boot processor runs kernel code so
+   far: cpu_init() finds the others in the BIOS's MultiProcessor
+   table, but does not start them. */
+struct cpu
+  {
+    int id;                     /* Index in cpus[]. */
+    uint8_t apic_id;            /* Local APIC ID. */
+    bool started;               /* Running kernel code? */
+
+    /* Timer ticks, counted by thread_tick(). */
+    long long idle_ticks;       /* Spent in the idle thread. */
+    long long kernel_ticks;     /* Spent in kernel threads. */
+    long long user_ticks;       /* Spent in user programs. */
+  };
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+/* CPUID function 1 EDX feature bits, returned by cpu_features(). */
+#define CPUID_PSE (1u << 3)     /* 4 MB pages. */
+#define CPUID_SEP (1u << 11)    /* SYSENTER and SYSEXIT. */
+#define CPUID_PGE (1u << 13)    /* Global pages. */
+#define CPUID_FXSR (1u << 24)   /* FXSAVE and FXRSTOR. */
+#define CPUID_SSE (1u << 25)    /* SSE. */
+
+void cpu_init (void);
+uint32_t cpu_features (void);
+bool cpu_has_sysenter (void);
+void cpu_print_stats (void);
+
+/* Writes VALUE to model-specific register MSR. */
+static inline void
+cpu_write_msr (uint32_t msr, uint64_t value)
+{
+  asm volatile ("wrmsr" : : "c" (msr), "A" (value));
+}
+
+/* Returns the CPU running the caller.  Only the boot processor
+   runs, so that is always cpus[0]. */
+static inline struct cpu *
+cpu_current (void)
+{
+  return &cpus[0];
+}
+
+#endif /* threads/cpu.h */
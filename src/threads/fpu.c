@@ -0,0 +1,272 @@
+#include "threads/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/cpu.h"
+#include "threads/interrupt.h"
+#include "threads/loader.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+
+/* CR0 and CR4 bits.  See [IA32-v3a] 2.5 "Control Registers". */
+#define CR0_MP 0x00000002       /* Monitor coprocessor. */
+#define CR0_EM 0x00000004       /* (Floating-point) Emulation. */
+#define CR0_TS 0x00000008       /* Task Switched. */
+#define CR0_NE 0x00000020       /* Numeric Error: report via #MF. */
+#define CR4_OSFXSR 0x00000200   /* FXSAVE, FXRSTOR, and SSE allowed. */
+#define CR4_OSXMMEXCPT 0x00000400 /* SIMD exceptions via #XF. */
+
+/* FXSAVE area: 512 bytes, which must be 16-byte aligned.
+   malloc() does not promise that, so save areas are allocated
+   with room to spare and aligned by hand. */
+#define FXSAVE_SIZE 512
+#define FXSAVE_ALIGN 16
+
+/* Initial MXCSR: all SIMD exceptions masked, round to nearest. */
+#define MXCSR_DEFAULT 0x1f80
+
+/* True if FPU state is being switched, false if CR0.EM is still
+   set and FPU instructions trap to exception.c. */
+static bool enabled;
+
+/* Thread whose state the FPU registers hold, if any. */
+static struct thread *owner;
+
+/* Whether CR0.TS is currently set, to avoid rewriting CR0 on
+   context switches that do not change it. */
+static bool ts_set;
+
+/* Inside fpu_kernel_begin()? */
+static bool in_kernel;
+
+/* State of a freshly initialized FPU, copied into each new save
+   area so that every thread starts from the same registers. */
+static uint8_t initial_state[FXSAVE_SIZE] __attribute__ ((aligned (16)));
+
+/* Statistics. */
+static long long restore_cnt;   /* #NM traps that loaded a thread's state. */
+static long long save_cnt;      /* Times an owner's state was saved. */
+
+static intr_handler_func fpu_trap;
+
+static inline uint32_t
+read_cr0 (void)
+{
+  uint32_t cr0;
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  return cr0;
+}
+
+static inline void
+write_cr0 (uint32_t cr0)
+{
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0) : "memory");
+}
+
+/* Sets CR0.TS if TS is true, clears it otherwise. */
+static void
+set_ts (bool ts)
+{
+  if (ts != ts_set)
+    {
+      if (ts)
+        write_cr0 (read_cr0 () | CR0_TS);
+      else
+        asm volatile ("clts" : : : "memory");
+      ts_set = ts;
+    }
+}
+
+/* Returns the 16-byte aligned FXSAVE area within block T->fpu. */
+static void *
+save_area (const struct thread *t)
+{
+  return (void *) ROUND_UP ((uintptr_t) t->fpu, FXSAVE_ALIGN);
+}
+
+static inline void
+fxsave (void *area)
+{
+  asm volatile ("fxsave %0" : "=m" (*(uint8_t (*)[FXSAVE_SIZE]) area));
+}
+
+static inline void
+fxrstor (const void *area)
+{
+  asm volatile ("fxrstor %0" : : "m" (*(const uint8_t (*)[FXSAVE_SIZE]) area));
+}
+
+/* Saves the owner's registers, if there is an owner, and leaves
+   the FPU without one.  CR0.TS must be clear. */
+static void
+save_owner (void)
+{
+  if (owner != NULL)
+    {
+      fxsave (save_area (owner));
+      owner = NULL;
+      save_cnt++;
+    }
+}
+
+/* Enables the FPU and SSE, if the CPU has FXSAVE, with CR0.TS
+   set so that the first use by a thread traps.  Must be called
+   after intr_init() and before exception_init(). */
+void
+fpu_init (void)
+{
+  uint32_t features = cpu_features ();
+  uint32_t cr4;
+
+  if (!(features & CPUID_FXSR))
+    return;
+
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  cr4 |= CR4_OSFXSR;
+  if (features & CPUID_SSE)
+    cr4 |= CR4_OSXMMEXCPT;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+
+  write_cr0 ((read_cr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+  ts_set = false;
+  asm volatile ("fninit");
+  if (features & CPUID_SSE)
+    {
+      uint32_t mxcsr = MXCSR_DEFAULT;
+      asm volatile ("ldmxcsr %0" : : "m" (mxcsr));
+    }
+  fxsave (initial_state);
+  set_ts (true);
+
+  intr_register_int (7, 0, INTR_ON, fpu_trap,
+                     "#NM Device Not Available Exception");
+  enabled = true;
+}
+
+/* Returns true if FPU state is switched between threads, false
+   if the FPU is not usable at all. */
+bool
+fpu_available (void)
+{
+  return enabled;
+}
+
+/* Called by schedule_tail() with interrupts off when CUR has
+   just started running.  Lets CUR use the FPU directly if it
+   owns the registers, and arranges for a trap otherwise. */
+void
+fpu_switch (struct thread *cur)
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (enabled)
+    set_ts (cur != owner);
+}
+
+/* #NM handler: the running thread used the FPU while CR0.TS was
+   set.  Saves the owner's registers and loads the running
+   thread's, giving it a save area first if this is its first
+   use. */
+static void
+fpu_trap (struct intr_frame *f)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (f->cs == SEL_KCSEG)
+    PANIC ("kernel used the FPU outside fpu_kernel_begin()");
+
+  if (cur->fpu == NULL)
+    {
+      /* May sleep, and others may take the FPU meanwhile, so
+         nothing about the FPU is decided until afterward. */
+      void *block = malloc (FXSAVE_SIZE + FXSAVE_ALIGN - 1);
+      if (block == NULL)
+        {
+          printf ("%s: out of memory for FPU state\n", thread_name ());
+          thread_exit ();
+        }
+      cur->fpu = block;
+      memcpy (save_area (cur), initial_state, FXSAVE_SIZE);
+    }
+
+  old_level = intr_disable ();
+  set_ts (false);
+  if (owner != cur)
+    {
+      save_owner ();
+      fxrstor (save_area (cur));
+      owner = cur;
+      restore_cnt++;
+    }
+  intr_set_level (old_level);
+}
+
+/* Frees the running thread's FPU save area, if it has one.
+   Called by thread_exit(). */
+void
+fpu_thread_exit (void)
+{
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  if (cur->fpu == NULL)
+    return;
+
+  old_level = intr_disable ();
+  if (owner == cur)
+    {
+      owner = NULL;
+      set_ts (true);
+    }
+  intr_set_level (old_level);
+
+  free (cur->fpu);
+  cur->fpu = NULL;
+}
+
+/* Lets kernel code use FPU and SSE instructions until the
+   matching fpu_kernel_end(), e.g. for a vectorized copy loop.
+   The code in between must be in a function compiled without
+   -msoft-float, or written in assembly, and must not sleep.
+   Interrupts are off in between, so that no other thread can
+   take the FPU; the return value is the previous interrupt
+   level, to pass to fpu_kernel_end().  The registers' previous
+   owner gets them back on its next use. */
+enum intr_level
+fpu_kernel_begin (void)
+{
+  enum intr_level old_level;
+
+  ASSERT (enabled);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  ASSERT (!in_kernel);
+  set_ts (false);
+  save_owner ();
+  in_kernel = true;
+  return old_level;
+}
+
+/* Ends kernel FPU use started by fpu_kernel_begin(), which
+   returned OLD_LEVEL. */
+void
+fpu_kernel_end (enum intr_level old_level)
+{
+  ASSERT (in_kernel);
+
+  in_kernel = false;
+  set_ts (true);
+  intr_set_level (old_level);
+}
+
+/* Prints FPU statistics, if any thread has used the FPU. */
+void
+fpu_print_stats (void)
+{
+  if (restore_cnt > 0)
+    printf ("FPU: %lld lazy restores, %lld saves\n", restore_cnt, save_cnt);
+}
@@ -0,0 +1,36 @@
+#ifndef THREADS_FPU_H
+#define THREADS_FPU_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* Floating-point and SSE state.
+
+   The x87 FPU, MMX, and SSE registers are not saved by
+   switch_threads() or by the interrupt stubs, since the kernel
+   itself is compiled with -msoft-float and never touches them.
+   Instead they are switched lazily: the register contents belong
+   to at most one thread, the FPU owner, and whenever any other
+   thread runs, CR0.TS is set so that its first FPU or SSE
+   instruction raises #NM (Device Not Available).  The #NM handler
+   saves the owner's registers with FXSAVE in the owner's save
+   area, loads the new thread's with FXRSTOR, and makes it the
+   owner.  Threads that never use the FPU never get a save area
+   and never pay for a save or restore.
+
+   A CPU without FXSAVE is left as before, with CR0.EM set, so
+   that FPU instructions in user programs kill the process. */
+
+struct thread;
+
+void fpu_init (void);
+bool fpu_available (void);
+void fpu_switch (struct thread *);
+void fpu_thread_exit (void);
+
+enum intr_level fpu_kernel_begin (void);
+void fpu_kernel_end (enum intr_level);
+
+void fpu_print_stats (void);
+
+#endif /* threads/fpu.h */
@@ -1,29 +1,45 @@
 #include "threads/init.h"
 #include <console.h>
 #include <debug.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <random.h>
+#include <stats.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "devices/binlog.h"
 #include "devices/kbd.h"
 #include "devices/input.h"
+#include "devices/tty.h"
 #include "devices/serial.h"
 #include "devices/timer.h"
 #include "devices/vga.h"
+#include "threads/cpu.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/kstack.h"
+#include "threads/latency.h"
 #include "threads/loader.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/pollwait.h"
+#include "threads/prof.h"
 #include "threads/pte.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/tunable.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
 #include "userprog/gdt.h"
+#include "userprog/pagedir.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
 #else
@@ -34,6 +50,11 @@
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+#endif
 
 /* Amount of physical memory, in 4 kB pages. */
 size_t ram_pages;
@@ -62,6 +83,11 @@ static void run_actions (char **argv);
 static void usage (void);
 
 static void print_stats (void);
+static void dump_request (void);
+static thread_func dump_daemon;
+
+/* Signaled by dump_request() to wake dump_daemon(). */
+static struct semaphore dump_sema;
 
 
 int main (void) NO_RETURN;
@@ -92,7 +118,11 @@ main (void)
 
   palloc_init ();
   malloc_init ();
+  kmem_init ();
   paging_init ();
+  cpu_init ();
+  if (cpu_cnt > 1)
+    printf ("%d CPUs found, running on 1 of them.\n", cpu_cnt);
 
 
 
@@ -104,9 +134,13 @@ main (void)
 
   /* Initialize interrupt handlers. */
   intr_init ();
+  fpu_init ();
   timer_init ();
+  vga_start_flusher ();
+  pollwait_init ();
   kbd_init ();
   input_init ();
+  tty_init ();
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
@@ -114,7 +148,12 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  palloc_start_zeroer ();
+  workqueue_init ();
   serial_init_queue ();
+  sema_init (&dump_sema, 0);
+  thread_create_daemon ("dump", PRI_MAX, dump_daemon, NULL);
+  input_set_dump (dump_request);
   timer_calibrate ();
 
 #ifdef FILESYS
@@ -122,10 +161,15 @@ main (void)
   disk_init ();
   filesys_init (format_filesys);
 #endif
+#ifdef VM
+  frame_init ();
+  swap_init ();
+#endif
 
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
+  tunable_check ();
   run_actions (argv);
 
   /* Finish up. */
@@ -155,7 +199,16 @@ ram_init (void)
 /* Populates the base page directory and page table with the
    kernel virtual mapping, and then sets up the CPU to use the
    new page directory.  Points base_page_dir to the page
-   directory it creates.
+   directory it creates, which also gets the page tables for the
+   kernel stack region.
+
+   If the CPU has 4 MB pages, each 4 MB of RAM that does not
+   hold kernel text is mapped with a single PDE, so the mapping
+   of RAM takes few TLB entries.  Kernel text stays in 4 kB pages
+   so that it can stay read-only.  If the CPU has global pages,
+   every kernel mapping is global, so that switching page
+   directories, which all share the kernel mapping, does not
+   flush it from the TLB.
 
    At the time this function is called, the active page table
    (set up by loader.S) only maps the first 4 MB of RAM, so we
@@ -167,6 +220,9 @@ paging_init (void)
   uint32_t *pd, *pt;
   size_t page;
   extern char _start, _end_kernel_text;
+  uint32_t features = cpu_features ();
+  bool large = (features & CPUID_PSE) != 0;
+  uint32_t cr4;
 
   pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
   pt = NULL;
@@ -178,6 +234,15 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (large && pte_idx == 0
+          && ram_pages - page >= PTSPAN / PGSIZE
+          && (vaddr + PTSPAN <= &_start || vaddr >= &_end_kernel_text))
+        {
+          pd[pde_idx] = pde_create_large_kernel (vaddr);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -187,12 +252,28 @@ paging_init (void)
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* 4 MB pages have to be enabled before the page directory that
+     uses them is loaded. */
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  if (large)
+    cr4 |= CR4_PSE;
+  asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
      to/from Control Registers" and [IA32-v3a] 3.7.5 "Base Address
      of the Page Directory". */
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)));
+
+  /* From here on, loading CR3 flushes only user mappings. */
+  if (features & CPUID_PGE)
+    {
+      cr4 |= CR4_PGE;
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4));
+    }
+
+  kstack_init ();
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -255,6 +336,43 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-ks"))
+        kstack_pages = atoi (value);
+      else if (!strcmp (name, "-lat"))
+        latency_enable ();
+#ifdef USERPROG
+      else if (!strcmp (name, "-rusage"))
+        process_rusage_report = true;
+#endif
+      else if (!strcmp (name, "-binlog"))
+        {
+          if (!binlog_init ())
+            printf ("No second serial port: -binlog ignored.\n");
+        }
+      else if (!strcmp (name, "-o"))
+        {
+          if (value == NULL && argv[1] != NULL)
+            value = *++argv;
+          if (!tunable_set (value))
+            PANIC ("bad -o setting (use -h for help)");
+        }
+      else if (!strcmp (name, "-tsc"))
+        {
+          if (!timer_set_tsc_hz (value))
+            PANIC ("bad -tsc rate (use -h for help)");
+        }
+      else if (!strcmp (name, "-prof"))
+        prof_enable (value != NULL ? atoi (value) : 0);
+      else if (!strcmp (name, "-log"))
+        {
+          if (value == NULL || !log_configure (value))
+            PANIC ("bad -log subsystem list (use -h for help)");
+        }
+      else if (!strcmp (name, "-trace"))
+        {
+          if (value == NULL || !trace_enable (value))
+            PANIC ("bad -trace event list (use -h for help)");
+        }
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -262,6 +380,10 @@ parse_options (char **argv)
         free_page_limit = atoi (value);
       else if (!strcmp (name, "-tcl")) // klaar@ida
         thread_create_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        stack_page_limit = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -285,6 +407,100 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Memory in use, for run_batch()'s leak check. */
+struct batch_usage
+  {
+    unsigned kernel_pages;      /* Kernel pool pages in use. */
+    unsigned user_pages;        /* User pool pages in use. */
+    unsigned malloc_pages;      /* Pages of malloc() arenas and big blocks. */
+  };
+
+static void
+batch_usage (struct batch_usage *u)
+{
+  struct stats s;
+
+  palloc_get_stats (&s);
+  malloc_get_stats (&s);
+  u->kernel_pages = s.kernel_pages - s.kernel_free_pages;
+  u->user_pages = s.user_pages - s.user_free_pages;
+  u->malloc_pages = s.malloc_arenas + s.malloc_big_pages;
+}
+
+static bool
+batch_usage_equal (const struct batch_usage *a, const struct batch_usage *b)
+{
+  return (a->kernel_pages == b->kernel_pages
+          && a->user_pages == b->user_pages
+          && a->malloc_pages == b->malloc_pages);
+}
+
+/* Runs each of the tasks in ARGV[1], separated by semicolons, in
+   turn, as the "run" action would, in one boot.  Each task's
+   output lies between the usual "Executing" and "Execution ...
+   complete" lines, so that it can still be checked on its own.
+   Before and after each one, a "batch:" line gives its number and
+   its exit status, and the pages in use are compared with those
+   before it started, to report pages that it leaked.  Caches such
+   as the buffer cache and idle inodes may grow on a first run, so
+   a leak that shows up once is only a hint; one that shows up on
+   every run of the same task is a real leak. */
+static void
+run_batch (char **argv)
+{
+  char *save_ptr, *task;
+  int task_cnt = 0, failed_cnt = 0, leak_cnt = 0;
+
+  for (task = strtok_r (argv[1], ";", &save_ptr); task != NULL;
+       task = strtok_r (NULL, ";", &save_ptr))
+    {
+      struct batch_usage before, after;
+      int status = 0;
+      int i;
+
+      while (*task == ' ')
+        task++;
+      if (*task == '\0')
+        continue;
+      task_cnt++;
+
+      batch_usage (&before);
+      printf ("batch: begin %d '%s'\n", task_cnt, task);
+      printf ("Executing '%s':\n", task);
+#ifdef USERPROG
+      status = process_wait (process_execute (task));
+#else
+      run_test (task);
+#endif
+      printf ("Execution of '%s' complete.\n", task);
+
+      /* The process may still be freeing its pages when its parent
+         sees it exit, so give it a moment before calling it a
+         leak. */
+      for (i = 0; ; i++)
+        {
+          batch_usage (&after);
+          if (batch_usage_equal (&before, &after) || i == 10)
+            break;
+          timer_msleep (10);
+        }
+      printf ("batch: end %d '%s' exit %d\n", task_cnt, task, status);
+      if (status != 0)
+        failed_cnt++;
+      if (!batch_usage_equal (&before, &after))
+        {
+          printf ("batch: '%s' leaked %d kernel pages, %d user pages, "
+                  "%d malloc pages\n", task,
+                  (int) (after.kernel_pages - before.kernel_pages),
+                  (int) (after.user_pages - before.user_pages),
+                  (int) (after.malloc_pages - before.malloc_pages));
+          leak_cnt++;
+        }
+    }
+  printf ("batch: %d tasks, %d with nonzero exit, %d leaking\n",
+          task_cnt, failed_cnt, leak_cnt);
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -302,12 +518,14 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"run-batch", 2, run_batch},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
       {"rm", 2, fsutil_rm},
       {"put", 2, fsutil_put},
       {"get", 2, fsutil_get},
+      {"extract", 1, fsutil_extract},
 #endif
       {NULL, 0, NULL},
     };
@@ -347,8 +565,11 @@ usage (void)
           "\nAvailable actions:\n"
 #ifdef USERPROG
           "  run 'PROG [ARG...]' Run PROG and wait for it to complete.\n"
+          "  run-batch 'PROG [ARG...];...'\n"
+          "                     Run each PROG in turn, checking for leaks.\n"
 #else
           "  run TEST           Run TEST.\n"
+          "  run-batch 'TEST;...' Run each TEST in turn, checking for leaks.\n"
 #endif
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
@@ -357,6 +578,7 @@ usage (void)
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  put FILE           Put FILE into file system from scratch disk.\n"
           "  get FILE           Get FILE from file system into scratch disk.\n"
+          "  extract            Extract ustar archive from scratch disk.\n"
 #endif
           "\nOptions:\n"
           "  -h                 Print this help message and power off.\n"
@@ -365,11 +587,36 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -ks=PAGES          Give each kernel stack PAGES pages (default 2).\n"
+          "  -prof[=DEPTH]      Profile, recording DEPTH callers per sample.\n"
+          "  -lat               Measure interrupts-off and wakeup latency.\n"
+#ifdef USERPROG
+          "  -rusage            Print each process's resource usage at exit.\n"
+#endif
+          "  -binlog            Send trace and profile dumps to COM2, in binary.\n"
+          "  -tsc=HZ            Take the TSC rate as HZ instead of measuring it.\n"
+          "  -o NAME=VALUE,...  Set tunables: hz time_slice time_slice_low\n"
+          "                     workers read_ahead cache_sectors idle_inodes\n"
+          "                     swap_cluster zswap_pages fair_share\n"
+          "                     defrag_secs.\n"
+          "  -trace=EVENT,...   Trace EVENTs (or `all') and dump at power off.\n"
+          "                     Events: sched block unblock syscall sysret\n"
+          "                     disk-read disk-write disk-done fault lock-wait\n"
+          "                     lock exec\n"
+          "  -log=SUBSYS[:LEVEL],...\n"
+          "                     Log SUBSYS (or `all') at LEVEL: off error info\n"
+          "                     debug (default).  Subsystems: misc thread\n"
+          "                     process syscall plist flist\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
           "  -fl=COUNT          Limit free memory to COUNT pages.\n"
           "  -tcl=N             Fail at call N to thread_create.\n"
 #endif
+#ifdef VM
+          "  -sl=COUNT          Limit user stacks to COUNT pages.\n"
+#endif
+          "\nWhile running, type Ctrl+T on the keyboard or serial port\n"
+          "to print the threads, statistics and trace.\n"
           );
 
   /* klaar@ida disabled due to threads and locks not initialized
@@ -395,8 +642,15 @@ power_off (void)
 #endif
 
   print_stats ();
+  if (prof_enabled)
+    prof_print ();
+  if (latency_enabled)
+    latency_print ();
+  if (trace_mask != 0)
+    trace_dump ();
 
   printf ("Powering off...\n");
+  vga_flush ();
   serial_flush ();
 
   /* klaar,filst 2014-01
@@ -415,12 +669,50 @@ power_off (void)
   for (;;);
 }
 
+/* Asks dump_daemon() for a status dump.  Called in interrupt
+   context when INPUT_DUMP_KEY is typed. */
+static void
+dump_request (void) 
+{
+  sema_up (&dump_sema);
+}
+
+/* Prints the thread list, the statistics, and the trace ring if
+   tracing, each time INPUT_DUMP_KEY is typed.  It runs as a
+   thread, so the rest of the kernel keeps running meanwhile;
+   only the trace is paused while it is printed.  This shows what
+   a wedged or slow run is doing without rebooting it. */
+static void
+dump_daemon (void *aux UNUSED) 
+{
+  for (;;)
+    {
+      sema_down (&dump_sema);
+      printf ("# Status dump at tick %"PRId64"\n", timer_ticks ());
+      thread_print_list ();
+      print_stats ();
+      if (trace_mask != 0)
+        trace_dump ();
+      printf ("# End of status dump\n");
+    }
+}
+
 /* Print statistics about Pintos execution. */
 static void
 print_stats (void) 
 {
+  tunable_print_stats ();
+  intr_print_stats ();
   timer_print_stats ();
   thread_print_stats ();
+  cpu_print_stats ();
+  fpu_print_stats ();
+  synch_print_stats ();
+  palloc_print_stats ();
+  kstack_print_stats ();
+  workqueue_print_stats ();
+  malloc_print_stats ();
+  kmem_print_stats ();
 #ifdef FILESYS
   disk_print_stats ();
 #endif
@@ -428,5 +720,12 @@ print_stats (void)
   kbd_print_stats ();
 #ifdef USERPROG
   exception_print_stats ();
+  syscall_print_stats ();
+  pagedir_print_stats ();
+#endif
+#ifdef VM
+  frame_print_stats ();
+  page_print_stats ();
+  swap_print_stats ();
 #endif
 }
@@ -1,14 +1,21 @@
 #include "threads/interrupt.h"
 #include <debug.h>
 #include <inttypes.h>
+#include <stats.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/latency.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/gdt.h"
+#include "userprog/process.h"
+#endif
 
 /* Number of x86 interrupts. */
 #define INTR_CNT 256
@@ -25,27 +32,44 @@ static intr_handler_func *intr_handlers[INTR_CNT];
 /* Names for each interrupt, for debugging purposes. */
 static const char *intr_names[INTR_CNT];
 
+/* Counters for each interrupt, kept by intr_handler().  Only
+   external interrupts have their cycles counted, since internal
+   ones, such as system calls and page faults, may sleep. */
+static struct intr_stats intr_counters[INTR_CNT];
+
 /* External interrupts are those generated by devices outside the
    CPU, such as the timer.  External interrupts run with
    interrupts turned off, so they never nest, nor are they ever
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
+   interrupt returns.
+
+   A handler may also defer work to a bottom half, which runs
+   after the interrupt is acknowledged, with interrupts back on,
+   so that the next interrupt need not wait for it.  Bottom halves
+   count as interrupt context: they may not sleep either, and a
+   yield they cause waits until they have all run.  Interrupts
+   that arrive while bottom halves run leave their own bottom
+   halves, and any yield, to the outermost interrupt. */
 static bool in_external_intr;   /* Are we processing an external interrupt? */
+static bool in_bottom_half;     /* Are we running bottom halves? */
 static bool yield_on_return;    /* Should we yield on interrupt return? */
+static struct list pending_bottoms; /* Bottom halves waiting to run. */
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
 
 /* Interrupt Descriptor Table helpers. */
+static enum intr_level disable_from (void *caller);
 static uint64_t make_intr_gate (void (*) (void), int dpl);
 static uint64_t make_trap_gate (void (*) (void), int dpl);
 static inline uint64_t make_idtr_operand (uint16_t limit, void *base);
 
 /* Interrupt handlers. */
 void intr_handler (struct intr_frame *args);
+static void count_cycles (struct intr_stats *, uint64_t cycles);
 
 /* Returns the current interrupt status. */
 enum intr_level
@@ -67,7 +91,9 @@ intr_get_level (void)
 enum intr_level
 intr_set_level (enum intr_level level) 
 {
-  return level == INTR_ON ? intr_enable () : intr_disable ();
+  return (level == INTR_ON
+          ? intr_enable ()
+          : disable_from (__builtin_return_address (0)));
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
@@ -75,7 +101,10 @@ enum intr_level
 intr_enable (void) 
 {
   enum intr_level old_level = intr_get_level ();
-  ASSERT (!intr_context ());
+  ASSERT (!in_external_intr);
+
+  if (latency_enabled && old_level == INTR_OFF)
+    latency_intr_on ();
 
   /* Enable interrupts by setting the interrupt flag.
 
@@ -89,6 +118,14 @@ intr_enable (void)
 /* Disables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_disable (void) 
+{
+  return disable_from (__builtin_return_address (0));
+}
+
+/* Does the work of intr_disable() on behalf of CALLER, to whom
+   -lat charges the time interrupts then stay off. */
+static enum intr_level
+disable_from (void *caller)
 {
   enum intr_level old_level = intr_get_level ();
 
@@ -97,6 +134,8 @@ intr_disable (void)
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
 
+  if (latency_enabled && old_level == INTR_ON)
+    latency_intr_off (caller);
   return old_level;
 }
 
@@ -109,6 +148,7 @@ intr_init (void)
 
   /* Initialize interrupt controller. */
   pic_init ();
+  list_init (&pending_bottoms);
 
   /* Initialize IDT. */
   for (i = 0; i < INTR_CNT; i++)
@@ -193,18 +233,39 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
   register_handler (vec_no, dpl, level, handler, name);
 }
 
-/* Returns true during processing of an external interrupt
-   and false at all other times. */
+/* Registers internal interrupt VEC_NO to switch to the task
+   whose TSS has selector TSS_SEL, for the few exceptions that
+   cannot be handled on the stack that raised them.  The task
+   must not return.  The interrupt is named NAME for debugging
+   purposes.  See [IA32-v3a] 6.3 "Task Switching". */
+void
+intr_register_task (uint8_t vec_no, uint16_t tss_sel, const char *name)
+{
+  uint32_t e0, e1;
+
+  ASSERT (vec_no < 0x20);
+  ASSERT (intr_handlers[vec_no] == NULL);
+
+  e0 = (uint32_t) tss_sel << 16;           /* TSS segment selector. */
+  e1 = ((1 << 15)                          /* Present. */
+        | (0 << 13)                        /* Descriptor privilege level. */
+        | (5 << 8));                       /* Task gate. */
+  idt[vec_no] = e0 | ((uint64_t) e1 << 32);
+  intr_names[vec_no] = name;
+}
+
+/* Returns true during processing of an external interrupt,
+   including its bottom halves, and false at all other times. */
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  return in_external_intr || in_bottom_half;
 }
 
 /* During processing of an external interrupt, directs the
    interrupt handler to yield to a new process just before
-   returning from the interrupt.  May not be called at any other
-   time. */
+   returning from the interrupt, after any bottom halves.  May
+   not be called at any other time. */
 void
 intr_yield_on_return (void) 
 {
@@ -212,6 +273,60 @@ intr_yield_on_return (void)
   yield_on_return = true;
 }
 
+/* Initializes bottom half B to call FUNC with AUX. */
+void
+intr_bottom_init (struct intr_bottom *b, intr_bottom_func *func, void *aux) 
+{
+  ASSERT (b != NULL);
+  ASSERT (func != NULL);
+
+  b->func = func;
+  b->aux = aux;
+  b->pending = false;
+}
+
+/* Arranges for bottom half B to run before the current external
+   interrupt returns.  Does nothing if B is already pending, so
+   one run of B must handle everything scheduled since it last
+   ran.  May only be called from an external interrupt handler or
+   a bottom half. */
+void
+intr_schedule_bottom (struct intr_bottom *b) 
+{
+  enum intr_level old_level;
+
+  ASSERT (intr_context ());
+
+  old_level = intr_disable ();
+  if (!b->pending) 
+    {
+      b->pending = true;
+      list_push_back (&pending_bottoms, &b->elem);
+    }
+  intr_set_level (old_level);
+}
+
+/* Runs pending bottom halves, with interrupts on, until none is
+   left.  Interrupts must be off on entry and are off on return. */
+static void
+run_bottom_halves (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!in_bottom_half);
+
+  in_bottom_half = true;
+  while (!list_empty (&pending_bottoms)) 
+    {
+      struct intr_bottom *b = list_entry (list_pop_front (&pending_bottoms),
+                                          struct intr_bottom, elem);
+      b->pending = false;
+      intr_enable ();
+      b->func (b->aux);
+      intr_disable ();
+    }
+  in_bottom_half = false;
+}
+
 /* 8259A Programmable Interrupt Controller. */
 
 /* Every PC has two 8259A Programmable Interrupt Controller (PIC)
@@ -331,6 +446,15 @@ make_idtr_operand (uint16_t limit, void *base)
 
 /* Interrupt handlers. */
 
+/* Adds CYCLES, spent handling one interrupt, to S. */
+static void
+count_cycles (struct intr_stats *s, uint64_t cycles) 
+{
+  s->cycles += cycles;
+  if (cycles > s->max_cycles)
+    s->max_cycles = cycles;
+}
+
 /* Handler for all interrupts, faults, and exceptions.  This
    function is called by the assembly language interrupt stubs in
    intr-stubs.S.  FRAME describes the interrupt and the
@@ -338,21 +462,30 @@ make_idtr_operand (uint16_t limit, void *base)
 void
 intr_handler (struct intr_frame *frame) 
 {
+  struct intr_stats *s = &intr_counters[frame->vec_no];
   bool external;
   intr_handler_func *handler;
+  uint64_t start = 0;
+
+  s->cnt++;
 
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
      and they need to be acknowledged on the PIC (see below).
      An external interrupt handler cannot sleep. */
+  if (latency_enabled)
+    latency_intr_entry (frame);
+
   external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
-      ASSERT (!intr_context ());
+      ASSERT (!in_external_intr);
 
       in_external_intr = true;
-      yield_on_return = false;
+      if (!in_bottom_half)
+        yield_on_return = false;
+      start = read_tsc ();
     }
 
   /* Invoke the interrupt's handler. */
@@ -382,9 +515,29 @@ intr_handler (struct intr_frame *frame)
       in_external_intr = false;
       pic_end_of_interrupt (frame->vec_no); 
 
+      /* If we interrupted bottom halves, the interrupt they belong
+         to runs ours and yields when they are done. */
+      if (!in_bottom_half && !list_empty (&pending_bottoms))
+        run_bottom_halves ();
+      count_cycles (s, read_tsc () - start);
+      if (in_bottom_half)
+        return;
       if (yield_on_return) 
-        thread_yield (); 
+        {
+          s->yield_cnt++;
+          thread_yield_preempted (); 
+        }
+    }
+
+#ifdef USERPROG
+  /* A thread of an exiting process exits instead of going back
+     to user mode. */
+  if (frame->cs == SEL_UCSEG && process_exiting ())
+    {
+      intr_enable ();
+      thread_exit ();
     }
+#endif
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
@@ -400,7 +553,7 @@ intr_dump_frame (const struct intr_frame *f)
      (#PF)". */
   asm ("movl %%cr2, %0" : "=r" (cr2));
 
-  printf ("Interrupt %#04x (%s) at eip=%p\n",
+  printf ("Interrupt 0x%02x (%s) at eip=%p\n",
           f->vec_no, intr_names[f->vec_no], f->eip);
   printf (" cr2=%08"PRIx32" error=%08"PRIx32"\n", cr2, f->error_code);
   printf (" eax=%08"PRIx32" ebx=%08"PRIx32" ecx=%08"PRIx32" edx=%08"PRIx32"\n",
@@ -417,3 +570,36 @@ intr_name (uint8_t vec)
 {
   return intr_names[vec];
 }
+
+/* Fills in the interrupt fields of *S. */
+void
+intr_get_stats (struct stats *s) 
+{
+  enum intr_level old_level = intr_disable ();
+  memcpy (s->irqs, &intr_counters[0x20], sizeof s->irqs);
+  intr_set_level (old_level);
+}
+
+/* Prints how many times each interrupt that happened did and,
+   for external interrupts, the cycles they took and the yields
+   they ended in. */
+void
+intr_print_stats (void) 
+{
+  int i;
+
+  for (i = 0; i < INTR_CNT; i++) 
+    {
+      const struct intr_stats *s = &intr_counters[i];
+
+      if (s->cnt == 0)
+        continue;
+      if (i >= 0x20 && i < 0x30)
+        printf ("Interrupt 0x%02x (%s): %lld, %"PRIu64" cycles avg, "
+                "%"PRIu64" max, %lld yields\n",
+                i, intr_names[i], s->cnt, s->cycles / s->cnt,
+                s->max_cycles, s->yield_cnt);
+      else
+        printf ("Interrupt 0x%02x (%s): %lld\n", i, intr_names[i], s->cnt);
+    }
+}
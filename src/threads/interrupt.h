@@ -1,6 +1,7 @@
 #ifndef THREADS_INTERRUPT_H
 #define THREADS_INTERRUPT_H
 
+#include <list.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -61,10 +62,32 @@ void intr_init (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
+void intr_register_task (uint8_t vec, uint16_t tss_sel, const char *name);
 bool intr_context (void);
 void intr_yield_on_return (void);
 
+/* A bottom half: work that an external interrupt handler defers
+   until the interrupt is about to return, when it runs with
+   interrupts on.  The handler itself ("top half") need then only
+   acknowledge the device and grab whatever the device will not
+   hold on to.  Like a handler, a bottom half may not sleep. */
+typedef void intr_bottom_func (void *aux);
+struct intr_bottom
+  {
+    struct list_elem elem;      /* Element in pending list. */
+    intr_bottom_func *func;     /* Function to call. */
+    void *aux;                  /* Passed to FUNC. */
+    bool pending;               /* On the pending list? */
+  };
+
+void intr_bottom_init (struct intr_bottom *, intr_bottom_func *, void *aux);
+void intr_schedule_bottom (struct intr_bottom *);
+
 void intr_dump_frame (const struct intr_frame *);
 const char *intr_name (uint8_t vec);
 
+struct stats;
+void intr_get_stats (struct stats *);
+void intr_print_stats (void);
+
 #endif /* threads/interrupt.h */
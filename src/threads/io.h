@@ -170,4 +170,14 @@ outsl (uint16_t port, const void *addr, size_t cnt)
                 : "cc");
 }
 
+/* Returns the CPU's time stamp counter. */
+static inline uint64_t
+read_tsc (void) 
+{
+  uint64_t tsc;
+  /* See [IA32-v2b] "RDTSC". */
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 #endif /* threads/io.h */
@@ -0,0 +1,211 @@
+#include "threads/kstack.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "threads/cpu.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/spinlock.h"
+
+/* Pages mapped for each stack. */
+int kstack_pages = 2;
+
+/* Page table entries for the whole region, in one run of page
+   tables, so that the entry for the page at VADDR is
+   ptes[pg_no (VADDR - KSTACK_BASE)]. */
+static uint32_t *ptes;
+
+/* Slots in use.  Stacks are freed by schedule_tail() with
+   interrupts off, so this is protected by a spin lock. */
+static struct bitmap *used_slots;
+static struct spinlock slots_lock;
+
+/* Recently freed stacks, still mapped, so that creating a thread
+   soon after another one exited needs neither the page allocator
+   nor the page tables, nor zeroing the pages.  Each CPU has its
+   own cache, used only with interrupts off. */
+#define CACHE_CNT 4
+struct stack_cache
+  {
+    void *tops[CACHE_CNT];      /* Tops of cached stacks. */
+    int cnt;                    /* Number of stacks in TOPS. */
+  };
+static struct stack_cache caches[CPU_MAX];
+
+/* Statistics. */
+static long long alloc_cnt;     /* Stacks allocated. */
+static long long cached_cnt;    /* Of those, taken from a cache. */
+
+static void release (uint8_t *top);
+static palloc_shrink_func shrink;
+
+/* Returns the page table entry for kernel stack page VADDR. */
+static uint32_t *
+lookup_pte (const uint8_t *vaddr)
+{
+  ASSERT (kstack_contains (vaddr));
+  return &ptes[((uintptr_t) vaddr - (uintptr_t) KSTACK_BASE) >> PGBITS];
+}
+
+/* Creates the page tables for the kernel stack region in
+   base_page_dir.  Must be called by paging_init(), before any
+   page directory is copied from base_page_dir, so that every
+   page directory shares them. */
+void
+kstack_init (void)
+{
+  size_t pt_cnt = KSTACK_REGION_SIZE / PGSIZE / (PGSIZE / sizeof *ptes);
+  size_t i;
+
+  if (kstack_pages < 1 || kstack_pages > KSTACK_MAX_PAGES)
+    PANIC ("-ks must be between 1 and %d", KSTACK_MAX_PAGES);
+  ASSERT ((uint8_t *) ptov (ram_pages * PGSIZE) <= KSTACK_BASE);
+
+  ptes = palloc_get_multiple (PAL_ASSERT | PAL_ZERO, pt_cnt);
+  for (i = 0; i < pt_cnt; i++)
+    base_page_dir[pd_no (KSTACK_BASE) + i]
+      = pde_create (ptes + i * (PGSIZE / sizeof *ptes));
+
+  used_slots = bitmap_create (KSTACK_SLOT_CNT);
+  if (used_slots == NULL)
+    PANIC ("out of memory for kernel stack slots");
+  spin_init (&slots_lock);
+  palloc_register_shrinker ("kstack", shrink);
+}
+
+/* Allocates a kernel stack and returns its top, or a null
+   pointer if no slot or not enough memory is left.  The stack's
+   contents are arbitrary. */
+void *
+kstack_alloc (void)
+{
+  enum intr_level old_level;
+  struct stack_cache *c;
+  size_t slot;
+  uint8_t *top;
+  int i;
+
+  old_level = intr_disable ();
+  alloc_cnt++;
+  c = &caches[cpu_current ()->id];
+  if (c->cnt > 0)
+    {
+      top = c->tops[--c->cnt];
+      cached_cnt++;
+      intr_set_level (old_level);
+      return top;
+    }
+  intr_set_level (old_level);
+
+  old_level = spin_lock_irqsave (&slots_lock);
+  slot = bitmap_scan_and_flip (used_slots, 0, 1, false);
+  spin_unlock_irqrestore (&slots_lock, old_level);
+  if (slot == BITMAP_ERROR)
+    return NULL;
+
+  top = KSTACK_BASE + (slot + 1) * KSTACK_SLOT_SIZE;
+  for (i = 1; i <= kstack_pages; i++)
+    {
+      void *page = palloc_get_page (0);
+      if (page == NULL)
+        {
+          release (top);
+          return NULL;
+        }
+      *lookup_pte (top - i * PGSIZE) = pte_create_kernel (page, true);
+    }
+  return top;
+}
+
+/* Frees the kernel stack whose top is TOP, keeping it in this
+   CPU's cache if there is room.  May be called with interrupts
+   off, but not on the stack being freed. */
+void
+kstack_free (void *top_)
+{
+  uint8_t *top = top_;
+  enum intr_level old_level;
+  struct stack_cache *c;
+
+  ASSERT (kstack_contains (top - 1) && kstack_slot_top (top - 1) == top);
+
+  old_level = intr_disable ();
+  c = &caches[cpu_current ()->id];
+  if (c->cnt < CACHE_CNT)
+    {
+      c->tops[c->cnt++] = top;
+      top = NULL;
+    }
+  intr_set_level (old_level);
+
+  if (top != NULL)
+    release (top);
+}
+
+/* Unmaps and frees the pages of the stack whose top is TOP, if
+   any, and frees its slot. */
+static void
+release (uint8_t *top)
+{
+  enum intr_level old_level;
+  int i;
+
+  for (i = 1; i <= KSTACK_MAX_PAGES; i++)
+    {
+      uint8_t *vaddr = top - i * PGSIZE;
+      uint32_t *pte = lookup_pte (vaddr);
+      if (*pte & PTE_P)
+        {
+          void *page = pte_get_page (*pte);
+          *pte = 0;
+          asm volatile ("invlpg %0" : : "m" (*vaddr) : "memory");
+          palloc_free_page (page);
+        }
+    }
+
+  old_level = spin_lock_irqsave (&slots_lock);
+  bitmap_reset (used_slots, (top - KSTACK_BASE) / KSTACK_SLOT_SIZE - 1);
+  spin_unlock_irqrestore (&slots_lock, old_level);
+}
+
+/* Frees this CPU's cached stacks until PAGE_CNT pages have been
+   given back, and returns the number of pages freed.  Called by
+   the page allocator when memory is short. */
+static size_t
+shrink (size_t page_cnt)
+{
+  size_t freed = 0;
+
+  while (freed < page_cnt)
+    {
+      enum intr_level old_level = intr_disable ();
+      struct stack_cache *c = &caches[cpu_current ()->id];
+      uint8_t *top = c->cnt > 0 ? c->tops[--c->cnt] : NULL;
+      intr_set_level (old_level);
+
+      if (top == NULL)
+        break;
+      release (top);
+      freed += kstack_pages;
+    }
+  return freed;
+}
+
+/* Prints kernel stack statistics. */
+void
+kstack_print_stats (void)
+{
+  printf ("Kernel stacks: %lld allocated, %lld from cache\n",
+          alloc_cnt, cached_cnt);
+}
+
+/* Returns true if P is in the guard area below some kernel
+   stack, which is where a stack that overflowed faults. */
+bool
+kstack_is_guard (const void *p)
+{
+  return (kstack_contains (p)
+          && (uint8_t *) p < ((uint8_t *) kstack_slot_top (p)
+                              - kstack_pages * PGSIZE));
+}
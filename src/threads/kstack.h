@@ -0,0 +1,56 @@
+#ifndef THREADS_KSTACK_H
+#define THREADS_KSTACK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/vaddr.h"
+
+/* Kernel thread stacks.
+
+   Each thread's kernel stack lives in its own slot of a region
+   of kernel virtual memory above the mapping of physical RAM.
+   Only the top KSTACK_PAGES pages of a slot are mapped; the rest
+   of it, at least one page, is left unmapped as a guard, so a
+   stack that overflows faults instead of running into whatever
+   lies below it.  The thread's struct thread sits at the very
+   top of its slot, above the stack, where an overflow cannot
+   reach it.
+
+   Slots are KSTACK_SLOT_SIZE bytes and aligned to that size, so
+   the slot of any address on a stack, and with it the running
+   thread, is found by rounding the stack pointer. */
+
+/* Kernel stack region. */
+#define KSTACK_BASE ((uint8_t *) PHYS_BASE + 0x30000000)
+#define KSTACK_SLOT_SIZE (8 * PGSIZE)
+#define KSTACK_SLOT_CNT 1024
+#define KSTACK_REGION_SIZE (KSTACK_SLOT_SIZE * KSTACK_SLOT_CNT)
+
+/* Largest usable stack, leaving one guard page per slot. */
+#define KSTACK_MAX_PAGES (KSTACK_SLOT_SIZE / PGSIZE - 1)
+
+/* Pages mapped for each stack, set by the -ks option. */
+extern int kstack_pages;
+
+void kstack_init (void);
+void *kstack_alloc (void);
+void kstack_free (void *top);
+bool kstack_is_guard (const void *);
+void kstack_print_stats (void);
+
+/* Returns true if P lies in the kernel stack region. */
+static inline bool
+kstack_contains (const void *p)
+{
+  return (uintptr_t) p - (uintptr_t) KSTACK_BASE < KSTACK_REGION_SIZE;
+}
+
+/* Returns the top of the slot containing P, which must be in the
+   kernel stack region. */
+static inline void *
+kstack_slot_top (const void *p)
+{
+  return (void *) (((uintptr_t) p | (KSTACK_SLOT_SIZE - 1)) + 1);
+}
+
+#endif /* threads/kstack.h */
@@ -0,0 +1,214 @@
+#include "threads/latency.h"
+#include <debug.h>
+#include <div64.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/flags.h"
+#include "threads/io.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Latency statistics.
+
+   With -lat, the kernel measures how long interrupts stay off
+   and how long a thread waits to run once it is woken, both with
+   the time stamp counter.
+
+   An interrupts-off window starts when intr_disable() turns
+   interrupts off and ends when intr_enable() or intr_set_level()
+   turns them back on.  It is charged to the code that called
+   intr_disable(), even if the window spans a thread switch and
+   another thread ends it.  Windows opened by the CPU itself on
+   entry to an interrupt handler are not counted.
+
+   Wakeup latency runs from thread_unblock() to the thread's
+   schedule_tail(), and is kept both for all threads and for
+   threads above PRI_DEFAULT, whose latency is what preemption is
+   supposed to keep short. */
+
+/* Number of distinct intr_disable() callers tracked.  Windows
+   from callers that find the table full are counted only in the
+   totals. */
+#define SITE_CNT 64
+
+/* Number of callers printed, longest window first. */
+#define SITE_PRINT_CNT 10
+
+/* Durations of a kind of event, in TSC cycles. */
+struct span_stats
+  {
+    uint32_t cnt;               /* Events. */
+    uint64_t total;             /* Sum of durations. */
+    uint64_t max;               /* Longest duration. */
+  };
+
+/* Interrupts-off windows opened by one caller. */
+struct site
+  {
+    void *caller;               /* Return address; null if unused. */
+    struct span_stats stats;
+  };
+
+bool latency_enabled;
+
+/* Current interrupts-off window, if OFF_SINCE is nonzero. */
+static uint64_t off_since;
+static void *off_caller;
+
+static struct site sites[SITE_CNT];
+static struct span_stats off_stats;     /* All windows. */
+static struct span_stats wake_stats;    /* All wakeups. */
+static struct span_stats high_stats;    /* Wakeups above PRI_DEFAULT. */
+
+/* Starts measuring. */
+void
+latency_enable (void)
+{
+  latency_enabled = true;
+}
+
+/* Adds an event of the given DURATION to S. */
+static void
+add_span (struct span_stats *s, uint64_t duration)
+{
+  s->cnt++;
+  s->total += duration;
+  if (duration > s->max)
+    s->max = duration;
+}
+
+/* Returns the site for CALLER, or a null pointer if the table is
+   full. */
+static struct site *
+find_site (void *caller)
+{
+  unsigned i = ((uintptr_t) caller >> 2) % SITE_CNT;
+  unsigned n;
+
+  for (n = 0; n < SITE_CNT; n++, i = (i + 1) % SITE_CNT)
+    {
+      struct site *s = &sites[i];
+      if (s->caller == caller)
+        return s;
+      if (s->caller == NULL)
+        {
+          s->caller = caller;
+          return s;
+        }
+    }
+  return NULL;
+}
+
+/* Called by intr_disable() when it turns interrupts off, on
+   behalf of CALLER. */
+void
+latency_intr_off (void *caller)
+{
+  off_since = read_tsc ();
+  off_caller = caller;
+}
+
+/* Called by intr_enable() just before it turns interrupts back
+   on. */
+void
+latency_intr_on (void)
+{
+  if (off_since != 0)
+    {
+      uint64_t duration = read_tsc () - off_since;
+      struct site *s = find_site (off_caller);
+
+      add_span (&off_stats, duration);
+      if (s != NULL)
+        add_span (&s->stats, duration);
+      off_since = 0;
+    }
+}
+
+/* Called on entry to every interrupt handler.  If the interrupt
+   arrived with interrupts on, whatever window was open has
+   already ended, without intr_enable() noticing. */
+void
+latency_intr_entry (const struct intr_frame *f)
+{
+  if (f->eflags & FLAG_IF)
+    off_since = 0;
+}
+
+/* Called by thread_unblock() with interrupts off when T is made
+   ready. */
+void
+latency_wakeup (struct thread *t)
+{
+  t->wakeup_tsc = read_tsc ();
+}
+
+/* Called by schedule_tail() with interrupts off when T starts
+   running. */
+void
+latency_run (struct thread *t)
+{
+  if (t->wakeup_tsc != 0)
+    {
+      uint64_t duration = read_tsc () - t->wakeup_tsc;
+
+      add_span (&wake_stats, duration);
+      if (t->priority > PRI_DEFAULT)
+        add_span (&high_stats, duration);
+      t->wakeup_tsc = 0;
+    }
+}
+
+/* Converts CYCLES to microseconds, or leaves it in cycles if the
+   TSC rate is unknown. */
+static uint64_t
+to_us (uint64_t cycles)
+{
+  uint32_t mhz = timer_tsc_hz () / 1000000;
+  return mhz != 0 ? div64_32 (cycles, mhz, NULL) : cycles;
+}
+
+/* Prints S, named NAME, counting UNIT. */
+static void
+print_span (const char *name, const struct span_stats *s, const char *unit)
+{
+  uint64_t avg = s->cnt != 0 ? div64_32 (s->total, s->cnt, NULL) : 0;
+
+  printf ("%s: %"PRIu32" %s, avg %"PRIu64", max %"PRIu64" %s\n",
+          name, s->cnt, unit, to_us (avg), to_us (s->max),
+          timer_tsc_hz () / 1000000 != 0 ? "us" : "cycles");
+}
+
+/* Prints the latency statistics, including the callers of
+   intr_disable() whose windows were longest.  Their addresses
+   can be turned into function names with utils/backtrace. */
+void
+latency_print (void)
+{
+  bool printed[SITE_CNT] = { false };
+  int n;
+
+  /* Printing turns interrupts off too. */
+  latency_enabled = false;
+
+  print_span ("Interrupts off", &off_stats, "windows");
+  for (n = 0; n < SITE_PRINT_CNT; n++)
+    {
+      struct site *longest = NULL;
+      int i;
+
+      for (i = 0; i < SITE_CNT; i++)
+        if (sites[i].caller != NULL && !printed[i]
+            && (longest == NULL || sites[i].stats.max > longest->stats.max))
+          longest = &sites[i];
+      if (longest == NULL)
+        break;
+      printed[longest - sites] = true;
+
+      printf ("  %p", longest->caller);
+      print_span ("", &longest->stats, "windows");
+    }
+  print_span ("Wakeup latency", &wake_stats, "wakeups");
+  print_span ("Wakeup latency above PRI_DEFAULT", &high_stats, "wakeups");
+}
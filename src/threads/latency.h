@@ -0,0 +1,20 @@
+#ifndef THREADS_LATENCY_H
+#define THREADS_LATENCY_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+struct thread;
+
+/* True if latency is being measured (-lat). */
+extern bool latency_enabled;
+
+void latency_enable (void);
+void latency_intr_off (void *caller);
+void latency_intr_on (void);
+void latency_intr_entry (const struct intr_frame *);
+void latency_wakeup (struct thread *);
+void latency_run (struct thread *);
+void latency_print (void);
+
+#endif /* threads/latency.h */
@@ -2,6 +2,7 @@
 #include <debug.h>
 #include <list.h>
 #include <round.h>
+#include <stats.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -32,7 +33,14 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   Each descriptor counts its arenas and the blocks in use, which
+   malloc_print_stats() prints.  When the kernel is compiled with
+   -DMALLOC_DEBUG, every block also carries a small header saying
+   which function allocated it, so that the blocks still allocated
+   at power off can be charged to their allocation sites.  Look the
+   addresses up with `backtrace' or addr2line. */
 
 /* Descriptor. */
 struct desc
@@ -41,6 +49,11 @@ struct desc
     size_t blocks_per_arena;    /* Number of blocks in an arena. */
     struct list free_list;      /* List of free blocks. */
     struct lock lock;           /* Lock. */
+
+    /* Statistics, protected by LOCK. */
+    size_t arena_cnt;           /* Arenas held. */
+    size_t in_use;              /* Blocks allocated now. */
+    size_t peak_in_use;         /* Most blocks ever allocated. */
   };
 
 /* Magic number for detecting arena corruption. */
@@ -64,6 +77,42 @@ struct block
 static struct desc descs[10];   /* Descriptors. */
 static size_t desc_cnt;         /* Number of descriptors. */
 
+/* Statistics for big blocks, protected by BIG_LOCK. */
+static struct lock big_lock;
+static size_t big_cnt;          /* Big blocks allocated now. */
+static size_t big_pages;        /* Pages in those blocks. */
+static size_t big_peak_pages;   /* Most pages ever in big blocks. */
+
+#ifdef MALLOC_DEBUG
+/* An allocation site: a caller of malloc() and friends, with the
+   blocks it allocated that are not yet freed. */
+struct site
+  {
+    const void *caller;         /* Return address into the caller. */
+    size_t live_cnt;            /* Blocks still allocated. */
+    size_t live_bytes;          /* Bytes requested for those blocks. */
+  };
+
+/* Allocation sites, hashed by caller.  The extra last entry
+   collects the sites that do not fit. */
+#define SITE_CNT 256
+static struct site sites[SITE_CNT + 1];
+static struct lock sites_lock;
+
+/* Header in front of every block under MALLOC_DEBUG. */
+struct block_header
+  {
+    struct site *site;          /* Where the block was allocated. */
+    size_t size;                /* Size requested. */
+  };
+
+static struct site *site_charge (const void *caller, size_t size);
+static void site_credit (struct site *, size_t size);
+#endif
+
+static void *malloc_at (size_t, const void *caller);
+static void *alloc_block (size_t);
+static void free_block (void *);
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
 
@@ -81,13 +130,94 @@ malloc_init (void)
       d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
       list_init (&d->free_list);
       lock_init (&d->lock);
+      d->arena_cnt = d->in_use = d->peak_in_use = 0;
+    }
+  lock_init (&big_lock);
+#ifdef MALLOC_DEBUG
+  lock_init (&sites_lock);
+#endif
+}
+
+/* Prints allocator statistics and, under MALLOC_DEBUG, the sites
+   of all blocks not yet freed. */
+void
+malloc_print_stats (void)
+{
+  size_t i;
+
+  for (i = 0; i < desc_cnt; i++)
+    {
+      struct desc *d = &descs[i];
+      if (d->peak_in_use > 0)
+        printf ("malloc: %zu-byte blocks: %zu in use (peak %zu), "
+                "%zu arenas\n",
+                d->block_size, d->in_use, d->peak_in_use, d->arena_cnt);
     }
+  printf ("malloc: big blocks: %zu in use, %zu pages (peak %zu)\n",
+          big_cnt, big_pages, big_peak_pages);
+
+#ifdef MALLOC_DEBUG
+  for (i = 0; i <= SITE_CNT; i++)
+    {
+      struct site *s = &sites[i];
+      if (s->live_cnt == 0)
+        continue;
+      if (i < SITE_CNT)
+        printf ("malloc: %p: ", s->caller);
+      else
+        printf ("malloc: other sites: ");
+      printf ("%zu blocks, %zu bytes not freed\n",
+              s->live_cnt, s->live_bytes);
+    }
+#endif
+}
+
+/* Fills in the malloc() fields of *S.  The counts are read
+   without their locks, so they may be slightly out of date. */
+void
+malloc_get_stats (struct stats *s)
+{
+  size_t i;
+
+  s->malloc_arenas = 0;
+  for (i = 0; i < desc_cnt; i++)
+    s->malloc_arenas += descs[i].arena_cnt;
+  s->malloc_big_pages = big_pages;
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  return malloc_at (size, __builtin_return_address (0));
+}
+
+/* Does the work of malloc(), on behalf of CALLER. */
+static void *
+malloc_at (size_t size, const void *caller UNUSED)
+{
+#ifdef MALLOC_DEBUG
+  struct block_header *h;
+
+  if (size == 0)
+    return NULL;
+  h = alloc_block (size + sizeof *h);
+  if (h == NULL)
+    return NULL;
+  h->site = site_charge (caller, size);
+  h->size = size;
+  return h + 1;
+#else
+  return alloc_block (size);
+#endif
+}
+
+/* Obtains and returns a new block of at least SIZE bytes from the
+   descriptors or the page allocator.  Returns a null pointer if
+   memory is not available. */
+static void *
+alloc_block (size_t size) 
 {
   struct desc *d;
   struct block *b;
@@ -116,6 +246,13 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = NULL;
       a->free_cnt = page_cnt;
+
+      lock_acquire (&big_lock);
+      big_cnt++;
+      big_pages += page_cnt;
+      if (big_pages > big_peak_pages)
+        big_peak_pages = big_pages;
+      lock_release (&big_lock);
       return a + 1;
     }
 
@@ -138,6 +275,7 @@ malloc (size_t size)
       a->magic = ARENA_MAGIC;
       a->desc = d;
       a->free_cnt = d->blocks_per_arena;
+      d->arena_cnt++;
       for (i = 0; i < d->blocks_per_arena; i++) 
         {
           struct block *b = arena_to_block (a, i);
@@ -149,6 +287,8 @@ malloc (size_t size)
   b = list_entry (list_pop_front (&d->free_list), struct block, free_elem);
   a = block_to_arena (b);
   a->free_cnt--;
+  if (++d->in_use > d->peak_in_use)
+    d->peak_in_use = d->in_use;
   lock_release (&d->lock);
   return b;
 }
@@ -167,22 +307,27 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = malloc_at (size, __builtin_return_address (0));
   if (p != NULL)
     memset (p, 0, size);
 
   return p;
 }
 
-/* Returns the number of bytes allocated for BLOCK. */
+/* Returns the number of bytes allocated for BLOCK, as returned by
+   malloc(). */
 static size_t
 block_size (void *block) 
 {
+#ifdef MALLOC_DEBUG
+  return ((struct block_header *) block)[-1].size;
+#else
   struct block *b = block;
   struct arena *a = block_to_arena (b);
   struct desc *d = a->desc;
 
   return d != NULL ? d->block_size : PGSIZE * a->free_cnt - pg_ofs (block);
+#endif
 }
 
 /* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
@@ -201,7 +346,7 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = malloc_at (new_size, __builtin_return_address (0));
       if (old_block != NULL && new_block != NULL)
         {
           size_t old_size = block_size (old_block);
@@ -217,6 +362,22 @@ realloc (void *old_block, size_t new_size)
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) 
+{
+#ifdef MALLOC_DEBUG
+  if (p != NULL)
+    {
+      struct block_header *h = (struct block_header *) p - 1;
+      site_credit (h->site, h->size);
+      p = h;
+    }
+#endif
+  free_block (p);
+}
+
+/* Returns block P, as returned by alloc_block(), to its
+   descriptor or the page allocator. */
+static void
+free_block (void *p) 
 {
   if (p != NULL)
     {
@@ -237,6 +398,7 @@ free (void *p)
 
           /* Add block to free list. */
           list_push_front (&d->free_list, &b->free_elem);
+          d->in_use--;
 
           /* If the arena is now entirely unused, free it. */
           if (++a->free_cnt >= d->blocks_per_arena) 
@@ -249,6 +411,7 @@ free (void *p)
                   struct block *b = arena_to_block (a, i);
                   list_remove (&b->free_elem);
                 }
+              d->arena_cnt--;
               palloc_free_page (a);
             }
 
@@ -257,12 +420,57 @@ free (void *p)
       else
         {
           /* It's a big block.  Free its pages. */
+          lock_acquire (&big_lock);
+          big_cnt--;
+          big_pages -= a->free_cnt;
+          lock_release (&big_lock);
           palloc_free_multiple (a, a->free_cnt);
           return;
         }
     }
 }
 
+#ifdef MALLOC_DEBUG
+/* Charges a SIZE-byte block to the site for CALLER and returns
+   the site. */
+static struct site *
+site_charge (const void *caller, size_t size)
+{
+  size_t start = ((uintptr_t) caller >> 2) % SITE_CNT;
+  size_t i = start;
+  struct site *s;
+
+  lock_acquire (&sites_lock);
+  do
+    {
+      s = &sites[i];
+      if (s->caller == caller || s->caller == NULL)
+        break;
+      i = (i + 1) % SITE_CNT;
+    }
+  while (i != start);
+  if (s->caller != caller && s->caller != NULL)
+    s = &sites[SITE_CNT];
+  else
+    s->caller = caller;
+  s->live_cnt++;
+  s->live_bytes += size;
+  lock_release (&sites_lock);
+  return s;
+}
+
+/* Credits site S with the freeing of a SIZE-byte block. */
+static void
+site_credit (struct site *s, size_t size)
+{
+  lock_acquire (&sites_lock);
+  ASSERT (s->live_cnt > 0);
+  s->live_cnt--;
+  s->live_bytes -= size;
+  lock_release (&sites_lock);
+}
+#endif
+
 /* Returns the arena that block B is inside. */
 static struct arena *
 block_to_arena (struct block *b)
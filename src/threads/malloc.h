@@ -4,7 +4,11 @@
 #include <debug.h>
 #include <stddef.h>
 
+struct stats;
+
 void malloc_init (void);
+void malloc_print_stats (void);
+void malloc_get_stats (struct stats *);
 void *malloc (size_t) __attribute__ ((malloc));
 void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
@@ -2,14 +2,18 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
+#include <stats.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -24,14 +28,62 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Within a pool, pages are managed by a binary buddy allocator.
+   Free memory is kept as blocks of 2**ORDER pages aligned to their
+   size, one free list per order, so that both allocating and
+   freeing take time logarithmic in the pool size.  A request for
+   N pages splits the smallest free block that holds N and gives
+   back the unused tail; freed pages merge with their free buddies
+   into ever larger blocks.  The list element for a free block is
+   kept in the block's first page.
+
+   Each pool also keeps a few free pages that are already zeroed,
+   so that most PAL_ZERO requests for a single page do not have to
+   clear one on the spot.  A low-priority kernel thread started by
+   palloc_start_zeroer() zeroes them when there is nothing better
+   to do.  They count as used in the bitmap but are handed out to
+   any request that would otherwise fail.
+
+   When an allocation leaves the user pool with fewer than
+   palloc_user_low free pages, the pressure hook set with
+   palloc_set_pressure_hook() is called, so that something can
+   free memory before the pool runs dry.
+
+   The split between the pools is only where each starts out.  A
+   pool that cannot satisfy an allocation borrows the pages from
+   the other one, as long as that leaves the lender with its
+   reserve: palloc_user_low pages for the user pool, a quarter of
+   the pool for the kernel.  The pages stay in the lender's bitmap
+   and go back to it when they are freed.  The user pool does not
+   borrow when its size was limited with -ul, since that is done
+   to force paging.  If neither pool has the pages, the shrinkers
+   registered with palloc_register_shrinker() are asked to give
+   back pages that their owners keep around only for speed, such
+   as empty slabs, and the allocation is tried once more.
+
+   A pool is protected by disabling interrupts rather than by a
+   lock, because the scheduler frees a dying thread's page with
+   interrupts already off.  Every critical section is short. */
+
+/* Pre-zeroed pages kept per pool. */
+#define ZEROED_MAX 32
+
+/* Number of buddy block orders, enough for a 4 GB pool. */
+#define BUDDY_ORDERS 20
 
 /* A memory pool. */
 struct pool
   {
-    struct lock lock;                   /* Mutual exclusion. */
-    struct bitmap *used_map;            /* Bitmap of free pages. */
+    struct bitmap *used_map;            /* Bitmap of pages in use. */
     uint8_t *base;                      /* Base of pool. */
+    uint8_t *free_order;                /* Per page: 1 + order of the free
+                                           block it starts, else 0. */
+    struct list free_lists[BUDDY_ORDERS]; /* Free blocks by order. */
+    void *zeroed[ZEROED_MAX];           /* Free pages known to be zero. */
+    size_t zeroed_cnt;                  /* Number of ZEROED pages. */
+    size_t free_cnt;                    /* Free pages, not counting ZEROED. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -41,9 +93,49 @@ struct pool kernel_pool, user_pool;
 size_t user_page_limit = SIZE_MAX;
 size_t free_page_limit = SIZE_MAX; // klaar@ida
 
+/* User pool low watermark: a user pool with fewer free pages than
+   this is under pressure.  A sixteenth of the pool. */
+size_t palloc_user_low;
+#define USER_LOW_DIVISOR 16
+
+/* Kernel pool reserve: the kernel pool lends pages to the user
+   pool only while more than a quarter of it stays free. */
+#define KERNEL_RESERVE_DIVISOR 4
+
+/* Registered shrinkers. */
+#define SHRINKERS_MAX 8
+struct shrinker
+  {
+    const char *name;                   /* Name for statistics. */
+    palloc_shrink_func *func;           /* Gives back pages. */
+    long long freed_cnt;                /* Pages it has given back. */
+  };
+static struct shrinker shrinkers[SHRINKERS_MAX];
+static size_t shrinker_cnt;
+
+/* Called when the user pool falls below its low watermark. */
+static palloc_pressure_func *pressure_hook;
+
+/* Wakes the zeroing thread.  ZERO_WANTED keeps the semaphore from
+   piling up ups while the thread is already busy. */
+static struct semaphore zero_sema;
+static volatile bool zero_wanted;
+
+/* Statistics. */
+static long long zeroed_hit_cnt;        /* PAL_ZERO requests served pre-zeroed. */
+static long long zeroed_miss_cnt;       /* PAL_ZERO requests zeroed on the spot. */
+static long long pressure_cnt;          /* User allocations below the watermark. */
+static long long user_lent_cnt;         /* Kernel pages lent to the user pool. */
+static long long kernel_lent_cnt;       /* User pages lent to the kernel pool. */
+static long long shrink_cnt;            /* Times the shrinkers were run. */
+
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static struct pool *pool_of (void *page);
+static size_t buddy_alloc (struct pool *, size_t page_cnt);
+static void buddy_free (struct pool *, size_t page_idx, size_t page_cnt);
+static thread_func zeroer;
 
 /* Initializes the page allocator. */
 void
@@ -73,37 +165,256 @@ palloc_init (void)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+  palloc_user_low = bitmap_size (user_pool.used_map) / USER_LOW_DIVISOR;
+  sema_init (&zero_sema, 0);
+}
+
+/* Sets HOOK to be called whenever an allocation leaves the user
+   pool below palloc_user_low free pages.  HOOK runs with
+   interrupts off, in whatever thread allocated, so it should do
+   no more than wake a thread that can free memory. */
+void
+palloc_set_pressure_hook (palloc_pressure_func *hook)
+{
+  pressure_hook = hook;
+}
+
+/* Registers FUNC, named NAME for statistics, to be called when
+   neither pool can satisfy an allocation.  FUNC runs with
+   interrupts on, in whatever thread allocated, perhaps while it
+   holds locks of its own, so it must not wait for anything. */
+void
+palloc_register_shrinker (const char *name, palloc_shrink_func *func)
+{
+  ASSERT (shrinker_cnt < SHRINKERS_MAX);
+  shrinkers[shrinker_cnt].name = name;
+  shrinkers[shrinker_cnt].func = func;
+  shrinkers[shrinker_cnt].freed_cnt = 0;
+  shrinker_cnt++;
+}
+
+/* Returns the number of free pages in the user pool. */
+size_t
+palloc_user_free (void)
+{
+  return user_pool.free_cnt + user_pool.zeroed_cnt;
+}
+
+/* Starts the thread that keeps the pools' pre-zeroed pages topped
+   up.  Must be called after thread_start(). */
+void
+palloc_start_zeroer (void)
+{
+  zero_wanted = true;
+  thread_create_daemon ("zeroer", PRI_MIN, zeroer, NULL);
+}
+
+/* Prints page allocator statistics. */
+void
+palloc_print_stats (void)
+{
+  size_t i;
+
+  printf ("Page allocator: %lld of %lld zeroed pages came pre-zeroed\n",
+          zeroed_hit_cnt, zeroed_hit_cnt + zeroed_miss_cnt);
+  printf ("User pool: %lld allocations under the %zu page low watermark\n",
+          pressure_cnt, palloc_user_low);
+  printf ("Pools: %lld kernel pages lent to user, %lld user pages to "
+          "kernel, %lld shrinks\n",
+          user_lent_cnt, kernel_lent_cnt, shrink_cnt);
+  for (i = 0; i < shrinker_cnt; i++)
+    printf ("Shrinker %s: %lld pages given back\n",
+            shrinkers[i].name, shrinkers[i].freed_cnt);
+}
+
+/* Fills in the page allocator fields of *S. */
+void
+palloc_get_stats (struct stats *s)
+{
+  enum intr_level old_level = intr_disable ();
+  size_t kernel_cnt = bitmap_size (kernel_pool.used_map);
+  size_t user_cnt = bitmap_size (user_pool.used_map);
+
+  s->kernel_pages = kernel_cnt;
+  s->kernel_free_pages = (bitmap_count (kernel_pool.used_map, 0, kernel_cnt,
+                                        false)
+                          + kernel_pool.zeroed_cnt);
+  s->user_pages = user_cnt;
+  s->user_free_pages = (bitmap_count (user_pool.used_map, 0, user_cnt, false)
+                        + user_pool.zeroed_cnt);
+  s->zeroed_hit_cnt = zeroed_hit_cnt;
+  s->zeroed_miss_cnt = zeroed_miss_cnt;
+  s->user_low_pages = palloc_user_low;
+  s->pressure_cnt = pressure_cnt;
+  intr_set_level (old_level);
+}
+
+/* Asks the zeroing thread to top up the pre-zeroed pages. */
+static void
+want_zeroed (void)
+{
+  if (!zero_wanted)
+    {
+      zero_wanted = true;
+      sema_up (&zero_sema);
+    }
+}
+
+/* Returns POOL's pre-zeroed pages to its bitmap, so that they can
+   be part of a multi-page allocation.  Interrupts must be
+   off. */
+static void
+release_zeroed (struct pool *pool)
+{
+  while (pool->zeroed_cnt > 0)
+    {
+      void *page = pool->zeroed[--pool->zeroed_cnt];
+      buddy_free (pool, pg_no (page) - pg_no (pool->base), 1);
+    }
+}
+
+/* Calls the pressure hook if the user pool is below its low
+   watermark.  Interrupts must be off. */
+static void
+check_pressure (void)
+{
+  if (palloc_user_free () < palloc_user_low)
+    {
+      pressure_cnt++;
+      if (pressure_hook != NULL)
+        pressure_hook ();
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   first, or a null pointer if it has no free block big enough.
+   Interrupts must be off. */
+static void *
+pool_alloc (struct pool *pool, size_t page_cnt)
+{
+  size_t page_idx = buddy_alloc (pool, page_cnt);
+
+  if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0)
+    {
+      /* The pre-zeroed pages may be the last free ones, or what
+         keeps free blocks from merging. */
+      release_zeroed (pool);
+      page_idx = buddy_alloc (pool, page_cnt);
+    }
+  return page_idx != BITMAP_ERROR ? pool->base + PGSIZE * page_idx : NULL;
+}
+
+/* Returns true if LENDER can spare PAGE_CNT pages for the other
+   pool without going below its reserve.  Interrupts must be
+   off. */
+static bool
+can_lend (const struct pool *lender, size_t page_cnt)
+{
+  size_t free_cnt = lender->free_cnt + lender->zeroed_cnt;
+  size_t reserve;
+
+  if (lender == &user_pool)
+    reserve = palloc_user_low;
+  else if (user_page_limit == SIZE_MAX)
+    reserve = bitmap_size (lender->used_map) / KERNEL_RESERVE_DIVISOR;
+  else
+    return false;
+  return free_cnt >= page_cnt && free_cnt - page_cnt > reserve;
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL or, failing that,
+   from the other pool if it can lend them.  Returns the first
+   page, or a null pointer.  Interrupts must be off. */
+static void *
+alloc_or_borrow (struct pool *pool, size_t page_cnt)
+{
+  struct pool *lender = pool == &user_pool ? &kernel_pool : &user_pool;
+  void *pages = pool_alloc (pool, page_cnt);
+
+  if (pages == NULL && can_lend (lender, page_cnt))
+    {
+      pages = pool_alloc (lender, page_cnt);
+      if (pages != NULL)
+        {
+          if (lender == &kernel_pool)
+            user_lent_cnt += page_cnt;
+          else
+            kernel_lent_cnt += page_cnt;
+        }
+    }
+  return pages;
+}
+
+/* Asks the shrinkers to give back PAGE_CNT pages between them.
+   Turns interrupts on while they run, and off again before
+   returning. */
+static void
+shrink (size_t page_cnt)
+{
+  size_t freed = 0;
+  size_t i;
+
+  shrink_cnt++;
+  intr_enable ();
+  for (i = 0; i < shrinker_cnt && freed < page_cnt; i++)
+    {
+      size_t cnt = shrinkers[i].func (page_cnt - freed);
+      shrinkers[i].freed_cnt += cnt;
+      freed += cnt;
+    }
+  intr_disable ();
 }
 
 /* Obtains and returns a group of PAGE_CNT contiguous free pages.
    If PAL_USER is set, the pages are obtained from the user pool,
    otherwise from the kernel pool.  If PAL_ZERO is set in FLAGS,
-   then the pages are filled with zeros.  If too few pages are
-   available, returns a null pointer, unless PAL_ASSERT is set in
-   FLAGS, in which case the kernel panics. */
+   then the pages are filled with zeros.  If the pool is short,
+   the pages may come from the other pool, once the shrinkers have
+   run if need be (but only if interrupts are on).  If too few
+   pages are available, returns a null pointer, unless PAL_ASSERT
+   is set in FLAGS, in which case the kernel panics. */
 void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+  enum intr_level old_level;
   void *pages;
-  size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
-  lock_release (&pool->lock);
-
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
+  old_level = intr_disable ();
+  if (page_cnt == 1 && (flags & PAL_ZERO) && pool->zeroed_cnt > 0)
+    {
+      pages = pool->zeroed[--pool->zeroed_cnt];
+      zeroed_hit_cnt++;
+      if (pool == &user_pool)
+        check_pressure ();
+      intr_set_level (old_level);
+      want_zeroed ();
+      return pages;
+    }
+  pages = alloc_or_borrow (pool, page_cnt);
+  if (pages == NULL && old_level == INTR_ON && !intr_context ())
+    {
+      shrink (page_cnt);
+      pages = alloc_or_borrow (pool, page_cnt);
+    }
+  if (pool == &user_pool)
+    check_pressure ();
+  intr_set_level (old_level);
 
   if (pages != NULL) 
     {
       if (flags & PAL_ZERO)
-        memset (pages, 0, PGSIZE * page_cnt);
+        {
+          memset (pages, 0, PGSIZE * page_cnt);
+          if (page_cnt == 1)
+            {
+              zeroed_miss_cnt++;
+              want_zeroed ();
+            }
+        }
     }
   else 
     {
@@ -114,6 +425,33 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   return pages;
 }
 
+/* Obtains PAGE_CNT contiguous free pages, PAGE_CNT a power of 2,
+   whose physical address is a multiple of PAGE_CNT pages, as a
+   4 MB page needs, and returns the kernel virtual address of the
+   first.  Buddy blocks are aligned only relative to the start of
+   their pool, so this takes nearly twice as many pages and gives
+   back the ends.  FLAGS are as for palloc_get_multiple(). */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt)
+{
+  uint8_t *pages, *aligned;
+  size_t head, span = page_cnt * PGSIZE;
+
+  ASSERT (page_cnt > 0 && (page_cnt & (page_cnt - 1)) == 0);
+
+  pages = palloc_get_multiple (flags & ~PAL_ZERO, 2 * page_cnt - 1);
+  if (pages == NULL)
+    return NULL;
+  aligned = ptov (ROUND_UP (vtop (pages), span));
+  head = (aligned - pages) / PGSIZE;
+  palloc_free_multiple (pages, head);
+  palloc_free_multiple (aligned + span, page_cnt - 1 - head);
+
+  if (flags & PAL_ZERO)
+    memset (aligned, 0, span);
+  return aligned;
+}
+
 /* Obtains a single free page and returns its kernel virtual
    address.
    If PAL_USER is set, the page is obtained from the user pool,
@@ -132,27 +470,23 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
   if (pages == NULL || page_cnt == 0)
     return;
 
-  if (page_from_pool (&kernel_pool, pages))
-    pool = &kernel_pool;
-  else if (page_from_pool (&user_pool, pages))
-    pool = &user_pool;
-  else
-    NOT_REACHED ();
-
+  pool = pool_of (pages);
   page_idx = pg_no (pages) - pg_no (pool->base);
 
 #ifndef NDEBUG
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  old_level = intr_disable ();
+  buddy_free (pool, page_idx, page_cnt);
+  intr_set_level (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -162,15 +496,108 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Returns the pool that PAGE belongs to. */
+static struct pool *
+pool_of (void *page)
+{
+  if (page_from_pool (&kernel_pool, page))
+    return &kernel_pool;
+  else if (page_from_pool (&user_pool, page))
+    return &user_pool;
+  else
+    NOT_REACHED ();
+}
+
+/* Frees the CNT pages, from either pool, whose addresses are in
+   PAGES, turning interrupts off only once for all of them. */
+void
+palloc_free_pages (void **pages, size_t cnt)
+{
+  enum intr_level old_level;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      ASSERT (pg_ofs (pages[i]) == 0);
+#ifndef NDEBUG
+      memset (pages[i], 0xcc, PGSIZE);
+#endif
+    }
+
+  old_level = intr_disable ();
+  for (i = 0; i < cnt; i++)
+    {
+      struct pool *pool = pool_of (pages[i]);
+      buddy_free (pool, pg_no (pages[i]) - pg_no (pool->base), 1);
+    }
+  intr_set_level (old_level);
+}
+
+/* Zeroes free pages of POOL until it has ZEROED_MAX pre-zeroed
+   ones or runs out of free pages. */
+static void
+fill_zeroed (struct pool *pool)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      size_t page_idx;
+      void *page;
+
+      old_level = intr_disable ();
+      if (pool->zeroed_cnt >= ZEROED_MAX)
+        page_idx = BITMAP_ERROR;
+      else
+        page_idx = buddy_alloc (pool, 1);
+      intr_set_level (old_level);
+      if (page_idx == BITMAP_ERROR)
+        return;
+
+      /* Clear it with interrupts on. */
+      page = pool->base + PGSIZE * page_idx;
+      memset (page, 0, PGSIZE);
+
+      old_level = intr_disable ();
+      if (pool->zeroed_cnt < ZEROED_MAX)
+        pool->zeroed[pool->zeroed_cnt++] = page;
+      else
+        buddy_free (pool, page_idx, 1);
+      intr_set_level (old_level);
+    }
+}
+
+/* Zeroing thread.  Runs at the lowest priority, so it usually
+   gets the CPU only when nothing else wants it, and refills both
+   pools whenever an allocation has used up pre-zeroed pages. */
+static void
+zeroer (void *aux UNUSED)
+{
+  /* Under the MLFQS, niceness rather than priority keeps us out of
+     the way. */
+  if (thread_mlfqs)
+    thread_set_nice (20);
+
+  for (;;)
+    {
+      zero_wanted = false;
+      fill_zeroed (&kernel_pool);
+      fill_zeroed (&user_pool);
+      sema_down (&zero_sema);
+    }
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
+  /* We'll put the pool's used_map at its base, followed by the
+     free_order array.  Calculate the space needed for both
      and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -178,9 +605,118 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
   printf ("%zu pages available in %s.\n", page_cnt, name);
 
   /* Initialize the pool. */
-  lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
+  p->free_order = (uint8_t *) base + bm_size;
+  memset (p->free_order, 0, page_cnt);
   p->base = base + bm_pages * PGSIZE;
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    list_init (&p->free_lists[order]);
+  p->zeroed_cnt = 0;
+  p->free_cnt = 0;
+
+  /* Everything starts out in use, so this marks it free. */
+  bitmap_set_all (p->used_map, true);
+  buddy_free (p, 0, page_cnt);
+}
+
+/* Returns the list element kept in free page PAGE_IDX of POOL. */
+static struct list_elem *
+block_elem (const struct pool *pool, size_t page_idx)
+{
+  return (struct list_elem *) (pool->base + PGSIZE * page_idx);
+}
+
+/* Returns the index of the free page in POOL that holds E. */
+static size_t
+elem_page_idx (const struct pool *pool, const struct list_elem *e)
+{
+  return ((const uint8_t *) e - pool->base) / PGSIZE;
+}
+
+/* Adds the free block of 2**ORDER pages at PAGE_IDX to POOL,
+   merging it with its buddy, and the result with its own buddy,
+   and so on, for as long as the buddy is free. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+
+  while (order + 1 < BUDDY_ORDERS)
+    {
+      size_t buddy = page_idx ^ ((size_t) 1 << order);
+      if (buddy >= page_cnt || pool->free_order[buddy] != order + 1)
+        break;
+
+      list_remove (block_elem (pool, buddy));
+      pool->free_order[buddy] = 0;
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+    }
+  pool->free_order[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order], block_elem (pool, page_idx));
+}
+
+/* Marks the PAGE_CNT pages starting at PAGE_IDX in POOL free,
+   as the largest aligned blocks they can be split into.
+   Interrupts must be off. */
+static void
+buddy_free (struct pool *pool, size_t page_idx, size_t page_cnt)
+{
+  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  pool->free_cnt += page_cnt;
+
+  while (page_cnt > 0)
+    {
+      int order = 0;
+
+      while (order + 1 < BUDDY_ORDERS
+             && (page_idx & (((size_t) 2 << order) - 1)) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first, or BITMAP_ERROR if no free block is big
+   enough.  Interrupts must be off. */
+static size_t
+buddy_alloc (struct pool *pool, size_t page_cnt)
+{
+  int order = 0, k;
+  size_t page_idx;
+
+  while (((size_t) 1 << order) < page_cnt)
+    if (++order >= BUDDY_ORDERS)
+      return BITMAP_ERROR;
+  for (k = order; k < BUDDY_ORDERS; k++)
+    if (!list_empty (&pool->free_lists[k]))
+      break;
+  if (k >= BUDDY_ORDERS)
+    return BITMAP_ERROR;
+
+  page_idx = elem_page_idx (pool, list_pop_front (&pool->free_lists[k]));
+  pool->free_order[page_idx] = 0;
+
+  /* Split the block down to the size asked for.  The upper halves
+     cannot merge, since their buddies are the part we keep. */
+  while (k > order)
+    {
+      size_t half = page_idx + ((size_t) 1 << --k);
+      pool->free_order[half] = k + 1;
+      list_push_front (&pool->free_lists[k], block_elem (pool, half));
+    }
+
+  /* Mark the block in use, then give back what is beyond
+     PAGE_CNT. */
+  bitmap_set_multiple (pool->used_map, page_idx, (size_t) 1 << order, true);
+  pool->free_cnt -= (size_t) 1 << order;
+  if (((size_t) 1 << order) > page_cnt)
+    buddy_free (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+  return page_idx;
 }
 
 /* Returns true if PAGE was allocated from POOL,
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+struct stats;
+
 /* How to allocate pages. */
 enum palloc_flags
   {
@@ -15,10 +17,31 @@ enum palloc_flags
 extern size_t user_page_limit;
 extern size_t free_page_limit; // klaar@ida
 
+/* Free user pages below which the user pool is under pressure. */
+extern size_t palloc_user_low;
+
+/* Called by the page allocator, with interrupts off, when the user
+   pool is under pressure. */
+typedef void palloc_pressure_func (void);
+
+/* Called by the page allocator, with interrupts on, when neither
+   pool has the pages for an allocation.  Frees up to PAGE_CNT
+   pages that are kept only for speed and returns how many it
+   freed. */
+typedef size_t palloc_shrink_func (size_t page_cnt);
+
 void palloc_init (void);
+void palloc_start_zeroer (void);
+void palloc_print_stats (void);
+void palloc_get_stats (struct stats *);
 void *palloc_get_page (enum palloc_flags);
 void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void *palloc_get_aligned (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
+void palloc_free_pages (void **pages, size_t cnt);
+void palloc_set_pressure_hook (palloc_pressure_func *);
+void palloc_register_shrinker (const char *name, palloc_shrink_func *);
+size_t palloc_user_free (void);
 
 #endif /* threads/palloc.h */
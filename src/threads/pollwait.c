@@ -0,0 +1,86 @@
+#include "threads/pollwait.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+
+/* Threads waiting in poll().  Readiness changes are rare next to
+   the work of checking them, so there is a single list, and
+   every change wakes every waiter to check its own objects again.
+   The list is protected by disabling interrupts, so that
+   poll_notify() may be called from interrupt handlers. */
+static struct list waiters;
+
+/* Initializes the poll waiter list. */
+void
+pollwait_init (void)
+{
+  list_init (&waiters);
+}
+
+/* Called by the timer when W's timeout expires. */
+static void
+timeout (void *w_)
+{
+  struct poll_waiter *w = w_;
+
+  w->timed_out = true;
+  sema_up (&w->wakeup);
+}
+
+/* Adds W to the waiters, so that readiness changes from now on
+   wake it.  If TIMEOUT_TICKS is positive, W also wakes that many
+   ticks from now.  Must be called before checking the objects, so
+   that no change after the check is missed. */
+void
+poll_register (struct poll_waiter *w, int64_t timeout_ticks)
+{
+  enum intr_level old_level;
+
+  sema_init (&w->wakeup, 0);
+  w->timed_out = false;
+  w->timer.pending = false;
+  old_level = intr_disable ();
+  list_push_back (&waiters, &w->elem);
+  intr_set_level (old_level);
+  if (timeout_ticks > 0)
+    timer_add (&w->timer, timeout_ticks, timeout, w);
+}
+
+/* Removes W from the waiters and cancels its timeout. */
+void
+poll_unregister (struct poll_waiter *w)
+{
+  enum intr_level old_level;
+
+  timer_cancel (&w->timer);
+  old_level = intr_disable ();
+  list_remove (&w->elem);
+  intr_set_level (old_level);
+}
+
+/* Waits until a readiness change or W's timeout since the last
+   call, or since poll_register().  Returns false if the timeout
+   has expired, true otherwise. */
+bool
+poll_block (struct poll_waiter *w)
+{
+  sema_down (&w->wakeup);
+  return !w->timed_out;
+}
+
+/* Wakes every waiter to check its objects again.  May be called
+   from an interrupt handler. */
+void
+poll_notify (void)
+{
+  enum intr_level old_level = intr_disable ();
+  struct list_elem *e;
+
+  for (e = list_begin (&waiters); e != list_end (&waiters);
+       e = list_next (e))
+    {
+      struct poll_waiter *w = list_entry (e, struct poll_waiter, elem);
+      if (w->wakeup.value == 0)
+        sema_up (&w->wakeup);
+    }
+  intr_set_level (old_level);
+}
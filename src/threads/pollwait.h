@@ -0,0 +1,26 @@
+#ifndef THREADS_POLLWAIT_H
+#define THREADS_POLLWAIT_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+#include "threads/synch.h"
+
+/* A thread waiting in poll() for any of several objects to become
+   ready.  Kept on the caller's stack. */
+struct poll_waiter
+  {
+    struct list_elem elem;      /* Element in the waiter list. */
+    struct semaphore wakeup;    /* Upped by poll_notify() or timeout. */
+    struct timer timer;         /* Timeout, if any. */
+    bool timed_out;             /* Set once the timeout expires. */
+  };
+
+void pollwait_init (void);
+void poll_register (struct poll_waiter *, int64_t timeout_ticks);
+void poll_unregister (struct poll_waiter *);
+bool poll_block (struct poll_waiter *);
+void poll_notify (void);
+
+#endif /* threads/pollwait.h */
@@ -0,0 +1,204 @@
+#include "threads/prof.h"
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/kstack.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/binlog.h"
+#ifdef USERPROG
+#include "userprog/pagedir.h"
+#endif
+
+/* Sampling CPU profiler.
+
+   On each timer interrupt, prof_sample() records the interrupted
+   instruction and, if asked, the return addresses of up to
+   PROF_DEPTH_MAX of its callers, found by following the chain of
+   saved frame pointers.  Identical stacks share one slot of a
+   fixed hash table, which counts them, so memory use does not
+   grow with the length of the run.  Samples that find the table
+   full are counted as lost.
+
+   prof_print() prints one line per slot:
+
+        PROF <count> <pc> <caller>...
+
+   in user or kernel addresses as they were sampled.  Run
+   utils/backtrace --profile on the output to turn it into flat
+   and call-graph profiles.
+
+   With -binlog, the profile goes to the binary log instead, as
+   one BINLOG_PROF frame: the sample and lost counts, the number
+   of PCs in each slot, and then the used slots as laid out in
+   struct prof_slot. */
+
+/* Number of distinct stacks that can be counted. */
+#define PROF_SLOTS 512
+
+/* A distinct stack and the number of samples that hit it. */
+struct prof_slot
+  {
+    uint32_t count;                     /* Samples; 0 if unused. */
+    uint32_t pcs[PROF_DEPTH_MAX + 1];   /* PC, then callers, 0-padded. */
+  };
+
+bool prof_enabled;
+static int prof_depth;                  /* Callers to record. */
+static struct prof_slot slots[PROF_SLOTS];
+static uint64_t sample_cnt;             /* Samples taken. */
+static uint64_t lost_cnt;               /* Samples that found no slot. */
+
+/* Starts sampling, recording DEPTH callers with each sample.
+   DEPTH is capped at PROF_DEPTH_MAX. */
+void
+prof_enable (int depth)
+{
+  prof_depth = depth < 0 ? 0 : depth < PROF_DEPTH_MAX ? depth : PROF_DEPTH_MAX;
+  prof_enabled = true;
+}
+
+/* Reads the saved frame pointer and return address of the frame
+   whose frame pointer is EBP into FRAME[0] and FRAME[1].  F is
+   the interrupt frame being sampled.  Returns false if EBP does
+   not point to memory that may safely be read here: kernel
+   frames must lie in the mapped part of the interrupted thread's
+   stack, and user frames in pages that are mapped. */
+static bool
+read_frame (const struct intr_frame *f, uint32_t ebp, uint32_t frame[2])
+{
+  const void *p = (const void *) ebp;
+
+  if (ebp % sizeof (uint32_t) != 0 || pg_ofs (p) > PGSIZE - 2 * sizeof *frame)
+    return false;
+  if (is_kernel_vaddr (p))
+    {
+      if (kstack_contains (f)
+          ? (!kstack_contains (p) || kstack_is_guard (p)
+             || kstack_slot_top (p) != kstack_slot_top (f))
+          : pg_round_down (p) != pg_round_down (f))
+        return false;
+    }
+  else
+    {
+#ifdef USERPROG
+      uint32_t *pd = thread_current ()->pagedir;
+
+      p = pd != NULL ? pagedir_get_page (pd, p) : NULL;
+      if (p == NULL)
+        return false;
+#else
+      return false;
+#endif
+    }
+  memcpy (frame, p, 2 * sizeof *frame);
+  return true;
+}
+
+/* Records a sample of the code interrupted with frame F, and
+   counts it WEIGHT times, the number of timer ticks it stands
+   for.  Called from the timer interrupt handler. */
+void
+prof_sample (const struct intr_frame *f, unsigned weight)
+{
+  uint32_t pcs[PROF_DEPTH_MAX + 1];
+  uint32_t ebp = f->ebp;
+  unsigned h, i;
+  int depth;
+
+  ASSERT (intr_context ());
+
+  memset (pcs, 0, sizeof pcs);
+  pcs[0] = (uint32_t) f->eip;
+  for (depth = 0; depth < prof_depth; depth++)
+    {
+      uint32_t frame[2];
+
+      if (!read_frame (f, ebp, frame) || frame[1] == 0)
+        break;
+      pcs[depth + 1] = frame[1];
+
+      /* Callers' frames lie above their callees'.  Anything else
+         is a broken chain, or the jump from a kernel stack to the
+         user stack. */
+      if (frame[0] <= ebp)
+        break;
+      ebp = frame[0];
+    }
+
+  sample_cnt += weight;
+  h = hash_bytes (pcs, sizeof pcs);
+  for (i = 0; i < PROF_SLOTS; i++)
+    {
+      struct prof_slot *s = &slots[(h + i) % PROF_SLOTS];
+
+      if (s->count == 0)
+        memcpy (s->pcs, pcs, sizeof pcs);
+      else if (memcmp (s->pcs, pcs, sizeof pcs))
+        continue;
+      s->count += weight;
+      return;
+    }
+  lost_cnt += weight;
+}
+
+/* Header of a BINLOG_PROF frame, followed by SLOT_CNT struct
+   prof_slots of 1 + PC_CNT words each. */
+struct prof_frame
+  {
+    uint64_t sample_cnt;
+    uint64_t lost_cnt;
+    uint32_t pc_cnt;
+    uint32_t slot_cnt;
+  };
+
+/* Writes the used slots to the binary log. */
+static void
+print_binary (void) 
+{
+  struct prof_frame frame;
+  int i;
+
+  frame.sample_cnt = sample_cnt;
+  frame.lost_cnt = lost_cnt;
+  frame.pc_cnt = PROF_DEPTH_MAX + 1;
+  frame.slot_cnt = 0;
+  for (i = 0; i < PROF_SLOTS; i++)
+    if (slots[i].count > 0)
+      frame.slot_cnt++;
+
+  binlog_begin (BINLOG_PROF, sizeof frame + frame.slot_cnt * sizeof *slots);
+  binlog_put (&frame, sizeof frame);
+  for (i = 0; i < PROF_SLOTS; i++)
+    if (slots[i].count > 0)
+      binlog_put (&slots[i], sizeof slots[i]);
+  printf ("Profile: %"PRIu64" samples, %"PRIu64" lost, "
+          "sent to binary log\n", sample_cnt, lost_cnt);
+}
+
+/* Stops sampling and prints the profile. */
+void
+prof_print (void)
+{
+  int i, j;
+
+  prof_enabled = false;
+  if (binlog_enabled)
+    {
+      print_binary ();
+      return;
+    }
+  printf ("Profile: %"PRIu64" samples, %"PRIu64" lost\n",
+          sample_cnt, lost_cnt);
+  for (i = 0; i < PROF_SLOTS; i++)
+    if (slots[i].count > 0)
+      {
+        printf ("PROF %"PRIu32, slots[i].count);
+        for (j = 0; j <= PROF_DEPTH_MAX && slots[i].pcs[j] != 0; j++)
+          printf (" %#"PRIx32, slots[i].pcs[j]);
+        printf ("\n");
+      }
+}
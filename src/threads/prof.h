@@ -0,0 +1,17 @@
+#ifndef THREADS_PROF_H
+#define THREADS_PROF_H
+
+#include <stdbool.h>
+#include "threads/interrupt.h"
+
+/* Maximum number of callers recorded with each sample. */
+#define PROF_DEPTH_MAX 4
+
+/* True if the profiler is sampling. */
+extern bool prof_enabled;
+
+void prof_enable (int depth);
+void prof_sample (const struct intr_frame *, unsigned weight);
+void prof_print (void);
+
+#endif /* threads/prof.h */
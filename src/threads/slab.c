@@ -0,0 +1,292 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Slab allocator.
+
+   malloc() rounds every request up to a power of 2, so a kernel
+   object a little over a power of 2 in size wastes nearly half
+   its block.  A slab cache instead hands out objects of exactly
+   one size, packed into pages called "slabs" obtained from the
+   page allocator.
+
+   An object may also have a constructor, which sets up the parts
+   of it that are the same for every use, such as locks.  It runs
+   only when a slab is created, not on every allocation, so the
+   free list of each slab is kept in the slab header and never in
+   the objects themselves.
+
+   Each cache keeps its slabs that have free objects on one list
+   and those that are full on another.  At most one entirely free
+   slab is kept around, so that allocating and freeing a single
+   object over and over does not go to the page allocator every
+   time.  When the page allocator runs short, it asks for those
+   back through kmem_shrink(). */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* A slab: one page of objects, with this header at its start. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in cache's partial or full. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint8_t *objs;              /* First object. */
+    uint16_t free_idx[];        /* Free objects, as a stack of indexes. */
+  };
+
+/* A cache. */
+struct kmem_cache
+  {
+    struct list_elem elem;      /* Element in caches. */
+    const char *name;           /* Name for statistics. */
+    size_t obj_size;            /* Object size, rounded for alignment. */
+    size_t objs_per_slab;       /* Objects in one slab. */
+    kmem_ctor *ctor;            /* Constructor, or null. */
+    struct lock lock;           /* Protects the rest. */
+    struct list partial;        /* Slabs with free objects. */
+    struct list full;           /* Slabs without. */
+    size_t empty_cnt;           /* Entirely free slabs, 0 or 1. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs in the cache. */
+    size_t in_use;              /* Objects allocated now. */
+    size_t peak_in_use;         /* Most objects ever allocated. */
+    long long alloc_cnt;        /* Successful allocations. */
+  };
+
+/* All caches, for kmem_print_stats(). */
+static struct list caches;
+static struct lock caches_lock;
+
+static palloc_shrink_func kmem_shrink;
+
+/* Initializes the slab allocator. */
+void
+kmem_init (void)
+{
+  list_init (&caches);
+  lock_init (&caches_lock);
+  palloc_register_shrinker ("slab", kmem_shrink);
+}
+
+/* Creates and returns a cache of SIZE-byte objects named NAME,
+   each put in its constructed state by CTOR if it is nonnull.
+   NAME must outlive the cache.  SIZE must leave room for several
+   objects per page.  Panics if memory is short, since caches are
+   created at initialization time. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor *ctor)
+{
+  struct kmem_cache *c;
+  size_t obj_size = ROUND_UP (size > 0 ? size : 1, sizeof (void *));
+
+  ASSERT (obj_size <= PGSIZE / 4);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    PANIC ("kmem_cache_create: out of memory creating %s", name);
+  c->name = name;
+  c->obj_size = obj_size;
+  c->objs_per_slab = ((PGSIZE - sizeof (struct slab))
+                      / (obj_size + sizeof (uint16_t)));
+  c->ctor = ctor;
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  c->empty_cnt = 0;
+  c->slab_cnt = c->in_use = c->peak_in_use = 0;
+  c->alloc_cnt = 0;
+
+  lock_acquire (&caches_lock);
+  list_push_back (&caches, &c->elem);
+  lock_release (&caches_lock);
+  return c;
+}
+
+/* Adds a new slab to cache C and returns it, or a null pointer if
+   the page allocator is out of pages.  C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c)
+{
+  struct slab *s = palloc_get_page (0);
+  size_t i;
+
+  if (s == NULL)
+    return NULL;
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  s->objs = (uint8_t *) s + ROUND_UP (sizeof *s + c->objs_per_slab
+                                      * sizeof *s->free_idx,
+                                      sizeof (void *));
+  ASSERT (s->objs + c->objs_per_slab * c->obj_size
+          <= (uint8_t *) s + PGSIZE);
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      s->free_idx[i] = c->objs_per_slab - 1 - i;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->obj_size);
+    }
+
+  list_push_front (&c->partial, &s->elem);
+  c->slab_cnt++;
+  c->empty_cnt++;
+  return s;
+}
+
+/* Returns an object from cache C, in its constructed state if C
+   has a constructor, or a null pointer if memory is short. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+  if (list_empty (&c->partial))
+    {
+      if (slab_create (c) == NULL)
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+    }
+
+  s = list_entry (list_front (&c->partial), struct slab, elem);
+  if (s->free_cnt == c->objs_per_slab)
+    c->empty_cnt--;
+  obj = s->objs + s->free_idx[--s->free_cnt] * c->obj_size;
+  if (s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_back (&c->full, &s->elem);
+    }
+
+  c->alloc_cnt++;
+  if (++c->in_use > c->peak_in_use)
+    c->peak_in_use = c->in_use;
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Returns OBJ, which must have come from cache C and be in its
+   constructed state, to C.  A null OBJ is ignored. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t ofs;
+
+  if (obj == NULL)
+    return;
+
+  s = pg_round_down (obj);
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+  ofs = (uint8_t *) obj - s->objs;
+  ASSERT (ofs % c->obj_size == 0);
+
+  lock_acquire (&c->lock);
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  if (s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  s->free_idx[s->free_cnt++] = ofs / c->obj_size;
+  c->in_use--;
+
+  /* Keep one free slab, but give any other back. */
+  if (s->free_cnt == c->objs_per_slab && c->empty_cnt++ > 0)
+    {
+      list_remove (&s->elem);
+      c->empty_cnt--;
+      c->slab_cnt--;
+      s->magic = 0;
+      palloc_free_page (s);
+    }
+  lock_release (&c->lock);
+}
+
+/* Frees the entirely free slab of cache C, if it has one, and
+   returns the number of pages freed.  C's lock must be held. */
+static size_t
+free_empty_slab (struct kmem_cache *c)
+{
+  struct list_elem *e;
+
+  if (c->empty_cnt == 0)
+    return 0;
+  for (e = list_begin (&c->partial); e != list_end (&c->partial);
+       e = list_next (e))
+    {
+      struct slab *s = list_entry (e, struct slab, elem);
+      if (s->free_cnt == c->objs_per_slab)
+        {
+          list_remove (&s->elem);
+          c->empty_cnt--;
+          c->slab_cnt--;
+          s->magic = 0;
+          palloc_free_page (s);
+          return 1;
+        }
+    }
+  NOT_REACHED ();
+}
+
+/* Gives back the free slab kept by each cache, until PAGE_CNT
+   pages have been freed, and returns the number freed.  Called by
+   the page allocator when memory is short, perhaps by a thread
+   that holds some of these locks already, so a cache whose lock
+   is busy is skipped. */
+static size_t
+kmem_shrink (size_t page_cnt)
+{
+  struct list_elem *e;
+  size_t freed = 0;
+
+  if (lock_held_by_current_thread (&caches_lock)
+      || !lock_try_acquire (&caches_lock))
+    return 0;
+  for (e = list_begin (&caches); e != list_end (&caches) && freed < page_cnt;
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      if (!lock_held_by_current_thread (&c->lock)
+          && lock_try_acquire (&c->lock))
+        {
+          freed += free_empty_slab (c);
+          lock_release (&c->lock);
+        }
+    }
+  lock_release (&caches_lock);
+  return freed;
+}
+
+/* Prints statistics for every cache. */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  lock_acquire (&caches_lock);
+  for (e = list_begin (&caches); e != list_end (&caches); e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab %s: %zu-byte objects, %zu in use (peak %zu), "
+              "%zu slabs, %lld allocations\n",
+              c->name, c->obj_size, c->in_use, c->peak_in_use,
+              c->slab_cnt, c->alloc_cnt);
+    }
+  lock_release (&caches_lock);
+}
@@ -0,0 +1,21 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* A cache of equally sized kernel objects. */
+struct kmem_cache;
+
+/* Puts a newly created object into its constructed state.  Runs
+   once per object, when the page holding it is added to its
+   cache; the object must be back in that state when freed. */
+typedef void kmem_ctor (void *obj);
+
+void kmem_init (void);
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      kmem_ctor *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+void kmem_print_stats (void);
+
+#endif /* threads/slab.h */
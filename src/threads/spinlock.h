@@ -0,0 +1,78 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <debug.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "threads/interrupt.h"
+
+/* Spin lock.
+
+   Disabling interrupts keeps other threads on this CPU out of a
+   critical section, but not code running on another CPU.  A
+   spin lock does both: spin_lock_irqsave() disables interrupts
+   and then busy-waits for the lock word with an atomic exchange.
+   Data that interrupt handlers may touch, or that another CPU
+   could, should be protected with a spin lock rather than with
+   intr_disable() alone.
+
+   While the kernel runs on one CPU, the lock word is always free
+   when it is tested, so a spin lock costs one exchange more than
+   intr_disable().  The holder must not sleep, and spin locks are
+   not recursive. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* 1 if held, 0 if free. */
+  };
+
+/* Initializer for a spin lock that starts out free. */
+#define SPINLOCK_INITIALIZER { 0 }
+
+/* Initializes LOCK as free. */
+static inline void
+spin_init (struct spinlock *lock)
+{
+  lock->locked = 0;
+}
+
+/* Disables interrupts, acquires LOCK, and returns the previous
+   interrupt level, to be passed to spin_unlock_irqrestore(). */
+static inline enum intr_level
+spin_lock_irqsave (struct spinlock *lock)
+{
+  enum intr_level old_level = intr_disable ();
+  uint32_t was_locked;
+
+  for (;;)
+    {
+      was_locked = 1;
+      asm volatile ("xchgl %0, %1"
+                    : "+r" (was_locked), "+m" (lock->locked)
+                    : : "memory");
+      if (!was_locked)
+        break;
+      while (lock->locked)
+        asm volatile ("pause");
+    }
+  return old_level;
+}
+
+/* Releases LOCK and restores interrupt level OLD_LEVEL. */
+static inline void
+spin_unlock_irqrestore (struct spinlock *lock, enum intr_level old_level)
+{
+  ASSERT (lock->locked);
+
+  asm volatile ("" : : : "memory");
+  lock->locked = 0;
+  intr_set_level (old_level);
+}
+
+/* Returns true if LOCK is held, by any CPU. */
+static inline bool
+spin_is_locked (const struct spinlock *lock)
+{
+  return lock->locked != 0;
+}
+
+#endif /* threads/spinlock.h */
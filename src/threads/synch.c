@@ -27,10 +27,41 @@
 */
 
 #include "threads/synch.h"
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#ifdef LOCK_STATS
+#include "devices/timer.h"
+#endif
+
+/* Source of the sequence numbers that put waiters of equal
+   priority in first-in, first-out order.  Wraps around, which
+   is harmless as long as no waiter waits through 2**31 others. */
+static unsigned next_wait_seq;
+
+/* Returns true if a waiter with PRI_A and SEQ_A should be woken
+   after one with PRI_B and SEQ_B: if it has lower priority, or
+   has the same priority and started waiting later. */
+static inline bool
+waiter_less (int pri_a, unsigned seq_a, int pri_b, unsigned seq_b) 
+{
+  if (pri_a != pri_b)
+    return pri_a < pri_b;
+  return (int) (seq_a - seq_b) > 0;
+}
+
+/* Orders threads in a semaphore's queue of waiters. */
+static bool
+thread_priority_less (const struct pqueue_elem *a_,
+                      const struct pqueue_elem *b_, void *aux UNUSED) 
+{
+  const struct thread *a = pqueue_entry (a_, struct thread, waitelem);
+  const struct thread *b = pqueue_entry (b_, struct thread, waitelem);
+  return waiter_less (a->priority, a->wait_seq, b->priority, b->wait_seq);
+}
 
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
@@ -47,7 +78,66 @@ sema_init (struct semaphore *sema, unsigned value)
   ASSERT (sema != NULL);
 
   sema->value = value;
-  list_init (&sema->waiters);
+  pqueue_init (&sema->waiters, thread_priority_less, NULL);
+#ifdef LOCK_STATS
+  memset (&sema->stats, 0, sizeof sema->stats);
+#endif
+}
+
+#ifdef LOCK_STATS
+/* Named semaphores, whose statistics synch_print_stats()
+   prints. */
+#define NAMED_MAX 64
+static struct synch_stats *named[NAMED_MAX];
+static size_t named_cnt;
+
+/* Charges WAIT_TICKS spent waiting for the semaphore tracked by
+   STATS to the running thread. */
+static void
+record_wait (struct synch_stats *stats, int64_t wait_ticks) 
+{
+  const char *name = thread_name ();
+  int i, min = 0;
+
+  stats->contended_cnt++;
+  stats->wait_ticks += wait_ticks;
+  for (i = 0; i < SYNCH_TOP_WAITERS; i++)
+    {
+      if (!strcmp (stats->top[i].name, name))
+        {
+          stats->top[i].wait_ticks += wait_ticks;
+          return;
+        }
+      if (stats->top[i].wait_ticks < stats->top[min].wait_ticks)
+        min = i;
+    }
+  if (wait_ticks >= stats->top[min].wait_ticks)
+    {
+      strlcpy (stats->top[min].name, name, sizeof stats->top[min].name);
+      stats->top[min].wait_ticks = wait_ticks;
+    }
+}
+#endif
+
+/* Initializes SEMA as sema_init() does, and gives it NAME for
+   the contention statistics kept with -DLOCK_STATS.  SEMA and
+   NAME must exist until the kernel shuts down.  Without
+   -DLOCK_STATS, the name is ignored. */
+void
+sema_init_named (struct semaphore *sema, unsigned value, const char *name) 
+{
+  ASSERT (name != NULL);
+
+  sema_init (sema, value);
+#ifdef LOCK_STATS
+  {
+    enum intr_level old_level = intr_disable ();
+    sema->stats.name = name;
+    if (named_cnt < NAMED_MAX)
+      named[named_cnt++] = &sema->stats;
+    intr_set_level (old_level);
+  }
+#endif
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -61,17 +151,34 @@ void
 sema_down (struct semaphore *sema) 
 {
   enum intr_level old_level;
+#ifdef LOCK_STATS
+  bool contended;
+  int64_t start;
+#endif
 
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
   old_level = intr_disable ();
+#ifdef LOCK_STATS
+  contended = sema->value == 0;
+  start = timer_ticks ();
+  sema->stats.acquire_cnt++;
+#endif
   while (sema->value == 0) 
     {
-      list_push_back (&sema->waiters, &thread_current ()->elem);
+      struct thread *cur = thread_current ();
+
+      cur->wait_seq = next_wait_seq++;
+      cur->waiting_sema = sema;
+      pqueue_push (&sema->waiters, &cur->waitelem);
       thread_block ();
     }
   sema->value--;
+#ifdef LOCK_STATS
+  if (contended && sema->stats.name != NULL)
+    record_wait (&sema->stats, timer_elapsed (start));
+#endif
   intr_set_level (old_level);
 }
 
@@ -102,7 +209,9 @@ sema_try_down (struct semaphore *sema)
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any, yielding to it if it outranks the running
+   thread.  Waiters of equal priority are woken in FIFO order.
 
    This function may be called from an interrupt handler. */
 void
@@ -113,11 +222,16 @@ sema_up (struct semaphore *sema)
   ASSERT (sema != NULL);
 
   old_level = intr_disable ();
-  if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+  if (!pqueue_empty (&sema->waiters)) 
+    {
+      struct thread *t = pqueue_entry (pqueue_pop (&sema->waiters),
+                                     struct thread, waitelem);
+      t->waiting_sema = NULL;
+      thread_unblock (t);
+    }
   sema->value++;
   intr_set_level (old_level);
+  thread_preempt ();
 }
 
 static void sema_test_helper (void *sema_);
@@ -181,10 +295,31 @@ lock_init (struct lock *lock)
   sema_init (&lock->semaphore, 1);
 }
 
+/* Initializes LOCK as lock_init() does, and gives it NAME for
+   the contention statistics kept with -DLOCK_STATS.  LOCK and
+   NAME must exist until the kernel shuts down. */
+void
+lock_init_named (struct lock *lock, const char *name)
+{
+  ASSERT (lock != NULL);
+
+  lock->holder = NULL;
+  sema_init_named (&lock->semaphore, 1, name);
+}
+
+/* Maximum length of a chain of lock holders, each waiting for a
+   lock held by the next, through which a priority is donated. */
+#define DONATION_DEPTH 8
+
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
 
+   While waiting, the current thread donates its priority to the
+   holder of LOCK, and on through the holders of the locks that
+   holder is waiting for, so that a low-priority holder cannot
+   keep a high-priority waiter off the CPU indefinitely.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -192,12 +327,38 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+  bool waited;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  waited = lock->holder != NULL;
+  if (waited)
+    trace (TRACE_LOCK_WAIT, (uint32_t) lock, lock->holder->tid);
+  if (waited && !thread_mlfqs) 
+    {
+      struct lock *l = lock;
+      int depth;
+
+      cur->waiting_lock = lock;
+      for (depth = 0; l != NULL && l->holder != NULL
+             && depth < DONATION_DEPTH; depth++)
+        {
+          thread_donate_priority (l->holder, cur->priority);
+          l = l->holder->waiting_lock;
+        }
+    }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->held_locks, &lock->elem);
+  thread_update_priority (cur);
+  trace (TRACE_LOCK_ACQUIRE, (uint32_t) lock, waited);
+  intr_set_level (old_level);
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -209,18 +370,27 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
-  if (success)
-    lock->holder = thread_current ();
+  if (success) 
+    {
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->held_locks, &lock->elem);
+    }
+  intr_set_level (old_level);
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
+   Gives up any priority donated through LOCK and wakes up its
+   highest-priority waiter, yielding to it if it now outranks
+   the current thread.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -228,10 +398,16 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  thread_update_priority (thread_current ());
+  intr_set_level (old_level);
   sema_up (&lock->semaphore);
 }
 
@@ -246,13 +422,29 @@ lock_held_by_current_thread (const struct lock *lock)
   return lock->holder == thread_current ();
 }
 
-/* One semaphore in a list. */
+/* One semaphore in a condition's queue of waiters. */
 struct semaphore_elem 
   {
-    struct list_elem elem;              /* List element. */
+    struct pqueue_elem elem;              /* Heap element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
+    unsigned seq;                       /* Orders equal priorities. */
   };
 
+/* Returns true if the thread waiting on semaphore_elem A should
+   be signaled after the one waiting on B. */
+static bool
+waiter_priority_less (const struct pqueue_elem *a_,
+                      const struct pqueue_elem *b_, void *aux UNUSED) 
+{
+  const struct semaphore_elem *a = pqueue_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = pqueue_entry (b_, struct semaphore_elem,
+                                               elem);
+  return waiter_less (a->thread->priority, a->seq,
+                      b->thread->priority, b->seq);
+}
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -261,7 +453,7 @@ cond_init (struct condition *cond)
 {
   ASSERT (cond != NULL);
 
-  list_init (&cond->waiters);
+  pqueue_init (&cond->waiters, waiter_priority_less, NULL);
 }
 
 /* Atomically releases LOCK and waits for COND to be signaled by
@@ -288,6 +480,7 @@ void
 cond_wait (struct condition *cond, struct lock *lock) 
 {
   struct semaphore_elem waiter;
+  enum intr_level old_level;
 
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
@@ -295,15 +488,27 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
-  list_push_back (&cond->waiters, &waiter.elem);
+  waiter.thread = thread_current ();
+
+  /* A donation can reorder the queue from another thread that
+     does not hold LOCK, so the queue is touched only with
+     interrupts off. */
+  old_level = intr_disable ();
+  waiter.seq = next_wait_seq++;
+  waiter.thread->waiting_cond = cond;
+  waiter.thread->cond_elem = &waiter.elem;
+  pqueue_push (&cond->waiters, &waiter.elem);
+  intr_set_level (old_level);
+
   lock_release (lock);
   sema_down (&waiter.semaphore);
   lock_acquire (lock);
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the one with the highest priority to
+   wake up from its wait.  LOCK must be held before calling this
+   function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -316,9 +521,16 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (!intr_context ());
   ASSERT (lock_held_by_current_thread (lock));
 
-  if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+  if (!pqueue_empty (&cond->waiters)) 
+    {
+      enum intr_level old_level = intr_disable ();
+      struct semaphore_elem *waiter = pqueue_entry (pqueue_pop (&cond->waiters),
+                                                  struct semaphore_elem,
+                                                  elem);
+      waiter->thread->waiting_cond = NULL;
+      intr_set_level (old_level);
+      sema_up (&waiter->semaphore);
+    }
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -333,6 +545,110 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   ASSERT (cond != NULL);
   ASSERT (lock != NULL);
 
-  while (!list_empty (&cond->waiters))
+  while (!pqueue_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+/* Initializes RW as a reader-writer lock.  Any number of readers
+   may hold a reader-writer lock at once, or else a single writer.
+
+   Writers are preferred: once a writer is waiting for the
+   readers to finish, new readers wait until it is done, so a
+   steady stream of readers cannot starve writers.  Waiting
+   readers and writers queue on the same lock, which is held for
+   the whole of each write, so they donate their priority to the
+   writer ahead of them and are served in priority order. */
+void
+rw_init (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  lock_init (&rw->write);
+  lock_init (&rw->lock);
+  cond_init (&rw->no_readers);
+  rw->readers = 0;
+}
+
+/* Acquires RW for reading, sleeping until no writer holds or is
+   waiting to take it.  RW must not already be held by the
+   current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_read_acquire (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->write);
+  lock_acquire (&rw->lock);
+  rw->readers++;
+  lock_release (&rw->lock);
+  lock_release (&rw->write);
+}
+
+/* Releases RW, which the current thread must hold for
+   reading. */
+void
+rw_read_release (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->lock);
+  ASSERT (rw->readers > 0);
+  if (--rw->readers == 0)
+    cond_signal (&rw->no_readers, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Acquires RW for writing, sleeping until no other thread holds
+   it.  RW must not already be held by the current thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rw_write_acquire (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  lock_acquire (&rw->write);
+  lock_acquire (&rw->lock);
+  while (rw->readers > 0)
+    cond_wait (&rw->no_readers, &rw->lock);
+  lock_release (&rw->lock);
+}
+
+/* Releases RW, which the current thread must hold for
+   writing. */
+void
+rw_write_release (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+  ASSERT (lock_held_by_current_thread (&rw->write));
+
+  lock_release (&rw->write);
+}
+
+/* Prints the contention statistics of the named semaphores and
+   locks, if the kernel was compiled with -DLOCK_STATS. */
+void
+synch_print_stats (void) 
+{
+#ifdef LOCK_STATS
+  size_t i;
+  int j;
+
+  for (i = 0; i < named_cnt; i++)
+    {
+      const struct synch_stats *stats = named[i];
+
+      printf ("Lock %s: %lld acquires, %lld contended, %"PRId64" ticks "
+              "waiting\n", stats->name, stats->acquire_cnt,
+              stats->contended_cnt, stats->wait_ticks);
+      for (j = 0; j < SYNCH_TOP_WAITERS; j++)
+        if (stats->top[j].wait_ticks > 0)
+          printf ("  %s waited %"PRId64" ticks\n",
+                  stats->top[j].name, stats->top[j].wait_ticks);
+    }
+#endif
+}
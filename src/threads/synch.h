@@ -1,17 +1,44 @@
 #ifndef THREADS_SYNCH_H
 #define THREADS_SYNCH_H
 
+#include <pqueue.h>
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+
+#ifdef LOCK_STATS
+/* Number of threads that waited longest kept per semaphore. */
+#define SYNCH_TOP_WAITERS 4
+
+/* Contention statistics for a named semaphore or lock.  Only
+   kept when the kernel is compiled with -DLOCK_STATS. */
+struct synch_stats
+  {
+    const char *name;           /* Name, or null if not tracked. */
+    long long acquire_cnt;      /* Number of downs. */
+    long long contended_cnt;    /* Number of downs that had to wait. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+    struct
+      {
+        char name[16];          /* Thread name. */
+        int64_t wait_ticks;     /* Total ticks it spent waiting. */
+      }
+    top[SYNCH_TOP_WAITERS];     /* Threads that waited longest. */
+  };
+#endif
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
-    struct list waiters;        /* List of waiting threads. */
+    struct pqueue waiters;        /* Waiting threads, by priority. */
+#ifdef LOCK_STATS
+    struct synch_stats stats;   /* Contention statistics. */
+#endif
   };
 
 void sema_init (struct semaphore *, unsigned value);
+void sema_init_named (struct semaphore *, unsigned value, const char *name);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
@@ -20,11 +47,13 @@ void sema_self_test (void);
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
+    struct thread *holder;      /* Thread holding lock. */
     struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct list_elem elem;      /* Element in holder's held_locks. */
   };
 
 void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
@@ -33,7 +62,7 @@ bool lock_held_by_current_thread (const struct lock *);
 /* Condition variable. */
 struct condition 
   {
-    struct list waiters;        /* List of waiting threads. */
+    struct pqueue waiters;        /* Waiting threads, by priority. */
   };
 
 void cond_init (struct condition *);
@@ -41,6 +70,23 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader-writer lock. */
+struct rwlock 
+  {
+    struct lock write;          /* Held by the writer, briefly by readers. */
+    struct lock lock;           /* Protects READERS. */
+    struct condition no_readers; /* Signaled when READERS drops to 0. */
+    int readers;                /* Number of readers holding the lock. */
+  };
+
+void rw_init (struct rwlock *);
+void rw_read_acquire (struct rwlock *);
+void rw_read_release (struct rwlock *);
+void rw_write_acquire (struct rwlock *);
+void rw_write_release (struct rwlock *);
+
+void synch_print_stats (void);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
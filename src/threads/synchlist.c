@@ -17,6 +17,7 @@
 
 #include "copyright.h"
 #include "synchlist.h"
+#include <debug.h>
 #include "threads/malloc.h"
 
 //----------------------------------------------------------------------
@@ -62,13 +63,10 @@ void sl_destroy(struct SynchList *sl)
 
 void sl_append(struct SynchList *sl, void *item)
 {
-  lock_acquire(&sl->sl_lock);                // enforce mutual exclusive access to the list 
   struct SL_element *sl_elem = malloc(sizeof(struct SL_element));
+  ASSERT(sl_elem != NULL);
   sl_elem->item = item;
-  list_push_back(&sl->sl_list, &sl_elem->elem);
-  cond_signal(&sl->sl_empty,&sl->sl_lock);  // wake up a waiter, if any
-  lock_release(&sl->sl_lock);              
-  return;
+  sl_append_elem(sl, &sl_elem->elem);
 }
 
 
@@ -81,18 +79,98 @@ void sl_append(struct SynchList *sl, void *item)
 //----------------------------------------------------------------------
 
 void *sl_remove(struct SynchList *sl)
+{
+  struct list_elem *e = sl_remove_elem(sl);
+  struct SL_element *sl_elem = list_entry(e, struct SL_element, elem);
+  void *item = sl_elem->item;
+  free(sl_elem);
+  return item;
+}
+
+
+//----------------------------------------------------------------------
+// SynchList::AppendElem
+//      Append "elem", embedded in the caller's own structure, to the
+//	end of the list, and wake up one waiter, if any.
+//----------------------------------------------------------------------
+
+void sl_append_elem(struct SynchList *sl, struct list_elem *elem)
+{
+  lock_acquire(&sl->sl_lock);                // enforce mutual exclusive access to the list 
+  list_push_back(&sl->sl_list, elem);
+  cond_signal(&sl->sl_empty,&sl->sl_lock);  // wake up a waiter, if any
+  lock_release(&sl->sl_lock);              
+}
+
+
+//----------------------------------------------------------------------
+// SynchList::RemoveElem
+//      Remove an element from the beginning of the list.  Wait if
+//	the list is empty.  If elements are left, wake up the next
+//	waiter, so that a batch appended with a single wakeup is
+//	still shared out among all waiting consumers.
+// Returns:
+//	The removed element. 
+//----------------------------------------------------------------------
+
+struct list_elem *sl_remove_elem(struct SynchList *sl)
 {
   struct list_elem *e;
-  void *item;
   lock_acquire(&sl->sl_lock);                // enforce mutual exclusion
   while(list_empty(&sl->sl_list)){
     cond_wait(&sl->sl_empty, &sl->sl_lock);  // wait until list isn't empty
   }
   e = list_pop_front(&sl->sl_list);
-  struct SL_element *sl_elem = list_entry(e, struct SL_element, elem);
-  item = sl_elem->item;
-  free(sl_elem);
+  if (!list_empty(&sl->sl_list))
+    cond_signal(&sl->sl_empty, &sl->sl_lock); // pass the leftovers on
+  lock_release(&sl->sl_lock);
+  return e;
+}
+
+
+//----------------------------------------------------------------------
+// SynchList::AppendMany
+//      Move all the elements of "elems" to the end of the list, in
+//	order, under one lock acquire, leaving "elems" empty.  Wakes
+//	up one waiter for the whole batch; each consumer that finds
+//	elements left over wakes up the next.
+//----------------------------------------------------------------------
+
+void sl_append_many(struct SynchList *sl, struct list *elems)
+{
+  if (list_empty(elems))
+    return;
+  lock_acquire(&sl->sl_lock);
+  list_splice(list_end(&sl->sl_list), list_begin(elems), list_end(elems));
+  cond_signal(&sl->sl_empty, &sl->sl_lock);
   lock_release(&sl->sl_lock);
-  return item;
 }
 
+
+//----------------------------------------------------------------------
+// SynchList::RemoveMany
+//      Wait until the list is not empty, then move up to "max"
+//	elements from its beginning to the end of "elems", under one
+//	lock acquire.
+// Returns:
+//	The number of elements moved, at least 1.
+//----------------------------------------------------------------------
+
+size_t sl_remove_many(struct SynchList *sl, struct list *elems, size_t max)
+{
+  struct list_elem *e;
+  size_t n;
+  ASSERT(max > 0);
+  lock_acquire(&sl->sl_lock);
+  while(list_empty(&sl->sl_list)){
+    cond_wait(&sl->sl_empty, &sl->sl_lock);
+  }
+  e = list_begin(&sl->sl_list);
+  for (n = 0; n < max && e != list_end(&sl->sl_list); n++)
+    e = list_next(e);
+  list_splice(list_end(elems), list_begin(&sl->sl_list), e);
+  if (!list_empty(&sl->sl_list))
+    cond_signal(&sl->sl_empty, &sl->sl_lock);
+  lock_release(&sl->sl_lock);
+  return n;
+}
@@ -20,6 +20,11 @@
 //	1. Threads trying to remove an item from a list will
 //	wait until the list has an element on it.
 //	2. One thread at a time can access list data structures
+//
+// A list holds either items, which sl_append() wraps in an
+// SL_element it allocates, or structures that embed their own
+// list_elem, queued with sl_append_elem() and the batch routines,
+// which allocate nothing.  Don't mix the two in one list.
 
 struct SynchList {
   struct list sl_list;
@@ -37,3 +42,7 @@ void sl_init(struct SynchList *sl);
 void sl_destroy(struct SynchList *sl);
 void sl_append(struct SynchList *sl, void *item);
 void *sl_remove(struct SynchList *sl);
+void sl_append_elem(struct SynchList *sl, struct list_elem *elem);
+struct list_elem *sl_remove_elem(struct SynchList *sl);
+void sl_append_many(struct SynchList *sl, struct list *elems);
+size_t sl_remove_many(struct SynchList *sl, struct list *elems, size_t max);
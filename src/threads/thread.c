@@ -1,28 +1,65 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <div64.h>
 #include <stddef.h>
 #include <random.h>
+#include <stats.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/cpu.h"
 #include "threads/flags.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/kstack.h"
+#include "threads/latency.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
+#include "threads/trace.h"
+#include "threads/tunable.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
 
+/* Subsystem of this file's debug() messages. */
+#define DEBUG_SUBSYS LOG_THREAD
+
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
    of thread.h for details. */
 #define THREAD_MAGIC 0xcd6abf4b
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, waiting for one CPU.
+   There is one FIFO queue per priority, and bit P of MASK is set
+   when QUEUES[P] is nonempty, so the highest-priority ready
+   thread is found in constant time.
+
+   Each CPU has its own run queue, so that CPUs do not contend
+   for one.  A thread goes back on the queue of the CPU it last
+   ran on, whose cache is likely to still hold its working set,
+   and a CPU whose queue runs dry steals from the busiest other
+   queue.  Interrupts must be off, and LOCK held, to touch one. */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+struct run_queue
+  {
+    struct spinlock lock;       /* Protects the other members. */
+    struct list queues[PRI_CNT]; /* Ready threads, by priority. */
+    uint64_t mask;              /* Bit P set if QUEUES[P] nonempty. */
+    int cnt;                    /* Number of threads in QUEUES. */
+  };
+static struct run_queue run_queues[CPU_MAX];
+
+/* List of all processes.  Processes are added to this list when
+   they are created and removed when they exit.  The multilevel
+   feedback queue scheduler walks it once a second, and
+   thread_print_list() on request. */
+static struct list all_list;
 
 /* Idle thread. */
 static struct thread *idle_thread;
@@ -30,8 +67,25 @@ static struct thread *idle_thread;
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
 
-/* Lock used by allocate_tid(). */
-static struct lock tid_lock;
+/* Table of tids.  Free slots are chained through NEXT_FREE and
+   reused most recently freed first, which keeps the indexes in
+   use, and so the process list, dense.  A slot is held by its
+   thread until the thread is destroyed, and by whoever else calls
+   tid_hold(), such as the process list, which keeps a process's
+   pid from being reused while its exit status may still be
+   asked for.  Tids are freed by schedule_tail() with interrupts
+   off, so the table is protected by a spin lock. */
+struct tid_slot
+  {
+    struct thread *thread;      /* Thread with this tid, if any. */
+    int next_free;              /* Next free slot, if free; -1 ends. */
+    uint16_t generation;        /* Changed each time the slot is freed. */
+    uint16_t ref_cnt;           /* Holders; 0 if free. */
+  };
+static struct tid_slot tids[TID_CNT];
+static int tid_free_head;       /* First free slot, or -1. */
+static int tid_used_cnt;        /* Slots ever handed out. */
+static struct spinlock tid_lock;
 
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
@@ -42,30 +96,66 @@ struct kernel_thread_frame
   };
 
 /* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
+static long long switch_cnt;    /* # of thread switches. */
+static long long preempt_cnt;   /* # of those that preempted a thread. */
 
 /* Scheduling. */
-#define TIME_SLICE 4            /* # of timer ticks to give each thread. */
+#define TIME_SLICE 4            /* Default # of timer ticks per thread. */
+static int time_slice = TIME_SLICE; /* Tunable "time_slice". */
+static int time_slice_low = TIME_SLICE; /* Tunable "time_slice_low". */
 static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+static bool preempting;         /* Running thread is being preempted. */
+
+/* Fair-share scheduling, tunable "fair_share": if nonzero, ready
+   threads of equal priority are not served strictly in turn.
+   Instead the scheduler picks the one whose group has had the
+   least CPU lately, so that a process tree with many threads gets
+   no more CPU, as a whole, than one with a single thread.
+   Threads within a group still take turns.  A group is a
+   top-level process and all its descendants (see share_group in
+   struct thread).
+
+   Recent use is kept per slot, not per group: groups whose ids
+   are equal modulo SHARE_SLOTS share a slot, and so a share.  It
+   counts ticks and is halved every second. */
+static int fair_share;
+#define SHARE_SLOTS 64
+static unsigned share_ticks[SHARE_SLOTS];
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multilevel feedback queue scheduler. */
+#define NICE_MIN -20            /* Lowest niceness. */
+#define NICE_MAX 20             /* Highest niceness. */
+#define PRIORITY_INTERVAL 4     /* Ticks between priority updates. */
+static fixed_point load_avg;    /* Moving average of ready threads. */
+
 static void kernel_thread (thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
-static struct thread *running_thread (void);
 static struct thread *next_thread_to_run (void);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
+static void yield (bool preempted);
 void schedule_tail (struct thread *prev);
-static tid_t allocate_tid (void);
+static tid_t allocate_tid (struct thread *);
+static void release_thread_tid (struct thread *);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static void set_priority (struct thread *, int);
+static void mlfqs_tick (struct thread *);
+static void share_tick (struct thread *);
+static int mlfqs_priority (const struct thread *);
+static unsigned slice_ticks (int priority);
+static int ready_max_priority (void);
+static int ready_total (void);
+static tid_t create_thread (const char *name, int priority,
+                            thread_func *, void *aux, bool counted);
 
 /* Initializes the threading system (not individual threads!) by
    transforming the code that's currently running into a thread.
@@ -84,16 +174,33 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
-  lock_init (&tid_lock);
-  list_init (&ready_list);
+  tunable_register ("time_slice", &time_slice, 1, TIMER_FREQ_MAX);
+  tunable_register ("time_slice_low", &time_slice_low, 1, TIMER_FREQ_MAX);
+  tunable_register ("fair_share", &fair_share, 0, 1);
+  spin_init (&tid_lock);
+  tid_free_head = -1;
+  for (i = 0; i < CPU_MAX; i++)
+    {
+      struct run_queue *rq = &run_queues[i];
+      int pri;
+
+      spin_init (&rq->lock);
+      for (pri = 0; pri < PRI_CNT; pri++)
+        list_init (&rq->queues[pri]);
+      rq->mask = 0;
+      rq->cnt = 0;
+    }
+  list_init (&all_list);
 
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
-  initial_thread->tid = allocate_tid ();
+  initial_thread->tid = allocate_tid (initial_thread);
 
   DEBUG_thread_init();
 }
@@ -103,6 +210,8 @@ thread_init (void)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
@@ -110,12 +219,15 @@ init_thread (struct thread *t, const char *name, int priority)
   memset (t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
   strlcpy (t->name, name, sizeof t->name);
-  t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->stack = thread_stack_top (t);
+  t->priority = t->base_priority = priority;
+  t->cpu = cpu_current ()->id;
+  list_init (&t->held_locks);
   t->magic = THREAD_MAGIC;
 
-  /* YES! You may want add stuff here. */
-  map_init(&(t->open_file_table));
+  old_level = intr_disable ();
+  list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
 }
 
 /* Starts preemptive thread scheduling by enabling interrupts.
@@ -141,28 +253,194 @@ void
 thread_tick (void) 
 {
   struct thread *t = thread_current ();
+  struct cpu *cpu = cpu_current ();
 
   /* Update statistics. */
   if (t == idle_thread)
-    idle_ticks++;
+    cpu->idle_ticks++;
 #ifdef USERPROG
   else if (t->pagedir != NULL)
-    user_ticks++;
+    {
+      cpu->user_ticks++;
+      t->user_ticks++;
+    }
 #endif
   else
-    kernel_ticks++;
+    {
+      cpu->kernel_ticks++;
+      t->kernel_ticks++;
+    }
+
+  if (thread_mlfqs)
+    mlfqs_tick (t);
+  if (fair_share)
+    share_tick (t);
 
   /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  if (++thread_ticks >= slice_ticks (t->priority))
     intr_yield_on_return ();
 }
 
+/* Charges the current tick to running thread T's fair-share
+   group, and once a second halves every group's recent use. */
+static void
+share_tick (struct thread *t)
+{
+  if (t != idle_thread)
+    share_ticks[(unsigned) t->share_group % SHARE_SLOTS]++;
+  if (timer_ticks () % TIMER_FREQ == 0)
+    {
+      int i;
+
+      for (i = 0; i < SHARE_SLOTS; i++)
+        share_ticks[i] /= 2;
+    }
+}
+
+/* Returns the number of ticks a thread of the given PRIORITY
+   runs before it is preempted.  At PRI_DEFAULT and above that is
+   time_slice; below, it moves linearly toward time_slice_low at
+   PRI_MIN.  Setting time_slice_low above time_slice gives the
+   CPU-bound threads that MLFQS pushes to low priorities longer,
+   cheaper slices while interactive threads keep short ones. */
+static unsigned
+slice_ticks (int priority)
+{
+  if (priority >= PRI_DEFAULT)
+    return time_slice;
+  return (time_slice + (time_slice_low - time_slice) * (PRI_DEFAULT - priority)
+          / (PRI_DEFAULT - PRI_MIN));
+}
+
+/* Stores in *S the idle, kernel and user ticks of all CPUs. */
+static void
+sum_cpu_ticks (struct stats *s) 
+{
+  int i;
+
+  s->idle_ticks = s->kernel_ticks = s->user_ticks = 0;
+  for (i = 0; i < cpu_cnt; i++)
+    {
+      s->idle_ticks += cpus[i].idle_ticks;
+      s->kernel_ticks += cpus[i].kernel_ticks;
+      s->user_ticks += cpus[i].user_ticks;
+    }
+}
+
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
 {
+  struct stats s;
+
+  sum_cpu_ticks (&s);
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
-          idle_ticks, kernel_ticks, user_ticks);
+          s.idle_ticks, s.kernel_ticks, s.user_ticks);
+}
+
+/* Most threads thread_print_list() prints. */
+#define THREAD_LIST_MAX 128
+
+/* What thread_print_list() records of a thread. */
+struct thread_snapshot
+  {
+    tid_t tid;
+    char name[16];
+    enum thread_status status;
+    int priority;
+    long long ticks;            /* User and kernel ticks. */
+    tid_t lock_holder;          /* Holder of awaited lock, or 0. */
+  };
+
+/* Prints every thread with its state, and the length of each
+   nonempty run queue.  The threads are copied with interrupts
+   off and printed afterward, so the scheduler is held up only
+   briefly; the list is a snapshot and may be stale by the time
+   it is printed. */
+void
+thread_print_list (void) 
+{
+  static const char *status_names[] =
+    {
+      [THREAD_RUNNING] = "running",
+      [THREAD_READY] = "ready",
+      [THREAD_BLOCKED] = "blocked",
+      [THREAD_DYING] = "dying",
+    };
+  int queue_len[PRI_CNT];
+  struct thread_snapshot *snap;
+  enum intr_level old_level;
+  struct list_elem *e;
+  size_t cnt, total, i;
+  int pri, cpu;
+
+  snap = malloc (THREAD_LIST_MAX * sizeof *snap);
+  if (snap == NULL)
+    {
+      printf ("Threads: out of memory\n");
+      return;
+    }
+
+  old_level = intr_disable ();
+  cnt = total = 0;
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e), total++)
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      struct thread_snapshot *ts;
+
+      if (cnt >= THREAD_LIST_MAX)
+        continue;
+      ts = &snap[cnt++];
+      ts->tid = t->tid;
+      strlcpy (ts->name, t->name, sizeof ts->name);
+      ts->status = t->status;
+      ts->priority = t->priority;
+      ts->ticks = t->user_ticks + t->kernel_ticks;
+      ts->lock_holder = (t->waiting_lock != NULL
+                         && t->waiting_lock->holder != NULL
+                         ? t->waiting_lock->holder->tid : 0);
+    }
+  for (pri = 0; pri < PRI_CNT; pri++)
+    {
+      queue_len[pri] = 0;
+      for (cpu = 0; cpu < cpu_cnt; cpu++)
+        queue_len[pri] += list_size (&run_queues[cpu].queues[pri]);
+    }
+  intr_set_level (old_level);
+
+  printf ("Threads: %zu threads, run queues:", total);
+  for (pri = PRI_CNT - 1; pri >= 0; pri--)
+    if (queue_len[pri] > 0)
+      printf (" %d@%d", queue_len[pri], pri + PRI_MIN);
+  printf ("\n");
+  for (i = 0; i < cnt; i++)
+    {
+      const struct thread_snapshot *ts = &snap[i];
+
+      printf ("  %4d %-16s %-7s pri %2d %8lld ticks", ts->tid, ts->name,
+              status_names[ts->status], ts->priority, ts->ticks);
+      if (ts->lock_holder != 0)
+        printf (", waiting for lock held by %d", ts->lock_holder);
+      printf ("\n");
+    }
+  if (cnt < total)
+    printf ("  (%zu more)\n", total - cnt);
+  free (snap);
+}
+
+/* Fills in the scheduler fields of *S. */
+void
+thread_get_stats (struct stats *s) 
+{
+  enum intr_level old_level = intr_disable ();
+
+  sum_cpu_ticks (s);
+  s->switch_cnt = switch_cnt;
+  s->preempt_cnt = preempt_cnt;
+  s->thread_cnt = list_size (&all_list);
+  s->ready_cnt = ready_total ();
+  intr_set_level (old_level);
 }
 
 /* Creates a new kernel thread named NAME with the given initial
@@ -177,18 +455,13 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   Threads are scheduled strictly by priority, so if the new
+   thread's PRIORITY is higher than the running thread's, the new
+   thread runs before thread_create() returns. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
 {
-  struct thread *t;
-  struct kernel_thread_frame *kf;
-  struct switch_entry_frame *ef;
-  struct switch_threads_frame *sf;
-  tid_t tid;
   /* NO! I do not think there's any reason to modify this function. */
   
   ASSERT (function != NULL);
@@ -198,17 +471,64 @@ thread_create (const char *name, int priority,
       return TID_ERROR;
     }
 
+  return create_thread (name, priority, function, aux, true);
+}
+
+/* Creates a kernel daemon, as thread_create(), for a service
+   that runs for the whole lifetime of the system (for example
+   file system I/O helpers).  A daemon must never exit.  Daemons
+   are not counted by DEBUG_thread_poweroff_check() and are not
+   subject to the -tcl option, so starting one does not change
+   the behaviour of user programs or tests. */
+tid_t
+thread_create_daemon (const char *name, int priority,
+                      thread_func *function, void *aux) 
+{
+  ASSERT (function != NULL);
+
+  return create_thread (name, priority, function, aux, false);
+}
+
+/* Does the work of thread_create() and thread_create_daemon().
+   COUNTED tells whether the new thread takes part in the
+   DEBUG_thread_* running thread count. */
+static tid_t
+create_thread (const char *name, int priority,
+               thread_func *function, void *aux, bool counted) 
+{
+  void *stack_top;
+  struct thread *t;
+  struct kernel_thread_frame *kf;
+  struct switch_entry_frame *ef;
+  struct switch_threads_frame *sf;
+  tid_t tid;
     
-  /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
-  if (t == NULL)
+  /* Allocate thread, at the top of its kernel stack. */
+  stack_top = kstack_alloc ();
+  if (stack_top == NULL)
     {
     return TID_ERROR;
     }
+  t = (struct thread *) stack_top - 1;
+
+  tid = allocate_tid (t);
+  if (tid == TID_ERROR)
+    {
+      kstack_free (stack_top);
+      return TID_ERROR;
+    }
 
-  /* Initialize thread. */
+  /* Initialize thread.  Under -mlfqs it inherits its creator's
+     niceness and recent CPU use, and PRIORITY is ignored. */
   init_thread (t, name, priority);
-  tid = t->tid = allocate_tid ();
+  t->tid = tid;
+  t->share_group = thread_current ()->share_group;
+  if (thread_mlfqs) 
+    {
+      t->nice = thread_current ()->nice;
+      t->recent_cpu = thread_current ()->recent_cpu;
+      t->priority = t->base_priority = mlfqs_priority (t);
+    }
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -225,13 +545,15 @@ thread_create (const char *name, int priority,
   sf->eip = switch_entry;
 
   /* Add to run queue. */
-  DEBUG_thread_count_up();
+  if (counted)
+    DEBUG_thread_count_up();
   thread_unblock (t);
 
   debug("%s#%d: thread_create(\"%s\", ...) RETURNS %d\n",
         thread_current()->name,
         thread_current()->tid,
         name, tid);
+  thread_preempt ();
   return tid;
 }
 
@@ -247,6 +569,7 @@ thread_block (void)
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
+  trace (TRACE_BLOCK, (uint32_t) __builtin_return_address (0), 0);
   thread_current ()->status = THREAD_BLOCKED;
   schedule ();
 }
@@ -255,10 +578,13 @@ thread_block (void)
    This is an error if T is not blocked.  (Use thread_yield() to
    make the running thread ready.)
 
-   This function does not preempt the running thread.  This can
+   Outside an interrupt handler this function does not preempt
+   the running thread, even if T has a higher priority.  This can
    be important: if the caller had disabled interrupts itself,
    it may expect that it can atomically unblock a thread and
-   update other data. */
+   update other data.  Call thread_preempt() afterward to give
+   way to T.  From an interrupt handler, the interrupted thread
+   yields on return if T outranks it. */
 void
 thread_unblock (struct thread *t) 
 {
@@ -268,9 +594,35 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  trace (TRACE_UNBLOCK, t->tid, 0);
+  ready_push (t);
   t->status = THREAD_READY;
+  t->ready_tick = timer_ticks ();
+  if (latency_enabled)
+    latency_wakeup (t);
+  if (intr_context () && t->priority > thread_current ()->priority)
+    intr_yield_on_return ();
+  intr_set_level (old_level);
+}
+
+/* Yields the CPU if a thread of higher priority than the running
+   thread is ready to run.  In an interrupt handler, yields when
+   the handler returns instead.  Does nothing if interrupts are
+   off outside an interrupt handler, since the caller then relies
+   on not being preempted. */
+void
+thread_preempt (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  bool preempt = ready_max_priority () > thread_current ()->priority;
+
   intr_set_level (old_level);
+  if (!preempt)
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else if (old_level == INTR_ON)
+    thread_yield_preempted ();
 }
 
 /* Returns the name of the running thread. */
@@ -316,13 +668,15 @@ thread_exit (void)
 
 #ifdef USERPROG
   process_cleanup ();
-  map_close_all_files(&(thread_current()->open_file_table));
 #endif
 
+  fpu_thread_exit ();
+
   /* Just set our status to dying and schedule another process.
      We will be destroyed during the call to schedule_tail(). */
   intr_disable ();
 
+  list_remove (&thread_current ()->allelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -332,6 +686,23 @@ thread_exit (void)
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) 
+{
+  yield (false);
+}
+
+/* Yields the CPU, as thread_yield(), because a thread of higher
+   priority is ready or the current thread's time slice is over.
+   Counted as an involuntary context switch. */
+void
+thread_yield_preempted (void) 
+{
+  yield (true);
+}
+
+/* Does the work of thread_yield() and thread_yield_preempted().
+   PREEMPTED tells which kind of context switch to count. */
+static void
+yield (bool preempted) 
 {
   struct thread *cur = thread_current ();
   enum intr_level old_level;
@@ -340,17 +711,126 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_push_back (&ready_list, &cur->elem);
+    {
+      ready_push (cur);
+      cur->ready_tick = timer_ticks ();
+    }
   cur->status = THREAD_READY;
+  preempting = preempted;
   schedule ();
   intr_set_level (old_level);
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Sets the current thread's base priority to NEW_PRIORITY,
+   yielding the CPU if it no longer has the highest priority.
+   While other threads donate a higher priority to it, the
+   thread keeps running at that priority instead.  Ignored under
+   -mlfqs, where the scheduler sets priorities itself. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *cur = thread_current ();
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+  if (thread_mlfqs)
+    return;
+
+  cur->base_priority = new_priority;
+  thread_update_priority (cur);
+  thread_preempt ();
+}
+
+/* Recomputes T's priority as the highest of its base priority
+   and the priorities of the threads waiting for locks that T
+   holds, and moves T to the matching run queue if it is ready.
+   Does not preempt the running thread.  Does nothing under
+   -mlfqs, which has no priority donation. */
+void
+thread_update_priority (struct thread *t) 
+{
+  enum intr_level old_level;
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  ASSERT (is_thread (t));
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&t->held_locks); e != list_end (&t->held_locks);
+       e = list_next (e))
+    {
+      struct pqueue *waiters = &list_entry (e, struct lock, elem)
+                               ->semaphore.waiters;
+
+      if (!pqueue_empty (waiters))
+        {
+          struct thread *waiter = pqueue_entry (pqueue_max (waiters),
+                                              struct thread, waitelem);
+          if (waiter->priority > priority)
+            priority = waiter->priority;
+        }
+    }
+
+  set_priority (t, priority);
+  intr_set_level (old_level);
+}
+
+/* Raises T's priority to PRIORITY, if that is higher, on behalf
+   of a thread waiting for a lock that T holds.  Does not preempt
+   the running thread. */
+void
+thread_donate_priority (struct thread *t, int priority) 
+{
+  enum intr_level old_level;
+
+  ASSERT (is_thread (t));
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable ();
+  if (priority > t->priority)
+    set_priority (t, priority);
+  intr_set_level (old_level);
+}
+
+/* Restores the order of queue H after the priority of the
+   waiter whose element is E has changed, the cheap way if it
+   RAISED. */
+static void
+requeue_waiter (struct pqueue *h, struct pqueue_elem *e, bool raised) 
+{
+  if (raised)
+    pqueue_raise (h, e);
+  else
+    pqueue_update (h, e);
+}
+
+/* Changes T's priority to PRIORITY, moving T to the matching run
+   queue if it is ready, or within the queues of waiters it is in
+   if it is blocked. */
+static void
+set_priority (struct thread *t, int priority) 
+{
+  bool raised = priority > t->priority;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->status == THREAD_READY) 
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+      return;
+    }
+
+  if (priority == t->priority)
+    return;
+  t->priority = priority;
+  if (t->waiting_sema != NULL)
+    requeue_waiter (&t->waiting_sema->waiters, &t->waitelem, raised);
+  if (t->waiting_cond != NULL)
+    requeue_waiter (&t->waiting_cond->waiters, t->cond_elem, raised);
 }
 
 /* Returns the current thread's priority. */
@@ -360,37 +840,107 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recomputes
+   its priority, yielding if it no longer has the highest. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  cur->nice = nice;
+  if (thread_mlfqs)
+    set_priority (cur, mlfqs_priority (cur));
+  intr_set_level (old_level);
+  thread_preempt ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load = fp_round (load_avg * 100);
+  intr_set_level (old_level);
+  return load;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent = fp_round (thread_current ()->recent_cpu * 100);
+  intr_set_level (old_level);
+  return recent;
 }
-
+
+/* Returns the priority the multilevel feedback queue scheduler
+   assigns to T, given its recent CPU use and niceness. */
+static int
+mlfqs_priority (const struct thread *t) 
+{
+  int priority = PRI_MAX - fp_trunc (t->recent_cpu / 4) - t->nice * 2;
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+  return priority;
+}
+
+/* Does the multilevel feedback queue scheduler's accounting for
+   a timer tick in which CUR was running.  Only CUR's recent_cpu
+   grows from tick to tick, so only its priority is recomputed
+   every PRIORITY_INTERVAL ticks; every thread's priority is
+   recomputed just once a second, when load_avg and all the
+   recent_cpu values decay. */
+static void
+mlfqs_tick (struct thread *cur) 
+{
+  int64_t ticks = timer_ticks ();
+
+  if (cur != idle_thread)
+    cur->recent_cpu += FP_ONE;
+
+  if (mod64_32 (ticks, TIMER_FREQ) == 0) 
+    {
+      int ready = ready_total () + (cur != idle_thread ? 1 : 0);
+      fixed_point decay;
+      struct list_elem *e;
+
+      load_avg = fp_mul (fp_from_int (59) / 60, load_avg)
+                 + fp_from_int (ready) / 60;
+      decay = fp_div (2 * load_avg, 2 * load_avg + FP_ONE);
+      for (e = list_begin (&all_list); e != list_end (&all_list);
+           e = list_next (e))
+        {
+          struct thread *t = list_entry (e, struct thread, allelem);
+          if (t == idle_thread)
+            continue;
+          t->recent_cpu = fp_mul (decay, t->recent_cpu)
+                          + fp_from_int (t->nice);
+          set_priority (t, mlfqs_priority (t));
+        }
+    }
+  else if (mod64_32 (ticks, PRIORITY_INTERVAL) == 0
+           && cur != idle_thread)
+    set_priority (cur, mlfqs_priority (cur));
+
+  if (ready_max_priority () > cur->priority)
+    intr_yield_on_return ();
+}
+
 /* Idle thread.  Executes when no other thread is ready to run.
 
    The idle thread is initially put on the ready list by
@@ -413,6 +963,10 @@ idle (void *idle_started_ UNUSED)
       intr_disable ();
       thread_block ();
 
+      /* Nothing is ready to run, so let the timer interrupt come
+         as late as the pending timers allow. */
+      timer_idle_enter ();
+
       /* Re-enable interrupts and wait for the next one.
 
          The `sti' instruction disables interrupts until the
@@ -446,14 +1000,26 @@ running_thread (void)
 {
   uint32_t *esp;
 
-  /* Copy the CPU's stack pointer into `esp', and then round that
-     down to the start of a page.  Because `struct thread' is
-     always at the beginning of a page and the stack pointer is
-     somewhere in the middle, this locates the current thread. */
+  /* Copy the CPU's stack pointer into `esp'.  `struct thread'
+     is always at the top of its kernel stack slot, so rounding
+     the stack pointer up to the slot boundary locates the current
+     thread.  The initial thread instead runs on the loader's
+     stack, with `struct thread' at the beginning of the page. */
   asm ("mov %%esp, %0" : "=g" (esp));
+  if (kstack_contains (esp))
+    return (struct thread *) kstack_slot_top (esp) - 1;
   return pg_round_down (esp);
 }
 
+/* Returns the top of T's kernel stack. */
+uint8_t *
+thread_stack_top (const struct thread *t)
+{
+  return (kstack_contains (t)
+          ? (uint8_t *) t
+          : (uint8_t *) pg_round_down (t) + PGSIZE);
+}
+
 /* Returns true if T appears to point to a valid thread. */
 static bool
 is_thread (struct thread *t)
@@ -470,22 +1036,183 @@ alloc_frame (struct thread *t, size_t size)
   ASSERT (is_thread (t));
   ASSERT (size % sizeof (uint32_t) == 0);
 
+  /* The stack may be reused, so clear the frame: a saved %ebp of
+     0 is what ends backtraces. */
   t->stack -= size;
+  memset (t->stack, 0, size);
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Adds ready thread T to the back of the run queue for its
+   priority. */
+static void
+ready_push (struct thread *t) 
+{
+  struct run_queue *rq = &run_queues[t->cpu];
+  int pri = t->priority - PRI_MIN;
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  old_level = spin_lock_irqsave (&rq->lock);
+  list_push_back (&rq->queues[pri], &t->elem);
+  rq->mask |= (uint64_t) 1 << pri;
+  rq->cnt++;
+  spin_unlock_irqrestore (&rq->lock, old_level);
+}
+
+/* Removes ready thread T from its run queue. */
+static void
+ready_remove (struct thread *t) 
+{
+  struct run_queue *rq = &run_queues[t->cpu];
+  int pri = t->priority - PRI_MIN;
+  enum intr_level old_level;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  old_level = spin_lock_irqsave (&rq->lock);
+  list_remove (&t->elem);
+  rq->cnt--;
+  if (list_empty (&rq->queues[pri]))
+    rq->mask &= ~((uint64_t) 1 << pri);
+  spin_unlock_irqrestore (&rq->lock, old_level);
+}
+
+/* Returns the highest priority of any thread in RQ, or
+   PRI_MIN - 1 if RQ is empty. */
+static int
+rq_max_priority (const struct run_queue *rq) 
+{
+  uint32_t high = rq->mask >> 32;
+  uint32_t low = rq->mask;
+
+  if (high != 0)
+    return PRI_MIN + 63 - __builtin_clz (high);
+  else if (low != 0)
+    return PRI_MIN + 31 - __builtin_clz (low);
+  else
+    return PRI_MIN - 1;
+}
+
+/* Returns the highest priority of any thread ready to run on
+   this CPU, or PRI_MIN - 1 if no thread is. */
+static int
+ready_max_priority (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  return rq_max_priority (&run_queues[cpu_current ()->id]);
+}
+
+/* Returns the number of ready threads on all CPUs. */
+static int
+ready_total (void) 
+{
+  int cnt = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    cnt += run_queues[i].cnt;
+  return cnt;
+}
+
+/* Returns the thread in nonempty QUEUE to run next under
+   fair-share scheduling: the frontmost of those whose group has
+   the least recent CPU use. */
+static struct thread *
+share_pick (struct list *queue)
+{
+  struct thread *best = NULL;
+  unsigned best_ticks = 0;
+  struct list_elem *e;
+
+  for (e = list_begin (queue); e != list_end (queue); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, elem);
+      unsigned ticks = share_ticks[(unsigned) t->share_group % SHARE_SLOTS];
+
+      if (best == NULL || ticks < best_ticks)
+        {
+          best = t;
+          best_ticks = ticks;
+        }
+    }
+  return best;
+}
+
+/* Removes and returns the front thread of the highest-priority
+   nonempty queue in RQ, or, under fair-share scheduling, the one
+   share_pick() chooses from that queue.  Returns a null pointer
+   if RQ is empty. */
+static struct thread *
+rq_pop (struct run_queue *rq) 
+{
+  enum intr_level old_level = spin_lock_irqsave (&rq->lock);
+  int pri = rq_max_priority (rq);
+  struct thread *t = NULL;
+
+  if (pri >= PRI_MIN)
+    {
+      struct list *queue = &rq->queues[pri - PRI_MIN];
+
+      if (fair_share)
+        {
+          t = share_pick (queue);
+          list_remove (&t->elem);
+        }
+      else
+        t = list_entry (list_pop_front (queue), struct thread, elem);
+      rq->cnt--;
+      if (list_empty (queue))
+        rq->mask &= ~((uint64_t) 1 << (pri - PRI_MIN));
+    }
+  spin_unlock_irqrestore (&rq->lock, old_level);
+  return t;
+}
+
+/* Returns the run queue of a running CPU other than SELF with
+   the most threads in it, or a null pointer if every other run
+   queue is empty.  Reads the counts without locking, so the
+   queue may be empty again by the time its lock is taken. */
+static struct run_queue *
+busiest_queue (int self) 
+{
+  struct run_queue *busiest = NULL;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (i != self && cpus[i].started && run_queues[i].cnt > 0
+        && (busiest == NULL || run_queues[i].cnt > busiest->cnt))
+      busiest = &run_queues[i];
+  return busiest;
+}
+
+/* Chooses and returns the next thread to be scheduled on this
+   CPU.  Should return a thread from its run queue, unless the
+   run queue is empty.  (If the running thread can continue
+   running, then it will be in the run queue.)  Picks the front
+   of the highest-priority nonempty queue, so threads of equal
+   priority take turns.  If this CPU's run queue is empty,
+   steals the best thread in the busiest other run queue, and
+   failing that returns idle_thread. */
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
-  else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+  struct cpu *cpu = cpu_current ();
+  struct thread *t = rq_pop (&run_queues[cpu->id]);
+
+  if (t == NULL)
+    {
+      struct run_queue *victim = busiest_queue (cpu->id);
+
+      if (victim != NULL)
+        t = rq_pop (victim);
+      if (t == NULL)
+        return idle_thread;
+      t->cpu = cpu->id;
+    }
+  return t;
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -513,10 +1240,18 @@ schedule_tail (struct thread *prev)
 
   /* Mark us as running. */
   cur->status = THREAD_RUNNING;
+  if (cur != idle_thread)
+    cur->wait_ticks += timer_ticks () - cur->ready_tick;
 
   /* Start new time slice. */
   thread_ticks = 0;
 
+  /* Trap the FPU unless its registers are already ours. */
+  fpu_switch (cur);
+
+  if (latency_enabled)
+    latency_run (cur);
+
 #ifdef USERPROG
   /* Activate the new address space. */
   process_activate ();
@@ -526,11 +1261,13 @@ schedule_tail (struct thread *prev)
      thread.  This must happen late so that thread_exit() doesn't
      pull out the rug under itself.  (We don't free
      initial_thread because its memory was not obtained via
-     palloc().) */
+     kstack_alloc().) */
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != cur);
-      palloc_free_page (prev);
+      if (prev->tid != TID_ERROR)
+        release_thread_tid (prev);
+      kstack_free (prev + 1);
     }
 }
 
@@ -552,23 +1289,145 @@ schedule (void)
   ASSERT (cur->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  if (cur == idle_thread && next != idle_thread)
+    timer_idle_exit ();
+  if (cur != next)
+    {
+      switch_cnt++;
+      if (preempting)
+        {
+          preempt_cnt++;
+          cur->involuntary_switches++;
+        }
+      else if (cur->status != THREAD_DYING)
+        cur->voluntary_switches++;
+    }
+  preempting = false;
   if (cur != next)
-    prev = switch_threads (cur, next);
+    {
+      trace (TRACE_SCHEDULE, cur->tid, next->tid);
+      prev = switch_threads (cur, next);
+    }
   schedule_tail (prev); 
 }
 
-/* Returns a tid to use for a new thread. */
+/* Returns a tid to use for new thread T, or TID_ERROR if the
+   tid table is full. */
 static tid_t
-allocate_tid (void) 
+allocate_tid (struct thread *t) 
 {
-  static tid_t next_tid = 1;
-  tid_t tid;
+  enum intr_level old_level = spin_lock_irqsave (&tid_lock);
+  struct tid_slot *s;
+  int idx;
 
-  lock_acquire (&tid_lock);
-  tid = next_tid++;
-  lock_release (&tid_lock);
+  if (tid_free_head != -1)
+    {
+      idx = tid_free_head;
+      tid_free_head = tids[idx].next_free;
+    }
+  else if (tid_used_cnt < TID_CNT)
+    idx = tid_used_cnt++;
+  else
+    {
+      spin_unlock_irqrestore (&tid_lock, old_level);
+      return TID_ERROR;
+    }
+  s = &tids[idx];
+  s->thread = t;
+  s->ref_cnt = 1;
+  spin_unlock_irqrestore (&tid_lock, old_level);
 
-  return tid;
+  /* Generation 0 would make the first tid 0. */
+  return ((tid_t) s->generation + 1) << TID_INDEX_BITS | idx;
+}
+
+/* Returns the slot for TID, which must be live, or a null
+   pointer.  TID_LOCK must be held. */
+static struct tid_slot *
+tid_lookup (tid_t tid)
+{
+  struct tid_slot *s;
+
+  ASSERT (spin_is_locked (&tid_lock));
+
+  if (tid <= 0)
+    return NULL;
+  s = &tids[TID_INDEX (tid)];
+  if (s->ref_cnt == 0
+      || (tid_t) (s->generation + 1) != tid >> TID_INDEX_BITS)
+    return NULL;
+  return s;
+}
+
+/* Returns the thread whose tid is TID, or a null pointer if it
+   no longer exists.  The thread may exit at any time unless
+   interrupts are off. */
+struct thread *
+thread_by_tid (tid_t tid) 
+{
+  enum intr_level old_level = spin_lock_irqsave (&tid_lock);
+  struct tid_slot *s = tid_lookup (tid);
+  struct thread *t = s != NULL ? s->thread : NULL;
+
+  spin_unlock_irqrestore (&tid_lock, old_level);
+  return t;
+}
+
+/* Keeps TID from being reused until tid_release() is called for
+   it, even after its thread is destroyed.  Returns false, holding
+   nothing, if TID has already been freed. */
+bool
+tid_hold (tid_t tid) 
+{
+  enum intr_level old_level = spin_lock_irqsave (&tid_lock);
+  struct tid_slot *s = tid_lookup (tid);
+
+  if (s != NULL)
+    s->ref_cnt++;
+  spin_unlock_irqrestore (&tid_lock, old_level);
+  return s != NULL;
+}
+
+/* Drops a hold on slot S, freeing it if that was the last.
+   TID_LOCK must be held. */
+static void
+unref_tid (struct tid_slot *s) 
+{
+  ASSERT (spin_is_locked (&tid_lock));
+  ASSERT (s->ref_cnt > 0);
+
+  if (--s->ref_cnt == 0)
+    {
+      s->generation++;
+      s->next_free = tid_free_head;
+      tid_free_head = s - tids;
+    }
+}
+
+/* Drops a hold on TID taken by tid_hold(). */
+void
+tid_release (tid_t tid) 
+{
+  enum intr_level old_level = spin_lock_irqsave (&tid_lock);
+  struct tid_slot *s = tid_lookup (tid);
+
+  ASSERT (s != NULL);
+  unref_tid (s);
+  spin_unlock_irqrestore (&tid_lock, old_level);
+}
+
+/* Drops thread T's own hold on its tid, as T is destroyed.
+   Called by schedule_tail() with interrupts off. */
+static void
+release_thread_tid (struct thread *t) 
+{
+  enum intr_level old_level = spin_lock_irqsave (&tid_lock);
+  struct tid_slot *s = tid_lookup (t->tid);
+
+  ASSERT (s != NULL && s->thread == t);
+  s->thread = NULL;
+  unref_tid (s);
+  spin_unlock_irqrestore (&tid_lock, old_level);
 }
 
 /* Offset of `stack' member within `struct thread'.
@@ -2,8 +2,13 @@
 #define THREADS_THREAD_H
 
 #include <debug.h>
+#include <hash.h>
+#include <pqueue.h>
 #include <list.h>
+#include <ohash.h>
+#include <stats.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 #include "userprog/flist.h"
 
 /* States in a thread's life cycle. */
@@ -20,6 +25,15 @@ enum thread_status
 typedef int tid_t;
 #define TID_ERROR ((tid_t) -1)          /* Error value for tid_t. */
 
+/* A tid is an index into the table of tids in its low
+   TID_INDEX_BITS bits and that slot's generation above them.  A
+   slot's generation changes each time it is freed, so a stale tid
+   never names the slot's next occupant.  User processes have the
+   tid of their thread as their pid. */
+#define TID_INDEX_BITS 12
+#define TID_CNT (1 << TID_INDEX_BITS)   /* Size of the tid table. */
+#define TID_INDEX(TID) ((unsigned) (TID) & (TID_CNT - 1))
+
 /* Thread priorities. */
 #define PRI_MIN 0                       /* Lowest priority. */
 #define PRI_DEFAULT 31                  /* Default priority. */
@@ -27,60 +41,54 @@ typedef int tid_t;
 
 /* A kernel thread or user process.
 
-   Each thread structure is stored in its own 4 kB page.  The
-   thread structure itself sits at the very bottom of the page
-   (at offset 0).  The rest of the page is reserved for the
-   thread's kernel stack, which grows downward from the top of
-   the page (at offset 4 kB).  Here's an illustration:
+   Each thread has a kernel stack of kstack_pages pages (2 by
+   default, set with -ks) in its own slot of the kernel stack
+   region (see threads/kstack.h).  The thread structure itself
+   sits at the very top of the slot, and the stack grows downward
+   from just below it.  Below the stack, the rest of the slot is
+   left unmapped as a guard.  Here's an illustration:
 
-        4 kB +---------------------------------+
+             +---------------------------------+
+             |              magic              |
+             |                :                |
+             |               name              |
+             |              status             |
+             +---------------------------------+
              |          kernel stack           |
              |                |                |
-             |                |                |
              |                V                |
              |         grows downward          |
              |                                 |
+             +---------------------------------+
              |                                 |
-             |                                 |
-             |                                 |
-             |                                 |
-             |                                 |
-             |                                 |
+             |       guard (not mapped)        |
              |                                 |
              +---------------------------------+
-             |              magic              |
-             |                :                |
-             |                :                |
-             |               name              |
-             |              status             |
-        0 kB +---------------------------------+
 
    The upshot of this is twofold:
 
       1. First, `struct thread' must not be allowed to grow too
-         big.  If it does, then there will not be enough room for
-         the kernel stack.  Our base `struct thread' is only a
-         few bytes in size.  It probably should stay well under 1
-         kB.
+         big, since it shares the top stack page.  It probably
+         should stay well under 1 kB.
 
       2. Second, kernel stacks must not be allowed to grow too
-         large.  If a stack overflows, it will corrupt the thread
-         state.  Thus, kernel functions should not allocate large
-         structures or arrays as non-static local variables.  Use
-         dynamic allocation with malloc() or palloc_get_page()
-         instead.
-
-   The first symptom of either of these problems will probably be
-   an assertion failure in thread_current(), which checks that
-   the `magic' member of the running thread's `struct thread' is
-   set to THREAD_MAGIC.  Stack overflow will normally change this
-   value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+         large.  A stack that overflows runs into the guard and
+         panics the kernel, with a double fault if the stack
+         pointer itself went too far.  Kernel functions should
+         still not allocate large structures or arrays as
+         non-static local variables.  Use dynamic allocation with
+         malloc() or palloc_get_page() instead.
+
+   The initial thread is the exception: it runs on the stack set
+   up by the loader, with its struct thread at the bottom of that
+   4 kB page.  thread_current() checks that the `magic' member of
+   the running thread's `struct thread' is set to THREAD_MAGIC,
+   which there still catches most overflows. */
+/* The `elem' member is an element in the run queue (thread.c).
+   The `waitelem' member is an element in a semaphore's queue of
+   waiters (synch.c), which is ordered by priority, so when a
+   blocked thread's priority changes, thread.c moves it within
+   the queues named by `waiting_sema' and `waiting_cond'. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -88,19 +96,65 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Priority, including donations. */
+    int base_priority;                  /* Priority set by the thread. */
+    int nice;                           /* Niceness, for -mlfqs. */
+    fixed_point recent_cpu;             /* Recent CPU use, for -mlfqs. */
+    int cpu;                            /* CPU whose run queue it goes on. */
+    int share_group;                    /* Fair-share group: tid of the
+                                           top-level process, 0 for the
+                                           kernel. */
+    struct list_elem allelem;           /* Element in all threads list. */
+
+    /* Statistics, owned by thread.c. */
+    long long user_ticks;               /* Ticks running user code. */
+    long long kernel_ticks;             /* Ticks running in the kernel. */
+    long long wait_ticks;               /* Ticks ready but not running. */
+    int64_t ready_tick;                 /* When the thread last became ready. */
+    unsigned voluntary_switches;        /* Times it blocked or yielded. */
+    unsigned involuntary_switches;      /* Times it was preempted. */
+    uint64_t wakeup_tsc;                /* When last unblocked, for -lat. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct list held_locks;             /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being acquired, if any. */
+    struct pqueue_elem waitelem;          /* Element in semaphore's waiters. */
+    unsigned wait_seq;                  /* Orders waiters of equal priority. */
+    struct semaphore *waiting_sema;     /* Semaphore being downed, if any. */
+    struct condition *waiting_cond;     /* Condition waited on, if any. */
+    struct pqueue_elem *cond_elem;        /* Element in its waiters. */
 
     /* YES! You may want to add stuff. But make note of point 2 above. */
-    //add per process open file table
-    struct map open_file_table;
     //Used as id in plist
     int element_id;
+
+    /* Owned by userprog/exception.c. */
+    long long fault_cnt[FAULT_CLASS_CNT]; /* Page faults, by class. */
+    int64_t fault_ns[FAULT_CLASS_CNT];    /* Time serving them. */
+
+    /* Owned by devices/disk.c. */
+    long long io_read_bytes;            /* Bytes read from disk. */
+    long long io_write_bytes;           /* Bytes written to disk. */
+    int io_class;                       /* enum disk_io_class. */
+
+    /* Owned by filesys/journal.c. */
+    int journal_depth;                  /* Nesting of journal_begin(). */
+
+    /* Owned by threads/fpu.c. */
+    void *fpu;                          /* FPU save area block, if used. */
+
+    /* Owned by filesys/filesys.c. */
+    struct dir *cwd;                    /* Working directory, null: root. */
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
-    uint32_t *pagedir;                  /* Page directory. */
+    struct process *process;            /* Process, null for a kernel thread. */
+    uint32_t *pagedir;                  /* The process's page directory. */
+    struct user_thread *user_thread;    /* Join record, if joinable. */
+#endif
+#ifdef VM
+    /* Owned by vm/page.c. */
+    void *user_esp;                     /* User stack pointer in syscalls. */
 #endif
 
     /* Owned by thread.c. */
@@ -117,22 +171,35 @@ void thread_start (void);
 
 void thread_tick (void);
 void thread_print_stats (void);
+void thread_print_list (void);
+void thread_get_stats (struct stats *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_daemon (const char *name, int priority,
+                            thread_func *, void *);
 
 void thread_block (void);
 void thread_unblock (struct thread *);
+void thread_preempt (void);
 
+struct thread *running_thread (void);
 struct thread *thread_current (void);
+uint8_t *thread_stack_top (const struct thread *);
 tid_t thread_tid (void);
+struct thread *thread_by_tid (tid_t);
+bool tid_hold (tid_t);
+void tid_release (tid_t);
 const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_yield_preempted (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_update_priority (struct thread *);
+void thread_donate_priority (struct thread *, int);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -0,0 +1,195 @@
+#include "threads/trace.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/binlog.h"
+#include "devices/timer.h"
+
+/* Kernel event tracing.
+
+   Each traced event is recorded in a fixed-size ring of records,
+   overwriting the oldest once the ring is full.  Recording takes
+   no lock, only disables interrupts for the few stores that fill
+   in a record, so events may be traced from interrupt handlers
+   and from the middle of a thread switch.
+
+   trace_dump() prints the ring to the console, oldest record
+   first, one line per record:
+
+        TRACE <tsc> <tid> <event> <arg0> <arg1>
+
+   between "trace: begin" and "trace: end" lines.  The begin line
+   gives the TSC rate, for converting counts to time.  utils/pintos-trace
+   turns that into a timeline.
+
+   With -binlog, the ring goes to the binary log instead, as one
+   BINLOG_TRACE frame: the record count, the lost count and the
+   TSC rate, the event names, and then the records themselves, as
+   laid out in struct trace_rec. */
+
+/* Number of records in the ring.  Must be a power of 2. */
+#define TRACE_SIZE 2048
+
+/* One traced event. */
+struct trace_rec
+  {
+    uint64_t tsc;               /* Time stamp counter. */
+    int32_t tid;                /* Running thread. */
+    uint32_t event;             /* enum trace_event. */
+    uint32_t arg0, arg1;        /* Event-specific. */
+  };
+
+uint32_t trace_mask;
+static struct trace_rec ring[TRACE_SIZE];
+static uint32_t head;                   /* Records ever written. */
+
+/* Event names, as used by trace_enable() and trace_dump(). */
+static const char *event_names[TRACE_EVENT_CNT] =
+  {
+    [TRACE_SCHEDULE] = "sched",
+    [TRACE_BLOCK] = "block",
+    [TRACE_UNBLOCK] = "unblock",
+    [TRACE_SYSCALL_ENTER] = "syscall",
+    [TRACE_SYSCALL_EXIT] = "sysret",
+    [TRACE_DISK_READ] = "disk-read",
+    [TRACE_DISK_WRITE] = "disk-write",
+    [TRACE_DISK_DONE] = "disk-done",
+    [TRACE_PAGE_FAULT] = "fault",
+    [TRACE_LOCK_WAIT] = "lock-wait",
+    [TRACE_LOCK_ACQUIRE] = "lock",
+    [TRACE_EXEC_PHASE] = "exec",
+  };
+
+/* Enables tracing of the events in NAMES, a comma-separated list
+   of event names, or "all" for every event.  Returns false if
+   NAMES contains an unknown name, without enabling anything. */
+bool
+trace_enable (const char *names)
+{
+  uint32_t mask = 0;
+
+  while (*names != '\0')
+    {
+      size_t len = strcspn (names, ",");
+      int e;
+
+      if (len == 3 && !memcmp (names, "all", 3))
+        mask = (1u << TRACE_EVENT_CNT) - 1;
+      else
+        {
+          for (e = 0; e < TRACE_EVENT_CNT; e++)
+            if (strlen (event_names[e]) == len
+                && !memcmp (names, event_names[e], len))
+              break;
+          if (e == TRACE_EVENT_CNT)
+            return false;
+          mask |= 1u << e;
+        }
+      names += len;
+      if (*names == ',')
+        names++;
+    }
+  trace_mask |= mask;
+  return true;
+}
+
+/* Records EVENT with ARG0 and ARG1.  Use trace() instead, which
+   skips events not being traced. */
+void
+trace_record (enum trace_event event, uint32_t arg0, uint32_t arg1)
+{
+  /* thread_current() would fail its assertions during a thread
+     switch. */
+  struct thread *t = running_thread ();
+  struct trace_rec *r;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  r = &ring[head++ % TRACE_SIZE];
+  r->tsc = read_tsc ();
+  r->tid = t->tid;
+  r->event = event;
+  r->arg0 = arg0;
+  r->arg1 = arg1;
+  intr_set_level (old_level);
+}
+
+/* Header of a BINLOG_TRACE frame, followed by NAMES_SIZE bytes
+   of event names, each null-terminated, in enum trace_event
+   order, and then RECORD_CNT struct trace_recs. */
+struct trace_frame
+  {
+    uint32_t record_cnt;
+    uint32_t lost_cnt;
+    uint64_t tsc_hz;
+    uint32_t names_size;
+  };
+
+/* Writes records START up to HEAD to the binary log. */
+static void
+dump_binary (uint32_t start) 
+{
+  struct trace_frame frame;
+  uint32_t first, cnt;
+  int e;
+
+  frame.record_cnt = head - start;
+  frame.lost_cnt = start;
+  frame.tsc_hz = timer_tsc_hz ();
+  frame.names_size = 0;
+  for (e = 0; e < TRACE_EVENT_CNT; e++)
+    frame.names_size += strlen (event_names[e]) + 1;
+
+  binlog_begin (BINLOG_TRACE, (sizeof frame + frame.names_size
+                               + frame.record_cnt * sizeof *ring));
+  binlog_put (&frame, sizeof frame);
+  for (e = 0; e < TRACE_EVENT_CNT; e++)
+    binlog_put (event_names[e], strlen (event_names[e]) + 1);
+
+  /* The records may wrap around the end of the ring. */
+  first = start % TRACE_SIZE;
+  cnt = frame.record_cnt < TRACE_SIZE - first ? frame.record_cnt
+                                              : TRACE_SIZE - first;
+  binlog_put (ring + first, cnt * sizeof *ring);
+  binlog_put (ring, (frame.record_cnt - cnt) * sizeof *ring);
+  printf ("trace: %"PRIu32" records, %"PRIu32" lost, sent to binary log\n",
+          frame.record_cnt, frame.lost_cnt);
+}
+
+/* Prints the recorded events, oldest first, and empties the ring.
+   Tracing is paused meanwhile, so that printing is not itself
+   traced.  Must not be called from an interrupt handler. */
+void
+trace_dump (void)
+{
+  uint32_t mask = trace_mask;
+  uint32_t i, start;
+
+  ASSERT (!intr_context ());
+
+  trace_mask = 0;
+  start = head > TRACE_SIZE ? head - TRACE_SIZE : 0;
+  if (binlog_enabled)
+    {
+      dump_binary (start);
+      head = 0;
+      trace_mask = mask;
+      return;
+    }
+  printf ("trace: begin %"PRIu32" records, %"PRIu32" lost, "
+          "%"PRIu64" tsc/s\n", head - start, start, timer_tsc_hz ());
+  for (i = start; i != head; i++)
+    {
+      const struct trace_rec *r = &ring[i % TRACE_SIZE];
+      printf ("TRACE %"PRIu64" %d %s %#"PRIx32" %#"PRIx32"\n",
+              r->tsc, r->tid, event_names[r->event], r->arg0, r->arg1);
+    }
+  printf ("trace: end\n");
+  head = 0;
+  trace_mask = mask;
+}
@@ -0,0 +1,41 @@
+#ifndef THREADS_TRACE_H
+#define THREADS_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Kernel events that may be traced. */
+enum trace_event
+  {
+    TRACE_SCHEDULE,             /* Thread switch: from, to tid. */
+    TRACE_BLOCK,                /* thread_block(): caller's address. */
+    TRACE_UNBLOCK,              /* thread_unblock(): tid unblocked. */
+    TRACE_SYSCALL_ENTER,        /* System call: number, first arg. */
+    TRACE_SYSCALL_EXIT,         /* System call return: number, eax. */
+    TRACE_DISK_READ,            /* Disk read starts: sector, count. */
+    TRACE_DISK_WRITE,           /* Disk write starts: sector, count. */
+    TRACE_DISK_DONE,            /* Disk transfer ends: sector, count. */
+    TRACE_PAGE_FAULT,           /* Page fault: address, error code. */
+    TRACE_LOCK_WAIT,            /* Lock is contended: lock, holder tid. */
+    TRACE_LOCK_ACQUIRE,         /* Lock acquired: lock, whether waited. */
+    TRACE_EXEC_PHASE,           /* Exec phase done: enum exec_phase, ns. */
+    TRACE_EVENT_CNT
+  };
+
+/* Bit (1 << E) is set if event E is being traced. */
+extern uint32_t trace_mask;
+
+bool trace_enable (const char *names);
+void trace_record (enum trace_event, uint32_t arg0, uint32_t arg1);
+void trace_dump (void);
+
+/* Records EVENT with ARG0 and ARG1, if EVENT is being traced.
+   May be called from an interrupt handler. */
+static inline void
+trace (enum trace_event event, uint32_t arg0, uint32_t arg1)
+{
+  if (trace_mask & (1u << event))
+    trace_record (event, arg0, arg1);
+}
+
+#endif /* threads/trace.h */
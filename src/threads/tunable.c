@@ -0,0 +1,144 @@
+#include "threads/tunable.h"
+#include <debug.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Maximum number of tunables, and of -o settings. */
+#define TUNABLE_MAX 16
+
+/* A registered tunable. */
+struct tunable
+  {
+    const char *name;           /* Name given to -o. */
+    int *value;                 /* The module's variable. */
+    int dflt;                   /* Value at registration. */
+    int min, max;               /* Allowed range of values. */
+  };
+
+/* A NAME=VALUE setting from the command line.  The strings point
+   into the command line, which stays put. */
+struct setting
+  {
+    const char *name;
+    const char *value;
+    bool used;                  /* Applied to a tunable? */
+  };
+
+/* Neither table needs memory allocation, so that options can be
+   parsed before the allocators are up. */
+static struct tunable tunables[TUNABLE_MAX];
+static size_t tunable_cnt;
+static struct setting settings[TUNABLE_MAX];
+static size_t setting_cnt;
+
+/* Stores setting S in tunable T, panicking if it is not a number
+   in T's range. */
+static void
+apply (const struct tunable *t, struct setting *s)
+{
+  const char *p = s->value;
+  int value;
+
+  if (*p == '-')
+    p++;
+  if (*p == '\0' || strspn (p, "0123456789") != strlen (p))
+    PANIC ("-o %s: `%s' is not a number", s->name, s->value);
+  value = atoi (s->value);
+  if (value < t->min || value > t->max)
+    PANIC ("-o %s: %d is not between %d and %d",
+           s->name, value, t->min, t->max);
+  *t->value = value;
+  s->used = true;
+}
+
+/* Registers the tunable NAME, stored in *VALUE, which already
+   holds its default, and allowed to range from MIN to MAX.  If
+   the command line set NAME, *VALUE is updated to match. */
+void
+tunable_register (const char *name, int *value, int min, int max)
+{
+  struct tunable *t;
+  size_t i;
+
+  ASSERT (min <= *value && *value <= max);
+  for (i = 0; i < tunable_cnt; i++)
+    if (!strcmp (tunables[i].name, name))
+      PANIC ("tunable %s registered twice", name);
+  if (tunable_cnt >= TUNABLE_MAX)
+    PANIC ("too many tunables");
+
+  t = &tunables[tunable_cnt++];
+  t->name = name;
+  t->value = value;
+  t->dflt = *value;
+  t->min = min;
+  t->max = max;
+  for (i = 0; i < setting_cnt; i++)
+    if (!strcmp (settings[i].name, name))
+      apply (t, &settings[i]);
+}
+
+/* Parses OPTIONS, a comma-separated list of NAME=VALUE settings,
+   given to -o.  OPTIONS is modified, and must stay put.  A
+   setting for a tunable that is already registered takes effect
+   at once; others wait for tunable_register().  Returns false if
+   OPTIONS is malformed. */
+bool
+tunable_set (char *options)
+{
+  char *setting, *save_ptr;
+
+  if (options == NULL)
+    return false;
+  for (setting = strtok_r (options, ",", &save_ptr); setting != NULL;
+       setting = strtok_r (NULL, ",", &save_ptr))
+    {
+      char *equals = strchr (setting, '=');
+      struct setting *s;
+      size_t i;
+
+      if (equals == NULL || equals == setting)
+        return false;
+      *equals = '\0';
+      if (setting_cnt >= TUNABLE_MAX)
+        PANIC ("too many -o settings");
+
+      s = &settings[setting_cnt++];
+      s->name = setting;
+      s->value = equals + 1;
+      s->used = false;
+      for (i = 0; i < tunable_cnt; i++)
+        if (!strcmp (tunables[i].name, s->name))
+          apply (&tunables[i], s);
+    }
+  return true;
+}
+
+/* Panics if the command line set a tunable that no module has
+   registered.  Called once every module is initialized. */
+void
+tunable_check (void)
+{
+  size_t i;
+
+  for (i = 0; i < setting_cnt; i++)
+    if (!settings[i].used)
+      PANIC ("-o %s: no such tunable (use -h for help)", settings[i].name);
+}
+
+/* Prints each tunable's value, marking those that differ from
+   their defaults. */
+void
+tunable_print_stats (void)
+{
+  size_t i;
+
+  if (tunable_cnt == 0)
+    return;
+  printf ("Tunables:");
+  for (i = 0; i < tunable_cnt; i++)
+    printf (" %s=%d%s", tunables[i].name, *tunables[i].value,
+            *tunables[i].value != tunables[i].dflt ? "*" : "");
+  printf ("\n");
+}
@@ -0,0 +1,22 @@
+#ifndef THREADS_TUNABLE_H
+#define THREADS_TUNABLE_H
+
+#include <stdbool.h>
+
+/* Tunables: integer kernel parameters that can be set on the
+   kernel command line with -o NAME=VALUE, so that cache sizes,
+   time slices and the like can be tried per workload without
+   recompiling.
+
+   A module registers each of its tunables, with its default
+   already stored in the variable, before it first uses the
+   value.  A value given on the command line before the module
+   registers is kept until then.  Once the kernel is up,
+   tunable_check() rejects names that no module registered. */
+
+void tunable_register (const char *name, int *value, int min, int max);
+bool tunable_set (char *options);
+void tunable_check (void);
+void tunable_print_stats (void);
+
+#endif /* threads/tunable.h */
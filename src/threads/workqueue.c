@@ -0,0 +1,229 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/spinlock.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/tunable.h"
+
+/* Work items waiting for a worker, one FIFO queue per priority.
+   Work may be queued from interrupt handlers, including timer
+   callbacks for delayed work, so the queues and the state of
+   every item are protected by a spin lock rather than by a
+   sleeping lock. */
+static struct list queues[WORK_PRI_CNT];
+static struct spinlock queue_lock;
+
+/* Upped once per item queued.  Since a canceled item leaves its
+   count behind, a worker that finds the queues empty just waits
+   again. */
+static struct semaphore queued;
+
+/* Number of worker threads, tunable as "workers".  More than
+   one by default, so that a slow or low-priority item does not
+   hold up an urgent one. */
+#define WORKER_CNT 3
+#define WORKER_MAX 16
+static int worker_cnt = WORKER_CNT;
+
+/* Thread priority at which a worker runs items of each priority. */
+static const int thread_priorities[WORK_PRI_CNT] =
+  {
+    [WORK_HIGH] = PRI_DEFAULT + 1,
+    [WORK_NORMAL] = PRI_DEFAULT,
+    [WORK_LOW] = PRI_MIN,
+  };
+
+/* Statistics. */
+static long long run_cnt[WORK_PRI_CNT];   /* Items run. */
+static long long cancel_cnt;              /* Items canceled. */
+
+static thread_func worker NO_RETURN;
+
+/* Sets up the work queues and starts the worker threads.  Must be
+   called after thread_start(). */
+void
+workqueue_init (void)
+{
+  int i;
+
+  for (i = 0; i < WORK_PRI_CNT; i++)
+    list_init (&queues[i]);
+  spin_init (&queue_lock);
+  sema_init (&queued, 0);
+  tunable_register ("workers", &worker_cnt, 1, WORKER_MAX);
+  for (i = 0; i < worker_cnt; i++)
+    thread_create_daemon ("worker", PRI_DEFAULT, worker, NULL);
+}
+
+/* Initializes W to call FUNC, which may find AUX in W->aux. */
+void
+work_init (struct work *w, work_func *func, void *aux)
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->priority = WORK_NORMAL;
+  w->state = WORK_IDLE;
+  w->timer.pending = false;
+}
+
+/* Puts idle item W at the end of the queue for PRIORITY.
+   QUEUE_LOCK must be held. */
+static void
+enqueue (struct work *w, enum work_priority priority)
+{
+  ASSERT (spin_is_locked (&queue_lock));
+  ASSERT (priority < WORK_PRI_CNT);
+
+  w->priority = priority;
+  w->state = WORK_QUEUED;
+  list_push_back (&queues[priority], &w->elem);
+  sema_up (&queued);
+}
+
+/* Queues W to be run by a worker at PRIORITY.  Returns true if
+   successful, false if W was already pending.  May be called
+   from an interrupt handler. */
+bool
+work_queue (struct work *w, enum work_priority priority)
+{
+  enum intr_level old_level = spin_lock_irqsave (&queue_lock);
+  bool idle = w->state == WORK_IDLE;
+
+  if (idle)
+    enqueue (w, priority);
+  spin_unlock_irqrestore (&queue_lock, old_level);
+  return idle;
+}
+
+/* Timer callback for work_queue_delayed(). */
+static void
+delay_expired (void *w_)
+{
+  struct work *w = w_;
+  enum intr_level old_level = spin_lock_irqsave (&queue_lock);
+
+  if (w->state == WORK_DELAYED)
+    enqueue (w, w->priority);
+  spin_unlock_irqrestore (&queue_lock, old_level);
+}
+
+/* Queues W to be run by a worker at PRIORITY once TICKS timer
+   ticks have passed.  Returns true if successful, false if W was
+   already pending.  May be called from an interrupt handler. */
+bool
+work_queue_delayed (struct work *w, enum work_priority priority,
+                    int64_t ticks)
+{
+  enum intr_level old_level;
+  bool idle;
+
+  if (ticks <= 0)
+    return work_queue (w, priority);
+
+  old_level = spin_lock_irqsave (&queue_lock);
+  idle = w->state == WORK_IDLE;
+  if (idle)
+    {
+      w->priority = priority;
+      w->state = WORK_DELAYED;
+      timer_add (&w->timer, ticks, delay_expired, w);
+    }
+  spin_unlock_irqrestore (&queue_lock, old_level);
+  return idle;
+}
+
+/* Cancels W.  Returns true if W was pending and will now not
+   run, false if it was not pending.  W's function may still be
+   running when this returns, so an item must not be freed just
+   because it was canceled unless it is known not to be running. */
+bool
+work_cancel (struct work *w)
+{
+  enum intr_level old_level = spin_lock_irqsave (&queue_lock);
+  bool pending = w->state != WORK_IDLE;
+
+  if (w->state == WORK_DELAYED)
+    timer_cancel (&w->timer);
+  else if (w->state == WORK_QUEUED)
+    list_remove (&w->elem);
+  if (pending)
+    cancel_cnt++;
+  w->state = WORK_IDLE;
+  spin_unlock_irqrestore (&queue_lock, old_level);
+  return pending;
+}
+
+/* Returns true if W is waiting for a delay or a worker. */
+bool
+work_pending (const struct work *w)
+{
+  return w->state != WORK_IDLE;
+}
+
+/* Removes and returns the most urgent queued item, or a null
+   pointer if there is none.  QUEUE_LOCK must be held. */
+static struct work *
+dequeue (void)
+{
+  int i;
+
+  ASSERT (spin_is_locked (&queue_lock));
+
+  for (i = 0; i < WORK_PRI_CNT; i++)
+    if (!list_empty (&queues[i]))
+      {
+        struct work *w = list_entry (list_pop_front (&queues[i]),
+                                     struct work, elem);
+        w->state = WORK_IDLE;
+        return w;
+      }
+  return NULL;
+}
+
+/* Worker thread: runs queued items for as long as the system
+   runs. */
+static void
+worker (void *aux UNUSED)
+{
+  for (;;)
+    {
+      enum intr_level old_level;
+      struct work *w;
+      work_func *func = NULL;
+      enum work_priority priority = WORK_NORMAL;
+
+      /* W belongs to its submitter again as soon as it leaves the
+         queue, so read what we need of it first. */
+      sema_down (&queued);
+      old_level = spin_lock_irqsave (&queue_lock);
+      w = dequeue ();
+      if (w != NULL)
+        {
+          func = w->func;
+          priority = w->priority;
+          run_cnt[priority]++;
+        }
+      spin_unlock_irqrestore (&queue_lock, old_level);
+
+      if (w != NULL)
+        {
+          thread_set_priority (thread_priorities[priority]);
+          func (w);
+        }
+    }
+}
+
+/* Prints work queue statistics. */
+void
+workqueue_print_stats (void)
+{
+  printf ("Work queue: %lld high, %lld normal, %lld low items run, "
+          "%lld canceled\n",
+          run_cnt[WORK_HIGH], run_cnt[WORK_NORMAL], run_cnt[WORK_LOW],
+          cancel_cnt);
+}
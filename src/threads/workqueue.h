@@ -0,0 +1,65 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "devices/timer.h"
+
+/* Deferred work.
+
+   A work item is a function to call later from one of a small
+   pool of kernel worker threads, instead of in the caller's own
+   context.  This lets interrupt handlers and system calls hand
+   off anything that may sleep or that need not delay them:
+   reading ahead, writing behind, reaping exited processes, and
+   so on.
+
+   The submitter owns the struct work, which must stay valid
+   until its function has been called or it has been canceled.
+   An item is queued at most once at a time; queuing it again
+   while it is still pending does nothing.  Once its function
+   starts, it is no longer pending, so the function may queue its
+   own item again. */
+
+/* Urgency of a work item.  Workers always take the most urgent
+   queued item first, and run it at a matching thread priority. */
+enum work_priority
+  {
+    WORK_HIGH,                  /* Someone is waiting for the result. */
+    WORK_NORMAL,                /* Ordinary deferred work. */
+    WORK_LOW,                   /* Only worth doing when idle. */
+    WORK_PRI_CNT
+  };
+
+struct work;
+typedef void work_func (struct work *);
+
+/* A work item. */
+struct work
+  {
+    struct list_elem elem;      /* Element in a work queue. */
+    struct timer timer;         /* Delay before queuing, if any. */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* For FUNC's use. */
+    enum work_priority priority; /* Queue to go on. */
+    enum
+      {
+        WORK_IDLE,              /* Not pending. */
+        WORK_DELAYED,           /* Waiting for TIMER. */
+        WORK_QUEUED             /* On a queue, waiting for a worker. */
+      }
+    state;
+  };
+
+void workqueue_init (void);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct work *, enum work_priority);
+bool work_queue_delayed (struct work *, enum work_priority, int64_t ticks);
+bool work_cancel (struct work *);
+bool work_pending (const struct work *);
+
+void workqueue_print_stats (void);
+
+#endif /* threads/workqueue.h */
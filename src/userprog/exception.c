@@ -1,15 +1,41 @@
 #include "userprog/exception.h"
+#include <div64.h>
 #include <inttypes.h>
+#include <stats.h>
 #include <stdio.h>
 #include "userprog/gdt.h"
+#include "userprog/process.h"
+#include "devices/timer.h"
+#include "threads/fpu.h"
 #include "threads/interrupt.h"
+#include "threads/kstack.h"
 #include "threads/thread.h"
+#include "threads/trace.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
 
+/* Page faults by class, with their latencies. */
+static struct fault_stats fault_stats[FAULT_CLASS_CNT];
+
+/* Names of the fault classes, for printing. */
+static const char *fault_class_names[FAULT_CLASS_CNT] =
+  {
+    [FAULT_FILE] = "file",
+    [FAULT_ZERO] = "zero",
+    [FAULT_SWAP] = "swap",
+    [FAULT_STACK] = "stack",
+    [FAULT_COW] = "cow",
+    [FAULT_INVALID] = "invalid",
+  };
+
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void count_fault (enum fault_class, int64_t start);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -45,8 +71,10 @@ exception_init (void)
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
   intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-  intr_register_int (7, 0, INTR_ON, kill,
-                     "#NM Device Not Available Exception");
+  if (!fpu_available ())
+    intr_register_int (7, 0, INTR_ON, kill,
+                       "#NM Device Not Available Exception");
+  intr_register_task (8, SEL_DFTSS, "#DF Double Fault Exception");
   intr_register_int (11, 0, INTR_ON, kill, "#NP Segment Not Present");
   intr_register_int (12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
   intr_register_int (13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -60,11 +88,75 @@ exception_init (void)
   intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
 }
 
-/* Prints exception statistics. */
+/* Prints exception statistics.  For each class of page fault
+   that occurred, prints the average latency and the histogram
+   up to its last nonempty bucket. */
 void
 exception_print_stats (void) 
 {
+  int c;
+
   printf ("Exception: %lld page faults\n", page_fault_cnt);
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    {
+      const struct fault_stats *fs = &fault_stats[c];
+      int last, i;
+
+      if (fs->cnt == 0)
+        continue;
+      for (last = FAULT_HIST_BUCKETS - 1; fs->hist[last] == 0; last--)
+        continue;
+      printf ("  %s: %lld faults, %"PRId64" us average, histogram (us):",
+              fault_class_names[c], fs->cnt, fs->ns / fs->cnt / 1000);
+      printf (" <2:%lld", fs->hist[0]);
+      for (i = 1; i <= last; i++)
+        printf (" %d:%lld", 1 << i, fs->hist[i]);
+      printf ("\n");
+    }
+}
+
+/* Fills in the exception fields of *S, including the current
+   process's page faults. */
+void
+exception_get_stats (struct stats *s) 
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+  int c;
+
+  old_level = intr_disable ();
+  s->page_fault_cnt = page_fault_cnt;
+  for (c = 0; c < FAULT_CLASS_CNT; c++)
+    {
+      s->faults[c] = fault_stats[c];
+      s->proc_faults[c].cnt = t->fault_cnt[c];
+      s->proc_faults[c].ns = t->fault_ns[c];
+    }
+  intr_set_level (old_level);
+}
+
+/* Counts a page fault of class CLASS that began at time START, in
+   nanoseconds, for the system and for the current thread. */
+static void
+count_fault (enum fault_class class, int64_t start)
+{
+  struct fault_stats *fs = &fault_stats[class];
+  struct thread *t = thread_current ();
+  int64_t ns = timer_ns () - start;
+  int64_t us = div64_32 (ns, 1000, NULL);
+  enum intr_level old_level;
+  int bucket;
+
+  for (bucket = 0; us >= 2 && bucket < FAULT_HIST_BUCKETS - 1; bucket++)
+    us >>= 1;
+
+  old_level = intr_disable ();
+  fs->cnt++;
+  fs->ns += ns;
+  fs->hist[bucket]++;
+  t->fault_cnt[class]++;
+  t->fault_ns[class] += ns;
+  intr_set_level (old_level);
 }
 
 /* Handler for an exception (probably) caused by a user process. */
@@ -89,6 +181,7 @@ kill (struct intr_frame *f)
       printf ("%s: dying due to interrupt %#04x (%s).\n",
               thread_name (), f->vec_no, intr_name (f->vec_no));
       intr_dump_frame (f);
+      process_exit (-1);
       thread_exit (); 
 
     case SEL_KCSEG:
@@ -126,6 +219,10 @@ page_fault (struct intr_frame *f)
   bool write;        /* True: access was write, false: access was read. */
   bool user;         /* True: access by user, false: access by kernel. */
   void *fault_addr;  /* Fault address. */
+  int64_t start;     /* When the fault began, in nanoseconds. */
+#ifdef VM
+  enum fault_class class;
+#endif
 
   /* Obtain faulting address, the virtual address that was
      accessed to cause the fault.  It may point to code or to
@@ -135,19 +232,68 @@ page_fault (struct intr_frame *f)
      [IA32-v3a] 5.15 "Interrupt 14--Page Fault Exception
      (#PF)". */
   asm ("movl %%cr2, %0" : "=r" (fault_addr));
+  trace (TRACE_PAGE_FAULT, (uint32_t) fault_addr, f->error_code);
 
   /* Turn interrupts back on (they were only off so that we could
      be assured of reading CR2 before it changed). */
   intr_enable ();
 
-  /* Count page faults. */
+  /* Count page faults.  Each one is also counted by class once
+     it is served, with the time that took. */
   page_fault_cnt++;
+  start = timer_ns ();
 
   /* Determine cause. */
   not_present = (f->error_code & PF_P) == 0;
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
+#ifdef VM
+  /* A not-present user page may just not have been loaded yet, or
+     be the next page of a growing stack.  In the kernel, the user
+     stack pointer is the one saved on entry to the system call. */
+  if (not_present)
+    {
+      if (page_load (fault_addr, write, &class))
+        {
+          count_fault (class, start);
+          return;
+        }
+      if (page_grow_stack (fault_addr, user ? f->esp
+                                            : thread_current ()->user_esp))
+        {
+          count_fault (FAULT_STACK, start);
+          return;
+        }
+    }
+
+  /* A write to a present page may be the first to a copy-on-write
+     page.  CR0.WP makes kernel writes fault here too. */
+  if (!not_present && write && page_unshare (fault_addr))
+    {
+      count_fault (FAULT_COW, start);
+      return;
+    }
+#endif
+  count_fault (FAULT_INVALID, start);
+
+  /* A kernel access to a user address can only come from the
+     get_user() and put_user() accessors in syscall.c, which leave
+     the address to resume at in EAX.  Resume there with EAX set to
+     -1 so the access reports failure instead of panicking. */
+  if (!user && is_user_vaddr (fault_addr))
+    {
+      f->eip = (void (*) (void)) f->eax;
+      f->eax = 0xffffffff;
+      return;
+    }
+
+  /* A kernel access just below a kernel stack means the stack
+     overflowed into its guard page. */
+  if (!user && kstack_is_guard (fault_addr))
+    PANIC ("kernel stack overflow in thread %s at eip %p",
+           thread_name (), f->eip);
+
   /* To implement virtual memory, delete the rest of the function
      body, and replace it with code that brings in the page to
      which fault_addr refers. */
@@ -1,6 +1,8 @@
 #ifndef USERPROG_EXCEPTION_H
 #define USERPROG_EXCEPTION_H
 
+struct stats;
+
 /* Page fault error code bits that describe the cause of the exception.  */
 #define PF_P 0x1    /* 0: not-present page. 1: access rights violation. */
 #define PF_W 0x2    /* 0: read, 1: write. */
@@ -8,5 +10,6 @@
 
 void exception_init (void);
 void exception_print_stats (void);
+void exception_get_stats (struct stats *);
 
 #endif /* userprog/exception.h */
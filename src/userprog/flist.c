@@ -1,126 +1,219 @@
+#include <debug.h>
 #include <stddef.h>
 #include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "flist.h"
 #define offset 2
-#define flist_debug 0
+/* Subsystem of this file's debug() messages. */
+#define DEBUG_SUBSYS LOG_FLIST
 
-void map_init(struct map* m)
+struct map* map_create(void)
 {
-#if flist_debug
-  debug("Enterd map_init\n");
-#endif
-  int i;
-  for(i = 0; i < MAP_SIZE; i++)
-    m->content[i] =NULL;
+  debug("Enterd map_create\n");
+  struct map* m = malloc(sizeof *m);
+  if(m == NULL)
+    return NULL;
+  m->content = NULL;
+  m->pages = 0;
+  m->size = 0;
+  m->hint = 0;
   lock_init(&(m->lock));
-#if flist_debug
-  debug("Exit map_init\n");
-#endif
+  return m;
+}
+
+//Frees the table itself. Files still in it are not closed, use
+//map_close_all_files first.
+void map_destroy(struct map* m)
+{
+  if(m == NULL)
+    return;
+  if(m->content != NULL)
+    palloc_free_multiple(m->content, m->pages);
+  free(m);
+}
+
+//Adds a page to the table. The slots have to stay contiguous so the
+//old ones are copied over, this only happens every MAP_PAGE_SLOTS opens.
+static bool grow(struct map* m)
+{
+  if(m->pages >= MAP_MAX_PAGES)
+    return false;
+  value_t* content = palloc_get_multiple(PAL_ZERO, m->pages + 1);
+  if(content == NULL)
+    return false;
+  if(m->content != NULL)
+    {
+      memcpy(content, m->content, m->size * sizeof *content);
+      palloc_free_multiple(m->content, m->pages);
+    }
+  m->content = content;
+  m->pages++;
+  m->size = m->pages * MAP_PAGE_SLOTS;
+  debug("map grew to %i slots\n", m->size);
+  return true;
 }
 
-key_t map_insert(struct map* m, value_t v)
+//Inserts V at the lowest free fd, creating the table on first use.
+key_t map_insert(struct map** mp, value_t v)
 {
-#if flist_debug
   debug("Enterd map_insert\n");
-#endif
-  int i = 0;
   if(v == NULL)
     {
-#if flist_debug
       debug("Exit map_insert with -1\n");
-#endif
+      return -1;
+    }
+  if(*mp == NULL && (*mp = map_create()) == NULL)
+    {
+      filesys_close(v);
+      return -1;
+    }
+
+  struct map* m = *mp;
+  lock_acquire(&(m->lock));
+  size_t i = m->hint;
+  while(i < m->size && m->content[i] != NULL)
+    i++;
+  if(i == m->size && !grow(m))
+    {
+      lock_release(&(m->lock));
+      filesys_close(v);
+      debug("Exit map_insert with -1\n");
+      return -1;
+    }
+  m->content[i] = v;
+  m->hint = i + 1;
+  lock_release(&(m->lock));
+  debug("Exit map_insert with %i\n", i + offset);
+  return i + offset;
+}
+
+//Puts V at fd K, growing the table as needed, and returns K. A file
+//already open as K is closed. Returns -1, closing V, if K is out of
+//range or memory is short.
+key_t map_insert_at(struct map** mp, key_t k, value_t v)
+{
+  if(v == NULL)
+    return -1;
+  if(k < offset || (size_t)(k - offset) >= MAP_MAX_PAGES * MAP_PAGE_SLOTS
+     || (*mp == NULL && (*mp = map_create()) == NULL))
+    {
+      filesys_close(v);
       return -1;
     }
 
-  for(i = 0; i <MAP_SIZE; i++){
-    
-    if(m->content[i] == NULL)
+  struct map* m = *mp;
+  size_t i = k - offset;
+  lock_acquire(&(m->lock));
+  while(i >= m->size)
+    if(!grow(m))
       {
-	m->content[i] = v;
-	
-#if flist_debug
-	debug("Exit map_insert with %i\n", i + offset);
-#endif
-	return i + offset;
+        lock_release(&(m->lock));
+        filesys_close(v);
+        return -1;
       }
-  }
-#if flist_debug
-  debug("Exit map_insert with -1\n");
-#endif
-  return -1;
+  value_t old = m->content[i];
+  m->content[i] = v;
+  lock_release(&(m->lock));
+  filesys_close(old);
+  return k;
+}
+
+//Returns a new table with every file of M at the same fd, shared
+//with M through file_share, in *COPY, which is null if M has no
+//files. Returns false if memory is short.
+bool map_share(struct map* m, struct map** copy)
+{
+  *copy = NULL;
+  if(m == NULL || m->size == 0)
+    return true;
+  struct map* c = map_create();
+  if(c == NULL)
+    return false;
+  while(c->size < m->size)
+    if(!grow(c))
+      {
+        map_destroy(c);
+        return false;
+      }
+  size_t i;
+  for(i = 0; i < m->size; i++)
+    if(m->content[i] != NULL)
+      c->content[i] = file_share(m->content[i]);
+  c->hint = m->hint;
+  *copy = c;
+  return true;
 }
 
 value_t map_find(struct map* m, key_t k)
 {
+  if(m == NULL || k < offset || (size_t)(k - offset) >= m->size)
+    return NULL;
   value_t ret = m->content[k - offset];
   return ret;
 }
 
 value_t map_remove(struct map* m, key_t k)
 {
+  if(map_find(m, k) == NULL)
+    return NULL;
   lock_acquire(&(m->lock));
-#if flist_debug
   debug("Enterd map_remove with k: %i , offset: %i\n", k, offset);
-#endif
-  value_t rvalue = m->content[k - offset];
-  m->content[k - offset] = NULL;
-#if flist_debug
+  size_t i = k - offset;
+  value_t rvalue = m->content[i];
+  m->content[i] = NULL;
+  if(i < m->hint)
+    m->hint = i;
   debug("Exit map_remove\n");
-#endif
   lock_release(&(m->lock));
   return rvalue;
 }
 
 void map_for_each(struct map* m, void(*exec)(key_t k, value_t v, int aux), int aux)
 {
-  int i = 0;
-  for(; i < MAP_SIZE; i++)
-    if(map_find(m,i) != NULL)
-      exec(i, map_find(m,i), aux);
+  if(m == NULL)
+    return;
+  size_t i = 0;
+  for(; i < m->size; i++)
+    if(m->content[i] != NULL)
+      exec(i + offset, m->content[i], aux);
 }
 
 void map_remove_if(struct map* m, bool (*cond)(key_t k, value_t v, int aux), int aux)
 {
-  int i = 0;
-  for(; i < MAP_SIZE; i++)
-    if(map_find(m,i) != NULL)
-      if(cond(i, map_find(m,i), aux))
-	map_remove(m,i);
+  if(m == NULL)
+    return;
+  size_t i = 0;
+  for(; i < m->size; i++)
+    if(m->content[i] != NULL)
+      if(cond(i + offset, m->content[i], aux))
+	map_remove(m, i + offset);
 }
 
 void map_close_file(struct map* m, key_t k)
 {
-#if flist_debug
   debug("Enterd map_close_files\n");
-#endif
   value_t t = map_remove(m,k);
-#if flist_debug
-  debug("map_remove returned: %i\n", t);
-#endif
+  debug("map_remove returned: %p\n", t);
   if(t != NULL)
     {
       filesys_close(t);
     }
-#if flist_debug
   debug("Exit map_close_files\n");
-#endif
 }
 
 void map_close_all_files(struct map * m)
 {
-#if flist_debug
   debug("Enterd map_close_all_files\n");
-#endif
   if(m == NULL)
     {
-#if flist_debug
       debug("Exit map_close_all_files\n");
-#endif
       return;
     }
 
-  int i;
-  for(i = 0; i< MAP_SIZE; i++)
+  size_t i;
+  for(i = 0; i < m->size; i++)
     {
       value_t t = m->content[i];
       //debug("What's inside?: %i, %i\n",t,i);
@@ -130,7 +223,5 @@ void map_close_all_files(struct map * m)
 	}
 
     }
-#if flist_debug
   debug("Exit map_close_all_files\n");
-#endif
 }
@@ -5,15 +5,24 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "threads/synch.h"
+#include "threads/vaddr.h"
 typedef struct file* value_t;
 typedef int key_t;
 //typedef int mid_t;
 
-#define MAP_SIZE 32
+//Slots per page of the table, and the most pages it may grow to
+#define MAP_PAGE_SLOTS (PGSIZE / sizeof (value_t))
+#define MAP_MAX_PAGES 8
 
+//Open file table of one process. Threads start with no table; it is
+//allocated by the first map_insert and grows a page at a time, so
+//kernel threads that never open a file only pay for a pointer.
 struct map
 {
-  value_t content[MAP_SIZE];
+  value_t* content;     //Slots, SIZE of them, from palloc
+  size_t pages;         //Pages in CONTENT
+  size_t size;          //Number of slots
+  size_t hint;          //No free slot below this index
   struct lock lock;
 };
 /*
@@ -31,9 +40,12 @@ void maps_remove_all(struct maps * m, mid_t id);
 //Extra
 void maps_delete(struct maps *m, mid_t id);
 */
-//Functions for map
-void map_init(struct map* m);
-key_t map_insert(struct map* m, value_t k);
+//Functions for map. All of them accept a NULL map, which has no files.
+struct map* map_create(void);
+void map_destroy(struct map* m);
+key_t map_insert(struct map** m, value_t k);
+key_t map_insert_at(struct map** m, key_t k, value_t v);
+bool map_share(struct map* m, struct map** copy);
 value_t map_find(struct map* m, key_t k);
 value_t map_remove(struct map*m, key_t k);
 void map_for_each(struct map*m, void(*exec)(key_t k, value_t v, int aux), int aux);
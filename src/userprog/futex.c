@@ -0,0 +1,188 @@
+#include "userprog/futex.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdint.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Futexes: wait queues keyed by the physical location of an int
+   in user memory, so that processes sharing a page also share
+   its futexes.  The kernel address that the page is mapped at
+   stands in for the physical address.  While a process waits, its
+   futex page is kept pinned, so the key stays valid. */
+
+/* Number of wait queues.  A power of 2. */
+#define FUTEX_BUCKETS 64
+
+/* A wait queue.  Waiters with different keys may share one. */
+struct futex_bucket
+  {
+    struct lock lock;           /* Protects WAITERS. */
+    struct list waiters;        /* List of struct futex_waiter. */
+  };
+
+/* A thread waiting on a futex, on the thread's kernel stack. */
+struct futex_waiter
+  {
+    struct list_elem elem;      /* Element in the bucket's WAITERS. */
+    const int *key;             /* Kernel address of the futex. */
+    struct process *process;    /* Process of the waiting thread. */
+    struct semaphore woken;     /* Upped by futex_wake(). */
+  };
+
+static struct futex_bucket buckets[FUTEX_BUCKETS];
+
+/* Initializes the futex wait queues. */
+void
+futex_init (void)
+{
+  size_t i;
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      lock_init (&buckets[i].lock);
+      list_init (&buckets[i].waiters);
+    }
+}
+
+/* Returns the wait queue for KEY. */
+static struct futex_bucket *
+bucket_for (const int *key)
+{
+  return &buckets[hash_int ((uintptr_t) key) & (FUTEX_BUCKETS - 1)];
+}
+
+/* Makes sure the int at user address UADDR is in memory and
+   writable, and keeps it there until unpin_futex().  Returns its
+   kernel address, or a null pointer if UADDR is misaligned or
+   not mapped.  With VM, the page must also be writable: making
+   it so gives the process its own copy of a copy-on-write page,
+   whose frame would otherwise be shared with processes that have
+   nothing to do with this futex. */
+static int *
+pin_futex (int *uaddr)
+{
+  if ((uintptr_t) uaddr % sizeof *uaddr != 0
+      || !is_user_vaddr (uaddr) || uaddr == NULL)
+    return NULL;
+#ifdef VM
+  if (!page_pin (uaddr, sizeof *uaddr, true))
+    return NULL;
+#endif
+  return pagedir_get_page (thread_current ()->pagedir, uaddr);
+}
+
+/* Undoes pin_futex(). */
+static void
+unpin_futex (int *uaddr UNUSED)
+{
+#ifdef VM
+  page_unpin (uaddr, sizeof *uaddr);
+#endif
+}
+
+/* If the int at user address UADDR still holds VAL, waits until
+   futex_wake() is called on it and returns 0.  Returns -1 at once
+   if it holds something else, or if UADDR is not a mapped,
+   aligned user address, or if the process is exiting.  The check
+   and the start of the wait are atomic with respect to
+   futex_wake() and futex_wake_process(). */
+int
+futex_wait (int *uaddr, int val)
+{
+  struct futex_waiter w;
+  struct futex_bucket *b;
+
+  w.key = pin_futex (uaddr);
+  if (w.key == NULL)
+    return -1;
+
+  b = bucket_for (w.key);
+  lock_acquire (&b->lock);
+  if (*w.key != val || process_exiting ())
+    {
+      lock_release (&b->lock);
+      unpin_futex (uaddr);
+      return -1;
+    }
+  w.process = thread_current ()->process;
+  sema_init (&w.woken, 0);
+  list_push_back (&b->waiters, &w.elem);
+  lock_release (&b->lock);
+
+  sema_down (&w.woken);
+  unpin_futex (uaddr);
+  return 0;
+}
+
+/* Wakes up to CNT threads waiting on the int at user address
+   UADDR, oldest first.  Returns the number woken, or -1 if UADDR
+   is not a mapped, aligned user address. */
+int
+futex_wake (int *uaddr, int cnt)
+{
+  struct futex_bucket *b;
+  struct list_elem *e;
+  const int *key;
+  int woken = 0;
+
+  key = pin_futex (uaddr);
+  if (key == NULL)
+    return -1;
+
+  b = bucket_for (key);
+  lock_acquire (&b->lock);
+  for (e = list_begin (&b->waiters);
+       e != list_end (&b->waiters) && woken < cnt; )
+    {
+      struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+      e = list_next (e);
+      if (w->key == key)
+        {
+          list_remove (&w->elem);
+          sema_up (&w->woken);
+          woken++;
+        }
+    }
+  lock_release (&b->lock);
+
+  unpin_futex (uaddr);
+  return woken;
+}
+
+/* Wakes every thread of process P that is waiting on a futex, so
+   that it can exit.  P must already be marked as exiting, which
+   keeps its threads from starting new waits. */
+void
+futex_wake_process (struct process *p)
+{
+  size_t i;
+
+  ASSERT (p->exiting);
+
+  for (i = 0; i < FUTEX_BUCKETS; i++)
+    {
+      struct futex_bucket *b = &buckets[i];
+      struct list_elem *e;
+
+      lock_acquire (&b->lock);
+      for (e = list_begin (&b->waiters); e != list_end (&b->waiters); )
+        {
+          struct futex_waiter *w = list_entry (e, struct futex_waiter, elem);
+          e = list_next (e);
+          if (w->process == p)
+            {
+              list_remove (&w->elem);
+              sema_up (&w->woken);
+            }
+        }
+      lock_release (&b->lock);
+    }
+}
@@ -0,0 +1,132 @@
+#include "userprog/heap.h"
+#include <debug.h>
+#include <round.h>
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* The user heap, grown and shrunk by sbrk().
+
+   A process's heap starts at the page after its highest
+   segment and ends at the program break.  The pages that cover
+   it are zero-filled.  With VM they are demand-zero pages in the
+   supplemental page table, so growing the heap costs nothing
+   until the pages are touched.  Without VM they are allocated
+   and mapped at once.
+
+   The heap may not grow into pages in use, such as shared memory
+   or mappings placed above it, nor, with VM, into the region the
+   stack may grow to.  The break belongs to the process, so its
+   threads move it under the process lock. */
+
+/* Sets the current process's heap to start, empty, at START,
+   rounded up to a page boundary. */
+void
+heap_init (void *start)
+{
+  struct process *p = thread_current ()->process;
+
+  p->heap_start = p->heap_brk = (uint8_t *) ROUND_UP ((uintptr_t) start,
+                                                        PGSIZE);
+}
+
+/* Returns the highest address the heap may extend to. */
+static uint8_t *
+heap_limit (void)
+{
+#ifdef VM
+  return (uint8_t *) PHYS_BASE - stack_page_limit * PGSIZE;
+#else
+  return (uint8_t *) PHYS_BASE - PGSIZE;
+#endif
+}
+
+/* Adds a zeroed page at UPAGE to the current process, if UPAGE is
+   free.  Returns true if successful. */
+static bool
+add_page (void *upage)
+{
+#ifdef VM
+  return !page_present (upage) && page_add_file (upage, NULL, 0, 0, true);
+#else
+  uint32_t *pd = thread_current ()->pagedir;
+  uint8_t *kpage;
+
+  if (pagedir_get_page (pd, upage) != NULL)
+    return false;
+  kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (kpage == NULL)
+    return false;
+  if (!pagedir_set_page (pd, upage, kpage, true))
+    {
+      palloc_free_page (kpage);
+      return false;
+    }
+  return true;
+#endif
+}
+
+/* Removes the page at UPAGE, added by add_page(), from the
+   current process and frees it. */
+static void
+remove_page (void *upage)
+{
+#ifdef VM
+  page_remove (upage);
+#else
+  uint32_t *pd = thread_current ()->pagedir;
+  void *kpage = pagedir_get_page (pd, upage);
+
+  ASSERT (kpage != NULL);
+  pagedir_clear_page (pd, upage);
+  palloc_free_page (kpage);
+#endif
+}
+
+/* Moves the current process's program break by INCREMENT bytes,
+   adding zeroed pages to cover the heap as it grows and freeing
+   them as it shrinks.  Returns the old break, or (void *) -1,
+   leaving the break as it was, if the break would fall below
+   the start of the heap or above the limit, if a page it needs
+   is in use, or if memory is short. */
+void *
+heap_sbrk (intptr_t increment)
+{
+  struct process *p = thread_current ()->process;
+  uint8_t *old_brk, *new_brk;
+  uint8_t *old_end, *new_end, *upage;
+
+  lock_acquire (&p->lock);
+  old_brk = p->heap_brk;
+  new_brk = old_brk + increment;
+  if (p->heap_start == NULL
+      || (increment < 0
+          ? new_brk < p->heap_start || new_brk > old_brk
+          : new_brk > heap_limit () || new_brk < old_brk))
+    {
+      lock_release (&p->lock);
+      return (void *) -1;
+    }
+
+  old_end = (uint8_t *) ROUND_UP ((uintptr_t) old_brk, PGSIZE);
+  new_end = (uint8_t *) ROUND_UP ((uintptr_t) new_brk, PGSIZE);
+  for (upage = old_end; upage < new_end; upage += PGSIZE)
+    if (!add_page (upage))
+      {
+        while (upage > old_end)
+          remove_page (upage -= PGSIZE);
+        lock_release (&p->lock);
+        return (void *) -1;
+      }
+  for (upage = new_end; upage < old_end; upage += PGSIZE)
+    remove_page (upage);
+
+  p->heap_brk = new_brk;
+  lock_release (&p->lock);
+  return old_brk;
+}
@@ -0,0 +1,78 @@
+#include "userprog/kinfo.h"
+#include <debug.h>
+#include <kinfo.h>
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/thread.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Kernel information pages, as described in lib/kinfo.h.  Like
+   shared memory, they are mapped straight into page directories,
+   outside any supplemental page table, so they are never evicted.
+   The shared page lives as long as the kernel, so it is unmapped
+   again before a page directory is destroyed, which would free
+   it.  The per-process page is freed along with the page
+   directory. */
+
+/* The shared page. */
+static struct kinfo *kinfo;
+
+/* Allocates the shared page and has the timer keep it up to
+   date. */
+void
+kinfo_init (void)
+{
+  kinfo = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  timer_share (kinfo);
+}
+
+/* Returns true if user page UPAGE is in use in the current
+   process. */
+static bool
+page_in_use (const void *upage)
+{
+#ifdef VM
+  return page_present (upage);
+#else
+  return pagedir_get_page (thread_current ()->pagedir, upage) != NULL;
+#endif
+}
+
+/* Maps the shared page and a new per-process page, read-only,
+   into the current process.  Returns false, with neither mapped,
+   if their addresses are in use or memory is short. */
+bool
+kinfo_map (void)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct kinfo_proc *proc;
+  void *kpages[2];
+
+  if (page_in_use (KINFO_ADDR) || page_in_use (KINFO_PROC_ADDR))
+    return false;
+  proc = palloc_get_page (PAL_USER | PAL_ZERO);
+  if (proc == NULL)
+    return false;
+  proc->pid = process_pid ();
+
+  kpages[0] = kinfo;
+  kpages[1] = proc;
+  if (!pagedir_map_range (pd, (void *) KINFO_ADDR, kpages, 2, false))
+    {
+      palloc_free_page (proc);
+      return false;
+    }
+  return true;
+}
+
+/* Unmaps the shared page from the current process, so that
+   destroying its page directory does not free it. */
+void
+kinfo_unmap (void)
+{
+  pagedir_clear_page (thread_current ()->pagedir, (void *) KINFO_ADDR);
+}
@@ -0,0 +1,10 @@
+#ifndef USERPROG_KINFO_H
+#define USERPROG_KINFO_H
+
+#include <stdbool.h>
+
+void kinfo_init (void);
+bool kinfo_map (void);
+void kinfo_unmap (void);
+
+#endif /* userprog/kinfo.h */
@@ -4,13 +4,22 @@
 #include <string.h>    /* memcmp */
 
 #include "userprog/process.h"
+#include "userprog/heap.h"
+#include "userprog/kinfo.h"
 #include "userprog/load.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h" /* PAL_* constants */
 #include "threads/thread.h"
 #include "threads/vaddr.h"  /* PGSIZE */
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 /* We load ELF binaries.  The following definitions are taken
    from the ELF specification, [ELF1], more-or-less verbatim.  */
@@ -75,7 +84,40 @@ struct Elf32_Phdr
 #define PF_W 2          /* Writable. */
 #define PF_R 4          /* Readable. */
 
+/* A loadable segment, as computed from its program header. */
+struct segment
+  {
+    off_t ofs;                  /* Page-aligned offset in the file. */
+    uint8_t *upage;             /* Page-aligned user address. */
+    uint32_t read_bytes;        /* Bytes to read from the file. */
+    uint32_t zero_bytes;        /* Bytes to zero following them. */
+    bool writable;              /* Writable by the process? */
+  };
+
+/* Most segments recorded in an exec_plan.  An executable with
+   more loadable segments is still loaded, just never from a
+   cached plan. */
+#define PLAN_SEGMENT_MAX 8
+
+/* What load() found in an executable's ELF headers, once they
+   were read and validated: the entry point and the loadable
+   segments.  The plan is cached with the executable's inode, so
+   that loading the same unchanged executable again skips the
+   header reads and checks. */
+struct exec_plan
+  {
+    unsigned write_cnt;         /* inode_write_cnt() before reading. */
+    void (*entry) (void);       /* Entry point. */
+    uint8_t *end;               /* End of the highest segment. */
+    int segment_cnt;            /* Segments, or -1 if too many. */
+    struct segment segments[PLAN_SEGMENT_MAX];
+  };
+
 static bool setup_stack (void **esp);
+static bool plan_lookup (struct inode *, struct exec_plan *);
+static void plan_store (struct inode *, const struct exec_plan *);
+static bool read_headers (struct file *, const char *file_name,
+                          struct exec_plan *);
 static bool validate_segment (const struct Elf32_Phdr *, struct file *);
 static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
                           uint32_t read_bytes, uint32_t zero_bytes,
@@ -84,27 +126,42 @@ static bool load_segment (struct file *file, off_t ofs, uint8_t *upage,
 /* Loads an ELF executable from FILE_NAME into the current thread.
    Stores the executable's entry point into *EIP
    and its initial stack pointer into *ESP.
+   Charges the time of each phase, starting from *SINCE, to the
+   exec statistics with process_exec_phase().
    Returns true if successful, false otherwise. */
 bool
-load (const char *file_name, void (**eip) (void), void **esp) 
+load (const char *file_name, void (**eip) (void), void **esp,
+      int64_t *since) 
 {
   struct thread *t = thread_current ();
-  struct Elf32_Ehdr ehdr;
+  struct exec_plan plan;
   struct file *file = NULL;
-  off_t file_ofs;
   bool success = false;
   int i;
 
   /* Allocate and activate page directory. */
-  t->pagedir = pagedir_create ();
+  t->process->pagedir = t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+#ifdef VM
+  if (!page_table_init ())
+    {
+      /* process_cleanup() destroys the page table along with the
+         page directory, so it must exist whenever PAGEDIR does. */
+      pagedir_activate (NULL);
+      pagedir_destroy (t->pagedir);
+      t->process->pagedir = t->pagedir = NULL;
+      goto done;
+    }
+  mmap_init ();
+#endif
 
   /* Set up stack. */
   if (!setup_stack (esp)){
     goto done;
   }
+  process_exec_phase (EXEC_SETUP, since);
 
   /* Open executable file. */
   file = filesys_open (file_name);
@@ -113,6 +170,134 @@ load (const char *file_name, void (**eip) (void), void **esp)
       printf ("load: %s: open failed\n", file_name);
       goto done; 
     }
+  process_exec_phase (EXEC_OPEN, since);
+
+  /* Load the segments, from the cached plan if there is one. */
+  if (plan_lookup (file_get_inode (file), &plan))
+    {
+      for (i = 0; i < plan.segment_cnt; i++)
+        {
+          const struct segment *seg = &plan.segments[i];
+          if (!load_segment (file, seg->ofs, seg->upage, seg->read_bytes,
+                             seg->zero_bytes, seg->writable))
+            goto done;
+        }
+    }
+  else if (read_headers (file, file_name, &plan))
+    plan_store (file_get_inode (file), &plan);
+  else
+    goto done;
+
+#ifdef VM
+  /* Whatever of the executable is still in memory from processes
+     that ran it, or still run it, is mapped now instead of on
+     first touch. */
+  for (i = 0; i < plan.segment_cnt; i++)
+    {
+      const struct segment *seg = &plan.segments[i];
+      page_map_shared (seg->upage,
+                       (seg->read_bytes + seg->zero_bytes) / PGSIZE);
+    }
+#endif
+
+  /* The kernel information pages go in last, so that a segment
+     in their way makes the load fail instead of covering them. */
+  if (!kinfo_map ())
+    goto done;
+
+  /* Start address, and the heap just past the segments. */
+  *eip = plan.entry;
+  heap_init (plan.end);
+  process_exec_phase (EXEC_SEGMENTS, since);
+
+  success = true;
+
+ done:
+  /* We arrive here whether the load is successful or not. */
+  /* Keep the executable open, and unwritable, for as long as the
+     process lives: with VM its segments are read in on demand, and
+     in any case a running program must not change under it.
+     process_cleanup() closes it. */
+  if (success)
+    {
+      file_deny_write (file);
+      t->process->exec_file = file;
+    }
+  else
+    file_close (file);
+  return success;
+}
+
+/* load() helpers. */
+
+#ifndef VM
+/* Pages load_segment() reads before mapping them together. */
+#define LOAD_BATCH 32
+
+static void free_pages (void **kpages, size_t cnt);
+#endif
+
+/* Copies the plan cached for INODE into *PLAN and returns true,
+   or returns false if there is none or INODE has been written
+   since it was made.  Interrupts stand in for a lock here, since
+   only a short copy is ever done under them. */
+static bool
+plan_lookup (struct inode *inode, struct exec_plan *plan)
+{
+  enum intr_level old_level = intr_disable ();
+  struct exec_plan *cached = inode_get_exec_plan (inode);
+  bool found = (cached != NULL
+                && cached->write_cnt == inode_write_cnt (inode));
+  if (found)
+    *plan = *cached;
+  intr_set_level (old_level);
+  return found;
+}
+
+/* Caches a copy of PLAN with INODE, replacing any earlier plan,
+   unless PLAN is incomplete or INODE has been written since PLAN
+   was made.  Failing to allocate the copy is harmless: the next
+   load just reads the headers again. */
+static void
+plan_store (struct inode *inode, const struct exec_plan *plan)
+{
+  struct exec_plan *copy, *old = NULL;
+  enum intr_level old_level;
+
+  if (plan->segment_cnt < 0)
+    return;
+  copy = malloc (sizeof *copy);
+  if (copy == NULL)
+    return;
+  *copy = *plan;
+
+  old_level = intr_disable ();
+  if (plan->write_cnt == inode_write_cnt (inode))
+    {
+      old = inode_get_exec_plan (inode);
+      inode_set_exec_plan (inode, copy);
+      copy = NULL;
+    }
+  intr_set_level (old_level);
+  free (old);
+  free (copy);
+}
+
+/* Reads and verifies the ELF headers of FILE, the executable
+   named FILE_NAME, loading each segment as it is found.  Records
+   the entry point and the segments in PLAN.  Returns true if
+   successful, false otherwise. */
+static bool
+read_headers (struct file *file, const char *file_name,
+              struct exec_plan *plan)
+{
+  struct Elf32_Ehdr ehdr;
+  off_t file_ofs;
+  int i;
+
+  plan->write_cnt = inode_write_cnt (file_get_inode (file));
+  plan->end = NULL;
+  plan->segment_cnt = 0;
 
   /* Read and verify executable header. */
   if (file_read (file, &ehdr, sizeof ehdr) != sizeof ehdr
@@ -124,7 +309,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
       || ehdr.e_phnum > 1024) 
     {
       printf ("load: %s: error loading executable\n", file_name);
-      goto done; 
+      return false; 
     }
 
   /* Read program headers. */
@@ -134,11 +319,11 @@ load (const char *file_name, void (**eip) (void), void **esp)
       struct Elf32_Phdr phdr;
 
       if (file_ofs < 0 || file_ofs > file_length (file))
-        goto done;
+        return false;
       file_seek (file, file_ofs);
 
       if (file_read (file, &phdr, sizeof phdr) != sizeof phdr)
-        goto done;
+        return false;
       file_ofs += sizeof phdr;
       switch (phdr.p_type) 
         {
@@ -152,54 +337,53 @@ load (const char *file_name, void (**eip) (void), void **esp)
         case PT_DYNAMIC:
         case PT_INTERP:
         case PT_SHLIB:
-          goto done;
+          return false;
         case PT_LOAD:
           if (validate_segment (&phdr, file)) 
             {
-              bool writable = (phdr.p_flags & PF_W) != 0;
-              uint32_t file_page = phdr.p_offset & ~PGMASK;
-              uint32_t mem_page = phdr.p_vaddr & ~PGMASK;
+              struct segment seg;
               uint32_t page_offset = phdr.p_vaddr & PGMASK;
-              uint32_t read_bytes, zero_bytes;
+
+              seg.ofs = phdr.p_offset & ~PGMASK;
+              seg.upage = (uint8_t *) (phdr.p_vaddr & ~PGMASK);
+              seg.writable = (phdr.p_flags & PF_W) != 0;
               if (phdr.p_filesz > 0)
                 {
                   /* Normal segment.
                      Read initial part from disk and zero the rest. */
-                  read_bytes = page_offset + phdr.p_filesz;
-                  zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz, PGSIZE)
-                                - read_bytes);
+                  seg.read_bytes = page_offset + phdr.p_filesz;
+                  seg.zero_bytes = (ROUND_UP (page_offset + phdr.p_memsz,
+                                              PGSIZE)
+                                    - seg.read_bytes);
                 }
               else 
                 {
                   /* Entirely zero.
                      Don't read anything from disk. */
-                  read_bytes = 0;
-                  zero_bytes = ROUND_UP (page_offset + phdr.p_memsz, PGSIZE);
+                  seg.read_bytes = 0;
+                  seg.zero_bytes = ROUND_UP (page_offset + phdr.p_memsz,
+                                             PGSIZE);
                 }
-              if (!load_segment (file, file_page, (void *) mem_page,
-                                 read_bytes, zero_bytes, writable))
-                goto done;
+              if (!load_segment (file, seg.ofs, seg.upage, seg.read_bytes,
+                                 seg.zero_bytes, seg.writable))
+                return false;
+
+              if (seg.upage + seg.read_bytes + seg.zero_bytes > plan->end)
+                plan->end = seg.upage + seg.read_bytes + seg.zero_bytes;
+              if (plan->segment_cnt == PLAN_SEGMENT_MAX)
+                plan->segment_cnt = -1;
+              else if (plan->segment_cnt >= 0)
+                plan->segments[plan->segment_cnt++] = seg;
             }
           else
-            goto done;
+            return false;
           break;
         }
     }
 
-  /* Start address. */
-  *eip = (void (*) (void)) ehdr.e_entry;
-
-  success = true;
-
- done:
-  /* We arrive here whether the load is successful or not. */
-  file_close (file);
-  return success;
+  plan->entry = (void (*) (void)) ehdr.e_entry;
+  return true;
 }
-
-/* load() helpers. */
-
-static bool install_page (void *upage, void *kpage, bool writable);
 
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
@@ -259,7 +443,11 @@ validate_segment (const struct Elf32_Phdr *phdr, struct file *file)
    user process if WRITABLE is true, read-only otherwise.
 
    Return true if successful, false if a memory allocation error
-   or disk read error occurs. */
+   or disk read error occurs.
+
+   With VM, the pages are only recorded in the supplemental page
+   table here, and each is read in by page_fault() when it is
+   first touched. */
 static bool
 load_segment (struct file *file, off_t ofs, uint8_t *upage,
               uint32_t read_bytes, uint32_t zero_bytes, bool writable) 
@@ -268,41 +456,68 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
+#ifdef VM
   while (read_bytes > 0 || zero_bytes > 0) 
     {
-      /* Calculate how to fill this page.
-         We will read PAGE_READ_BYTES bytes from FILE
-         and zero the final PAGE_ZERO_BYTES bytes. */
       size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
       size_t page_zero_bytes = PGSIZE - page_read_bytes;
 
-      /* Get a page of memory. */
-      uint8_t *kpage = palloc_get_page (PAL_USER);
-      if (kpage == NULL)
+      if (!page_add_file (upage, file, ofs, page_read_bytes, writable))
         return false;
 
-      /* Load this page. */
-      if (file_read (file, kpage, page_read_bytes) != (int) page_read_bytes)
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+    }
+  return true;
+#else
+
+  file_seek (file, ofs);
+  while (read_bytes > 0 || zero_bytes > 0) 
+    {
+      /* Fill up to LOAD_BATCH pages, then map them all with one
+         walk of the page directory. */
+      void *kpages[LOAD_BATCH];
+      size_t cnt;
+
+      for (cnt = 0; cnt < LOAD_BATCH && (read_bytes > 0 || zero_bytes > 0);
+           cnt++)
         {
-          palloc_free_page (kpage);
-          return false; 
+          /* Calculate how to fill this page.
+             We will read PAGE_READ_BYTES bytes from FILE
+             and zero the final PAGE_ZERO_BYTES bytes. */
+          size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+          size_t page_zero_bytes = PGSIZE - page_read_bytes;
+
+          /* Get a page of memory and load it. */
+          uint8_t *kpage = palloc_get_page (PAL_USER);
+          if (kpage == NULL
+              || (file_read (file, kpage, page_read_bytes)
+                  != (int) page_read_bytes))
+            {
+              palloc_free_page (kpage);
+              free_pages (kpages, cnt);
+              return false;
+            }
+          memset (kpage + page_read_bytes, 0, page_zero_bytes);
+          kpages[cnt] = kpage;
+
+          read_bytes -= page_read_bytes;
+          zero_bytes -= page_zero_bytes;
         }
-      memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
-      /* Add the page to the process's address space. */
-      if (!install_page (upage, kpage, writable)) 
+      /* Add the pages to the process's address space. */
+      if (!pagedir_map_range (thread_current ()->pagedir, upage, kpages, cnt,
+                              writable))
         {
-          palloc_free_page (kpage);
-          return false; 
+          free_pages (kpages, cnt);
+          return false;
         }
-
-      /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      upage += PGSIZE;
+      upage += cnt * PGSIZE;
     }
   return true;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -310,40 +525,40 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
 static bool
 setup_stack (void **esp) 
 {
-  uint8_t *kpage;
+#ifdef VM
+  /* A zero page, like any other, filled in when first touched. */
+  if (!page_add_file (((uint8_t *) PHYS_BASE) - PGSIZE, NULL, 0, 0, true))
+    return false;
+  *esp = PHYS_BASE;
+  return true;
+#else
+  void *kpage;
   bool success = false;
 
   kpage = palloc_get_page (PAL_USER | PAL_ZERO);
   if (kpage != NULL) 
     {
-      success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, kpage, true);
+      success = pagedir_map_range (thread_current ()->pagedir,
+                                   ((uint8_t *) PHYS_BASE) - PGSIZE,
+                                   &kpage, 1, true);
       if (success)
         *esp = PHYS_BASE;
       else
         palloc_free_page (kpage);
     }
   return success;
+#endif
 }
 
-/* Adds a mapping from user virtual address UPAGE to kernel
-   virtual address KPAGE to the page table.
-   If WRITABLE is true, the user process may modify the page;
-   otherwise, it is read-only.
-   UPAGE must not already be mapped.
-   KPAGE should probably be a page obtained from the user pool
-   with palloc_get_page().
-   Returns true on success, false if UPAGE is already mapped or
-   if memory allocation fails. */
-static bool
-install_page (void *upage, void *kpage, bool writable)
+#ifndef VM
+/* Frees the CNT pages in KPAGES. */
+static void
+free_pages (void **kpages, size_t cnt)
 {
-  struct thread *t = thread_current ();
-
-  /* Verify that there's not already a page at that virtual
-     address, then map our page there. */
-  return (pagedir_get_page (t->pagedir, upage) == NULL
-          && pagedir_set_page (t->pagedir, upage, kpage, writable));
+  while (cnt-- > 0)
+    palloc_free_page (kpages[cnt]);
 }
+#endif
 
 /* A function that dumps 'size' bytes of memory starting at 'ptr'
  * it will dump the higher adress first letting the stack grow down.
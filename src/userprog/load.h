@@ -1,7 +1,11 @@
 #ifndef USERPROG_LOAD_H
 #define USERPROG_LOAD_H
 
-bool load (const char *file_name, void (**eip) (void), void **esp);
+#include <stdbool.h>
+#include <stdint.h>
+
+bool load (const char *file_name, void (**eip) (void), void **esp,
+           int64_t *since);
 void dump_stack(void* ptr, int size);
 
 #endif /* userprog/load.h */
@@ -1,13 +1,54 @@
 #include "userprog/pagedir.h"
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/loader.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+
+/* Number of page directory entries for user virtual memory. */
+#define PD_USER_CNT (LOADER_PHYS_BASE >> PDSHIFT)
+
+/* Bookkeeping for a page directory, kept in the page just after
+   it, so that pagedir_destroy() visits only the page tables the
+   process used and scans only those that still map pages.  With
+   VM, the supplemental page table has already unmapped and freed
+   every frame by then, so only the page tables are left.  PDEs
+   that map 4 MB pages, from pagedir_set_large(), are not listed:
+   their owner unmaps them before PD is destroyed. */
+struct pd_info
+  {
+    uint16_t pt_cnt;                    /* Number of page tables. */
+    uint16_t pts[PD_USER_CNT];          /* PDE index of each one. */
+    uint16_t present_cnt[PD_USER_CNT];  /* Present PTEs, by PDE index. */
+    uint32_t resident;                  /* Pages mapped, counting each 4 MB
+                                           page as PTSPAN / PGSIZE. */
+    uint32_t max_resident;              /* Most RESIDENT has been. */
+  };
+
+/* 4 MB pages mapped by pagedir_set_large(). */
+static long long large_cnt;
+
+/* Pages pagedir_destroy() frees at a time. */
+#define FREE_BATCH 32
+
+/* Most pages pagedir_clear_range() invalidates one by one.  Past
+   this, reloading CR3 costs less than the invlpgs, since the
+   kernel's global mappings survive it anyway. */
+#define INVLPG_MAX 32
+
+/* Returns the bookkeeping for page directory PD. */
+static struct pd_info *
+pd_info (uint32_t *pd)
+{
+  return (struct pd_info *) ((uint8_t *) pd + PGSIZE);
+}
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -16,35 +57,86 @@ static void invalidate_pagedir (uint32_t *);
 uint32_t *
 pagedir_create (void) 
 {
-  uint32_t *pd = palloc_get_page (0);
+  uint32_t *pd;
+
+  ASSERT (sizeof (struct pd_info) <= PGSIZE);
+
+  pd = palloc_get_multiple (0, 2);
   if (pd != NULL)
-    memcpy (pd, base_page_dir, PGSIZE);
+    {
+      memcpy (pd, base_page_dir, PGSIZE);
+      pd_info (pd)->pt_cnt = 0;
+      pd_info (pd)->resident = pd_info (pd)->max_resident = 0;
+    }
   return pd;
 }
 
+/* Adds CNT, which may be negative, to the number of pages PD
+   maps, keeping track of the most it has mapped at once. */
+static void
+count_resident (uint32_t *pd, int cnt)
+{
+  struct pd_info *info = pd_info (pd);
+
+  info->resident += cnt;
+  if (info->resident > info->max_resident)
+    info->max_resident = info->resident;
+}
+
+/* Returns the most pages PD has had mapped at once.  Pages shared
+   with other processes, such as copy-on-write and shared memory
+   pages, count in each. */
+size_t
+pagedir_max_resident (uint32_t *pd)
+{
+  return pd_info (pd)->max_resident;
+}
+
+/* Adds PAGE to the CNT pages in BATCH, freeing them all first if
+   the batch is full. */
+static void
+free_batched (void **batch, size_t *cnt, void *page)
+{
+  if (*cnt == FREE_BATCH)
+    {
+      palloc_free_pages (batch, *cnt);
+      *cnt = 0;
+    }
+  batch[(*cnt)++] = page;
+}
+
 /* Destroys page directory PD, freeing all the pages it
    references. */
 void
 pagedir_destroy (uint32_t *pd) 
 {
-  uint32_t *pde;
+  struct pd_info *info;
+  void *batch[FREE_BATCH];
+  size_t batch_cnt = 0;
+  size_t i;
 
   if (pd == NULL)
     return;
 
   ASSERT (pd != base_page_dir);
-  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
-    if (*pde & PTE_P) 
-      {
-        uint32_t *pt = pde_get_pt (*pde);
-        uint32_t *pte;
-        
-        for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
-          if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
-        palloc_free_page (pt);
-      }
-  palloc_free_page (pd);
+  info = pd_info (pd);
+  for (i = 0; i < info->pt_cnt; i++)
+    {
+      size_t pde_idx = info->pts[i];
+      uint32_t *pt = pde_get_pt (pd[pde_idx]);
+      size_t left = info->present_cnt[pde_idx];
+      uint32_t *pte;
+
+      for (pte = pt; left > 0 && pte < pt + PGSIZE / sizeof *pte; pte++)
+        if (*pte & PTE_P)
+          {
+            free_batched (batch, &batch_cnt, pte_get_page (*pte));
+            left--;
+          }
+      free_batched (batch, &batch_cnt, pt);
+    }
+  palloc_free_pages (batch, batch_cnt);
+  palloc_free_multiple (pd, 2);
 }
 
 /* Returns the address of the page table entry for virtual
@@ -52,7 +144,8 @@ pagedir_destroy (uint32_t *pd)
    If PD does not have a page table for VADDR, behavior depends
    on CREATE.  If CREATE is true, then a new page table is
    created and a pointer into it is returned.  Otherwise, a null
-   pointer is returned. */
+   pointer is returned.  A null pointer is also returned if VADDR
+   lies in a 4 MB page, which has no page table entries. */
 static uint32_t *
 lookup_page (uint32_t *pd, const void *vaddr, bool create)
 {
@@ -70,15 +163,21 @@ lookup_page (uint32_t *pd, const void *vaddr, bool create)
     {
       if (create)
         {
+          struct pd_info *info = pd_info (pd);
+
           pt = palloc_get_page (PAL_ZERO);
           if (pt == NULL) 
             return NULL; 
       
           *pde = pde_create (pt);
+          info->pts[info->pt_cnt++] = pde - pd;
+          info->present_cnt[pde - pd] = 0;
         }
       else
         return NULL;
     }
+  else if (*pde & PTE_PS)
+    return NULL;
 
   /* Return the page table entry. */
   pt = pde_get_pt (*pde);
@@ -112,12 +211,150 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
     {
       ASSERT ((*pte & PTE_P) == 0);
       *pte = pte_create_user (kpage, writable);
+      pd_info (pd)->present_cnt[pd_no (upage)]++;
+      count_resident (pd, 1);
       return true;
     }
   else
     return false;
 }
 
+/* Returns how many of the CNT pages starting at UPAGE lie in the
+   same page table as UPAGE. */
+static size_t
+pt_run (const uint8_t *upage, size_t cnt)
+{
+  size_t left = (1 << PTBITS) - pt_no (upage);
+  return cnt < left ? cnt : left;
+}
+
+/* Maps the CNT consecutive user virtual pages starting at UPAGE
+   to the frames identified by kernel virtual addresses
+   KPAGES[0] through KPAGES[CNT - 1], as CNT calls to
+   pagedir_set_page() would, but looking up each page table only
+   once rather than once per page.
+   Returns true if successful.  Returns false, with none of the
+   pages mapped, if any of them is already mapped or if memory
+   allocation failed; page tables created along the way are kept
+   until PD is destroyed. */
+bool
+pagedir_map_range (uint32_t *pd, void *upage_, void **kpages, size_t cnt,
+                   bool writable)
+{
+  uint8_t *upage = upage_;
+  size_t i, j, run;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (cnt == 0 || is_user_vaddr (upage + (cnt - 1) * PGSIZE));
+  ASSERT (upage + cnt * PGSIZE >= upage);
+  ASSERT (pd != base_page_dir);
+
+  /* Create any missing page tables and check that nothing in
+     the range is mapped yet. */
+  for (i = 0; i < cnt; i += run)
+    {
+      uint8_t *vaddr = upage + i * PGSIZE;
+      uint32_t *pte = lookup_page (pd, vaddr, true);
+
+      if (pte == NULL)
+        return false;
+      run = pt_run (vaddr, cnt - i);
+      for (j = 0; j < run; j++)
+        if (pte[j] & PTE_P)
+          return false;
+    }
+
+  /* Fill in the entries, one page table at a time. */
+  for (i = 0; i < cnt; i += run)
+    {
+      uint8_t *vaddr = upage + i * PGSIZE;
+      uint32_t *pte = lookup_page (pd, vaddr, false);
+
+      run = pt_run (vaddr, cnt - i);
+      for (j = 0; j < run; j++)
+        {
+          void *kpage = kpages[i + j];
+
+          ASSERT (pg_ofs (kpage) == 0);
+          ASSERT (vtop (kpage) >> PTSHIFT < ram_pages);
+          pte[j] = pte_create_user (kpage, writable);
+        }
+      pd_info (pd)->present_cnt[pd_no (vaddr)] += run;
+      count_resident (pd, run);
+    }
+  return true;
+}
+
+/* Maps the 4 MB of user virtual memory starting at UPAGE to the
+   4 MB page at kernel virtual address KPAGE with a single PDE, so
+   that the whole range takes one TLB entry instead of 1024.  Both
+   addresses must be 4 MB aligned, and the CPU must support
+   CR4_PSE.  If WRITABLE is true, the range is read/write;
+   otherwise it is read-only.  The caller owns the memory and must
+   unmap it with pagedir_clear_large() before PD is destroyed.
+   Returns false, mapping nothing, if the range has a page table,
+   even an empty one, or is mapped already. */
+bool
+pagedir_set_large (uint32_t *pd, void *upage, void *kpage, bool writable)
+{
+  uint32_t *pde = pd + pd_no (upage);
+
+  ASSERT (((uintptr_t) upage & (PTSPAN - 1)) == 0);
+  ASSERT ((uint8_t *) upage + (PTSPAN - 1) < (uint8_t *) PHYS_BASE);
+  ASSERT (vtop (kpage) >> PTSHIFT < ram_pages);
+  ASSERT (pd != base_page_dir);
+
+  if (*pde != 0)
+    return false;
+  *pde = pde_create_large_user (kpage, writable);
+  large_cnt++;
+  count_resident (pd, PTSPAN / PGSIZE);
+  return true;
+}
+
+/* Removes the 4 MB mapping at UPAGE that pagedir_set_large()
+   made in PD. */
+void
+pagedir_clear_large (uint32_t *pd, void *upage)
+{
+  uint32_t *pde = pd + pd_no (upage);
+
+  ASSERT (((uintptr_t) upage & (PTSPAN - 1)) == 0);
+  ASSERT ((*pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS));
+
+  *pde = 0;
+  count_resident (pd, -(PTSPAN / PGSIZE));
+  invalidate_page (pd, upage);
+}
+
+/* Adds a read-only mapping from user virtual page UPAGE to the
+   physical frame identified by kernel virtual address KPAGE, as
+   pagedir_set_page() does, and marks it copy-on-write.  A write to
+   the page then faults, user or kernel, since CR0.WP is set, and
+   the fault handler gives the page a private copy of KPAGE before
+   retrying.  KPAGE may be mapped this way in any number of page
+   directories at once.  Remapping UPAGE with pagedir_set_page()
+   clears the mark.
+   Returns true if successful, false if memory allocation
+   failed. */
+bool
+pagedir_set_page_cow (uint32_t *pd, void *upage, void *kpage)
+{
+  if (!pagedir_set_page (pd, upage, kpage, false))
+    return false;
+  *lookup_page (pd, upage, false) |= PTE_COW;
+  return true;
+}
+
+/* Returns true if virtual page VPAGE is mapped copy-on-write in
+   PD.  Returns false if PD contains no such mapping. */
+bool
+pagedir_is_cow (uint32_t *pd, const void *vpage)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  return pte != NULL && (*pte & (PTE_P | PTE_COW)) == (PTE_P | PTE_COW);
+}
+
 /* Looks up the physical address that corresponds to user virtual
    address UADDR in PD.  Returns the kernel virtual address
    corresponding to that physical address, or a null pointer if
@@ -125,10 +362,15 @@ pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool writable)
 void *
 pagedir_get_page (uint32_t *pd, const void *uaddr) 
 {
-  uint32_t *pte;
+  uint32_t pde, *pte;
 
   ASSERT (is_user_vaddr (uaddr));
-  
+
+  pde = pd[pd_no (uaddr)];
+  if ((pde & (PTE_P | PTE_PS)) == (PTE_P | PTE_PS))
+    return (uint8_t *) ptov (pde & ~(PTSPAN - 1))
+           + ((uintptr_t) uaddr & (PTSPAN - 1));
+
   pte = lookup_page (pd, uaddr, false);
   if (pte != NULL && (*pte & PTE_P) != 0)
     return pte_get_page (*pte) + pg_ofs (uaddr);
@@ -152,10 +394,53 @@ pagedir_clear_page (uint32_t *pd, void *upage)
   if (pte != NULL && (*pte & PTE_P) != 0)
     {
       *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
+      pd_info (pd)->present_cnt[pd_no (upage)]--;
+      count_resident (pd, -1);
+      invalidate_page (pd, upage);
     }
 }
 
+/* Marks the CNT user virtual pages starting at UPAGE "not
+   present" in PD, as CNT calls to pagedir_clear_page() would,
+   but looking up each page table once and flushing the TLB once
+   at the end.  The pages need not be mapped. */
+void
+pagedir_clear_range (uint32_t *pd, void *upage_, size_t cnt)
+{
+  uint8_t *upage = upage_;
+  size_t i, j, run;
+  size_t cleared = 0;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (cnt == 0 || is_user_vaddr (upage + (cnt - 1) * PGSIZE));
+
+  for (i = 0; i < cnt; i += run)
+    {
+      uint8_t *vaddr = upage + i * PGSIZE;
+      uint32_t *pte = lookup_page (pd, vaddr, false);
+
+      run = pt_run (vaddr, cnt - i);
+      if (pte == NULL)
+        continue;
+      for (j = 0; j < run; j++)
+        if (pte[j] & PTE_P)
+          {
+            pte[j] &= ~PTE_P;
+            pd_info (pd)->present_cnt[pd_no (vaddr)]--;
+            cleared++;
+          }
+    }
+
+  count_resident (pd, -(int) cleared);
+  if (cleared == 0)
+    return;
+  else if (cnt <= INVLPG_MAX)
+    for (i = 0; i < cnt; i++)
+      invalidate_page (pd, upage + i * PGSIZE);
+  else
+    invalidate_pagedir (pd);
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -180,7 +465,7 @@ pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty)
       else 
         {
           *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
@@ -209,13 +494,32 @@ pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed)
       else 
         {
           *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
+          invalidate_page (pd, vpage);
         }
     }
 }
 
+/* Returns true if the PTE for virtual page VPAGE in PD has been
+   accessed since it was installed or last cleared, and clears
+   the accessed bit, with one lookup.  This is what the eviction
+   clock asks of every page it passes, so the TLB entry is
+   dropped only when the bit was actually set, and only for
+   VPAGE.  Returns false if PD contains no PTE for VPAGE. */
+bool
+pagedir_test_and_clear_accessed (uint32_t *pd, const void *vpage)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+
+  if (pte == NULL || (*pte & PTE_A) == 0)
+    return false;
+  *pte &= ~(uint32_t) PTE_A;
+  invalidate_page (pd, vpage);
+  return true;
+}
+
 /* Loads page directory PD into the CPU's page directory base
-   register. */
+   register.  This flushes PD's user mappings from the TLB, but
+   not the kernel's, which are global when the CPU allows it. */
 void
 pagedir_activate (uint32_t *pd) 
 {
@@ -230,6 +534,43 @@ pagedir_activate (uint32_t *pd)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (pd)) : "memory");
 }
 
+static uint32_t *active_pd (void);
+
+/* Context switches that kept the loaded page directory, and those
+   that had to load another. */
+static long long switch_kept_cnt;
+static long long switch_load_cnt;
+
+/* Makes PD, a user process's page directory, the active one on a
+   context switch, unless it already is.  Threads of one process
+   share their page directory, so switching between them needs no
+   CR3 load.  A null PD, for a kernel thread, leaves whatever page
+   directory is loaded in place: a kernel thread touches only
+   kernel memory, which every page directory maps alike, so it can
+   borrow the last process's instead of flushing its user mappings
+   from the TLB.  That is safe because a page directory is never
+   destroyed while it is loaded; see process_cleanup(). */
+void
+pagedir_switch (uint32_t *pd)
+{
+  if (pd == NULL || active_pd () == pd)
+    switch_kept_cnt++;
+  else
+    {
+      switch_load_cnt++;
+      pagedir_activate (pd);
+    }
+}
+
+/* Prints how often context switches loaded a page directory. */
+void
+pagedir_print_stats (void)
+{
+  printf ("Page directories: %lld switches loaded CR3, %lld kept it, "
+          "%lld 4 MB pages mapped\n",
+          switch_load_cnt, switch_kept_cnt, large_cnt);
+}
+
 /* Returns the currently active page directory. */
 static uint32_t *
 active_pd (void) 
@@ -250,7 +591,10 @@ active_pd (void)
 
    This function invalidates the TLB if PD is the active page
    directory.  (If PD is not active then its entries are not in
-   the TLB, so there is no need to invalidate anything.) */
+   the TLB, so there is no need to invalidate anything.)  Only
+   the boot processor runs, so its TLB is the only one; once
+   others do, this and invalidate_page() must also reach, by IPI,
+   each CPU that has PD loaded. */
 static void
 invalidate_pagedir (uint32_t *pd) 
 {
@@ -261,3 +605,15 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/* Drops the TLB entry for VADDR if PD is the active page
+   directory, which is all that clearing the present, accessed, or
+   dirty bit of a single PTE requires.  The CPU sets those bits again
+   on the next use only if it has to walk the page table, which
+   it does not while a stale TLB entry remains. */
+static void
+invalidate_page (uint32_t *pd, const void *vaddr)
+{
+  if (active_pd () == pd)
+    asm volatile ("invlpg %0" : : "m" (*(const uint8_t *) vaddr) : "memory");
+}
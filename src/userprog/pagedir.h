@@ -2,17 +2,29 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
+bool pagedir_map_range (uint32_t *pd, void *upage, void **kpages, size_t cnt,
+                        bool rw);
+bool pagedir_set_large (uint32_t *pd, void *upage, void *kpage, bool rw);
+void pagedir_clear_large (uint32_t *pd, void *upage);
+bool pagedir_set_page_cow (uint32_t *pd, void *upage, void *kpage);
+bool pagedir_is_cow (uint32_t *pd, const void *upage);
 void *pagedir_get_page (uint32_t *pd, const void *upage);
 void pagedir_clear_page (uint32_t *pd, void *upage);
+void pagedir_clear_range (uint32_t *pd, void *upage, size_t cnt);
 bool pagedir_is_dirty (uint32_t *pd, const void *upage);
 void pagedir_set_dirty (uint32_t *pd, const void *upage, bool dirty);
 bool pagedir_is_accessed (uint32_t *pd, const void *upage);
 void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
+bool pagedir_test_and_clear_accessed (uint32_t *pd, const void *upage);
 void pagedir_activate (uint32_t *pd);
+void pagedir_switch (uint32_t *pd);
+size_t pagedir_max_resident (uint32_t *pd);
+void pagedir_print_stats (void);
 
 #endif /* userprog/pagedir.h */
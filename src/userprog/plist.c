@@ -1,219 +1,468 @@
-#include "plist.h"
-#include <stdio.h>
-#include "threads/synch.h"
-#define undefined -1
-#define plist_debug 0
-struct semaphore plist_fatlock;
-void init_fatlock(process_list * list)
-{
-  #if plist_debug
-   debug("Enter fatlock\n");
-  #endif
-  sema_init(&plist_fatlock,1);
-
- int i = 0;
- for(; i < PLIST_MAX; i++)
-   {
-   list->table[i].free = true;
-   list->table[i].parent_id = undefined;
-   list->table[i].alive = false;
-   list->table[i].parent_alive= false;
-   list->table[i].exit_status = undefined;
-   sema_init(&(list->table[i].is_done),0);
-   }
-  #if plist_debug
-  debug("Exit fatlock\n");
-  #endif
-}
-
-
-plist_value_t plist_form_process_info(int parent_id)
-{
-  #if plist_debug
-  debug("Enterd process_info\n");
-  #endif
-  sema_down(&plist_fatlock);
-  plist_value_t t;
-  t.alive = true;
-  //check if parent = idle thread (tid = -1)
-  t.parent_alive = parent_id != -1;
-  t.parent_id = parent_id;
-  t.free = false;
-  t.is_waiting =false;
-  t.exit_status = undefined;
-  sema_up(&plist_fatlock);
-  #if plist_debug
-  debug("Exit process_info\n");
-  #endif
-  return t;
-}
-
-int plist_find(process_list* list,plist_value_t* return_value,  plist_key_t element_id)
-{
-  #if plist_debug
-  debug("Enterd find\n");
-  #endif
-  sema_down(&plist_fatlock);
-
-  plist_value_t ret = list->table[element_id];
-  if(ret.free || ret.parent_id == undefined)
-    return -1;
-  return_value = &(list->table[element_id]);
-  sema_up(&plist_fatlock);
-  #if plist_debug
-  debug("Exit find\n");
-  #endif
-  return 1;
-}
-
-
-plist_key_t plist_insert(process_list* list, plist_value_t v)
-{
-  //sema_dow
-  #if plist_debug
-  debug("Enterd insert\n");
-  #endif
-  sema_down(&plist_fatlock);
-  int i = 0;
-  plist_key_t ret = -1;
-  for(;i < PLIST_MAX; i++)
-  {
-     if(list->table[i].free)
-     {
-      list->table[i] = v;
-      sema_init(&(list->table[i].is_done),0);
-      ret = i;
-      break;
-     }
-  }
-  sema_up(&plist_fatlock);
-  #if plist_debug
-  debug("Exit insert with %i\n",ret);
-  #endif
-  return ret;
-}
-
-void plist_set_exit_status(process_list* list, plist_key_t element_id, int exit_status)
-{
-  #if plist_debug
-  debug("Enterd set_exit_status\n");
-  #endif
-  sema_down(&plist_fatlock);
-  bool isFree = list->table[element_id].free;
-  sema_up(&plist_fatlock);
-  if(!isFree)
-    {
-      sema_down(&plist_fatlock);
-      list->table[element_id].exit_status = exit_status;
-      sema_up(&(list->table[element_id].is_done));
-      sema_up(&plist_fatlock);
-
-    }
-  #if plist_debug
-  debug("Exit exit_status\n");
-  #endif
-}
-
-int plist_get_exit_status(process_list* list, plist_key_t element_id)
-{
-  #if plist_debug
-  debug("Enterd get_exit_status\n");
-  #endif
-  int ret = -1;
-  sema_down(&plist_fatlock);
-  ret = list->table[element_id].exit_status;
-  list->table[element_id].free = true;
-  sema_up(&plist_fatlock);
-  #if plist_debug
-  debug("Exit get exit_status with %i\n",ret);
-  #endif
-  return ret;
-}
-
-bool plist_wait_for_pid(process_list*list,plist_key_t element_id)
-{
-  sema_down(&plist_fatlock);
-  bool waiting = list->table[element_id].is_waiting;
-  sema_up(&plist_fatlock);
-  if(!waiting){
-  sema_down(&(list->table[element_id].is_done));
-   sema_down(&plist_fatlock);
-   list->table[element_id].is_waiting = true;
-   sema_up(&plist_fatlock);
-   return true;
-  }
-  return false;
-}
-
-bool plist_remove(process_list* list, plist_key_t element_id)
-{
-  #if plist_debug
-  debug("Enterd remove\n");
-  #endif
-  //sema_down
-  sema_down(&plist_fatlock);
-  bool ret = false;
-    bool is_empty = list->table[element_id].free;
-    if(!is_empty)
-    { 
-      int parent_id = element_id;
-      int i = 0;
-      for(; i < PLIST_MAX; i++)
-      {
-        if(!list->table[i].free && (list->table[i].parent_id == parent_id || parent_id == -1))
-        {
-          list->table[i].parent_alive = false;
-        }
-      }
-      list->table[element_id].alive = false;
-      list->table[element_id].free = !list->table[element_id].alive && !list->table[element_id].parent_alive;
-      //
-      ret = true;
-    }
-    sema_up(&plist_fatlock);
-  #if plist_debug
-  debug("Exit remove\n");
-  #endif
-  //sema_up
-  return ret;
-}
-
-void plist_clean(process_list* list)
-{    
-  #if plist_debug
-  debug("Enterd free\n");
-  #endif
-  sema_down(&plist_fatlock);
-   int i = 0;
-    for(; i < PLIST_MAX; i++)
-    {
-      if(!list->table[i].free && (!list->table[i].alive && !list->table[i].parent_alive))
-      {
-        list->table[i].free = true;
-      }
-      }
-  sema_up(&plist_fatlock);
-  #if plist_debug
-  debug("Exit free\n");
-  #endif
-}
-
-void plist_print_list(process_list* list)
-{
-  #if plist_debug
-  debug("Enterd print\n");
-  #endif
-  //sema_down
-  sema_down(&plist_fatlock);
-  int i = 0;
-  for(;i < PLIST_MAX; i++)
-  {
-      if(!list->table[i].free)
-         debug("id:%i pid:%i Alive:%i pa:%i es:%i \tf:%i\n",i, list->table[i].parent_id, list->table[i].alive, list->table[i].parent_alive, list->table[i].exit_status, list->table[i].free);
-  }
-  sema_up(&plist_fatlock);
-  #if plist_debug
-  debug("Exit print\n");
-  #endif
-  //sema_up
-}
+#include "plist.h"
+#include <stdio.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#define undefined -1
+/* Subsystem of this file's debug() messages. */
+#define DEBUG_SUBSYS LOG_PLIST
+
+/* Number of entries in one page-sized chunk. */
+#define CHUNK_ENTRIES (PGSIZE / sizeof(plist_value_t))
+
+/* Returns the entry at index IDX, which must be below
+   LIST->entry_cnt. */
+static plist_value_t* entry_at(process_list* list, unsigned idx)
+{
+  return &list->chunks[idx / CHUNK_ENTRIES][idx % CHUNK_ENTRIES];
+}
+
+/* Returns the allocated entry named by ELEMENT_ID with its lock
+   held, or NULL if there is none. */
+static plist_value_t* lookup(process_list* list, plist_key_t element_id)
+{
+  if(element_id <= 0)
+    return NULL;
+  unsigned idx = TID_INDEX(element_id);
+  /* ENTRY_CNT only grows, and only after its chunk is set up, so
+     it may be read without the alloc_lock. */
+  if(idx >= list->entry_cnt)
+    return NULL;
+  barrier();
+
+  plist_value_t* e = entry_at(list, idx);
+  lock_acquire(&e->lock);
+  if(e->free || e->key != element_id)
+    {
+      lock_release(&e->lock);
+      return NULL;
+    }
+  return e;
+}
+
+/* Adds a chunk of new free entries to LIST.  LIST's alloc_lock
+   must be held.  Returns false if memory runs out. */
+static bool grow(process_list* list)
+{
+  ASSERT(lock_held_by_current_thread(&list->alloc_lock));
+
+  if(list->entry_cnt / CHUNK_ENTRIES >= PLIST_CHUNK_MAX
+     || list->entry_cnt >= TID_CNT)
+    return false;
+  plist_value_t* chunk = palloc_get_page(PAL_ZERO);
+  if(chunk == NULL)
+    return false;
+  list->chunks[list->entry_cnt / CHUNK_ENTRIES] = chunk;
+
+  unsigned i = 0;
+  for(; i < CHUNK_ENTRIES; i++)
+    {
+      plist_value_t* e = &chunk[i];
+      lock_init(&e->lock);
+      e->free = true;
+      e->parent_id = undefined;
+      e->exit_status = undefined;
+      e->thread = NULL;
+      e->rusage = NULL;
+      sema_init(&e->is_done,0);
+      sema_init(&e->child_done,0);
+      list_init(&e->children);
+      e->key = undefined;
+    }
+  barrier();
+  list->entry_cnt += CHUNK_ENTRIES;
+  return true;
+}
+
+/* Drops one reference to entry E, whose lock must be held, and
+   frees E if that was the last.  The process itself holds one
+   reference until it exits, and its parent holds another until
+   it has waited for the process or exits itself. */
+static void unref_entry(process_list* list, plist_value_t* e)
+{
+  ASSERT(lock_held_by_current_thread(&e->lock));
+  ASSERT(e->ref_cnt > 0);
+
+  if(--e->ref_cnt > 0)
+    return;
+  ASSERT(!e->alive && !e->parent_alive);
+  ASSERT(list_empty(&e->children));
+
+  plist_key_t key = e->key;
+  free(e->rusage);
+  e->rusage = NULL;
+  lock_acquire(&list->alloc_lock);
+  e->free = true;
+  e->key = undefined;
+  lock_release(&list->alloc_lock);
+  tid_release(key);
+}
+
+void init_fatlock(process_list * list)
+{
+   debug("Enter fatlock\n");
+  lock_init_named(&list->alloc_lock, "plist_alloc");
+  list->entry_cnt = 0;
+  debug("Exit fatlock\n");
+}
+
+
+plist_value_t plist_form_process_info(int parent_id)
+{
+  debug("Enterd process_info\n");
+  plist_value_t t;
+  t.alive = true;
+  /* A parent of -1 is the kernel's main thread, which has no entry
+     of its own but waits for its children all the same. */
+  t.parent_alive = true;
+  t.parent_id = parent_id;
+  t.free = false;
+  t.is_waiting =false;
+  t.exit_status = undefined;
+  t.thread = NULL;
+  debug("Exit process_info\n");
+  return t;
+}
+
+int plist_find(process_list* list,plist_value_t* return_value,  plist_key_t element_id)
+{
+  debug("Enterd find\n");
+  plist_value_t* e = lookup(list, element_id);
+  if(e == NULL || e->parent_id == undefined)
+    {
+      if(e != NULL)
+        lock_release(&e->lock);
+      return -1;
+    }
+  return_value->free = e->free;
+  return_value->parent_id = e->parent_id;
+  return_value->exit_status = e->exit_status;
+  return_value->alive = e->alive;
+  return_value->parent_alive = e->parent_alive;
+  return_value->is_waiting = e->is_waiting;
+  return_value->thread = e->thread;
+  lock_release(&e->lock);
+  debug("Exit find\n");
+  return 1;
+}
+
+
+bool plist_insert(process_list* list, plist_key_t key, plist_value_t v)
+{
+  debug("Enterd insert\n");
+  /* The entry at KEY's index is free: whoever had it before held
+     that index's previous tid until freeing it. */
+  plist_value_t* e = NULL;
+  unsigned idx = TID_INDEX(key);
+  if(!tid_hold(key))
+    return false;
+  lock_acquire(&list->alloc_lock);
+  while(idx >= list->entry_cnt && grow(list))
+    continue;
+  if(idx < list->entry_cnt)
+    {
+      e = entry_at(list, idx);
+      ASSERT(e->free);
+      e->free = false;
+      e->key = key;
+    }
+  lock_release(&list->alloc_lock);
+  if(e == NULL)
+    {
+      tid_release(key);
+      return false;
+    }
+
+  /* Link the new entry to its parent first, so that the parent
+     sees it as a child from the start.  The parent is alive,
+     since it is waiting in process_execute() for us. */
+  plist_value_t* parent = NULL;
+  if(v.parent_alive && v.parent_id != undefined)
+    {
+      parent = lookup(list, v.parent_id);
+      if(parent != NULL && !parent->alive)
+        {
+          lock_release(&parent->lock);
+          parent = NULL;
+        }
+      if(parent == NULL)
+        v.parent_alive = false;
+    }
+  lock_acquire(&e->lock);
+  e->parent_id = v.parent_id;
+  e->exit_status = v.exit_status;
+  e->alive = v.alive;
+  e->parent_alive = v.parent_alive;
+  e->ref_cnt = v.parent_alive ? 2 : 1;
+  e->is_waiting = v.is_waiting;
+  e->thread = v.thread;
+  e->rusage = NULL;
+  sema_init(&e->is_done,0);
+  sema_init(&e->child_done,0);
+  if(parent != NULL)
+    list_push_back(&parent->children, &e->child_elem);
+  lock_release(&e->lock);
+  if(parent != NULL)
+    lock_release(&parent->lock);
+  debug("Exit insert with %i\n",key);
+  return true;
+}
+
+void plist_set_exit_status(process_list* list, plist_key_t element_id, int exit_status)
+{
+  debug("Enterd set_exit_status\n");
+  plist_value_t* e = lookup(list, element_id);
+  if(e != NULL)
+    {
+      e->exit_status = exit_status;
+      sema_up(&e->is_done);
+      lock_release(&e->lock);
+    }
+  debug("Exit exit_status\n");
+}
+
+int plist_get_exit_status(process_list* list, plist_key_t element_id)
+{
+  debug("Enterd get_exit_status\n");
+  int ret = -1;
+  plist_value_t* e = lookup(list, element_id);
+  if(e != NULL)
+    {
+      ret = e->exit_status;
+      lock_release(&e->lock);
+    }
+  debug("Exit get exit_status with %i\n",ret);
+  return ret;
+}
+
+bool plist_wait_for_pid(process_list*list,plist_key_t element_id)
+{
+  plist_value_t* e = lookup(list, element_id);
+  if(e == NULL)
+    return false;
+  bool waiting = e->is_waiting || e->parent_id != process_pid();
+  if(!waiting)
+    e->is_waiting = true;
+  lock_release(&e->lock);
+
+  /* Only we, the parent, can free E, so it stays put. */
+  if(!waiting)
+    sema_down(&e->is_done);
+  return !waiting;
+}
+
+void plist_release_child(process_list* list, plist_key_t element_id)
+{
+  plist_value_t* e = lookup(list, element_id);
+  plist_value_t* parent;
+  if(e == NULL)
+    return;
+
+  /* The caller is the parent, so E stays allocated and its
+     PARENT_ID stays valid until we unlink it. */
+  bool linked = e->parent_alive && e->parent_id == process_pid();
+  int parent_id = e->parent_id;
+  lock_release(&e->lock);
+  if(!linked)
+    return;
+
+  parent = parent_id != undefined ? lookup(list, parent_id) : NULL;
+  lock_acquire(&e->lock);
+  if(e->parent_alive)
+    {
+      if(parent != NULL)
+        list_remove(&e->child_elem);
+      e->parent_alive = false;
+      unref_entry(list, e);
+    }
+  lock_release(&e->lock);
+  if(parent != NULL)
+    lock_release(&parent->lock);
+}
+
+bool plist_remove(process_list* list, plist_key_t element_id)
+{
+  debug("Enterd remove\n");
+  plist_value_t* e = lookup(list, element_id);
+  if(e == NULL)
+    return false;
+
+  /* Orphan our children, freeing the ones that are already dead.
+     Only our own children are visited, so exit costs time
+     proportional to the number of children. */
+  while(!list_empty(&e->children))
+    {
+      plist_value_t* child = list_entry(list_pop_front(&e->children),
+                                        plist_value_t, child_elem);
+      lock_acquire(&child->lock);
+      child->parent_alive = false;
+      unref_entry(list, child);
+      lock_release(&child->lock);
+    }
+  e->alive = false;
+  /* Wake a waiting parent even if we were killed without an exit
+     status; it then sees -1. */
+  sema_up(&e->is_done);
+  /* While we are linked to the parent it cannot finish exiting, as
+     orphaning us needs our lock, so its entry stays put.  Its lock
+     must not be taken here, as it is ordered before ours. */
+  if(e->parent_alive && e->parent_id != undefined)
+    {
+      sema_up(&entry_at(list, TID_INDEX(e->parent_id))->child_done);
+    }
+  unref_entry(list, e);
+  lock_release(&e->lock);
+  debug("Exit remove\n");
+  return true;
+}
+
+plist_key_t plist_wait_any(process_list* list, int* status)
+{
+  plist_value_t* self = lookup(list, process_pid());
+  if(self == NULL)
+    return -1;
+
+  for(;;)
+    {
+      /* Look for a dead child that nobody waits for, noting whether
+         any child is left that could still be waited for. */
+      plist_value_t* found = NULL;
+      bool waitable = false;
+      struct list_elem* el;
+      for(el = list_begin(&self->children); el != list_end(&self->children);
+          el = list_next(el))
+        {
+          plist_value_t* child = list_entry(el, plist_value_t, child_elem);
+          lock_acquire(&child->lock);
+          if(!child->is_waiting)
+            {
+              waitable = true;
+              if(!child->alive)
+                {
+                  child->is_waiting = true;
+                  found = child;
+                }
+            }
+          lock_release(&child->lock);
+          if(found != NULL)
+            break;
+        }
+      if(found != NULL || !waitable)
+        {
+          lock_release(&self->lock);
+          if(found == NULL)
+            return -1;
+
+          /* Only we, the parent, can free FOUND, so it stays put. */
+          plist_key_t key = found->key;
+          *status = found->exit_status;
+          plist_release_child(list, key);
+          return key;
+        }
+
+      /* Not holding our lock, so the children can exit. */
+      lock_release(&self->lock);
+      sema_down(&self->child_done);
+      self = lookup(list, process_pid());
+      if(self == NULL)
+        return -1;
+    }
+}
+
+/* The table is printed whatever the plist log level, as SYS_PLIST
+   asks for it.  The "# " prefix keeps it out of the test output. */
+void plist_print_list(process_list* list)
+{
+  debug("Enterd print\n");
+  unsigned i = 0;
+  for(;i < list->entry_cnt; i++)
+  {
+      plist_value_t* e = entry_at(list, i);
+      lock_acquire(&e->lock);
+      if(!e->free)
+        {
+         printf("# id:%i pid:%i Alive:%i pa:%i es:%i \tf:%i\n",e->key, e->parent_id, e->alive, e->parent_alive, e->exit_status, e->free);
+         if(e->thread != NULL)
+         {
+           printf("# \tio: %lld bytes read, %lld bytes written\n",
+                  e->thread->io_read_bytes,
+                  e->thread->io_write_bytes);
+           printf("# \tcpu: %lld user ticks, %lld kernel ticks, "
+                  "%lld ticks waiting, %u voluntary and %u involuntary "
+                  "switches\n",
+                  e->thread->user_ticks,
+                  e->thread->kernel_ticks,
+                  e->thread->wait_ticks,
+                  e->thread->voluntary_switches,
+                  e->thread->involuntary_switches);
+           printf("# \tfaults: %lld file, %lld zero, %lld swap, %lld stack, "
+                  "%lld cow, %lld invalid\n",
+                  e->thread->fault_cnt[FAULT_FILE],
+                  e->thread->fault_cnt[FAULT_ZERO],
+                  e->thread->fault_cnt[FAULT_SWAP],
+                  e->thread->fault_cnt[FAULT_STACK],
+                  e->thread->fault_cnt[FAULT_COW],
+                  e->thread->fault_cnt[FAULT_INVALID]);
+         }
+        }
+      lock_release(&e->lock);
+  }
+  debug("Exit print\n");
+  //sema_up
+}
+
+void plist_set_thread(process_list* list, plist_key_t element_id,
+                      struct thread *thread)
+{
+  plist_value_t* e = lookup(list, element_id);
+  if(e == NULL)
+    return;
+  e->thread = thread;
+  lock_release(&e->lock);
+}
+
+void plist_set_rusage(process_list* list, plist_key_t element_id,
+                      const struct rusage* ru)
+{
+  struct rusage* copy = malloc(sizeof *copy);
+  if(copy == NULL)
+    return;
+  *copy = *ru;
+  plist_value_t* e = lookup(list, element_id);
+  if(e == NULL || e->rusage != NULL)
+    {
+      if(e != NULL)
+        lock_release(&e->lock);
+      free(copy);
+      return;
+    }
+  e->rusage = copy;
+  lock_release(&e->lock);
+}
+
+void plist_get_rusage(process_list* list, plist_key_t element_id,
+                      struct rusage* ru)
+{
+  for(;;)
+    {
+      plist_value_t* e = lookup(list, element_id);
+      if(e == NULL)
+        return;
+      if(!e->alive)
+        {
+          if(e->rusage != NULL)
+            *ru = *e->rusage;
+          lock_release(&e->lock);
+          return;
+        }
+      lock_release(&e->lock);
+      /* The child upped IS_DONE once with its exit status, which
+         plist_wait_for_pid() took, and ups it again in
+         plist_remove() once it is dead.  Only we, the parent, can
+         free E, so it stays put. */
+      sema_down(&e->is_done);
+    }
+}
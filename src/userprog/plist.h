@@ -1,73 +1,132 @@
-#ifndef _PLIST_H_
-#define _PLIST_H_
-#include <stdbool.h>
-#include <stdlib.h>
-#include "threads/synch.h"
-typedef struct process_info plist_value_t;
-typedef struct process_list process_list;
-typedef int plist_key_t;
-#define PLIST_MAX 61
-/* Place functions to handle a running process here (process list).
-   
-   plist.h : Your function declarations and documentation.
-   plist.c : Your implementation.
-
-   The following is strongly recommended:
-
-   - A function that given process inforamtion (up to you to create)
-   inserts this in a list of running processes and return an integer
-   that can be used to find the information later on.
-
-   - A function that given an integer (obtained from above function)
-   FIND the process information in the list. Should return some
-   failure code if no process matching the integer is in the list.
-   Or, optionally, several functions to access any information of a
-   particular process that you currently need.
-
-   - A function that given an integer REMOVE the process information
-   from the list. Should only remove the information when no process
-   or thread need it anymore, but must guarantee it is always
-   removed EVENTUALLY.
-     
-   - A function that print the entire content of the list in a nice,
-   clean, readable format.
-     
-*/
-struct process_info
-{
-  bool free;
-  int parent_id;
-  int exit_status;
-  bool alive;
-  bool parent_alive;
-  bool is_waiting;
-  struct semaphore is_done;
-  //semaphore wait for child?
-};
-
-struct process_list
-{
-plist_value_t table[PLIST_MAX];
-};
-
-void init_fatlock(process_list* list);
-
-plist_value_t plist_form_process_info(int parent_id);
-//Returns a number to find and remove the element later NOT THE PROCESS ID
-plist_key_t plist_insert(process_list* list, plist_value_t v);
-
-//returns -1 if cant find and places return value in parameter return_value
-int plist_find(process_list* list,plist_value_t*return_value,  plist_key_t element_id);
-
-void plist_set_exit_status(process_list* list, plist_key_t element_id, int exit_status);
-int plist_get_exit_status(process_list* list, plist_key_t element_id);
-bool plist_remove(process_list* list, plist_key_t element_id);
-
-void plist_remove_children(process_list* list, int parent_element_id);
-
-void plist_clean(process_list* list);
-
-void plist_print_list(process_list*  list);
-
-
-#endif
+#ifndef _PLIST_H_
+#define _PLIST_H_
+#include <stdbool.h>
+#include <stdlib.h>
+#include <list.h>
+#include <rusage.h>
+#include "threads/synch.h"
+#include "threads/thread.h"
+typedef struct process_info plist_value_t;
+typedef struct process_list process_list;
+typedef int plist_key_t;
+
+/* A key is the pid of the entry's process, which is the tid of
+   its thread.  The entry for a pid is at the pid's index in the
+   tid table, and holds the tid until the entry is freed, so a
+   stale key never finds the entry's next occupant. */
+
+/* Maximum number of page-sized chunks of entries. */
+#define PLIST_CHUNK_MAX 512
+/* Place functions to handle a running process here (process list).
+   
+   plist.h : Your function declarations and documentation.
+   plist.c : Your implementation.
+
+   The following is strongly recommended:
+
+   - A function that given process inforamtion (up to you to create)
+   inserts this in a list of running processes and return an integer
+   that can be used to find the information later on.
+
+   - A function that given an integer (obtained from above function)
+   FIND the process information in the list. Should return some
+   failure code if no process matching the integer is in the list.
+   Or, optionally, several functions to access any information of a
+   particular process that you currently need.
+
+   - A function that given an integer REMOVE the process information
+   from the list. Should only remove the information when no process
+   or thread need it anymore, but must guarantee it is always
+   removed EVENTUALLY.
+     
+   - A function that print the entire content of the list in a nice,
+   clean, readable format.
+     
+*/
+/* An entry in the process list.  FREE and KEY are protected by
+   both the entry's LOCK and the list's ALLOC_LOCK: a free entry is
+   claimed holding ALLOC_LOCK alone, and released holding both.  The other
+   members are protected by LOCK.  When both an entry and one of
+   its children must be locked, the parent is locked first. */
+struct process_info
+{
+  struct lock lock;        /* Protects this entry. */
+  bool free;
+  int parent_id;
+  int exit_status;
+  bool alive;
+  bool parent_alive;       /* True while linked into the parent's CHILDREN. */
+  int ref_cnt;             /* Held by the process and by its parent. */
+  bool is_waiting;
+  struct semaphore is_done;
+  struct semaphore child_done; /* Upped each time one of CHILDREN dies. */
+  struct thread *thread;   /* Running thread, for I/O statistics, or NULL. */
+  struct rusage *rusage;   /* Usage of the dead process, or NULL. */
+  struct list children;    /* Entries whose parent is this process. */
+  struct list_elem child_elem; /* Element in the parent's CHILDREN. */
+  plist_key_t key;         /* Pid of the process, if not free. */
+};
+
+/* The entries live in page-sized chunks, allocated as the list
+   grows and never released.  Since an entry's position is its
+   pid's index, both claiming and finding one take constant
+   time. */
+struct process_list
+{
+struct lock alloc_lock;    /* Protects CHUNKS and ENTRY_CNT. */
+plist_value_t* chunks[PLIST_CHUNK_MAX];
+unsigned entry_cnt;        /* Number of entries in CHUNKS. */
+};
+
+void init_fatlock(process_list* list);
+
+plist_value_t plist_form_process_info(int parent_id);
+/* Inserts V as the entry for the running process, whose pid is
+   KEY.  Returns false if memory runs out. */
+bool plist_insert(process_list* list, plist_key_t key, plist_value_t v);
+
+//returns -1 if cant find and places return value in parameter return_value
+int plist_find(process_list* list,plist_value_t*return_value,  plist_key_t element_id);
+
+void plist_set_exit_status(process_list* list, plist_key_t element_id, int exit_status);
+int plist_get_exit_status(process_list* list, plist_key_t element_id);
+bool plist_remove(process_list* list, plist_key_t element_id);
+
+/* Waits until child ELEMENT_ID has an exit status, unless another
+   wait for it has already been made.  Returns true if it waited. */
+bool plist_wait_for_pid(process_list* list, plist_key_t element_id);
+
+/* Called by the parent of ELEMENT_ID once it no longer needs the
+   child's exit status.  Frees the entry if the child is dead. */
+void plist_release_child(process_list* list, plist_key_t element_id);
+
+/* Waits until some child of the current process that nobody is
+   waiting for has died, releases it and stores its exit status in
+   *STATUS.  Returns the child's key, or -1 at once if there is no
+   such child left to wait for. */
+plist_key_t plist_wait_any(process_list* list, int* status);
+
+void plist_remove_children(process_list* list, int parent_element_id);
+
+void plist_print_list(process_list*  list);
+
+/* Sets the thread whose I/O statistics plist_print_list() shows
+   for ELEMENT_ID.  Must be reset to NULL before the thread
+   exits. */
+void plist_set_thread(process_list* list, plist_key_t element_id,
+                      struct thread *thread);
+
+/* Records a copy of RU as the resources used by ELEMENT_ID, which
+   is exiting, for its parent to collect.  Does nothing if memory
+   runs out. */
+void plist_set_rusage(process_list* list, plist_key_t element_id,
+                      const struct rusage* ru);
+
+/* Called by the parent of ELEMENT_ID once plist_wait_for_pid() has
+   returned true.  Waits until the child has finished exiting and
+   stores the resources it used in *RU, leaving *RU alone if none
+   were recorded. */
+void plist_get_rusage(process_list* list, plist_key_t element_id,
+                      struct rusage* ru);
+
+#endif
@@ -1,4 +1,5 @@
 #include <debug.h>
+#include <stats.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -7,24 +8,42 @@
 #include "userprog/load.h"
 #include "userprog/pagedir.h"  /* pagedir_activate etc. */
 #include "userprog/tss.h"      /* tss_update */
+#include "filesys/directory.h"
 #include "filesys/file.h"
 #include "threads/flags.h"     /* FLAG_* constants */
 #include "threads/thread.h"
 #include "threads/vaddr.h"     /* PHYS_BASE */
 #include "threads/interrupt.h" /* if_ */
+#include "threads/malloc.h"
+#include "threads/trace.h"
+#include "devices/disk.h"
+#include "devices/timer.h"
 
 /* Headers not yet used that you may need for various reasons. */
 #include "threads/synch.h"
-#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "lib/kernel/list.h"
 
 #include "userprog/flist.h"
+#include "userprog/futex.h"
+#include "userprog/kinfo.h"
 #include "userprog/plist.h"
+#include "userprog/shm.h"
+#include "userprog/syscall.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 /* HACK defines code you must remove and implement in a proper way */
 //#define HACK
 
+/* Subsystem of this file's debug() messages. */
+#define DEBUG_SUBSYS LOG_PROCESS
+
 struct process_list process_id_table;
+
+bool process_rusage_report;
 /* This function is called at boot time (threads/init.c) to initialize
  * the process subsystem. */
 void process_init(void)
@@ -33,14 +52,79 @@ void process_init(void)
   //sema_init()
 }
 
-/* This function is currently never called. As thread_exit does not
- * have an exit status parameter, this could be used to handle that
- * instead. Note however that all cleanup after a process must be done
- * in process_cleanup, and that process_cleanup are already called
- * from thread_exit - do not call cleanup twice! */
-void process_exit(int status UNUSED)
+/* A thread started by process_thread_create(), as its process
+   sees it.  The record stays in the process's THREADS list until
+   the thread is joined or the process is freed. */
+struct user_thread
+  {
+    struct list_elem elem;      /* Element in process's THREADS. */
+    tid_t tid;                  /* The thread's tid. */
+    bool joined;                /* Being joined by some thread? */
+    struct semaphore done;      /* Upped when the thread exits. */
+
+    /* How the thread starts. */
+    struct process *process;
+    void (*eip) (void);         /* User entry point. */
+    void *esp;                  /* User stack pointer. */
+    struct dir *cwd;            /* Working directory, from its creator. */
+  };
+
+/* Sets the exit status of the current process to STATUS and makes
+   all of its threads exit: each one exits when it next returns to
+   user mode, and a thread waiting on a futex is woken to do so.
+   Only the first call for a process sets its status.  The caller
+   must still call thread_exit() itself: all cleanup after a
+   process is done in process_cleanup(), which thread_exit() calls
+   for each thread, the last one freeing the process. */
+void process_exit(int status)
+{
+  struct process *p = thread_current ()->process;
+  bool first;
+
+  if (p == NULL)
+    {
+      plist_set_exit_status(&process_id_table, process_pid(), status);
+      return;
+    }
+  lock_acquire (&p->lock);
+  first = !p->exiting;
+  p->exiting = true;
+  lock_release (&p->lock);
+  if (first)
+    {
+      plist_set_exit_status(&process_id_table, p->pid, status);
+      futex_wake_process (p);
+    }
+}
+
+/* Returns the pid of the current thread's process, or the
+   thread's own tid if it is a kernel thread. */
+tid_t
+process_pid (void)
 {
-  plist_set_exit_status(&process_id_table, thread_current()->tid,status);
+  struct process *p = thread_current ()->process;
+  return p != NULL ? p->pid : thread_tid ();
+}
+
+/* Returns true if the current thread belongs to a process that
+   is exiting, in which case it must not return to user mode.  May
+   be called with interrupts off, since EXITING only ever goes
+   from false to true. */
+bool
+process_exiting (void)
+{
+  struct process *p = thread_current ()->process;
+  return p != NULL && p->exiting;
+}
+
+/* Returns the running process's stdio files, all null for the
+   console if it is a kernel thread. */
+static struct file **
+current_stdio (void)
+{
+  static struct file *console[2];
+  struct process *p = thread_current ()->process;
+  return p != NULL ? p->stdio : console;
 }
 
 /* Print a list of all running processes. The list shall include all
@@ -53,28 +137,229 @@ void process_print_list()
 
 struct parameters_to_start_process
 {
-  char* command_line;
+  /* Initial user stack, built by build_stack: the last STACK_SIZE
+     bytes of STACK_PAGE, to be copied to just below PHYS_BASE.
+     FILE_NAME (argv[0]) points into the page. */
+  uint8_t* stack_page;
+  size_t stack_size;
+  const char* file_name;
   struct semaphore semaphore_process_id; 
   int process_id;
   int parent_id;
+  /* Start of the current exec phase, from timer_ns(). */
+  int64_t phase_start;
+  /* Working directory for the process, inherited from the
+     parent, or null for the root directory. */
+  struct dir* cwd;
+  /* Files for the process's fds 0 and 1, its own copies of the
+     parent's or of the ones given to process_execute_stdio(), or
+     null for the console. */
+  struct file *stdio[2];
+  /* Files for the process's other fds, shared with the parent by
+     process_execute_inherit(), or null for none. */
+  struct map *files;
 };
 
+/* Limits on the command line passed to build_stack: the bytes of
+   the command line, including its null terminator, and the number
+   of words.  Each takes at most half of the page. */
+#define ARGS_MAX  (PGSIZE / 2)
+#define ARGC_MAX  (PGSIZE / 2 / sizeof (char *) - 1)
+
+/* Splits COMMAND_LINE into words and lays them out in PAGE as the
+   initial user stack of a new process, in the last bytes of the
+   page exactly as main() expects them just below PHYS_BASE: the
+   strings, then argv[] with its null terminator, then argv, argc
+   and a null return address.  Pointers are user addresses.  Sets
+   *FILE_NAME to the first word (in PAGE) and returns the number of
+   bytes used, or 0 if COMMAND_LINE has no words or does not fit. */
+static size_t
+build_stack (const char *command_line, uint8_t *page,
+             const char **file_name)
+{
+  uint8_t *top = page + PGSIZE;
+  size_t len = strlen (command_line) + 1;
+  /* Word starts go at the bottom of the page until argc is known. */
+  char **words = (char **) page;
+  char *dst, *strings;
+  uint32_t *sp;
+  int argc = 0, i;
+  bool in_word = false;
+
+#define UADDR(KADDR) ((uint32_t) PHYS_BASE - (uint32_t) (top - (uint8_t *) (KADDR)))
+
+  if (len > ARGS_MAX)
+    return 0;
+  strings = dst = (char *) top - len;
+  for (; *command_line != '\0'; command_line++)
+    if (*command_line == ' ' || *command_line == '\t')
+      {
+        if (in_word)
+          *dst++ = '\0';
+        in_word = false;
+      }
+    else
+      {
+        if (!in_word)
+          {
+            if (argc == ARGC_MAX)
+              return 0;
+            words[argc++] = dst;
+          }
+        *dst++ = *command_line;
+        in_word = true;
+      }
+  *dst = '\0';
+  if (argc == 0)
+    return 0;
+
+  /* argv[], argv, argc, return address, below the word-aligned
+     strings.  Copied from the top down, since argv[] may overlap
+     the word starts it is made from. */
+  *file_name = words[0];
+  sp = (uint32_t *) ((uintptr_t) strings & ~(uintptr_t) 3) - (argc + 1);
+  if ((uint8_t *) (sp - 3) < page)
+    return 0;
+  sp[argc] = 0;
+  for (i = argc - 1; i >= 0; i--)
+    sp[i] = UADDR (words[i]);
+  sp[-1] = UADDR (sp);
+  sp[-2] = argc;
+  sp[-3] = 0;
+  sp -= 3;
+  return top - (uint8_t *) sp;
+#undef UADDR
+}
+
 static void
 start_process(struct parameters_to_start_process* parameters) NO_RETURN;
 
-/* Starts a new proccess by creating a new thread to run it. The
-   process is loaded from the file specified in the COMMAND_LINE and
-   started with the arguments on the COMMAND_LINE. The new thread may
-   be scheduled (and may even exit) before process_execute() returns.
-   Returns the new process's thread id, or TID_ERROR if the thread
-   cannot be created. */
-int
-process_execute (const char *command_line) 
+/* Most ticks an exec waits for the user pool to recover from
+   pressure before trying anyway. */
+#define EXEC_WAIT_MAX (TIMER_FREQ / 2)
+
+/* Exec statistics, protected by disabling interrupts. */
+static long long exec_wait_cnt;    /* Execs that waited for memory. */
+static long long exec_wait_ticks;  /* Ticks spent waiting. */
+static long long exec_cnt;         /* Processes started. */
+static int64_t exec_ns[EXEC_PHASE_CNT]; /* Time in each phase. */
+
+/* Holds back a new process while the user pool is under pressure,
+   giving the evictor, or processes that are exiting, a chance to
+   free memory, so that under overload execs slow down rather than
+   fail outright for want of a page.  Gives up after EXEC_WAIT_MAX
+   ticks, since the pressure may be the caller's own doing. */
+static void
+wait_for_memory (void)
+{
+  int64_t start;
+  enum intr_level old_level;
+
+  if (palloc_user_free () >= palloc_user_low)
+    return;
+
+  start = timer_ticks ();
+  while (palloc_user_free () < palloc_user_low
+         && timer_elapsed (start) < EXEC_WAIT_MAX)
+    timer_sleep (1);
+
+  old_level = intr_disable ();
+  exec_wait_cnt++;
+  exec_wait_ticks += timer_elapsed (start);
+  intr_set_level (old_level);
+}
+
+/* Ends exec phase PHASE, which started at *SINCE: adds its time
+   to the statistics, traces it, and starts the next phase now. */
+void
+process_exec_phase (enum exec_phase phase, int64_t *since)
+{
+  int64_t now = timer_ns ();
+  int64_t ns = now - *since;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  exec_ns[phase] += ns;
+  intr_set_level (old_level);
+  trace (TRACE_EXEC_PHASE, phase, ns);
+  *since = now;
+}
+
+/* Fills in the exec fields of *S. */
+void
+process_get_stats (struct stats *s)
+{
+  enum intr_level old_level = intr_disable ();
+  int i;
+
+  s->exec_wait_cnt = exec_wait_cnt;
+  s->exec_wait_ticks = exec_wait_ticks;
+  s->exec_cnt = exec_cnt;
+  for (i = 0; i < EXEC_PHASE_CNT; i++)
+    s->exec_ns[i] = exec_ns[i];
+  intr_set_level (old_level);
+}
+
+/* Closes the stdio and inherited files in ARGUMENTS, for a
+   process that did not take them over. */
+static void
+close_stdio (struct parameters_to_start_process *arguments)
+{
+  file_close (arguments->stdio[0]);
+  file_close (arguments->stdio[1]);
+  map_close_all_files (arguments->files);
+  map_destroy (arguments->files);
+  arguments->files = NULL;
+}
+
+/* Gives ARGUMENTS shares of every file in the running process's
+   table.  Returns false if memory is short. */
+static bool
+share_files (struct parameters_to_start_process *arguments)
+{
+  struct process *p = thread_current ()->process;
+  bool success;
+
+  if (p == NULL)
+    return true;
+  lock_acquire (&p->lock);
+  success = map_share (p->open_file_table, &arguments->files);
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Gives ARGUMENTS copies of STDIO[0] and STDIO[1], where null
+   means the console.  Returns false if memory is short. */
+static bool
+dup_stdio (struct parameters_to_start_process *arguments,
+           struct file *stdio[2])
+{
+  int i;
+
+  for (i = 0; i < 2; i++)
+    {
+      arguments->stdio[i] = NULL;
+      if (stdio[i] != NULL
+          && (arguments->stdio[i] = file_dup (stdio[i])) == NULL)
+        {
+          close_stdio (arguments);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Starts creating a new process to run COMMAND_LINE with STDIO as
+   its fds 0 and 1, and, if INHERIT, the running process's other
+   files at the same fds, filling in ARGUMENTS, which must stay put
+   until spawn_finish() is called with it.  Returns false, with
+   nothing left to finish, if the thread cannot be created. */
+static bool
+spawn_start (const char *command_line, struct file *stdio[2],
+             bool inherit, struct parameters_to_start_process *arguments)
 {
   char debug_name[64];
-  int command_line_size = strlen(command_line) + 1;
   tid_t thread_id = -1;
-  int  process_id = -1;
 
   /* LOCAL variable will cease existence when function return! */
 
@@ -82,48 +367,189 @@ process_execute (const char *command_line)
         thread_current()->name,
         thread_current()->tid,
         command_line);
-  struct parameters_to_start_process arguments;
-  arguments.parent_id = thread_current()->tid;
-  /* COPY command line out of parent process memory */
-  arguments.command_line = malloc(command_line_size);
-  strlcpy(arguments.command_line, command_line, command_line_size);
-
+  wait_for_memory ();
+  arguments->phase_start = timer_ns ();
+  arguments->parent_id = process_pid ();
+  arguments->cwd = NULL;
+  if (thread_current()->cwd != NULL)
+    {
+      arguments->cwd = dir_reopen (thread_current()->cwd);
+      if (arguments->cwd == NULL)
+        return false;
+    }
+  arguments->files = NULL;
+  if (!dup_stdio (arguments, stdio))
+    {
+      dir_close (arguments->cwd);
+      return false;
+    }
+  if (inherit && !share_files (arguments))
+    {
+      close_stdio (arguments);
+      dir_close (arguments->cwd);
+      return false;
+    }
+  /* COPY command line out of parent process memory, already laid
+     out as the child's initial stack */
+  arguments->stack_page = palloc_get_page (0);
+  if (arguments->stack_page == NULL)
+    {
+      close_stdio (arguments);
+      dir_close (arguments->cwd);
+      return false;
+    }
+  arguments->stack_size = build_stack (command_line, arguments->stack_page,
+                                       &arguments->file_name);
+  if (arguments->stack_size == 0)
+    {
+      palloc_free_page (arguments->stack_page);
+      close_stdio (arguments);
+      dir_close (arguments->cwd);
+      return false;
+    }
 
-  strlcpy_first_word (debug_name, command_line, 64);
+  strlcpy (debug_name, arguments->file_name, sizeof debug_name);
   
-  sema_init(&(arguments.semaphore_process_id), 0);
+  sema_init(&(arguments->semaphore_process_id), 0);
+  process_exec_phase (EXEC_SPAWN, &arguments->phase_start);
   /* SCHEDULES function `start_process' to run (LATER) */
   thread_id = thread_create (debug_name, PRI_DEFAULT,
-                             (thread_func*)start_process, &arguments);
+                             (thread_func*)start_process, arguments);
   if(thread_id == -1)
     {
     debug("Error in thread create\n");
-    process_id = -1;
+    palloc_free_page (arguments->stack_page);
+    close_stdio (arguments);
+    dir_close (arguments->cwd);
+    return false;
     }  
-  else
+  return true;
+}
+
+/* Waits for the process started by spawn_start() with ARGUMENTS
+   to finish loading and returns its process id, or -1 if it
+   failed to load. */
+static int
+spawn_finish (struct parameters_to_start_process *arguments)
+{
+  int process_id;
+
+  sema_down(&(arguments->semaphore_process_id));
+  process_id = arguments->process_id;
+  if(process_id != -1)
     {
-      sema_down(&(arguments.semaphore_process_id));
-      process_id =arguments.process_id;
-      if(process_id != -1)
-	{
-	  debug("Returned to process_execute with valid id\n");
-	  //Add to list
-	}
+      debug("Returned to process_execute with valid id\n");
     }
-  /* AVOID bad stuff by turning off. YOU will fix this! */
-  //power_off();
 
-  
-  /* WHICH thread may still be using this right now? */
-  // free(arguments.command_line);
+  /* start_process is done with ARGUMENTS once it has signalled
+     semaphore_process_id. */
+  palloc_free_page (arguments->stack_page);
 
-  debug("%s#%d: process_execute(\"%s\") RETURNS %d\n",
+  debug("%s#%d: process_execute(...) RETURNS %d\n",
         thread_current()->name,
         thread_current()->tid,
-        command_line, process_id);
+        process_id);
+  return process_id;
+}
 
+/* Starts a new proccess by creating a new thread to run it. The
+   process is loaded from the file specified in the COMMAND_LINE and
+   started with the arguments on the COMMAND_LINE. The new thread may
+   be scheduled (and may even exit) before process_execute() returns.
+   Returns the new process's thread id, or TID_ERROR if the thread
+   cannot be created. */
+int
+process_execute (const char *command_line) 
+{
+  return process_execute_stdio (command_line, current_stdio ());
+}
+
+/* Like process_execute(), but the new process reads fd 0 from
+   STDIO[0] and writes fd 1 to STDIO[1], through copies of its
+   own, instead of inheriting the running process's.  A null file
+   means the console. */
+int
+process_execute_stdio (const char *command_line, struct file *stdio[2])
+{
+  struct parameters_to_start_process arguments;
+
+  if (!spawn_start (command_line, stdio, false, &arguments))
+    return -1;
   /* MUST be -1 if `load' in `start_process' return false */
-  return process_id;
+  return spawn_finish (&arguments);
+}
+
+/* Like process_execute(), but the new process also starts with
+   every file the running process has open, at the same fds.  The
+   files are shared, not copied: parent and child see one position
+   for each. */
+int
+process_execute_inherit (const char *command_line)
+{
+  struct parameters_to_start_process arguments;
+
+  if (!spawn_start (command_line, current_stdio (), true, &arguments))
+    return -1;
+  return spawn_finish (&arguments);
+}
+
+/* Starts a process for each of the CNT command lines in
+   COMMAND_LINES, at most SPAWN_MAX, and stores their process ids,
+   -1 for each one that failed, in PIDS.  A null command line
+   fails at once.  All the processes are started before waiting
+   for any of them to load, so they load in parallel. */
+void
+process_execute_many (const char *const *command_lines, int cnt, int *pids)
+{
+  struct parameters_to_start_process arguments[SPAWN_MAX];
+  bool started[SPAWN_MAX];
+  int i;
+
+  ASSERT (cnt >= 0 && cnt <= SPAWN_MAX);
+  for (i = 0; i < cnt; i++)
+    started[i] = (command_lines[i] != NULL
+                  && spawn_start (command_lines[i], current_stdio (), false,
+                                  &arguments[i]));
+  for (i = 0; i < cnt; i++)
+    pids[i] = started[i] ? spawn_finish (&arguments[i]) : -1;
+}
+
+/* Creates the process of the running thread, which becomes its
+   first thread, taking over STDIO as its fds 0 and 1 and FILES, if
+   nonnull, as its table of other open files.  Returns false if
+   memory is short, with STDIO and FILES closed. */
+static bool
+process_create (struct file *stdio[2], struct map *files)
+{
+  struct thread *t = thread_current ();
+  struct process *p = malloc (sizeof *p);
+
+  if (p == NULL)
+    {
+      file_close (stdio[0]);
+      file_close (stdio[1]);
+      map_close_all_files (files);
+      map_destroy (files);
+      return false;
+    }
+  p->pid = t->tid;
+  p->pagedir = NULL;
+  p->exec_file = NULL;
+  p->stdio[0] = stdio[0];
+  p->stdio[1] = stdio[1];
+  lock_init (&p->lock);
+  p->thread_cnt = 1;
+  p->exiting = false;
+  list_init (&p->threads);
+  p->open_file_table = files;
+  memset (&p->rusage, 0, sizeof p->rusage);
+  p->heap_start = p->heap_brk = NULL;
+  list_init (&p->shm_attachments);
+#ifdef VM
+  lock_init (&p->pages_lock);
+#endif
+  t->process = p;
+  return true;
 }
 
 /* A thread function that loads a user process and starts it
@@ -133,15 +559,16 @@ start_process (struct parameters_to_start_process* parameters)
 {
   /* The last argument passed to thread_create is received here... */
   struct intr_frame if_;
+  int64_t phase_start = parameters->phase_start;
+  enum intr_level old_level;
   bool success;
 
-  char file_name[64];
-  strlcpy_first_word (file_name, parameters->command_line, 64);
-  
+  process_exec_phase (EXEC_THREAD, &phase_start);
+
   debug("%s#%d: start_process(\"%s\") ENTERED\n",
         thread_current()->name,
         thread_current()->tid,
-        parameters->command_line);
+        parameters->file_name);
   
   /* Initialize interrupt frame and load executable. */
   memset (&if_, 0, sizeof if_);
@@ -149,7 +576,18 @@ start_process (struct parameters_to_start_process* parameters)
   if_.cs = SEL_UCSEG;
   if_.eflags = FLAG_IF | FLAG_MBS;
 
-  success = load (file_name, &if_.eip, &if_.esp);
+  /* The executable is looked up from the inherited working
+     directory. */
+  thread_current()->cwd = parameters->cwd;
+
+  /* A process started by another one joins its fair-share group,
+     which it inherited when its thread was created, and one
+     started by the kernel begins a group of its own. */
+  if (thread_current()->share_group == 0)
+    thread_current()->share_group = thread_current()->tid;
+  success = (process_create (parameters->stdio, parameters->files)
+             && load (parameters->file_name, &if_.eip, &if_.esp,
+                      &phase_start));
 
   debug("%s#%d: start_process(...): load returned %d\n",
         thread_current()->name,
@@ -163,17 +601,18 @@ start_process (struct parameters_to_start_process* parameters)
 	 the stack. */
 
       plist_value_t value = plist_form_process_info(parameters->parent_id);
-      thread_current()->tid = plist_insert(&process_id_table,value );
-      if(thread_current()->tid == -1)
+      value.thread = thread_current();
+      if(!plist_insert(&process_id_table, thread_current()->tid, value))
 	success = false;
       else
 	{
-	  /* A temporary solution is to modify the stack pointer to
-	     "pretend" the arguments are present on the stack. A normal
+	  /* process_execute already laid out the arguments to main
+	     exactly as they belong at the top of the stack. A normal
 	     C-function expects the stack to contain, in order, the return
 	     address, the first argument, the second argument etc. */
-	  if_.esp = createStack(parameters->command_line, if_.esp);
-	  //HACK if_.esp -= 12; /* Unacceptable solution. */
+	  if_.esp = (uint8_t *) if_.esp - parameters->stack_size;
+	  memcpy (if_.esp, parameters->stack_page + PGSIZE
+                  - parameters->stack_size, parameters->stack_size);
 
 	  /* The stack and stack pointer should be setup correct just before
 	     the process start, so this is the place to dump stack content
@@ -181,16 +620,23 @@ start_process (struct parameters_to_start_process* parameters)
     
 	  // dump_stack ( PHYS_BASE + 15, PHYS_BASE - if_.esp + 16 );
 
-
+	  process_exec_phase (EXEC_REGISTER, &phase_start);
+	  old_level = intr_disable ();
+	  exec_cnt++;
+	  intr_set_level (old_level);
 	}
-	  parameters->process_id = thread_current()->tid;
-	  sema_up(&(parameters->semaphore_process_id));
   }
 
   debug("%s#%d: start_process(\"%s\") DONE\n",
         thread_current()->name,
         thread_current()->tid,
-        parameters->command_line);
+        parameters->file_name);
+
+  /* Report back exactly once. PARAMETERS lives on the parent's
+     stack and holds memory the parent frees, so it must not be
+     touched after sema_up. */
+  parameters->process_id = success ? thread_current()->tid : -1;
+  sema_up(&(parameters->semaphore_process_id));
 
   /* If load fail, quit. Load may fail for several reasons.
      Some simple examples:
@@ -201,8 +647,6 @@ start_process (struct parameters_to_start_process* parameters)
   if ( ! success )
     {
       debug("# problem with start process\n");
-      parameters->process_id = -1;
-      sema_up(&(parameters->semaphore_process_id));
       thread_exit ();
     }
   /* Start the user process by simulating a return from an interrupt,
@@ -235,6 +679,7 @@ process_wait (int child_id)
   if(plist_wait_for_pid(&process_id_table,child_id))
   {
     status = plist_get_exit_status(&process_id_table,child_id);
+    plist_release_child(&process_id_table,child_id);
   }
   
   debug("%s#%d: process_wait(%d) RETURNS %d\n",
@@ -243,6 +688,159 @@ process_wait (int child_id)
  
 }
 
+/* As process_wait(), but also stores the resources used by the
+   child in *RU, or zeros if it returns -1 without waiting.  Unlike
+   process_wait(), waits for the child to have finished exiting,
+   since its usage is only complete then. */
+int
+process_wait_rusage (int child_id, struct rusage *ru)
+{
+  int status = -1;
+
+  memset (ru, 0, sizeof *ru);
+  if (plist_wait_for_pid (&process_id_table, child_id))
+    {
+      status = plist_get_exit_status (&process_id_table, child_id);
+      plist_get_rusage (&process_id_table, child_id, ru);
+      plist_release_child (&process_id_table, child_id);
+    }
+  return status;
+}
+
+/* Waits for any child of the current process that nobody else is
+   waiting for to die, and stores its exit status in *STATUS.
+   Returns the child's process id, or -1 without waiting if there
+   is no such child. */
+int
+process_wait_any (int *status)
+{
+  return plist_wait_any (&process_id_table, status);
+}
+
+static void start_thread (struct user_thread *) NO_RETURN;
+
+/* Starts a new thread in the current process, running user code
+   at EIP with stack pointer ESP.  The thread shares the process's
+   address space and open files, and starts in the creator's
+   working directory.  Returns its tid, which process_thread_join()
+   takes, or TID_ERROR if the thread cannot be created or the
+   process is exiting. */
+tid_t
+process_thread_create (void (*eip) (void), void *esp)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+  struct user_thread *ut;
+  tid_t tid;
+
+  ut = malloc (sizeof *ut);
+  if (ut == NULL)
+    return TID_ERROR;
+  ut->tid = TID_ERROR;
+  ut->joined = false;
+  sema_init (&ut->done, 0);
+  ut->process = p;
+  ut->eip = eip;
+  ut->esp = esp;
+  ut->cwd = NULL;
+  if (cur->cwd != NULL && (ut->cwd = dir_reopen (cur->cwd)) == NULL)
+    {
+      free (ut);
+      return TID_ERROR;
+    }
+
+  /* Counted before it exists, so that the process cannot go away
+     before the new thread gets going. */
+  lock_acquire (&p->lock);
+  if (p->exiting)
+    {
+      lock_release (&p->lock);
+      dir_close (ut->cwd);
+      free (ut);
+      return TID_ERROR;
+    }
+  p->thread_cnt++;
+  list_push_back (&p->threads, &ut->elem);
+  lock_release (&p->lock);
+
+  tid = thread_create (cur->name, PRI_DEFAULT,
+                       (thread_func *) start_thread, ut);
+
+  lock_acquire (&p->lock);
+  if (tid == TID_ERROR)
+    {
+      p->thread_cnt--;
+      list_remove (&ut->elem);
+      dir_close (ut->cwd);
+      free (ut);
+    }
+  else
+    ut->tid = tid;
+  lock_release (&p->lock);
+  return tid;
+}
+
+/* A thread function that starts a thread created by
+   process_thread_create() running in user mode. */
+static void
+start_thread (struct user_thread *ut)
+{
+  struct thread *t = thread_current ();
+  struct intr_frame if_;
+
+  t->process = ut->process;
+  t->pagedir = ut->process->pagedir;
+  t->user_thread = ut;
+  t->cwd = ut->cwd;
+  process_activate ();
+  if (process_exiting ())
+    thread_exit ();
+
+  memset (&if_, 0, sizeof if_);
+  if_.gs = if_.fs = if_.es = if_.ds = if_.ss = SEL_UDSEG;
+  if_.cs = SEL_UCSEG;
+  if_.eflags = FLAG_IF | FLAG_MBS;
+  if_.eip = ut->eip;
+  if_.esp = ut->esp;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Waits for thread TID of the current process, started by
+   process_thread_create(), to exit.  Returns 0 once it has, or -1
+   at once if TID is not such a thread or is already being
+   joined. */
+int
+process_thread_join (tid_t tid)
+{
+  struct process *p = thread_current ()->process;
+  struct user_thread *ut = NULL;
+  struct list_elem *e;
+
+  lock_acquire (&p->lock);
+  for (e = list_begin (&p->threads); e != list_end (&p->threads);
+       e = list_next (e))
+    {
+      struct user_thread *u = list_entry (e, struct user_thread, elem);
+      if (u->tid == tid && !u->joined && tid != thread_tid ())
+        {
+          ut = u;
+          ut->joined = true;
+          break;
+        }
+    }
+  lock_release (&p->lock);
+  if (ut == NULL)
+    return -1;
+
+  sema_down (&ut->done);
+  lock_acquire (&p->lock);
+  list_remove (&ut->elem);
+  lock_release (&p->lock);
+  free (ut);
+  return 0;
+}
+
 /* Free the current process's resources. This function is called
    automatically from thread_exit() to make sure cleanup of any
    process resources is always done. That is correct behaviour. But
@@ -255,16 +853,114 @@ process_wait (int child_id)
    is detected.
 */
   
+/* Adds the counters of thread T to RU. */
+static void
+add_thread_usage (struct rusage *ru, const struct thread *t)
+{
+  int i;
+
+  ru->user_ticks += t->user_ticks;
+  ru->kernel_ticks += t->kernel_ticks;
+  ru->voluntary_switches += t->voluntary_switches;
+  ru->involuntary_switches += t->involuntary_switches;
+  for (i = 0; i < FAULT_CLASS_CNT; i++)
+    ru->faults[i] += t->fault_cnt[i];
+  ru->disk_read_sectors += t->io_read_bytes / DISK_SECTOR_SIZE;
+  ru->disk_write_sectors += t->io_write_bytes / DISK_SECTOR_SIZE;
+}
+
+/* Prints RU, the resources used by process NAME, in a few lines
+   after its exit status. */
+static void
+print_rusage (const char *name, const struct rusage *ru)
+{
+  int i;
+
+  printf ("%s: rusage: %lld user + %lld kernel ticks, "
+          "%lld voluntary + %lld involuntary switches\n",
+          name, ru->user_ticks, ru->kernel_ticks,
+          ru->voluntary_switches, ru->involuntary_switches);
+  printf ("%s: rusage: faults %lld file, %lld zero, %lld swap, "
+          "%lld stack, %lld cow, %lld invalid\n",
+          name, ru->faults[FAULT_FILE], ru->faults[FAULT_ZERO],
+          ru->faults[FAULT_SWAP], ru->faults[FAULT_STACK],
+          ru->faults[FAULT_COW], ru->faults[FAULT_INVALID]);
+  printf ("%s: rusage: %lld bytes read, %lld written, "
+          "%lld+%lld disk sectors, %lld pages resident at most\n",
+          name, ru->read_bytes, ru->write_bytes, ru->disk_read_sectors,
+          ru->disk_write_sectors, ru->max_resident);
+  printf ("%s: rusage: syscalls", name);
+  for (i = 0; i < STATS_SYSCALLS; i++)
+    if (ru->syscalls[i] > 0)
+      printf (" %s %lld", syscall_name (i), ru->syscalls[i]);
+  printf ("\n");
+}
+
+/* Takes the current thread out of its process, if it has one.
+   Returns true if it was the process's last thread, so that the
+   process itself is to be cleaned up, false if other threads
+   still use it. */
+static bool
+leave_process (void)
+{
+  struct thread *cur = thread_current ();
+  struct process *p = cur->process;
+  bool last;
+
+  if (p == NULL)
+    return true;
+
+  lock_acquire (&p->lock);
+  last = --p->thread_cnt == 0;
+  add_thread_usage (&p->rusage, cur);
+  if (cur->user_thread != NULL)
+    sema_up (&cur->user_thread->done);
+  lock_release (&p->lock);
+
+  if (!last)
+    {
+      /* Threads are named after their process, so this one does
+         not report an exit of its own.  Its page directory lives
+         on in the other threads, so it may stay loaded. */
+      if (cur->tid == p->pid)
+        plist_set_thread (&process_id_table, p->pid, NULL);
+      cur->process = NULL;
+      cur->pagedir = NULL;
+    }
+  return last;
+}
+
+/* Frees process P and the join records of threads nobody joined.
+   P's last thread has exited. */
+static void
+free_process (struct process *p)
+{
+  map_close_all_files (p->open_file_table);
+  map_destroy (p->open_file_table);
+  file_close (p->stdio[0]);
+  file_close (p->stdio[1]);
+  while (!list_empty (&p->threads))
+    free (list_entry (list_pop_front (&p->threads),
+                      struct user_thread, elem));
+  free (p);
+}
+
 void
 process_cleanup (void)
 {
   struct thread  *cur = thread_current ();
+  struct process *p   = cur->process;
   uint32_t       *pd  = cur->pagedir;
-  int status = plist_get_exit_status(&process_id_table,cur->tid);
-  //int status = plist_get_exit_status(&process_id_table,cur->tid);
+  tid_t           pid = p != NULL ? p->pid : cur->tid;
+  int status;
   
   debug("%s#%i: process_cleanup() ENTERED\n", cur->name, cur->tid);
-  
+
+  dir_close (cur->cwd);
+  cur->cwd = NULL;
+  if (!leave_process ())
+    return;
+
   /* Later tests DEPEND on this output to work correct. You will have
    * to find the actual exit status in your process list. It is
    * important to do this printf BEFORE you tell the parent process
@@ -272,10 +968,19 @@ process_cleanup (void)
    * that may sometimes poweroff as soon as process_wait() returns,
    * possibly before the prontf is completed.)
    */
+  status = plist_get_exit_status(&process_id_table, pid);
   printf("%s: exit(%i)\n", thread_name(), status);
+  if (p != NULL)
+    {
+      if (pd != NULL)
+        p->rusage.max_resident = pagedir_max_resident (pd);
+      if (process_rusage_report)
+        print_rusage (thread_name (), &p->rusage);
+      plist_set_rusage (&process_id_table, pid, &p->rusage);
+    }
 
-  plist_remove(&process_id_table, cur->tid);
-  plist_clean(&process_id_table);
+  plist_set_thread(&process_id_table, pid, NULL);
+  plist_remove(&process_id_table, pid);
   // plist_print_list(&process_id_table);
   
   
@@ -290,10 +995,23 @@ process_cleanup (void)
          directory before destroying the process's page
          directory, or our active page directory will be one
          that's been freed (and cleared). */
-      cur->pagedir = NULL;
+      shm_detach_all ();
+      kinfo_unmap ();
+#ifdef VM
+      mmap_unmap_all ();
+      page_table_destroy ();
+#endif
+      file_close (p->exec_file);
+      p->exec_file = NULL;
+      p->pagedir = cur->pagedir = NULL;
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }  
+  if (p != NULL)
+    {
+      free_process (p);
+      cur->process = NULL;
+    }
   //debug("%s#%i: process_cleanup() DONE with status %i\n",
   //      cur->name, cur->tid, status);
 }
@@ -306,119 +1024,12 @@ process_activate (void)
 {
   struct thread *t = thread_current ();
 
-  /* Activate thread's page tables. */
-  pagedir_activate (t->pagedir);
+  /* Activate thread's page tables, unless they are already
+     loaded.  A kernel thread keeps whichever are. */
+  pagedir_switch (t->pagedir);
 
   /* Set thread's kernel stack for use in processing
-     interrupts. */
+     interrupts.  Every thread has its own, so this cannot be
+     skipped, but it is only a store. */
   tss_update ();
 }
-
-void* createStack(const char * command_line, void* stack_top)
-{
-  /* Variable "esp" stores an address, and at the memory loaction
-   * pointed out by that address a "struct main_args" is found.
-   * That is: "esp" is a pointer to "struct main_args" */
-  void* esp;
-  int argc;
-  int total_size;
-  int line_size_nd;
-  int line_size;
-  /* "cmd_line_on_stack" and "ptr_save" are variables that each store
-     * one address, and at that address (the first) char (of a possible
-    * sequence) can be found. */
-  char* cmd_line_on_stack;
-  char* ptr_save;
-  int i = 0;
-  
-  /* calculate the bytes needed to store the command_line */
-  line_size = 1; 
-  const char* c = command_line;
-  while(*(c++) != '\0')
-    {
-      line_size++;
-    }
-  /* round up to make it even divisible by 4 */
-  line_size_nd = line_size;
-  line_size += line_size % 4 == 0 ? 0: 4 - line_size % 4;
-  /* calculate how many words the command_line contain */
-  argc = 0;
-  c = command_line;
-  char prev = ' ';
-  while(*c != '\0')
-    {
-      
-      if(*c != ' ' && prev == ' ')
-   	argc++;
-      prev = *(c++);
-	
-    }
-  /* calculate the size of each word */
-  int argv_size[argc];
-  int tmp = 0;
-  c = command_line;
-  i = 0;
-  while(i < argc)
-    {
-      if(*c == ' ' || *(c) == '\0')
-	{
-	  if(tmp != 0)
-	    {
-	      argv_size[i++] = tmp;
-	      tmp = 0;
-	    }
-	}
-      else
-	tmp++;
-      c++;
-    }
-  /* calculate the size needed on our simulated stack */
-  total_size = line_size + argc*4 + 16;
-  /* calculate where the final stack top will be located */
-   esp =  stack_top - (total_size);
-  /* setup return address and argument count */
-  //esp->ret = 0;
-  //esp->argc = argc;
-  
-  /* calculate where in the memory the words is stored */
-  cmd_line_on_stack = stack_top - line_size;
-
-  /* calculate where in the memory the argv array starts */
-  //esp->argv = (cmd_line_on_stack - (argc+2)*4);
-
-  /* copy the command_line to where it should be in the stack */
-  int*address_of_null[argc+1];
-  int temp_index = 1;
-  address_of_null[0] = 0;
-  int tmp_ptr = 0;
-  prev = 0;
-  for(i = 0; i<= line_size; i++)
-    {
-      char ch = command_line[ (line_size - i)];
-      if(ch != ' ')
-	tmp_ptr = stack_top -i;
-      if((ch == ' ') && ( line_size - i < line_size_nd))
-	{
-	  ch = '\0';
-	  if(prev != '\0')
-	    address_of_null[temp_index++] = tmp_ptr;
-	}
-      (*(char*)(stack_top-i)) = ch; //might need to filter ' ' or '\0' or '.'
-      prev = ch;
-    }
-  address_of_null[argc] = tmp_ptr;
-
-  /* build argv array and insert null-characters after each word */
-  for(i = 1; i<= argc+1; i++)
-    {
-      *(int*)(cmd_line_on_stack-i*4) = address_of_null[i-1];
-    }
-
-  *(int*)(cmd_line_on_stack - (argc+2)*4) = cmd_line_on_stack - (argc+1)*4;
-
-  *(cmd_line_on_stack - (argc+3)*4) = argc;
-
-  //*(cmd_line_on_stack - (argc+4)*4) = esp->ret;
-  *(cmd_line_on_stack - (argc+4)*4) = 0;
-  return esp; /* the new stack top */
-}
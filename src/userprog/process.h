@@ -1,15 +1,83 @@
 #ifndef USERPROG_PROCESS_H
 #define USERPROG_PROCESS_H
 
+#include <list.h>
+#include <ohash.h>
+#include <rusage.h>
+#include <stats.h>
+#include "threads/synch.h"
 #include "threads/thread.h"
+
+/* Most command lines one process_execute_many() call starts. */
+#define SPAWN_MAX 16
+
+/* A user process: the state shared by its threads.  The first
+   thread is started by process_execute(), and its tid is the
+   process's pid.  More are started by process_thread_create().
+   Each thread points to its process with its `process' member
+   and keeps a copy of PAGEDIR in its own `pagedir' member.  The
+   last thread to exit frees the process. */
+struct process
+  {
+    tid_t pid;                          /* Process identifier. */
+    uint32_t *pagedir;                  /* Page directory. */
+    struct file *exec_file;             /* Executable, open while running. */
+    struct file *stdio[2];              /* Files read and written as fds 0
+                                           and 1, null for the console. */
+
+    /* Protected by LOCK. */
+    struct lock lock;
+    int thread_cnt;                     /* Threads that have not exited. */
+    bool exiting;                       /* Set once by process_exit(). */
+    struct list threads;                /* Joinable threads. */
+    struct map *open_file_table;        /* Open files, null until the first open. */
+    struct rusage rusage;               /* Usage of threads that have exited.
+                                           Syscall and byte counts are
+                                           added without LOCK. */
+
+    /* Owned by userprog/heap.c, protected by LOCK. */
+    uint8_t *heap_start;                /* Start of the heap. */
+    uint8_t *heap_brk;                  /* Program break. */
+
+    /* Owned by userprog/shm.c. */
+    struct list shm_attachments;        /* Shared memory segments. */
+#ifdef VM
+    /* Owned by vm/page.c. */
+    struct lock pages_lock;             /* Protects PAGES, FAULT_AROUND*. */
+    struct ohash pages;                 /* Supplemental page table. */
+    size_t fault_around;                /* Pages to map after a fault. */
+    void *fault_around_base;            /* Last pages so mapped... */
+    size_t fault_around_cnt;            /* ...and how many, if not judged. */
+
+    /* Owned by vm/mmap.c, protected by LOCK. */
+    struct list mappings;               /* Memory-mapped files. */
+    int next_mapid;                     /* Next mapping identifier. */
+#endif
+  };
+
+/* Print each process's resource usage after its exit status?
+   Set by the -rusage kernel option. */
+extern bool process_rusage_report;
+
 void process_init (void);
 void process_print_list (void);
 void process_exit (int status);
 tid_t process_execute (const char *file_name);
+tid_t process_execute_stdio (const char *file_name, struct file *stdio[2]);
+tid_t process_execute_inherit (const char *file_name);
 int process_wait (tid_t);
+void process_execute_many (const char *const *command_lines, int cnt,
+                           int *pids);
+int process_wait_any (int *status);
+int process_wait_rusage (tid_t, struct rusage *);
 void process_cleanup (void);
 void process_activate (void);
-void* createStack(const char*, void*);
+tid_t process_pid (void);
+bool process_exiting (void);
+tid_t process_thread_create (void (*eip) (void), void *esp);
+int process_thread_join (tid_t);
+void process_exec_phase (enum exec_phase, int64_t *since);
+void process_get_stats (struct stats *);
 /* This is unacceptable solutions. */
 /*#define INFINITE_WAIT() for ( ; ; ) thread_yield()
 #define BUSY_WAIT(n)       \
@@ -0,0 +1,342 @@
+#include "userprog/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "threads/cpu.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
+
+/* Shared memory segments.  A segment's pages come from the user
+   pool and are mapped straight into the page directory of every
+   process that attaches it, outside any supplemental page table,
+   so they are never evicted.  A segment lives until the last
+   process detaches it.
+
+   A segment made of whole 4 MB pieces, created at a 4 MB aligned
+   address on a CPU with CR4_PSE, takes its memory as physically
+   aligned 4 MB blocks when the user pool has them, so that each
+   piece can be mapped by a single PDE and cost one TLB entry
+   rather than 1024.  Each process that attaches it at a 4 MB
+   aligned address gets the 4 MB mappings; elsewhere it gets 4 kB
+   ones, from the same pages. */
+
+/* Pages in a 4 MB page. */
+#define LARGE_PAGES (PTSPAN / PGSIZE)
+
+/* A shared memory segment. */
+struct shm_segment
+  {
+    struct list_elem elem;      /* Element in SEGMENTS. */
+    int id;                     /* Identifier. */
+    int attach_cnt;             /* Number of attachments. */
+    size_t page_cnt;            /* Number of pages. */
+    bool large;                 /* Made of aligned 4 MB blocks? */
+    void *kpages[];             /* Kernel addresses of the pages. */
+  };
+
+/* A segment attached to a process. */
+struct shm_attachment
+  {
+    struct list_elem elem;      /* Element in process's shm_attachments. */
+    struct shm_segment *seg;    /* Segment. */
+    uint8_t *base;              /* Where it is mapped. */
+    bool large;                 /* Mapped with 4 MB pages? */
+  };
+
+/* All segments.  SHM_LOCK protects it, each segment's ATTACH_CNT,
+   and NEXT_ID. */
+static struct list segments;
+static struct lock shm_lock;
+static int next_id;
+
+/* Initializes the shared memory module. */
+void
+shm_init (void)
+{
+  list_init (&segments);
+  lock_init (&shm_lock);
+  next_id = 0;
+}
+
+/* Returns true if user page UPAGE is in use in the current
+   process. */
+static bool
+page_in_use (const void *upage)
+{
+#ifdef VM
+  return page_present (upage);
+#else
+  return pagedir_get_page (thread_current ()->pagedir, upage) != NULL;
+#endif
+}
+
+/* Maps large segment SEG into page directory PD at BASE, which
+   must be 4 MB aligned, with 4 MB pages.  Returns false, and maps
+   nothing, if any of its PDEs is in use. */
+static bool
+map_large (uint32_t *pd, struct shm_segment *seg, uint8_t *base)
+{
+  size_t i;
+
+  for (i = 0; i < seg->page_cnt; i += LARGE_PAGES)
+    if (!pagedir_set_large (pd, base + i * PGSIZE, seg->kpages[i], true))
+      {
+        while (i > 0)
+          {
+            i -= LARGE_PAGES;
+            pagedir_clear_large (pd, base + i * PGSIZE);
+          }
+        return false;
+      }
+  return true;
+}
+
+/* Maps SEG into the current process at ADDR, which must be
+   page-aligned and not null, and records the attachment.
+   SHM_LOCK must be held.  Returns false, and maps nothing, if
+   that would overlap pages in use or memory is short. */
+static bool
+attach (struct shm_segment *seg, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct shm_attachment *a;
+  uint8_t *base = addr;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&shm_lock));
+
+  if (base == NULL || pg_ofs (base) != 0)
+    return false;
+  for (i = 0; i < seg->page_cnt; i++)
+    if (!is_user_vaddr (base + i * PGSIZE)
+        || page_in_use (base + i * PGSIZE))
+      return false;
+
+  a = malloc (sizeof *a);
+  if (a == NULL)
+    return false;
+  a->large = (seg->large && ((uintptr_t) base & (PTSPAN - 1)) == 0
+              && map_large (t->pagedir, seg, base));
+  if (!a->large
+      && !pagedir_map_range (t->pagedir, base, seg->kpages, seg->page_cnt,
+                             true))
+    {
+      free (a);
+      return false;
+    }
+
+  a->seg = seg;
+  a->base = base;
+  list_push_back (&t->process->shm_attachments, &a->elem);
+  seg->attach_cnt++;
+  return true;
+}
+
+/* Frees SEG's first PAGE_CNT pages. */
+static void
+free_pages (struct shm_segment *seg, size_t page_cnt)
+{
+  size_t i;
+
+  if (seg->large)
+    for (i = 0; i < page_cnt; i += LARGE_PAGES)
+      palloc_free_multiple (seg->kpages[i], LARGE_PAGES);
+  else
+    for (i = 0; i < page_cnt; i++)
+      palloc_free_page (seg->kpages[i]);
+}
+
+/* Frees SEG and its pages. */
+static void
+free_segment (struct shm_segment *seg)
+{
+  free_pages (seg, seg->page_cnt);
+  free (seg);
+}
+
+/* Gives SEG aligned 4 MB blocks of zeroed pages.  Returns false,
+   with none allocated, if the user pool is short of them. */
+static bool
+alloc_large (struct shm_segment *seg)
+{
+  size_t i, j;
+
+  for (i = 0; i < seg->page_cnt; i += LARGE_PAGES)
+    {
+      uint8_t *block = palloc_get_aligned (PAL_USER | PAL_ZERO, LARGE_PAGES);
+      if (block == NULL)
+        {
+          free_pages (seg, i);
+          return false;
+        }
+      for (j = 0; j < LARGE_PAGES; j++)
+        seg->kpages[i + j] = block + j * PGSIZE;
+    }
+  return true;
+}
+
+/* Gives SEG zeroed pages one at a time.  Returns false, with none
+   allocated, if memory is short. */
+static bool
+alloc_small (struct shm_segment *seg)
+{
+  size_t i;
+
+  for (i = 0; i < seg->page_cnt; i++)
+    {
+      seg->kpages[i] = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (seg->kpages[i] == NULL)
+        {
+          free_pages (seg, i);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Unmaps attachment A from the current process and frees it,
+   along with its segment if this was the last attachment.
+   SHM_LOCK must be held. */
+static void
+detach (struct shm_attachment *a)
+{
+  struct thread *t = thread_current ();
+  struct shm_segment *seg = a->seg;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&shm_lock));
+
+  if (a->large)
+    for (i = 0; i < seg->page_cnt; i += LARGE_PAGES)
+      pagedir_clear_large (t->pagedir, a->base + i * PGSIZE);
+  else
+    pagedir_clear_range (t->pagedir, a->base, seg->page_cnt);
+  list_remove (&a->elem);
+  free (a);
+
+  if (--seg->attach_cnt == 0)
+    {
+      list_remove (&seg->elem);
+      free_segment (seg);
+    }
+}
+
+/* Creates a zeroed shared memory segment of SIZE bytes, rounded up
+   to whole pages, and attaches it to the current process at ADDR.
+   Returns the segment's identifier, which other processes pass to
+   shm_attach(), or -1 if SIZE is 0 or too big, ADDR is not
+   page-aligned, the segment would overlap pages in use, or memory
+   is short. */
+int
+shm_create (size_t size, void *addr)
+{
+  struct shm_segment *seg;
+  size_t page_cnt = DIV_ROUND_UP (size, PGSIZE);
+  int id;
+
+  if (page_cnt == 0 || page_cnt > SHM_MAX_PAGES)
+    return -1;
+  seg = malloc (sizeof *seg + page_cnt * sizeof *seg->kpages);
+  if (seg == NULL)
+    return -1;
+  seg->attach_cnt = 0;
+  seg->page_cnt = page_cnt;
+  seg->large = ((cpu_features () & CPUID_PSE) != 0
+                && page_cnt % LARGE_PAGES == 0
+                && ((uintptr_t) addr & (PTSPAN - 1)) == 0);
+  if (seg->large && !alloc_large (seg))
+    seg->large = false;
+  if (!seg->large && !alloc_small (seg))
+    {
+      free (seg);
+      return -1;
+    }
+
+  lock_acquire (&shm_lock);
+  if (!attach (seg, addr))
+    {
+      lock_release (&shm_lock);
+      free_segment (seg);
+      return -1;
+    }
+  id = seg->id = next_id++;
+  list_push_back (&segments, &seg->elem);
+  lock_release (&shm_lock);
+  return id;
+}
+
+/* Attaches the existing segment ID to the current process at ADDR.
+   Returns false if there is no such segment, ADDR is not
+   page-aligned, the segment would overlap pages in use, or memory
+   is short. */
+bool
+shm_attach (int id, void *addr)
+{
+  struct list_elem *e;
+  bool success = false;
+
+  lock_acquire (&shm_lock);
+  for (e = list_begin (&segments); e != list_end (&segments);
+       e = list_next (e))
+    {
+      struct shm_segment *seg = list_entry (e, struct shm_segment, elem);
+      if (seg->id == id)
+        {
+          success = attach (seg, addr);
+          break;
+        }
+    }
+  lock_release (&shm_lock);
+  return success;
+}
+
+/* Detaches the segment attached at ADDR from the current process.
+   Returns false if no segment is attached there. */
+bool
+shm_detach (void *addr)
+{
+  struct list *attachments = &thread_current ()->process->shm_attachments;
+  struct list_elem *e;
+  bool success = false;
+
+  lock_acquire (&shm_lock);
+  for (e = list_begin (attachments); e != list_end (attachments);
+       e = list_next (e))
+    {
+      struct shm_attachment *a = list_entry (e, struct shm_attachment, elem);
+      if (a->base == addr)
+        {
+          detach (a);
+          success = true;
+          break;
+        }
+    }
+  lock_release (&shm_lock);
+  return success;
+}
+
+/* Detaches every segment from the current process.  Must be called
+   by its last thread, before its page directory is destroyed, which would otherwise
+   free the shared pages. */
+void
+shm_detach_all (void)
+{
+  struct list *attachments = &thread_current ()->process->shm_attachments;
+
+  if (list_empty (attachments))
+    return;
+  lock_acquire (&shm_lock);
+  while (!list_empty (attachments))
+    detach (list_entry (list_front (attachments),
+                        struct shm_attachment, elem));
+  lock_release (&shm_lock);
+}
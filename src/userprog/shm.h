@@ -0,0 +1,16 @@
+#ifndef USERPROG_SHM_H
+#define USERPROG_SHM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Most pages in one shared memory segment: 16 MB. */
+#define SHM_MAX_PAGES 4096
+
+void shm_init (void);
+int shm_create (size_t size, void *addr);
+bool shm_attach (int id, void *addr);
+bool shm_detach (void *addr);
+void shm_detach_all (void);
+
+#endif /* userprog/shm.h */
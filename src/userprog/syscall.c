@@ -1,4 +1,13 @@
+#include <console.h>
+#include <disk-stats.h>
+#include <fcntl.h>
+#include <iovec.h>
+#include <limits.h>
+#include <poll.h>
+#include <rusage.h>
+#include <stats.h>
 #include <stdio.h>
+#include <syscall-batch.h>
 #include <syscall-nr.h>
 #include "userprog/syscall.h"
 #include "threads/interrupt.h"
@@ -6,212 +15,1583 @@
 
 /* header files you probably need, they are not used yet */
 #include <string.h>
+#include <inttypes.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
+#include "threads/io.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
 #include "threads/vaddr.h"
+#include "threads/cpu.h"
 #include "threads/init.h"
+#include "threads/pollwait.h"
+#include "threads/trace.h"
 #include "userprog/pagedir.h"
+#include "userprog/exception.h"
 #include "userprog/process.h"
 #include "userprog/flist.h"
-#include "devices/input.h"
+#include "userprog/futex.h"
+#include "userprog/heap.h"
+#include "userprog/kinfo.h"
+#include "userprog/shm.h"
+#include "userprog/tss.h"
+#include "devices/disk.h"
+#include "devices/kbd.h"
+#include "devices/tty.h"
+#include "devices/timer.h"
+#ifdef VM
+#include "vm/frame.h"
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
+
+/* Most arguments any system call takes. */
+#define SYSCALL_ARG_MAX 4
+
+/* Subsystem of this file's debug() messages. */
+#define DEBUG_SUBSYS LOG_SYSCALL
+
+/* A system call handler.  ARGS holds the call's arguments,
+   already copied out of the user stack.  The return value, if
+   any, goes in F->eax. */
+typedef void syscall_func (struct intr_frame *f, const int32_t *args);
+
+/* One entry in the system call table. */
+struct syscall
+  {
+    syscall_func *func;         /* Handler, or null if not implemented. */
+    int argc;                   /* Number of argument words. */
+    const char *name;           /* Name for statistics. */
+  };
+
+static syscall_func sys_halt, sys_exit, sys_exec, sys_wait, sys_create,
+  sys_remove, sys_open, sys_filesize, sys_read, sys_write, sys_seek,
+  sys_tell, sys_close, sys_sleep, sys_plist, sys_pipe, sys_readv,
+  sys_writev, sys_copy, sys_pread, sys_pwrite, sys_submit, sys_spawn_many,
+  sys_wait_any, sys_futex_wait, sys_futex_wake, sys_shm_create,
+  sys_shm_attach, sys_shm_detach, sys_poll, sys_chdir, sys_mkdir,
+  sys_readdir, sys_isdir, sys_inumber, sys_open_flags, sys_trace_dump,
+  sys_clock_ns, sys_disk_stats, sys_stats, sys_sbrk, sys_thread_create,
+  sys_thread_join, sys_thread_exit, sys_exec_stdio, sys_dup, sys_dup2,
+  sys_exec_inherit, sys_wait_rusage;
+#ifdef VM
+static syscall_func sys_mmap, sys_munmap;
+#else
+#define sys_mmap NULL
+#define sys_munmap NULL
+#endif
+
+/* System calls, indexed by number.  All system calls have a name
+   such as SYS_READ defined as an enum type, see `lib/syscall-nr.h'.
+   Calls that are not implemented have a null FUNC but keep their
+   argument count. */
+static const struct syscall syscall_table[SYS_NUMBER_OF_CALLS] =
+  {
+    /* basic calls */
+    [SYS_HALT]     = { sys_halt,     0, "halt" },
+    [SYS_EXIT]     = { sys_exit,     1, "exit" },
+    [SYS_EXEC]     = { sys_exec,     1, "exec" },
+    [SYS_WAIT]     = { sys_wait,     1, "wait" },
+    [SYS_CREATE]   = { sys_create,   2, "create" },
+    [SYS_REMOVE]   = { sys_remove,   1, "remove" },
+    [SYS_OPEN]     = { sys_open,     1, "open" },
+    [SYS_FILESIZE] = { sys_filesize, 1, "filesize" },
+    [SYS_READ]     = { sys_read,     3, "read" },
+    [SYS_WRITE]    = { sys_write,    3, "write" },
+    [SYS_SEEK]     = { sys_seek,     2, "seek" },
+    [SYS_TELL]     = { sys_tell,     1, "tell" },
+    [SYS_CLOSE]    = { sys_close,    1, "close" },
+    /* virtual memory, null without VM */
+    [SYS_MMAP]     = { sys_mmap,     2, "mmap" },
+    [SYS_MUNMAP]   = { sys_munmap,   1, "munmap" },
+    /* directories */
+    [SYS_CHDIR]    = { sys_chdir,    1, "chdir" },
+    [SYS_MKDIR]    = { sys_mkdir,    1, "mkdir" },
+    [SYS_READDIR]  = { sys_readdir,  2, "readdir" },
+    [SYS_ISDIR]    = { sys_isdir,    1, "isdir" },
+    [SYS_INUMBER]  = { sys_inumber,  1, "inumber" },
+    /* extended */
+    [SYS_SLEEP]    = { sys_sleep,    1, "sleep" },
+    [SYS_PLIST]    = { sys_plist,    0, "plist" },
+    [SYS_PIPE]     = { sys_pipe,     1, "pipe" },
+    [SYS_READV]    = { sys_readv,    3, "readv" },
+    [SYS_WRITEV]   = { sys_writev,   3, "writev" },
+    [SYS_COPY]     = { sys_copy,     3, "copy" },
+    [SYS_PREAD]    = { sys_pread,    4, "pread" },
+    [SYS_PWRITE]   = { sys_pwrite,   4, "pwrite" },
+    [SYS_SUBMIT]   = { sys_submit,   2, "submit" },
+    [SYS_SPAWN_MANY] = { sys_spawn_many, 3, "spawn_many" },
+    [SYS_WAIT_ANY] = { sys_wait_any, 1, "wait_any" },
+    [SYS_FUTEX_WAIT] = { sys_futex_wait, 2, "futex_wait" },
+    [SYS_FUTEX_WAKE] = { sys_futex_wake, 2, "futex_wake" },
+    [SYS_SHM_CREATE] = { sys_shm_create, 2, "shm_create" },
+    [SYS_SHM_ATTACH] = { sys_shm_attach, 2, "shm_attach" },
+    [SYS_SHM_DETACH] = { sys_shm_detach, 1, "shm_detach" },
+    [SYS_POLL]     = { sys_poll,     3, "poll" },
+    [SYS_OPEN_FLAGS] = { sys_open_flags, 2, "open_flags" },
+    [SYS_TRACE_DUMP] = { sys_trace_dump, 0, "trace_dump" },
+    [SYS_CLOCK_NS] = { sys_clock_ns, 1, "clock_ns" },
+    [SYS_DISK_STATS] = { sys_disk_stats, 1, "disk_stats" },
+    [SYS_STATS] = { sys_stats, 2, "stats" },
+    [SYS_SBRK] = { sys_sbrk, 1, "sbrk" },
+    [SYS_THREAD_CREATE] = { sys_thread_create, 2, "thread_create" },
+    [SYS_THREAD_JOIN] = { sys_thread_join, 1, "thread_join" },
+    [SYS_THREAD_EXIT] = { sys_thread_exit, 0, "thread_exit" },
+    [SYS_EXEC_STDIO] = { sys_exec_stdio, 3, "exec_stdio" },
+    [SYS_DUP] = { sys_dup, 1, "dup" },
+    [SYS_DUP2] = { sys_dup2, 2, "dup2" },
+    [SYS_EXEC_INHERIT] = { sys_exec_inherit, 1, "exec_inherit" },
+    [SYS_WAIT_RUSAGE] = { sys_wait_rusage, 2, "wait_rusage" },
+  };
+
+/* Per-call statistics.  Updated without a lock, so counts from
+   concurrent processes may occasionally be lost. */
+static long long syscall_calls[SYS_NUMBER_OF_CALLS];
+static uint64_t syscall_cycles[SYS_NUMBER_OF_CALLS];
+
+/* System calls that came in through SYSENTER. */
+static long long sysenter_cnt;
+
+/* Model-specific registers for SYSENTER.  See [IA32-v3a] 5.8.7
+   "Performing Fast Calls to System Procedures with the SYSENTER
+   and SYSEXIT Instructions". */
+#define MSR_SYSENTER_CS 0x174   /* Kernel CS; SS, and user CS, SS follow. */
+#define MSR_SYSENTER_ESP 0x175  /* Kernel ESP. */
+#define MSR_SYSENTER_EIP 0x176  /* Kernel entry point. */
 
 static void syscall_handler (struct intr_frame *);
+static void run_syscall (int nr, struct intr_frame *, const int32_t *args);
+static void kill_process (void) NO_RETURN;
+
+/* In syscall-entry.S. */
+void syscall_sysenter_entry (void);
+void syscall_sysenter_handler (struct intr_frame *);
+
 void
-syscall_init (void) 
+syscall_init (void)
 {
 	intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
+
+  /* SYSENTER derives the kernel SS and the user CS and SS from the
+     kernel CS, which the GDT lays out to match.  User programs
+     check CPUID the same way before using it. */
+  if (cpu_has_sysenter ())
+    {
+      cpu_write_msr (MSR_SYSENTER_CS, SEL_KCSEG);
+      cpu_write_msr (MSR_SYSENTER_ESP, (uint32_t) tss_get_esp0 ());
+      cpu_write_msr (MSR_SYSENTER_EIP, (uint32_t) syscall_sysenter_entry);
+    }
+  futex_init ();
+  shm_init ();
+  kinfo_init ();
+}
+
+/* Prints the number of calls and the average cost in CPU cycles
+   of each system call that was used. */
+void
+syscall_print_stats (void)
+{
+  int i;
+
+  for (i = 0; i < SYS_NUMBER_OF_CALLS; i++)
+    if (syscall_calls[i] > 0)
+      printf ("Syscall %s: %lld calls, %"PRIu64" cycles/call\n",
+              syscall_table[i].name, syscall_calls[i],
+              syscall_cycles[i] / syscall_calls[i]);
+  if (sysenter_cnt > 0)
+    printf ("Syscalls: %lld through SYSENTER\n", sysenter_cnt);
+}
+
+/* Returns the name of system call NR, or null if there is no
+   such call. */
+const char *
+syscall_name (int nr)
+{
+  return nr >= 0 && nr < SYS_NUMBER_OF_CALLS ? syscall_table[nr].name : NULL;
+}
+
+/* Terminates the current process with exit status -1. */
+static void
+kill_process (void)
+{
+  process_exit (-1);
+  thread_exit ();
+}
+
+/* Reads a byte at user virtual address UADDR, which must be below
+   PHYS_BASE.  Returns the byte value if successful, -1 if a page
+   fault occurred; page_fault() resumes at the label in EAX. */
+static inline int
+get_user (const uint8_t *uaddr)
+{
+  int result;
+  asm volatile ("movl $1f, %0; movzbl %1, %0; 1:"
+                : "=&a" (result) : "m" (*uaddr));
+  return result;
+}
+
+/* Writes BYTE to user address UDST, which must be below PHYS_BASE.
+   Returns true if successful, false if a page fault occurred. */
+static inline bool
+put_user (uint8_t *udst, uint8_t byte)
+{
+  int error_code;
+  asm volatile ("movl $1f, %0; movb %b2, %1; 1:"
+                : "=&a" (error_code), "=m" (*udst) : "q" (byte));
+  return error_code != -1;
+}
+
+/* Reads the word at user address UADDR, which must be below
+   PHYS_BASE and word-aligned, so that it lies within one page,
+   into *WORD.  Returns true if successful, false if a page fault
+   occurred. */
+static inline bool
+get_user_word (const uint32_t *uaddr, uint32_t *word)
+{
+  int error_code;
+  uint32_t w;
+  asm volatile ("movl $1f, %0; movl %2, %1; 1:"
+                : "=&a" (error_code), "=&r" (w) : "m" (*uaddr));
+  *word = w;
+  return error_code != -1;
+}
+
+/* Writes WORD to user address UDST, which must be below PHYS_BASE
+   and word-aligned.  Returns true if successful, false if a page
+   fault occurred. */
+static inline bool
+put_user_word (uint32_t *udst, uint32_t word)
+{
+  int error_code;
+  asm volatile ("movl $1f, %0; movl %2, %1; 1:"
+                : "=&a" (error_code), "=m" (*udst) : "r" (word));
+  return error_code != -1;
+}
+
+/* Returns true if the SIZE bytes at USRC lie entirely below
+   PHYS_BASE. */
+static bool
+user_range_ok (const void *usrc, size_t size)
+{
+  const uint8_t *first = usrc;
+
+  return (size == 0
+          || (is_user_vaddr (first + size - 1) && first + size - 1 >= first));
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address DST,
+   a word at a time wherever USRC is word-aligned.  Returns false,
+   having copied only part, if USRC is not mapped. */
+static bool
+copy_in (void *dst_, const void *usrc_, size_t size)
+{
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+
+  if (!user_range_ok (usrc, size))
+    return false;
+  while (size > 0)
+    if (size >= sizeof (uint32_t) && (uintptr_t) usrc % sizeof (uint32_t) == 0)
+      {
+        uint32_t w;
+        if (!get_user_word ((const uint32_t *) usrc, &w))
+          return false;
+        memcpy (dst, &w, sizeof w);
+        dst += sizeof w;
+        usrc += sizeof w;
+        size -= sizeof w;
+      }
+    else
+      {
+        int b = get_user (usrc++);
+        if (b == -1)
+          return false;
+        *dst++ = b;
+        size--;
+      }
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address UDST,
+   a word at a time wherever UDST is word-aligned.  Returns false,
+   having copied only part, if UDST is not mapped writable. */
+static bool
+copy_out (void *udst_, const void *src_, size_t size)
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+
+  if (!user_range_ok (udst, size))
+    return false;
+  while (size > 0)
+    if (size >= sizeof (uint32_t) && (uintptr_t) udst % sizeof (uint32_t) == 0)
+      {
+        uint32_t w;
+        memcpy (&w, src, sizeof w);
+        if (!put_user_word ((uint32_t *) udst, w))
+          return false;
+        udst += sizeof w;
+        src += sizeof w;
+        size -= sizeof w;
+      }
+    else
+      {
+        if (!put_user (udst++, *src++))
+          return false;
+        size--;
+      }
+  return true;
+}
+
+/* Copies the user string at USRC, including its null terminator,
+   into the SIZE bytes at DST.  Returns the string's length, or
+   SIZE, with DST not null-terminated, if it does not fit, or -1
+   if USRC is not mapped up to its end or SIZE bytes.  Aligned
+   words never straddle a page, so they are read whole even if the
+   string ends partway through one. */
+static int
+strncpy_from_user (char *dst, const char *usrc_, size_t size)
+{
+  const uint8_t *usrc = (const uint8_t *) usrc_;
+  size_t len = 0;
+
+  while (len < size && is_user_vaddr (usrc))
+    if ((uintptr_t) usrc % sizeof (uint32_t) == 0
+        && size - len >= sizeof (uint32_t))
+      {
+        uint32_t w;
+        size_t i;
+
+        if (!get_user_word ((const uint32_t *) usrc, &w))
+          return -1;
+        memcpy (dst + len, &w, sizeof w);
+        for (i = 0; i < sizeof w; i++)
+          if (dst[len + i] == '\0')
+            return len + i;
+        len += sizeof w;
+        usrc += sizeof w;
+      }
+    else
+      {
+        int b = get_user (usrc++);
+        if (b == -1)
+          return -1;
+        dst[len] = b;
+        if (b == 0)
+          return len;
+        len++;
+      }
+  return len < size ? -1 : (int) size;
+}
+
+/* Returns true if the SIZE byte user buffer at UBUF is mapped, and
+   writable as well if WRITABLE.  Only one byte in each page is
+   touched, so a buffer costs one access per page rather than a
+   page table walk. */
+static bool
+check_buffer (const void *ubuf, int size, bool writable)
+{
+  const uint8_t *p = ubuf;
+  const uint8_t *last;
+
+  if (size <= 0)
+    return true;
+  if (!user_range_ok (ubuf, size))
+    return false;
+  last = p + size - 1;
+  for (;;)
+    {
+      int b = get_user (p);
+      if (b == -1 || (writable && !put_user ((uint8_t *) p, b)))
+        return false;
+      if (pg_round_down (p) == pg_round_down (last))
+        return true;
+      p = pg_round_down (p) + PGSIZE;
+    }
+}
+
+/* Keeps the SIZE byte user buffer at UBUF, already checked with
+   check_buffer(), in memory while the file system works on it.
+   A page fault there could need the very file system locks that
+   are held when it happens.  WRITABLE tells whether the kernel
+   will write the buffer. */
+static void
+pin_buffer (const void *ubuf UNUSED, int size UNUSED, bool writable UNUSED)
+{
+#ifdef VM
+  if (size > 0 && !page_pin (ubuf, size, writable))
+    kill_process ();
+#endif
+}
+
+/* Undoes pin_buffer(). */
+static void
+unpin_buffer (const void *ubuf UNUSED, int size UNUSED)
+{
+#ifdef VM
+  if (size > 0)
+    page_unpin (ubuf, size);
+#endif
+}
+
+/* As copy_in_string(), but instead of killing the process if the
+   string at US is not all mapped, sets *UNMAPPED to true and
+   returns a null pointer, so that the caller can free what it
+   holds first.  Otherwise sets *UNMAPPED to false. */
+static char *
+try_copy_in_string (int32_t us, bool *unmapped)
+{
+  char *ks = palloc_get_page (0);
+  int len;
+
+  *unmapped = false;
+  if (ks == NULL)
+    return NULL;
+  len = strncpy_from_user (ks, (const char *) us, PGSIZE);
+  if (len == -1 || len == PGSIZE)
+    {
+      *unmapped = len == -1;
+      palloc_free_page (ks);
+      return NULL;
+    }
+  return ks;
+}
+
+/* Returns a copy, in a page of its own, of the user string at
+   US, for a system call to work on without touching user memory:
+   a page fault in the file system could need the very locks that
+   are held when it happens, and another thread of the process
+   could change the string meanwhile.  Kills the process if the
+   string is not all mapped.  Returns a null pointer if it is
+   PGSIZE bytes or longer or memory is short.  Free the copy with
+   palloc_free_page(), which accepts a null pointer. */
+static char *
+copy_in_string (int32_t us)
+{
+  bool unmapped;
+  char *ks = try_copy_in_string (us, &unmapped);
+
+  if (unmapped)
+    kill_process ();
+  return ks;
+}
+
+static void
+syscall_handler (struct intr_frame *f)
+{
+  const int32_t *esp = f->esp;
+  int32_t args[SYSCALL_ARG_MAX];
+  const struct syscall *sc;
+  int nr;
+
+#ifdef VM
+  thread_current ()->user_esp = f->esp;
+#endif
+
+  /* Fetch the call number and its arguments once, so handlers
+     never touch the user stack themselves. */
+  if (!copy_in (&nr, esp, sizeof nr))
+    kill_process ();
+  if (nr < 0 || nr >= SYS_NUMBER_OF_CALLS
+      || syscall_table[nr].func == NULL)
+    kill_process ();
+  sc = &syscall_table[nr];
+  if (!copy_in (args, esp + 1, sc->argc * sizeof *args))
+    kill_process ();
+
+  run_syscall (nr, f, args);
+}
+
+/* Handles a system call made with SYSENTER, called from
+   syscall_sysenter_entry with F laid out as for "int $0x30".  The
+   call number and first three arguments come in registers and
+   any fourth one from the top of the user stack. */
+void
+syscall_sysenter_handler (struct intr_frame *f)
+{
+  int32_t args[SYSCALL_ARG_MAX];
+  const struct syscall *sc;
+  int nr = f->eax;
+
+#ifdef VM
+  thread_current ()->user_esp = f->esp;
+#endif
+  sysenter_cnt++;
+
+  if (nr < 0 || nr >= SYS_NUMBER_OF_CALLS
+      || syscall_table[nr].func == NULL)
+    kill_process ();
+  sc = &syscall_table[nr];
+  args[0] = f->ebx;
+  args[1] = f->esi;
+  args[2] = f->edi;
+  if (sc->argc > 3 && !copy_in (&args[3], f->esp, sizeof args[3]))
+    kill_process ();
+
+  run_syscall (nr, f, args);
+
+  /* As intr_handler() does on the way back to user mode. */
+  if (process_exiting ())
+    {
+      intr_enable ();
+      thread_exit ();
+    }
+}
+
+/* Runs system call NR with ARGS, which must be a valid call, and
+   accounts for it in the statistics. */
+static void
+run_syscall (int nr, struct intr_frame *f, const int32_t *args)
+{
+  uint64_t start;
+
+  /* Exit and halt do not return, so only their calls count. */
+  syscall_calls[nr]++;
+  if (nr < STATS_SYSCALLS)
+    thread_current ()->process->rusage.syscalls[nr]++;
+  trace (TRACE_SYSCALL_ENTER, nr, syscall_table[nr].argc > 0 ? args[0] : 0);
+  start = read_tsc ();
+  syscall_table[nr].func (f, args);
+  syscall_cycles[nr] += read_tsc () - start;
+  trace (TRACE_SYSCALL_EXIT, nr, f->eax);
+}
+
+static void
+sys_halt (struct intr_frame *f UNUSED, const int32_t *args UNUSED)
+{
+  power_off ();
+}
+
+static void
+sys_trace_dump (struct intr_frame *f UNUSED, const int32_t *args UNUSED)
+{
+  trace_dump ();
+}
+
+static void
+sys_clock_ns (struct intr_frame *f UNUSED, const int32_t *args)
+{
+  int64_t ns = timer_ns ();
+
+  if (!copy_out ((void *) args[0], &ns, sizeof ns))
+    kill_process ();
+}
+
+static void
+sys_disk_stats (struct intr_frame *f, const int32_t *args)
+{
+  struct disk_stats s;
+
+  disk_get_stats (filesys_disk, &s);
+  cache_get_stats (&s);
+  if (!copy_out ((void *) args[0], &s, sizeof s))
+    kill_process ();
+  f->eax = true;
+}
+
+/* Copies up to SIZE bytes of a struct stats snapshot to BUFFER and
+   returns the number copied, or -1 if memory is short. */
+static void
+sys_stats (struct intr_frame *f, const int32_t *args)
+{
+  size_t size = args[1];
+  struct stats *s;
+  int i;
+
+  f->eax = -1;
+  s = malloc (sizeof *s);
+  if (s == NULL)
+    return;
+
+  memset (s, 0, sizeof *s);
+  s->version = STATS_VERSION;
+  s->size = sizeof *s;
+  s->ticks = timer_ticks ();
+  thread_get_stats (s);
+  intr_get_stats (s);
+  palloc_get_stats (s);
+  malloc_get_stats (s);
+#ifdef VM
+  frame_get_stats (s);
+#endif
+  console_get_stats (s);
+  kbd_get_stats (s);
+  exception_get_stats (s);
+  process_get_stats (s);
+  disk_get_stats (filesys_disk, &s->disk);
+  cache_get_stats (&s->disk);
+  s->syscall_cnt = (SYS_NUMBER_OF_CALLS < STATS_SYSCALLS
+                    ? SYS_NUMBER_OF_CALLS : STATS_SYSCALLS);
+  for (i = 0; i < (int) s->syscall_cnt; i++)
+    {
+      s->syscalls[i].calls = syscall_calls[i];
+      s->syscalls[i].cycles = syscall_cycles[i];
+    }
+
+  if (size > sizeof *s)
+    size = sizeof *s;
+  if (!copy_out ((void *) args[0], s, size))
+    {
+      free (s);
+      kill_process ();
+    }
+  free (s);
+  f->eax = size;
+}
+
+/* Moves the program break by INCREMENT bytes and returns the old
+   break, or (void *) -1 on failure. */
+static void
+sys_sbrk (struct intr_frame *f, const int32_t *args)
+{
+  f->eax = (uint32_t) heap_sbrk (args[0]);
+}
+
+static void
+sys_exit (struct intr_frame *f UNUSED, const int32_t *args)
+{
+  process_exit (args[0]);
+  thread_exit ();
+}
+
+/* Starts a thread in the current process at user address ARGS[0]
+   with stack pointer ARGS[1] and returns its tid, or -1. */
+static void
+sys_thread_create (struct intr_frame *f, const int32_t *args)
+{
+  if (!is_user_vaddr ((void *) args[0]) || !is_user_vaddr ((void *) args[1]))
+    kill_process ();
+  f->eax = process_thread_create ((void (*) (void)) args[0],
+                                  (void *) args[1]);
+}
+
+static void
+sys_thread_join (struct intr_frame *f, const int32_t *args)
+{
+  f->eax = process_thread_join (args[0]);
+}
+
+/* Ends the calling thread only.  The process lives on until its
+   last thread exits. */
+static void
+sys_thread_exit (struct intr_frame *f UNUSED, const int32_t *args UNUSED)
+{
+  thread_exit ();
+}
+
+/* Runs the command line at ARGS[0] in a new process and returns
+   its process id, or -1.  The command line is copied in first,
+   since starting the process may sleep, and meanwhile another
+   thread of the caller could unmap or change it. */
+static void
+sys_exec (struct intr_frame *f, const int32_t *args)
+{
+  char *cmd_line = copy_in_string (args[0]);
+
+  f->eax = cmd_line != NULL ? process_execute (cmd_line) : -1;
+  palloc_free_page (cmd_line);
+}
+
+static void
+sys_wait (struct intr_frame *f, const int32_t *args)
+{
+  f->eax = process_wait (args[0]);
+}
+
+/* As sys_wait(), but also stores the resources the child used at
+   user address ARGS[1], all zeros if it returns -1. */
+static void
+sys_wait_rusage (struct intr_frame *f, const int32_t *args)
+{
+  struct rusage ru;
+
+  if (!check_buffer ((void *) args[1], sizeof ru, true))
+    kill_process ();
+  f->eax = process_wait_rusage (args[0], &ru);
+  if (!copy_out ((void *) args[1], &ru, sizeof ru))
+    kill_process ();
+}
+
+/* Starts a process for each of the ARGS[1] command lines in the
+   user array at ARGS[0], loading them all in parallel, and stores
+   their process ids, -1 for each failure, in the user array at
+   ARGS[2].  Returns the number of processes started, or -1 if
+   the count is out of range. */
+static void
+sys_spawn_many (struct intr_frame *f, const int32_t *args)
+{
+  const char *cmd_lines[SPAWN_MAX];
+  char *copies[SPAWN_MAX];
+  int pids[SPAWN_MAX];
+  int cnt = args[1];
+  int started = 0;
+  int i;
+
+  if (cnt < 0 || cnt > SPAWN_MAX)
+    {
+      f->eax = -1;
+      return;
+    }
+  if (!copy_in (cmd_lines, (const void *) args[0], cnt * sizeof *cmd_lines)
+      || !check_buffer ((void *) args[2], cnt * sizeof *pids, true))
+    kill_process ();
+  /* Copied in as sys_exec() does. */
+  for (i = 0; i < cnt; i++)
+    {
+      bool unmapped;
+
+      copies[i] = try_copy_in_string ((int32_t) cmd_lines[i], &unmapped);
+      if (unmapped)
+        {
+          while (i-- > 0)
+            palloc_free_page (copies[i]);
+          kill_process ();
+        }
+    }
+
+  process_execute_many ((const char *const *) copies, cnt, pids);
+  for (i = 0; i < cnt; i++)
+    palloc_free_page (copies[i]);
+  if (!copy_out ((void *) args[2], pids, cnt * sizeof *pids))
+    kill_process ();
+  for (i = 0; i < cnt; i++)
+    started += pids[i] != -1;
+  f->eax = started;
+}
+
+/* Waits for whichever child dies first and returns its process id,
+   storing its exit status at user address ARGS[0] unless that is
+   null.  Returns -1 at once if there is no child to wait for. */
+static void
+sys_wait_any (struct intr_frame *f, const int32_t *args)
+{
+  int *ustatus = (int *) args[0];
+  int status;
+  int pid;
+
+  if (ustatus != NULL && !check_buffer (ustatus, sizeof *ustatus, true))
+    kill_process ();
+  pid = process_wait_any (&status);
+  if (pid != -1 && ustatus != NULL
+      && !copy_out (ustatus, &status, sizeof status))
+    kill_process ();
+  f->eax = pid;
+}
+
+static void
+sys_create (struct intr_frame *f, const int32_t *args)
+{
+  char *name = copy_in_string (args[0]);
+
+  f->eax = name != NULL && filesys_create (name, (unsigned) args[1]);
+  palloc_free_page (name);
+}
+
+static void
+sys_remove (struct intr_frame *f, const int32_t *args)
+{
+  char *name = copy_in_string (args[0]);
+
+  f->eax = name != NULL && filesys_remove (name);
+  palloc_free_page (name);
+#ifdef VM
+  /* The file may be an executable whose frames are kept. */
+  if (f->eax)
+    frame_drop_removed ();
+#endif
+}
+
+/* The current process's open files.  Its threads share the table,
+   so it is only used under the process lock.  The lock covers the
+   table, not the files in it: a file found in it stays open only
+   until some thread closes its fd, so a thread must not close a
+   file that another thread of its process is still using. */
+
+/* Adds FILE to the current process's open files and returns its
+   fd, or -1 if FILE is null or the table is full.  Closes FILE on
+   failure. */
+static int
+fd_insert (struct file *file)
+{
+  struct process *p = thread_current ()->process;
+  int fd;
+
+  lock_acquire (&p->lock);
+  fd = map_insert (&p->open_file_table, file);
+  lock_release (&p->lock);
+  return fd;
+}
+
+/* Returns the file open as FD in the current process, or a null
+   pointer if there is none.  Fds 0 and 1 are the process's stdio
+   files, which are null for the console. */
+static struct file *
+lookup_fd (int fd)
+{
+  struct process *p = thread_current ()->process;
+  struct file *file;
+
+  /* Set when the process is created and never changed. */
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO)
+    return p->stdio[fd];
+
+  lock_acquire (&p->lock);
+  file = map_find (p->open_file_table, fd);
+  lock_release (&p->lock);
+  return file;
+}
+
+/* Returns the file open as FD in the current process with a
+   holder added by file_share(), or a null pointer if there is
+   none.  Unlike lookup_fd(), the file stays open even if another
+   thread closes FD meanwhile. */
+static struct file *
+share_fd (int fd)
+{
+  struct process *p = thread_current ()->process;
+  struct file *file;
+
+  if (fd == STDIN_FILENO || fd == STDOUT_FILENO)
+    return p->stdio[fd] != NULL ? file_share (p->stdio[fd]) : NULL;
+
+  lock_acquire (&p->lock);
+  file = map_find (p->open_file_table, fd);
+  if (file != NULL)
+    file_share (file);
+  lock_release (&p->lock);
+  return file;
+}
+
+/* Closes FD in the current process, if it is open. */
+static void
+fd_close (int fd)
+{
+  struct process *p = thread_current ()->process;
+
+  lock_acquire (&p->lock);
+  map_close_file (p->open_file_table, fd);
+  lock_release (&p->lock);
+}
+
+/* Runs the command line at ARGS[0] like exec, but with fds
+   ARGS[1] and ARGS[2] of the calling process as the new process's
+   fds 0 and 1.  Returns -1 if either is not open. */
+static void
+sys_exec_stdio (struct intr_frame *f, const int32_t *args)
+{
+  char *cmd_line = copy_in_string (args[0]);
+  struct file *stdio[2];
+  int i;
+
+  f->eax = -1;
+  if (cmd_line == NULL)
+    return;
+  for (i = 0; i < 2; i++)
+    {
+      int fd = args[1 + i];
+      stdio[i] = lookup_fd (fd);
+      if (stdio[i] == NULL && fd != i)
+        {
+          palloc_free_page (cmd_line);
+          return;
+        }
+    }
+  f->eax = process_execute_stdio (cmd_line, stdio);
+  palloc_free_page (cmd_line);
+}
+
+/* Runs the command line at ARGS[0] like exec, but the new process
+   also starts with every file the caller has open, at the same
+   fds, sharing their positions with the caller. */
+static void
+sys_exec_inherit (struct intr_frame *f, const int32_t *args)
+{
+  char *cmd_line = copy_in_string (args[0]);
+
+  f->eax = cmd_line != NULL ? process_execute_inherit (cmd_line) : -1;
+  palloc_free_page (cmd_line);
+}
+
+/* Opens fd ARGS[0] again as the lowest free fd and returns it,
+   or -1 if ARGS[0] is not open.  Both fds refer to the same open
+   file, with one position.  Fds 0 and 1 on the console cannot be
+   duplicated, since the console is not a file. */
+static void
+sys_dup (struct intr_frame *f, const int32_t *args)
+{
+  struct file *file = share_fd (args[0]);
+
+  f->eax = file != NULL ? fd_insert (file) : -1;
+}
+
+/* Makes fd ARGS[1] refer to the open file of fd ARGS[0], as
+   dup() does, closing whatever ARGS[1] had open.  Returns
+   ARGS[1], or -1 if ARGS[0] is not open or ARGS[1] is out of
+   range.  Fds 0 and 1 are fixed when the process starts, so
+   ARGS[1] may not be either of them. */
+static void
+sys_dup2 (struct intr_frame *f, const int32_t *args)
+{
+  struct process *p = thread_current ()->process;
+  int old_fd = args[0], new_fd = args[1];
+  struct file *file;
+
+  if (new_fd <= STDOUT_FILENO)
+    {
+      f->eax = -1;
+      return;
+    }
+  if (old_fd == new_fd)
+    {
+      f->eax = lookup_fd (old_fd) != NULL ? new_fd : -1;
+      return;
+    }
+  file = share_fd (old_fd);
+  lock_acquire (&p->lock);
+  f->eax = map_insert_at (&p->open_file_table, new_fd, file);
+  lock_release (&p->lock);
+}
+
+static void
+sys_open (struct intr_frame *f, const int32_t *args)
+{
+  char *name = copy_in_string (args[0]);
+
+  f->eax = name != NULL ? fd_insert (filesys_open (name)) : -1;
+  palloc_free_page (name);
+}
+
+/* Opens the file named ARGS[0] like open(), with the O_* flags
+   in ARGS[1].  Returns -1 if a flag is unknown. */
+static void
+sys_open_flags (struct intr_frame *f, const int32_t *args)
+{
+  char *name = copy_in_string (args[0]);
+  struct file *file;
+
+  if ((args[1] & ~O_DIRECT) != 0 || name == NULL)
+    {
+      palloc_free_page (name);
+      f->eax = -1;
+      return;
+    }
+  file = filesys_open (name);
+  palloc_free_page (name);
+  if (file != NULL && (args[1] & O_DIRECT))
+    file_set_direct (file);
+  f->eax = fd_insert (file);
+}
+
+static void
+sys_filesize (struct intr_frame *f, const int32_t *args)
+{
+  struct file *file = lookup_fd (args[0]);
+
+  f->eax = file != NULL ? file_length (file) : -1;
+}
+
+/* Most user pages one direct transfer covers. */
+#define DIRECT_PAGES 16
+
+/* Transfers SIZE bytes between FILE and the user buffer at UBUF,
+   already checked and pinned, writing FILE if WRITE is true and
+   reading it otherwise.  If FILE was opened with O_DIRECT and
+   UBUF, SIZE and FILE's position are all sector aligned, the
+   data moves straight between the disk and the frames behind
+   UBUF, DIRECT_PAGES pages at a time; otherwise it goes through
+   the buffer cache.  Returns the number of bytes transferred, or
+   -1 if FILE cannot be transferred at all. */
+static int
+file_transfer (struct file *file, void *ubuf, int size, bool write)
+{
+  uint8_t *uaddr = ubuf;
+  int total = 0;
+
+  ASSERT (O_DIRECT_ALIGN == DISK_SECTOR_SIZE);
+  if (!file_is_direct (file)
+      || ((uintptr_t) ubuf | size | file_tell (file)) % O_DIRECT_ALIGN != 0)
+    return write ? file_write (file, ubuf, size) : file_read (file, ubuf, size);
+
+  while (total < size)
+    {
+      struct iovec kiov[DIRECT_PAGES];
+      int cnt, chunk = 0, n;
+
+      for (cnt = 0; cnt < DIRECT_PAGES && total + chunk < size; cnt++)
+        {
+          uint8_t *upage = uaddr + total + chunk;
+          int len = PGSIZE - pg_ofs (upage);
+
+          if (len > size - total - chunk)
+            len = size - total - chunk;
+          kiov[cnt].iov_base = pagedir_get_page (thread_current ()->pagedir,
+                                                 upage);
+          kiov[cnt].iov_len = len;
+          ASSERT (kiov[cnt].iov_base != NULL);
+          chunk += len;
+        }
+      n = (write
+           ? file_write_direct (file, kiov, cnt)
+           : file_read_direct (file, kiov, cnt));
+      total += n;
+      if (n < chunk)
+        break;
+    }
+  return total;
+}
+
+/* Reads from FD into the IOVCNT buffers in IOV, already checked
+   with check_buffer(), in order.  Stops early at the first short
+   read, such as at end of file or when a pipe runs dry.  Returns
+   the number of bytes read, or -1 if FD cannot be read. */
+static int
+read_iov (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct file *file = NULL;
+  int total = 0;
+  int i;
+
+  if (fd == STDOUT_FILENO || fd == -1)
+    return -1;
+  if ((file = lookup_fd (fd)) == NULL && fd != STDIN_FILENO)
+    return -1;
+  for (i = 0; i < iovcnt; i++)
+    {
+      void *buffer = iov[i].iov_base;
+      int size = iov[i].iov_len;
+      int n;
+
+      if (size == 0)
+        continue;
+      if (file == NULL)
+        n = tty_read (buffer, size);
+      else
+        {
+          pin_buffer (buffer, size, true);
+          n = file_transfer (file, buffer, size, false);
+          unpin_buffer (buffer, size);
+        }
+      if (n < 0)
+        return total > 0 ? total : -1;
+      total += n;
+      if (n < size)
+        break;
+    }
+  return total;
 }
 
+/* Writes the IOVCNT buffers in IOV, already checked with
+   check_buffer(), to FD in order.  The console is held for the
+   whole call, so the buffers come out together.  Returns the
+   number of bytes written, or -1 if FD cannot be written. */
+static int
+write_iov (int fd, const struct iovec *iov, int iovcnt)
+{
+  struct file *file = NULL;
+  int total = 0;
+  int i;
+
+  if (fd == STDIN_FILENO || fd == -1)
+    return -1;
+  if (fd == STDOUT_FILENO && lookup_fd (fd) == NULL)
+    {
+      console_acquire ();
+      for (i = 0; i < iovcnt; i++)
+        putbuf (iov[i].iov_base, iov[i].iov_len);
+      console_release ();
+      for (i = 0; i < iovcnt; i++)
+        total += iov[i].iov_len;
+      return total;
+    }
+  if ((file = lookup_fd (fd)) == NULL)
+    return -1;
+  for (i = 0; i < iovcnt; i++)
+    {
+      const void *buffer = iov[i].iov_base;
+      int size = iov[i].iov_len;
+      int n;
+
+      if (size == 0)
+        continue;
+      pin_buffer (buffer, size, false);
+      n = file_transfer (file, (void *) buffer, size, true);
+      unpin_buffer (buffer, size);
+      if (n < 0)
+        return total > 0 ? total : -1;
+      total += n;
+      if (n < size)
+        break;
+    }
+  return total;
+}
+
+/* Adds N, the result of a read or, if WRITE, a write, to the
+   current process's byte counts if positive, and returns it. */
+static int
+count_bytes (int n, bool write)
+{
+  struct rusage *ru = &thread_current ()->process->rusage;
+
+  if (n > 0)
+    {
+      if (write)
+        ru->write_bytes += n;
+      else
+        ru->read_bytes += n;
+    }
+  return n;
+}
+
+/* Copies the IOVCNT element iovec array at UIOV into IOV and checks
+   each buffer, writable ones if WRITABLE.  Kills the process if
+   any of it is not mapped.  Returns false if IOVCNT is out of
+   range or the buffers add up to more than INT_MAX bytes. */
+static bool
+copy_in_iov (struct iovec *iov, const void *uiov, int iovcnt, bool writable)
+{
+  size_t total = 0;
+  int i;
+
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return false;
+  if (!copy_in (iov, uiov, iovcnt * sizeof *iov))
+    kill_process ();
+  for (i = 0; i < iovcnt; i++)
+    {
+      if (iov[i].iov_len > (size_t) INT_MAX - total)
+        return false;
+      total += iov[i].iov_len;
+      if (!check_buffer (iov[i].iov_base, iov[i].iov_len, writable))
+        kill_process ();
+    }
+  return true;
+}
+
+static void
+sys_read (struct intr_frame *f, const int32_t *args)
+{
+  struct iovec iov;
+  int size = args[2];
+
+  iov.iov_base = (void *) args[1];
+  iov.iov_len = size > 0 ? size : 0;
+  if (!check_buffer (iov.iov_base, size, true))
+    kill_process ();
+  f->eax = count_bytes (read_iov (args[0], &iov, 1), false);
+}
+
+static void
+sys_write (struct intr_frame *f, const int32_t *args)
+{
+  struct iovec iov;
+  int size = args[2];
+
+  iov.iov_base = (void *) args[1];
+  iov.iov_len = size > 0 ? size : 0;
+  if (!check_buffer (iov.iov_base, size, false))
+    kill_process ();
+  f->eax = count_bytes (write_iov (args[0], &iov, 1), true);
+}
+
+static void
+sys_readv (struct intr_frame *f, const int32_t *args)
+{
+  struct iovec iov[IOV_MAX];
+
+  if (!copy_in_iov (iov, (const void *) args[1], args[2], true))
+    f->eax = -1;
+  else
+    f->eax = count_bytes (read_iov (args[0], iov, args[2]), false);
+}
+
+static void
+sys_writev (struct intr_frame *f, const int32_t *args)
+{
+  struct iovec iov[IOV_MAX];
+
+  if (!copy_in_iov (iov, (const void *) args[1], args[2], false))
+    f->eax = -1;
+  else
+    f->eax = count_bytes (write_iov (args[0], iov, args[2]), true);
+}
+
+/* Reads ARGS[2] bytes into the user buffer at ARGS[1] from the
+   file open as ARGS[0], starting at offset ARGS[3].  The file's
+   position is left alone.  Returns the number of bytes read, or
+   -1 if the fd is not an open file or the offset is negative. */
+static void
+sys_pread (struct intr_frame *f, const int32_t *args)
+{
+  struct file *file = args[0] > 1 ? lookup_fd (args[0]) : NULL;
+  void *buffer = (void *) args[1];
+  int size = args[2];
+
+  if (!check_buffer (buffer, size, true))
+    kill_process ();
+  if (file == NULL || args[3] < 0)
+    f->eax = -1;
+  else
+    {
+      pin_buffer (buffer, size, true);
+      f->eax = count_bytes (file_read_at (file, buffer, size, args[3]),
+                            false);
+      unpin_buffer (buffer, size);
+    }
+}
+
+/* Writes ARGS[2] bytes from the user buffer at ARGS[1] to the file
+   open as ARGS[0], starting at offset ARGS[3].  The file's
+   position is left alone.  Returns the number of bytes written,
+   or -1 if the fd is not an open file or the offset is
+   negative. */
+static void
+sys_pwrite (struct intr_frame *f, const int32_t *args)
+{
+  struct file *file = args[0] > 1 ? lookup_fd (args[0]) : NULL;
+  const void *buffer = (const void *) args[1];
+  int size = args[2];
+
+  if (!check_buffer (buffer, size, false))
+    kill_process ();
+  if (file == NULL || args[3] < 0)
+    f->eax = -1;
+  else
+    {
+      pin_buffer (buffer, size, false);
+      f->eax = count_bytes (file_write_at (file, buffer, size, args[3]),
+                            true);
+      unpin_buffer (buffer, size);
+    }
+}
+
+/* Copies up to ARGS[2] bytes from the file open as ARGS[0] to the
+   one open as ARGS[1], from and to their current positions, without
+   passing through user memory.  Returns the number of bytes copied,
+   or -1 if either fd is not an open file. */
+static void
+sys_copy (struct intr_frame *f, const int32_t *args)
+{
+  struct file *src = args[0] > 1 ? lookup_fd (args[0]) : NULL;
+  struct file *dst = args[1] > 1 ? lookup_fd (args[1]) : NULL;
+  off_t size = (uint32_t) args[2] > INT_MAX ? INT_MAX : args[2];
+
+  if (src == NULL || dst == NULL)
+    f->eax = -1;
+  else
+    f->eax = file_copy (dst, src, size);
+}
+
+static void
+sys_seek (struct intr_frame *f UNUSED, const int32_t *args)
+{
+  struct file *file = lookup_fd (args[0]);
 
-/* This array defined the number of arguments each syscall expects.
-   For example, if you want to find out the number of arguments for
-   the read system call you shall write:
-   
-   int sys_read_arg_count = argc[ SYS_READ ];
-   
-   All system calls have a name such as SYS_READ defined as an enum
-   type, see `lib/syscall-nr.h'. Use them instead of numbers.
- */
-   const int argc[] = {
-  /* basic calls */
-   	0, 1, 1, 1, 2, 1, 1, 1, 3, 3, 2, 1, 1, 
-  /* not implemented */
-   	2, 1,    1, 1, 2, 1, 1,
-  /* extended */
-   	0
-   };
-
-   static void
-   syscall_handler (struct intr_frame *f) 
-   {
-   	int32_t* esp = (int32_t*)f->esp;
-   	int sys_read_arg_count = argc[ esp[0] ];
-  switch ( esp[0] /* retrive syscall number */ )
-   	{
-   		case SYS_HALT:
-   		power_off();
-   		break;
-   		case SYS_EXIT:
-   		{
-   			int exit_status = (int)(esp[1]);
-   			process_exit(exit_status);
-   			thread_exit();
-   		}
-   		break;
-   		case SYS_WAIT:
-   		{
-   			int pid = esp[1];
-   			int status = process_wait (pid);
-   			f->eax = status;
-   		}
-   		break;
-   		case SYS_READ:
-   		{
-   			int fd = esp[1];
-   			char *buffer = (char*)esp[2];
-   			int size = esp[3];
-   			if(fd == STDOUT_FILENO || fd == -1)
-   			{
-   				f->eax = -1;
-   				break;
-   			}
-   			else if(fd == STDIN_FILENO)
-   			{
-   				int counter = 0;
-   				while(counter < size)
-   				{
-   					char c = input_getc();
-   					if(c == '\r')
-   						c = '\n';
-   					*(buffer + counter) = c;
-   					putbuf((char*)&c,1);
-   					counter++;
-   				}
-   				f->eax = counter;
-   			}
-   			else
-   			{
-   				struct file * file = map_find(&(thread_current()->open_file_table), fd);
-   				if(file == NULL)
-   				{
-   					f->eax = -1;
-   					break;
-   				}
-   				f->eax  = file_read(file, buffer, size);
-   			}
-   		}
-   		break;
-   		case SYS_WRITE:
-   		{
-   			int fd = esp[1];
-   			char * buffer = (char*) esp[2];
-   			int size = esp[3];
-   			if(fd == STDIN_FILENO || fd == -1)
-   			{
-   				f->eax = -1;
-   				break;
-   			}
-   			else if(fd == STDOUT_FILENO)
-   			{
-   				putbuf(buffer, size);
-   				f->eax = size;
-   			}
-   			else
-   			{
-   				struct file * file = map_find(&(thread_current()->open_file_table), fd);
-   				if(file == NULL)
-   				{
-   					f->eax = -1;
-   					break;
-   				}
-   				f->eax = file_write(file, buffer,size);
-   			}
-   		}
-   		break;
-   		case SYS_OPEN:
-   		{
-   			char* file = (char*)esp[1];
-   			int fd = map_insert(&(thread_current()->open_file_table), filesys_open(file));
-   			f->eax = fd; 
-   		}
-   		break;
-   		case SYS_CREATE:
-   		{
-   			char * file = (char*) esp[1];
-   			unsigned int size = esp[2];
-   			f->eax = filesys_create(file,size);
-   			break;
-   		}
-   		case SYS_REMOVE:
-   		{
-   			char * file = (char*) esp[1];
-   			f->eax = filesys_remove(file);
-   			
-   			break;
-   		}
-   		case SYS_CLOSE:
-   		{
-   			int fd = esp[1];
-   			if(fd > 1)
-   				map_close_file(&(thread_current()->open_file_table), fd);
-   			break;
-   		}
-   		case SYS_SEEK:
-   		{
-   			int fd = esp[1];
-   			int pos = esp[2];
-   			struct file * file = map_find(&(thread_current()->open_file_table), fd);
-   			if(file == NULL)
-   			{
-   				break;
-   			}
-   			file_seek(file, pos);
-   		}
-   		break;
-   		case SYS_TELL:
-   		{
-   			int fd = esp[1];
-   			struct file * file = map_find(&(thread_current()->open_file_table), fd);
-   			if(file == NULL)
-   			{
-   				f->eax = -1;
-   				break;
-   			}
-   			f->eax = file_tell(file);
-   		}
-   		break;
-   		case SYS_FILESIZE:
-   		{
-   			int fd = esp[1];
-   			struct file * file = map_find(&(thread_current()->open_file_table), fd);
-   			if(file == NULL)
-   			{
-   				f->eax = -1;
-   				break;
-   			}
-   			f->eax = file_length(file);
-   		}
-   		break;
-   		case SYS_SLEEP:
-   		{
-   			debug("Sleep with: %i\n", (int)(esp[1]));
-   			timer_msleep((int)(esp[1]));
-   		}
-   		break;
-   		case SYS_PLIST:
-   		{
-   			process_print_list();
-   		}      
-   		break;
-   		case SYS_EXEC:
-   		{
-   			f->eax = process_execute(esp[1]);
-   		}
-   		break;
-   		default:
-   		{     
-   			thread_exit ();
-   		}
-   		
-   	}
-   }
+  if (file != NULL)
+    file_seek (file, args[1]);
+}
+
+static void
+sys_tell (struct intr_frame *f, const int32_t *args)
+{
+  struct file *file = lookup_fd (args[0]);
+
+  f->eax = file != NULL ? file_tell (file) : -1;
+}
+
+static void
+sys_close (struct intr_frame *f UNUSED, const int32_t *args)
+{
+  if (args[0] > 1)
+    fd_close (args[0]);
+}
+
+#ifdef VM
+static void
+sys_mmap (struct intr_frame *f, const int32_t *args)
+{
+  struct file *file = args[0] > 1 ? lookup_fd (args[0]) : NULL;
+
+  f->eax = mmap_map (file, (void *) args[1]);
+}
+
+static void
+sys_munmap (struct intr_frame *f UNUSED, const int32_t *args)
+{
+  mmap_unmap (args[0]);
+}
+#endif
+
+static void
+sys_chdir (struct intr_frame *f, const int32_t *args)
+{
+  char *name = copy_in_string (args[0]);
+
+  f->eax = name != NULL && filesys_chdir (name);
+  palloc_free_page (name);
+}
+
+static void
+sys_mkdir (struct intr_frame *f, const int32_t *args)
+{
+  char *name = copy_in_string (args[0]);
+
+  f->eax = name != NULL && filesys_mkdir (name);
+  palloc_free_page (name);
+}
+
+/* Returns the inode of the file open as FD in the current
+   process, or a null pointer if there is none or FD is a pipe
+   end. */
+static struct inode *
+lookup_fd_inode (int fd)
+{
+  struct file *file = fd > 1 ? lookup_fd (fd) : NULL;
+  return file != NULL ? file_get_inode (file) : NULL;
+}
+
+/* Stores the next name in the directory open as ARGS[0] into the
+   user buffer at ARGS[1], of READDIR_MAX_LEN + 1 bytes, skipping
+   "." and "..".  Returns false at the end of the directory or if
+   ARGS[0] is not a directory. */
+static void
+sys_readdir (struct intr_frame *f, const int32_t *args)
+{
+  struct file *file = args[0] > 1 ? lookup_fd (args[0]) : NULL;
+  struct inode *inode = file != NULL ? file_get_inode (file) : NULL;
+  char name[NAME_MAX + 1];
+  off_t pos;
+
+  f->eax = false;
+  if (inode == NULL || !inode_is_dir (inode))
+    return;
+  pos = file_tell (file);
+  if (dir_readdir_at (inode, &pos, name))
+    {
+      if (!copy_out ((char *) args[1], name, strlen (name) + 1))
+        kill_process ();
+      f->eax = true;
+    }
+  file_seek (file, pos);
+}
+
+static void
+sys_isdir (struct intr_frame *f, const int32_t *args)
+{
+  struct inode *inode = lookup_fd_inode (args[0]);
+
+  f->eax = inode != NULL && inode_is_dir (inode);
+}
+
+static void
+sys_inumber (struct intr_frame *f, const int32_t *args)
+{
+  struct inode *inode = lookup_fd_inode (args[0]);
+
+  f->eax = inode != NULL ? (int) inode_get_inumber (inode) : -1;
+}
+
+static void
+sys_sleep (struct intr_frame *f UNUSED, const int32_t *args)
+{
+  debug ("Sleep with: %i\n", (int) args[0]);
+  timer_msleep (args[0]);
+}
+
+static void
+sys_plist (struct intr_frame *f UNUSED, const int32_t *args UNUSED)
+{
+  process_print_list ();
+}
+
+/* Creates a pipe and stores the file descriptors of its read and
+   write ends in the user array at ARGS[0].  Returns true if
+   successful, false if out of memory or file descriptors. */
+static void
+sys_pipe (struct intr_frame *f, const int32_t *args)
+{
+  struct file *reader, *writer;
+  int fds[2];
+
+  /* Check first, so that a bad pointer never leaks a pipe. */
+  if (!check_buffer ((void *) args[0], sizeof fds, true))
+    kill_process ();
+
+  f->eax = false;
+  if (!file_open_pipe (&reader, &writer))
+    return;
+  fds[0] = fd_insert (reader);
+  if (fds[0] == -1)
+    {
+      file_close (writer);
+      return;
+    }
+  fds[1] = fd_insert (writer);
+  if (fds[1] == -1)
+    {
+      fd_close (fds[0]);
+      return;
+    }
+  if (!copy_out ((void *) args[0], fds, sizeof fds))
+    {
+      fd_close (fds[0]);
+      fd_close (fds[1]);
+      kill_process ();
+    }
+  f->eax = true;
+}
+
+/* Returns true if system call NR may be queued for submit(). */
+static bool
+batchable (int nr)
+{
+  switch (nr)
+    {
+    case SYS_FILESIZE:
+    case SYS_READ:
+    case SYS_WRITE:
+    case SYS_SEEK:
+    case SYS_TELL:
+    case SYS_CLOSE:
+    case SYS_PREAD:
+    case SYS_PWRITE:
+      return true;
+    default:
+      return false;
+    }
+}
+
+/* Runs the ARGS[1] queued file system calls in the user array of
+   struct syscall_entry at ARGS[0], in order, storing each return
+   value into its entry, so that many small calls cost a single
+   trap.  An entry whose call may not be queued gets -1.  Returns
+   the number of entries run, or -1 if the count is out of
+   range. */
+static void
+sys_submit (struct intr_frame *f, const int32_t *args)
+{
+  struct syscall_entry *uentries = (struct syscall_entry *) args[0];
+  int cnt = args[1];
+  int i;
+
+  if (cnt < 0 || cnt > SUBMIT_MAX)
+    {
+      f->eax = -1;
+      return;
+    }
+  for (i = 0; i < cnt; i++)
+    {
+      struct syscall_entry e;
+      struct intr_frame inner = *f;
+
+      if (!copy_in (&e, &uentries[i], sizeof e))
+        kill_process ();
+      if (batchable (e.nr))
+        {
+          run_syscall (e.nr, &inner, e.args);
+          e.result = inner.eax;
+        }
+      else
+        e.result = -1;
+      if (!copy_out (&uentries[i].result, &e.result, sizeof e.result))
+        kill_process ();
+    }
+  f->eax = cnt;
+}
+
+static void
+sys_futex_wait (struct intr_frame *f, const int32_t *args)
+{
+  f->eax = futex_wait ((int *) args[0], args[1]);
+}
+
+static void
+sys_futex_wake (struct intr_frame *f, const int32_t *args)
+{
+  f->eax = futex_wake ((int *) args[0], args[1]);
+}
+
+static void
+sys_shm_create (struct intr_frame *f, const int32_t *args)
+{
+  f->eax = shm_create ((uint32_t) args[0], (void *) args[1]);
+}
+
+static void
+sys_shm_attach (struct intr_frame *f, const int32_t *args)
+{
+  f->eax = shm_attach (args[0], (void *) args[1]);
+}
+
+static void
+sys_shm_detach (struct intr_frame *f, const int32_t *args)
+{
+  f->eax = shm_detach ((void *) args[0]);
+}
+
+/* Sets the REVENTS of each of the CNT entries in FDS and returns
+   the number of entries with any. */
+static int
+poll_scan (struct pollfd *fds, int cnt)
+{
+  int ready = 0;
+  int i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct pollfd *p = &fds[i];
+      int events;
+
+      struct file *file = lookup_fd (p->fd);
+
+      if (file != NULL)
+        events = file_poll (file);
+      else if (p->fd == STDIN_FILENO)
+        events = tty_ready () ? POLLIN : 0;
+      else if (p->fd == STDOUT_FILENO)
+        events = POLLOUT;
+      else
+        events = POLLNVAL;
+      p->revents = events & (p->events | POLLHUP | POLLNVAL);
+      if (p->revents != 0)
+        ready++;
+    }
+  return ready;
+}
+
+/* Waits until at least one of the ARGS[1] fds in the user array
+   of struct pollfd at ARGS[0] is ready for the events asked for,
+   or for ARGS[2] milliseconds if that is not negative, and sets
+   each entry's REVENTS.  Stdin is ready once a whole line has
+   been typed.  Returns the number of ready entries, 0 on timeout,
+   or -1 if the count is out of range. */
+static void
+sys_poll (struct intr_frame *f, const int32_t *args)
+{
+  struct pollfd fds[POLL_MAX];
+  struct poll_waiter w;
+  int cnt = args[1];
+  int timeout_ms = args[2];
+  int ready;
+
+  if (cnt < 0 || cnt > POLL_MAX)
+    {
+      f->eax = -1;
+      return;
+    }
+  if (!copy_in (fds, (const void *) args[0], cnt * sizeof *fds))
+    kill_process ();
+
+  poll_register (&w, timeout_ms > 0
+                 ? (int64_t) timeout_ms * TIMER_FREQ / 1000 + 1 : 0);
+  while ((ready = poll_scan (fds, cnt)) == 0
+         && timeout_ms != 0 && poll_block (&w))
+    continue;
+  poll_unregister (&w);
+
+  if (!copy_out ((void *) args[0], fds, cnt * sizeof *fds))
+    kill_process ();
+  f->eax = ready;
+}
@@ -2,5 +2,7 @@
 #define USERPROG_SYSCALL_H
 
 void syscall_init (void);
+void syscall_print_stats (void);
+const char *syscall_name (int nr);
 
 #endif /* userprog/syscall.h */
@@ -2,6 +2,10 @@
 #include <debug.h>
 #include <stddef.h>
 #include "userprog/gdt.h"
+#include "threads/flags.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/kstack.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
 #include "threads/thread.h"
@@ -75,6 +79,17 @@ struct tss
 /* Kernel TSS. */
 static struct tss *tss;
 
+/* TSS for the double fault task.  A kernel stack that overflows
+   into its guard page cannot take the resulting page fault,
+   because the CPU has nowhere to push the interrupt frame, so it
+   raises a double fault instead, and if that were handled on the
+   same stack too, the machine would reset.  The double fault
+   exception therefore goes through a task gate, which switches
+   to this TSS and so to a stack of its own. */
+static struct tss *df_tss;
+
+static void double_fault (void) NO_RETURN;
+
 /* Initializes the kernel TSS. */
 void
 tss_init (void) 
@@ -86,6 +101,18 @@ tss_init (void)
   tss->ss0 = SEL_KDSEG;
   tss->bitmap = 0xdfff;
   tss_update ();
+
+  /* The double fault task runs double_fault() on the rest of
+     DF_TSS's page. */
+  df_tss = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  df_tss->cr3 = vtop (base_page_dir);
+  df_tss->eip = double_fault;
+  df_tss->eflags = FLAG_MBS;
+  df_tss->esp = (uint32_t) df_tss + PGSIZE;
+  df_tss->cs = SEL_KCSEG;
+  df_tss->ss = df_tss->ds = df_tss->es = SEL_KDSEG;
+  df_tss->fs = df_tss->gs = SEL_KDSEG;
+  df_tss->bitmap = 0xdfff;
 }
 
 /* Returns the kernel TSS. */
@@ -96,11 +123,43 @@ tss_get (void)
   return tss;
 }
 
+/* Returns the TSS of the double fault task. */
+struct tss *
+tss_get_double_fault (void) 
+{
+  ASSERT (df_tss != NULL);
+  return df_tss;
+}
+
+/* Runs as the double fault task.  The switch to it saved the
+   faulting state in the kernel TSS.  If there was no room left
+   above the guard page for an interrupt frame, the fault was a
+   kernel stack overflow. */
+static void
+double_fault (void) 
+{
+  uint8_t *esp = (uint8_t *) tss->esp;
+
+  PANIC ("double fault at eip %p with esp %p%s",
+         (void *) tss->eip, esp,
+         kstack_is_guard (esp - sizeof (struct intr_frame))
+         ? ": kernel stack overflow" : "");
+}
+
+/* Returns the address of the TSS's esp0 member, which always
+   holds the top of the running thread's kernel stack. */
+void **
+tss_get_esp0 (void)
+{
+  ASSERT (tss != NULL);
+  return &tss->esp0;
+}
+
 /* Sets the ring 0 stack pointer in the TSS to point to the end
    of the thread stack. */
 void
 tss_update (void) 
 {
   ASSERT (tss != NULL);
-  tss->esp0 = (uint8_t *) thread_current () + PGSIZE;
+  tss->esp0 = thread_stack_top (thread_current ());
 }
@@ -0,0 +1,718 @@
+/* pintos-mkfs, a utility for building and checking Pintos file
+   system images on the host.
+
+   Building an image does on the host what "pintos -f" followed by
+   a series of "pintos -p" does in the kernel: it formats the disk
+   and copies files into its root directory.  The image can then
+   be attached with --fs-disk and booted without -f.  Checking an
+   image walks every inode reachable from the root directory,
+   through its subdirectories, and compares the sectors in use
+   against the free map.
+
+   The on-disk structures below must match filesys/inode.c,
+   filesys/directory.c, filesys/free-map.c and filesys/journal.c.
+   Compiled for the host, so everything is declared with explicit
+   widths that match the 32-bit kernel. */
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define SECTOR_SIZE 512
+
+/* filesys/filesys.h. */
+#define FREE_MAP_SECTOR 0
+#define ROOT_DIR_SECTOR 1
+#define JOURNAL_SECTOR 2
+
+/* filesys/journal.h. */
+#define JOURNAL_SECTORS 33
+
+/* filesys/directory.h and the root directory size given to
+   dir_create() by filesys/filesys.c, not counting "." and
+   "..". */
+#define NAME_MAX 14
+#define ROOT_DIR_ENTRIES 16
+
+/* filesys/inode.c. */
+#define INODE_MAGIC 0x494e4f44
+#define INODE_EXTENTS 0
+#define INODE_INDEXED 1
+#define INODE_INLINE 2
+#define INODE_DIRECT_CNT 122
+#define INODE_PTRS_PER_SECTOR (SECTOR_SIZE / 4)
+#define INODE_EXTENT_CNT 61
+#define INODE_INLINE_MAX 496
+
+struct inode_extent
+  {
+    uint32_t start;
+    uint32_t end;
+  };
+
+struct inode_disk
+  {
+    int32_t length;
+    int32_t init_length;
+    uint32_t magic;
+    uint16_t layout;
+    uint16_t is_dir;
+    union
+      {
+        struct
+          {
+            uint32_t direct[INODE_DIRECT_CNT];
+            uint32_t indirect;
+            uint32_t doubly_indirect;
+          }
+        index;
+        struct
+          {
+            uint32_t cnt;
+            struct inode_extent extents[INODE_EXTENT_CNT];
+          }
+        ext;
+        uint8_t bytes[INODE_INLINE_MAX];
+      };
+  };
+
+struct dir_entry
+  {
+    uint32_t inode_sector;
+    char name[NAME_MAX + 1];
+    uint8_t in_use;
+  };
+
+/* filesys/journal.c. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* The image being built or checked. */
+static FILE *disk;
+static const char *disk_name;
+static uint32_t sector_cnt;
+
+/* Free map being built, or read from the image; one byte per
+   sector. */
+static uint8_t *used;
+
+/* Number of problems found by check. */
+static int error_cnt;
+
+static void
+fail (const char *format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  fprintf (stderr, "pintos-mkfs: ");
+  vfprintf (stderr, format, args);
+  putc ('\n', stderr);
+  va_end (args);
+  exit (EXIT_FAILURE);
+}
+
+/* Reports a problem found while checking the image. */
+static void
+problem (const char *format, ...)
+{
+  va_list args;
+
+  va_start (args, format);
+  printf ("%s: ", disk_name);
+  vprintf (format, args);
+  putchar ('\n');
+  va_end (args);
+  error_cnt++;
+}
+
+static void
+read_sectors (uint32_t sector, uint32_t cnt, void *buffer)
+{
+  if (fseek (disk, (long) sector * SECTOR_SIZE, SEEK_SET) != 0
+      || fread (buffer, SECTOR_SIZE, cnt, disk) != cnt)
+    fail ("%s: read of sector %u failed", disk_name, sector);
+}
+
+static void
+write_sectors (uint32_t sector, uint32_t cnt, const void *buffer)
+{
+  if (fseek (disk, (long) sector * SECTOR_SIZE, SEEK_SET) != 0
+      || fwrite (buffer, SECTOR_SIZE, cnt, disk) != cnt)
+    fail ("%s: write of sector %u failed", disk_name, sector);
+}
+
+static uint32_t
+bytes_to_sectors (uint32_t size)
+{
+  return (size + SECTOR_SIZE - 1) / SECTOR_SIZE;
+}
+
+/* Size in bytes of the free map file, as bitmap_file_size()
+   computes it with 32-bit elements. */
+static uint32_t
+free_map_bytes (void)
+{
+  return (sector_cnt + 31) / 32 * 4;
+}
+
+/* Building. */
+
+/* Allocates CNT consecutive sectors, first fit, as
+   free_map_allocate() does. */
+static uint32_t
+allocate (uint32_t cnt, const char *what)
+{
+  uint32_t start, i;
+
+  for (start = 0; start + cnt <= sector_cnt; start++)
+    {
+      for (i = 0; i < cnt && !used[start + i]; i++)
+        continue;
+      if (i == cnt)
+        {
+          memset (used + start, 1, cnt);
+          return start;
+        }
+      start += i;
+    }
+  fail ("%s: no room for %s (%u sectors)", disk_name, what, cnt);
+  return 0;
+}
+
+/* Writes an inode at SECTOR for a file, or a directory if IS_DIR
+   is true, of LENGTH bytes held in one extent at DATA, all of
+   which is written. */
+static void
+write_inode (uint32_t sector, uint32_t length, uint32_t data, bool is_dir)
+{
+  struct inode_disk inode;
+
+  memset (&inode, 0, sizeof inode);
+  inode.length = length;
+  inode.init_length = length;
+  inode.magic = INODE_MAGIC;
+  inode.layout = INODE_EXTENTS;
+  inode.is_dir = is_dir;
+  if (length > 0)
+    {
+      inode.ext.cnt = 1;
+      inode.ext.extents[0].start = data;
+      inode.ext.extents[0].end = bytes_to_sectors (length);
+    }
+  write_sectors (sector, 1, &inode);
+}
+
+/* Writes LENGTH bytes from BUFFER to the sectors starting at
+   DATA, padding the last one with zeros. */
+static void
+write_data (uint32_t data, const void *buffer, uint32_t length)
+{
+  uint32_t cnt = bytes_to_sectors (length);
+  uint8_t *padded;
+
+  if (cnt == 0)
+    return;
+  padded = calloc (cnt, SECTOR_SIZE);
+  if (padded == NULL)
+    fail ("out of memory");
+  memcpy (padded, buffer, length);
+  write_sectors (data, cnt, padded);
+  free (padded);
+}
+
+/* Reads host file FILE_NAME into a new buffer and stores its size
+   in *SIZE. */
+static void *
+slurp (const char *file_name, uint32_t *size)
+{
+  FILE *f = fopen (file_name, "rb");
+  struct stat st;
+  void *buffer;
+
+  if (f == NULL || fstat (fileno (f), &st) != 0)
+    fail ("%s: %s", file_name, strerror (errno));
+  buffer = malloc (st.st_size > 0 ? st.st_size : 1);
+  if (buffer == NULL)
+    fail ("out of memory");
+  if (fread (buffer, 1, st.st_size, f) != (size_t) st.st_size)
+    fail ("%s: read failed", file_name);
+  fclose (f);
+  *size = st.st_size;
+  return buffer;
+}
+
+/* Formats the image and copies the FILE_CNT host files in FILES
+   into its root directory, under their base names. */
+static void
+build (char **files, int file_cnt)
+{
+  uint32_t dir_cnt = (file_cnt > ROOT_DIR_ENTRIES ? file_cnt : ROOT_DIR_ENTRIES)
+                     + 2;
+  uint32_t dir_bytes = dir_cnt * sizeof (struct dir_entry);
+  struct dir_entry *entries = calloc (dir_cnt, sizeof *entries);
+  uint8_t zeros[SECTOR_SIZE];
+  uint32_t map_bytes = free_map_bytes ();
+  uint32_t map_data, dir_data, i;
+  uint8_t *map;
+  int f;
+
+  if (entries == NULL)
+    fail ("out of memory");
+
+  /* Reserve the fixed sectors, then lay out the free map and root
+     directory in the order do_format() creates them. */
+  used[FREE_MAP_SECTOR] = used[ROOT_DIR_SECTOR] = 1;
+  memset (used + JOURNAL_SECTOR, 1, JOURNAL_SECTORS);
+  map_data = allocate (bytes_to_sectors (map_bytes), "free map");
+  dir_data = allocate (bytes_to_sectors (dir_bytes), "root directory");
+
+  /* "." and ".." of the root both refer to the root. */
+  for (i = 0; i < 2; i++)
+    {
+      entries[i].inode_sector = ROOT_DIR_SECTOR;
+      strcpy (entries[i].name, i == 0 ? "." : "..");
+      entries[i].in_use = 1;
+    }
+
+  /* Copy the files, after "." and "..". */
+  for (f = 0; f < file_cnt; f++)
+    {
+      struct dir_entry *e = &entries[f + 2];
+      const char *name = strrchr (files[f], '/');
+      uint32_t size, inode_sector, data = 0;
+      void *buffer;
+
+      name = name != NULL ? name + 1 : files[f];
+      if (strlen (name) == 0 || strlen (name) > NAME_MAX)
+        fail ("%s: name must be 1 to %d characters long", name, NAME_MAX);
+      if (!strcmp (name, ".") || !strcmp (name, ".."))
+        fail ("%s: reserved file name", name);
+      for (i = 2; i < (uint32_t) f + 2; i++)
+        if (!strcmp (entries[i].name, name))
+          fail ("%s: duplicate file name", name);
+
+      buffer = slurp (files[f], &size);
+      inode_sector = allocate (1, name);
+      if (size > 0)
+        data = allocate (bytes_to_sectors (size), name);
+      write_inode (inode_sector, size, data, false);
+      write_data (data, buffer, size);
+      free (buffer);
+
+      e->inode_sector = inode_sector;
+      strcpy (e->name, name);
+      e->in_use = 1;
+      printf ("%s: %u bytes\n", name, size);
+    }
+
+  /* Root directory. */
+  write_inode (ROOT_DIR_SECTOR, dir_bytes, dir_data, true);
+  write_data (dir_data, entries, dir_bytes);
+  free (entries);
+
+  /* Free map, as bitmap_write() lays it out. */
+  map = calloc (1, map_bytes);
+  if (map == NULL)
+    fail ("out of memory");
+  for (i = 0; i < sector_cnt; i++)
+    if (used[i])
+      map[i / 8] |= 1 << (i % 8);
+  write_inode (FREE_MAP_SECTOR, map_bytes, map_data, false);
+  write_data (map_data, map, map_bytes);
+  free (map);
+
+  /* Empty journal. */
+  memset (zeros, 0, sizeof zeros);
+  write_sectors (JOURNAL_SECTOR, 1, zeros);
+}
+
+/* Checking. */
+
+/* Owner of each sector, for reporting sectors referenced twice:
+   0 if unreferenced, otherwise the referencing inode's sector
+   plus 1. */
+static uint32_t *owner;
+
+/* Records that the inode at INODE_SECTOR refers to SECTOR. */
+static void
+claim (uint32_t sector, uint32_t inode_sector, const char *what)
+{
+  if (sector >= sector_cnt)
+    problem ("inode %u: %s sector %u is past end of disk",
+             inode_sector, what, sector);
+  else if (owner[sector] != 0)
+    problem ("inode %u: %s sector %u is also used by inode %u",
+             inode_sector, what, sector, owner[sector] - 1);
+  else
+    owner[sector] = inode_sector + 1;
+}
+
+/* Claims the index sector SECTOR of the inode at INODE_SECTOR
+   and, through LEVEL levels of index, the next *LEFT data
+   sectors of the file.  Decrements *LEFT for each data sector
+   slot passed, allocated or a hole. */
+static void
+claim_index (uint32_t sector, int level, uint32_t inode_sector,
+             uint32_t *left)
+{
+  uint32_t entries[INODE_PTRS_PER_SECTOR];
+  uint32_t span = level == 1 ? 1 : INODE_PTRS_PER_SECTOR;
+  int i;
+
+  if (sector == 0)
+    {
+      *left = *left > span * INODE_PTRS_PER_SECTOR
+              ? *left - span * INODE_PTRS_PER_SECTOR : 0;
+      return;
+    }
+  claim (sector, inode_sector, "index");
+  if (sector >= sector_cnt)
+    return;
+  read_sectors (sector, 1, entries);
+  for (i = 0; i < INODE_PTRS_PER_SECTOR && *left > 0; i++)
+    {
+      if (level > 1)
+        claim_index (entries[i], level - 1, inode_sector, left);
+      else
+        {
+          if (entries[i] != 0)
+            claim (entries[i], inode_sector, "data");
+          (*left)--;
+        }
+    }
+}
+
+/* Reads and checks the inode at SECTOR and claims every sector it
+   uses.  Stores the inode in *INODE.  Returns false if it is not a
+   valid inode. */
+static bool
+check_inode (uint32_t sector, struct inode_disk *inode)
+{
+  uint32_t data_cnt, i;
+
+  claim (sector, sector, "inode");
+  if (sector >= sector_cnt)
+    return false;
+  read_sectors (sector, 1, inode);
+  if (inode->magic != INODE_MAGIC)
+    {
+      problem ("inode %u: bad magic %#x", sector, inode->magic);
+      return false;
+    }
+  if (inode->length < 0 || inode->init_length < 0
+      || inode->init_length > inode->length)
+    {
+      problem ("inode %u: bad length %d or initialized length %d",
+               sector, inode->length, inode->init_length);
+      return false;
+    }
+  data_cnt = bytes_to_sectors (inode->length);
+
+  if (inode->layout == INODE_EXTENTS)
+    {
+      uint32_t first = 0;
+
+      if (inode->ext.cnt > INODE_EXTENT_CNT)
+        {
+          problem ("inode %u: %u extents", sector, inode->ext.cnt);
+          return false;
+        }
+      for (i = 0; i < inode->ext.cnt; i++)
+        {
+          const struct inode_extent *e = &inode->ext.extents[i];
+          uint32_t s;
+
+          if (e->end <= first)
+            problem ("inode %u: extent %u is empty or out of order",
+                     sector, i);
+          for (s = 0; first + s < e->end; s++)
+            claim (e->start + s, sector, "data");
+          first = e->end > first ? e->end : first;
+        }
+      if (first < data_cnt)
+        problem ("inode %u: extents cover %u of %u sectors",
+                 sector, first, data_cnt);
+    }
+  else if (inode->layout == INODE_INDEXED)
+    {
+      uint32_t left;
+
+      for (i = 0; i < INODE_DIRECT_CNT; i++)
+        if (inode->index.direct[i] != 0)
+          {
+            if (i < data_cnt)
+              claim (inode->index.direct[i], sector, "data");
+            else
+              problem ("inode %u: direct sector %u is past end of file",
+                       sector, i);
+          }
+      left = data_cnt > INODE_DIRECT_CNT ? data_cnt - INODE_DIRECT_CNT : 0;
+      claim_index (inode->index.indirect, 1, sector, &left);
+      claim_index (inode->index.doubly_indirect, 2, sector, &left);
+    }
+  else if (inode->layout == INODE_INLINE)
+    {
+      if (inode->length > INODE_INLINE_MAX
+          || inode->init_length != inode->length)
+        {
+          problem ("inode %u: inline length %d, initialized length %d",
+                   sector, inode->length, inode->init_length);
+          return false;
+        }
+    }
+  else
+    {
+      problem ("inode %u: unknown layout %u", sector, inode->layout);
+      return false;
+    }
+  return true;
+}
+
+/* Reads LENGTH bytes of the file whose inode is INODE into a new
+   buffer, reading holes as zeros. */
+static void *
+read_file (const struct inode_disk *inode)
+{
+  uint32_t cnt = bytes_to_sectors (inode->length);
+  uint8_t *buffer = calloc (cnt > 0 ? cnt : 1, SECTOR_SIZE);
+  uint32_t i;
+
+  if (buffer == NULL)
+    fail ("out of memory");
+  if (inode->layout == INODE_INLINE)
+    {
+      memcpy (buffer, inode->bytes, inode->length);
+      return buffer;
+    }
+  for (i = 0; i < cnt && i * SECTOR_SIZE < (uint32_t) inode->init_length;
+       i++)
+    {
+      uint32_t sector = 0;
+
+      if (inode->layout == INODE_EXTENTS)
+        {
+          uint32_t e, first = 0;
+          for (e = 0; e < inode->ext.cnt; first = inode->ext.extents[e++].end)
+            if (i < inode->ext.extents[e].end)
+              {
+                sector = inode->ext.extents[e].start + (i - first);
+                break;
+              }
+        }
+      else if (i < INODE_DIRECT_CNT)
+        sector = inode->index.direct[i];
+      else
+        {
+          uint32_t idx = i - INODE_DIRECT_CNT, block, entries[INODE_PTRS_PER_SECTOR];
+          if (idx < INODE_PTRS_PER_SECTOR)
+            block = inode->index.indirect;
+          else
+            {
+              idx -= INODE_PTRS_PER_SECTOR;
+              block = inode->index.doubly_indirect;
+              if (block != 0 && block < sector_cnt)
+                {
+                  read_sectors (block, 1, entries);
+                  block = entries[idx / INODE_PTRS_PER_SECTOR];
+                }
+              idx %= INODE_PTRS_PER_SECTOR;
+            }
+          if (block != 0 && block < sector_cnt)
+            {
+              read_sectors (block, 1, entries);
+              sector = entries[idx];
+            }
+        }
+      if (sector != 0 && sector < sector_cnt)
+        read_sectors (sector, 1, buffer + i * SECTOR_SIZE);
+    }
+  memset (buffer + inode->init_length, 0,
+          cnt * SECTOR_SIZE - inode->init_length);
+  return buffer;
+}
+
+/* Checks the entries of the directory at SECTOR, whose inode,
+   already checked, is INODE and whose parent is at PARENT, and
+   every file and directory below it.  PATH is the directory's
+   name, for printing.  Adds the number of files found to
+   *FILE_CNT. */
+static void
+check_dir (uint32_t sector, const struct inode_disk *inode, uint32_t parent,
+           const char *path, uint32_t *file_cnt)
+{
+  struct dir_entry *entries = read_file (inode);
+  uint32_t cnt = inode->length / sizeof *entries;
+  bool dot = false, dotdot = false;
+  uint32_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct dir_entry *e = &entries[i];
+      struct inode_disk child;
+      char child_path[1024];
+
+      if (!e->in_use)
+        continue;
+      if (memchr (e->name, '\0', sizeof e->name) == NULL)
+        {
+          problem ("%s: entry %u: name is not terminated", path, i);
+          continue;
+        }
+      if (!strcmp (e->name, ".") || !strcmp (e->name, ".."))
+        {
+          bool is_dot = e->name[1] == '\0';
+          if (e->inode_sector != (is_dot ? sector : parent))
+            problem ("%s: \"%s\" refers to inode %u, should be %u",
+                     path, e->name, e->inode_sector,
+                     is_dot ? sector : parent);
+          *(is_dot ? &dot : &dotdot) = true;
+          continue;
+        }
+
+      snprintf (child_path, sizeof child_path, "%s%s%s", path,
+                path[strlen (path) - 1] == '/' ? "" : "/", e->name);
+      if (e->inode_sector < sector_cnt && owner[e->inode_sector] != 0)
+        {
+          /* Referenced twice; also guards against cycles. */
+          claim (e->inode_sector, sector, "inode");
+          continue;
+        }
+      if (!check_inode (e->inode_sector, &child))
+        continue;
+      if (child.is_dir)
+        {
+          printf ("%-28s directory\n", child_path);
+          check_dir (e->inode_sector, &child, sector, child_path, file_cnt);
+        }
+      else
+        {
+          printf ("%-28s %8d bytes%s\n", child_path, child.length,
+                  child.layout == INODE_INDEXED ? ", indexed" : "");
+          (*file_cnt)++;
+        }
+    }
+  if (!dot || !dotdot)
+    problem ("%s: \".\" or \"..\" is missing", path);
+  free (entries);
+}
+
+/* Checks the image and returns the number of problems found. */
+static int
+check (void)
+{
+  struct inode_disk map_inode, dir_inode;
+  uint32_t i, file_cnt = 0;
+  uint32_t header[4];
+
+  owner = calloc (sector_cnt, sizeof *owner);
+  if (owner == NULL)
+    fail ("out of memory");
+
+  /* Journal. */
+  for (i = 0; i < JOURNAL_SECTORS; i++)
+    claim (JOURNAL_SECTOR + i, JOURNAL_SECTOR, "journal");
+  read_sectors (JOURNAL_SECTOR, 1, header);
+  if (header[0] == JOURNAL_MAGIC)
+    printf ("%s: journal holds transaction %u of %u sectors, "
+            "to be replayed at boot\n", disk_name, header[1], header[2]);
+
+  /* Free map. */
+  if (!check_inode (FREE_MAP_SECTOR, &map_inode))
+    fail ("%s: free map inode is damaged", disk_name);
+  if ((uint32_t) map_inode.length < free_map_bytes ())
+    problem ("free map is %d bytes, should be %u",
+             map_inode.length, free_map_bytes ());
+  else
+    {
+      uint8_t *map = read_file (&map_inode);
+      for (i = 0; i < sector_cnt; i++)
+        used[i] = (map[i / 8] >> (i % 8)) & 1;
+      free (map);
+    }
+
+  /* Root directory and everything below it. */
+  if (!check_inode (ROOT_DIR_SECTOR, &dir_inode) || !dir_inode.is_dir)
+    fail ("%s: root directory inode is damaged", disk_name);
+  check_dir (ROOT_DIR_SECTOR, &dir_inode, ROOT_DIR_SECTOR, "/", &file_cnt);
+
+  /* Compare with the free map. */
+  for (i = 0; i < sector_cnt; i++)
+    if (owner[i] != 0 && !used[i])
+      problem ("sector %u is in use by inode %u but marked free",
+               i, owner[i] - 1);
+    else if (owner[i] == 0 && used[i])
+      problem ("sector %u is marked in use but is not referenced", i);
+
+  printf ("%s: %u files, %d problems\n", disk_name, file_cnt, error_cnt);
+  free (owner);
+  return error_cnt;
+}
+
+static void
+usage (int exit_code)
+{
+  printf ("pintos-mkfs, a utility for building and checking Pintos "
+          "file system images\n"
+          "Usage: pintos-mkfs DISK [FILE...]\n"
+          "       pintos-mkfs -c DISK\n"
+          "where DISK is a disk made by pintos-mkdisk.  The first form\n"
+          "formats DISK and copies each host FILE into its root "
+          "directory,\n"
+          "under the file's base name, as \"pintos -f -p\" would; "
+          "boot it\n"
+          "with --fs-disk=DISK and without -f.  The second form checks "
+          "DISK.\n"
+          "Options:\n"
+          "  -c, --check       Check DISK instead of building it.\n"
+          "  -h, --help        Display this help message.\n");
+  exit (exit_code);
+}
+
+int
+main (int argc, char *argv[])
+{
+  bool check_only = false;
+  struct stat st;
+  int arg = 1;
+
+  if (sizeof (struct inode_disk) != SECTOR_SIZE
+      || sizeof (struct dir_entry) != 20)
+    fail ("on-disk structures have the wrong size for this host");
+
+  if (arg < argc && (!strcmp (argv[arg], "-h")
+                     || !strcmp (argv[arg], "--help")))
+    usage (EXIT_SUCCESS);
+  if (arg < argc && (!strcmp (argv[arg], "-c")
+                     || !strcmp (argv[arg], "--check")))
+    {
+      check_only = true;
+      arg++;
+    }
+  if (arg >= argc || (check_only && argc - arg != 1))
+    usage (EXIT_FAILURE);
+
+  disk_name = argv[arg++];
+  disk = fopen (disk_name, check_only ? "rb" : "r+b");
+  if (disk == NULL || fstat (fileno (disk), &st) != 0)
+    fail ("%s: %s", disk_name, strerror (errno));
+  sector_cnt = st.st_size / SECTOR_SIZE;
+  if (sector_cnt < JOURNAL_SECTOR + JOURNAL_SECTORS + 2)
+    fail ("%s: disk is too small", disk_name);
+
+  used = calloc (sector_cnt, 1);
+  if (used == NULL)
+    fail ("out of memory");
+
+  if (check_only)
+    return check () == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+  build (argv + arg, argc - arg);
+  if (fclose (disk) != 0)
+    fail ("%s: %s", disk_name, strerror (errno));
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,834 @@
+#include "vm/frame.h"
+#include <debug.h>
+#include <stats.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+#include "vm/swap.h"
+
+/* Every frame holding a user page, in clock order. */
+static struct list frames;
+
+/* The clock hand: next frame to consider for eviction, or the
+   list's tail when it should wrap around. */
+static struct list_elem *hand;
+
+/* Frames holding unchanged file pages, keyed by inode, offset and
+   length, so processes running the same executable can share
+   them, and file reads can be served from them: the page
+   cache. */
+static struct hash shared_frames;
+
+/* Shared frames kept with no pages, in the order they were
+   left. */
+static struct list kept_frames;
+
+/* A page of zeros, mapped copy-on-write by every all-zero page
+   that is read before it is written.  It is permanently pinned and
+   not in FRAMES, so it is never evicted or freed. */
+static struct frame zero_frame;
+
+/* Protects FRAMES, HAND, SHARED_FRAMES, and each frame's PAGES and
+   PIN_CNT. */
+static struct lock frame_lock;
+
+/* Statistics. */
+static long long evict_cnt;     /* Frames evicted. */
+static long long share_cnt;     /* Faults satisfied by a shared frame. */
+static long long zero_cnt;      /* Faults satisfied by the zero frame. */
+static long long reclaim_cnt;   /* Frames freed by the evictor thread. */
+static long long revive_cnt;    /* Shared faults that found a kept frame. */
+static long long cache_hit_cnt; /* Pages read from the page cache. */
+static long long cache_fill_cnt; /* Pages put in it by reads. */
+
+/* Wakes the evictor thread.  EVICT_WANTED keeps the semaphore from
+   piling up ups while the thread is already busy. */
+static struct semaphore evict_sema;
+static volatile bool evict_wanted;
+
+/* Room for the most frames evicted at once.  Batches are cut to
+   SWAP_CLUSTER frames, the swap cluster size in use. */
+#define EVICT_BATCH SWAP_CLUSTER_MAX
+
+static void frame_put (struct frame *);
+static struct inode *frame_unshare (struct frame *);
+static palloc_pressure_func wake_evictor;
+static thread_func evictor;
+static hash_hash_func share_hash;
+static hash_less_func share_less;
+static inode_page_read_func frame_cache_read;
+
+/* Initializes the frame table. */
+void
+frame_init (void)
+{
+  list_init (&frames);
+  hand = list_end (&frames);
+  list_init (&kept_frames);
+  if (!hash_init_incremental (&shared_frames, share_hash, share_less, NULL))
+    PANIC ("frame: shared frame table creation failed");
+  lock_init_named (&frame_lock, "frame");
+
+  zero_frame.kpage = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  list_init (&zero_frame.pages);
+  zero_frame.pin_cnt = 1;
+  zero_frame.inode = NULL;
+  zero_frame.referenced = false;
+
+  sema_init (&evict_sema, 0);
+  evict_wanted = true;
+  thread_create_daemon ("evictor", PRI_DEFAULT, evictor, NULL);
+  palloc_set_pressure_hook (wake_evictor);
+  inode_set_page_cache (frame_cache_read);
+}
+
+/* Prints frame table statistics. */
+void
+frame_print_stats (void)
+{
+  printf ("Frames: %zu in use, %zu shared, %lld evictions, "
+          "%lld shared faults\n",
+          list_size (&frames), hash_size (&shared_frames),
+          evict_cnt, share_cnt);
+  printf ("Zero frame: %zu pages mapped, %lld faults\n",
+          list_size (&zero_frame.pages), zero_cnt);
+  printf ("Evictor: %lld frames freed ahead of need\n", reclaim_cnt);
+  printf ("Kept frames: %zu now, %lld shared faults found one\n",
+          list_size (&kept_frames), revive_cnt);
+  printf ("Page cache: %lld pages read from it, %lld put in by reads\n",
+          cache_hit_cnt, cache_fill_cnt);
+}
+
+/* Fills in the frame fields of *S. */
+void
+frame_get_stats (struct stats *s)
+{
+  lock_acquire (&frame_lock);
+  s->frame_cnt = list_size (&frames);
+  s->evict_cnt = evict_cnt;
+  s->reclaim_cnt = reclaim_cnt;
+  lock_release (&frame_lock);
+}
+
+/* Advances the clock hand and returns the frame it passed. */
+static struct frame *
+clock_next (void)
+{
+  struct frame *f;
+
+  if (hand == list_end (&frames))
+    hand = list_begin (&frames);
+  ASSERT (hand != list_end (&frames));
+
+  f = list_entry (hand, struct frame, elem);
+  hand = list_next (hand);
+  return f;
+}
+
+/* Releases the locks of F's pages, up to but not including STOP. */
+static void
+unlock_pages (struct frame *f, struct list_elem *stop)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != stop; e = list_next (e))
+    lock_release (&list_entry (e, struct page, frame_elem)->lock);
+}
+
+/* Tries to lock every page mapped to F, without waiting.  Returns
+   true if all were locked, false with none locked otherwise. */
+static bool
+lock_pages (struct frame *f)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    if (!lock_try_acquire (&list_entry (e, struct page, frame_elem)->lock))
+      {
+        unlock_pages (f, e);
+        return false;
+      }
+  return true;
+}
+
+/* Returns true if any page mapped to F was accessed since the
+   last call, clearing the accessed bits. */
+static bool
+test_and_clear_accessed (struct frame *f)
+{
+  struct list_elem *e;
+  bool accessed = false;
+
+  for (e = list_begin (&f->pages); e != list_end (&f->pages);
+       e = list_next (e))
+    {
+      struct page *p = list_entry (e, struct page, frame_elem);
+      uint32_t *pd = p->owner->pagedir;
+
+      if (pagedir_test_and_clear_accessed (pd, p->upage))
+        accessed = true;
+    }
+  return accessed;
+}
+
+/* Picks a frame to evict with the clock algorithm: frames whose
+   pages were accessed, or that a file read used, since the hand
+   last passed get a second chance, while a kept frame, with no
+   pages, goes at once otherwise.
+   Pinned frames and frames with a page that is busy being loaded
+   or freed are skipped.  Returns the frame, pinned, out of the
+   shared frame table, and with all its pages' locks held, or a
+   null pointer if no frame can be evicted.  Stores the inode the
+   frame held in *INODEP, for the caller to close once it releases
+   FRAME_LOCK, or a null pointer.  FRAME_LOCK must be held. */
+static struct frame *
+pick_victim (struct inode **inodep)
+{
+  size_t i, n = 2 * list_size (&frames);
+
+  for (i = 0; i < n; i++)
+    {
+      struct frame *f = clock_next ();
+      bool referenced;
+
+      if (f->pin_cnt > 0 || (list_empty (&f->pages) && f->inode == NULL)
+          || !lock_pages (f))
+        continue;
+      referenced = f->referenced;
+      f->referenced = false;
+      if (test_and_clear_accessed (f) || referenced)
+        {
+          unlock_pages (f, list_end (&f->pages));
+          continue;
+        }
+      if (list_empty (&f->pages))
+        list_remove (&f->kept_elem);
+      f->pin_cnt++;
+      *inodep = frame_unshare (f);
+      return f;
+    }
+  return NULL;
+}
+
+/* Returns a frame for page P from the free part of the user pool,
+   pinned as frame_alloc() leaves it, or a null pointer if the
+   pool is exhausted.  Never evicts, so it is cheap enough to call
+   on speculation. */
+struct frame *
+frame_try_alloc (struct page *p)
+{
+  struct frame *f;
+  void *kpage = palloc_get_page (PAL_USER);
+
+  if (kpage == NULL)
+    return NULL;
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      return NULL;
+    }
+  f->kpage = kpage;
+  list_init (&f->pages);
+  list_push_back (&f->pages, &p->frame_elem);
+  f->pin_cnt = 1;
+  f->inode = NULL;
+  f->referenced = false;
+  lock_acquire (&frame_lock);
+  list_push_back (&frames, &f->elem);
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Evicts up to SWAP_CLUSTER frames at once, as chosen by the clock,
+   and stores them in VICTIMS, pinned and with their pages' locks
+   still held.  Evicting several together lets the dirty ones go
+   to adjacent swap slots in one disk command, to be read back the
+   same way.  The clock only picks frames not accessed since it
+   last passed, so the batch comes out of memory that is not in
+   anyone's working set.  Returns the number of frames evicted. */
+static size_t
+evict_batch (struct frame **victims)
+{
+  struct page *dirty[EVICT_BATCH];
+  void *kpages[EVICT_BATCH];
+  size_t slots[EVICT_BATCH];
+  struct inode *inodes[EVICT_BATCH];
+  size_t victim_cnt, dirty_cnt, evicted, i;
+
+  lock_acquire (&frame_lock);
+  for (victim_cnt = 0; victim_cnt < (size_t) swap_cluster; victim_cnt++)
+    {
+      victims[victim_cnt] = pick_victim (&inodes[victim_cnt]);
+      if (victims[victim_cnt] == NULL)
+        break;
+    }
+  lock_release (&frame_lock);
+  for (i = 0; i < victim_cnt; i++)
+    inode_close (inodes[i]);
+
+  /* Saving the old contents may mean disk I/O, so it is done
+     without FRAME_LOCK; the pins and the pages' locks keep the
+     frames ours.  Only a private page can need swap, since a
+     shared page is read-only, and a private frame has just the
+     one page. */
+  dirty_cnt = 0;
+  for (i = 0; i < victim_cnt; i++)
+    {
+      struct list_elem *e;
+
+      for (e = list_begin (&victims[i]->pages);
+           e != list_end (&victims[i]->pages); e = list_next (e))
+        {
+          struct page *p = list_entry (e, struct page, frame_elem);
+          if (page_evict_begin (p))
+            {
+              ASSERT (e == list_begin (&victims[i]->pages));
+              dirty[dirty_cnt] = p;
+              kpages[dirty_cnt++] = victims[i]->kpage;
+            }
+        }
+    }
+  swap_out_cluster (kpages, dirty_cnt, slots);
+  for (i = 0; i < dirty_cnt; i++)
+    page_evict_finish (dirty[i], slots[i]);
+
+  /* Frames whose page did not fit in swap stay as they were. */
+  evicted = 0;
+  for (i = 0; i < victim_cnt; i++)
+    {
+      struct frame *f = victims[i];
+
+      if (list_empty (&f->pages)
+          || list_entry (list_begin (&f->pages),
+                         struct page, frame_elem)->frame == NULL)
+        victims[evicted++] = f;
+      else
+        {
+          unlock_pages (f, list_end (&f->pages));
+          frame_unpin (f);
+        }
+    }
+
+  lock_acquire (&frame_lock);
+  evict_cnt += evicted;
+  lock_release (&frame_lock);
+  return evicted;
+}
+
+/* Detaches the pages of evicted frame F, releasing their locks.
+   FRAME_LOCK must be held. */
+static void
+detach_pages (struct frame *f)
+{
+  while (!list_empty (&f->pages))
+    lock_release (&list_entry (list_pop_front (&f->pages),
+                               struct page, frame_elem)->lock);
+}
+
+/* Frees the CNT frames at VICTIMS, evicted by evict_batch(), back
+   to the user pool. */
+static void
+free_victims (struct frame **victims, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      lock_acquire (&frame_lock);
+      detach_pages (victims[i]);
+      victims[i]->pin_cnt--;
+      frame_put (victims[i]);
+    }
+}
+
+/* Returns a frame for page P, evicting other frames if the user
+   pool is exhausted.  The frame is pinned, so that it is not
+   evicted before the caller fills and maps it; call frame_unpin()
+   then.  Returns a null pointer if no frame can be had. */
+struct frame *
+frame_alloc (struct page *p)
+{
+  struct frame *victims[EVICT_BATCH];
+  struct frame *f;
+  size_t cnt;
+
+  f = frame_try_alloc (p);
+  if (f != NULL)
+    return f;
+
+  cnt = evict_batch (victims);
+  if (cnt == 0)
+    return NULL;
+
+  /* P takes the first frame.  The rest go back to the user pool,
+     for the faults that are likely to follow. */
+  f = victims[0];
+  lock_acquire (&frame_lock);
+  detach_pages (f);
+  list_push_back (&f->pages, &p->frame_elem);
+  lock_release (&frame_lock);
+  free_victims (victims + 1, cnt - 1);
+  return f;
+}
+
+/* Pressure hook: wakes the evictor thread. */
+static void
+wake_evictor (void)
+{
+  if (!evict_wanted)
+    {
+      evict_wanted = true;
+      sema_up (&evict_sema);
+    }
+}
+
+/* Evictor thread.  Woken when the user pool falls below its low
+   watermark, it evicts frames in batches until twice that much is
+   free again, so that faulting threads and exec find free frames
+   instead of each evicting its own on the spot. */
+static void
+evictor (void *aux UNUSED)
+{
+  for (;;)
+    {
+      evict_wanted = false;
+      while (palloc_user_free () < 2 * palloc_user_low)
+        {
+          struct frame *victims[EVICT_BATCH];
+          size_t cnt = evict_batch (victims);
+
+          if (cnt == 0)
+            break;
+          free_victims (victims, cnt);
+          lock_acquire (&frame_lock);
+          reclaim_cnt += cnt;
+          lock_release (&frame_lock);
+        }
+      sema_down (&evict_sema);
+    }
+}
+
+/* Takes frame F out of the shared frame table, if it is there,
+   and returns the inode it held, for the caller to close once it
+   releases FRAME_LOCK, or a null pointer.  FRAME_LOCK must be
+   held. */
+static struct inode *
+frame_unshare (struct frame *f)
+{
+  struct inode *inode = f->inode;
+
+  if (inode != NULL)
+    {
+      hash_delete (&shared_frames, &f->share_elem);
+      f->inode = NULL;
+    }
+  return inode;
+}
+
+/* Removes frame F from the frame list and the shared frame table,
+   and returns what frame_unshare() does.  FRAME_LOCK must be
+   held. */
+static struct inode *
+frame_unlink (struct frame *f)
+{
+  if (hand == &f->elem)
+    hand = list_next (hand);
+  list_remove (&f->elem);
+  return frame_unshare (f);
+}
+
+/* Frees frame F and its memory.  F's one page must already be
+   unmapped. */
+void
+frame_free (struct frame *f)
+{
+  struct inode *inode;
+
+  lock_acquire (&frame_lock);
+  inode = frame_unlink (f);
+  lock_release (&frame_lock);
+
+  inode_close (inode);
+  palloc_free_page (f->kpage);
+  free (f);
+}
+
+/* Returns a hash of the file data that frame F holds. */
+static inline unsigned
+share_key_hash (const struct frame *f)
+{
+  return hash_int ((int) f->inode) ^ hash_int (f->ofs);
+}
+
+/* Returns true if frames A and B hold the same file data. */
+static inline bool
+share_equal (const struct frame *a, const struct frame *b)
+{
+  return (a->inode == b->inode && a->ofs == b->ofs
+          && a->read_bytes == b->read_bytes);
+}
+
+DEFINE_HASH_FIND (share_lookup, struct frame, share_elem,
+                  const struct frame *, share_key_hash, share_equal);
+
+/* Looks for a frame that already holds the file data of page P,
+   which must be unchanged.  If there is one, adds P to it and
+   returns it, pinned; the caller maps it, copy-on-write if P is
+   writable, and then unpins it.  Otherwise returns a null
+   pointer. */
+struct frame *
+frame_share_find (struct page *p)
+{
+  struct frame key;
+  struct frame *f = NULL;
+  bool kept;
+
+  ASSERT (p->file != NULL && !p->modified && !p->mapped);
+
+  key.inode = file_get_inode (p->file);
+  key.ofs = p->ofs;
+  key.read_bytes = p->read_bytes;
+
+  lock_acquire (&frame_lock);
+  f = share_lookup (&shared_frames, &key);
+  if (f != NULL)
+    {
+      kept = list_empty (&f->pages) && f->pin_cnt == 0;
+      if (kept)
+        list_remove (&f->kept_elem);
+      if (f->write_cnt != inode_write_cnt (key.inode))
+        {
+          /* The file was written after every process running it
+             had exited.  F is out of date, so drop it. */
+          struct inode *inode = frame_unshare (f);
+          frame_put (f);
+          inode_close (inode);
+          return NULL;
+        }
+      if (kept)
+        revive_cnt++;
+      list_push_back (&f->pages, &p->frame_elem);
+      f->pin_cnt++;
+      share_cnt++;
+    }
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Makes frame F, just filled with the file data of its one page,
+   available to other processes.  The page must be mapped
+   read-only or copy-on-write, so that the data stays unchanged.
+   If another process got there first, F simply stays private. */
+void
+frame_share_add (struct frame *f)
+{
+  struct page *p = list_entry (list_front (&f->pages),
+                               struct page, frame_elem);
+  struct inode *inode = inode_reopen (file_get_inode (p->file));
+
+  ASSERT (p->file != NULL && !p->modified && !p->mapped);
+
+  lock_acquire (&frame_lock);
+  f->inode = inode;
+  f->ofs = p->ofs;
+  f->read_bytes = p->read_bytes;
+  f->write_cnt = inode_write_cnt (inode);
+  if (hash_insert (&shared_frames, &f->share_elem) == NULL)
+    inode = NULL;
+  else
+    f->inode = NULL;
+  lock_release (&frame_lock);
+  inode_close (inode);
+}
+
+/* Returns the up-to-date shared frame that holds the READ_BYTES
+   bytes of INODE at OFS, pinned and marked referenced, or a null
+   pointer if there is none. */
+static struct frame *
+cache_find (struct inode *inode, off_t ofs, size_t read_bytes)
+{
+  struct frame key;
+  struct frame *f;
+
+  key.inode = inode;
+  key.ofs = ofs;
+  key.read_bytes = read_bytes;
+
+  lock_acquire (&frame_lock);
+  f = share_lookup (&shared_frames, &key);
+  if (f != NULL && f->write_cnt == inode_write_cnt (inode))
+    {
+      if (list_empty (&f->pages) && f->pin_cnt == 0)
+        list_remove (&f->kept_elem);
+      f->pin_cnt++;
+      f->referenced = true;
+      cache_hit_cnt++;
+    }
+  else
+    f = NULL;
+  lock_release (&frame_lock);
+  return f;
+}
+
+/* Reads the READ_BYTES bytes of INODE at OFS, OFS a multiple of
+   PGSIZE, into a new shared frame with no pages, and returns it,
+   pinned, or a null pointer if the user pool is under pressure,
+   memory is short, the read fails, or another thread got there
+   first.  A read never evicts anything to make room, so that
+   streaming through a big file does not push out the pages
+   processes are using. */
+static struct frame *
+cache_fill (struct inode *inode, off_t ofs, size_t read_bytes)
+{
+  struct frame *f;
+  void *kpage;
+
+  if (palloc_user_free () <= palloc_user_low)
+    return NULL;
+  kpage = palloc_get_page (PAL_USER);
+  if (kpage == NULL)
+    return NULL;
+  f = malloc (sizeof *f);
+  if (f == NULL)
+    {
+      palloc_free_page (kpage);
+      return NULL;
+    }
+
+  f->kpage = kpage;
+  list_init (&f->pages);
+  f->pin_cnt = 1;
+  f->inode = inode_reopen (inode);
+  f->ofs = ofs;
+  f->read_bytes = read_bytes;
+  f->write_cnt = inode_write_cnt (inode);
+  f->referenced = true;
+  if (inode_read_through (inode, kpage, read_bytes, ofs) != (off_t) read_bytes)
+    goto fail;
+  memset ((uint8_t *) kpage + read_bytes, 0, PGSIZE - read_bytes);
+  inode_uncache (inode, ofs, read_bytes);
+
+  lock_acquire (&frame_lock);
+  if (hash_insert (&shared_frames, &f->share_elem) != NULL)
+    {
+      lock_release (&frame_lock);
+      goto fail;
+    }
+  list_push_back (&frames, &f->elem);
+  cache_fill_cnt++;
+  lock_release (&frame_lock);
+  return f;
+
+ fail:
+  inode_close (f->inode);
+  palloc_free_page (kpage);
+  free (f);
+  return NULL;
+}
+
+/* Page cache hook for inode_read_at(): copies to BUFFER the SIZE
+   bytes of INODE at OFFSET, a page at a time, up to the end of
+   the file or the first page the page cache does not hold.  A
+   page that the read covers all of is put in the page cache if it
+   is not there yet.  Returns the number of bytes copied. */
+static off_t
+frame_cache_read (struct inode *inode, void *buffer, off_t size,
+                  off_t offset)
+{
+  uint8_t *dst = buffer;
+  off_t length = inode_length (inode);
+  off_t done = 0;
+
+  while (done < size && offset + done < length)
+    {
+      off_t pos = offset + done;
+      off_t page_ofs = pos - pos % PGSIZE;
+      size_t page_bytes = (length - page_ofs < PGSIZE
+                           ? (size_t) (length - page_ofs) : PGSIZE);
+      off_t chunk = page_ofs + page_bytes - pos;
+      struct frame *f;
+
+      if (chunk > size - done)
+        chunk = size - done;
+      f = cache_find (inode, page_ofs, page_bytes);
+      if (f == NULL && pos == page_ofs && (size_t) chunk == page_bytes)
+        f = cache_fill (inode, page_ofs, page_bytes);
+      if (f == NULL)
+        break;
+      memcpy (dst + done, (uint8_t *) f->kpage + (pos - page_ofs), chunk);
+      frame_unpin (f);
+      done += chunk;
+    }
+  return done;
+}
+
+/* Copies the READ_BYTES bytes of INODE at OFS to KPAGE from the
+   page cache, followed by zeros to the end of the page.  Returns false, copying nothing, if the page
+   cache does not hold them. */
+bool
+frame_cache_copy (struct inode *inode, off_t ofs, size_t read_bytes,
+                  void *kpage)
+{
+  struct frame *f = cache_find (inode, ofs, read_bytes);
+
+  if (f == NULL)
+    return false;
+  memcpy (kpage, f->kpage, PGSIZE);
+  frame_unpin (f);
+  return true;
+}
+
+/* Attaches all-zero page P to the zero frame and returns it,
+   pinned.  The caller maps it with pagedir_set_page_cow(), so the
+   first write gives P a frame of its own, and then unpins it. */
+struct frame *
+frame_zero (struct page *p)
+{
+  lock_acquire (&frame_lock);
+  list_push_back (&zero_frame.pages, &p->frame_elem);
+  zero_frame.pin_cnt++;
+  zero_cnt++;
+  lock_release (&frame_lock);
+  return &zero_frame;
+}
+
+/* Returns true if F is the zero frame. */
+bool
+frame_is_zero (const struct frame *f)
+{
+  return f == &zero_frame;
+}
+
+/* Drops F if nothing uses it any more: no page is mapped to it and
+   no one has it pinned.  A shared frame is kept instead, for
+   pick_victim() to free when memory is short, unless its file has
+   been removed.  Otherwise, or if F is the zero frame, does
+   nothing.  FRAME_LOCK must be held on entry and is released. */
+static void
+frame_put (struct frame *f)
+{
+  bool unused = list_empty (&f->pages) && f->pin_cnt == 0;
+  struct inode *inode = NULL;
+
+  if (unused && f->inode != NULL && !inode_is_removed (f->inode))
+    {
+      list_push_back (&kept_frames, &f->kept_elem);
+      unused = false;
+    }
+  if (unused)
+    inode = frame_unlink (f);
+  lock_release (&frame_lock);
+
+  if (unused)
+    {
+      inode_close (inode);
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+}
+
+/* Frees the kept frames of files that have been removed since, so
+   that the files' sectors are freed too.  Called after a file is
+   removed. */
+void
+frame_drop_removed (void)
+{
+  struct list dead;
+  struct list_elem *e, *next;
+
+  list_init (&dead);
+  lock_acquire (&frame_lock);
+  for (e = list_begin (&kept_frames); e != list_end (&kept_frames); e = next)
+    {
+      struct frame *f = list_entry (e, struct frame, kept_elem);
+
+      next = list_next (e);
+      if (inode_is_removed (f->inode))
+        {
+          /* Take F out of every table, so that no one finds it, but
+             leave INODE for closing below. */
+          list_remove (&f->kept_elem);
+          hash_delete (&shared_frames, &f->share_elem);
+          if (hand == &f->elem)
+            hand = list_next (hand);
+          list_remove (&f->elem);
+          list_push_back (&dead, &f->kept_elem);
+        }
+    }
+  lock_release (&frame_lock);
+
+  while (!list_empty (&dead))
+    {
+      struct frame *f = list_entry (list_pop_front (&dead),
+                                    struct frame, kept_elem);
+      inode_close (f->inode);
+      palloc_free_page (f->kpage);
+      free (f);
+    }
+}
+
+/* Detaches page P, already unmapped, from its frame, and frees the
+   frame if nothing else uses it. */
+void
+frame_release (struct page *p)
+{
+  struct frame *f = p->frame;
+
+  lock_acquire (&frame_lock);
+  list_remove (&p->frame_elem);
+  p->frame = NULL;
+  frame_put (f);
+}
+
+/* Keeps frame F from being evicted or freed until frame_unpin(). */
+void
+frame_pin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  f->pin_cnt++;
+  lock_release (&frame_lock);
+}
+
+/* Undoes one frame_pin(), or the pin frame_alloc() returns with,
+   freeing F if nothing else uses it. */
+void
+frame_unpin (struct frame *f)
+{
+  lock_acquire (&frame_lock);
+  ASSERT (f->pin_cnt > 0);
+  f->pin_cnt--;
+  frame_put (f);
+}
+
+/* Returns a hash of the file data in shared frame E. */
+static unsigned
+share_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return share_key_hash (hash_entry (e, struct frame, share_elem));
+}
+
+/* Orders shared frames by inode, then offset, then length. */
+static bool
+share_less (const struct hash_elem *a_, const struct hash_elem *b_,
+            void *aux UNUSED)
+{
+  const struct frame *a = hash_entry (a_, struct frame, share_elem);
+  const struct frame *b = hash_entry (b_, struct frame, share_elem);
+
+  if (a->inode != b->inode)
+    return a->inode < b->inode;
+  if (a->ofs != b->ofs)
+    return a->ofs < b->ofs;
+  return a->read_bytes < b->read_bytes;
+}
@@ -0,0 +1,60 @@
+#ifndef VM_FRAME_H
+#define VM_FRAME_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+
+struct inode;
+struct page;
+struct stats;
+
+/* A frame of physical memory from the user pool, holding one
+   user page.  A page of a file that still holds the file's data
+   may be mapped by several processes at once, all sharing the
+   frame, read-only or copy-on-write.  Such a frame is kept, with
+   no pages mapped, after the last of them is gone, so that the
+   next process to run the same executable finds it in memory;
+   the clock frees it like any other frame that nobody uses.
+   Together these frames are the page cache, which also serves
+   file reads, see frame_cache_read(). */
+struct frame
+  {
+    struct list_elem elem;      /* Element in the frame list. */
+    void *kpage;                /* Kernel virtual address. */
+    struct list pages;          /* Pages mapped to this frame. */
+    int pin_cnt;                /* Exempt from eviction if nonzero. */
+
+    /* For a frame that other processes may share, the file data
+       it holds; INODE is null otherwise.  The frame holds a
+       reference to INODE, so that it cannot be freed and its
+       address reused while the frame may be found. */
+    struct hash_elem share_elem; /* Element in the shared frame table. */
+    struct inode *inode;
+    off_t ofs;
+    size_t read_bytes;
+    unsigned write_cnt;         /* inode_write_cnt() when filled. */
+    struct list_elem kept_elem; /* In the kept frames, if kept. */
+    bool referenced;            /* Read from since the clock passed? */
+  };
+
+void frame_init (void);
+void frame_print_stats (void);
+void frame_get_stats (struct stats *);
+struct frame *frame_alloc (struct page *);
+struct frame *frame_try_alloc (struct page *);
+void frame_free (struct frame *);
+struct frame *frame_zero (struct page *);
+bool frame_is_zero (const struct frame *);
+struct frame *frame_share_find (struct page *);
+void frame_share_add (struct frame *);
+bool frame_cache_copy (struct inode *, off_t ofs, size_t read_bytes,
+                       void *kpage);
+void frame_release (struct page *);
+void frame_drop_removed (void);
+void frame_pin (struct frame *);
+void frame_unpin (struct frame *);
+
+#endif /* vm/frame.h */
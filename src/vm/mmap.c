@@ -0,0 +1,151 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+
+/* A file mapped into a process's address space, one page of the
+   supplemental page table per page of the file.  Pages are read
+   in when first touched and written back when evicted or
+   unmapped. */
+struct mapping
+  {
+    struct list_elem elem;      /* Element in process's mapping list. */
+    mapid_t id;                 /* Mapping identifier. */
+    struct file *file;          /* Private handle on the file. */
+    uint8_t *base;              /* First mapped page. */
+    size_t page_cnt;            /* Number of mapped pages. */
+  };
+
+/* Initializes the current process's mapping list. */
+void
+mmap_init (void)
+{
+  struct process *p = thread_current ()->process;
+
+  list_init (&p->mappings);
+  p->next_mapid = 0;
+}
+
+/* Removes the first PAGE_CNT pages of mapping M from the page
+   table, writing changed pages back to the file. */
+static void
+remove_pages (struct mapping *m, size_t page_cnt)
+{
+  size_t i;
+
+  for (i = 0; i < page_cnt; i++)
+    page_remove (m->base + i * PGSIZE);
+}
+
+/* Maps FILE into the current process's address space starting at
+   page-aligned ADDR.  The mapping uses its own handle on FILE, so
+   closing FILE does not unmap it.  Returns the new mapping's
+   identifier, or MAP_FAILED if FILE is empty, ADDR is null or not
+   page-aligned, the mapping would overlap pages already in use, or
+   memory is short. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct process *p = thread_current ()->process;
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  if (file == NULL || addr == NULL || pg_ofs (addr) != 0)
+    return MAP_FAILED;
+  length = file_length (file);
+  if (length <= 0)
+    return MAP_FAILED;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    return MAP_FAILED;
+  m->base = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+  m->file = file_reopen (file);
+  if (m->file == NULL)
+    goto fail;
+
+  /* The whole range must be free user memory, checked before
+     adding anything so a failure leaves nothing to undo but the
+     pages added here.  The process lock keeps other threads from
+     taking any of the range meanwhile. */
+  lock_acquire (&p->lock);
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = m->base + i * PGSIZE;
+      if (!is_user_vaddr (upage) || page_present (upage))
+        goto fail_locked;
+    }
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      off_t ofs = i * PGSIZE;
+      size_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (!page_add_mapped (m->base + ofs, m->file, ofs, read_bytes))
+        {
+          remove_pages (m, i);
+          goto fail_locked;
+        }
+    }
+
+  m->id = p->next_mapid++;
+  list_push_back (&p->mappings, &m->elem);
+  lock_release (&p->lock);
+  return m->id;
+
+ fail_locked:
+  lock_release (&p->lock);
+ fail:
+  file_close (m->file);
+  free (m);
+  return MAP_FAILED;
+}
+
+/* Unmaps mapping M, writing changed pages back to its file. */
+static void
+unmap (struct mapping *m)
+{
+  list_remove (&m->elem);
+  remove_pages (m, m->page_cnt);
+  file_close (m->file);
+  free (m);
+}
+
+/* Unmaps the current process's mapping ID, if there is one. */
+void
+mmap_unmap (mapid_t id)
+{
+  struct process *p = thread_current ()->process;
+  struct list_elem *e;
+
+  lock_acquire (&p->lock);
+  for (e = list_begin (&p->mappings); e != list_end (&p->mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == id)
+        {
+          unmap (m);
+          break;
+        }
+    }
+  lock_release (&p->lock);
+}
+
+/* Unmaps all of the current process's mappings.  Must be called
+   by its last thread, before its page table is destroyed. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->process->mappings;
+
+  while (!list_empty (mappings))
+    unmap (list_entry (list_front (mappings), struct mapping, elem));
+}
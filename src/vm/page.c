@@ -0,0 +1,772 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/frame.h"
+#include "vm/swap.h"
+
+/* Most pages a user stack may grow to, 8 MB by default. */
+size_t stack_page_limit = 2048;
+
+/* Largest number of pages fault_around() maps after a faulting
+   one. */
+#define FAULT_AROUND_MAX 16
+
+/* Window size each process starts with. */
+#define FAULT_AROUND_INIT 4
+
+/* Fault-around statistics, protected by the owning process's
+   PAGES_LOCK, which is as good as any lock since they are only
+   for printing. */
+static long long prefault_cnt;          /* Pages mapped ahead. */
+static long long prefault_hit_cnt;      /* Of those, later touched. */
+static long long exec_map_cnt;          /* Pages mapped by exec from memory. */
+
+static struct page *page_lookup (const void *addr);
+static void fault_around (struct page *, bool write, size_t slot);
+
+/* Writes mapped page P, which is in memory, back to its file.  Only
+   the bytes that came from the file are written, so the file never
+   grows. */
+static void
+write_back (struct page *p)
+{
+  file_write_at (p->file, p->frame->kpage, p->read_bytes, p->ofs);
+}
+
+/* Initializes the current process's supplemental page table, an
+   open-addressing table from user page address to struct page,
+   since a lookup sits on the path of every page fault.  The
+   process's threads share the table, so it is only used under
+   the process's PAGES_LOCK, which is never held for more than a
+   lookup, insertion or deletion.  Returns false if memory is
+   short. */
+bool
+page_table_init (void)
+{
+  struct process *proc = thread_current ()->process;
+
+  thread_current ()->user_esp = NULL;
+  proc->fault_around = FAULT_AROUND_INIT;
+  proc->fault_around_cnt = 0;
+  return ohash_init (&proc->pages, 0);
+}
+
+/* Prints fault-around statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Fault-around: %lld pages mapped ahead, %lld used\n",
+          prefault_cnt, prefault_hit_cnt);
+  printf ("Exec: %lld executable pages mapped from memory\n", exec_map_cnt);
+}
+
+/* Frees page P along with its frame or swap slot. */
+static void
+page_free (struct page *p)
+{
+
+  /* Wait out an eviction in progress. */
+  lock_acquire (&p->lock);
+  if (p->frame != NULL)
+    {
+      uint32_t *pd = p->owner->pagedir;
+
+      pagedir_clear_page (pd, p->upage);
+      if (p->mapped && pagedir_is_dirty (pd, p->upage))
+        write_back (p);
+      frame_release (p);
+    }
+  if (p->swap_slot != SWAP_NONE)
+    swap_free (p->swap_slot);
+  lock_release (&p->lock);
+  free (p);
+}
+
+/* Frees VALUE, a page, for ohash_destroy(). */
+static void
+page_free_action (uintptr_t upage UNUSED, void *value, void *aux UNUSED)
+{
+  page_free (value);
+}
+
+/* Destroys the current process's supplemental page table and
+   frees every frame and swap slot its pages use.  Must be called
+   by its last thread, before its page directory is destroyed. */
+void
+page_table_destroy (void)
+{
+  ohash_destroy (&thread_current ()->process->pages, page_free_action,
+                 NULL);
+}
+
+/* Adds user page UPAGE to the current process's page table, as
+   page_add_file() and page_add_mapped() describe. */
+static bool
+page_add (void *upage, struct file *file, off_t ofs,
+          size_t read_bytes, bool writable, bool mapped)
+{
+  struct process *proc = thread_current ()->process;
+  struct page *p;
+  bool success;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (read_bytes <= PGSIZE);
+  ASSERT (file != NULL || read_bytes == 0);
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return false;
+  p->upage = upage;
+  p->owner = proc;
+  p->writable = writable;
+  lock_init (&p->lock);
+  p->frame = NULL;
+  p->swap_slot = SWAP_NONE;
+  p->file = read_bytes > 0 ? file : NULL;
+  p->ofs = ofs;
+  p->read_bytes = read_bytes;
+  p->modified = false;
+  p->mapped = mapped;
+
+  lock_acquire (&proc->pages_lock);
+  success = (ohash_find (&proc->pages, (uintptr_t) upage) == NULL
+             && ohash_insert (&proc->pages, (uintptr_t) upage, p));
+  lock_release (&proc->pages_lock);
+  if (!success)
+    free (p);
+  return success;
+}
+
+/* Records that user page UPAGE, which must not already be in the
+   current thread's page table, is to be filled on first touch
+   with READ_BYTES from FILE at offset OFS and zeros after that.
+   FILE may be null if READ_BYTES is 0.  FILE must stay open for as
+   long as the page table exists.  Returns false if UPAGE is
+   already present or memory is short. */
+bool
+page_add_file (void *upage, struct file *file, off_t ofs,
+               size_t read_bytes, bool writable)
+{
+  return page_add (upage, file, ofs, read_bytes, writable, false);
+}
+
+/* Records that user page UPAGE maps READ_BYTES of FILE at offset
+   OFS, writably, as page_add_file() would, except that changes to
+   those bytes are written back to FILE when the page is evicted
+   or removed.  FILE must stay open until page_remove(). */
+bool
+page_add_mapped (void *upage, struct file *file, off_t ofs,
+                 size_t read_bytes)
+{
+  ASSERT (file != NULL && read_bytes > 0);
+  return page_add (upage, file, ofs, read_bytes, true, true);
+}
+
+/* Returns true if UPAGE is in use in the current process: either
+   in its page table or mapped directly in its page directory,
+   like shared memory. */
+bool
+page_present (const void *upage)
+{
+  return (page_lookup (upage) != NULL
+          || pagedir_get_page (thread_current ()->pagedir, upage) != NULL);
+}
+
+/* Removes UPAGE from the current process's page table, writing
+   it back to its file first if it is a mapped page that changed,
+   and frees its frame or swap slot.  Does nothing if UPAGE is not
+   in the page table. */
+void
+page_remove (void *upage)
+{
+  struct process *proc = thread_current ()->process;
+  struct page *p;
+
+  lock_acquire (&proc->pages_lock);
+  p = ohash_find (&proc->pages, (uintptr_t) upage);
+  if (p != NULL)
+    ohash_delete (&proc->pages, (uintptr_t) upage);
+  lock_release (&proc->pages_lock);
+  if (p != NULL)
+    page_free (p);
+}
+
+/* Returns the current process's page containing ADDR, or a null
+   pointer if there is none. */
+static struct page *
+page_lookup (const void *addr)
+{
+  struct process *proc = thread_current ()->process;
+  struct page *p;
+
+  if (!is_user_vaddr (addr) || proc == NULL)
+    return NULL;
+  lock_acquire (&proc->pages_lock);
+  p = ohash_find (&proc->pages, (uintptr_t) pg_round_down (addr));
+  lock_release (&proc->pages_lock);
+  return p;
+}
+
+/* Returns true if page P may share a frame with the same page of
+   other processes: it holds file data that it has not changed,
+   and it is not a mapped file, whose changes go to the file.  A
+   writable page shares the frame copy-on-write, so that everyone
+   else keeps seeing the file's bytes. */
+static bool
+page_is_sharable (const struct page *p)
+{
+  return p->file != NULL && !p->modified && !p->mapped;
+}
+
+/* Returns true if page P holds nothing but zeros. */
+static bool
+page_is_zero (const struct page *p)
+{
+  return p->file == NULL && p->swap_slot == SWAP_NONE;
+}
+
+/* Fills frame F with page P's initial contents from its file:
+   copied from the page cache if it holds them, otherwise read
+   from the buffer cache, whose copy of the sectors is then dropped,
+   now that F has the data.  Returns false if the read fails. */
+static bool
+read_file_page (struct page *p, struct frame *f)
+{
+  struct inode *inode = file_get_inode (p->file);
+
+  if (p->read_bytes == 0
+      || frame_cache_copy (inode, p->ofs, p->read_bytes, f->kpage))
+    return true;
+  if (inode_read_through (inode, f->kpage, p->read_bytes, p->ofs)
+      != (off_t) p->read_bytes)
+    return false;
+  inode_uncache (inode, p->ofs, p->read_bytes);
+  return true;
+}
+
+/* Brings page P into a frame and maps it, leaving the frame
+   pinned.  P's lock must be held and P must not be in memory.  A
+   sharable page that is not about to be written, or is read-only,
+   reuses a frame another process already read it into, if there
+   is one, and an all-zero page that is not about to be written,
+   WRITE false, is mapped copy-on-write to the zero frame.  If
+   MAY_EVICT is false, P gets a frame only if one is free.  Returns
+   false if no frame is available or the read fails. */
+static bool
+page_in (struct page *p, bool write, bool may_evict)
+{
+  uint32_t *pd = p->owner->pagedir;
+  bool share = page_is_sharable (p) && !(write && p->writable);
+  bool shared = false;
+  struct frame *f;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame == NULL);
+
+  if (page_is_zero (p) && !write)
+    {
+      f = frame_zero (p);
+      p->frame = f;
+      if (!(p->writable
+            ? pagedir_set_page_cow (pd, p->upage, f->kpage)
+            : pagedir_set_page (pd, p->upage, f->kpage, false)))
+        {
+          frame_unpin (f);
+          frame_release (p);
+          return false;
+        }
+      return true;
+    }
+
+  if (share)
+    {
+      f = frame_share_find (p);
+      shared = f != NULL;
+    }
+  if (!shared)
+    {
+      f = may_evict ? frame_alloc (p) : frame_try_alloc (p);
+      if (f == NULL)
+        return false;
+
+      if (p->swap_slot != SWAP_NONE)
+        {
+          swap_in (p->swap_slot, f->kpage);
+          p->swap_slot = SWAP_NONE;
+        }
+      else
+        {
+          if (p->file != NULL && !read_file_page (p, f))
+            {
+              frame_free (f);
+              return false;
+            }
+          memset ((uint8_t *) f->kpage + p->read_bytes, 0,
+                  PGSIZE - p->read_bytes);
+          if (share)
+            frame_share_add (f);
+        }
+    }
+
+  p->frame = f;
+  if (!(share && p->writable
+        ? pagedir_set_page_cow (pd, p->upage, f->kpage)
+        : pagedir_set_page (pd, p->upage, f->kpage, p->writable)))
+    {
+      frame_unpin (f);
+      frame_release (p);
+      return false;
+    }
+  return true;
+}
+
+/* Maps those of the CNT pages from UPAGE on, in the current
+   process, whose file data is already in a shared frame, as it is
+   for an executable that is running or ran not long ago, so that
+   they do not fault when first touched.  Writable pages are
+   mapped copy-on-write.  Called by load() for the segments of a
+   new process.  Returns the number of pages mapped. */
+size_t
+page_map_shared (void *upage, size_t cnt)
+{
+  struct process *proc = thread_current ()->process;
+  size_t mapped = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct page *p = page_lookup ((uint8_t *) upage + i * PGSIZE);
+      struct frame *f;
+
+      if (p == NULL || !page_is_sharable (p))
+        continue;
+      lock_acquire (&p->lock);
+      if (p->frame == NULL && (f = frame_share_find (p)) != NULL)
+        {
+          uint32_t *pd = p->owner->pagedir;
+
+          p->frame = f;
+          if (p->writable
+              ? pagedir_set_page_cow (pd, p->upage, f->kpage)
+              : pagedir_set_page (pd, p->upage, f->kpage, false))
+            {
+              frame_unpin (f);
+              mapped++;
+            }
+          else
+            {
+              frame_unpin (f);
+              frame_release (p);
+            }
+        }
+      lock_release (&p->lock);
+    }
+
+  lock_acquire (&proc->pages_lock);
+  exec_map_cnt += mapped;
+  lock_release (&proc->pages_lock);
+  return mapped;
+}
+
+/* Gives page P, which is mapped copy-on-write, a writable frame
+   of its own holding a copy of the shared one, and leaves it
+   pinned.  P's lock must be held.  Returns false, with P not in
+   memory, if no frame is available. */
+static bool
+unshare (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+  struct frame *old = p->frame;
+  struct frame *new;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+
+  /* Keep the old frame around to copy from after letting go of it. */
+  frame_pin (old);
+  pagedir_clear_page (pd, p->upage);
+  frame_release (p);
+
+  new = frame_alloc (p);
+  if (new != NULL)
+    {
+      /* Clearing a page is cheaper than copying one, since nothing
+         has to be read. */
+      if (frame_is_zero (old))
+        memset (new->kpage, 0, PGSIZE);
+      else
+        memcpy (new->kpage, old->kpage, PGSIZE);
+      p->frame = new;
+      if (!pagedir_set_page (pd, p->upage, new->kpage, true))
+        {
+          frame_unpin (new);
+          frame_release (p);
+          new = NULL;
+        }
+    }
+  frame_unpin (old);
+  return new != NULL;
+}
+
+/* Handles a write to the page containing FAULT_ADDR that faulted
+   because the page is mapped copy-on-write, by giving it a private
+   copy.  Returns true if the faulting write can be retried, false
+   if the page is not the current process's, is not copy-on-write,
+   or there is no memory for the copy. */
+bool
+page_unshare (void *fault_addr)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct page *p;
+  bool success;
+
+  if (pd == NULL)
+    return false;
+  p = page_lookup (fault_addr);
+  if (p == NULL)
+    return false;
+
+  lock_acquire (&p->lock);
+  success = (p->frame != NULL && pagedir_is_cow (pd, p->upage)
+             && unshare (p));
+  if (success)
+    frame_unpin (p->frame);
+  lock_release (&p->lock);
+  return success;
+}
+
+/* Counts the pages of the current process's last fault-around
+   window that have been touched since, adjusts its window size
+   to match, and forgets the window.  A window that was mostly
+   used, as by a sequential scan, doubles the size, and one that
+   was mostly not halves it. */
+static void
+judge_window (struct process *proc)
+{
+  uint32_t *pd = proc->pagedir;
+  uint8_t *base;
+  size_t cnt, hits, i;
+
+  lock_acquire (&proc->pages_lock);
+  base = proc->fault_around_base;
+  cnt = proc->fault_around_cnt;
+  proc->fault_around_cnt = 0;
+  lock_release (&proc->pages_lock);
+  if (cnt == 0)
+    return;
+
+  hits = 0;
+  for (i = 0; i < cnt; i++)
+    if (pagedir_is_accessed (pd, base + i * PGSIZE))
+      hits++;
+
+  lock_acquire (&proc->pages_lock);
+  prefault_hit_cnt += hits;
+  if (hits * 2 >= cnt)
+    proc->fault_around = (proc->fault_around * 2 < FAULT_AROUND_MAX
+                          ? proc->fault_around * 2 : FAULT_AROUND_MAX);
+  else if (proc->fault_around > 1)
+    proc->fault_around /= 2;
+  lock_release (&proc->pages_lock);
+}
+
+/* Maps the pages from BASE on, up to CNT of them, that are in
+   adjacent swap slots starting at SLOT, as the frame allocator
+   leaves pages it evicts together, reading them all in one disk
+   command.  Stops at the first page that is not, that is busy, or
+   that cannot have a frame without evicting one.  Returns the
+   number of pages mapped. */
+static size_t
+swap_in_run (uint8_t *base, size_t slot, size_t cnt)
+{
+  struct page *run[SWAP_CLUSTER_MAX];
+  void *kpages[SWAP_CLUSTER_MAX];
+  size_t run_cnt, mapped, i;
+
+  ASSERT (cnt <= SWAP_CLUSTER_MAX);
+
+  for (run_cnt = 0; run_cnt < cnt; run_cnt++)
+    {
+      struct page *q = page_lookup (base + run_cnt * PGSIZE);
+      struct frame *f;
+
+      if (q == NULL || !lock_try_acquire (&q->lock))
+        break;
+      if (q->frame != NULL || q->swap_slot != slot + run_cnt
+          || (f = frame_try_alloc (q)) == NULL)
+        {
+          lock_release (&q->lock);
+          break;
+        }
+      q->frame = f;
+      run[run_cnt] = q;
+      kpages[run_cnt] = f->kpage;
+    }
+  if (run_cnt == 0)
+    return 0;
+
+  swap_read_cluster (slot, kpages, run_cnt);
+
+  /* Past a page that cannot be mapped, the rest would not be
+     contiguous with the window, so they are let go too.  Their
+     slots still hold their contents. */
+  mapped = 0;
+  for (i = 0; i < run_cnt; i++)
+    {
+      struct page *q = run[i];
+      struct frame *f = q->frame;
+
+      if (mapped == i
+          && pagedir_set_page (q->owner->pagedir, q->upage, f->kpage,
+                               q->writable))
+        {
+          swap_free (q->swap_slot);
+          q->swap_slot = SWAP_NONE;
+          mapped++;
+          frame_unpin (f);
+        }
+      else
+        {
+          frame_unpin (f);
+          frame_release (q);
+        }
+      lock_release (&q->lock);
+    }
+  return mapped;
+}
+
+/* Having just loaded page P after a fault, WRITE true if it was
+   a write, maps the pages that follow P as well, so that a
+   sequential scan or straight-line code takes a fault only every
+   few pages.  Only pages that are cheap to bring in are mapped,
+   stopping at the first that is not: pages that need no frame,
+   because they are all zeros or another process already read
+   them, and pages that can have a frame without evicting one.
+   Zero pages are mapped the way P was, private if P was written
+   and copy-on-write to the zero frame if not.  If P was read from
+   swap slot SLOT, though, only the pages swapped out along with
+   it are mapped, as swap_in_run() describes. */
+static void
+fault_around (struct page *p, bool write, size_t slot)
+{
+  struct process *proc = p->owner;
+  uint8_t *base = (uint8_t *) p->upage + PGSIZE;
+  size_t cnt, k;
+
+  judge_window (proc);
+
+  k = proc->fault_around;
+  if (slot != SWAP_NONE)
+    cnt = swap_in_run (base, slot + 1, k < (size_t) swap_cluster
+                                       ? k : (size_t) swap_cluster);
+  else
+    for (cnt = 0; cnt < k; cnt++)
+      {
+        struct page *q = page_lookup (base + cnt * PGSIZE);
+        bool ok;
+
+        if (q == NULL || !lock_try_acquire (&q->lock))
+          break;
+        ok = (q->frame == NULL && q->swap_slot == SWAP_NONE
+              && page_in (q, write && q->writable, false));
+        if (ok)
+          frame_unpin (q->frame);
+        lock_release (&q->lock);
+        if (!ok)
+          break;
+      }
+
+  lock_acquire (&proc->pages_lock);
+  proc->fault_around_base = base;
+  proc->fault_around_cnt = cnt;
+  prefault_cnt += cnt;
+  lock_release (&proc->pages_lock);
+}
+
+/* Brings the page containing FAULT_ADDR into memory and maps it,
+   if it belongs to the current process.  WRITE tells whether the
+   faulting access was a write.  Returns true if the faulting
+   access can be retried, false if FAULT_ADDR is not a valid
+   address or there is no memory for the page.  If CLASS is
+   nonnull, sets *CLASS to where the page came from. */
+bool
+page_load (void *fault_addr, bool write, enum fault_class *class)
+{
+  struct page *p;
+  size_t slot;
+  bool success;
+
+  if (thread_current ()->pagedir == NULL)
+    return false;
+  p = page_lookup (fault_addr);
+  if (p == NULL)
+    return false;
+
+  lock_acquire (&p->lock);
+  /* A page already in memory faulted for another reason, such as
+     a write to a read-only page. */
+  if (class != NULL)
+    *class = (p->swap_slot != SWAP_NONE ? FAULT_SWAP
+              : p->file != NULL && p->read_bytes > 0 ? FAULT_FILE
+              : FAULT_ZERO);
+  slot = p->swap_slot;
+  success = p->frame == NULL && page_in (p, write, true);
+  if (success)
+    frame_unpin (p->frame);
+  lock_release (&p->lock);
+  if (success)
+    fault_around (p, write, slot);
+  return success;
+}
+
+/* Adds a zero page to the current process's stack to cover
+   FAULT_ADDR, if that looks like a stack access, and loads it.  A
+   stack access is one no more than 32 bytes below ESP, the user
+   stack pointer at the time of the fault, since PUSHA writes that
+   far below it before adjusting it; ESP may be null in the kernel
+   when it is not known.  The stack may grow to STACK_PAGE_LIMIT
+   pages.  Returns true if the faulting access can be retried. */
+bool
+page_grow_stack (void *fault_addr, const void *esp)
+{
+  const uint8_t *stack_bottom = (const uint8_t *) PHYS_BASE
+                                - stack_page_limit * PGSIZE;
+  void *upage = pg_round_down (fault_addr);
+
+  if (thread_current ()->pagedir == NULL
+      || !is_user_vaddr (fault_addr)
+      || (uint8_t *) fault_addr < stack_bottom
+      || (esp != NULL && (uint8_t *) fault_addr + 32 < (uint8_t *) esp))
+    return false;
+  return (page_add_file (upage, NULL, 0, 0, true)
+          && page_load (fault_addr, true, NULL));
+}
+
+/* Starts evicting page P, which the frame allocator has chosen:
+   unmaps it so that its owner faults it back in on the next
+   access, and writes it back to its file if it is a mapped page.
+   P's lock must be held and its frame pinned.  Returns true if P
+   may have changed and so must go to swap, which the caller then
+   arranges and reports with page_evict_finish().  Returns false if
+   P is already evicted: one that has not changed can simply be
+   read from its initial contents again. */
+bool
+page_evict_begin (struct page *p)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->frame != NULL);
+
+  /* Unmap first, so the owner cannot dirty the page after we
+     check.  The dirty bit survives in the cleared entry. */
+  pagedir_clear_page (pd, p->upage);
+  if (p->mapped)
+    {
+      /* The file is the backing store for a mapped page. */
+      if (pagedir_is_dirty (pd, p->upage))
+        write_back (p);
+    }
+  else if (pagedir_is_dirty (pd, p->upage))
+    p->modified = true;
+
+  if (p->modified)
+    return true;
+  p->frame = NULL;
+  return false;
+}
+
+/* Finishes evicting page P, for which page_evict_begin() returned
+   true, now that its frame has been written to swap slot SLOT.
+   Returns true if successful.  If SLOT is SWAP_NONE, because swap
+   is full, maps P again as it was and returns false. */
+bool
+page_evict_finish (struct page *p, size_t slot)
+{
+  uint32_t *pd = p->owner->pagedir;
+
+  ASSERT (lock_held_by_current_thread (&p->lock));
+  ASSERT (p->modified);
+
+  if (slot == SWAP_NONE)
+    {
+      pagedir_set_page (pd, p->upage, p->frame->kpage, p->writable);
+      pagedir_set_dirty (pd, p->upage, true);
+      return false;
+    }
+  p->swap_slot = slot;
+  p->frame = NULL;
+  return true;
+}
+
+/* Brings the SIZE bytes of user memory at UADDR into memory and
+   pins them there, so that kernel code can access them while
+   holding locks that page_load() might need.  If the kernel is to
+   write them, WRITE true, copy-on-write pages get their private
+   copies now, since that too may need a new frame.  Returns false,
+   with nothing pinned, if part of the range is not mapped or
+   cannot be loaded. */
+bool
+page_pin (const void *uaddr, size_t size, bool write)
+{
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const uint8_t *up;
+
+  for (up = start; up < end; up += PGSIZE)
+    {
+      struct page *p = page_lookup (up);
+      bool ok;
+
+      if (p == NULL)
+        {
+          /* Pages outside the page table, such as shared memory,
+             are never evicted. */
+          ok = pagedir_get_page (thread_current ()->pagedir, up) != NULL;
+        }
+      else
+        {
+          lock_acquire (&p->lock);
+          if (p->frame == NULL)
+            ok = page_in (p, write, true);
+          else if (write && pagedir_is_cow (p->owner->pagedir, p->upage))
+            ok = unshare (p);
+          else
+            {
+              frame_pin (p->frame);
+              ok = true;
+            }
+          lock_release (&p->lock);
+        }
+
+      if (!ok)
+        {
+          page_unpin (start, up - start);
+          return false;
+        }
+    }
+  return true;
+}
+
+/* Unpins the SIZE bytes at UADDR, which page_pin() pinned. */
+void
+page_unpin (const void *uaddr, size_t size)
+{
+  const uint8_t *start = pg_round_down (uaddr);
+  const uint8_t *end = (const uint8_t *) uaddr + size;
+  const uint8_t *up;
+
+  for (up = start; up < end; up += PGSIZE)
+    {
+      struct page *p = page_lookup (up);
+      if (p != NULL && p->frame != NULL)
+        frame_unpin (p->frame);
+    }
+}
@@ -0,0 +1,72 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <list.h>
+#include <stats.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "filesys/off_t.h"
+#include "threads/synch.h"
+
+struct file;
+struct process;
+
+/* Most pages a user stack may grow to. */
+extern size_t stack_page_limit;
+
+/* A page of a process's virtual address space that is described
+   in its supplemental page table.  Such a page is not in the page
+   directory until it is first touched; page_fault() then calls
+   page_load() to bring it in.  It may later be evicted to make
+   room for another page, and is brought back in the same way. */
+struct page
+  {
+    void *upage;                /* User virtual address. */
+    struct process *owner;      /* Process whose page table holds it. */
+    bool writable;              /* Mapped writable? */
+
+    /* Held while the page is being loaded, evicted or freed. */
+    struct lock lock;
+
+    /* Where the page is now.  FRAME is set while it is in memory.
+       Otherwise SWAP_SLOT holds its contents if it is not
+       SWAP_NONE, or else it is read from its initial contents. */
+    struct frame *frame;
+    struct list_elem frame_elem; /* Element in FRAME's page list. */
+    size_t swap_slot;
+
+    /* Initial contents: READ_BYTES from FILE at offset OFS,
+       followed by zeros to the end of the page.  FILE is null for
+       an all-zero page. */
+    struct file *file;
+    off_t ofs;
+    size_t read_bytes;
+
+    /* True once the contents may differ from the initial ones, so
+       that eviction must write the page to swap. */
+    bool modified;
+
+    /* True for a page of a memory-mapped file, whose changes are
+       written back to FILE instead of going to swap. */
+    bool mapped;
+  };
+
+bool page_table_init (void);
+void page_table_destroy (void);
+void page_print_stats (void);
+bool page_add_file (void *upage, struct file *, off_t ofs,
+                    size_t read_bytes, bool writable);
+bool page_add_mapped (void *upage, struct file *, off_t ofs,
+                      size_t read_bytes);
+bool page_present (const void *upage);
+size_t page_map_shared (void *upage, size_t cnt);
+void page_remove (void *upage);
+bool page_load (void *fault_addr, bool write, enum fault_class *);
+bool page_unshare (void *fault_addr);
+bool page_grow_stack (void *fault_addr, const void *esp);
+bool page_evict_begin (struct page *);
+bool page_evict_finish (struct page *, size_t slot);
+bool page_pin (const void *uaddr, size_t size, bool write);
+void page_unpin (const void *uaddr, size_t size);
+
+#endif /* vm/page.h */
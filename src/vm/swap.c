@@ -0,0 +1,244 @@
+#include "vm/swap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <stdio.h>
+#include "devices/disk.h"
+#include "threads/synch.h"
+#include "threads/tunable.h"
+#include "threads/vaddr.h"
+#include "vm/zswap.h"
+
+/* Swap partition, on hd1:1. */
+static struct disk *swap_disk;
+
+/* Disk sectors in a swap slot, which holds one page. */
+#define SECTORS_PER_SLOT (PGSIZE / DISK_SECTOR_SIZE)
+
+/* Slots from ZSWAP_SLOT on are entries of compressed swap, which
+   pages try before the disk; see zswap.c.  They are numbered
+   consecutively like disk slots, so that pages stored together
+   are also loaded together. */
+#define ZSWAP_SLOT (SIZE_MAX / 2 + 1)
+
+/* Returns true if SLOT is in compressed swap. */
+static inline bool
+in_zswap (size_t slot)
+{
+  return slot >= ZSWAP_SLOT && slot != SWAP_NONE;
+}
+
+/* Slots in use, one bit per slot. */
+static struct bitmap *swap_map;
+static struct lock swap_lock;   /* Protects SWAP_MAP and the statistics. */
+
+int swap_cluster = SWAP_CLUSTER_MAX;
+
+/* Statistics. */
+static long long out_cnt;       /* Pages written. */
+static long long out_run_cnt;   /* Runs of adjacent slots written. */
+static long long in_cnt;        /* Pages read. */
+static long long in_run_cnt;    /* Runs of adjacent slots read. */
+
+/* Finds the swap disk and sets up the slot map. Without a swap
+   disk, there are no slots and eviction of anything that needs
+   saving fails. */
+void
+swap_init (void)
+{
+  size_t slot_cnt = 0;
+
+  swap_disk = disk_get (1, 1);
+  if (swap_disk != NULL)
+    slot_cnt = disk_size (swap_disk) / SECTORS_PER_SLOT;
+  else
+    printf ("swap: no swap disk, running without swap\n");
+
+  swap_map = bitmap_create (slot_cnt);
+  if (swap_map == NULL)
+    PANIC ("swap: bitmap creation failed");
+  lock_init_named (&swap_lock, "swap");
+  tunable_register ("swap_cluster", &swap_cluster, 1, SWAP_CLUSTER_MAX);
+  zswap_init ();
+}
+
+/* Writes the page at KPAGE to a free swap slot and returns the
+   slot, or SWAP_NONE if swap is full. */
+size_t
+swap_out (const void *kpage)
+{
+  void *kpages[1] = { (void *) kpage };
+  size_t slot;
+
+  zswap_store (kpages, 1, &slot);
+  if (slot != SWAP_NONE)
+    return ZSWAP_SLOT + slot;
+
+  lock_acquire (&swap_lock);
+  slot = bitmap_scan_and_flip (swap_map, 0, 1, false);
+  lock_release (&swap_lock);
+  if (slot == BITMAP_ERROR)
+    return SWAP_NONE;
+
+  disk_write_multiple (swap_disk, slot * SECTORS_PER_SLOT,
+                       SECTORS_PER_SLOT, kpage);
+  lock_acquire (&swap_lock);
+  out_cnt++;
+  out_run_cnt++;
+  lock_release (&swap_lock);
+  return slot;
+}
+
+/* Transfers the CNT pages at KPAGES to or from swap slots SLOTS,
+   writing them if WRITE is true, skipping slots that are
+   SWAP_NONE.  All the transfers are queued before waiting for
+   any, so the disk driver merges those to adjacent slots into
+   single commands.  Returns the number of runs of adjacent slots
+   transferred. */
+static size_t
+transfer_cluster (void *const *kpages, const size_t *slots, size_t cnt,
+                  bool write)
+{
+  struct disk_request reqs[SWAP_CLUSTER_MAX];
+  size_t runs = 0;
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER_MAX);
+
+  for (i = 0; i < cnt; i++)
+    if (slots[i] != SWAP_NONE)
+      {
+        disk_request_init (&reqs[i], swap_disk, slots[i] * SECTORS_PER_SLOT,
+                           SECTORS_PER_SLOT, kpages[i], write, NULL, NULL);
+        disk_submit (&reqs[i]);
+        if (i == 0 || slots[i - 1] == SWAP_NONE
+            || slots[i - 1] + 1 != slots[i])
+          runs++;
+      }
+  for (i = 0; i < cnt; i++)
+    if (slots[i] != SWAP_NONE)
+      disk_wait (&reqs[i]);
+  return runs;
+}
+
+/* Writes the CNT pages at KPAGES, at most SWAP_CLUSTER_MAX, to
+   swap.  Pages go to compressed swap if they fit there and to the
+   disk otherwise, in adjacent slots if a long enough run of them
+   is free, so that they go out in one disk command and can be read
+   back in one.  Stores each page's slot in SLOTS, or SWAP_NONE for
+   pages that did not fit because swap is full. */
+void
+swap_out_cluster (void *const *kpages, size_t cnt, size_t *slots)
+{
+  void *disk_kpages[SWAP_CLUSTER_MAX];
+  size_t disk_slots[SWAP_CLUSTER_MAX];
+  size_t disk_cnt, first, i, j, runs;
+
+  ASSERT (cnt <= SWAP_CLUSTER_MAX);
+
+  zswap_store (kpages, cnt, slots);
+  disk_cnt = 0;
+  for (i = 0; i < cnt; i++)
+    if (slots[i] != SWAP_NONE)
+      slots[i] += ZSWAP_SLOT;
+    else
+      disk_kpages[disk_cnt++] = kpages[i];
+  if (disk_cnt == 0)
+    return;
+
+  lock_acquire (&swap_lock);
+  first = bitmap_scan_and_flip (swap_map, 0, disk_cnt, false);
+  for (i = 0; i < disk_cnt; i++)
+    if (first != BITMAP_ERROR)
+      disk_slots[i] = first + i;
+    else
+      {
+        disk_slots[i] = bitmap_scan_and_flip (swap_map, 0, 1, false);
+        if (disk_slots[i] == BITMAP_ERROR)
+          disk_slots[i] = SWAP_NONE;
+      }
+  lock_release (&swap_lock);
+
+  runs = transfer_cluster (disk_kpages, disk_slots, disk_cnt, true);
+  for (i = j = 0; i < cnt; i++)
+    if (slots[i] == SWAP_NONE)
+      slots[i] = disk_slots[j++];
+
+  lock_acquire (&swap_lock);
+  for (i = 0; i < disk_cnt; i++)
+    out_cnt += disk_slots[i] != SWAP_NONE;
+  out_run_cnt += runs;
+  lock_release (&swap_lock);
+}
+
+/* Reads swap slot SLOT into KPAGE and frees the slot. */
+void
+swap_in (size_t slot, void *kpage)
+{
+  ASSERT (slot != SWAP_NONE);
+
+  if (in_zswap (slot))
+    {
+      zswap_load (slot - ZSWAP_SLOT, kpage);
+      zswap_free (slot - ZSWAP_SLOT);
+      return;
+    }
+  disk_read_multiple (swap_disk, slot * SECTORS_PER_SLOT,
+                      SECTORS_PER_SLOT, kpage);
+  lock_acquire (&swap_lock);
+  in_cnt++;
+  in_run_cnt++;
+  lock_release (&swap_lock);
+  swap_free (slot);
+}
+
+/* Reads the CNT adjacent swap slots starting at SLOT, at most
+   SWAP_CLUSTER_MAX, into KPAGES, in one disk command.  Unlike
+   swap_in(), leaves the slots allocated; free each with
+   swap_free() once its page is safely in memory. */
+void
+swap_read_cluster (size_t slot, void *const *kpages, size_t cnt)
+{
+  size_t slots[SWAP_CLUSTER_MAX];
+  size_t i;
+
+  ASSERT (cnt <= SWAP_CLUSTER_MAX);
+
+  if (in_zswap (slot))
+    {
+      for (i = 0; i < cnt; i++)
+        zswap_load (slot - ZSWAP_SLOT + i, kpages[i]);
+      return;
+    }
+
+  for (i = 0; i < cnt; i++)
+    slots[i] = slot + i;
+  transfer_cluster (kpages, slots, cnt, false);
+  lock_acquire (&swap_lock);
+  in_cnt += cnt;
+  in_run_cnt += cnt > 0;
+  lock_release (&swap_lock);
+}
+
+/* Frees swap slot SLOT without reading it. */
+void
+swap_free (size_t slot)
+{
+  if (in_zswap (slot))
+    {
+      zswap_free (slot - ZSWAP_SLOT);
+      return;
+    }
+  lock_acquire (&swap_lock);
+  ASSERT (bitmap_test (swap_map, slot));
+  bitmap_reset (swap_map, slot);
+  lock_release (&swap_lock);
+}
+
+/* Prints swap statistics. */
+void
+swap_print_stats (void)
+{
+  printf ("Swap: %lld pages out in %lld runs, %lld pages in in %lld runs\n",
+          out_cnt, out_run_cnt, in_cnt, in_run_cnt);
+  zswap_print_stats ();
+}
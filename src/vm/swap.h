@@ -0,0 +1,23 @@
+#ifndef VM_SWAP_H
+#define VM_SWAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A swap slot index that names no slot. */
+#define SWAP_NONE SIZE_MAX
+
+/* Most pages moved to or from swap together, and the number
+   actually moved, tunable as "swap_cluster". */
+#define SWAP_CLUSTER_MAX 8
+extern int swap_cluster;
+
+void swap_init (void);
+size_t swap_out (const void *kpage);
+void swap_out_cluster (void *const *kpages, size_t cnt, size_t *slots);
+void swap_in (size_t slot, void *kpage);
+void swap_read_cluster (size_t slot, void *const *kpages, size_t cnt);
+void swap_free (size_t slot);
+void swap_print_stats (void);
+
+#endif /* vm/swap.h */
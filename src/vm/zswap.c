@@ -0,0 +1,425 @@
+#include "vm/zswap.h"
+#include <bitmap.h>
+#include <debug.h>
+#include <list.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/tunable.h"
+#include "threads/vaddr.h"
+#include "vm/swap.h"
+
+/* Compressed swap.  Evicted pages are kept here, compressed, as
+   long as there is room, and go to the swap disk only when there
+   is not, so that a process thrashing on a small memory mostly
+   pays for compression instead of a disk transfer.
+
+   A page whose words all have the same value, most often zero,
+   is kept as that one word.  Any other page is compressed with a
+   small LZ77 coder and kept in a "zpage" obtained from the kernel
+   pool, which holds at most two compressed pages, one at each
+   end, so that freeing one never leaves a hole that has to be
+   filled or compacted.  A zpage with one compressed page is on
+   the UNBUDDIED list, where the next compressed page that fits in
+   the rest of it goes.
+
+   At most zswap_pages zpages are used.  A page that does not
+   compress to less than ZSWAP_SIZE_MAX bytes, or that arrives
+   when the zpages are full, goes to the disk instead. */
+
+int zswap_pages = 0;
+
+/* Largest compressed page worth keeping. */
+#define ZSWAP_SIZE_MAX (PGSIZE * 3 / 4)
+
+/* Entries per zpage allowed, since each zpage holds two
+   compressed pages and pages kept as one word need none. */
+#define ENTRIES_PER_ZPAGE 8
+
+/* A compressed page, or a page of one repeated word if SIZE is
+   0. */
+struct zentry
+  {
+    uint8_t *data;              /* Compressed data, in a zpage. */
+    uint32_t word;              /* The repeated word, if SIZE is 0. */
+    uint16_t size;              /* Bytes of DATA. */
+  };
+
+/* A page of compressed data.  The first compressed page starts
+   just past this header and the last one ends at the end of the
+   page. */
+struct zpage
+  {
+    struct list_elem elem;      /* In UNBUDDIED, if it has room. */
+    uint16_t first_size;        /* Bytes of the first page, or 0. */
+    uint16_t last_size;         /* Bytes of the last page, or 0. */
+  };
+#define ZPAGE_ROOM (PGSIZE - sizeof (struct zpage))
+
+static struct zentry *table;    /* Entries, ENTRY_CNT of them. */
+static size_t entry_cnt;
+static struct bitmap *entry_map; /* Entries in use. */
+static struct list unbuddied;   /* Zpages with one compressed page. */
+static size_t zpage_cnt;        /* Zpages in use. */
+static size_t stored_bytes;     /* Compressed bytes in them. */
+
+/* Protects everything above, and the coder's buffers. */
+static struct lock zswap_lock;
+
+/* Statistics. */
+static long long compressed_cnt; /* Pages stored compressed. */
+static long long word_cnt;      /* Pages stored as one word. */
+static long long reject_cnt;    /* Pages that did not compress. */
+static long long full_cnt;      /* Pages turned away when full. */
+static long long load_cnt;      /* Pages loaded. */
+
+/* The LZ77 coder.  Its output is a sequence of items, each
+   starting with a tag byte:
+
+        0x00 + (N - 1)          N literal bytes follow, 1 <= N <= 128.
+        0x80 + (N - MATCH_MIN)  2-byte little-endian OFFSET follows;
+                                copy N bytes from OFFSET bytes back,
+                                MATCH_MIN <= N <= MATCH_MAX.
+
+   Matches are found through a hash table of the last position at
+   which each 4-byte sequence was seen.  The table is not cleared
+   between pages, since every candidate is checked anyway. */
+#define LITERAL_MAX 128
+#define MATCH_MIN 4
+#define MATCH_MAX (MATCH_MIN + 127)
+#define HASH_BITS 12
+static uint16_t lz_table[1 << HASH_BITS];
+static uint8_t lz_buf[ZSWAP_SIZE_MAX];
+
+/* Returns the 4 bytes at P, in any alignment. */
+static uint32_t
+get32 (const uint8_t *p)
+{
+  uint32_t w;
+  memcpy (&w, p, sizeof w);
+  return w;
+}
+
+/* Appends the CNT literal bytes at SRC to the DST_MAX bytes at
+   DST, of which *OUT are used.  Returns false if they do not
+   fit. */
+static bool
+put_literals (const uint8_t *src, size_t cnt,
+              uint8_t *dst, size_t *out, size_t dst_max)
+{
+  while (cnt > 0)
+    {
+      size_t n = cnt < LITERAL_MAX ? cnt : LITERAL_MAX;
+      if (*out + 1 + n > dst_max)
+        return false;
+      dst[(*out)++] = n - 1;
+      memcpy (dst + *out, src, n);
+      *out += n;
+      src += n;
+      cnt -= n;
+    }
+  return true;
+}
+
+/* Compresses the page at SRC into the DST_MAX bytes at DST.
+   Returns the compressed size, or 0 if it is more than
+   DST_MAX. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t dst_max)
+{
+  size_t pos = 0, lit = 0, out = 0;
+
+  while (pos + MATCH_MIN <= PGSIZE)
+    {
+      uint32_t w = get32 (src + pos);
+      size_t h = (w * 2654435761u) >> (32 - HASH_BITS);
+      size_t cand = lz_table[h];
+
+      lz_table[h] = pos;
+      if (cand < pos && get32 (src + cand) == w)
+        {
+          size_t len = MATCH_MIN, ofs = pos - cand;
+
+          while (pos + len < PGSIZE && len < MATCH_MAX
+                 && src[cand + len] == src[pos + len])
+            len++;
+          if (!put_literals (src + lit, pos - lit, dst, &out, dst_max)
+              || out + 3 > dst_max)
+            return 0;
+          dst[out++] = 0x80 | (len - MATCH_MIN);
+          dst[out++] = ofs & 0xff;
+          dst[out++] = ofs >> 8;
+          pos += len;
+          lit = pos;
+        }
+      else
+        pos++;
+    }
+  if (!put_literals (src + lit, PGSIZE - lit, dst, &out, dst_max))
+    return 0;
+  return out;
+}
+
+/* Decompresses the SIZE bytes at SRC, made by lz_compress(), into
+   the page at DST.  Returns false if they are not a whole page's
+   worth of valid items. */
+static bool
+lz_decompress (const uint8_t *src, size_t size, uint8_t *dst)
+{
+  const uint8_t *end = src + size;
+  size_t out = 0;
+
+  while (src < end)
+    {
+      uint8_t tag = *src++;
+      if (tag < 0x80)
+        {
+          size_t n = tag + 1;
+          if (n > (size_t) (end - src) || n > PGSIZE - out)
+            return false;
+          memcpy (dst + out, src, n);
+          src += n;
+          out += n;
+        }
+      else
+        {
+          size_t n = (tag & 0x7f) + MATCH_MIN, ofs;
+          if (end - src < 2)
+            return false;
+          ofs = src[0] | (src[1] << 8);
+          src += 2;
+          if (ofs == 0 || ofs > out || n > PGSIZE - out)
+            return false;
+
+          /* Byte by byte, since a match may overlap itself. */
+          for (; n > 0; n--, out++)
+            dst[out] = dst[out - ofs];
+        }
+    }
+  return out == PGSIZE;
+}
+
+/* If every word of the page at KPAGE is the same, stores it in
+   *WORD and returns true. */
+static bool
+one_word (const void *kpage, uint32_t *word)
+{
+  const uint32_t *w = kpage;
+  size_t i;
+
+  for (i = 1; i < PGSIZE / sizeof *w; i++)
+    if (w[i] != w[0])
+      return false;
+  *word = w[0];
+  return true;
+}
+
+/* Sets up compressed swap, if zswap_pages asks for it. */
+void
+zswap_init (void)
+{
+  tunable_register ("zswap_pages", &zswap_pages, 0, 16384);
+  lock_init_named (&zswap_lock, "zswap");
+  list_init (&unbuddied);
+  if (zswap_pages == 0)
+    return;
+
+  entry_cnt = (size_t) zswap_pages * ENTRIES_PER_ZPAGE;
+  table = malloc (entry_cnt * sizeof *table);
+  entry_map = bitmap_create (entry_cnt);
+  if (table == NULL || entry_map == NULL)
+    PANIC ("zswap: out of memory for %zu entries", entry_cnt);
+}
+
+/* Returns room for SIZE bytes of compressed data in a zpage, or a
+   null pointer if the zpages are full.  ZSWAP_LOCK must be
+   held. */
+static uint8_t *
+zpage_alloc (size_t size)
+{
+  struct list_elem *e;
+  struct zpage *zp;
+
+  ASSERT (size > 0 && size <= ZPAGE_ROOM);
+  for (e = list_begin (&unbuddied); e != list_end (&unbuddied);
+       e = list_next (e))
+    {
+      zp = list_entry (e, struct zpage, elem);
+      if (zp->first_size + zp->last_size + size <= ZPAGE_ROOM)
+        {
+          list_remove (&zp->elem);
+          if (zp->first_size == 0)
+            {
+              zp->first_size = size;
+              return (uint8_t *) (zp + 1);
+            }
+          zp->last_size = size;
+          return (uint8_t *) zp + PGSIZE - size;
+        }
+    }
+
+  if (zpage_cnt >= (size_t) zswap_pages
+      || (zp = palloc_get_page (0)) == NULL)
+    return NULL;
+  zpage_cnt++;
+  zp->first_size = size;
+  zp->last_size = 0;
+  list_push_back (&unbuddied, &zp->elem);
+  return (uint8_t *) (zp + 1);
+}
+
+/* Frees the compressed data at DATA, in a zpage, freeing the zpage
+   too if it is now empty.  ZSWAP_LOCK must be held. */
+static void
+zpage_free (uint8_t *data)
+{
+  struct zpage *zp = pg_round_down (data);
+  bool was_full = zp->first_size != 0 && zp->last_size != 0;
+
+  if (data == (uint8_t *) (zp + 1))
+    zp->first_size = 0;
+  else
+    zp->last_size = 0;
+
+  if (zp->first_size == 0 && zp->last_size == 0)
+    {
+      list_remove (&zp->elem);
+      palloc_free_page (zp);
+      zpage_cnt--;
+    }
+  else if (was_full)
+    list_push_back (&unbuddied, &zp->elem);
+}
+
+/* Stores the page at KPAGE in entry ENTRY, reserved by the caller,
+   and returns true if it could be kept.  ZSWAP_LOCK must be
+   held. */
+static bool
+store_page (size_t entry, const void *kpage)
+{
+  struct zentry *z = &table[entry];
+  size_t size;
+
+  if (one_word (kpage, &z->word))
+    {
+      z->size = 0;
+      word_cnt++;
+      return true;
+    }
+
+  size = lz_compress (kpage, lz_buf, sizeof lz_buf);
+  if (size == 0)
+    {
+      reject_cnt++;
+      return false;
+    }
+  z->data = zpage_alloc (size);
+  if (z->data == NULL)
+    {
+      full_cnt++;
+      return false;
+    }
+  memcpy (z->data, lz_buf, size);
+  z->size = size;
+  stored_bytes += size;
+  compressed_cnt++;
+  return true;
+}
+
+/* Stores the CNT pages at KPAGES compressed, in adjacent entries
+   if enough are free, so that they can be loaded back together,
+   and sets each page's entry in ENTRIES.  Pages that cannot be
+   kept get SWAP_NONE and must go to the swap disk. */
+void
+zswap_store (void *const *kpages, size_t cnt, size_t *entries)
+{
+  size_t first, i;
+
+  if (entry_map == NULL)
+    {
+      for (i = 0; i < cnt; i++)
+        entries[i] = SWAP_NONE;
+      return;
+    }
+
+  lock_acquire (&zswap_lock);
+  first = cnt > 0 ? bitmap_scan_and_flip (entry_map, 0, cnt, false)
+                  : BITMAP_ERROR;
+  for (i = 0; i < cnt; i++)
+    {
+      size_t entry = first != BITMAP_ERROR ? first + i
+                     : bitmap_scan_and_flip (entry_map, 0, 1, false);
+
+      if (entry == BITMAP_ERROR)
+        {
+          full_cnt++;
+          entries[i] = SWAP_NONE;
+        }
+      else if (store_page (entry, kpages[i]))
+        entries[i] = entry;
+      else
+        {
+          bitmap_reset (entry_map, entry);
+          entries[i] = SWAP_NONE;
+        }
+    }
+  lock_release (&zswap_lock);
+}
+
+/* Reads entry ENTRY into KPAGE.  The entry stays in use; free it
+   with zswap_free(). */
+void
+zswap_load (size_t entry, void *kpage)
+{
+  struct zentry *z;
+
+  lock_acquire (&zswap_lock);
+  ASSERT (entry < entry_cnt && bitmap_test (entry_map, entry));
+  z = &table[entry];
+  if (z->size == 0)
+    {
+      uint32_t *w = kpage;
+      size_t i;
+
+      for (i = 0; i < PGSIZE / sizeof *w; i++)
+        w[i] = z->word;
+    }
+  else if (!lz_decompress (z->data, z->size, kpage))
+    PANIC ("zswap: entry %zu is corrupt", entry);
+  load_cnt++;
+  lock_release (&zswap_lock);
+}
+
+/* Frees entry ENTRY. */
+void
+zswap_free (size_t entry)
+{
+  struct zentry *z;
+
+  lock_acquire (&zswap_lock);
+  ASSERT (entry < entry_cnt && bitmap_test (entry_map, entry));
+  z = &table[entry];
+  if (z->size != 0)
+    {
+      zpage_free (z->data);
+      stored_bytes -= z->size;
+    }
+  bitmap_reset (entry_map, entry);
+  lock_release (&zswap_lock);
+}
+
+/* Prints compressed swap statistics. */
+void
+zswap_print_stats (void)
+{
+  if (entry_map == NULL)
+    return;
+  printf ("Compressed swap: %lld pages compressed, %lld as one word, "
+          "%lld loaded\n", compressed_cnt, word_cnt, load_cnt);
+  printf ("Compressed swap: %lld would not compress, %lld found it full, "
+          "%zu bytes in %zu of %d pages\n",
+          reject_cnt, full_cnt, stored_bytes, zpage_cnt, zswap_pages);
+}
@@ -0,0 +1,18 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+
+#include <stddef.h>
+
+/* Compressed swap in memory, tried before the swap disk. */
+
+/* Most pages' worth of memory to keep compressed pages in,
+   tunable as "zswap_pages".  0, the default, turns it off. */
+extern int zswap_pages;
+
+void zswap_init (void);
+void zswap_store (void *const *kpages, size_t cnt, size_t *entries);
+void zswap_load (size_t entry, void *kpage);
+void zswap_free (size_t entry);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
@@ -0,0 +1,307 @@
+/* Host-side checks and throughput benchmarks for the process list
+   (userprog/plist.c) and the open file table (userprog/flist.c).
+
+   Both are compiled unchanged from the kernel sources, against
+   the stand-in kernel headers in shim/, so that their data
+   structures can be measured and tuned without booting Pintos.
+   Run "make" here, then "./bench-lists [ROUNDS]".  Each benchmark
+   prints one line
+
+        BENCH <name> <ops> <unit> <ns> ns <rate> <unit>/s
+
+   in the format of the kernel's own benchmarks in tests/bench. */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "plist.h"
+#include "flist.h"
+#include "userprog/process.h"
+
+/* Default number of times each benchmark fills and empties its
+   table. */
+#define DEFAULT_ROUNDS 200
+
+/* Entries used in the process list: every index above 0,
+   since the kernel's main thread has no entry. */
+#define PLIST_ENTRIES (TID_CNT - 1)
+
+/* Slots in a full open file table. */
+#define FLIST_SLOTS (MAP_MAX_PAGES * MAP_PAGE_SLOTS)
+
+/* Parent id of a process started by the kernel's main thread. */
+#define KERNEL_PID -1
+
+#define CHECK(COND)                                                     \
+        if (COND) { } else {                                            \
+                fprintf (stderr, "%s:%d: check `%s' failed\n",          \
+                         __FILE__, __LINE__, #COND);                    \
+                exit (EXIT_FAILURE);                                    \
+        }
+
+static int64_t
+bench_start (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (int64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int64_t
+bench_elapsed (int64_t start)
+{
+  return bench_start () - start;
+}
+
+static void
+bench_report (const char *name, int64_t ns, int64_t ops, const char *unit)
+{
+  if (ns <= 0)
+    ns = 1;
+  printf ("BENCH %s %"PRId64" %s %"PRId64" ns %"PRId64" %s/s\n",
+          name, ops, unit, ns, ops * 1000000000 / ns, unit);
+}
+
+/* Returns the pid for tid table index IDX in generation GEN. */
+static plist_key_t
+make_pid (unsigned idx, unsigned gen)
+{
+  return (plist_key_t) ((gen + 1) << TID_INDEX_BITS | idx);
+}
+
+/* Returns the Ith dummy file.  The file table never looks
+   behind the pointers it stores. */
+static struct file *
+dummy_file (size_t i)
+{
+  return (struct file *) (uintptr_t) (0x1000 + i * 16);
+}
+
+/* Inserts PID as a child of PARENT, as process_execute() does. */
+static void
+spawn (process_list *list, plist_key_t pid, plist_key_t parent)
+{
+  shim_pid = pid;
+  CHECK (plist_insert (list, pid, plist_form_process_info (parent)));
+}
+
+/* Returns true if PID has an entry, storing it in *INFO. */
+static bool
+find (process_list *list, plist_key_t pid, plist_value_t *info)
+{
+  return plist_find (list, info, pid) == 1;
+}
+
+/* Exercises the process list with a small family of processes:
+   a chain 1 -> 2 -> 3 -> 4 -> 5 that exits from the middle, so
+   that both orphans and zombies are left behind and cleaned up. */
+static void
+check_plist (process_list *list)
+{
+  plist_key_t p[6];
+  plist_value_t info;
+  int status;
+  int i;
+
+  for (i = 1; i <= 5; i++)
+    {
+      p[i] = make_pid (i, 0);
+      spawn (list, p[i], i == 1 ? KERNEL_PID : p[i - 1]);
+    }
+
+  /* 5 exits: it stays as a zombie until 4 collects it. */
+  plist_set_exit_status (list, p[5], 55);
+  CHECK (plist_remove (list, p[5]));
+  CHECK (find (list, p[5], &info) && !info.alive && info.exit_status == 55);
+  shim_pid = p[4];
+  CHECK (plist_wait_any (list, &status) == p[5] && status == 55);
+  CHECK (!find (list, p[5], &info));
+  CHECK (plist_wait_any (list, &status) == -1);
+
+  /* 2 exits: 3 becomes an orphan and 2 a zombie of 1. */
+  plist_set_exit_status (list, p[2], 22);
+  CHECK (plist_remove (list, p[2]));
+  CHECK (find (list, p[3], &info) && info.alive && !info.parent_alive);
+  shim_pid = p[1];
+  CHECK (plist_wait_for_pid (list, p[2]));
+  CHECK (plist_get_exit_status (list, p[2]) == 22);
+  plist_release_child (list, p[2]);
+  CHECK (!find (list, p[2], &info));
+
+  /* An orphan's entry goes away as soon as it exits. */
+  CHECK (plist_remove (list, p[3]));
+  CHECK (!find (list, p[3], &info));
+  CHECK (find (list, p[4], &info) && !info.parent_alive);
+  CHECK (plist_remove (list, p[4]));
+  CHECK (!find (list, p[4], &info));
+
+  /* 1 is collected by the kernel's main thread.  A stale pid for
+     its slot finds nothing. */
+  CHECK (plist_remove (list, p[1]));
+  shim_pid = KERNEL_PID;
+  plist_release_child (list, p[1]);
+  CHECK (!find (list, p[1], &info));
+  CHECK (!find (list, make_pid (1, 1), &info));
+}
+
+/* Exercises the open file table: lowest free fds first, growth
+   past the first page, and closing whatever is left. */
+static void
+check_flist (void)
+{
+  struct map *m = NULL;
+  size_t i;
+
+  CHECK (map_find (m, 2) == NULL);
+  for (i = 0; i < MAP_PAGE_SLOTS + 1; i++)
+    CHECK (map_insert (&m, dummy_file (i)) == (key_t) i + 2);
+  CHECK (m->pages == 2);
+  CHECK (map_remove (m, 5) == dummy_file (3));
+  CHECK (map_find (m, 5) == NULL);
+  CHECK (map_insert (&m, dummy_file (3)) == 5);
+  shim_close_cnt = 0;
+  map_close_all_files (m);
+  CHECK (shim_close_cnt == MAP_PAGE_SLOTS + 1);
+  CHECK (map_find (m, 2) == NULL);
+  map_destroy (m);
+}
+
+/* Fills the process list with children of one parent process,
+   finds each of them, lets them exit and has the parent collect
+   them, ROUNDS times, timing each kind of operation.  Then fills
+   it again and times the parent exiting first, which orphans
+   every child. */
+static void
+bench_plist (process_list *list, int rounds)
+{
+  int64_t insert_ns = 0, find_ns = 0, remove_ns = 0, clean_ns = 0;
+  int64_t orphan_ns = 0, start;
+  plist_value_t info;
+  unsigned idx;
+  int r;
+
+  for (r = 0; r < rounds; r++)
+    {
+      /* Generation 0 was used by check_plist(). */
+      unsigned gen = r + 1;
+      plist_key_t parent = make_pid (1, gen);
+
+      spawn (list, parent, KERNEL_PID);
+
+      start = bench_start ();
+      for (idx = 2; idx <= PLIST_ENTRIES; idx++)
+        spawn (list, make_pid (idx, gen), parent);
+      insert_ns += bench_elapsed (start);
+
+      start = bench_start ();
+      for (idx = 2; idx <= PLIST_ENTRIES; idx++)
+        CHECK (find (list, make_pid (idx, gen), &info));
+      find_ns += bench_elapsed (start);
+
+      start = bench_start ();
+      for (idx = 2; idx <= PLIST_ENTRIES; idx++)
+        CHECK (plist_remove (list, make_pid (idx, gen)));
+      remove_ns += bench_elapsed (start);
+
+      shim_pid = parent;
+      start = bench_start ();
+      for (idx = 2; idx <= PLIST_ENTRIES; idx++)
+        plist_release_child (list, make_pid (idx, gen));
+      clean_ns += bench_elapsed (start);
+
+      /* Same again, but the parent exits first. */
+      gen += rounds;
+      for (idx = 2; idx <= PLIST_ENTRIES; idx++)
+        spawn (list, make_pid (idx, gen), parent);
+      start = bench_start ();
+      CHECK (plist_remove (list, parent));
+      orphan_ns += bench_elapsed (start);
+      for (idx = 2; idx <= PLIST_ENTRIES; idx++)
+        CHECK (plist_remove (list, make_pid (idx, gen)));
+      shim_pid = KERNEL_PID;
+      plist_release_child (list, parent);
+      CHECK (!find (list, parent, &info));
+    }
+
+  bench_report ("plist-insert", insert_ns,
+                (int64_t) rounds * (PLIST_ENTRIES - 1), "inserts");
+  bench_report ("plist-find", find_ns,
+                (int64_t) rounds * (PLIST_ENTRIES - 1), "finds");
+  bench_report ("plist-remove", remove_ns,
+                (int64_t) rounds * (PLIST_ENTRIES - 1), "removes");
+  bench_report ("plist-clean", clean_ns,
+                (int64_t) rounds * (PLIST_ENTRIES - 1), "releases");
+  bench_report ("plist-orphan", orphan_ns,
+                (int64_t) rounds * (PLIST_ENTRIES - 1), "orphans");
+}
+
+/* Fills an open file table, finds each file, removes them all,
+   then fills it again and closes everything, ROUNDS times. */
+static void
+bench_flist (int rounds)
+{
+  int64_t insert_ns = 0, find_ns = 0, remove_ns = 0, clean_ns = 0;
+  int64_t start;
+  size_t i;
+  int r;
+
+  for (r = 0; r < rounds; r++)
+    {
+      struct map *m = NULL;
+
+      start = bench_start ();
+      for (i = 0; i < FLIST_SLOTS; i++)
+        CHECK (map_insert (&m, dummy_file (i)) == (key_t) i + 2);
+      insert_ns += bench_elapsed (start);
+
+      start = bench_start ();
+      for (i = 0; i < FLIST_SLOTS; i++)
+        CHECK (map_find (m, i + 2) == dummy_file (i));
+      find_ns += bench_elapsed (start);
+
+      start = bench_start ();
+      for (i = 0; i < FLIST_SLOTS; i++)
+        CHECK (map_remove (m, i + 2) == dummy_file (i));
+      remove_ns += bench_elapsed (start);
+
+      for (i = 0; i < FLIST_SLOTS; i++)
+        map_insert (&m, dummy_file (i));
+      start = bench_start ();
+      map_close_all_files (m);
+      map_destroy (m);
+      clean_ns += bench_elapsed (start);
+    }
+
+  bench_report ("flist-insert", insert_ns,
+                (int64_t) rounds * FLIST_SLOTS, "inserts");
+  bench_report ("flist-find", find_ns,
+                (int64_t) rounds * FLIST_SLOTS, "finds");
+  bench_report ("flist-remove", remove_ns,
+                (int64_t) rounds * FLIST_SLOTS, "removes");
+  bench_report ("flist-clean", clean_ns,
+                (int64_t) rounds * FLIST_SLOTS, "closes");
+}
+
+int
+main (int argc, char *argv[])
+{
+  process_list list;
+  int rounds = argc > 1 ? atoi (argv[1]) : DEFAULT_ROUNDS;
+
+  if (rounds <= 0)
+    {
+      fprintf (stderr, "usage: %s [ROUNDS]\n", argv[0]);
+      return EXIT_FAILURE;
+    }
+
+  init_fatlock (&list);
+  check_plist (&list);
+  check_flist ();
+  printf ("plist and flist checks passed\n");
+
+  bench_plist (&list, rounds);
+  bench_flist (rounds);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,15 @@
+#ifndef SHIM_DEBUG_H
+#define SHIM_DEBUG_H
+
+/* Host stand-in for lib/debug.h: the library's own header, found
+   after this one on the include path, with debug() turned into a
+   no-op so that the benchmark's timings leave out the logging.
+   log_levels[], which the library header declares for
+   log_printf(), is defined in shim.c with every subsystem off. */
+
+#include_next <debug.h>
+
+#undef debug
+#define debug(fmt, ...) ((void) 0)
+
+#endif /* debug.h */
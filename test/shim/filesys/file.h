@@ -0,0 +1,13 @@
+#ifndef FILESYS_FILE_H
+#define FILESYS_FILE_H
+
+/* Host stand-in for the kernel's filesys/file.h.  The file table
+   only stores, shares and closes struct file pointers, so the
+   harness hands it dummy ones, and sharing one returns it as
+   is. */
+
+struct file;
+
+struct file *file_share (struct file *);
+
+#endif /* filesys/file.h */
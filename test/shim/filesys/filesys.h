@@ -0,0 +1,14 @@
+#ifndef FILESYS_FILESYS_H
+#define FILESYS_FILESYS_H
+
+/* Host stand-in for the kernel's filesys/filesys.h.
+   filesys_close() only counts the files closed, in
+   shim_close_cnt. */
+
+struct file;
+
+extern long long shim_close_cnt;
+
+void filesys_close (struct file *);
+
+#endif /* filesys/filesys.h */
@@ -0,0 +1,177 @@
+/* Host implementations of the kernel interfaces declared by the
+   headers in this directory, for compiling userprog/plist.c and
+   userprog/flist.c into a host program. */
+
+#include <debug.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/process.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+
+tid_t shim_pid;
+long long shim_close_cnt;
+
+/* Runtime log levels, all LOG_OFF. */
+unsigned char log_levels[LOG_SUBSYS_CNT];
+
+/* Holds taken with tid_hold(), by tid index. */
+static unsigned tid_holds[TID_CNT];
+
+void
+debug_panic (const char *file, int line, const char *function,
+             const char *message, ...)
+{
+  va_list args;
+
+  fprintf (stderr, "PANIC at %s:%d in %s(): ", file, line, function);
+  va_start (args, message);
+  vfprintf (stderr, message, args);
+  va_end (args);
+  fprintf (stderr, "\n");
+  abort ();
+}
+
+void
+sema_init (struct semaphore *sema, unsigned value)
+{
+  sema->value = value;
+}
+
+void
+sema_down (struct semaphore *sema)
+{
+  if (sema->value == 0)
+    PANIC ("sema_down() would block forever");
+  sema->value--;
+}
+
+bool
+sema_try_down (struct semaphore *sema)
+{
+  if (sema->value == 0)
+    return false;
+  sema->value--;
+  return true;
+}
+
+void
+sema_up (struct semaphore *sema)
+{
+  sema->value++;
+}
+
+void
+lock_init (struct lock *lock)
+{
+  lock_init_named (lock, NULL);
+}
+
+void
+lock_init_named (struct lock *lock, const char *name)
+{
+  lock->held = false;
+  lock->name = name;
+}
+
+void
+lock_acquire (struct lock *lock)
+{
+  if (lock->held)
+    PANIC ("lock_acquire() of a held lock would deadlock");
+  lock->held = true;
+}
+
+bool
+lock_try_acquire (struct lock *lock)
+{
+  if (lock->held)
+    return false;
+  lock->held = true;
+  return true;
+}
+
+void
+lock_release (struct lock *lock)
+{
+  ASSERT (lock->held);
+  lock->held = false;
+}
+
+bool
+lock_held_by_current_thread (const struct lock *lock)
+{
+  return lock->held;
+}
+
+bool
+tid_hold (tid_t tid)
+{
+  tid_holds[TID_INDEX (tid)]++;
+  return true;
+}
+
+void
+tid_release (tid_t tid)
+{
+  ASSERT (tid_holds[TID_INDEX (tid)] > 0);
+  tid_holds[TID_INDEX (tid)]--;
+}
+
+tid_t
+process_pid (void)
+{
+  return shim_pid;
+}
+
+void *
+palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
+{
+  void *pages = aligned_alloc (PGSIZE, page_cnt * PGSIZE);
+
+  if (pages == NULL)
+    {
+      if (flags & PAL_ASSERT)
+        PANIC ("palloc_get: out of pages");
+      return NULL;
+    }
+  if (flags & PAL_ZERO)
+    memset (pages, 0, page_cnt * PGSIZE);
+  return pages;
+}
+
+void *
+palloc_get_page (enum palloc_flags flags)
+{
+  return palloc_get_multiple (flags, 1);
+}
+
+void
+palloc_free_multiple (void *pages, size_t page_cnt UNUSED)
+{
+  free (pages);
+}
+
+void
+palloc_free_page (void *page)
+{
+  free (page);
+}
+
+void
+filesys_close (struct file *file UNUSED)
+{
+  shim_close_cnt++;
+}
+
+struct file *
+file_share (struct file *file)
+{
+  return file;
+}
@@ -0,0 +1,8 @@
+#ifndef THREADS_MALLOC_H
+#define THREADS_MALLOC_H
+
+/* Host stand-in for the kernel's threads/malloc.h. */
+
+#include <stdlib.h>
+
+#endif /* threads/malloc.h */
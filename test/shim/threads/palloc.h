@@ -0,0 +1,22 @@
+#ifndef THREADS_PALLOC_H
+#define THREADS_PALLOC_H
+
+/* Host stand-in for the kernel's threads/palloc.h, backed by the
+   C library.  Pages are PGSIZE bytes and page-aligned, as in the
+   kernel. */
+
+#include <stddef.h>
+
+enum palloc_flags
+  {
+    PAL_ASSERT = 001,           /* Panic on failure. */
+    PAL_ZERO = 002,             /* Zero page contents. */
+    PAL_USER = 004              /* User page. */
+  };
+
+void *palloc_get_page (enum palloc_flags);
+void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
+void palloc_free_page (void *);
+void palloc_free_multiple (void *, size_t page_cnt);
+
+#endif /* threads/palloc.h */
@@ -0,0 +1,38 @@
+#ifndef THREADS_SYNCH_H
+#define THREADS_SYNCH_H
+
+/* Host stand-in for the kernel's threads/synch.h.  The harness
+   runs on one thread, so a lock only records whether it is held,
+   for the ASSERTs in the code under test, and a semaphore is a
+   bare counter.  Downing a semaphore at zero would block forever,
+   so it panics instead. */
+
+#include <stdbool.h>
+
+struct semaphore
+  {
+    unsigned value;             /* Current value. */
+  };
+
+void sema_init (struct semaphore *, unsigned value);
+void sema_down (struct semaphore *);
+bool sema_try_down (struct semaphore *);
+void sema_up (struct semaphore *);
+
+struct lock
+  {
+    bool held;                  /* True while acquired. */
+    const char *name;           /* Name given to lock_init_named(). */
+  };
+
+void lock_init (struct lock *);
+void lock_init_named (struct lock *, const char *name);
+void lock_acquire (struct lock *);
+bool lock_try_acquire (struct lock *);
+void lock_release (struct lock *);
+bool lock_held_by_current_thread (const struct lock *);
+
+/* Optimization barrier, as in the kernel. */
+#define barrier() asm volatile ("" : : : "memory")
+
+#endif /* threads/synch.h */
@@ -0,0 +1,37 @@
+#ifndef THREADS_THREAD_H
+#define THREADS_THREAD_H
+
+/* Host stand-in for the kernel's threads/thread.h: the tid
+   layout, the tid holds that the process list takes, and the
+   statistics members of struct thread that plist_print_list()
+   shows. */
+
+#include <debug.h>
+#include <stats.h>
+#include <stdint.h>
+
+typedef int tid_t;
+#define TID_ERROR ((tid_t) -1)
+
+/* Must match threads/thread.h: a tid is a slot index in its low
+   TID_INDEX_BITS bits and that slot's generation above them. */
+#define TID_INDEX_BITS 12
+#define TID_CNT (1 << TID_INDEX_BITS)
+#define TID_INDEX(TID) ((unsigned) (TID) & (TID_CNT - 1))
+
+struct thread
+  {
+    long long user_ticks;
+    long long kernel_ticks;
+    long long wait_ticks;
+    unsigned voluntary_switches;
+    unsigned involuntary_switches;
+    long long fault_cnt[FAULT_CLASS_CNT];
+    long long io_read_bytes;
+    long long io_write_bytes;
+  };
+
+bool tid_hold (tid_t);
+void tid_release (tid_t);
+
+#endif /* threads/thread.h */
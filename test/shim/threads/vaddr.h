@@ -0,0 +1,9 @@
+#ifndef THREADS_VADDR_H
+#define THREADS_VADDR_H
+
+/* Host stand-in for the kernel's threads/vaddr.h. */
+
+#define PGBITS 12                       /* Number of offset bits. */
+#define PGSIZE (1 << PGBITS)            /* Bytes in a page. */
+
+#endif /* threads/vaddr.h */
@@ -0,0 +1,14 @@
+#ifndef USERPROG_PROCESS_H
+#define USERPROG_PROCESS_H
+
+/* Host stand-in for the kernel's userprog/process.h.  The
+   "running process" is whichever pid the harness last stored in
+   shim_pid. */
+
+#include "threads/thread.h"
+
+extern tid_t shim_pid;
+
+tid_t process_pid (void);
+
+#endif /* userprog/process.h */